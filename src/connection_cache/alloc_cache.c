@@ -392,6 +392,8 @@ init_splite_internal_cache (struct splite_internal_cache *cache)
     cache->cutterMessage = NULL;
     cache->storedProcError = NULL;
     cache->createRoutingError = NULL;
+    cache->parallelJoinError = NULL;
+    cache->knnJoinError = NULL;
     cache->SqlProcLogfile = NULL;
     cache->SqlProcLogfileAppend = 0;
     cache->SqlProcLog = NULL;
@@ -416,6 +418,8 @@ init_splite_internal_cache (struct splite_internal_cache *cache)
     cache->buffer_join_style = GEOSBUF_JOIN_ROUND;
     cache->buffer_mitre_limit = 5.0;
     cache->buffer_quadrant_segments = 30;
+    cache->union_batch_size = UNION_DEFAULT_BATCH_SIZE;
+    cache->union_spatial_sort = 0;
 /* initializing an empty linked list of Topologies */
     cache->firstTopology = NULL;
     cache->lastTopology = NULL;
@@ -435,6 +439,11 @@ init_splite_internal_cache (struct splite_internal_cache *cache)
 /* initializing Virtual BBOXes */
     cache->first_vtable_extent = NULL;
     cache->last_vtable_extent = NULL;
+/* initializing the deferred SpatialIndex queue */
+    cache->deferred_rtree_enabled = 0;
+    cache->deferred_rtree_lost = 0;
+    cache->first_deferred_rtree = NULL;
+    cache->last_deferred_rtree = NULL;
 /* initializing the XML error buffers */
     out = malloc (sizeof (gaiaOutBuffer));
     gaiaOutBufferInitialize (out);
@@ -446,18 +455,27 @@ init_splite_internal_cache (struct splite_internal_cache *cache)
     gaiaOutBufferInitialize (out);
     cache->xmlXPathErrors = out;
 /* initializing the GEOS cache */
-    p = &(cache->cacheItem1);
-    memset (p->gaiaBlob, '\0', 64);
-    p->gaiaBlobSize = 0;
-    p->crc32 = 0;
-    p->geosGeom = NULL;
-    p->preparedGeosGeom = NULL;
-    p = &(cache->cacheItem2);
-    memset (p->gaiaBlob, '\0', 64);
-    p->gaiaBlobSize = 0;
-    p->crc32 = 0;
-    p->geosGeom = NULL;
-    p->preparedGeosGeom = NULL;
+    cache->geosCacheSize = GEOS_CACHE_DEFAULT_SIZE;
+    cache->geosCache =
+	malloc (sizeof (struct splite_geos_cache_item) * cache->geosCacheSize);
+    for (i = 0; i < cache->geosCacheSize; i++)
+      {
+	  p = cache->geosCache + i;
+	  memset (p->gaiaBlob, '\0', 64);
+	  p->gaiaBlobSize = 0;
+	  p->hash = 0;
+	  p->lastUsed = 0;
+	  p->geosGeom = NULL;
+	  p->preparedGeosGeom = NULL;
+      }
+    for (i = 0; i < GEOS_CACHE_SEEN_SIZE; i++)
+      {
+	  cache->geosCacheSeen[i].hash = 0;
+	  cache->geosCacheSeen[i].gaiaBlobSize = 0;
+      }
+    cache->geosCacheTick = 0;
+    cache->geosCacheHits = 0;
+    cache->geosCacheMisses = 0;
     for (i = 0; i < MAX_XMLSCHEMA_CACHE; i++)
       {
 	  /* initializing the XmlSchema cache */
@@ -831,17 +849,122 @@ get_vtable_extent (const char *table, double *minx, double *miny, double *maxx,
     return 0;
 }
 
+SPATIALITE_PRIVATE int
+add_deferred_rtree_item (const char *rtree_name, sqlite3_int64 pkid,
+			 double minx, double miny, double maxx, double maxy,
+			 const void *p_cache)
+{
+/* queuing a pending R*Tree entry (deferred SpatialIndex mode) */
+    struct splite_internal_cache *cache =
+	(struct splite_internal_cache *) p_cache;
+    struct splite_deferred_rtree *rtree = cache->last_deferred_rtree;
+    struct splite_deferred_rtree_item *item;
+    if (rtree == NULL || strcasecmp (rtree->rtree_name, rtree_name) != 0)
+      {
+	  rtree = cache->first_deferred_rtree;
+	  while (rtree != NULL)
+	    {
+		if (strcasecmp (rtree->rtree_name, rtree_name) == 0)
+		    break;
+		rtree = rtree->next;
+	    }
+      }
+    if (rtree == NULL)
+      {
+	  /* first entry for this R*Tree */
+	  int len = strlen (rtree_name);
+	  rtree = malloc (sizeof (struct splite_deferred_rtree));
+	  if (rtree == NULL)
+	      return 0;
+	  rtree->rtree_name = malloc (len + 1);
+	  if (rtree->rtree_name == NULL)
+	    {
+		free (rtree);
+		return 0;
+	    }
+	  strcpy (rtree->rtree_name, rtree_name);
+	  rtree->items = NULL;
+	  rtree->count = 0;
+	  rtree->allocated = 0;
+	  rtree->next = NULL;
+	  if (cache->first_deferred_rtree == NULL)
+	      cache->first_deferred_rtree = rtree;
+	  if (cache->last_deferred_rtree != NULL)
+	      cache->last_deferred_rtree->next = rtree;
+	  cache->last_deferred_rtree = rtree;
+      }
+    if (rtree->count >= rtree->allocated)
+      {
+	  int allocated = (rtree->allocated == 0) ? 1024 : rtree->allocated * 2;
+	  struct splite_deferred_rtree_item *items =
+	      realloc (rtree->items,
+		       sizeof (struct splite_deferred_rtree_item) * allocated);
+	  if (items == NULL)
+	      return 0;
+	  rtree->items = items;
+	  rtree->allocated = allocated;
+      }
+    item = rtree->items + rtree->count;
+    item->pkid = pkid;
+    item->minx = minx;
+    item->miny = miny;
+    item->maxx = maxx;
+    item->maxy = maxy;
+    item->seq = rtree->count;
+    rtree->count += 1;
+    return 1;
+}
+
+SPATIALITE_PRIVATE int
+count_deferred_rtree_items (const char *rtree_name, const void *p_cache)
+{
+/* counting the pending entries of some R*Tree (deferred SpatialIndex mode) */
+    struct splite_internal_cache *cache =
+	(struct splite_internal_cache *) p_cache;
+    struct splite_deferred_rtree *rtree = cache->first_deferred_rtree;
+    while (rtree != NULL)
+      {
+	  if (strcasecmp (rtree->rtree_name, rtree_name) == 0)
+	      return rtree->count;
+	  rtree = rtree->next;
+      }
+    return 0;
+}
+
+SPATIALITE_PRIVATE void
+reset_deferred_rtrees (const void *p_cache)
+{
+/* discarding all pending R*Tree entries */
+    struct splite_internal_cache *cache =
+	(struct splite_internal_cache *) p_cache;
+    struct splite_deferred_rtree *rtree;
+    struct splite_deferred_rtree *rtree_n;
+
+    rtree = cache->first_deferred_rtree;
+    while (rtree != NULL)
+      {
+	  rtree_n = rtree->next;
+	  free (rtree->rtree_name);
+	  if (rtree->items != NULL)
+	      free (rtree->items);
+	  free (rtree);
+	  rtree = rtree_n;
+      }
+    cache->first_deferred_rtree = NULL;
+    cache->last_deferred_rtree = NULL;
+}
+
 SPATIALITE_PRIVATE void
 free_internal_cache (struct splite_internal_cache *cache)
 {
 /* freeing an internal cache */
     struct splite_geos_cache_item *p;
+    int i;
 #ifndef OMIT_GEOS
     GEOSContextHandle_t handle = NULL;
 #endif
 
 #ifdef ENABLE_LIBXML2
-    int i;
     struct splite_xmlSchema_cache_item *p_xmlSchema;
 #endif
 
@@ -855,6 +978,17 @@ free_internal_cache (struct splite_internal_cache *cache)
 	gaia_free_variant (cache->SqlProcRetValue);
     cache->SqlProcRetValue = NULL;
 
+/* freeing the GEOS cache */
+    for (i = 0; i < cache->geosCacheSize; i++)
+      {
+	  p = cache->geosCache + i;
+	  splite_free_geos_cache_item_r (cache, p);
+      }
+    if (cache->geosCache != NULL)
+	free (cache->geosCache);
+    cache->geosCache = NULL;
+    cache->geosCacheSize = 0;
+
 #ifndef OMIT_GEOS
     handle = cache->GEOS_handle;
     if (handle != NULL)
@@ -918,11 +1052,6 @@ free_internal_cache (struct splite_internal_cache *cache)
     free (cache->xmlSchemaValidationErrors);
     free (cache->xmlXPathErrors);
 
-/* freeing the GEOS cache */
-    p = &(cache->cacheItem1);
-    splite_free_geos_cache_item_r (cache, p);
-    p = &(cache->cacheItem2);
-    splite_free_geos_cache_item_r (cache, p);
 #ifdef ENABLE_LIBXML2
     for (i = 0; i < MAX_XMLSCHEMA_CACHE; i++)
       {
@@ -941,6 +1070,12 @@ free_internal_cache (struct splite_internal_cache *cache)
     if (cache->createRoutingError != NULL)
 	free (cache->createRoutingError);
     cache->createRoutingError = NULL;
+    if (cache->parallelJoinError != NULL)
+	free (cache->parallelJoinError);
+    cache->parallelJoinError = NULL;
+    if (cache->knnJoinError != NULL)
+	free (cache->knnJoinError);
+    cache->knnJoinError = NULL;
     if (cache->storedProcError != NULL)
 	free (cache->storedProcError);
     cache->storedProcError = NULL;
@@ -952,6 +1087,7 @@ free_internal_cache (struct splite_internal_cache *cache)
     cache->SqlProcLog = NULL;
     free_sequences (cache);
     free_vtable_extents (cache);
+    reset_deferred_rtrees (cache);
 
     spatialite_finalize_topologies (cache);
 
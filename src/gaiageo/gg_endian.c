@@ -46,6 +46,7 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <sys/types.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #if defined(_WIN32) && !defined(__MINGW32__)
 #include "config-msvc.h"
@@ -53,6 +54,12 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include "config.h"
 #endif
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
 #include <spatialite/sqlite.h>
 
 #include <spatialite/gaiageo.h>
@@ -342,6 +349,64 @@ gaiaImport64 (const unsigned char *p, int little_endian, int little_endian_arch)
     return convert.double_value;
 }
 
+static void
+swap64_array (unsigned char *out, const unsigned char *in, int count)
+{
+/* reversing the byte order of an array of 64 bit values */
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i mask = _mm256_set_epi8 (8, 9, 10, 11, 12, 13, 14, 15,
+					  0, 1, 2, 3, 4, 5, 6, 7,
+					  8, 9, 10, 11, 12, 13, 14, 15,
+					  0, 1, 2, 3, 4, 5, 6, 7);
+    for (; i + 4 <= count; i += 4)
+      {
+	  __m256i v = _mm256_loadu_si256 ((const __m256i *) (in + (i * 8)));
+	  _mm256_storeu_si256 ((__m256i *) (out + (i * 8)),
+			       _mm256_shuffle_epi8 (v, mask));
+      }
+#elif defined(__SSSE3__)
+    const __m128i mask = _mm_set_epi8 (8, 9, 10, 11, 12, 13, 14, 15,
+				       0, 1, 2, 3, 4, 5, 6, 7);
+    for (; i + 2 <= count; i += 2)
+      {
+	  __m128i v = _mm_loadu_si128 ((const __m128i *) (in + (i * 8)));
+	  _mm_storeu_si128 ((__m128i *) (out + (i * 8)),
+			    _mm_shuffle_epi8 (v, mask));
+      }
+#endif
+    for (; i < count; i++)
+      {
+	  const unsigned char *p = in + (i * 8);
+	  unsigned char *q = out + (i * 8);
+	  q[0] = p[7];
+	  q[1] = p[6];
+	  q[2] = p[5];
+	  q[3] = p[4];
+	  q[4] = p[3];
+	  q[5] = p[2];
+	  q[6] = p[1];
+	  q[7] = p[0];
+      }
+}
+
+GAIAGEO_DECLARE void
+gaiaImport64Array (double *values, const unsigned char *p, int count,
+		   int little_endian, int little_endian_arch)
+{
+/* fetches an array of 64bit doubles from BLOB respecting declared endiannes */
+    if (count <= 0)
+	return;
+    if ((little_endian && little_endian_arch)
+	|| (!little_endian && !little_endian_arch))
+      {
+	  /* same byte ordering: a plain copy */
+	  memcpy (values, p, count * sizeof (double));
+	  return;
+      }
+    swap64_array ((unsigned char *) values, p, count);
+}
+
 GAIAGEO_DECLARE sqlite3_int64
 gaiaImportI64 (const unsigned char *p, int little_endian,
 	       int little_endian_arch)
@@ -684,6 +749,23 @@ gaiaExport64 (unsigned char *p, double value, int little_endian,
       }
 }
 
+GAIAGEO_DECLARE void
+gaiaExport64Array (unsigned char *p, const double *values, int count,
+		   int little_endian, int little_endian_arch)
+{
+/* stores an array of 64bit doubles into a BLOB respecting declared endiannes */
+    if (count <= 0)
+	return;
+    if ((little_endian && little_endian_arch)
+	|| (!little_endian && !little_endian_arch))
+      {
+	  /* same byte ordering: a plain copy */
+	  memcpy (p, values, count * sizeof (double));
+	  return;
+      }
+    swap64_array (p, (const unsigned char *) values, count);
+}
+
 GAIAGEO_DECLARE void
 gaiaExportI64 (unsigned char *p, sqlite3_int64 value, int little_endian,
 	       int little_endian_arch)
@@ -58,6 +58,7 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <spatialite/debug.h>
 
 #include <spatialite/gaiageo.h>
+#include <spatialite_private.h>
 
 #ifdef _WIN32
 #define strcasecmp	_stricmp
@@ -1880,17 +1881,16 @@ findEwktSrid (const char *buffer, int *base_offset)
     return atoi (dummy + 5);
 }
 
-gaiaGeomCollPtr
-gaiaParseEWKT (const unsigned char *dirty_buffer)
+static gaiaGeomCollPtr
+ewkt_lemon_parse (const unsigned char *buffer)
 {
+/* parsing an EWKT by using the FLEX lexer and the LEMON parser */
     void *pParser = ParseAlloc (malloc);
     /* Linked-list of token values */
     ewktFlexToken *tokens = malloc (sizeof (ewktFlexToken));
     /* Pointer to the head of the list */
     ewktFlexToken *head = tokens;
     int yv;
-    int srid;
-    int base_offset;
     yyscan_t scanner;
     struct ewkt_data str_data;
 
@@ -1906,8 +1906,7 @@ gaiaParseEWKT (const unsigned char *dirty_buffer)
     Ewktlex_init_extra (&str_data, &scanner);
     tokens->Next = NULL;
 
-    srid = findEwktSrid ((char *) dirty_buffer, &base_offset);
-    Ewkt_scan_string ((char *) dirty_buffer + base_offset, scanner);
+    Ewkt_scan_string ((char *) buffer, scanner);
 
     /*
        / Keep tokenizing until we reach the end
@@ -1953,19 +1952,38 @@ gaiaParseEWKT (const unsigned char *dirty_buffer)
       }
 
     ewktCleanMapDynAlloc (&str_data, 0);
+    return str_data.result;
+}
 
-    if (str_data.result == NULL)
+gaiaGeomCollPtr
+gaiaParseEWKT (const unsigned char *dirty_buffer)
+{
+    gaiaGeomCollPtr result;
+    int srid;
+    int base_offset;
+
+    srid = findEwktSrid ((char *) dirty_buffer, &base_offset);
+
+/*
+/ attempting first the fast reader; the LEMON parser is still
+/ required by anything else (syntax errors included)
+*/
+    result = gaiaFastParseWkt (dirty_buffer + base_offset, 1);
+    if (result == NULL)
+	result = ewkt_lemon_parse (dirty_buffer + base_offset);
+
+    if (result == NULL)
 	return NULL;
-    if (!ewktCheckValidity (str_data.result))
+    if (!ewktCheckValidity (result))
       {
-	  gaiaFreeGeomColl (str_data.result);
+	  gaiaFreeGeomColl (result);
 	  return NULL;
       }
 
-    gaiaMbrGeometry (str_data.result);
-    str_data.result->Srid = srid;
+    gaiaMbrGeometry (result);
+    result->Srid = srid;
 
-    return str_data.result;
+    return result;
 }
 
 
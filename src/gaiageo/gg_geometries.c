@@ -59,6 +59,7 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <spatialite/sqlite.h>
 
 #include <spatialite/gaiageo.h>
+#include <spatialite_private.h>
 
 GAIAGEO_DECLARE gaiaPointPtr
 gaiaAllocPoint (double x, double y)
@@ -977,6 +978,7 @@ gaiaAllocPolygon (int vert, int excl)
 	  pP->Coords = NULL;
 	  pP->Next = NULL;
 	  pP->Link = 0;
+	  pP->DimensionModel = GAIA_XY;
       }
     p->MinX = DBL_MAX;
     p->MinY = DBL_MAX;
@@ -1009,6 +1011,7 @@ gaiaAllocPolygonXYZ (int vert, int excl)
 	  pP->Coords = NULL;
 	  pP->Next = NULL;
 	  pP->Link = 0;
+	  pP->DimensionModel = GAIA_XY_Z;
       }
     p->MinX = DBL_MAX;
     p->MinY = DBL_MAX;
@@ -1041,6 +1044,7 @@ gaiaAllocPolygonXYM (int vert, int excl)
 	  pP->Coords = NULL;
 	  pP->Next = NULL;
 	  pP->Link = 0;
+	  pP->DimensionModel = GAIA_XY_M;
       }
     p->MinX = DBL_MAX;
     p->MinY = DBL_MAX;
@@ -1073,6 +1077,7 @@ gaiaAllocPolygonXYZM (int vert, int excl)
 	  pP->Coords = NULL;
 	  pP->Next = NULL;
 	  pP->Link = 0;
+	  pP->DimensionModel = GAIA_XY_Z_M;
       }
     p->MinX = DBL_MAX;
     p->MinY = DBL_MAX;
@@ -1719,6 +1724,337 @@ gaiaCastGeomCollToXYZMnoData (gaiaGeomCollPtr geom, double z_no_data,
     return new_geom;
 }
 
+/*
+/ a Geometry arena: all elementary geometry items and their coordinates
+/ are bump-allocated from a few large memory chunks, so that destroying
+/ the Geometry simply requires releasing the chunks
+/
+/ the Geometry itself is the very first block of its own arena, so that
+/ gaiaFreeArenaGeomColl() can locate the arena without any lookup; such
+/ a Geometry must never be passed to gaiaFreeGeomColl()
+*/
+#define GAIA_ARENA_ALIGN(sz)	(((sz) + 15) & ~((size_t) 15))
+
+struct gaiaGeomArenaChunk
+{
+/* a further memory chunk belonging to some arena */
+    struct gaiaGeomArenaChunk *Next;
+};
+
+struct gaiaGeomArenaStruct
+{
+/* a Geometry arena */
+    unsigned char *Buffer;	/* the current memory chunk */
+    size_t Size;		/* current chunk size */
+    size_t Used;		/* already allocated bytes (current chunk) */
+    size_t NextSize;		/* size of the next chunk to be created */
+    struct gaiaGeomArenaChunk *Chunks;	/* further chunks - linked list */
+};
+
+#define GAIA_ARENA_HEADER \
+	GAIA_ARENA_ALIGN (sizeof (struct gaiaGeomArenaStruct))
+
+static void *
+arena_alloc (struct gaiaGeomArenaStruct *arena, size_t size)
+{
+/* allocating a memory block from the arena */
+    void *block;
+    size = GAIA_ARENA_ALIGN (size);
+    if (arena->Used + size > arena->Size)
+      {
+	  /* the current chunk is exhausted: creating a further chunk */
+	  struct gaiaGeomArenaChunk *chunk;
+	  size_t hdr = GAIA_ARENA_ALIGN (sizeof (struct gaiaGeomArenaChunk));
+	  size_t chunk_size = arena->NextSize;
+	  if (chunk_size < size)
+	      chunk_size = size;
+	  chunk = malloc (hdr + chunk_size);
+	  if (chunk == NULL)
+	      return NULL;
+	  chunk->Next = arena->Chunks;
+	  arena->Chunks = chunk;
+	  arena->Buffer = (unsigned char *) chunk + hdr;
+	  arena->Size = chunk_size;
+	  arena->Used = 0;
+	  arena->NextSize *= 2;
+      }
+    block = arena->Buffer + arena->Used;
+    arena->Used += size;
+    return block;
+}
+
+static void
+arena_free (struct gaiaGeomArenaStruct *arena)
+{
+/* destroying the arena */
+    struct gaiaGeomArenaChunk *chunk = arena->Chunks;
+    while (chunk != NULL)
+      {
+	  struct gaiaGeomArenaChunk *next = chunk->Next;
+	  free (chunk);
+	  chunk = next;
+      }
+    free (arena);
+}
+
+static double *
+arena_alloc_coords (struct gaiaGeomArenaStruct *arena, int vert,
+		    int dimension_model)
+{
+/* allocating a COORDs mem-array from the arena */
+    int dims = 2;
+    if (dimension_model == GAIA_XY_Z || dimension_model == GAIA_XY_M)
+	dims = 3;
+    else if (dimension_model == GAIA_XY_Z_M)
+	dims = 4;
+    if (vert <= 0)
+	vert = 1;
+    return arena_alloc (arena, sizeof (double) * dims * (size_t) vert);
+}
+
+static gaiaPointPtr
+arena_alloc_point (struct gaiaGeomArenaStruct *arena, double x, double y,
+		   double z, double m, int dimension_model)
+{
+/* POINT object constructor [arena] */
+    gaiaPointPtr p = arena_alloc (arena, sizeof (gaiaPoint));
+    if (p == NULL)
+	return NULL;
+    p->X = x;
+    p->Y = y;
+    p->Z = z;
+    p->M = m;
+    p->DimensionModel = dimension_model;
+    p->Next = NULL;
+    p->Prev = NULL;
+    return p;
+}
+
+static gaiaLinestringPtr
+arena_alloc_linestring (struct gaiaGeomArenaStruct *arena, int vert,
+			int dimension_model)
+{
+/* LINESTRING object constructor [arena] */
+    gaiaLinestringPtr p = arena_alloc (arena, sizeof (gaiaLinestring));
+    if (p == NULL)
+	return NULL;
+    p->Coords = arena_alloc_coords (arena, vert, dimension_model);
+    if (p->Coords == NULL)
+	return NULL;
+    p->Points = vert;
+    p->MinX = DBL_MAX;
+    p->MinY = DBL_MAX;
+    p->MaxX = -DBL_MAX;
+    p->MaxY = -DBL_MAX;
+    p->DimensionModel = dimension_model;
+    p->Next = NULL;
+    return p;
+}
+
+static void
+arena_init_ring (gaiaRingPtr p, int vert, double *coords, int dimension_model)
+{
+/* initializing a RING object [arena] */
+    p->Coords = coords;
+    p->Points = vert;
+    p->Link = NULL;
+    p->Clockwise = 0;
+    p->MinX = DBL_MAX;
+    p->MinY = DBL_MAX;
+    p->MaxX = -DBL_MAX;
+    p->MaxY = -DBL_MAX;
+    p->DimensionModel = dimension_model;
+    p->Next = NULL;
+}
+
+static gaiaPolygonPtr
+arena_alloc_polygon (struct gaiaGeomArenaStruct *arena, int vert, int excl,
+		     int dimension_model)
+{
+/* POLYGON object constructor [arena] */
+    gaiaPolygonPtr p;
+    gaiaRingPtr ring;
+    double *coords;
+    int ind;
+    p = arena_alloc (arena, sizeof (gaiaPolygon));
+    ring = arena_alloc (arena, sizeof (gaiaRing));
+    coords = arena_alloc_coords (arena, vert, dimension_model);
+    if (p == NULL || ring == NULL || coords == NULL)
+	return NULL;
+    arena_init_ring (ring, vert, coords, dimension_model);
+    p->Exterior = ring;
+    p->NumInteriors = excl;
+    p->NextInterior = 0;
+    p->Next = NULL;
+    if (excl <= 0)
+	p->Interiors = NULL;
+    else
+      {
+	  p->Interiors = arena_alloc (arena, sizeof (gaiaRing) * (size_t) excl);
+	  if (p->Interiors == NULL)
+	      return NULL;
+      }
+    for (ind = 0; ind < p->NumInteriors; ind++)
+	arena_init_ring (p->Interiors + ind, 0, NULL, dimension_model);
+    p->MinX = DBL_MAX;
+    p->MinY = DBL_MAX;
+    p->MaxX = -DBL_MAX;
+    p->MaxY = -DBL_MAX;
+    p->DimensionModel = dimension_model;
+    return p;
+}
+
+SPATIALITE_PRIVATE void *
+gaiaAllocArenaGeomColl (int size_hint, void **p_arena)
+{
+/* GEOMETRYCOLLECTION object constructor [owning a memory arena] */
+    gaiaGeomCollPtr p;
+    struct gaiaGeomArenaStruct *arena;
+    size_t geom_size = GAIA_ARENA_ALIGN (sizeof (gaiaGeomColl));
+    size_t size = 4096;
+    *p_arena = NULL;
+    if (size_hint > 0)
+      {
+	  /* 
+	     / the BLOB is usually a little more compact than the corresponding
+	     / objects (each POINT or RING has its own struct, and compressed
+	     / vertices will be expanded), so the first chunk is oversized
+	   */
+	  size = GAIA_ARENA_ALIGN (((size_t) size_hint * 2) + 256);
+      }
+    size += geom_size;
+    arena = malloc (GAIA_ARENA_HEADER + size);
+    if (arena == NULL)
+	return NULL;
+    arena->Buffer = (unsigned char *) arena + GAIA_ARENA_HEADER;
+    arena->Size = size;
+    arena->Used = geom_size;
+    arena->NextSize = size;
+    arena->Chunks = NULL;
+/* the Geometry is the first block of the arena */
+    p = (gaiaGeomCollPtr) (arena->Buffer);
+    p->Srid = 0;
+    p->endian = ' ';
+    p->offset = 0;
+    p->FirstPoint = NULL;
+    p->LastPoint = NULL;
+    p->FirstLinestring = NULL;
+    p->LastLinestring = NULL;
+    p->FirstPolygon = NULL;
+    p->LastPolygon = NULL;
+    p->MinX = DBL_MAX;
+    p->MinY = DBL_MAX;
+    p->MaxX = -DBL_MAX;
+    p->MaxY = -DBL_MAX;
+    p->DimensionModel = GAIA_XY;
+    p->DeclaredType = GAIA_UNKNOWN;
+    p->Next = NULL;
+    *p_arena = arena;
+    return p;
+}
+
+SPATIALITE_PRIVATE void
+gaiaFreeArenaGeomColl (void *p_geom)
+{
+/* GEOMETRYCOLLECTION object destructor [owning a memory arena] */
+    struct gaiaGeomArenaStruct *arena;
+    if (p_geom == NULL)
+	return;
+    arena =
+	(struct gaiaGeomArenaStruct *) ((unsigned char *) p_geom -
+					GAIA_ARENA_HEADER);
+    arena_free (arena);
+}
+
+SPATIALITE_PRIVATE void
+gaiaArenaAddPoint (void *p_arena, void *p_geom, double x, double y, double z,
+		   double m, int dimension_model)
+{
+/* adding a POINT to this GEOMETRYCOLLECTION [arena aware] */
+    struct gaiaGeomArenaStruct *arena = (struct gaiaGeomArenaStruct *) p_arena;
+    gaiaGeomCollPtr geom = (gaiaGeomCollPtr) p_geom;
+    gaiaPointPtr point;
+    if (arena == NULL)
+      {
+	  if (dimension_model == GAIA_XY_Z)
+	      gaiaAddPointToGeomCollXYZ (geom, x, y, z);
+	  else if (dimension_model == GAIA_XY_M)
+	      gaiaAddPointToGeomCollXYM (geom, x, y, m);
+	  else if (dimension_model == GAIA_XY_Z_M)
+	      gaiaAddPointToGeomCollXYZM (geom, x, y, z, m);
+	  else
+	      gaiaAddPointToGeomColl (geom, x, y);
+	  return;
+      }
+    point = arena_alloc_point (arena, x, y, z, m, dimension_model);
+    if (point == NULL)
+	return;
+    if (geom->FirstPoint == NULL)
+	geom->FirstPoint = point;
+    if (geom->LastPoint != NULL)
+	geom->LastPoint->Next = point;
+    geom->LastPoint = point;
+}
+
+SPATIALITE_PRIVATE void *
+gaiaArenaAddLinestring (void *p_arena, void *p_geom, int vert)
+{
+/* adding a LINESTRING to this GEOMETRYCOLLECTION [arena aware] */
+    struct gaiaGeomArenaStruct *arena = (struct gaiaGeomArenaStruct *) p_arena;
+    gaiaGeomCollPtr geom = (gaiaGeomCollPtr) p_geom;
+    gaiaLinestringPtr line;
+    if (arena == NULL)
+	return gaiaAddLinestringToGeomColl (geom, vert);
+    line = arena_alloc_linestring (arena, vert, geom->DimensionModel);
+    if (line == NULL)
+	return NULL;
+    if (geom->FirstLinestring == NULL)
+	geom->FirstLinestring = line;
+    if (geom->LastLinestring != NULL)
+	geom->LastLinestring->Next = line;
+    geom->LastLinestring = line;
+    return line;
+}
+
+SPATIALITE_PRIVATE void *
+gaiaArenaAddPolygon (void *p_arena, void *p_geom, int vert, int interiors)
+{
+/* adding a POLYGON to this GEOMETRYCOLLECTION [arena aware] */
+    struct gaiaGeomArenaStruct *arena = (struct gaiaGeomArenaStruct *) p_arena;
+    gaiaGeomCollPtr geom = (gaiaGeomCollPtr) p_geom;
+    gaiaPolygonPtr polyg;
+    if (arena == NULL)
+	return gaiaAddPolygonToGeomColl (geom, vert, interiors);
+    polyg =
+	arena_alloc_polygon (arena, vert, interiors, geom->DimensionModel);
+    if (polyg == NULL)
+	return NULL;
+    if (geom->FirstPolygon == NULL)
+	geom->FirstPolygon = polyg;
+    if (geom->LastPolygon != NULL)
+	geom->LastPolygon->Next = polyg;
+    geom->LastPolygon = polyg;
+    return polyg;
+}
+
+SPATIALITE_PRIVATE void *
+gaiaArenaAddInteriorRing (void *p_arena, void *p_polyg, int pos, int vert)
+{
+/* adding an interior ring to some polygon [arena aware] */
+    struct gaiaGeomArenaStruct *arena = (struct gaiaGeomArenaStruct *) p_arena;
+    gaiaPolygonPtr polyg = (gaiaPolygonPtr) p_polyg;
+    gaiaRingPtr ring;
+    if (arena == NULL)
+	return gaiaAddInteriorRing (polyg, pos, vert);
+    ring = polyg->Interiors + pos;
+    ring->Coords = arena_alloc_coords (arena, vert, polyg->DimensionModel);
+    if (ring->Coords == NULL)
+	return NULL;
+    ring->Points = vert;
+    ring->DimensionModel = polyg->DimensionModel;
+    return ring;
+}
+
 GAIAGEO_DECLARE gaiaGeomCollPtr
 gaiaAllocGeomColl ()
 {
@@ -2919,116 +3255,16 @@ gaiaDimension (gaiaGeomCollPtr geom)
     return 2;
 }
 
-GAIAGEO_DECLARE int
-gaiaGeometryType (gaiaGeomCollPtr geom)
+static int
+geometry_type_from_counts (int n_points, int n_linestrings, int n_polygons,
+			   int declared_type, int dm)
 {
-/* determines the Class for this geometry */
-    gaiaPointPtr point;
-    gaiaLinestringPtr line;
-    gaiaPolygonPtr polyg;
-    gaiaRingPtr ring;
-    int ib;
-    int n_points = 0;
-    int n_linestrings = 0;
-    int n_polygons = 0;
-    int dm = GAIA_XY;
-    if (!geom)
-	return GAIA_UNKNOWN;
-    point = geom->FirstPoint;
-    while (point)
-      {
-	  /* counts how many points are there */
-	  n_points++;
-	  if (point->DimensionModel == GAIA_XY_Z)
-	    {
-		if (dm == GAIA_XY)
-		    dm = GAIA_XY_Z;
-		else if (dm == GAIA_XY_M)
-		    dm = GAIA_XY_Z_M;
-	    }
-	  else if (point->DimensionModel == GAIA_XY_M)
-	    {
-		if (dm == GAIA_XY)
-		    dm = GAIA_XY_M;
-		else if (dm == GAIA_XY_Z)
-		    dm = GAIA_XY_Z_M;
-	    }
-	  else if (point->DimensionModel == GAIA_XY_Z_M)
-	      dm = GAIA_XY_Z_M;
-	  point = point->Next;
-      }
-    line = geom->FirstLinestring;
-    while (line)
-      {
-	  /* counts how many linestrings are there */
-	  n_linestrings++;
-	  if (line->DimensionModel == GAIA_XY_Z)
-	    {
-		if (dm == GAIA_XY)
-		    dm = GAIA_XY_Z;
-		else if (dm == GAIA_XY_M)
-		    dm = GAIA_XY_Z_M;
-	    }
-	  else if (line->DimensionModel == GAIA_XY_M)
-	    {
-		if (dm == GAIA_XY)
-		    dm = GAIA_XY_M;
-		else if (dm == GAIA_XY_Z)
-		    dm = GAIA_XY_Z_M;
-	    }
-	  else if (line->DimensionModel == GAIA_XY_Z_M)
-	      dm = GAIA_XY_Z_M;
-	  line = line->Next;
-      }
-    polyg = geom->FirstPolygon;
-    while (polyg)
-      {
-	  /* counts how many polygons are there */
-	  n_polygons++;
-	  ring = polyg->Exterior;
-	  if (ring->DimensionModel == GAIA_XY_Z)
-	    {
-		if (dm == GAIA_XY)
-		    dm = GAIA_XY_Z;
-		else if (dm == GAIA_XY_M)
-		    dm = GAIA_XY_Z_M;
-	    }
-	  else if (ring->DimensionModel == GAIA_XY_M)
-	    {
-		if (dm == GAIA_XY)
-		    dm = GAIA_XY_M;
-		else if (dm == GAIA_XY_Z)
-		    dm = GAIA_XY_Z_M;
-	    }
-	  else if (ring->DimensionModel == GAIA_XY_Z_M)
-	      dm = GAIA_XY_Z_M;
-	  for (ib = 0; ib < polyg->NumInteriors; ib++)
-	    {
-		ring = polyg->Interiors + ib;
-		if (ring->DimensionModel == GAIA_XY_Z)
-		  {
-		      if (dm == GAIA_XY)
-			  dm = GAIA_XY_Z;
-		      else if (dm == GAIA_XY_M)
-			  dm = GAIA_XY_Z_M;
-		  }
-		else if (ring->DimensionModel == GAIA_XY_M)
-		  {
-		      if (dm == GAIA_XY)
-			  dm = GAIA_XY_M;
-		      else if (dm == GAIA_XY_Z)
-			  dm = GAIA_XY_Z_M;
-		  }
-		else if (ring->DimensionModel == GAIA_XY_Z_M)
-		    dm = GAIA_XY_Z_M;
-	    }
-	  polyg = polyg->Next;
-      }
+/* determines the Class given the elementary items count */
     if (n_points == 0 && n_linestrings == 0 && n_polygons == 0)
 	return GAIA_UNKNOWN;
     if (n_points == 1 && n_linestrings == 0 && n_polygons == 0)
       {
-	  if (geom->DeclaredType == GAIA_MULTIPOINT)
+	  if (declared_type == GAIA_MULTIPOINT)
 	    {
 		if (dm == GAIA_XY_Z)
 		    return GAIA_MULTIPOINTZ;
@@ -3039,7 +3275,7 @@ gaiaGeometryType (gaiaGeomCollPtr geom)
 		else
 		    return GAIA_MULTIPOINT;
 	    }
-	  else if (geom->DeclaredType == GAIA_GEOMETRYCOLLECTION)
+	  else if (declared_type == GAIA_GEOMETRYCOLLECTION)
 	    {
 		if (dm == GAIA_XY_Z)
 		    return GAIA_GEOMETRYCOLLECTIONZ;
@@ -3064,7 +3300,7 @@ gaiaGeometryType (gaiaGeomCollPtr geom)
       }
     if (n_points > 0 && n_linestrings == 0 && n_polygons == 0)
       {
-	  if (geom->DeclaredType == GAIA_GEOMETRYCOLLECTION)
+	  if (declared_type == GAIA_GEOMETRYCOLLECTION)
 	    {
 		if (dm == GAIA_XY_Z)
 		    return GAIA_GEOMETRYCOLLECTIONZ;
@@ -3089,7 +3325,7 @@ gaiaGeometryType (gaiaGeomCollPtr geom)
       }
     if (n_points == 0 && n_linestrings == 1 && n_polygons == 0)
       {
-	  if (geom->DeclaredType == GAIA_MULTILINESTRING)
+	  if (declared_type == GAIA_MULTILINESTRING)
 	    {
 		if (dm == GAIA_XY_Z)
 		    return GAIA_MULTILINESTRINGZ;
@@ -3100,7 +3336,7 @@ gaiaGeometryType (gaiaGeomCollPtr geom)
 		else
 		    return GAIA_MULTILINESTRING;
 	    }
-	  else if (geom->DeclaredType == GAIA_GEOMETRYCOLLECTION)
+	  else if (declared_type == GAIA_GEOMETRYCOLLECTION)
 	    {
 		if (dm == GAIA_XY_Z)
 		    return GAIA_GEOMETRYCOLLECTIONZ;
@@ -3125,7 +3361,7 @@ gaiaGeometryType (gaiaGeomCollPtr geom)
       }
     if (n_points == 0 && n_linestrings > 0 && n_polygons == 0)
       {
-	  if (geom->DeclaredType == GAIA_GEOMETRYCOLLECTION)
+	  if (declared_type == GAIA_GEOMETRYCOLLECTION)
 	    {
 		if (dm == GAIA_XY_Z)
 		    return GAIA_GEOMETRYCOLLECTIONZ;
@@ -3150,7 +3386,7 @@ gaiaGeometryType (gaiaGeomCollPtr geom)
       }
     if (n_points == 0 && n_linestrings == 0 && n_polygons == 1)
       {
-	  if (geom->DeclaredType == GAIA_MULTIPOLYGON)
+	  if (declared_type == GAIA_MULTIPOLYGON)
 	    {
 		if (dm == GAIA_XY_Z)
 		    return GAIA_MULTIPOLYGONZ;
@@ -3161,7 +3397,7 @@ gaiaGeometryType (gaiaGeomCollPtr geom)
 		else
 		    return GAIA_MULTIPOLYGON;
 	    }
-	  else if (geom->DeclaredType == GAIA_GEOMETRYCOLLECTION)
+	  else if (declared_type == GAIA_GEOMETRYCOLLECTION)
 	    {
 		if (dm == GAIA_XY_Z)
 		    return GAIA_GEOMETRYCOLLECTIONZ;
@@ -3186,7 +3422,7 @@ gaiaGeometryType (gaiaGeomCollPtr geom)
       }
     if (n_points == 0 && n_linestrings == 0 && n_polygons > 0)
       {
-	  if (geom->DeclaredType == GAIA_GEOMETRYCOLLECTION)
+	  if (declared_type == GAIA_GEOMETRYCOLLECTION)
 	    {
 		if (dm == GAIA_XY_Z)
 		    return GAIA_GEOMETRYCOLLECTIONZ;
@@ -3219,6 +3455,124 @@ gaiaGeometryType (gaiaGeomCollPtr geom)
 	return GAIA_GEOMETRYCOLLECTION;
 }
 
+GAIAGEO_DECLARE int
+gaiaGeometryType (gaiaGeomCollPtr geom)
+{
+/* determines the Class for this geometry */
+    gaiaPointPtr point;
+    gaiaLinestringPtr line;
+    gaiaPolygonPtr polyg;
+    gaiaRingPtr ring;
+    int ib;
+    int n_points = 0;
+    int n_linestrings = 0;
+    int n_polygons = 0;
+    int dm = GAIA_XY;
+    if (!geom)
+	return GAIA_UNKNOWN;
+    point = geom->FirstPoint;
+    while (point)
+      {
+	  /* counts how many points are there */
+	  n_points++;
+	  if (point->DimensionModel == GAIA_XY_Z)
+	    {
+		if (dm == GAIA_XY)
+		    dm = GAIA_XY_Z;
+		else if (dm == GAIA_XY_M)
+		    dm = GAIA_XY_Z_M;
+	    }
+	  else if (point->DimensionModel == GAIA_XY_M)
+	    {
+		if (dm == GAIA_XY)
+		    dm = GAIA_XY_M;
+		else if (dm == GAIA_XY_Z)
+		    dm = GAIA_XY_Z_M;
+	    }
+	  else if (point->DimensionModel == GAIA_XY_Z_M)
+	      dm = GAIA_XY_Z_M;
+	  point = point->Next;
+      }
+    line = geom->FirstLinestring;
+    while (line)
+      {
+	  /* counts how many linestrings are there */
+	  n_linestrings++;
+	  if (line->DimensionModel == GAIA_XY_Z)
+	    {
+		if (dm == GAIA_XY)
+		    dm = GAIA_XY_Z;
+		else if (dm == GAIA_XY_M)
+		    dm = GAIA_XY_Z_M;
+	    }
+	  else if (line->DimensionModel == GAIA_XY_M)
+	    {
+		if (dm == GAIA_XY)
+		    dm = GAIA_XY_M;
+		else if (dm == GAIA_XY_Z)
+		    dm = GAIA_XY_Z_M;
+	    }
+	  else if (line->DimensionModel == GAIA_XY_Z_M)
+	      dm = GAIA_XY_Z_M;
+	  line = line->Next;
+      }
+    polyg = geom->FirstPolygon;
+    while (polyg)
+      {
+	  /* counts how many polygons are there */
+	  n_polygons++;
+	  ring = polyg->Exterior;
+	  if (ring->DimensionModel == GAIA_XY_Z)
+	    {
+		if (dm == GAIA_XY)
+		    dm = GAIA_XY_Z;
+		else if (dm == GAIA_XY_M)
+		    dm = GAIA_XY_Z_M;
+	    }
+	  else if (ring->DimensionModel == GAIA_XY_M)
+	    {
+		if (dm == GAIA_XY)
+		    dm = GAIA_XY_M;
+		else if (dm == GAIA_XY_Z)
+		    dm = GAIA_XY_Z_M;
+	    }
+	  else if (ring->DimensionModel == GAIA_XY_Z_M)
+	      dm = GAIA_XY_Z_M;
+	  for (ib = 0; ib < polyg->NumInteriors; ib++)
+	    {
+		ring = polyg->Interiors + ib;
+		if (ring->DimensionModel == GAIA_XY_Z)
+		  {
+		      if (dm == GAIA_XY)
+			  dm = GAIA_XY_Z;
+		      else if (dm == GAIA_XY_M)
+			  dm = GAIA_XY_Z_M;
+		  }
+		else if (ring->DimensionModel == GAIA_XY_M)
+		  {
+		      if (dm == GAIA_XY)
+			  dm = GAIA_XY_M;
+		      else if (dm == GAIA_XY_Z)
+			  dm = GAIA_XY_Z_M;
+		  }
+		else if (ring->DimensionModel == GAIA_XY_Z_M)
+		    dm = GAIA_XY_Z_M;
+	    }
+	  polyg = polyg->Next;
+      }
+    return geometry_type_from_counts (n_points, n_linestrings, n_polygons,
+				      geom->DeclaredType, dm);
+}
+
+GAIAGEO_DECLARE int
+gaiaBlobViewGeometryType (gaiaBlobViewPtr view)
+{
+/* determines the Class for this BLOB-Geometry view */
+    return geometry_type_from_counts (view->NumPoints, view->NumLinestrings,
+				      view->NumPolygons, view->DeclaredType,
+				      view->DimensionModel);
+}
+
 GAIAGEO_DECLARE int
 gaiaGeometryAliasType (gaiaGeomCollPtr geom)
 {
@@ -123,6 +123,75 @@ splite_free_geos_cache_item_r (const void *p_cache,
     p->preparedGeosGeom = NULL;
 }
 
+static void
+splite_clear_geos_cache (struct splite_internal_cache *cache)
+{
+/* releasing all the prepared geometries held by the GEOS cache */
+    int i;
+    for (i = 0; i < cache->geosCacheSize; i++)
+      {
+	  struct splite_geos_cache_item *p = cache->geosCache + i;
+	  splite_free_geos_cache_item_r (cache, p);
+	  memset (p->gaiaBlob, '\0', 64);
+	  p->gaiaBlobSize = 0;
+	  p->hash = 0;
+	  p->lastUsed = 0;
+      }
+    for (i = 0; i < GEOS_CACHE_SEEN_SIZE; i++)
+      {
+	  cache->geosCacheSeen[i].hash = 0;
+	  cache->geosCacheSeen[i].gaiaBlobSize = 0;
+      }
+}
+
+SPATIALITE_PRIVATE void
+splite_reset_geos_cache (const void *p_cache)
+{
+/* resetting the GEOS cache and its hit/miss counters */
+    struct splite_internal_cache *cache =
+	(struct splite_internal_cache *) p_cache;
+    if (cache == NULL)
+	return;
+    if (cache->magic1 != SPATIALITE_CACHE_MAGIC1
+	|| cache->magic2 != SPATIALITE_CACHE_MAGIC2)
+	return;
+    splite_clear_geos_cache (cache);
+    cache->geosCacheTick = 0;
+    cache->geosCacheHits = 0;
+    cache->geosCacheMisses = 0;
+}
+
+SPATIALITE_PRIVATE int
+splite_set_geos_cache_size (const void *p_cache, int size)
+{
+/* 
+/ changing the max number of prepared geometries held by the GEOS cache
+/ (any currently cached geometry will be released)
+*/
+    struct splite_geos_cache_item *items;
+    struct splite_internal_cache *cache =
+	(struct splite_internal_cache *) p_cache;
+    if (cache == NULL)
+	return 0;
+    if (cache->magic1 != SPATIALITE_CACHE_MAGIC1
+	|| cache->magic2 != SPATIALITE_CACHE_MAGIC2)
+	return 0;
+    if (size < 1)
+	size = 1;
+    if (size > GEOS_CACHE_MAX_SIZE)
+	size = GEOS_CACHE_MAX_SIZE;
+    splite_clear_geos_cache (cache);
+    items =
+	realloc (cache->geosCache,
+		 sizeof (struct splite_geos_cache_item) * size);
+    if (items == NULL)
+	return 0;
+    memset (items, 0, sizeof (struct splite_geos_cache_item) * size);
+    cache->geosCache = items;
+    cache->geosCacheSize = size;
+    return 1;
+}
+
 GAIAGEO_DECLARE void
 gaiaResetGeosMsg ()
 {
@@ -355,8 +424,34 @@ splite_mbr_equals (gaiaGeomCollPtr g1, gaiaGeomCollPtr g2)
     return 1;
 }
 
+static sqlite3_uint64
+geosCacheHash (const unsigned char *blob, int size)
+{
+/* computing a 64 bit hash of the whole BLOB, 8 bytes at each step */
+    sqlite3_uint64 h = 0x9E3779B97F4A7C15ULL ^ (sqlite3_uint64) size;
+    sqlite3_uint64 w;
+    int i;
+    for (i = 0; i + 8 <= size; i += 8)
+      {
+	  memcpy (&w, blob + i, 8);
+	  h ^= w * 0x87C37B91114253D5ULL;
+	  h = (h << 27) | (h >> 37);
+	  h = (h * 5) + 0x52DCE729ULL;
+      }
+    w = 0;
+    memcpy (&w, blob + i, size - i);
+    h ^= w * 0x4CF5AD432745937FULL;
+/* final avalanche */
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
 static int
-evalGeosCacheItem (unsigned char *blob, int blob_size, uLong crc,
+evalGeosCacheItem (unsigned char *blob, int blob_size, sqlite3_uint64 hash,
 		   struct splite_geos_cache_item *p)
 {
 /* evaluting if this one could be a valid cache hit */
@@ -365,9 +460,9 @@ evalGeosCacheItem (unsigned char *blob, int blob_size, uLong crc,
 	  /* surely not a match; different size */
 	  return 0;
       }
-    if (crc != p->crc32)
+    if (hash != p->hash)
       {
-	  /* surely not a match: different CRC32 */
+	  /* surely not a match: different hash */
 	  return 0;
       }
 
@@ -379,6 +474,75 @@ evalGeosCacheItem (unsigned char *blob, int blob_size, uLong crc,
     return 0;
 }
 
+static struct splite_geos_cache_item *
+findGeosCacheItem (struct splite_internal_cache *cache, unsigned char *blob,
+		   int blob_size, sqlite3_uint64 hash)
+{
+/* searching the GEOS cache for a matching item */
+    int i;
+    for (i = 0; i < cache->geosCacheSize; i++)
+      {
+	  struct splite_geos_cache_item *p = cache->geosCache + i;
+	  if (evalGeosCacheItem (blob, blob_size, hash, p))
+	      return p;
+      }
+    return NULL;
+}
+
+static int
+checkGeosCacheSeen (struct splite_internal_cache *cache, int blob_size,
+		    sqlite3_uint64 hash)
+{
+/* 
+/ checking if this BLOB was already seen before; if not
+/ it will be registered, so to be promoted next time
+*/
+    struct splite_geos_cache_seen *p =
+	cache->geosCacheSeen + (hash % GEOS_CACHE_SEEN_SIZE);
+    if (p->hash == hash && p->gaiaBlobSize == blob_size)
+	return 1;
+    p->hash = hash;
+    p->gaiaBlobSize = blob_size;
+    return 0;
+}
+
+static GEOSPreparedGeometry *
+promoteGeosCacheItem (struct splite_internal_cache *cache, gaiaGeomCollPtr geom,
+		      unsigned char *blob, int blob_size, sqlite3_uint64 hash)
+{
+/* 
+/ inserting a Prepared Geometry into the GEOS cache
+/ the least recently used item will be evicted
+*/
+    int i;
+    struct splite_geos_cache_item *p = cache->geosCache;
+    GEOSContextHandle_t handle = cache->GEOS_handle;
+    for (i = 1; i < cache->geosCacheSize; i++)
+      {
+	  struct splite_geos_cache_item *pi = cache->geosCache + i;
+	  if (pi->lastUsed < p->lastUsed)
+	      p = pi;
+      }
+    splite_free_geos_cache_item_r (cache, p);
+    memcpy (p->gaiaBlob, blob, 46);
+    p->gaiaBlobSize = blob_size;
+    p->hash = hash;
+    p->lastUsed = ++(cache->geosCacheTick);
+/* preparing the GeosGeometries */
+    p->geosGeom = gaiaToGeos_r (cache, geom);
+    if (p->geosGeom)
+      {
+	  p->preparedGeosGeom = (void *) GEOSPrepare_r (handle, p->geosGeom);
+	  if (p->preparedGeosGeom == NULL)
+	    {
+		/* unexpected failure */
+		GEOSGeom_destroy_r (handle, p->geosGeom);
+		p->geosGeom = NULL;
+	    }
+      }
+    return p->preparedGeosGeom;
+}
+
 static int
 sniffTinyPointBlob (const unsigned char *blob, const int size)
 {
@@ -530,11 +694,17 @@ evalGeosCache (struct splite_internal_cache *cache, gaiaGeomCollPtr geom1,
 	       const int size2, GEOSPreparedGeometry ** gPrep,
 	       gaiaGeomCollPtr * geom)
 {
-/* handling the internal GEOS cache */
-    struct splite_geos_cache_item *p1 = &(cache->cacheItem1);
-    struct splite_geos_cache_item *p2 = &(cache->cacheItem2);
-    uLong crc1;
-    uLong crc2;
+/* 
+/ handling the internal GEOS cache
+/
+/ the cache is an LRU of Prepared Geometries, keyed by a hash
+/ of the whole BLOB; a geometry is only prepared the second time
+/ it is seen, so that single-use geometries (e.g. the points of
+/ a spatial join) will never evict the reused ones
+*/
+    struct splite_geos_cache_item *p;
+    sqlite3_uint64 hash1;
+    sqlite3_uint64 hash2;
     unsigned char *tiny1 = NULL;
     unsigned char *tiny2 = NULL;
     unsigned char *p_blob1;
@@ -542,8 +712,13 @@ evalGeosCache (struct splite_internal_cache *cache, gaiaGeomCollPtr geom1,
     int sz1;
     int sz2;
     int tiny_sz;
+    int seen1;
+    int seen2;
+    int failed1 = 0;
+    int failed2 = 0;
     int retcode;
     GEOSContextHandle_t handle = NULL;
+    GEOSPreparedGeometry *prepared;
     if (cache == NULL)
 	return 0;
     if (cache->magic1 != SPATIALITE_CACHE_MAGIC1
@@ -552,6 +727,11 @@ evalGeosCache (struct splite_internal_cache *cache, gaiaGeomCollPtr geom1,
     handle = cache->GEOS_handle;
     if (handle == NULL)
 	return 0;
+    if (cache->geosCache == NULL)
+      {
+	  if (!splite_set_geos_cache_size (cache, GEOS_CACHE_DEFAULT_SIZE))
+	      return 0;
+      }
 
     if (sniffTinyPointBlob (blob1, size1))
       {
@@ -575,94 +755,65 @@ evalGeosCache (struct splite_internal_cache *cache, gaiaGeomCollPtr geom1,
 	  p_blob2 = (unsigned char *) blob2;
 	  sz2 = size2;
       }
-    crc1 = crc32 (0L, p_blob1, sz1);
-    crc2 = crc32 (0L, p_blob2, sz2);
+    hash1 = geosCacheHash (p_blob1, sz1);
+    hash2 = geosCacheHash (p_blob2, sz2);
 
-/* checking the first cache item */
-    if (evalGeosCacheItem (p_blob1, sz1, crc1, p1))
+/* checking the first geometry */
+    p = findGeosCacheItem (cache, p_blob1, sz1, hash1);
+    if (p != NULL && p->preparedGeosGeom != NULL)
       {
-	  /* found a matching item */
-	  if (p1->preparedGeosGeom == NULL)
-	    {
-		/* preparing the GeosGeometries */
-		p1->geosGeom = gaiaToGeos_r (cache, geom1);
-		if (p1->geosGeom)
-		  {
-		      p1->preparedGeosGeom =
-			  (void *) GEOSPrepare_r (handle, p1->geosGeom);
-		      if (p1->preparedGeosGeom == NULL)
-			{
-			    /* unexpected failure */
-			    GEOSGeom_destroy_r (handle, p1->geosGeom);
-			    p1->geosGeom = NULL;
-			}
-		  }
-	    }
-	  if (p1->preparedGeosGeom)
+	  /* cache hit: returning the corresponding GeosPreparedGeometry */
+	  p->lastUsed = ++(cache->geosCacheTick);
+	  cache->geosCacheHits += 1;
+	  *gPrep = p->preparedGeosGeom;
+	  *geom = geom2;
+	  retcode = 1;
+	  goto end;
+      }
+    if (p != NULL)
+	failed1 = 1;		/* GEOS already failed preparing this one */
+
+/* checking the second geometry */
+    p = findGeosCacheItem (cache, p_blob2, sz2, hash2);
+    if (p != NULL && p->preparedGeosGeom != NULL)
+      {
+	  /* cache hit: returning the corresponding GeosPreparedGeometry */
+	  p->lastUsed = ++(cache->geosCacheTick);
+	  cache->geosCacheHits += 1;
+	  *gPrep = p->preparedGeosGeom;
+	  *geom = geom1;
+	  retcode = 1;
+	  goto end;
+      }
+    if (p != NULL)
+	failed2 = 1;		/* GEOS already failed preparing this one */
+
+/* cache miss: promoting a geometry already seen before (if any) */
+    cache->geosCacheMisses += 1;
+    seen1 = checkGeosCacheSeen (cache, sz1, hash1);
+    seen2 = checkGeosCacheSeen (cache, sz2, hash2);
+    if (seen1 && !failed1)
+      {
+	  prepared = promoteGeosCacheItem (cache, geom1, p_blob1, sz1, hash1);
+	  if (prepared)
 	    {
-		/* returning the corresponding GeosPreparedGeometry */
-		*gPrep = p1->preparedGeosGeom;
+		*gPrep = prepared;
 		*geom = geom2;
 		retcode = 1;
 		goto end;
 	    }
-	  retcode = 0;
-	  goto end;
       }
-
-/* checking the second cache item */
-    if (evalGeosCacheItem (p_blob2, sz2, crc2, p2))
+    if (seen2 && !failed2)
       {
-	  /* found a matching item */
-	  if (p2->preparedGeosGeom == NULL)
+	  prepared = promoteGeosCacheItem (cache, geom2, p_blob2, sz2, hash2);
+	  if (prepared)
 	    {
-		/* preparing the GeosGeometries */
-		p2->geosGeom = gaiaToGeos_r (cache, geom2);
-		if (p2->geosGeom)
-		  {
-		      p2->preparedGeosGeom =
-			  (void *) GEOSPrepare_r (handle, p2->geosGeom);
-		      if (p2->preparedGeosGeom == NULL)
-			{
-			    /* unexpected failure */
-			    GEOSGeom_destroy_r (handle, p2->geosGeom);
-			    p2->geosGeom = NULL;
-			}
-		  }
-	    }
-	  if (p2->preparedGeosGeom)
-	    {
-		/* returning the corresponding GeosPreparedGeometry */
-		*gPrep = p2->preparedGeosGeom;
+		*gPrep = prepared;
 		*geom = geom1;
 		retcode = 1;
 		goto end;
 	    }
-	  retcode = 0;
-	  goto end;
       }
-
-/* updating the GEOS cache item#1 */
-    memcpy (p1->gaiaBlob, p_blob1, 46);
-    p1->gaiaBlobSize = sz1;
-    p1->crc32 = crc1;
-    if (p1->preparedGeosGeom)
-	GEOSPreparedGeom_destroy_r (handle, p1->preparedGeosGeom);
-    if (p1->geosGeom)
-	GEOSGeom_destroy_r (handle, p1->geosGeom);
-    p1->geosGeom = NULL;
-    p1->preparedGeosGeom = NULL;
-
-/* updating the GEOS cache item#2 */
-    memcpy (p2->gaiaBlob, p_blob2, 46);
-    p2->gaiaBlobSize = sz2;
-    p2->crc32 = crc2;
-    if (p2->preparedGeosGeom)
-	GEOSPreparedGeom_destroy_r (handle, p2->preparedGeosGeom);
-    if (p2->geosGeom)
-	GEOSGeom_destroy_r (handle, p2->geosGeom);
-    p2->geosGeom = NULL;
-    p2->preparedGeosGeom = NULL;
     retcode = 0;
 
   end:
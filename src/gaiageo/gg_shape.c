@@ -51,6 +51,11 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <float.h>
 #include <errno.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #if defined(_WIN32) && !defined(__MINGW32__)
 #include "config-msvc.h"
 #else
@@ -83,6 +88,7 @@ extern const char *locale_charset (void);
 #include <spatialite/sqlite.h>
 
 #include <spatialite/gaiageo.h>
+#include <spatialite_private.h>
 #include <spatialite/debug.h>
 
 #ifdef _WIN32
@@ -2623,6 +2629,718 @@ gaiaReadShpEntity_ex (gaiaShapefilePtr shp, int current_row, int srid,
     return 0;
 }
 
+#ifndef _WIN32
+static int
+shp_map_file (FILE * fl, const unsigned char **addr, size_t *size)
+{
+/* memory mapping a whole (read-only) file */
+    struct stat st;
+    void *map;
+    int fd = fileno (fl);
+    if (fd < 0)
+	return 0;
+    if (fstat (fd, &st) != 0)
+	return 0;
+    if (st.st_size <= 0)
+	return 0;
+    map = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+	return 0;
+    *addr = map;
+    *size = (size_t) st.st_size;
+    return 1;
+}
+
+static int
+shp_mapped_headers_ok (struct splite_shp_mapping *mapping, int endian_arch)
+{
+/*
+/ checking the mapped sizes against the file lengths declared by the
+/ SHP, SHX and DBF headers: a truncated file must never be accessed
+/ through its mapping, because touching any page beyond its actual
+/ end would raise a SIGBUS
+*/
+    size_t len;
+    size_t records;
+    size_t hdsz;
+    size_t reclen;
+    if (mapping->shp_size < 100 || mapping->shx_size < 100
+	|| mapping->dbf_size < 32)
+	return 0;
+    if (gaiaImport32 (mapping->shp, GAIA_BIG_ENDIAN, endian_arch) != 9994)
+	return 0;
+    len =
+	(size_t) gaiaImport32 (mapping->shp + 24, GAIA_BIG_ENDIAN,
+			       endian_arch) * 2;
+    if (len > mapping->shp_size)
+	return 0;
+    if (gaiaImport32 (mapping->shx, GAIA_BIG_ENDIAN, endian_arch) != 9994)
+	return 0;
+    len =
+	(size_t) gaiaImport32 (mapping->shx + 24, GAIA_BIG_ENDIAN,
+			       endian_arch) * 2;
+    if (len > mapping->shx_size)
+	return 0;
+    records =
+	(size_t) (unsigned int) gaiaImport32 (mapping->dbf + 4,
+					      GAIA_LITTLE_ENDIAN,
+					      endian_arch);
+    hdsz =
+	(size_t) (unsigned short) gaiaImport16 (mapping->dbf + 8,
+						GAIA_LITTLE_ENDIAN,
+						endian_arch);
+    reclen =
+	(size_t) (unsigned short) gaiaImport16 (mapping->dbf + 10,
+						GAIA_LITTLE_ENDIAN,
+						endian_arch);
+    if (hdsz + (records * reclen) > mapping->dbf_size)
+	return 0;
+    return 1;
+}
+
+static int
+shp_file_shrunk (FILE * fl, size_t size)
+{
+/* checking if a mapped file is now shorter than its mapping */
+    struct stat st;
+    int fd = fileno (fl);
+    if (fd < 0 || fstat (fd, &st) != 0)
+	return 1;
+    return ((size_t) st.st_size < size);
+}
+#endif
+
+SPATIALITE_PRIVATE int
+splite_map_shapefile (void *p_shp, struct splite_shp_mapping *mapping)
+{
+/* 
+/ memory mapping the SHP, SHX and DBF files of an already opened Shapefile
+/ returns 0 if mapping isn't possible; the caller is then expected to
+/ keep on using the plain (stdio based) reader
+*/
+    gaiaShapefilePtr shp = (gaiaShapefilePtr) p_shp;
+    memset (mapping, 0, sizeof (struct splite_shp_mapping));
+#ifdef _WIN32
+    if (shp)
+	shp = shp;		/* unused arg warning suppression */
+    return 0;
+#else
+    if (shp == NULL || !(shp->Valid) || shp->ReadOnly == 0)
+	return 0;
+    if (!shp_map_file (shp->flShp, &(mapping->shp), &(mapping->shp_size)))
+	goto error;
+    if (!shp_map_file (shp->flShx, &(mapping->shx), &(mapping->shx_size)))
+	goto error;
+    if (!shp_map_file (shp->flDbf, &(mapping->dbf), &(mapping->dbf_size)))
+	goto error;
+    if (!shp_mapped_headers_ok (mapping, shp->endian_arch))
+	goto error;
+#ifdef MADV_SEQUENTIAL
+    madvise ((void *) (mapping->shp), mapping->shp_size, MADV_SEQUENTIAL);
+    madvise ((void *) (mapping->dbf), mapping->dbf_size, MADV_SEQUENTIAL);
+#endif
+    return 1;
+  error:
+    splite_unmap_shapefile (mapping);
+    return 0;
+#endif
+}
+
+SPATIALITE_PRIVATE void
+splite_check_mapped_shapefile (void *p_shp,
+			       struct splite_shp_mapping *mapping)
+{
+/*
+/ checking (before starting a new scan) that none of the mapped files
+/ has been truncated meanwhile by some other process; if so, the
+/ mapping is released and the plain reader will then be used
+*/
+#ifdef _WIN32
+    if (p_shp)
+	p_shp = p_shp;		/* unused arg warning suppression */
+    if (mapping)
+	mapping = mapping;	/* unused arg warning suppression */
+#else
+    gaiaShapefilePtr shp = (gaiaShapefilePtr) p_shp;
+    if (shp == NULL || mapping->shp == NULL)
+	return;
+    if (shp_file_shrunk (shp->flShp, mapping->shp_size)
+	|| shp_file_shrunk (shp->flShx, mapping->shx_size)
+	|| shp_file_shrunk (shp->flDbf, mapping->dbf_size))
+	splite_unmap_shapefile (mapping);
+#endif
+}
+
+SPATIALITE_PRIVATE void
+splite_unmap_shapefile (struct splite_shp_mapping *mapping)
+{
+/* releasing a memory mapped Shapefile */
+#ifndef _WIN32
+    if (mapping->shp != NULL)
+	munmap ((void *) (mapping->shp), mapping->shp_size);
+    if (mapping->shx != NULL)
+	munmap ((void *) (mapping->shx), mapping->shx_size);
+    if (mapping->dbf != NULL)
+	munmap ((void *) (mapping->dbf), mapping->dbf_size);
+#endif
+    memset (mapping, 0, sizeof (struct splite_shp_mapping));
+}
+
+struct shp_mapped_record
+{
+/* a SHP record directly addressed into the memory mapped file */
+    int shape;			/* the SHP shape type */
+    int n_parts;		/* # parts (Linestrings or Rings) */
+    int n_points;		/* # points */
+    const unsigned char *parts;	/* parts array */
+    const unsigned char *xy;	/* XY points array */
+    const unsigned char *z;	/* Z values array (may be NULL) */
+    const unsigned char *m;	/* M values array (may be NULL) */
+    int check_m;		/* M below NO_DATA should be reset to 0.0 */
+    int dims;			/* the output Dimension Model */
+    int endian_arch;
+};
+
+static void
+shp_mapped_vertex (struct shp_mapped_record *rec, int iv, double *x,
+		   double *y, double *z, double *m)
+{
+/* fetching a vertex from a mapped SHP record */
+    *x = gaiaImport64 (rec->xy + (iv * 16), GAIA_LITTLE_ENDIAN,
+		       rec->endian_arch);
+    *y = gaiaImport64 (rec->xy + (iv * 16) + 8, GAIA_LITTLE_ENDIAN,
+		       rec->endian_arch);
+    if (rec->z != NULL)
+	*z = gaiaImport64 (rec->z + (iv * 8), GAIA_LITTLE_ENDIAN,
+			   rec->endian_arch);
+    else
+	*z = 0.0;
+    if (rec->m != NULL)
+      {
+	  *m = gaiaImport64 (rec->m + (iv * 8), GAIA_LITTLE_ENDIAN,
+			     rec->endian_arch);
+	  if (rec->check_m && *m < SHAPEFILE_NO_DATA)
+	      *m = 0.0;
+      }
+    else
+	*m = 0.0;
+}
+
+static int
+shp_mapped_coord_size (int dims)
+{
+/* size of a single BLOB vertex */
+    if (dims == GAIA_XY_Z || dims == GAIA_XY_M)
+	return 24;
+    if (dims == GAIA_XY_Z_M)
+	return 32;
+    return 16;
+}
+
+static int
+shp_mapped_class (int type, int dims)
+{
+/* the BLOB class type for a given Dimension Model */
+    if (dims == GAIA_XY_Z)
+	return type + 1000;
+    if (dims == GAIA_XY_M)
+	return type + 2000;
+    if (dims == GAIA_XY_Z_M)
+	return type + 3000;
+    return type;
+}
+
+static unsigned char *
+shp_mapped_points (struct shp_mapped_record *rec, unsigned char *ptr,
+		   int start, int end, double *mbr)
+{
+/* 
+/ exporting a range of vertices into the BLOB, updating the MBR
+/ the XY case is a plain memcpy, SHP and BLOB sharing the same layout
+*/
+    int iv;
+    double x;
+    double y;
+    double z;
+    double m;
+    if (rec->dims == GAIA_XY)
+      {
+	  memcpy (ptr, rec->xy + (start * 16), (end - start) * 16);
+	  for (iv = start; iv < end; iv++)
+	    {
+		x = gaiaImport64 (rec->xy + (iv * 16), GAIA_LITTLE_ENDIAN,
+				  rec->endian_arch);
+		y = gaiaImport64 (rec->xy + (iv * 16) + 8, GAIA_LITTLE_ENDIAN,
+				  rec->endian_arch);
+		if (x < mbr[0])
+		    mbr[0] = x;
+		if (y < mbr[1])
+		    mbr[1] = y;
+		if (x > mbr[2])
+		    mbr[2] = x;
+		if (y > mbr[3])
+		    mbr[3] = y;
+	    }
+	  return ptr + ((end - start) * 16);
+      }
+    for (iv = start; iv < end; iv++)
+      {
+	  shp_mapped_vertex (rec, iv, &x, &y, &z, &m);
+	  if (x < mbr[0])
+	      mbr[0] = x;
+	  if (y < mbr[1])
+	      mbr[1] = y;
+	  if (x > mbr[2])
+	      mbr[2] = x;
+	  if (y > mbr[3])
+	      mbr[3] = y;
+	  gaiaExport64 (ptr, x, 1, rec->endian_arch);
+	  gaiaExport64 (ptr + 8, y, 1, rec->endian_arch);
+	  ptr += 16;
+	  if (rec->dims == GAIA_XY_Z || rec->dims == GAIA_XY_Z_M)
+	    {
+		gaiaExport64 (ptr, z, 1, rec->endian_arch);
+		ptr += 8;
+	    }
+	  if (rec->dims == GAIA_XY_M || rec->dims == GAIA_XY_Z_M)
+	    {
+		gaiaExport64 (ptr, m, 1, rec->endian_arch);
+		ptr += 8;
+	    }
+      }
+    return ptr;
+}
+
+static int
+shp_mapped_part_end (struct shp_mapped_record *rec, int ind)
+{
+/* returns the (exclusive) last vertex of some part */
+    if (ind < (rec->n_parts - 1))
+	return gaiaImport32 (rec->parts + ((ind + 1) * 4), GAIA_LITTLE_ENDIAN,
+			     rec->endian_arch);
+    return rec->n_points;
+}
+
+static int
+shp_mapped_ring_clockwise (struct shp_mapped_record *rec, int start, int end)
+{
+/* same as gaiaClockwise(), directly evaluated on the SHP vertices */
+    int ind;
+    int ix;
+    int points = end - start;
+    double xx;
+    double yy;
+    double x;
+    double y;
+    double area = 0.0;
+    for (ind = 0; ind < points; ind++)
+      {
+	  xx = gaiaImport64 (rec->xy + ((start + ind) * 16),
+			     GAIA_LITTLE_ENDIAN, rec->endian_arch);
+	  yy = gaiaImport64 (rec->xy + ((start + ind) * 16) + 8,
+			     GAIA_LITTLE_ENDIAN, rec->endian_arch);
+	  ix = (ind + 1) % points;
+	  x = gaiaImport64 (rec->xy + ((start + ix) * 16), GAIA_LITTLE_ENDIAN,
+			    rec->endian_arch);
+	  y = gaiaImport64 (rec->xy + ((start + ix) * 16) + 8,
+			    GAIA_LITTLE_ENDIAN, rec->endian_arch);
+	  area += ((xx * y) - (x * yy));
+      }
+    area /= 2.0;
+    if (area >= 0.0)
+	return 0;
+    return 1;
+}
+
+static int
+shp_mapped_parse (const unsigned char *buf, int size,
+		  struct shp_mapped_record *rec)
+{
+/* 
+/ validating a mapped SHP record and locating its arrays
+/ returns 0 for anything not strictly well-formed
+*/
+    sqlite3_int64 base;
+    sqlite3_int64 min_size;
+    sqlite3_int64 max_size;
+    int ind;
+    int start;
+    int end;
+    rec->n_parts = 0;
+    rec->n_points = 0;
+    rec->parts = NULL;
+    rec->xy = NULL;
+    rec->z = NULL;
+    rec->m = NULL;
+    rec->check_m = 1;
+    switch (rec->shape)
+      {
+      case GAIA_SHP_POINT:
+	  if (size < 20)
+	      return 0;
+	  rec->n_points = 1;
+	  rec->xy = buf + 4;
+	  return 1;
+      case GAIA_SHP_POINTZ:
+	  if (size < 36)
+	      return 0;
+	  rec->n_points = 1;
+	  rec->xy = buf + 4;
+	  rec->z = buf + 20;
+	  rec->m = buf + 28;
+	  rec->check_m = 0;
+	  return 1;
+      case GAIA_SHP_POINTM:
+	  if (size < 28)
+	      return 0;
+	  rec->n_points = 1;
+	  rec->xy = buf + 4;
+	  rec->m = buf + 20;
+	  rec->check_m = 0;
+	  return 1;
+      case GAIA_SHP_MULTIPOINT:
+      case GAIA_SHP_MULTIPOINTZ:
+      case GAIA_SHP_MULTIPOINTM:
+	  if (size < 40)
+	      return 0;
+	  rec->n_points =
+	      gaiaImport32 (buf + 36, GAIA_LITTLE_ENDIAN, rec->endian_arch);
+	  if (rec->n_points <= 0)
+	      return 0;
+	  base = 40;
+	  break;
+      case GAIA_SHP_POLYLINE:
+      case GAIA_SHP_POLYLINEZ:
+      case GAIA_SHP_POLYLINEM:
+      case GAIA_SHP_POLYGON:
+      case GAIA_SHP_POLYGONZ:
+	  if (size < 44)
+	      return 0;
+	  rec->n_parts =
+	      gaiaImport32 (buf + 36, GAIA_LITTLE_ENDIAN, rec->endian_arch);
+	  rec->n_points =
+	      gaiaImport32 (buf + 40, GAIA_LITTLE_ENDIAN, rec->endian_arch);
+	  if (rec->n_parts <= 0 || rec->n_points <= 0)
+	      return 0;
+	  if (rec->n_parts > (size - 44) / 4)
+	      return 0;
+	  rec->parts = buf + 44;
+	  base = 44 + ((sqlite3_int64) (rec->n_parts) * 4);
+	  break;
+      default:
+	  /* POLYGONM is left to gaiaReadShpEntity_ex() */
+	  return 0;
+      };
+    if (rec->n_points > (size - base) / 16)
+	return 0;
+    rec->xy = buf + base;
+    min_size = base + ((sqlite3_int64) (rec->n_points) * 16);
+    switch (rec->shape)
+      {
+      case GAIA_SHP_MULTIPOINTZ:
+      case GAIA_SHP_POLYLINEZ:
+      case GAIA_SHP_POLYGONZ:
+	  min_size += 16 + ((sqlite3_int64) (rec->n_points) * 8);
+	  if (size < min_size)
+	      return 0;
+	  rec->z = buf + min_size - ((sqlite3_int64) (rec->n_points) * 8);
+	  max_size = min_size + 16 + ((sqlite3_int64) (rec->n_points) * 8);
+	  if (size == max_size)
+	      rec->m = buf + max_size - ((sqlite3_int64) (rec->n_points) * 8);
+	  break;
+      case GAIA_SHP_MULTIPOINTM:
+      case GAIA_SHP_POLYLINEM:
+	  max_size = min_size + 16 + ((sqlite3_int64) (rec->n_points) * 8);
+	  if (size == max_size)
+	      rec->m = buf + max_size - ((sqlite3_int64) (rec->n_points) * 8);
+	  break;
+      };
+    if (rec->parts != NULL)
+      {
+	  /* checking the parts array; empty parts are left to the plain reader */
+	  start = 0;
+	  for (ind = 0; ind < rec->n_parts; ind++)
+	    {
+		end = shp_mapped_part_end (rec, ind);
+		if (end <= start || end > rec->n_points)
+		    return 0;
+		start = end;
+	    }
+      }
+    return 1;
+}
+
+static int
+shp_mapped_to_blob (gaiaShapefilePtr shp, struct shp_mapped_record *rec,
+		    int srid, unsigned char **blob, int *blob_size)
+{
+/* 
+/ directly encoding a mapped SHP record as a SpatiaLite BLOB
+/ the output is exactly the same produced by gaiaToSpatiaLiteBlobWkb()
+/ on the Geometry returned by gaiaReadShpEntity_ex()
+/ returns 0 if the record requires the plain reader
+*/
+    int type;
+    int entity_type = 0;
+    int entities;
+    int coord_size = shp_mapped_coord_size (rec->dims);
+    int ind;
+    int start;
+    int end;
+    int is_multi;
+    sqlite3_int64 size;
+    unsigned char *ptr;
+    double mbr[4];
+    switch (rec->shape)
+      {
+      case GAIA_SHP_POINT:
+      case GAIA_SHP_POINTZ:
+      case GAIA_SHP_POINTM:
+	  type = GAIA_POINT;
+	  entities = 1;
+	  is_multi = 0;
+	  size = 44 + coord_size;
+	  break;
+      case GAIA_SHP_MULTIPOINT:
+      case GAIA_SHP_MULTIPOINTZ:
+      case GAIA_SHP_MULTIPOINTM:
+	  type = GAIA_MULTIPOINT;
+	  entity_type = GAIA_POINT;
+	  entities = rec->n_points;
+	  is_multi = 1;
+	  size = 48 + ((sqlite3_int64) entities * (5 + coord_size));
+	  break;
+      case GAIA_SHP_POLYLINE:
+      case GAIA_SHP_POLYLINEZ:
+      case GAIA_SHP_POLYLINEM:
+	  entities = rec->n_parts;
+	  if (entities == 1 && shp->EffectiveType == GAIA_LINESTRING)
+	    {
+		type = GAIA_LINESTRING;
+		is_multi = 0;
+		size = 48 + ((sqlite3_int64) (rec->n_points) * coord_size);
+	    }
+	  else
+	    {
+		type = GAIA_MULTILINESTRING;
+		entity_type = GAIA_LINESTRING;
+		is_multi = 1;
+		size = 48 + ((sqlite3_int64) entities * 9) +
+		    ((sqlite3_int64) (rec->n_points) * coord_size);
+	    }
+	  break;
+      case GAIA_SHP_POLYGON:
+      case GAIA_SHP_POLYGONZ:
+	  /* 
+	     / interior Rings have to be associated to the containing exterior
+	     / Ring by shp_arrange_rings(); only Polygons made by a single Ring
+	     / or by exterior Rings alone can be directly encoded
+	   */
+	  entities = rec->n_parts;
+	  if (entities > 1)
+	    {
+		start = 0;
+		for (ind = 0; ind < entities; ind++)
+		  {
+		      end = shp_mapped_part_end (rec, ind);
+		      if (!shp_mapped_ring_clockwise (rec, start, end))
+			  return 0;
+		      start = end;
+		  }
+	    }
+	  if (entities == 1 && shp->EffectiveType == GAIA_POLYGON)
+	    {
+		type = GAIA_POLYGON;
+		is_multi = 0;
+		size = 52 + ((sqlite3_int64) (rec->n_points) * coord_size);
+	    }
+	  else
+	    {
+		type = GAIA_MULTIPOLYGON;
+		entity_type = GAIA_POLYGON;
+		is_multi = 1;
+		size = 48 + ((sqlite3_int64) entities * 13) +
+		    ((sqlite3_int64) (rec->n_points) * coord_size);
+	    }
+	  break;
+      default:
+	  return 0;
+      };
+    if (size > 0x7fffffff)
+	return 0;
+    *blob = malloc ((size_t) size);
+    *blob_size = (int) size;
+    ptr = *blob;
+    mbr[0] = DBL_MAX;
+    mbr[1] = DBL_MAX;
+    mbr[2] = -DBL_MAX;
+    mbr[3] = -DBL_MAX;
+    *ptr = GAIA_MARK_START;	/* START signature */
+    *(ptr + 1) = GAIA_LITTLE_ENDIAN;	/* byte ordering */
+    gaiaExport32 (ptr + 2, srid, 1, rec->endian_arch);	/* the SRID */
+    *(ptr + 38) = GAIA_MARK_MBR;	/* MBR signature */
+    gaiaExport32 (ptr + 39, shp_mapped_class (type, rec->dims), 1, rec->endian_arch);	/* class type */
+    ptr += 43;
+    if (is_multi)
+      {
+	  gaiaExport32 (ptr, entities, 1, rec->endian_arch);	/* # entities */
+	  ptr += 4;
+      }
+    start = 0;
+    for (ind = 0; ind < entities; ind++)
+      {
+	  if (is_multi)
+	    {
+		*ptr = GAIA_MARK_ENTITY;	/* ENTITY signature */
+		gaiaExport32 (ptr + 1,
+			      shp_mapped_class (entity_type, rec->dims), 1,
+			      rec->endian_arch);	/* entity class type */
+		ptr += 5;
+	    }
+	  if (type == GAIA_POINT || type == GAIA_MULTIPOINT)
+	    {
+		ptr = shp_mapped_points (rec, ptr, ind, ind + 1, mbr);
+		continue;
+	    }
+	  end = shp_mapped_part_end (rec, ind);
+	  if (type == GAIA_POLYGON || type == GAIA_MULTIPOLYGON)
+	    {
+		gaiaExport32 (ptr, 1, 1, rec->endian_arch);	/* # rings */
+		ptr += 4;
+	    }
+	  gaiaExport32 (ptr, end - start, 1, rec->endian_arch);	/* # points */
+	  ptr += 4;
+	  ptr = shp_mapped_points (rec, ptr, start, end, mbr);
+	  start = end;
+      }
+    *ptr = GAIA_MARK_END;	/* END signature */
+    ptr = *blob;
+    gaiaExport64 (ptr + 6, mbr[0], 1, rec->endian_arch);	/* MBR - minimum X */
+    gaiaExport64 (ptr + 14, mbr[1], 1, rec->endian_arch);	/* MBR - minimum Y */
+    gaiaExport64 (ptr + 22, mbr[2], 1, rec->endian_arch);	/* MBR - maximum X */
+    gaiaExport64 (ptr + 30, mbr[3], 1, rec->endian_arch);	/* MBR - maximum Y */
+    return 1;
+}
+
+static int
+shp_read_plain_entity (gaiaShapefilePtr shp, int current_row, int srid,
+		       int text_dates, unsigned char **blob, int *blob_size)
+{
+/* falling back to gaiaReadShpEntity_ex() */
+    int ret = gaiaReadShpEntity_ex (shp, current_row, srid, text_dates);
+    if (ret > 0 && shp->Dbf->Geometry != NULL)
+	gaiaToSpatiaLiteBlobWkb (shp->Dbf->Geometry, blob, blob_size);
+    return ret;
+}
+
+SPATIALITE_PRIVATE int
+splite_read_mapped_shp_entity (void *p_shp,
+			       struct splite_shp_mapping *mapping,
+			       int current_row, int srid, int text_dates,
+			       unsigned char **blob, int *blob_size)
+{
+/* 
+/ trying to read an entity from a memory mapped shapefile
+/ 
+/ return values and DBF values are exactly the same of gaiaReadShpEntity_ex(),
+/ but the Geometry is directly returned as a SpatiaLite BLOB (NULL for a
+/ NULL Shape) and shp->Dbf->Geometry is always left to NULL
+/ SHP records are addressed in place by their SHX offsets and converted
+/ into BLOB format without building any intermediate Geometry; anything
+/ unusual (corrupted records, EOF, Polygons with holes) simply goes through
+/ the plain reader, so to get identical results and error messages
+*/
+    gaiaShapefilePtr shp = (gaiaShapefilePtr) p_shp;
+    const unsigned char *dbf_rec;
+    const unsigned char *shp_rec;
+    size_t offset;
+    size_t off_shp;
+    int sz;
+    int len;
+    char errMsg[1024];
+    gaiaDbfFieldPtr pFld;
+    struct shp_mapped_record rec;
+    *blob = NULL;
+    *blob_size = 0;
+    if (mapping->shp == NULL || mapping->shx == NULL || mapping->dbf == NULL
+	|| current_row < 0)
+	return shp_read_plain_entity (shp, current_row, srid, text_dates,
+				      blob, blob_size);
+    rec.endian_arch = shp->endian_arch;
+    rec.dims = shp->EffectiveDims;
+/* addressing the SHX entry */
+    offset = 100 + ((size_t) current_row * 8);
+    if (offset + 8 > mapping->shx_size)
+	return shp_read_plain_entity (shp, current_row, srid, text_dates,
+				      blob, blob_size);
+    off_shp =
+	(size_t) gaiaImport32 (mapping->shx + offset, GAIA_BIG_ENDIAN,
+			       rec.endian_arch) * 2;
+/* addressing the DBF record */
+    offset =
+	(size_t) (shp->DbfHdsz) + ((size_t) current_row * shp->DbfReclen);
+    if (offset + shp->DbfReclen > mapping->dbf_size)
+	return shp_read_plain_entity (shp, current_row, srid, text_dates,
+				      blob, blob_size);
+    dbf_rec = mapping->dbf + offset;
+    if (*dbf_rec == '*')
+      {
+	  /* deleted DBF record */
+	  if (shp->LastError)
+	      free (shp->LastError);
+	  shp->LastError = NULL;
+	  return -1;
+      }
+/* addressing the SHP record */
+    if (off_shp + 12 > mapping->shp_size)
+	return shp_read_plain_entity (shp, current_row, srid, text_dates,
+				      blob, blob_size);
+    shp_rec = mapping->shp + off_shp;
+    sz = gaiaImport32 (shp_rec + 4, GAIA_BIG_ENDIAN, rec.endian_arch);
+    rec.shape = gaiaImport32 (shp_rec + 8, GAIA_LITTLE_ENDIAN, rec.endian_arch);
+    if (rec.shape != GAIA_SHP_NULL)
+      {
+	  if (rec.shape != shp->Shape || sz <= 0
+	      || off_shp + 8 + ((size_t) sz * 2) > mapping->shp_size)
+	      return shp_read_plain_entity (shp, current_row, srid,
+					    text_dates, blob, blob_size);
+	  if (!shp_mapped_parse (shp_rec + 8, sz * 2, &rec))
+	      return shp_read_plain_entity (shp, current_row, srid,
+					    text_dates, blob, blob_size);
+	  if (!shp_mapped_to_blob (shp, &rec, srid, blob, blob_size))
+	      return shp_read_plain_entity (shp, current_row, srid,
+					    text_dates, blob, blob_size);
+      }
+/* setting up the current SHP ENTITY */
+    gaiaResetDbfEntity (shp->Dbf);
+    shp->Dbf->RowId = current_row;
+/* fetching the DBF values */
+    pFld = shp->Dbf->First;
+    while (pFld)
+      {
+	  if (!parseDbfField
+	      ((unsigned char *) dbf_rec, shp->IconvObj, pFld, text_dates))
+	      goto conversion_error;
+	  pFld = pFld->Next;
+      }
+    if (shp->LastError)
+	free (shp->LastError);
+    shp->LastError = NULL;
+    return 1;
+  conversion_error:
+    if (*blob != NULL)
+	free (*blob);
+    *blob = NULL;
+    *blob_size = 0;
+    if (shp->LastError)
+	free (shp->LastError);
+    sprintf (errMsg, "Invalid character sequence");
+    len = strlen (errMsg);
+    shp->LastError = malloc (len + 1);
+    strcpy (shp->LastError, errMsg);
+    return 0;
+}
+
 static void
 gaiaSaneClockwise (gaiaPolygonPtr polyg)
 {
@@ -2991,7 +3709,7 @@ gaiaWriteShpEntity (gaiaShapefilePtr shp, gaiaDbfListPtr entity)
 		gaiaExport32 (shp->BufShp + 8, GAIA_SHP_POINTM, GAIA_LITTLE_ENDIAN, endian_arch);	/* exports geometry type = POINT M */
 		gaiaExport64 (shp->BufShp + 12, pt->X, GAIA_LITTLE_ENDIAN, endian_arch);	/* exports X coordinate */
 		gaiaExport64 (shp->BufShp + 20, pt->Y, GAIA_LITTLE_ENDIAN, endian_arch);	/* exports Y coordinate */
-		gaiaExport64 (shp->BufShp + 28, pt->Y, GAIA_LITTLE_ENDIAN, endian_arch);	/* exports M coordinate */
+		gaiaExport64 (shp->BufShp + 28, pt->M, GAIA_LITTLE_ENDIAN, endian_arch);	/* exports M coordinate */
 		fwrite (shp->BufShp, 1, 36, shp->flShp);
 		(shp->ShpSize) += 18;	/* updating current SHP file position [in 16 bits words !!!] */
 	    }
@@ -61,6 +61,7 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <spatialite/debug.h>
 
 #include <spatialite/gaiageo.h>
+#include <spatialite_private.h>
 
 #if defined(_WIN32) || defined(WIN32)
 #include <io.h>
@@ -1856,9 +1857,10 @@ vanuatu_cleanup (vanuatuFlexToken * token)
     return 0;
 }
 
-gaiaGeomCollPtr
-gaiaParseWkt (const unsigned char *dirty_buffer, short type)
+static gaiaGeomCollPtr
+vanuatu_lemon_parse (const unsigned char *dirty_buffer)
 {
+/* parsing a WKT by using the FLEX lexer and the LEMON parser */
     void *pParser = ParseAlloc (malloc);
     /* Linked-list of token values */
     vanuatuFlexToken *tokens = malloc (sizeof (vanuatuFlexToken));
@@ -1931,32 +1933,48 @@ gaiaParseWkt (const unsigned char *dirty_buffer, short type)
       }
 
     vanuatuCleanMapDynAlloc (&str_data, 0);
+    return str_data.result;
+}
+
+gaiaGeomCollPtr
+gaiaParseWkt (const unsigned char *dirty_buffer, short type)
+{
+    gaiaGeomCollPtr result;
+
+/*
+/ attempting first the fast reader; the LEMON parser is still
+/ required by anything else (syntax errors included)
+*/
+    result = gaiaFastParseWkt (dirty_buffer, 0);
+    if (result == NULL)
+	result = vanuatu_lemon_parse (dirty_buffer);
+
     /*
      ** Sandro Furieri 2010 Apr 4
      ** final checkup for validity
      */
-    if (str_data.result == NULL)
+    if (result == NULL)
 	return NULL;
-    if (!vanuatuCheckValidity (str_data.result))
+    if (!vanuatuCheckValidity (result))
       {
-	  gaiaFreeGeomColl (str_data.result);
+	  gaiaFreeGeomColl (result);
 	  return NULL;
       }
     if (type < 0)
 	;			/* no restrinction about GEOMETRY CLASS TYPE */
     else
       {
-	  if (str_data.result->DeclaredType != type)
+	  if (result->DeclaredType != type)
 	    {
 		/* invalid CLASS TYPE for request */
-		gaiaFreeGeomColl (str_data.result);
+		gaiaFreeGeomColl (result);
 		return NULL;
 	    }
       }
 
-    gaiaMbrGeometry (str_data.result);
+    gaiaMbrGeometry (result);
 
-    return str_data.result;
+    return result;
 }
 
 /******************************************************************************
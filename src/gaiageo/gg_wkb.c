@@ -59,9 +59,10 @@ the terms of any one of the MPL, the GPL or the LGPL.
 
 #include <spatialite/gaiageo.h>
 #include <spatialite/geopackage.h>
+#include <spatialite_private.h>
 
 static void
-ParseWkbPoint (gaiaGeomCollPtr geo)
+ParseWkbPoint (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a POINT from WKB */
     double x;
@@ -72,11 +73,11 @@ ParseWkbPoint (gaiaGeomCollPtr geo)
     y = gaiaImport64 (geo->blob + (geo->offset + 8), geo->endian,
 		      geo->endian_arch);
     geo->offset += 16;
-    gaiaAddPointToGeomColl (geo, x, y);
+    gaiaArenaAddPoint (arena, geo, x, y, 0.0, 0.0, GAIA_XY);
 }
 
 static void
-ParseWkbPointZ (gaiaGeomCollPtr geo)
+ParseWkbPointZ (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a POINTZ from WKB */
     double x;
@@ -90,11 +91,11 @@ ParseWkbPointZ (gaiaGeomCollPtr geo)
     z = gaiaImport64 (geo->blob + (geo->offset + 16), geo->endian,
 		      geo->endian_arch);
     geo->offset += 24;
-    gaiaAddPointToGeomCollXYZ (geo, x, y, z);
+    gaiaArenaAddPoint (arena, geo, x, y, z, 0.0, GAIA_XY_Z);
 }
 
 static void
-ParseWkbPointM (gaiaGeomCollPtr geo)
+ParseWkbPointM (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a POINTM from WKB */
     double x;
@@ -108,11 +109,11 @@ ParseWkbPointM (gaiaGeomCollPtr geo)
     m = gaiaImport64 (geo->blob + (geo->offset + 16), geo->endian,
 		      geo->endian_arch);
     geo->offset += 24;
-    gaiaAddPointToGeomCollXYM (geo, x, y, m);
+    gaiaArenaAddPoint (arena, geo, x, y, 0.0, m, GAIA_XY_M);
 }
 
 static void
-ParseWkbPointZM (gaiaGeomCollPtr geo)
+ParseWkbPointZM (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a POINTZM from WKB */
     double x;
@@ -129,143 +130,100 @@ ParseWkbPointZM (gaiaGeomCollPtr geo)
     m = gaiaImport64 (geo->blob + (geo->offset + 24), geo->endian,
 		      geo->endian_arch);
     geo->offset += 32;
-    gaiaAddPointToGeomCollXYZM (geo, x, y, z, m);
+    gaiaArenaAddPoint (arena, geo, x, y, z, m, GAIA_XY_Z_M);
 }
 
 static void
-ParseWkbLine (gaiaGeomCollPtr geo)
+ParseWkbLine (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a LINESTRING from WKB */
     int points;
-    int iv;
-    double x;
-    double y;
     gaiaLinestringPtr line;
     if (geo->size < geo->offset + 4)
 	return;
     points =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
-    if (geo->size < geo->offset + (16 * points))
+    if (points < 0 || geo->size < geo->offset + (16 * (unsigned long) points))
 	return;
-    line = gaiaAddLinestringToGeomColl (geo, points);
-    for (iv = 0; iv < points; iv++)
-      {
-	  x = gaiaImport64 (geo->blob + geo->offset, geo->endian,
-			    geo->endian_arch);
-	  y = gaiaImport64 (geo->blob + (geo->offset + 8), geo->endian,
-			    geo->endian_arch);
-	  gaiaSetPoint (line->Coords, iv, x, y);
-	  geo->offset += 16;
-      }
+    line = gaiaArenaAddLinestring (arena, geo, points);
+    if (line == NULL)
+	return;
+    gaiaImport64Array (line->Coords, geo->blob + geo->offset, points * 2,
+		       geo->endian, geo->endian_arch);
+    geo->offset += 16 * points;
 }
 
 static void
-ParseWkbLineZ (gaiaGeomCollPtr geo)
+ParseWkbLineZ (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a LINESTRINGZ from WKB */
     int points;
-    int iv;
-    double x;
-    double y;
-    double z;
     gaiaLinestringPtr line;
     if (geo->size < geo->offset + 4)
 	return;
     points =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
-    if (geo->size < geo->offset + (24 * points))
+    if (points < 0 || geo->size < geo->offset + (24 * (unsigned long) points))
 	return;
-    line = gaiaAddLinestringToGeomColl (geo, points);
-    for (iv = 0; iv < points; iv++)
-      {
-	  x = gaiaImport64 (geo->blob + geo->offset, geo->endian,
-			    geo->endian_arch);
-	  y = gaiaImport64 (geo->blob + (geo->offset + 8), geo->endian,
-			    geo->endian_arch);
-	  z = gaiaImport64 (geo->blob + (geo->offset + 16), geo->endian,
-			    geo->endian_arch);
-	  gaiaSetPointXYZ (line->Coords, iv, x, y, z);
-	  geo->offset += 24;
-      }
+    line = gaiaArenaAddLinestring (arena, geo, points);
+    if (line == NULL)
+	return;
+    gaiaImport64Array (line->Coords, geo->blob + geo->offset, points * 3,
+		       geo->endian, geo->endian_arch);
+    geo->offset += 24 * points;
 }
 
 static void
-ParseWkbLineM (gaiaGeomCollPtr geo)
+ParseWkbLineM (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a LINESTRINGM from WKB */
     int points;
-    int iv;
-    double x;
-    double y;
-    double m;
     gaiaLinestringPtr line;
     if (geo->size < geo->offset + 4)
 	return;
     points =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
-    if (geo->size < geo->offset + (24 * points))
+    if (points < 0 || geo->size < geo->offset + (24 * (unsigned long) points))
 	return;
-    line = gaiaAddLinestringToGeomColl (geo, points);
-    for (iv = 0; iv < points; iv++)
-      {
-	  x = gaiaImport64 (geo->blob + geo->offset, geo->endian,
-			    geo->endian_arch);
-	  y = gaiaImport64 (geo->blob + (geo->offset + 8), geo->endian,
-			    geo->endian_arch);
-	  m = gaiaImport64 (geo->blob + (geo->offset + 16), geo->endian,
-			    geo->endian_arch);
-	  gaiaSetPointXYM (line->Coords, iv, x, y, m);
-	  geo->offset += 24;
-      }
+    line = gaiaArenaAddLinestring (arena, geo, points);
+    if (line == NULL)
+	return;
+    gaiaImport64Array (line->Coords, geo->blob + geo->offset, points * 3,
+		       geo->endian, geo->endian_arch);
+    geo->offset += 24 * points;
 }
 
 static void
-ParseWkbLineZM (gaiaGeomCollPtr geo)
+ParseWkbLineZM (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a LINESTRINGZM from WKB */
     int points;
-    int iv;
-    double x;
-    double y;
-    double z;
-    double m;
     gaiaLinestringPtr line;
     if (geo->size < geo->offset + 4)
 	return;
     points =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
-    if (geo->size < geo->offset + (32 * points))
+    if (points < 0 || geo->size < geo->offset + (32 * (unsigned long) points))
 	return;
-    line = gaiaAddLinestringToGeomColl (geo, points);
-    for (iv = 0; iv < points; iv++)
-      {
-	  x = gaiaImport64 (geo->blob + geo->offset, geo->endian,
-			    geo->endian_arch);
-	  y = gaiaImport64 (geo->blob + (geo->offset + 8), geo->endian,
-			    geo->endian_arch);
-	  z = gaiaImport64 (geo->blob + (geo->offset + 16), geo->endian,
-			    geo->endian_arch);
-	  m = gaiaImport64 (geo->blob + (geo->offset + 24), geo->endian,
-			    geo->endian_arch);
-	  gaiaSetPointXYZM (line->Coords, iv, x, y, z, m);
-	  geo->offset += 32;
-      }
+    line = gaiaArenaAddLinestring (arena, geo, points);
+    if (line == NULL)
+	return;
+    gaiaImport64Array (line->Coords, geo->blob + geo->offset, points * 4,
+		       geo->endian, geo->endian_arch);
+    geo->offset += 32 * points;
 }
 
 static void
-ParseWkbPolygon (gaiaGeomCollPtr geo)
+ParseWkbPolygon (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a POLYGON from WKB */
     int rings;
     int nverts;
-    int iv;
     int ib;
-    double x;
-    double y;
     gaiaPolygonPtr polyg = NULL;
     gaiaRingPtr ring;
     if (geo->size < geo->offset + 4)
@@ -273,6 +231,8 @@ ParseWkbPolygon (gaiaGeomCollPtr geo)
     rings =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
+    if (rings < 0 || geo->size < geo->offset + (4 * (unsigned long) rings))
+	return;
     for (ib = 0; ib < rings; ib++)
       {
 	  if (geo->size < geo->offset + 4)
@@ -281,38 +241,35 @@ ParseWkbPolygon (gaiaGeomCollPtr geo)
 	      gaiaImport32 (geo->blob + geo->offset, geo->endian,
 			    geo->endian_arch);
 	  geo->offset += 4;
-	  if (geo->size < geo->offset + (16 * nverts))
+	  if (nverts < 0
+	      || geo->size < geo->offset + (16 * (unsigned long) nverts))
 	      return;
 	  if (ib == 0)
 	    {
-		polyg = gaiaAddPolygonToGeomColl (geo, nverts, rings - 1);
+		polyg = gaiaArenaAddPolygon (arena, geo, nverts, rings - 1);
+		if (polyg == NULL)
+		    return;
 		ring = polyg->Exterior;
 	    }
 	  else
-	      ring = gaiaAddInteriorRing (polyg, ib - 1, nverts);
-	  for (iv = 0; iv < nverts; iv++)
 	    {
-		x = gaiaImport64 (geo->blob + geo->offset, geo->endian,
-				  geo->endian_arch);
-		y = gaiaImport64 (geo->blob + (geo->offset + 8), geo->endian,
-				  geo->endian_arch);
-		geo->offset += 16;
-		gaiaSetPoint (ring->Coords, iv, x, y);
+		ring = gaiaArenaAddInteriorRing (arena, polyg, ib - 1, nverts);
+		if (ring == NULL)
+		    return;
 	    }
+	  gaiaImport64Array (ring->Coords, geo->blob + geo->offset,
+			     nverts * 2, geo->endian, geo->endian_arch);
+	  geo->offset += 16 * nverts;
       }
 }
 
 static void
-ParseWkbPolygonZ (gaiaGeomCollPtr geo)
+ParseWkbPolygonZ (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a POLYGONZ from WKB */
     int rings;
     int nverts;
-    int iv;
     int ib;
-    double x;
-    double y;
-    double z;
     gaiaPolygonPtr polyg = NULL;
     gaiaRingPtr ring;
     if (geo->size < geo->offset + 4)
@@ -320,6 +277,8 @@ ParseWkbPolygonZ (gaiaGeomCollPtr geo)
     rings =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
+    if (rings < 0 || geo->size < geo->offset + (4 * (unsigned long) rings))
+	return;
     for (ib = 0; ib < rings; ib++)
       {
 	  if (geo->size < geo->offset + 4)
@@ -328,40 +287,35 @@ ParseWkbPolygonZ (gaiaGeomCollPtr geo)
 	      gaiaImport32 (geo->blob + geo->offset, geo->endian,
 			    geo->endian_arch);
 	  geo->offset += 4;
-	  if (geo->size < geo->offset + (24 * nverts))
+	  if (nverts < 0
+	      || geo->size < geo->offset + (24 * (unsigned long) nverts))
 	      return;
 	  if (ib == 0)
 	    {
-		polyg = gaiaAddPolygonToGeomColl (geo, nverts, rings - 1);
+		polyg = gaiaArenaAddPolygon (arena, geo, nverts, rings - 1);
+		if (polyg == NULL)
+		    return;
 		ring = polyg->Exterior;
 	    }
 	  else
-	      ring = gaiaAddInteriorRing (polyg, ib - 1, nverts);
-	  for (iv = 0; iv < nverts; iv++)
 	    {
-		x = gaiaImport64 (geo->blob + geo->offset, geo->endian,
-				  geo->endian_arch);
-		y = gaiaImport64 (geo->blob + (geo->offset + 8), geo->endian,
-				  geo->endian_arch);
-		z = gaiaImport64 (geo->blob + (geo->offset + 16), geo->endian,
-				  geo->endian_arch);
-		geo->offset += 24;
-		gaiaSetPointXYZ (ring->Coords, iv, x, y, z);
+		ring = gaiaArenaAddInteriorRing (arena, polyg, ib - 1, nverts);
+		if (ring == NULL)
+		    return;
 	    }
+	  gaiaImport64Array (ring->Coords, geo->blob + geo->offset,
+			     nverts * 3, geo->endian, geo->endian_arch);
+	  geo->offset += 24 * nverts;
       }
 }
 
 static void
-ParseWkbPolygonM (gaiaGeomCollPtr geo)
+ParseWkbPolygonM (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a POLYGONM from WKB */
     int rings;
     int nverts;
-    int iv;
     int ib;
-    double x;
-    double y;
-    double m;
     gaiaPolygonPtr polyg = NULL;
     gaiaRingPtr ring;
     if (geo->size < geo->offset + 4)
@@ -369,6 +323,8 @@ ParseWkbPolygonM (gaiaGeomCollPtr geo)
     rings =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
+    if (rings < 0 || geo->size < geo->offset + (4 * (unsigned long) rings))
+	return;
     for (ib = 0; ib < rings; ib++)
       {
 	  if (geo->size < geo->offset + 4)
@@ -377,41 +333,35 @@ ParseWkbPolygonM (gaiaGeomCollPtr geo)
 	      gaiaImport32 (geo->blob + geo->offset, geo->endian,
 			    geo->endian_arch);
 	  geo->offset += 4;
-	  if (geo->size < geo->offset + (24 * nverts))
+	  if (nverts < 0
+	      || geo->size < geo->offset + (24 * (unsigned long) nverts))
 	      return;
 	  if (ib == 0)
 	    {
-		polyg = gaiaAddPolygonToGeomColl (geo, nverts, rings - 1);
+		polyg = gaiaArenaAddPolygon (arena, geo, nverts, rings - 1);
+		if (polyg == NULL)
+		    return;
 		ring = polyg->Exterior;
 	    }
 	  else
-	      ring = gaiaAddInteriorRing (polyg, ib - 1, nverts);
-	  for (iv = 0; iv < nverts; iv++)
 	    {
-		x = gaiaImport64 (geo->blob + geo->offset, geo->endian,
-				  geo->endian_arch);
-		y = gaiaImport64 (geo->blob + (geo->offset + 8), geo->endian,
-				  geo->endian_arch);
-		m = gaiaImport64 (geo->blob + (geo->offset + 16), geo->endian,
-				  geo->endian_arch);
-		geo->offset += 24;
-		gaiaSetPointXYM (ring->Coords, iv, x, y, m);
+		ring = gaiaArenaAddInteriorRing (arena, polyg, ib - 1, nverts);
+		if (ring == NULL)
+		    return;
 	    }
+	  gaiaImport64Array (ring->Coords, geo->blob + geo->offset,
+			     nverts * 3, geo->endian, geo->endian_arch);
+	  geo->offset += 24 * nverts;
       }
 }
 
 static void
-ParseWkbPolygonZM (gaiaGeomCollPtr geo)
+ParseWkbPolygonZM (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a POLYGONZM from WKB */
     int rings;
     int nverts;
-    int iv;
     int ib;
-    double x;
-    double y;
-    double z;
-    double m;
     gaiaPolygonPtr polyg = NULL;
     gaiaRingPtr ring;
     if (geo->size < geo->offset + 4)
@@ -419,6 +369,8 @@ ParseWkbPolygonZM (gaiaGeomCollPtr geo)
     rings =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
+    if (rings < 0 || geo->size < geo->offset + (4 * (unsigned long) rings))
+	return;
     for (ib = 0; ib < rings; ib++)
       {
 	  if (geo->size < geo->offset + 4)
@@ -427,33 +379,30 @@ ParseWkbPolygonZM (gaiaGeomCollPtr geo)
 	      gaiaImport32 (geo->blob + geo->offset, geo->endian,
 			    geo->endian_arch);
 	  geo->offset += 4;
-	  if (geo->size < geo->offset + (32 * nverts))
+	  if (nverts < 0
+	      || geo->size < geo->offset + (32 * (unsigned long) nverts))
 	      return;
 	  if (ib == 0)
 	    {
-		polyg = gaiaAddPolygonToGeomColl (geo, nverts, rings - 1);
+		polyg = gaiaArenaAddPolygon (arena, geo, nverts, rings - 1);
+		if (polyg == NULL)
+		    return;
 		ring = polyg->Exterior;
 	    }
 	  else
-	      ring = gaiaAddInteriorRing (polyg, ib - 1, nverts);
-	  for (iv = 0; iv < nverts; iv++)
 	    {
-		x = gaiaImport64 (geo->blob + geo->offset, geo->endian,
-				  geo->endian_arch);
-		y = gaiaImport64 (geo->blob + (geo->offset + 8), geo->endian,
-				  geo->endian_arch);
-		z = gaiaImport64 (geo->blob + (geo->offset + 16), geo->endian,
-				  geo->endian_arch);
-		m = gaiaImport64 (geo->blob + (geo->offset + 24), geo->endian,
-				  geo->endian_arch);
-		geo->offset += 32;
-		gaiaSetPointXYZM (ring->Coords, iv, x, y, z, m);
+		ring = gaiaArenaAddInteriorRing (arena, polyg, ib - 1, nverts);
+		if (ring == NULL)
+		    return;
 	    }
+	  gaiaImport64Array (ring->Coords, geo->blob + geo->offset,
+			     nverts * 4, geo->endian, geo->endian_arch);
+	  geo->offset += 32 * nverts;
       }
 }
 
 static void
-ParseCompressedWkbLine (gaiaGeomCollPtr geo)
+ParseCompressedWkbLine (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a COMPRESSED LINESTRING from WKB */
     int points;
@@ -470,9 +419,12 @@ ParseCompressedWkbLine (gaiaGeomCollPtr geo)
     points =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
-    if (geo->size < geo->offset + (8 * points) + 16)
+    if (points < 0
+	|| geo->size < geo->offset + (8 * (unsigned long) points) + 16)
+	return;
+    line = gaiaArenaAddLinestring (arena, geo, points);
+    if (line == NULL)
 	return;
-    line = gaiaAddLinestringToGeomColl (geo, points);
     for (iv = 0; iv < points; iv++)
       {
 	  if (iv == 0 || iv == (points - 1))
@@ -502,7 +454,7 @@ ParseCompressedWkbLine (gaiaGeomCollPtr geo)
 }
 
 static void
-ParseCompressedWkbLineZ (gaiaGeomCollPtr geo)
+ParseCompressedWkbLineZ (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a COMPRESSED LINESTRINGZ from WKB */
     int points;
@@ -522,9 +474,12 @@ ParseCompressedWkbLineZ (gaiaGeomCollPtr geo)
     points =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
-    if (geo->size < geo->offset + (12 * points) + 24)
+    if (points < 0
+	|| geo->size < geo->offset + (12 * (unsigned long) points) + 24)
+	return;
+    line = gaiaArenaAddLinestring (arena, geo, points);
+    if (line == NULL)
 	return;
-    line = gaiaAddLinestringToGeomColl (geo, points);
     for (iv = 0; iv < points; iv++)
       {
 	  if (iv == 0 || iv == (points - 1))
@@ -560,7 +515,7 @@ ParseCompressedWkbLineZ (gaiaGeomCollPtr geo)
 }
 
 static void
-ParseCompressedWkbLineM (gaiaGeomCollPtr geo)
+ParseCompressedWkbLineM (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a COMPRESSED LINESTRINGM from WKB */
     int points;
@@ -578,9 +533,12 @@ ParseCompressedWkbLineM (gaiaGeomCollPtr geo)
     points =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
-    if (geo->size < geo->offset + (16 * points) + 16)
+    if (points < 0
+	|| geo->size < geo->offset + (16 * (unsigned long) points) + 16)
+	return;
+    line = gaiaArenaAddLinestring (arena, geo, points);
+    if (line == NULL)
 	return;
-    line = gaiaAddLinestringToGeomColl (geo, points);
     for (iv = 0; iv < points; iv++)
       {
 	  if (iv == 0 || iv == (points - 1))
@@ -614,7 +572,7 @@ ParseCompressedWkbLineM (gaiaGeomCollPtr geo)
 }
 
 static void
-ParseCompressedWkbLineZM (gaiaGeomCollPtr geo)
+ParseCompressedWkbLineZM (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a COMPRESSED LINESTRINGZM from WKB */
     int points;
@@ -635,9 +593,12 @@ ParseCompressedWkbLineZM (gaiaGeomCollPtr geo)
     points =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
-    if (geo->size < geo->offset + (20 * points) + 24)
+    if (points < 0
+	|| geo->size < geo->offset + (20 * (unsigned long) points) + 24)
+	return;
+    line = gaiaArenaAddLinestring (arena, geo, points);
+    if (line == NULL)
 	return;
-    line = gaiaAddLinestringToGeomColl (geo, points);
     for (iv = 0; iv < points; iv++)
       {
 	  if (iv == 0 || iv == (points - 1))
@@ -677,7 +638,7 @@ ParseCompressedWkbLineZM (gaiaGeomCollPtr geo)
 }
 
 static void
-ParseCompressedWkbPolygon (gaiaGeomCollPtr geo)
+ParseCompressedWkbPolygon (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a COMPRESSED POLYGON from WKB */
     int rings;
@@ -697,6 +658,8 @@ ParseCompressedWkbPolygon (gaiaGeomCollPtr geo)
     rings =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
+    if (rings < 0 || geo->size < geo->offset + (4 * (unsigned long) rings))
+	return;
     for (ib = 0; ib < rings; ib++)
       {
 	  if (geo->size < geo->offset + 4)
@@ -705,15 +668,22 @@ ParseCompressedWkbPolygon (gaiaGeomCollPtr geo)
 	      gaiaImport32 (geo->blob + geo->offset, geo->endian,
 			    geo->endian_arch);
 	  geo->offset += 4;
-	  if (geo->size < geo->offset + (8 * nverts) + 16)
+	  if (nverts < 0
+	      || geo->size < geo->offset + (8 * (unsigned long) nverts) + 16)
 	      return;
 	  if (ib == 0)
 	    {
-		polyg = gaiaAddPolygonToGeomColl (geo, nverts, rings - 1);
+		polyg = gaiaArenaAddPolygon (arena, geo, nverts, rings - 1);
+		if (polyg == NULL)
+		    return;
 		ring = polyg->Exterior;
 	    }
 	  else
-	      ring = gaiaAddInteriorRing (polyg, ib - 1, nverts);
+	    {
+		ring = gaiaArenaAddInteriorRing (arena, polyg, ib - 1, nverts);
+		if (ring == NULL)
+		    return;
+	    }
 	  for (iv = 0; iv < nverts; iv++)
 	    {
 		if (iv == 0 || iv == (nverts - 1))
@@ -744,7 +714,7 @@ ParseCompressedWkbPolygon (gaiaGeomCollPtr geo)
 }
 
 static void
-ParseCompressedWkbPolygonZ (gaiaGeomCollPtr geo)
+ParseCompressedWkbPolygonZ (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a COMPRESSED POLYGONZ from WKB */
     int rings;
@@ -767,6 +737,8 @@ ParseCompressedWkbPolygonZ (gaiaGeomCollPtr geo)
     rings =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
+    if (rings < 0 || geo->size < geo->offset + (4 * (unsigned long) rings))
+	return;
     for (ib = 0; ib < rings; ib++)
       {
 	  if (geo->size < geo->offset + 4)
@@ -775,15 +747,22 @@ ParseCompressedWkbPolygonZ (gaiaGeomCollPtr geo)
 	      gaiaImport32 (geo->blob + geo->offset, geo->endian,
 			    geo->endian_arch);
 	  geo->offset += 4;
-	  if (geo->size < geo->offset + (12 * nverts) + 24)
+	  if (nverts < 0
+	      || geo->size < geo->offset + (12 * (unsigned long) nverts) + 24)
 	      return;
 	  if (ib == 0)
 	    {
-		polyg = gaiaAddPolygonToGeomColl (geo, nverts, rings - 1);
+		polyg = gaiaArenaAddPolygon (arena, geo, nverts, rings - 1);
+		if (polyg == NULL)
+		    return;
 		ring = polyg->Exterior;
 	    }
 	  else
-	      ring = gaiaAddInteriorRing (polyg, ib - 1, nverts);
+	    {
+		ring = gaiaArenaAddInteriorRing (arena, polyg, ib - 1, nverts);
+		if (ring == NULL)
+		    return;
+	    }
 	  for (iv = 0; iv < nverts; iv++)
 	    {
 		if (iv == 0 || iv == (nverts - 1))
@@ -820,7 +799,7 @@ ParseCompressedWkbPolygonZ (gaiaGeomCollPtr geo)
 }
 
 static void
-ParseCompressedWkbPolygonM (gaiaGeomCollPtr geo)
+ParseCompressedWkbPolygonM (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a COMPRESSED POLYGONM from WKB */
     int rings;
@@ -841,6 +820,8 @@ ParseCompressedWkbPolygonM (gaiaGeomCollPtr geo)
     rings =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
+    if (rings < 0 || geo->size < geo->offset + (4 * (unsigned long) rings))
+	return;
     for (ib = 0; ib < rings; ib++)
       {
 	  if (geo->size < geo->offset + 4)
@@ -849,15 +830,22 @@ ParseCompressedWkbPolygonM (gaiaGeomCollPtr geo)
 	      gaiaImport32 (geo->blob + geo->offset, geo->endian,
 			    geo->endian_arch);
 	  geo->offset += 4;
-	  if (geo->size < geo->offset + (16 * nverts) + 16)
+	  if (nverts < 0
+	      || geo->size < geo->offset + (16 * (unsigned long) nverts) + 16)
 	      return;
 	  if (ib == 0)
 	    {
-		polyg = gaiaAddPolygonToGeomColl (geo, nverts, rings - 1);
+		polyg = gaiaArenaAddPolygon (arena, geo, nverts, rings - 1);
+		if (polyg == NULL)
+		    return;
 		ring = polyg->Exterior;
 	    }
 	  else
-	      ring = gaiaAddInteriorRing (polyg, ib - 1, nverts);
+	    {
+		ring = gaiaArenaAddInteriorRing (arena, polyg, ib - 1, nverts);
+		if (ring == NULL)
+		    return;
+	    }
 	  for (iv = 0; iv < nverts; iv++)
 	    {
 		if (iv == 0 || iv == (nverts - 1))
@@ -892,7 +880,7 @@ ParseCompressedWkbPolygonM (gaiaGeomCollPtr geo)
 }
 
 static void
-ParseCompressedWkbPolygonZM (gaiaGeomCollPtr geo)
+ParseCompressedWkbPolygonZM (gaiaGeomCollPtr geo, void *arena)
 {
 /* decodes a COMPRESSED POLYGONZM from WKB */
     int rings;
@@ -916,6 +904,8 @@ ParseCompressedWkbPolygonZM (gaiaGeomCollPtr geo)
     rings =
 	gaiaImport32 (geo->blob + geo->offset, geo->endian, geo->endian_arch);
     geo->offset += 4;
+    if (rings < 0 || geo->size < geo->offset + (4 * (unsigned long) rings))
+	return;
     for (ib = 0; ib < rings; ib++)
       {
 	  if (geo->size < geo->offset + 4)
@@ -924,15 +914,22 @@ ParseCompressedWkbPolygonZM (gaiaGeomCollPtr geo)
 	      gaiaImport32 (geo->blob + geo->offset, geo->endian,
 			    geo->endian_arch);
 	  geo->offset += 4;
-	  if (geo->size < geo->offset + (20 * nverts) + 24)
+	  if (nverts < 0
+	      || geo->size < geo->offset + (20 * (unsigned long) nverts) + 24)
 	      return;
 	  if (ib == 0)
 	    {
-		polyg = gaiaAddPolygonToGeomColl (geo, nverts, rings - 1);
+		polyg = gaiaArenaAddPolygon (arena, geo, nverts, rings - 1);
+		if (polyg == NULL)
+		    return;
 		ring = polyg->Exterior;
 	    }
 	  else
-	      ring = gaiaAddInteriorRing (polyg, ib - 1, nverts);
+	    {
+		ring = gaiaArenaAddInteriorRing (arena, polyg, ib - 1, nverts);
+		if (ring == NULL)
+		    return;
+	    }
 	  for (iv = 0; iv < nverts; iv++)
 	    {
 		if (iv == 0 || iv == (nverts - 1))
@@ -972,12 +969,49 @@ ParseCompressedWkbPolygonZM (gaiaGeomCollPtr geo)
       }
 }
 
+static int
+ParseWkbItemDims (int type)
+{
+/*
+/ returns the DimensionModel of some LINESTRING or POLYGON item
+/ (their coordinates are allocated according to the container's one)
+/ or -1 for any other item
+*/
+    switch (type)
+      {
+      case GAIA_LINESTRING:
+      case GAIA_POLYGON:
+      case GAIA_COMPRESSED_LINESTRING:
+      case GAIA_COMPRESSED_POLYGON:
+	  return GAIA_XY;
+      case GAIA_LINESTRINGZ:
+      case GAIA_POLYGONZ:
+      case GAIA_GEOSWKB_LINESTRINGZ:
+      case GAIA_GEOSWKB_POLYGONZ:
+      case GAIA_COMPRESSED_LINESTRINGZ:
+      case GAIA_COMPRESSED_POLYGONZ:
+	  return GAIA_XY_Z;
+      case GAIA_LINESTRINGM:
+      case GAIA_POLYGONM:
+      case GAIA_COMPRESSED_LINESTRINGM:
+      case GAIA_COMPRESSED_POLYGONM:
+	  return GAIA_XY_M;
+      case GAIA_LINESTRINGZM:
+      case GAIA_POLYGONZM:
+      case GAIA_COMPRESSED_LINESTRINGZM:
+      case GAIA_COMPRESSED_POLYGONZM:
+	  return GAIA_XY_Z_M;
+      };
+    return -1;
+}
+
 static void
-ParseWkbGeometry (gaiaGeomCollPtr geo, int isWKB)
+ParseWkbGeometry (gaiaGeomCollPtr geo, void *arena, int isWKB)
 {
 /* decodes a MULTIxx or GEOMETRYCOLLECTION from SpatiaLite BLOB */
     int entities;
     int type;
+    int dims;
     int ie;
     if (geo->size < geo->offset + 4)
 	return;
@@ -1000,70 +1034,73 @@ ParseWkbGeometry (gaiaGeomCollPtr geo, int isWKB)
 	      gaiaImport32 (geo->blob + geo->offset + 1, geo->endian,
 			    geo->endian_arch);
 	  geo->offset += 5;
+	  dims = ParseWkbItemDims (type);
+	  if (dims >= 0 && dims != geo->DimensionModel)
+	      return;		/* mismatching dimensions: malformed */
 	  switch (type)
 	    {
 	    case GAIA_POINT:
-		ParseWkbPoint (geo);
+		ParseWkbPoint (geo, arena);
 		break;
 	    case GAIA_POINTZ:
 	    case GAIA_GEOSWKB_POINTZ:
-		ParseWkbPointZ (geo);
+		ParseWkbPointZ (geo, arena);
 		break;
 	    case GAIA_POINTM:
-		ParseWkbPointM (geo);
+		ParseWkbPointM (geo, arena);
 		break;
 	    case GAIA_POINTZM:
-		ParseWkbPointZM (geo);
+		ParseWkbPointZM (geo, arena);
 		break;
 	    case GAIA_LINESTRING:
-		ParseWkbLine (geo);
+		ParseWkbLine (geo, arena);
 		break;
 	    case GAIA_LINESTRINGZ:
 	    case GAIA_GEOSWKB_LINESTRINGZ:
-		ParseWkbLineZ (geo);
+		ParseWkbLineZ (geo, arena);
 		break;
 	    case GAIA_LINESTRINGM:
-		ParseWkbLineM (geo);
+		ParseWkbLineM (geo, arena);
 		break;
 	    case GAIA_LINESTRINGZM:
-		ParseWkbLineZM (geo);
+		ParseWkbLineZM (geo, arena);
 		break;
 	    case GAIA_POLYGON:
-		ParseWkbPolygon (geo);
+		ParseWkbPolygon (geo, arena);
 		break;
 	    case GAIA_POLYGONZ:
 	    case GAIA_GEOSWKB_POLYGONZ:
-		ParseWkbPolygonZ (geo);
+		ParseWkbPolygonZ (geo, arena);
 		break;
 	    case GAIA_POLYGONM:
-		ParseWkbPolygonM (geo);
+		ParseWkbPolygonM (geo, arena);
 		break;
 	    case GAIA_POLYGONZM:
-		ParseWkbPolygonZM (geo);
+		ParseWkbPolygonZM (geo, arena);
 		break;
 	    case GAIA_COMPRESSED_LINESTRING:
-		ParseCompressedWkbLine (geo);
+		ParseCompressedWkbLine (geo, arena);
 		break;
 	    case GAIA_COMPRESSED_LINESTRINGZ:
-		ParseCompressedWkbLineZ (geo);
+		ParseCompressedWkbLineZ (geo, arena);
 		break;
 	    case GAIA_COMPRESSED_LINESTRINGM:
-		ParseCompressedWkbLineM (geo);
+		ParseCompressedWkbLineM (geo, arena);
 		break;
 	    case GAIA_COMPRESSED_LINESTRINGZM:
-		ParseCompressedWkbLineZM (geo);
+		ParseCompressedWkbLineZM (geo, arena);
 		break;
 	    case GAIA_COMPRESSED_POLYGON:
-		ParseCompressedWkbPolygon (geo);
+		ParseCompressedWkbPolygon (geo, arena);
 		break;
 	    case GAIA_COMPRESSED_POLYGONZ:
-		ParseCompressedWkbPolygonZ (geo);
+		ParseCompressedWkbPolygonZ (geo, arena);
 		break;
 	    case GAIA_COMPRESSED_POLYGONM:
-		ParseCompressedWkbPolygonM (geo);
+		ParseCompressedWkbPolygonM (geo, arena);
 		break;
 	    case GAIA_COMPRESSED_POLYGONZM:
-		ParseCompressedWkbPolygonZM (geo);
+		ParseCompressedWkbPolygonZM (geo, arena);
 		break;
 	    default:
 		break;
@@ -1072,7 +1109,8 @@ ParseWkbGeometry (gaiaGeomCollPtr geo, int isWKB)
 }
 
 static gaiaGeomCollPtr
-doParseTinyPointBlob (const unsigned char *blob, unsigned int size)
+doParseTinyPointBlob (const unsigned char *blob, unsigned int size,
+		      int use_arena)
 {
 /* decoding from SpatiaLite TinyPoint BLOB to GEOMETRY */
     unsigned char pointType;
@@ -1080,6 +1118,7 @@ doParseTinyPointBlob (const unsigned char *blob, unsigned int size)
     int little_endian;
     int endian_arch = gaiaEndianArch ();
     gaiaGeomCollPtr geo = NULL;
+    void *arena = NULL;
 
     if (size < 24)
 	return NULL;		/* cannot be an internal BLOB TinyPoint geometry */
@@ -1095,7 +1134,14 @@ doParseTinyPointBlob (const unsigned char *blob, unsigned int size)
 	return NULL;		/* unknown encoding; nor little-endian neither big-endian */
 
     pointType = *(blob + 6);
-    geo = gaiaAllocGeomColl ();
+    if (use_arena)
+      {
+	  geo = gaiaAllocArenaGeomColl (size, &arena);
+	  if (geo == NULL)
+	      return NULL;
+      }
+    else
+	geo = gaiaAllocGeomColl ();
     geo->Srid = gaiaImport32 (blob + 2, little_endian, endian_arch);
     geo->endian_arch = (char) endian_arch;
     geo->endian = (char) little_endian;
@@ -1126,16 +1172,16 @@ doParseTinyPointBlob (const unsigned char *blob, unsigned int size)
       {
 	  /* parsing elementary geometries */
       case GAIA_POINT:
-	  ParseWkbPoint (geo);
+	  ParseWkbPoint (geo, arena);
 	  break;
       case GAIA_POINTZ:
-	  ParseWkbPointZ (geo);
+	  ParseWkbPointZ (geo, arena);
 	  break;
       case GAIA_POINTM:
-	  ParseWkbPointM (geo);
+	  ParseWkbPointM (geo, arena);
 	  break;
       case GAIA_POINTZM:
-	  ParseWkbPointZM (geo);
+	  ParseWkbPointZM (geo, arena);
 	  break;
       default:
 	  break;
@@ -1148,15 +1194,82 @@ doParseTinyPointBlob (const unsigned char *blob, unsigned int size)
     return geo;
 }
 
-GAIAGEO_DECLARE gaiaGeomCollPtr
-gaiaFromSpatiaLiteBlobWkbEx (const unsigned char *blob, unsigned int size,
-			     int gpkg_mode, int gpkg_amphibious)
+#ifdef ENABLE_GEOPACKAGE	/* GEOPACKAGE enabled: supporting GPKG geometries */
+static gaiaGeomCollPtr
+doCopyToArena (gaiaGeomCollPtr geom)
 {
-/* decoding from SpatiaLite BLOB to GEOMETRY */
+/* 
+/ copying a Geometry into a memory arena
+/ the original Geometry will be destroyed
+*/
+    gaiaGeomCollPtr geo;
+    void *arena;
+    gaiaPointPtr pt;
+    gaiaLinestringPtr ln;
+    gaiaLinestringPtr new_ln;
+    gaiaPolygonPtr pg;
+    gaiaPolygonPtr new_pg;
+    gaiaRingPtr rng;
+    int ib;
+    geo = gaiaAllocArenaGeomColl (0, &arena);
+    if (geo == NULL)
+      {
+	  gaiaFreeGeomColl (geom);
+	  return NULL;
+      }
+    geo->Srid = geom->Srid;
+    geo->DimensionModel = geom->DimensionModel;
+    geo->DeclaredType = geom->DeclaredType;
+    pt = geom->FirstPoint;
+    while (pt)
+      {
+	  gaiaArenaAddPoint (arena, geo, pt->X, pt->Y, pt->Z, pt->M,
+			     geo->DimensionModel);
+	  pt = pt->Next;
+      }
+    ln = geom->FirstLinestring;
+    while (ln)
+      {
+	  new_ln = gaiaArenaAddLinestring (arena, geo, ln->Points);
+	  if (new_ln != NULL)
+	      gaiaCopyLinestringCoords (new_ln, ln);
+	  ln = ln->Next;
+      }
+    pg = geom->FirstPolygon;
+    while (pg)
+      {
+	  new_pg =
+	      gaiaArenaAddPolygon (arena, geo, pg->Exterior->Points,
+				   pg->NumInteriors);
+	  if (new_pg != NULL)
+	    {
+		gaiaCopyRingCoords (new_pg->Exterior, pg->Exterior);
+		for (ib = 0; ib < pg->NumInteriors; ib++)
+		  {
+		      rng = pg->Interiors + ib;
+		      if (gaiaArenaAddInteriorRing
+			  (arena, new_pg, ib, rng->Points) != NULL)
+			  gaiaCopyRingCoords (new_pg->Interiors + ib, rng);
+		  }
+	    }
+	  pg = pg->Next;
+      }
+    gaiaFreeGeomColl (geom);
+    gaiaMbrGeometry (geo);
+    return geo;
+}
+#endif /* end GEOPACKAGE: supporting GPKG geometries */
+
+static gaiaGeomCollPtr
+doParseSpatiaLiteBlob (const unsigned char *blob, unsigned int size,
+		       int gpkg_mode, int gpkg_amphibious, int use_arena)
+{
+/* decoding from SpatiaLite BLOB to GEOMETRY [optionally using an arena] */
     int type;
     int little_endian;
     int endian_arch = gaiaEndianArch ();
     gaiaGeomCollPtr geo = NULL;
+    void *arena = NULL;
 
     if (gpkg_amphibious || gpkg_mode)
       {
@@ -1165,7 +1278,11 @@ gaiaFromSpatiaLiteBlobWkbEx (const unsigned char *blob, unsigned int size,
 	    {
 		geo = gaiaFromGeoPackageGeometryBlob (blob, size);
 		if (geo != NULL)
-		    return geo;
+		  {
+		      if (use_arena)
+			  return doCopyToArena (geo);
+		      return geo;
+		  }
 	    }
 	  if (gpkg_mode)
 	      return NULL;	/* must accept only GPKG geometries */
@@ -1181,7 +1298,7 @@ gaiaFromSpatiaLiteBlobWkbEx (const unsigned char *blob, unsigned int size,
 	      (*(blob + 1) == GAIA_TINYPOINT_LITTLE_ENDIAN
 	       || *(blob + 1) == GAIA_TINYPOINT_BIG_ENDIAN)
 	      && *(blob + (size - 1)) == GAIA_MARK_END)
-	      return doParseTinyPointBlob (blob, size);
+	      return doParseTinyPointBlob (blob, size, use_arena);
       }
 
     if (size < 45)
@@ -1199,7 +1316,14 @@ gaiaFromSpatiaLiteBlobWkbEx (const unsigned char *blob, unsigned int size,
     else
 	return NULL;		/* unknown encoding; nor little-endian neither big-endian */
     type = gaiaImport32 (blob + 39, little_endian, endian_arch);
-    geo = gaiaAllocGeomColl ();
+    if (use_arena)
+      {
+	  geo = gaiaAllocArenaGeomColl (size, &arena);
+	  if (geo == NULL)
+	      return NULL;
+      }
+    else
+	geo = gaiaAllocGeomColl ();
     geo->Srid = gaiaImport32 (blob + 2, little_endian, endian_arch);
     geo->endian_arch = (char) endian_arch;
     geo->endian = (char) little_endian;
@@ -1250,64 +1374,64 @@ gaiaFromSpatiaLiteBlobWkbEx (const unsigned char *blob, unsigned int size,
       {
 	  /* parsing elementary geometries */
       case GAIA_POINT:
-	  ParseWkbPoint (geo);
+	  ParseWkbPoint (geo, arena);
 	  break;
       case GAIA_POINTZ:
-	  ParseWkbPointZ (geo);
+	  ParseWkbPointZ (geo, arena);
 	  break;
       case GAIA_POINTM:
-	  ParseWkbPointM (geo);
+	  ParseWkbPointM (geo, arena);
 	  break;
       case GAIA_POINTZM:
-	  ParseWkbPointZM (geo);
+	  ParseWkbPointZM (geo, arena);
 	  break;
       case GAIA_LINESTRING:
-	  ParseWkbLine (geo);
+	  ParseWkbLine (geo, arena);
 	  break;
       case GAIA_LINESTRINGZ:
-	  ParseWkbLineZ (geo);
+	  ParseWkbLineZ (geo, arena);
 	  break;
       case GAIA_LINESTRINGM:
-	  ParseWkbLineM (geo);
+	  ParseWkbLineM (geo, arena);
 	  break;
       case GAIA_LINESTRINGZM:
-	  ParseWkbLineZM (geo);
+	  ParseWkbLineZM (geo, arena);
 	  break;
       case GAIA_POLYGON:
-	  ParseWkbPolygon (geo);
+	  ParseWkbPolygon (geo, arena);
 	  break;
       case GAIA_POLYGONZ:
-	  ParseWkbPolygonZ (geo);
+	  ParseWkbPolygonZ (geo, arena);
 	  break;
       case GAIA_POLYGONM:
-	  ParseWkbPolygonM (geo);
+	  ParseWkbPolygonM (geo, arena);
 	  break;
       case GAIA_POLYGONZM:
-	  ParseWkbPolygonZM (geo);
+	  ParseWkbPolygonZM (geo, arena);
 	  break;
       case GAIA_COMPRESSED_LINESTRING:
-	  ParseCompressedWkbLine (geo);
+	  ParseCompressedWkbLine (geo, arena);
 	  break;
       case GAIA_COMPRESSED_LINESTRINGZ:
-	  ParseCompressedWkbLineZ (geo);
+	  ParseCompressedWkbLineZ (geo, arena);
 	  break;
       case GAIA_COMPRESSED_LINESTRINGM:
-	  ParseCompressedWkbLineM (geo);
+	  ParseCompressedWkbLineM (geo, arena);
 	  break;
       case GAIA_COMPRESSED_LINESTRINGZM:
-	  ParseCompressedWkbLineZM (geo);
+	  ParseCompressedWkbLineZM (geo, arena);
 	  break;
       case GAIA_COMPRESSED_POLYGON:
-	  ParseCompressedWkbPolygon (geo);
+	  ParseCompressedWkbPolygon (geo, arena);
 	  break;
       case GAIA_COMPRESSED_POLYGONZ:
-	  ParseCompressedWkbPolygonZ (geo);
+	  ParseCompressedWkbPolygonZ (geo, arena);
 	  break;
       case GAIA_COMPRESSED_POLYGONM:
-	  ParseCompressedWkbPolygonM (geo);
+	  ParseCompressedWkbPolygonM (geo, arena);
 	  break;
       case GAIA_COMPRESSED_POLYGONZM:
-	  ParseCompressedWkbPolygonZM (geo);
+	  ParseCompressedWkbPolygonZM (geo, arena);
 	  break;
       case GAIA_MULTIPOINT:
       case GAIA_MULTIPOINTZ:
@@ -1325,7 +1449,7 @@ gaiaFromSpatiaLiteBlobWkbEx (const unsigned char *blob, unsigned int size,
       case GAIA_GEOMETRYCOLLECTIONZ:
       case GAIA_GEOMETRYCOLLECTIONM:
       case GAIA_GEOMETRYCOLLECTIONZM:
-	  ParseWkbGeometry (geo, 0);
+	  ParseWkbGeometry (geo, arena, 0);
 	  break;
       default:
 	  break;
@@ -1394,6 +1518,26 @@ gaiaFromSpatiaLiteBlobWkbEx (const unsigned char *blob, unsigned int size,
     return geo;
 }
 
+GAIAGEO_DECLARE gaiaGeomCollPtr
+gaiaFromSpatiaLiteBlobWkbEx (const unsigned char *blob, unsigned int size,
+			     int gpkg_mode, int gpkg_amphibious)
+{
+/* decoding from SpatiaLite BLOB to GEOMETRY */
+    return doParseSpatiaLiteBlob (blob, size, gpkg_mode, gpkg_amphibious, 0);
+}
+
+SPATIALITE_PRIVATE void *
+gaiaFromSpatiaLiteBlobWkbArena (const unsigned char *blob, unsigned int size,
+				int gpkg_mode, int gpkg_amphibious)
+{
+/* 
+/ decoding from SpatiaLite BLOB to GEOMETRY [using a memory arena]
+/ the returned Geometry is read-only, and must be destroyed by
+/ calling gaiaFreeArenaGeomColl()
+*/
+    return doParseSpatiaLiteBlob (blob, size, gpkg_mode, gpkg_amphibious, 1);
+}
+
 GAIAGEO_DECLARE gaiaGeomCollPtr
 gaiaFromSpatiaLiteBlobWkb (const unsigned char *blob, unsigned int size)
 {
@@ -1404,46 +1548,616 @@ gaiaFromSpatiaLiteBlobWkb (const unsigned char *blob, unsigned int size)
     return gaiaFromSpatiaLiteBlobWkbEx (blob, size, 0, 0);
 }
 
-static gaiaGeomCollPtr
-doParseTinyPointBlobMbr (const unsigned char *blob, unsigned int size)
-{
-/* decoding from SpatiaLite TinyPoint BLOB (MBR only) */
-    int little_endian;
-    int endian_arch = gaiaEndianArch ();
-    double x;
-    double y;
-    gaiaGeomCollPtr geo = NULL;
-    gaiaPolygonPtr polyg;
-    gaiaRingPtr ring;
-
-    if (size < 24)
-	return NULL;		/* cannot be an internal BLOB TinyPoint geometry */
-    if (*(blob + 0) != GAIA_MARK_START)
-	return NULL;		/* failed to recognize START signature */
-    if (*(blob + (size - 1)) != GAIA_MARK_END)
-	return NULL;		/* failed to recognize END signature */
-    if (*(blob + 1) == GAIA_TINYPOINT_LITTLE_ENDIAN)
-	little_endian = 1;
-    else if (*(blob + 1) == GAIA_TINYPOINT_BIG_ENDIAN)
-	little_endian = 0;
-    else
-	return NULL;		/* unknown encoding; nor little-endian neither big-endian */
-
-    x = gaiaImport64 (blob + 7, little_endian, endian_arch);
-    y = gaiaImport64 (blob + 15, little_endian, endian_arch);
-
-    geo = gaiaAllocGeomColl ();
-    polyg = gaiaAddPolygonToGeomColl (geo, 5, 0);
-    ring = polyg->Exterior;
-    gaiaSetPoint (ring->Coords, 0, x, y);	/* vertex # 1 */
-    gaiaSetPoint (ring->Coords, 1, x, y);	/* vertex # 2 */
-    gaiaSetPoint (ring->Coords, 2, x, y);	/* vertex # 3 */
-    gaiaSetPoint (ring->Coords, 3, x, y);	/* vertex # 4 */
-    gaiaSetPoint (ring->Coords, 4, x, y);	/* vertex # 5 [same as vertex # 1 to close the polygon] */
-    return geo;
-}
+/*
+/ BLOB view: read-only access to a SpatiaLite BLOB-Geometry
+/
+/ the BLOB is never decoded as a whole: elementary items are located
+/ by simply walking their offsets, and individual vertices are read
+/ on demand.  Only perfectly regular BLOBs are accepted, so that any
+/ caller can safely fall back to the full decoder when the view fails.
+*/
 
-GAIAGEO_DECLARE gaiaGeomCollPtr
+static int
+blob_view_classify (int type, int *class, int *compressed,
+		    int *dimension_model)
+{
+/* identifying an elementary item type */
+    *compressed = 0;
+    switch (type)
+      {
+      case GAIA_POINT:
+      case GAIA_POINTZ:
+      case GAIA_POINTM:
+      case GAIA_POINTZM:
+	  *class = GAIA_POINT;
+	  break;
+      case GAIA_LINESTRING:
+      case GAIA_LINESTRINGZ:
+      case GAIA_LINESTRINGM:
+      case GAIA_LINESTRINGZM:
+	  *class = GAIA_LINESTRING;
+	  break;
+      case GAIA_POLYGON:
+      case GAIA_POLYGONZ:
+      case GAIA_POLYGONM:
+      case GAIA_POLYGONZM:
+	  *class = GAIA_POLYGON;
+	  break;
+      case GAIA_COMPRESSED_LINESTRING:
+      case GAIA_COMPRESSED_LINESTRINGZ:
+      case GAIA_COMPRESSED_LINESTRINGM:
+      case GAIA_COMPRESSED_LINESTRINGZM:
+	  *class = GAIA_LINESTRING;
+	  *compressed = 1;
+	  break;
+      case GAIA_COMPRESSED_POLYGON:
+      case GAIA_COMPRESSED_POLYGONZ:
+      case GAIA_COMPRESSED_POLYGONM:
+      case GAIA_COMPRESSED_POLYGONZM:
+	  *class = GAIA_POLYGON;
+	  *compressed = 1;
+	  break;
+      default:
+	  return 0;
+      };
+    switch (type)
+      {
+      case GAIA_POINTZ:
+      case GAIA_LINESTRINGZ:
+      case GAIA_POLYGONZ:
+      case GAIA_COMPRESSED_LINESTRINGZ:
+      case GAIA_COMPRESSED_POLYGONZ:
+	  *dimension_model = GAIA_XY_Z;
+	  break;
+      case GAIA_POINTM:
+      case GAIA_LINESTRINGM:
+      case GAIA_POLYGONM:
+      case GAIA_COMPRESSED_LINESTRINGM:
+      case GAIA_COMPRESSED_POLYGONM:
+	  *dimension_model = GAIA_XY_M;
+	  break;
+      case GAIA_POINTZM:
+      case GAIA_LINESTRINGZM:
+      case GAIA_POLYGONZM:
+      case GAIA_COMPRESSED_LINESTRINGZM:
+      case GAIA_COMPRESSED_POLYGONZM:
+	  *dimension_model = GAIA_XY_Z_M;
+	  break;
+      default:
+	  *dimension_model = GAIA_XY;
+	  break;
+      };
+    return 1;
+}
+
+static unsigned int
+blob_view_full_vertex (int dimension_model)
+{
+/* size (in bytes) of an uncompressed vertex */
+    if (dimension_model == GAIA_XY_Z || dimension_model == GAIA_XY_M)
+	return 24;
+    if (dimension_model == GAIA_XY_Z_M)
+	return 32;
+    return 16;
+}
+
+static unsigned int
+blob_view_compressed_vertex (int dimension_model)
+{
+/* size (in bytes) of a compressed (intermediate) vertex */
+    if (dimension_model == GAIA_XY_Z)
+	return 12;
+    if (dimension_model == GAIA_XY_M)
+	return 16;
+    if (dimension_model == GAIA_XY_Z_M)
+	return 20;
+    return 8;
+}
+
+static int
+blob_view_points_size (gaiaBlobViewPtr view, unsigned int offset,
+		       int compressed, int *points, unsigned int *length)
+{
+/* measuring a vertex array [points count + vertices] */
+    unsigned int full = blob_view_full_vertex (view->DimensionModel);
+    unsigned int comp = blob_view_compressed_vertex (view->DimensionModel);
+    double bytes;
+    if (offset + 4 > view->size)
+	return 0;
+    *points =
+	gaiaImport32 (view->blob + offset, view->little_endian,
+		      view->endian_arch);
+    if (*points < 0)
+	return 0;
+    if (compressed && *points < 2)
+	return 0;		/* the decoder handles this one differently */
+    if (!compressed)
+	bytes = (double) full *(double) *points;
+    else
+	bytes = ((double) full * 2.0) + ((double) comp * (*points - 2));
+    if ((double) offset + 4.0 + bytes > (double) view->size)
+	return 0;
+    *length = 4 + (unsigned int) bytes;
+    return 1;
+}
+
+static int
+blob_view_item (gaiaBlobViewPtr view, unsigned int offset, int type,
+		int *class, unsigned int *length, int *vertices, int *rings)
+{
+/* measuring an elementary item; 0 if not a regular item */
+    int compressed;
+    int dimension_model;
+    int points;
+    int nrings;
+    int ib;
+    unsigned int len;
+    if (!blob_view_classify (type, class, &compressed, &dimension_model))
+	return 0;
+    if (dimension_model != view->DimensionModel)
+	return 0;
+    *vertices = 0;
+    *rings = 0;
+    if (*class == GAIA_POINT)
+      {
+	  len = blob_view_full_vertex (dimension_model);
+	  if (offset + len > view->size)
+	      return 0;
+	  *length = len;
+	  *vertices = 1;
+	  return 1;
+      }
+    if (*class == GAIA_LINESTRING)
+      {
+	  if (!blob_view_points_size (view, offset, compressed, &points, &len))
+	      return 0;
+	  *length = len;
+	  *vertices = points;
+	  return 1;
+      }
+    /* POLYGON */
+    if (offset + 4 > view->size)
+	return 0;
+    nrings =
+	gaiaImport32 (view->blob + offset, view->little_endian,
+		      view->endian_arch);
+    if (nrings <= 0)
+	return 0;		/* the decoder ignores an empty POLYGON */
+    *length = 4;
+    for (ib = 0; ib < nrings; ib++)
+      {
+	  if (!blob_view_points_size
+	      (view, offset + *length, compressed, &points, &len))
+	      return 0;
+	  *length += len;
+	  *vertices += points;
+      }
+    *rings = nrings;
+    return 1;
+}
+
+static int
+blob_view_find (gaiaBlobViewPtr view, int class, int index,
+		unsigned int *offset, int *type)
+{
+/* locating the Nth elementary item of the given class */
+    unsigned int off = view->first_item;
+    int ie;
+    int cnt = 0;
+    int item_class;
+    int vertices;
+    int rings;
+    unsigned int length;
+    if (index < 0)
+	return 0;
+    for (ie = 0; ie < view->items; ie++)
+      {
+	  int item_type;
+	  if (view->collection)
+	    {
+		item_type =
+		    gaiaImport32 (view->blob + off + 1, view->little_endian,
+				  view->endian_arch);
+		off += 5;
+	    }
+	  else
+	      item_type = view->item_type;
+	  if (!blob_view_item
+	      (view, off, item_type, &item_class, &length, &vertices, &rings))
+	      return 0;
+	  if (item_class == class)
+	    {
+		if (cnt == index)
+		  {
+		      *offset = off;
+		      *type = item_type;
+		      return 1;
+		  }
+		cnt++;
+	    }
+	  off += length;
+      }
+    return 0;
+}
+
+GAIAGEO_DECLARE int
+gaiaBlobViewInit (gaiaBlobViewPtr view, const unsigned char *blob,
+		  unsigned int size)
+{
+/* initializing a read-only view over a SpatiaLite BLOB-Geometry */
+    int type;
+    int ie;
+    unsigned int off;
+    int endian_arch = gaiaEndianArch ();
+    memset (view, 0, sizeof (gaiaBlobView));
+    if (blob == NULL)
+	return 0;
+    view->blob = blob;
+    view->size = size;
+    view->endian_arch = endian_arch;
+
+    if (size == 24 || size == 32 || size == 40)
+      {
+	  /* testing for a possible TinyPoint BLOB */
+	  if (*(blob + 0) == GAIA_MARK_START &&
+	      (*(blob + 1) == GAIA_TINYPOINT_LITTLE_ENDIAN
+	       || *(blob + 1) == GAIA_TINYPOINT_BIG_ENDIAN)
+	      && *(blob + (size - 1)) == GAIA_MARK_END)
+	    {
+		double x;
+		double y;
+		view->little_endian =
+		    (*(blob + 1) == GAIA_TINYPOINT_LITTLE_ENDIAN) ? 1 : 0;
+		switch (*(blob + 6))
+		  {
+		  case GAIA_TINYPOINT_XYZ:
+		      view->DimensionModel = GAIA_XY_Z;
+		      view->item_type = GAIA_POINTZ;
+		      break;
+		  case GAIA_TINYPOINT_XYM:
+		      view->DimensionModel = GAIA_XY_M;
+		      view->item_type = GAIA_POINTM;
+		      break;
+		  case GAIA_TINYPOINT_XYZM:
+		      view->DimensionModel = GAIA_XY_Z_M;
+		      view->item_type = GAIA_POINTZM;
+		      break;
+		  default:
+		      view->DimensionModel = GAIA_XY;
+		      view->item_type = GAIA_POINT;
+		      break;
+		  };
+		if (size != 8 + blob_view_full_vertex (view->DimensionModel))
+		    return 0;
+		view->Srid =
+		    gaiaImport32 (blob + 2, view->little_endian, endian_arch);
+		x = gaiaImport64 (blob + 7, view->little_endian, endian_arch);
+		y = gaiaImport64 (blob + 15, view->little_endian, endian_arch);
+		view->MinX = x;
+		view->MinY = y;
+		view->MaxX = x;
+		view->MaxY = y;
+		view->DeclaredType = GAIA_POINT;
+		view->NumPoints = 1;
+		view->NumVertices = 1;
+		view->first_item = 7;
+		view->items = 1;
+		return 1;
+	    }
+      }
+
+    if (size < 45)
+	return 0;
+    if (*(blob + 0) != GAIA_MARK_START)
+	return 0;
+    if (*(blob + (size - 1)) != GAIA_MARK_END)
+	return 0;
+    if (*(blob + 38) != GAIA_MARK_MBR)
+	return 0;
+    if (*(blob + 1) == GAIA_LITTLE_ENDIAN)
+	view->little_endian = 1;
+    else if (*(blob + 1) == GAIA_BIG_ENDIAN)
+	view->little_endian = 0;
+    else
+	return 0;
+    view->Srid = gaiaImport32 (blob + 2, view->little_endian, endian_arch);
+    view->MinX = gaiaImport64 (blob + 6, view->little_endian, endian_arch);
+    view->MinY = gaiaImport64 (blob + 14, view->little_endian, endian_arch);
+    view->MaxX = gaiaImport64 (blob + 22, view->little_endian, endian_arch);
+    view->MaxY = gaiaImport64 (blob + 30, view->little_endian, endian_arch);
+    type = gaiaImport32 (blob + 39, view->little_endian, endian_arch);
+    switch (type)
+      {
+      case GAIA_MULTIPOINT:
+      case GAIA_MULTILINESTRING:
+      case GAIA_MULTIPOLYGON:
+      case GAIA_GEOMETRYCOLLECTION:
+	  view->DimensionModel = GAIA_XY;
+	  break;
+      case GAIA_MULTIPOINTZ:
+      case GAIA_MULTILINESTRINGZ:
+      case GAIA_MULTIPOLYGONZ:
+      case GAIA_GEOMETRYCOLLECTIONZ:
+	  view->DimensionModel = GAIA_XY_Z;
+	  break;
+      case GAIA_MULTIPOINTM:
+      case GAIA_MULTILINESTRINGM:
+      case GAIA_MULTIPOLYGONM:
+      case GAIA_GEOMETRYCOLLECTIONM:
+	  view->DimensionModel = GAIA_XY_M;
+	  break;
+      case GAIA_MULTIPOINTZM:
+      case GAIA_MULTILINESTRINGZM:
+      case GAIA_MULTIPOLYGONZM:
+      case GAIA_GEOMETRYCOLLECTIONZM:
+	  view->DimensionModel = GAIA_XY_Z_M;
+	  break;
+      default:
+	  {
+	      /* an elementary Geometry */
+	      int class;
+	      int compressed;
+	      if (!blob_view_classify
+		  (type, &class, &compressed, &(view->DimensionModel)))
+		  return 0;
+	      view->DeclaredType = class;
+	      view->item_type = type;
+	      view->first_item = 43;
+	      view->items = 1;
+	  }
+	  break;
+      };
+    if (view->items == 0)
+      {
+	  /* a MULTIxx or GEOMETRYCOLLECTION */
+	  switch (type)
+	    {
+	    case GAIA_MULTIPOINT:
+	    case GAIA_MULTIPOINTZ:
+	    case GAIA_MULTIPOINTM:
+	    case GAIA_MULTIPOINTZM:
+		view->DeclaredType = GAIA_MULTIPOINT;
+		break;
+	    case GAIA_MULTILINESTRING:
+	    case GAIA_MULTILINESTRINGZ:
+	    case GAIA_MULTILINESTRINGM:
+	    case GAIA_MULTILINESTRINGZM:
+		view->DeclaredType = GAIA_MULTILINESTRING;
+		break;
+	    case GAIA_MULTIPOLYGON:
+	    case GAIA_MULTIPOLYGONZ:
+	    case GAIA_MULTIPOLYGONM:
+	    case GAIA_MULTIPOLYGONZM:
+		view->DeclaredType = GAIA_MULTIPOLYGON;
+		break;
+	    default:
+		view->DeclaredType = GAIA_GEOMETRYCOLLECTION;
+		break;
+	    };
+	  view->collection = 1;
+	  view->items = gaiaImport32 (blob + 43, view->little_endian,
+				      endian_arch);
+	  if (view->items < 0)
+	      return 0;
+	  view->first_item = 47;
+      }
+
+/* walking all elementary items */
+    off = view->first_item;
+    for (ie = 0; ie < view->items; ie++)
+      {
+	  int item_type;
+	  int class;
+	  int vertices;
+	  int rings;
+	  unsigned int length;
+	  if (view->collection)
+	    {
+		if (off + 5 > size)
+		    return 0;
+		if (*(blob + off) != GAIA_MARK_ENTITY)
+		    return 0;
+		item_type =
+		    gaiaImport32 (blob + off + 1, view->little_endian,
+				  endian_arch);
+		off += 5;
+	    }
+	  else
+	      item_type = view->item_type;
+	  if (!blob_view_item
+	      (view, off, item_type, &class, &length, &vertices, &rings))
+	      return 0;
+	  if (class == GAIA_POINT)
+	      view->NumPoints++;
+	  else if (class == GAIA_LINESTRING)
+	      view->NumLinestrings++;
+	  else
+	    {
+		view->NumPolygons++;
+		view->NumRings += rings;
+	    }
+	  view->NumVertices += vertices;
+	  off += length;
+      }
+    if (off != size - 1)
+	return 0;		/* not a regular BLOB */
+    return 1;
+}
+
+static void
+blob_view_vertex (gaiaBlobViewPtr view, const unsigned char *p,
+		  int compressed, int points, int vertex, double *x, double *y,
+		  double *z, double *m)
+{
+/* reading a vertex from some vertex array [p points to the first vertex] */
+    int little_endian = view->little_endian;
+    int endian_arch = view->endian_arch;
+    int dimension_model = view->DimensionModel;
+    *z = 0.0;
+    *m = 0.0;
+    if (!compressed || vertex == 0 || vertex == points - 1)
+      {
+	  /* an uncompressed vertex */
+	  unsigned int full = blob_view_full_vertex (dimension_model);
+	  if (compressed && vertex > 0)
+	      p += full + (blob_view_compressed_vertex (dimension_model) *
+			   (vertex - 1));
+	  else
+	      p += full * vertex;
+	  *x = gaiaImport64 (p, little_endian, endian_arch);
+	  *y = gaiaImport64 (p + 8, little_endian, endian_arch);
+	  if (dimension_model == GAIA_XY_Z)
+	      *z = gaiaImport64 (p + 16, little_endian, endian_arch);
+	  else if (dimension_model == GAIA_XY_M)
+	      *m = gaiaImport64 (p + 16, little_endian, endian_arch);
+	  else if (dimension_model == GAIA_XY_Z_M)
+	    {
+		*z = gaiaImport64 (p + 16, little_endian, endian_arch);
+		*m = gaiaImport64 (p + 24, little_endian, endian_arch);
+	    }
+      }
+    else
+      {
+	  /* a compressed vertex: accumulating the deltas exactly as the decoder does */
+	  unsigned int comp = blob_view_compressed_vertex (dimension_model);
+	  double lx = gaiaImport64 (p, little_endian, endian_arch);
+	  double ly = gaiaImport64 (p + 8, little_endian, endian_arch);
+	  double lz = 0.0;
+	  int iv;
+	  if (dimension_model == GAIA_XY_Z || dimension_model == GAIA_XY_Z_M)
+	      lz = gaiaImport64 (p + 16, little_endian, endian_arch);
+	  p += blob_view_full_vertex (dimension_model);
+	  for (iv = 1; iv <= vertex; iv++)
+	    {
+		lx += gaiaImportF32 (p, little_endian, endian_arch);
+		ly += gaiaImportF32 (p + 4, little_endian, endian_arch);
+		if (dimension_model == GAIA_XY_Z
+		    || dimension_model == GAIA_XY_Z_M)
+		    lz += gaiaImportF32 (p + 8, little_endian, endian_arch);
+		if (iv == vertex)
+		  {
+		      if (dimension_model == GAIA_XY_M)
+			  *m = gaiaImport64 (p + 8, little_endian,
+					     endian_arch);
+		      else if (dimension_model == GAIA_XY_Z_M)
+			  *m = gaiaImport64 (p + 12, little_endian,
+					     endian_arch);
+		  }
+		p += comp;
+	    }
+	  *x = lx;
+	  *y = ly;
+	  *z = lz;
+      }
+}
+
+GAIAGEO_DECLARE int
+gaiaBlobViewGetPoint (gaiaBlobViewPtr view, int index, double *x, double *y,
+		      double *z, double *m)
+{
+/* reading the Nth POINT */
+    unsigned int off;
+    int type;
+    if (!blob_view_find (view, GAIA_POINT, index, &off, &type))
+	return 0;
+    blob_view_vertex (view, view->blob + off, 0, 1, 0, x, y, z, m);
+    return 1;
+}
+
+GAIAGEO_DECLARE int
+gaiaBlobViewGetLinestring (gaiaBlobViewPtr view, int index, int *points)
+{
+/* retrieving the number of vertices of the Nth LINESTRING */
+    unsigned int off;
+    int type;
+    if (!blob_view_find (view, GAIA_LINESTRING, index, &off, &type))
+	return 0;
+    *points =
+	gaiaImport32 (view->blob + off, view->little_endian,
+		      view->endian_arch);
+    return 1;
+}
+
+GAIAGEO_DECLARE int
+gaiaBlobViewGetLinestringVertex (gaiaBlobViewPtr view, int index, int vertex,
+				 double *x, double *y, double *z, double *m)
+{
+/* reading a single vertex from the Nth LINESTRING */
+    unsigned int off;
+    int type;
+    int class;
+    int compressed;
+    int dimension_model;
+    int points;
+    if (!blob_view_find (view, GAIA_LINESTRING, index, &off, &type))
+	return 0;
+    blob_view_classify (type, &class, &compressed, &dimension_model);
+    points =
+	gaiaImport32 (view->blob + off, view->little_endian,
+		      view->endian_arch);
+    if (vertex < 0 || vertex >= points)
+	return 0;
+    blob_view_vertex (view, view->blob + off + 4, compressed, points, vertex,
+		      x, y, z, m);
+    return 1;
+}
+
+GAIAGEO_DECLARE int
+gaiaBlobViewGetPolygon (gaiaBlobViewPtr view, int index, int *interiors)
+{
+/* retrieving the number of interior rings of the Nth POLYGON */
+    unsigned int off;
+    int type;
+    int rings;
+    if (!blob_view_find (view, GAIA_POLYGON, index, &off, &type))
+	return 0;
+    rings =
+	gaiaImport32 (view->blob + off, view->little_endian,
+		      view->endian_arch);
+    *interiors = (rings > 0) ? rings - 1 : 0;
+    return 1;
+}
+
+static gaiaGeomCollPtr
+doParseTinyPointBlobMbr (const unsigned char *blob, unsigned int size)
+{
+/* decoding from SpatiaLite TinyPoint BLOB (MBR only) */
+    int little_endian;
+    int endian_arch = gaiaEndianArch ();
+    double x;
+    double y;
+    gaiaGeomCollPtr geo = NULL;
+    gaiaPolygonPtr polyg;
+    gaiaRingPtr ring;
+
+    if (size < 24)
+	return NULL;		/* cannot be an internal BLOB TinyPoint geometry */
+    if (*(blob + 0) != GAIA_MARK_START)
+	return NULL;		/* failed to recognize START signature */
+    if (*(blob + (size - 1)) != GAIA_MARK_END)
+	return NULL;		/* failed to recognize END signature */
+    if (*(blob + 1) == GAIA_TINYPOINT_LITTLE_ENDIAN)
+	little_endian = 1;
+    else if (*(blob + 1) == GAIA_TINYPOINT_BIG_ENDIAN)
+	little_endian = 0;
+    else
+	return NULL;		/* unknown encoding; nor little-endian neither big-endian */
+
+    x = gaiaImport64 (blob + 7, little_endian, endian_arch);
+    y = gaiaImport64 (blob + 15, little_endian, endian_arch);
+
+    geo = gaiaAllocGeomColl ();
+    polyg = gaiaAddPolygonToGeomColl (geo, 5, 0);
+    ring = polyg->Exterior;
+    gaiaSetPoint (ring->Coords, 0, x, y);	/* vertex # 1 */
+    gaiaSetPoint (ring->Coords, 1, x, y);	/* vertex # 2 */
+    gaiaSetPoint (ring->Coords, 2, x, y);	/* vertex # 3 */
+    gaiaSetPoint (ring->Coords, 3, x, y);	/* vertex # 4 */
+    gaiaSetPoint (ring->Coords, 4, x, y);	/* vertex # 5 [same as vertex # 1 to close the polygon] */
+    return geo;
+}
+
+GAIAGEO_DECLARE gaiaGeomCollPtr
 gaiaFromSpatiaLiteBlobMbr (const unsigned char *blob, unsigned int size)
 {
 /* decoding from SpatiaLite BLOB to GEOMETRY [MBR only] */
@@ -1568,17 +2282,29 @@ doEncodeTinyPointBlob (gaiaGeomCollPtr geom, unsigned char **result, int *size)
     *size = sz;
 }
 
+static unsigned char *
+doExportCoords (unsigned char *ptr, const double *coords, int points,
+		int dimension_model, int endian_arch)
+{
+/* exporting a whole array of vertices into a SpatiaLite BLOB */
+    int dims = 2;
+    if (dimension_model == GAIA_XY_Z || dimension_model == GAIA_XY_M)
+	dims = 3;
+    else if (dimension_model == GAIA_XY_Z_M)
+	dims = 4;
+    if (points <= 0)
+	return ptr;
+    gaiaExport64Array (ptr, coords, points * dims, GAIA_LITTLE_ENDIAN,
+		       endian_arch);
+    return ptr + (points * dims * 8);
+}
+
 GAIAGEO_DECLARE void
 gaiaToSpatiaLiteBlobWkbEx2 (gaiaGeomCollPtr geom, unsigned char **result,
 			    int *size, int gpkg_mode, int tiny_point)
 {
 /* builds the SpatiaLite BLOB representation for this GEOMETRY */
     int ib;
-    int iv;
-    double x;
-    double y;
-    double z = 0.0;
-    double m = 0.0;
     int entities = 0;
     int n_points = 0;
     int n_linestrings = 0;
@@ -2034,13 +2760,9 @@ gaiaToSpatiaLiteBlobWkbEx2 (gaiaGeomCollPtr geom, unsigned char **result,
 	  gaiaExport32 (ptr + 39, GAIA_LINESTRING, 1, endian_arch);	/* class LINESTRING */
 	  gaiaExport32 (ptr + 43, line->Points, 1, endian_arch);	/* # points */
 	  ptr += 47;
-	  for (iv = 0; iv < line->Points; iv++)
-	    {
-		gaiaGetPoint (line->Coords, iv, &x, &y);
-		gaiaExport64 (ptr, x, 1, endian_arch);
-		gaiaExport64 (ptr + 8, y, 1, endian_arch);
-		ptr += 16;
-	    }
+	  ptr =
+	      doExportCoords (ptr, line->Coords, line->Points, GAIA_XY,
+	  		    endian_arch);
 	  *ptr = GAIA_MARK_END;	/* END signature */
 	  break;
       case GAIA_LINESTRINGZ:
@@ -2055,14 +2777,9 @@ gaiaToSpatiaLiteBlobWkbEx2 (gaiaGeomCollPtr geom, unsigned char **result,
 	  gaiaExport32 (ptr + 39, GAIA_LINESTRINGZ, 1, endian_arch);	/* class LINESTRING XYZ */
 	  gaiaExport32 (ptr + 43, line->Points, 1, endian_arch);	/* # points */
 	  ptr += 47;
-	  for (iv = 0; iv < line->Points; iv++)
-	    {
-		gaiaGetPointXYZ (line->Coords, iv, &x, &y, &z);
-		gaiaExport64 (ptr, x, 1, endian_arch);
-		gaiaExport64 (ptr + 8, y, 1, endian_arch);
-		gaiaExport64 (ptr + 16, z, 1, endian_arch);
-		ptr += 24;
-	    }
+	  ptr =
+	      doExportCoords (ptr, line->Coords, line->Points, GAIA_XY_Z,
+	  		    endian_arch);
 	  *ptr = GAIA_MARK_END;	/* END signature */
 	  break;
       case GAIA_LINESTRINGM:
@@ -2077,14 +2794,9 @@ gaiaToSpatiaLiteBlobWkbEx2 (gaiaGeomCollPtr geom, unsigned char **result,
 	  gaiaExport32 (ptr + 39, GAIA_LINESTRINGM, 1, endian_arch);	/* class LINESTRING XYM */
 	  gaiaExport32 (ptr + 43, line->Points, 1, endian_arch);	/* # points */
 	  ptr += 47;
-	  for (iv = 0; iv < line->Points; iv++)
-	    {
-		gaiaGetPointXYM (line->Coords, iv, &x, &y, &m);
-		gaiaExport64 (ptr, x, 1, endian_arch);
-		gaiaExport64 (ptr + 8, y, 1, endian_arch);
-		gaiaExport64 (ptr + 16, m, 1, endian_arch);
-		ptr += 24;
-	    }
+	  ptr =
+	      doExportCoords (ptr, line->Coords, line->Points, GAIA_XY_M,
+	  		    endian_arch);
 	  *ptr = GAIA_MARK_END;	/* END signature */
 	  break;
       case GAIA_LINESTRINGZM:
@@ -2099,15 +2811,9 @@ gaiaToSpatiaLiteBlobWkbEx2 (gaiaGeomCollPtr geom, unsigned char **result,
 	  gaiaExport32 (ptr + 39, GAIA_LINESTRINGZM, 1, endian_arch);	/* class LINESTRING XYZM */
 	  gaiaExport32 (ptr + 43, line->Points, 1, endian_arch);	/* # points */
 	  ptr += 47;
-	  for (iv = 0; iv < line->Points; iv++)
-	    {
-		gaiaGetPointXYZM (line->Coords, iv, &x, &y, &z, &m);
-		gaiaExport64 (ptr, x, 1, endian_arch);
-		gaiaExport64 (ptr + 8, y, 1, endian_arch);
-		gaiaExport64 (ptr + 16, z, 1, endian_arch);
-		gaiaExport64 (ptr + 24, m, 1, endian_arch);
-		ptr += 32;
-	    }
+	  ptr =
+	      doExportCoords (ptr, line->Coords, line->Points, GAIA_XY_Z_M,
+	  		    endian_arch);
 	  *ptr = GAIA_MARK_END;	/* END signature */
 	  break;
       case GAIA_POLYGON:
@@ -2124,25 +2830,17 @@ gaiaToSpatiaLiteBlobWkbEx2 (gaiaGeomCollPtr geom, unsigned char **result,
 	  rng = polyg->Exterior;
 	  gaiaExport32 (ptr + 47, rng->Points, 1, endian_arch);	/* # points - exterior ring */
 	  ptr += 51;
-	  for (iv = 0; iv < rng->Points; iv++)
-	    {
-		gaiaGetPoint (rng->Coords, iv, &x, &y);
-		gaiaExport64 (ptr, x, 1, endian_arch);	/* X - exterior ring */
-		gaiaExport64 (ptr + 8, y, 1, endian_arch);	/* Y - exterior ring */
-		ptr += 16;
-	    }
+	  ptr =
+	      doExportCoords (ptr, rng->Coords, rng->Points, GAIA_XY,
+	  		    endian_arch);
 	  for (ib = 0; ib < polyg->NumInteriors; ib++)
 	    {
 		rng = polyg->Interiors + ib;
 		gaiaExport32 (ptr, rng->Points, 1, endian_arch);	/* # points - interior ring */
 		ptr += 4;
-		for (iv = 0; iv < rng->Points; iv++)
-		  {
-		      gaiaGetPoint (rng->Coords, iv, &x, &y);
-		      gaiaExport64 (ptr, x, 1, endian_arch);	/* X - interior ring */
-		      gaiaExport64 (ptr + 8, y, 1, endian_arch);	/* Y - interior ring */
-		      ptr += 16;
-		  }
+		ptr =
+		    doExportCoords (ptr, rng->Coords, rng->Points, GAIA_XY,
+				    endian_arch);
 	    }
 	  *ptr = GAIA_MARK_END;	/* END signature */
 	  break;
@@ -2160,27 +2858,17 @@ gaiaToSpatiaLiteBlobWkbEx2 (gaiaGeomCollPtr geom, unsigned char **result,
 	  rng = polyg->Exterior;
 	  gaiaExport32 (ptr + 47, rng->Points, 1, endian_arch);	/* # points - exterior ring */
 	  ptr += 51;
-	  for (iv = 0; iv < rng->Points; iv++)
-	    {
-		gaiaGetPointXYZ (rng->Coords, iv, &x, &y, &z);
-		gaiaExport64 (ptr, x, 1, endian_arch);	/* X - exterior ring */
-		gaiaExport64 (ptr + 8, y, 1, endian_arch);	/* Y - exterior ring */
-		gaiaExport64 (ptr + 16, z, 1, endian_arch);	/* Z - exterior ring */
-		ptr += 24;
-	    }
+	  ptr =
+	      doExportCoords (ptr, rng->Coords, rng->Points, GAIA_XY_Z,
+	  		    endian_arch);
 	  for (ib = 0; ib < polyg->NumInteriors; ib++)
 	    {
 		rng = polyg->Interiors + ib;
 		gaiaExport32 (ptr, rng->Points, 1, endian_arch);	/* # points - interior ring */
 		ptr += 4;
-		for (iv = 0; iv < rng->Points; iv++)
-		  {
-		      gaiaGetPointXYZ (rng->Coords, iv, &x, &y, &z);
-		      gaiaExport64 (ptr, x, 1, endian_arch);	/* X - interior ring */
-		      gaiaExport64 (ptr + 8, y, 1, endian_arch);	/* Y - interior ring */
-		      gaiaExport64 (ptr + 16, z, 1, endian_arch);	/* Z - interior ring */
-		      ptr += 24;
-		  }
+		ptr =
+		    doExportCoords (ptr, rng->Coords, rng->Points, GAIA_XY_Z,
+				    endian_arch);
 	    }
 	  *ptr = GAIA_MARK_END;	/* END signature */
 	  break;
@@ -2198,27 +2886,17 @@ gaiaToSpatiaLiteBlobWkbEx2 (gaiaGeomCollPtr geom, unsigned char **result,
 	  rng = polyg->Exterior;
 	  gaiaExport32 (ptr + 47, rng->Points, 1, endian_arch);	/* # points - exterior ring */
 	  ptr += 51;
-	  for (iv = 0; iv < rng->Points; iv++)
-	    {
-		gaiaGetPointXYM (rng->Coords, iv, &x, &y, &m);
-		gaiaExport64 (ptr, x, 1, endian_arch);	/* X - exterior ring */
-		gaiaExport64 (ptr + 8, y, 1, endian_arch);	/* Y - exterior ring */
-		gaiaExport64 (ptr + 16, m, 1, endian_arch);	/* M - exterior ring */
-		ptr += 24;
-	    }
+	  ptr =
+	      doExportCoords (ptr, rng->Coords, rng->Points, GAIA_XY_M,
+	  		    endian_arch);
 	  for (ib = 0; ib < polyg->NumInteriors; ib++)
 	    {
 		rng = polyg->Interiors + ib;
 		gaiaExport32 (ptr, rng->Points, 1, endian_arch);	/* # points - interior ring */
 		ptr += 4;
-		for (iv = 0; iv < rng->Points; iv++)
-		  {
-		      gaiaGetPointXYM (rng->Coords, iv, &x, &y, &m);
-		      gaiaExport64 (ptr, x, 1, endian_arch);	/* X - interior ring */
-		      gaiaExport64 (ptr + 8, y, 1, endian_arch);	/* Y - interior ring */
-		      gaiaExport64 (ptr + 16, m, 1, endian_arch);	/* M - interior ring */
-		      ptr += 24;
-		  }
+		ptr =
+		    doExportCoords (ptr, rng->Coords, rng->Points, GAIA_XY_M,
+				    endian_arch);
 	    }
 	  *ptr = GAIA_MARK_END;	/* END signature */
 	  break;
@@ -2236,29 +2914,17 @@ gaiaToSpatiaLiteBlobWkbEx2 (gaiaGeomCollPtr geom, unsigned char **result,
 	  rng = polyg->Exterior;
 	  gaiaExport32 (ptr + 47, rng->Points, 1, endian_arch);	/* # points - exterior ring */
 	  ptr += 51;
-	  for (iv = 0; iv < rng->Points; iv++)
-	    {
-		gaiaGetPointXYZM (rng->Coords, iv, &x, &y, &z, &m);
-		gaiaExport64 (ptr, x, 1, endian_arch);	/* X - exterior ring */
-		gaiaExport64 (ptr + 8, y, 1, endian_arch);	/* Y - exterior ring */
-		gaiaExport64 (ptr + 16, z, 1, endian_arch);	/* Z - exterior ring */
-		gaiaExport64 (ptr + 24, m, 1, endian_arch);	/* M - exterior ring */
-		ptr += 32;
-	    }
+	  ptr =
+	      doExportCoords (ptr, rng->Coords, rng->Points, GAIA_XY_Z_M,
+	  		    endian_arch);
 	  for (ib = 0; ib < polyg->NumInteriors; ib++)
 	    {
 		rng = polyg->Interiors + ib;
 		gaiaExport32 (ptr, rng->Points, 1, endian_arch);	/* # points - interior ring */
 		ptr += 4;
-		for (iv = 0; iv < rng->Points; iv++)
-		  {
-		      gaiaGetPointXYZM (rng->Coords, iv, &x, &y, &z, &m);
-		      gaiaExport64 (ptr, x, 1, endian_arch);	/* X - interior ring */
-		      gaiaExport64 (ptr + 8, y, 1, endian_arch);	/* Y - interior ring */
-		      gaiaExport64 (ptr + 16, z, 1, endian_arch);	/* Z - exterior ring */
-		      gaiaExport64 (ptr + 24, m, 1, endian_arch);	/* M - exterior ring */
-		      ptr += 32;
-		  }
+		ptr =
+		    doExportCoords (ptr, rng->Coords, rng->Points, GAIA_XY_Z_M,
+				    endian_arch);
 	    }
 	  *ptr = GAIA_MARK_END;	/* END signature */
 	  break;
@@ -2327,44 +2993,9 @@ gaiaToSpatiaLiteBlobWkbEx2 (gaiaGeomCollPtr geom, unsigned char **result,
 		    gaiaExport32 (ptr + 1, GAIA_LINESTRING, 1, endian_arch);	/* class LINESTRING */
 		gaiaExport32 (ptr + 5, line->Points, 1, endian_arch);	/* # points */
 		ptr += 9;
-		for (iv = 0; iv < line->Points; iv++)
-		  {
-		      if (geom->DimensionModel == GAIA_XY_Z)
-			{
-			    gaiaGetPointXYZ (line->Coords, iv, &x, &y, &z);
-			}
-		      else if (geom->DimensionModel == GAIA_XY_M)
-			{
-			    gaiaGetPointXYM (line->Coords, iv, &x, &y, &m);
-			}
-		      else if (geom->DimensionModel == GAIA_XY_Z_M)
-			{
-			    gaiaGetPointXYZM (line->Coords, iv, &x, &y, &z, &m);
-			}
-		      else
-			{
-			    gaiaGetPoint (line->Coords, iv, &x, &y);
-			}
-		      gaiaExport64 (ptr, x, 1, endian_arch);	/* X */
-		      gaiaExport64 (ptr + 8, y, 1, endian_arch);	/* Y */
-		      ptr += 16;
-		      if (geom->DimensionModel == GAIA_XY_Z)
-			{
-			    gaiaExport64 (ptr, z, 1, endian_arch);	/* Z */
-			    ptr += 8;
-			}
-		      if (geom->DimensionModel == GAIA_XY_M)
-			{
-			    gaiaExport64 (ptr, m, 1, endian_arch);	/* M */
-			    ptr += 8;
-			}
-		      if (geom->DimensionModel == GAIA_XY_Z_M)
-			{
-			    gaiaExport64 (ptr, z, 1, endian_arch);	/* Z */
-			    gaiaExport64 (ptr + 8, m, 1, endian_arch);	/* M */
-			    ptr += 16;
-			}
-		  }
+		ptr =
+		    doExportCoords (ptr, line->Coords, line->Points, geom->DimensionModel,
+				    endian_arch);
 		line = line->Next;
 	    }
 	  polyg = geom->FirstPolygon;
@@ -2383,88 +3014,17 @@ gaiaToSpatiaLiteBlobWkbEx2 (gaiaGeomCollPtr geom, unsigned char **result,
 		rng = polyg->Exterior;
 		gaiaExport32 (ptr + 9, rng->Points, 1, endian_arch);	/* # points - exterior ring */
 		ptr += 13;
-		for (iv = 0; iv < rng->Points; iv++)
-		  {
-		      if (geom->DimensionModel == GAIA_XY_Z)
-			{
-			    gaiaGetPointXYZ (rng->Coords, iv, &x, &y, &z);
-			}
-		      else if (geom->DimensionModel == GAIA_XY_M)
-			{
-			    gaiaGetPointXYM (rng->Coords, iv, &x, &y, &m);
-			}
-		      else if (geom->DimensionModel == GAIA_XY_Z_M)
-			{
-			    gaiaGetPointXYZM (rng->Coords, iv, &x, &y, &z, &m);
-			}
-		      else
-			{
-			    gaiaGetPoint (rng->Coords, iv, &x, &y);
-			}
-		      gaiaExport64 (ptr, x, 1, endian_arch);	/* X - exterior ring */
-		      gaiaExport64 (ptr + 8, y, 1, endian_arch);	/* Y - exterior ring */
-		      ptr += 16;
-		      if (geom->DimensionModel == GAIA_XY_Z)
-			{
-			    gaiaExport64 (ptr, z, 1, endian_arch);	/* Z */
-			    ptr += 8;
-			}
-		      if (geom->DimensionModel == GAIA_XY_M)
-			{
-			    gaiaExport64 (ptr, m, 1, endian_arch);	/* M */
-			    ptr += 8;
-			}
-		      if (geom->DimensionModel == GAIA_XY_Z_M)
-			{
-			    gaiaExport64 (ptr, z, 1, endian_arch);	/* Z */
-			    gaiaExport64 (ptr + 8, m, 1, endian_arch);	/* M */
-			    ptr += 16;
-			}
-		  }
+		ptr =
+		    doExportCoords (ptr, rng->Coords, rng->Points, geom->DimensionModel,
+				    endian_arch);
 		for (ib = 0; ib < polyg->NumInteriors; ib++)
 		  {
 		      rng = polyg->Interiors + ib;
 		      gaiaExport32 (ptr, rng->Points, 1, endian_arch);	/* # points - interior ring */
 		      ptr += 4;
-		      for (iv = 0; iv < rng->Points; iv++)
-			{
-			    if (geom->DimensionModel == GAIA_XY_Z)
-			      {
-				  gaiaGetPointXYZ (rng->Coords, iv, &x, &y, &z);
-			      }
-			    else if (geom->DimensionModel == GAIA_XY_M)
-			      {
-				  gaiaGetPointXYM (rng->Coords, iv, &x, &y, &m);
-			      }
-			    else if (geom->DimensionModel == GAIA_XY_Z_M)
-			      {
-				  gaiaGetPointXYZM (rng->Coords, iv, &x, &y,
-						    &z, &m);
-			      }
-			    else
-			      {
-				  gaiaGetPoint (rng->Coords, iv, &x, &y);
-			      }
-			    gaiaExport64 (ptr, x, 1, endian_arch);	/* X - interior ring */
-			    gaiaExport64 (ptr + 8, y, 1, endian_arch);	/* Y - interior ring */
-			    ptr += 16;
-			    if (geom->DimensionModel == GAIA_XY_Z)
-			      {
-				  gaiaExport64 (ptr, z, 1, endian_arch);	/* Z */
-				  ptr += 8;
-			      }
-			    if (geom->DimensionModel == GAIA_XY_M)
-			      {
-				  gaiaExport64 (ptr, m, 1, endian_arch);	/* M */
-				  ptr += 8;
-			      }
-			    if (geom->DimensionModel == GAIA_XY_Z_M)
-			      {
-				  gaiaExport64 (ptr, z, 1, endian_arch);	/* Z */
-				  gaiaExport64 (ptr + 8, m, 1, endian_arch);	/* M */
-				  ptr += 16;
-			      }
-			}
+		      ptr =
+		          doExportCoords (ptr, rng->Coords, rng->Points, geom->DimensionModel,
+		      		    endian_arch);
 		  }
 		polyg = polyg->Next;
 	    }
@@ -3751,43 +4311,43 @@ gaiaFromWkb (const unsigned char *blob, unsigned int size)
     switch (type)
       {
       case GAIA_POINT:
-	  ParseWkbPoint (geo);
+	  ParseWkbPoint (geo, NULL);
 	  break;
       case GAIA_POINTZ:
       case GAIA_GEOSWKB_POINTZ:
-	  ParseWkbPointZ (geo);
+	  ParseWkbPointZ (geo, NULL);
 	  break;
       case GAIA_POINTM:
-	  ParseWkbPointM (geo);
+	  ParseWkbPointM (geo, NULL);
 	  break;
       case GAIA_POINTZM:
-	  ParseWkbPointZM (geo);
+	  ParseWkbPointZM (geo, NULL);
 	  break;
       case GAIA_LINESTRING:
-	  ParseWkbLine (geo);
+	  ParseWkbLine (geo, NULL);
 	  break;
       case GAIA_LINESTRINGZ:
       case GAIA_GEOSWKB_LINESTRINGZ:
-	  ParseWkbLineZ (geo);
+	  ParseWkbLineZ (geo, NULL);
 	  break;
       case GAIA_LINESTRINGM:
-	  ParseWkbLineM (geo);
+	  ParseWkbLineM (geo, NULL);
 	  break;
       case GAIA_LINESTRINGZM:
-	  ParseWkbLineZM (geo);
+	  ParseWkbLineZM (geo, NULL);
 	  break;
       case GAIA_POLYGON:
-	  ParseWkbPolygon (geo);
+	  ParseWkbPolygon (geo, NULL);
 	  break;
       case GAIA_POLYGONZ:
       case GAIA_GEOSWKB_POLYGONZ:
-	  ParseWkbPolygonZ (geo);
+	  ParseWkbPolygonZ (geo, NULL);
 	  break;
       case GAIA_POLYGONM:
-	  ParseWkbPolygonM (geo);
+	  ParseWkbPolygonM (geo, NULL);
 	  break;
       case GAIA_POLYGONZM:
-	  ParseWkbPolygonZM (geo);
+	  ParseWkbPolygonZM (geo, NULL);
 	  break;
       case GAIA_MULTIPOINT:
       case GAIA_MULTILINESTRING:
@@ -3809,7 +4369,7 @@ gaiaFromWkb (const unsigned char *blob, unsigned int size)
       case GAIA_MULTILINESTRINGZM:
       case GAIA_MULTIPOLYGONZM:
       case GAIA_GEOMETRYCOLLECTIONZM:
-	  ParseWkbGeometry (geo, 1);
+	  ParseWkbGeometry (geo, NULL, 1);
 	  break;
       default:
 	  break;
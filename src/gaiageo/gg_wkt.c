@@ -48,6 +48,7 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
 
 #if defined(_WIN32) && !defined(__MINGW32__)
 #include "config-msvc.h"
@@ -58,36 +59,11 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <spatialite/sqlite.h>
 
 #include <spatialite/gaiageo.h>
+#include <spatialite_private.h>
 
-static void
-gaiaOutClean (char *buffer)
-{
-/* cleans unneeded trailing zeros */
-    int i;
-    for (i = strlen (buffer) - 1; i > 0; i--)
-      {
-	  if (buffer[i] == '0')
-	      buffer[i] = '\0';
-	  else
-	      break;
-      }
-    if (buffer[i] == '.')
-	buffer[i] = '\0';
-    if (strcmp (buffer, "-0") == 0)
-      {
-	  /* avoiding to return embarassing NEGATIVE ZEROes */
-	  strcpy (buffer, "0");
-      }
-
-    if (strcmp (buffer, "-1.#QNAN") == 0 || strcmp (buffer, "NaN") == 0
-	|| strcmp (buffer, "1.#QNAN") == 0
-	|| strcmp (buffer, "-1.#IND") == 0 || strcmp (buffer, "1.#IND") == 0)
-      {
-	  /* on Windows a NaN could be represented in "odd" ways */
-	  /* this is intended to restore a consistent behaviour  */
-	  strcpy (buffer, "nan");
-      }
-}
+#ifdef _WIN32
+#define strncasecmp	_strnicmp
+#endif /* not WIN32 */
 
 GAIAGEO_DECLARE void
 gaiaOutBufferInitialize (gaiaOutBufferPtr buf)
@@ -111,112 +87,598 @@ gaiaOutBufferReset (gaiaOutBufferPtr buf)
     buf->Error = 0;
 }
 
+static int
+out_buffer_reserve (gaiaOutBufferPtr buf, int len)
+{
+/* making sure that the output buffer has room for at least len bytes */
+    int new_size;
+    char *new_buf;
+    int free_size = buf->BufferSize - buf->WriteOffset;
+    if (len <= free_size)
+	return 1;
+    /* we must allocate a bigger buffer */
+    if (buf->BufferSize == 0)
+	new_size = len + 1024;
+    else if (buf->BufferSize <= 4196)
+	new_size = buf->BufferSize + len + 4196;
+    else if (buf->BufferSize <= 65536)
+	new_size = buf->BufferSize + len + 65536;
+    else
+	new_size = buf->BufferSize + len + (1024 * 1024);
+    new_buf = malloc (new_size);
+    if (!new_buf)
+      {
+	  buf->Error = 1;
+	  return 0;
+      }
+    memcpy (new_buf, buf->Buffer, buf->WriteOffset);
+    if (buf->Buffer)
+	free (buf->Buffer);
+    buf->Buffer = new_buf;
+    buf->BufferSize = new_size;
+    return 1;
+}
+
+static void
+out_buffer_append (gaiaOutBufferPtr buf, const char *text, int len)
+{
+/* appending len bytes of a text string */
+    if (!out_buffer_reserve (buf, len + 1))
+	return;
+    memcpy (buf->Buffer + buf->WriteOffset, text, len);
+    buf->WriteOffset += len;
+    *(buf->Buffer + buf->WriteOffset) = '\0';
+}
+
 GAIAGEO_DECLARE void
 gaiaAppendToOutBuffer (gaiaOutBufferPtr buf, const char *text)
 {
 /* appending a text string */
-    int len = strlen (text);
-    int free_size = buf->BufferSize - buf->WriteOffset;
-    if ((len + 1) > free_size)
+    out_buffer_append (buf, text, strlen (text));
+}
+
+/*
+/ fast formatting of coordinate values
+/
+/ the decimal digits are generated by the Grisu2 algorithm (Florian
+/ Loitsch: "Printing Floating-Point Numbers Quickly and Accurately with
+/ Integers", PLDI 2010): they always read back as the very same double,
+/ and are the shortest possible ones in the vast majority of cases; the
+/ few doubtful cases are detected while generating the digits, and then
+/ settled by shortest_digits().
+/
+/ a fixed precision is then applied by rounding these digits half away
+/ from zero, never exceeding 16 significant digits: this is the same
+/ format formerly produced by sqlite3_mprintf("%.*f") + gaiaOutClean(),
+/ but without any malloc() and without any printf() parsing.
+*/
+
+#define GAIA_DTOA_MAX	352	/* max length of a formatted double */
+
+struct diy_fp
+{
+/* an unnormalized floating point: f * 2^e */
+    sqlite3_uint64 f;
+    int e;
+};
+
+/* cached powers of ten: 10^-348, 10^-340 ... 10^340 */
+static const sqlite3_uint64 cached_powers_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const short cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954,
+    -927, -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635,
+    -608, -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316,
+    -289, -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30, 56,
+    83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348, 375, 402, 428, 455,
+    481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800, 827, 853,
+    880, 907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const sqlite3_uint64 pow10_table[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL,
+    10000000000000000000ULL
+};
+
+static struct diy_fp
+diy_fp_multiply (struct diy_fp x, struct diy_fp y)
+{
+/* multiplying two 64 bit significands, keeping the upper (rounded) half */
+    const sqlite3_uint64 mask = 0xFFFFFFFFULL;
+    sqlite3_uint64 a = x.f >> 32;
+    sqlite3_uint64 b = x.f & mask;
+    sqlite3_uint64 c = y.f >> 32;
+    sqlite3_uint64 d = y.f & mask;
+    sqlite3_uint64 ac = a * c;
+    sqlite3_uint64 bc = b * c;
+    sqlite3_uint64 ad = a * d;
+    sqlite3_uint64 bd = b * d;
+    sqlite3_uint64 tmp = (bd >> 32) + (ad & mask) + (bc & mask);
+    struct diy_fp r;
+    tmp += 1ULL << 31;
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    r.e = x.e + y.e + 64;
+    return r;
+}
+
+static void
+grisu_round (char *digits, int len, sqlite3_uint64 delta, sqlite3_uint64 rest,
+	     sqlite3_uint64 ten_kappa, sqlite3_uint64 wp_w)
+{
+/* moving the last digit as close as possible to the exact value */
+    while (rest < wp_w && delta - rest >= ten_kappa
+	   && (rest + ten_kappa < wp_w
+	       || wp_w - rest > rest + ten_kappa - wp_w))
       {
-	  /* we must allocate a bigger buffer */
-	  int new_size;
-	  char *new_buf;
-	  if (buf->BufferSize == 0)
-	      new_size = (len + 1) + 1024;
-	  else if (buf->BufferSize <= 4196)
-	      new_size = buf->BufferSize + (len + 1) + 4196;
-	  else if (buf->BufferSize <= 65536)
-	      new_size = buf->BufferSize + (len + 1) + 65536;
+	  digits[len - 1]--;
+	  rest += ten_kappa;
+      }
+}
+
+static int
+grisu_digits (double value, char *digits, int *exp10, int *doubtful)
+{
+/*
+/ generating the decimal digits of a positive and finite value,
+/ so that value = digits * 10^exp10
+/
+/ doubtful is set when a candidate having one digit less lies so
+/ close to the (slightly narrowed) rounding interval that it could
+/ possibly be a valid shorter representation
+/
+/ returns the number of digits (17 at most)
+*/
+    sqlite3_uint64 bits;
+    sqlite3_uint64 delta;
+    sqlite3_uint64 wp_w;
+    sqlite3_uint64 p2;
+    sqlite3_uint64 rest;
+    sqlite3_uint64 ten_kappa;
+    sqlite3_uint64 margin = 4;	/* the narrowing plus the scaling errors */
+    int near;
+    unsigned int p1;
+    unsigned int d;
+    struct diy_fp v;
+    struct diy_fp w_m;
+    struct diy_fp w_p;
+    struct diy_fp c_mk;
+    double dk;
+    int biased_e;
+    int k;
+    int index;
+    int kappa;
+    int shift;
+    int len = 0;
+
+    memcpy (&bits, &value, sizeof (double));
+    biased_e = (int) ((bits >> 52) & 0x7FF);
+    v.f = bits & 0x000FFFFFFFFFFFFFULL;
+    if (biased_e != 0)
+      {
+	  v.f += 0x0010000000000000ULL;
+	  v.e = biased_e - 1075;
+      }
+    else
+	v.e = -1074;
+
+/* the boundaries of the rounding interval */
+    w_p.f = (v.f << 1) + 1;
+    w_p.e = v.e - 1;
+    while (!(w_p.f & 0x0020000000000000ULL))
+      {
+	  w_p.f <<= 1;
+	  w_p.e--;
+      }
+    w_p.f <<= 10;
+    w_p.e -= 10;
+    if (v.f == 0x0010000000000000ULL)
+      {
+	  w_m.f = (v.f << 2) - 1;
+	  w_m.e = v.e - 2;
+      }
+    else
+      {
+	  w_m.f = (v.f << 1) - 1;
+	  w_m.e = v.e - 1;
+      }
+    w_m.f <<= w_m.e - w_p.e;
+    w_m.e = w_p.e;
+
+/* normalizing the value itself */
+    while (!(v.f & 0x0010000000000000ULL))
+      {
+	  v.f <<= 1;
+	  v.e--;
+      }
+    v.f <<= 11;
+    v.e -= 11;
+
+/* scaling by a cached power of ten */
+    dk = (-61 - w_p.e) * 0.30102999566398114 + 347;
+    k = (int) dk;
+    if (dk - k > 0.0)
+	k++;
+    index = (k >> 3) + 1;
+    *exp10 = -(-348 + index * 8);
+    c_mk.f = cached_powers_f[index];
+    c_mk.e = cached_powers_e[index];
+    v = diy_fp_multiply (v, c_mk);
+    w_p = diy_fp_multiply (w_p, c_mk);
+    w_m = diy_fp_multiply (w_m, c_mk);
+    w_m.f++;
+    w_p.f--;
+
+/* generating the digits */
+    delta = w_p.f - w_m.f;
+    wp_w = w_p.f - v.f;
+    shift = -w_p.e;
+    p1 = (unsigned int) (w_p.f >> shift);
+    p2 = w_p.f & ((1ULL << shift) - 1);
+    kappa = 1;
+    while (kappa < 10 && p1 >= pow10_table[kappa])
+	kappa++;
+/* the next power of ten (e.g. 1e23) is the candidate with no digits */
+    near = (sqlite3_uint64) p1 + 1 == pow10_table[kappa]
+	&& (1ULL << shift) - p2 <= margin;
+    while (kappa > 0)
+      {
+	  d = p1 / (unsigned int) pow10_table[kappa - 1];
+	  p1 %= (unsigned int) pow10_table[kappa - 1];
+	  if (d || len)
+	      digits[len++] = (char) ('0' + d);
+	  kappa--;
+	  rest = ((sqlite3_uint64) p1 << shift) + p2;
+	  ten_kappa = pow10_table[kappa] << shift;
+	  if (rest <= delta)
+	    {
+		*exp10 += kappa;
+		*doubtful = near;
+		grisu_round (digits, len, delta, rest, ten_kappa, wp_w);
+		return len;
+	    }
+	  near = rest - delta <= margin || ten_kappa - rest <= margin;
+      }
+    while (1)
+      {
+	  p2 *= 10;
+	  delta *= 10;
+	  margin *= 10;
+	  d = (unsigned int) (p2 >> shift);
+	  if (d || len)
+	      digits[len++] = (char) ('0' + d);
+	  p2 &= (1ULL << shift) - 1;
+	  kappa--;
+	  ten_kappa = 1ULL << shift;
+	  if (p2 < delta)
+	    {
+		*exp10 += kappa;
+		*doubtful = near;
+		grisu_round (digits, len, delta, p2, ten_kappa,
+			     (-kappa < 20) ? wp_w * pow10_table[-kappa] : 0);
+		return len;
+	    }
+	  near = p2 - delta <= margin || ten_kappa - p2 <= margin;
+      }
+}
+
+static int
+exact_round_up (double value, int point, int pos)
+{
+/*
+/ the shortest digits end just on a "5": the exact binary value
+/ could be either slightly below or slightly above such a midpoint,
+/ so the decision is taken by examining its exact decimal expansion
+*/
+    char exact[80];
+    const char *p;
+    int exp10;
+    snprintf (exact, sizeof (exact), "%.56e", value);
+    p = strchr (exact, 'e');
+    if (p == NULL)
+	return 1;
+    exp10 = atoi (p + 1) + 1;
+    if (exp10 != point)
+	return 1;
+    if (pos == 0)
+	return exact[0] >= '5';
+    return exact[pos + 1] >= '5';	/* skipping the decimal point */
+}
+
+static int
+reads_back (double value, const char *digits, int n, int point)
+{
+/* checking if digits * 10^(point - n) reads back as the same double */
+    char text[48];
+    double back;
+    text[0] = '0';
+    text[1] = '.';
+    memcpy (text + 2, digits, n);
+    sprintf (text + 2 + n, "e%d", point);
+    back = strtod (text, NULL);
+    return memcmp (&back, &value, sizeof (double)) == 0;
+}
+
+static int
+shorter_digits (const char *digits, int n, int round_up, char *shorter,
+		int *point)
+{
+/*
+/ dropping the last digit, truncating or rounding up
+/
+/ returns the number of digits (trailing zeros excluded)
+*/
+    int len = n - 1;
+    int i;
+    memcpy (shorter, digits, len);
+    if (round_up)
+      {
+	  i = len - 1;
+	  while (i >= 0 && shorter[i] == '9')
+	      i--;
+	  if (i < 0)
+	    {
+		shorter[0] = '1';
+		len = 1;
+		*point += 1;
+	    }
 	  else
-	      new_size = buf->BufferSize + (len + 1) + (1024 * 1024);
-	  new_buf = malloc (new_size);
-	  if (!new_buf)
 	    {
-		buf->Error = 1;
-		return;
+		shorter[i]++;
+		len = i + 1;
 	    }
-	  memcpy (new_buf, buf->Buffer, buf->WriteOffset);
-	  if (buf->Buffer)
-	      free (buf->Buffer);
-	  buf->Buffer = new_buf;
-	  buf->BufferSize = new_size;
       }
-    strcpy (buf->Buffer + buf->WriteOffset, text);
-    buf->WriteOffset += len;
+    while (len > 1 && shorter[len - 1] == '0')
+	len--;
+    return len;
+}
+
+static int
+shortest_digits (double value, char *digits, int n, int *point)
+{
+/*
+/ Grisu2 slightly narrows the rounding interval, so it can miss a
+/ shorter representation lying close to its boundaries (e.g. 1e23,
+/ printed as 9999999999999999e7); both the candidates having one
+/ digit less are verified here by reading them back
+/
+/ returns the number of digits
+*/
+    char shorter[32];
+    int len;
+    int pt;
+    int round_up;
+    while (n > 1)
+      {
+	  /* trying the nearest candidate first */
+	  round_up = digits[n - 1] >= '5';
+	  pt = *point;
+	  len = shorter_digits (digits, n, round_up, shorter, &pt);
+	  if (!reads_back (value, shorter, len, pt))
+	    {
+		pt = *point;
+		len = shorter_digits (digits, n, !round_up, shorter, &pt);
+		if (!reads_back (value, shorter, len, pt))
+		    break;
+	    }
+	  memcpy (digits, shorter, len);
+	  n = len;
+	  *point = pt;
+      }
+    return n;
+}
+
+static int
+format_double (char *out, double value, int precision)
+{
+/*
+/ formats a double (positional notation, no trailing zeros)
+/ out must be able to store GAIA_DTOA_MAX bytes
+/
+/ returns the length of the formatted string
+*/
+    sqlite3_uint64 bits;
+    char digits[32];
+    char *p = out;
+    int n;
+    int exp10;
+    int point;
+    int keep;
+    int doubtful;
+    int i;
+
+    memcpy (&bits, &value, sizeof (double));
+    if (((bits >> 52) & 0x7FF) == 0x7FF)
+      {
+	  /* NaN or Infinity */
+	  if (bits & 0x000FFFFFFFFFFFFFULL)
+	      strcpy (out, "nan");
+	  else if (value < 0.0)
+	      strcpy (out, "-Inf");
+	  else
+	      strcpy (out, "Inf");
+	  return strlen (out);
+      }
+    if (value == 0.0)
+	goto zero;
+    if (value < 0.0)
+      {
+	  *p++ = '-';
+	  value = -value;
+      }
+    n = grisu_digits (value, digits, &exp10, &doubtful);
+    point = n + exp10;		/* digits before the decimal point */
+
+    if (precision != GAIA_PRECISION_SHORTEST)
+      {
+	  /* rounding to the required number of decimals */
+	  if (precision < 0)
+	      precision = 6;
+	  keep = point + precision;
+	  if (keep > 16)
+	      keep = 16;
+	  if (keep < n)
+	    {
+		if (keep < 0)
+		    n = 0;
+		else if (digits[keep] > '5'
+			 || (digits[keep] == '5'
+			     && (keep + 1 < n
+				 || exact_round_up (value, point, keep))))
+		  {
+		      /* rounding up */
+		      i = keep - 1;
+		      while (i >= 0 && digits[i] == '9')
+			  i--;
+		      if (i < 0)
+			{
+			    digits[0] = '1';
+			    n = 1;
+			    point++;
+			}
+		      else
+			{
+			    digits[i]++;
+			    n = i + 1;
+			}
+		  }
+		else
+		    n = keep;
+	    }
+      }
+    else if (doubtful)
+	n = shortest_digits (value, digits, n, &point);
+    while (n > 0 && digits[n - 1] == '0')
+	n--;
+    if (n == 0)
+	goto zero;		/* avoiding to return NEGATIVE ZEROes */
+
+    if (point <= 0)
+      {
+	  /* 0.000ddd */
+	  *p++ = '0';
+	  *p++ = '.';
+	  for (i = point; i < 0; i++)
+	      *p++ = '0';
+	  memcpy (p, digits, n);
+	  p += n;
+      }
+    else if (point >= n)
+      {
+	  /* ddd000 */
+	  memcpy (p, digits, n);
+	  p += n;
+	  for (i = n; i < point; i++)
+	      *p++ = '0';
+      }
+    else
+      {
+	  /* ddd.ddd */
+	  memcpy (p, digits, point);
+	  p += point;
+	  *p++ = '.';
+	  memcpy (p, digits + point, n - point);
+	  p += n - point;
+      }
+    *p = '\0';
+    return p - out;
+
+  zero:
+    strcpy (out, "0");
+    return 1;
+}
+
+GAIAGEO_DECLARE void
+gaiaAppendDoubleToOutBuffer (gaiaOutBufferPtr buf, double value,
+			     int precision)
+{
+/* appending a formatted double */
+    if (!out_buffer_reserve (buf, GAIA_DTOA_MAX))
+	return;
+    buf->WriteOffset +=
+	format_double (buf->Buffer + buf->WriteOffset, value, precision);
+}
+
+static void
+out_coords (gaiaOutBufferPtr out_buf, int precision, const char *pattern, ...)
+{
+/*
+/ appending some coordinates: each '%' in the pattern is replaced by
+/ the next (double) argument, the other chars are copied as they are
+*/
+    va_list ap;
+    const char *start = pattern;
+    const char *p = pattern;
+    va_start (ap, pattern);
+    while (1)
+      {
+	  if (*p == '%' || *p == '\0')
+	    {
+		if (p > start)
+		    out_buffer_append (out_buf, start, p - start);
+		if (*p == '\0')
+		    break;
+		gaiaAppendDoubleToOutBuffer (out_buf, va_arg (ap, double),
+					     precision);
+		start = p + 1;
+	    }
+	  p++;
+      }
+    va_end (ap);
 }
 
 static void
 gaiaOutPointStrict (gaiaOutBufferPtr out_buf, gaiaPointPtr point, int precision)
 {
 /* formats a WKT POINT [Strict 2D] */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
-    buf_x = sqlite3_mprintf ("%.*f", precision, point->X);
-    gaiaOutClean (buf_x);
-    buf_y = sqlite3_mprintf ("%.*f", precision, point->Y);
-    gaiaOutClean (buf_y);
-    buf = sqlite3_mprintf ("%s %s", buf_x, buf_y);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+    out_coords (out_buf, precision, "% %", point->X, point->Y);
 }
 
 static void
 gaiaOutPoint (gaiaOutBufferPtr out_buf, gaiaPointPtr point, int precision)
 {
 /* formats a WKT POINT */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
-    if (precision < 0)
-	buf_x = sqlite3_mprintf ("%1.6f", point->X);
-    else
-	buf_x = sqlite3_mprintf ("%.*f", precision, point->X);
-    gaiaOutClean (buf_x);
-    if (precision < 0)
-	buf_y = sqlite3_mprintf ("%1.6f", point->Y);
-    else
-	buf_y = sqlite3_mprintf ("%.*f", precision, point->Y);
-    gaiaOutClean (buf_y);
-    buf = sqlite3_mprintf ("%s %s", buf_x, buf_y);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+    out_coords (out_buf, precision, "% %", point->X, point->Y);
 }
 
 GAIAGEO_DECLARE void
 gaiaOutPointZex (gaiaOutBufferPtr out_buf, gaiaPointPtr point, int precision)
 {
 /* formats a WKT POINTZ */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf;
-    if (precision < 0)
-	buf_x = sqlite3_mprintf ("%1.6f", point->X);
-    else
-	buf_x = sqlite3_mprintf ("%.*f", precision, point->X);
-    gaiaOutClean (buf_x);
-    if (precision < 0)
-	buf_y = sqlite3_mprintf ("%1.6f", point->Y);
-    else
-	buf_y = sqlite3_mprintf ("%.*f", precision, point->Y);
-    gaiaOutClean (buf_y);
-    if (precision < 0)
-	buf_z = sqlite3_mprintf ("%1.6f", point->Z);
-    else
-	buf_z = sqlite3_mprintf ("%.*f", precision, point->Z);
-    gaiaOutClean (buf_z);
-    buf = sqlite3_mprintf ("%s %s %s", buf_x, buf_y, buf_z);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    sqlite3_free (buf_z);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+    out_coords (out_buf, precision, "% % %", point->X, point->Y, point->Z);
 }
 
 GAIAGEO_DECLARE void
@@ -233,157 +695,44 @@ static void
 gaiaOutPointM (gaiaOutBufferPtr out_buf, gaiaPointPtr point, int precision)
 {
 /* formats a WKT POINTM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_m;
-    char *buf;
-    if (precision < 0)
-	buf_x = sqlite3_mprintf ("%1.6f", point->X);
-    else
-	buf_x = sqlite3_mprintf ("%.*f", precision, point->X);
-    gaiaOutClean (buf_x);
-    if (precision < 0)
-	buf_y = sqlite3_mprintf ("%1.6f", point->Y);
-    else
-	buf_y = sqlite3_mprintf ("%.*f", precision, point->Y);
-    gaiaOutClean (buf_y);
-    if (precision < 0)
-	buf_m = sqlite3_mprintf ("%1.6f", point->M);
-    else
-	buf_m = sqlite3_mprintf ("%.*f", precision, point->M);
-    gaiaOutClean (buf_m);
-    buf = sqlite3_mprintf ("%s %s %s", buf_x, buf_y, buf_m);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    sqlite3_free (buf_m);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+    out_coords (out_buf, precision, "% % %", point->X, point->Y, point->M);
 }
 
 static void
 gaiaOutPointZM (gaiaOutBufferPtr out_buf, gaiaPointPtr point, int precision)
 {
 /* formats a WKT POINTZM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf_m;
-    char *buf;
-    if (precision < 0)
-	buf_x = sqlite3_mprintf ("%1.6f", point->X);
-    else
-	buf_x = sqlite3_mprintf ("%.*f", precision, point->X);
-    gaiaOutClean (buf_x);
-    if (precision < 0)
-	buf_y = sqlite3_mprintf ("%1.6f", point->Y);
-    else
-	buf_y = sqlite3_mprintf ("%.*f", precision, point->Y);
-    gaiaOutClean (buf_y);
-    if (precision < 0)
-	buf_z = sqlite3_mprintf ("%1.6f", point->Z);
-    else
-	buf_z = sqlite3_mprintf ("%.*f", precision, point->Z);
-    gaiaOutClean (buf_z);
-    if (precision < 0)
-	buf_m = sqlite3_mprintf ("%1.6f", point->M);
-    else
-	buf_m = sqlite3_mprintf ("%.*f", precision, point->M);
-    gaiaOutClean (buf_m);
-    buf = sqlite3_mprintf ("%s %s %s %s", buf_x, buf_y, buf_z, buf_m);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    sqlite3_free (buf_z);
-    sqlite3_free (buf_m);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+    out_coords (out_buf, precision, "% % % %", point->X, point->Y, point->Z,
+		point->M);
 }
 
 static void
 gaiaOutEwktPoint (gaiaOutBufferPtr out_buf, gaiaPointPtr point)
 {
 /* formats an EWKT POINT */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
-    buf_x = sqlite3_mprintf ("%1.15f", point->X);
-    gaiaOutClean (buf_x);
-    buf_y = sqlite3_mprintf ("%1.15f", point->Y);
-    gaiaOutClean (buf_y);
-    buf = sqlite3_mprintf ("%s %s", buf_x, buf_y);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+    out_coords (out_buf, 15, "% %", point->X, point->Y);
 }
 
 GAIAGEO_DECLARE void
 gaiaOutEwktPointZ (gaiaOutBufferPtr out_buf, gaiaPointPtr point)
 {
 /* formats an EWKT POINTZ */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf;
-    buf_x = sqlite3_mprintf ("%1.15f", point->X);
-    gaiaOutClean (buf_x);
-    buf_y = sqlite3_mprintf ("%1.15f", point->Y);
-    gaiaOutClean (buf_y);
-    buf_z = sqlite3_mprintf ("%1.15f", point->Z);
-    gaiaOutClean (buf_z);
-    buf = sqlite3_mprintf ("%s %s %s", buf_x, buf_y, buf_z);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    sqlite3_free (buf_z);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+    out_coords (out_buf, 15, "% % %", point->X, point->Y, point->Z);
 }
 
 static void
 gaiaOutEwktPointM (gaiaOutBufferPtr out_buf, gaiaPointPtr point)
 {
 /* formats an EWKT POINTM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_m;
-    char *buf;
-    buf_x = sqlite3_mprintf ("%1.15f", point->X);
-    gaiaOutClean (buf_x);
-    buf_y = sqlite3_mprintf ("%1.15f", point->Y);
-    gaiaOutClean (buf_y);
-    buf_m = sqlite3_mprintf ("%1.15f", point->M);
-    gaiaOutClean (buf_m);
-    buf = sqlite3_mprintf ("%s %s %s", buf_x, buf_y, buf_m);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    sqlite3_free (buf_m);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+    out_coords (out_buf, 15, "% % %", point->X, point->Y, point->M);
 }
 
 static void
 gaiaOutEwktPointZM (gaiaOutBufferPtr out_buf, gaiaPointPtr point)
 {
 /* formats an EWKT POINTZM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf_m;
-    char *buf;
-    buf_x = sqlite3_mprintf ("%1.15f", point->X);
-    gaiaOutClean (buf_x);
-    buf_y = sqlite3_mprintf ("%1.15f", point->Y);
-    gaiaOutClean (buf_y);
-    buf_z = sqlite3_mprintf ("%1.15f", point->Z);
-    gaiaOutClean (buf_z);
-    buf_m = sqlite3_mprintf ("%1.15f", point->M);
-    gaiaOutClean (buf_m);
-    buf = sqlite3_mprintf ("%s %s %s %s", buf_x, buf_y, buf_z, buf_m);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    sqlite3_free (buf_z);
-    sqlite3_free (buf_m);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+    out_coords (out_buf, 15, "% % % %", point->X, point->Y, point->Z,
+		point->M);
 }
 
 static void
@@ -391,9 +740,6 @@ gaiaOutLinestringStrict (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line,
 			 int precision)
 {
 /* formats a WKT LINESTRING [Strict 2D] */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
     double x;
     double y;
     double z;
@@ -417,18 +763,10 @@ gaiaOutLinestringStrict (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line,
 	    {
 		gaiaGetPoint (line->Coords, iv, &x, &y);
 	    }
-	  buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
 	  if (iv > 0)
-	      buf = sqlite3_mprintf (",%s %s", buf_x, buf_y);
+	      out_coords (out_buf, precision, ",% %", x, y);
 	  else
-	      buf = sqlite3_mprintf ("%s %s", buf_x, buf_y);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, "% %", x, y);
       }
 }
 
@@ -437,33 +775,16 @@ gaiaOutLinestring (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line,
 		   int precision)
 {
 /* formats a WKT LINESTRING */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
     double x;
     double y;
     int iv;
     for (iv = 0; iv < line->Points; iv++)
       {
 	  gaiaGetPoint (line->Coords, iv, &x, &y);
-	  if (precision < 0)
-	      buf_x = sqlite3_mprintf ("%1.6f", x);
-	  else
-	      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  if (precision < 0)
-	      buf_y = sqlite3_mprintf ("%1.6f", y);
-	  else
-	      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
 	  if (iv > 0)
-	      buf = sqlite3_mprintf (", %s %s", buf_x, buf_y);
+	      out_coords (out_buf, precision, ", % %", x, y);
 	  else
-	      buf = sqlite3_mprintf ("%s %s", buf_x, buf_y);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, "% %", x, y);
       }
 }
 
@@ -472,10 +793,6 @@ gaiaOutLinestringZex (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line,
 		      int precision)
 {
 /* formats a WKT LINESTRINGZ */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf;
     double x;
     double y;
     double z;
@@ -483,30 +800,10 @@ gaiaOutLinestringZex (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line,
     for (iv = 0; iv < line->Points; iv++)
       {
 	  gaiaGetPointXYZ (line->Coords, iv, &x, &y, &z);
-	  if (precision < 0)
-	      buf_x = sqlite3_mprintf ("%1.6f", x);
-	  else
-	      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  if (precision < 0)
-	      buf_y = sqlite3_mprintf ("%1.6f", y);
-	  else
-	      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
-	  if (precision < 0)
-	      buf_z = sqlite3_mprintf ("%1.6f", z);
-	  else
-	      buf_z = sqlite3_mprintf ("%.*f", precision, z);
-	  gaiaOutClean (buf_z);
 	  if (iv > 0)
-	      buf = sqlite3_mprintf (", %s %s %s", buf_x, buf_y, buf_z);
+	      out_coords (out_buf, precision, ", % % %", x, y, z);
 	  else
-	      buf = sqlite3_mprintf ("%s %s %s", buf_x, buf_y, buf_z);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_z);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, "% % %", x, y, z);
       }
 }
 
@@ -525,10 +822,6 @@ gaiaOutLinestringM (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line,
 		    int precision)
 {
 /* formats a WKT LINESTRINGM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_m;
-    char *buf;
     double x;
     double y;
     double m;
@@ -536,30 +829,10 @@ gaiaOutLinestringM (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line,
     for (iv = 0; iv < line->Points; iv++)
       {
 	  gaiaGetPointXYM (line->Coords, iv, &x, &y, &m);
-	  if (precision < 0)
-	      buf_x = sqlite3_mprintf ("%1.6f", x);
-	  else
-	      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  if (precision < 0)
-	      buf_y = sqlite3_mprintf ("%1.6f", y);
-	  else
-	      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
-	  if (precision < 0)
-	      buf_m = sqlite3_mprintf ("%1.6f", m);
-	  else
-	      buf_m = sqlite3_mprintf ("%.*f", precision, m);
-	  gaiaOutClean (buf_m);
 	  if (iv > 0)
-	      buf = sqlite3_mprintf (", %s %s %s", buf_x, buf_y, buf_m);
+	      out_coords (out_buf, precision, ", % % %", x, y, m);
 	  else
-	      buf = sqlite3_mprintf ("%s %s %s", buf_x, buf_y, buf_m);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_m);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, "% % %", x, y, m);
       }
 }
 
@@ -568,11 +841,6 @@ gaiaOutLinestringZM (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line,
 		     int precision)
 {
 /* formats a WKT LINESTRINGZM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf_m;
-    char *buf;
     double x;
     double y;
     double z;
@@ -581,37 +849,10 @@ gaiaOutLinestringZM (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line,
     for (iv = 0; iv < line->Points; iv++)
       {
 	  gaiaGetPointXYZM (line->Coords, iv, &x, &y, &z, &m);
-	  if (precision < 0)
-	      buf_x = sqlite3_mprintf ("%1.6f", x);
-	  else
-	      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  if (precision < 0)
-	      buf_y = sqlite3_mprintf ("%1.6f", y);
-	  else
-	      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
-	  if (precision < 0)
-	      buf_z = sqlite3_mprintf ("%1.6f", z);
-	  else
-	      buf_z = sqlite3_mprintf ("%.*f", precision, z);
-	  gaiaOutClean (buf_z);
-	  if (precision < 0)
-	      buf_m = sqlite3_mprintf ("%1.6f", m);
-	  else
-	      buf_m = sqlite3_mprintf ("%.*f", precision, m);
-	  gaiaOutClean (buf_m);
 	  if (iv > 0)
-	      buf =
-		  sqlite3_mprintf (", %s %s %s %s", buf_x, buf_y, buf_z, buf_m);
+	      out_coords (out_buf, precision, ", % % % %", x, y, z, m);
 	  else
-	      buf = sqlite3_mprintf ("%s %s %s %s", buf_x, buf_y, buf_z, buf_m);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_z);
-	  sqlite3_free (buf_m);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, "% % % %", x, y, z, m);
       }
 }
 
@@ -619,27 +860,16 @@ static void
 gaiaOutEwktLinestring (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line)
 {
 /* formats an EWKT LINESTRING */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
     double x;
     double y;
     int iv;
     for (iv = 0; iv < line->Points; iv++)
       {
 	  gaiaGetPoint (line->Coords, iv, &x, &y);
-	  buf_x = sqlite3_mprintf ("%1.15f", x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%1.15f", y);
-	  gaiaOutClean (buf_y);
 	  if (iv > 0)
-	      buf = sqlite3_mprintf (",%s %s", buf_x, buf_y);
+	      out_coords (out_buf, 15, ",% %", x, y);
 	  else
-	      buf = sqlite3_mprintf ("%s %s", buf_x, buf_y);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, 15, "% %", x, y);
       }
 }
 
@@ -647,10 +877,6 @@ GAIAGEO_DECLARE void
 gaiaOutEwktLinestringZ (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line)
 {
 /* formats an EWKT LINESTRINGZ */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf;
     double x;
     double y;
     double z;
@@ -658,21 +884,10 @@ gaiaOutEwktLinestringZ (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line)
     for (iv = 0; iv < line->Points; iv++)
       {
 	  gaiaGetPointXYZ (line->Coords, iv, &x, &y, &z);
-	  buf_x = sqlite3_mprintf ("%1.15f", x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%1.15f", y);
-	  gaiaOutClean (buf_y);
-	  buf_z = sqlite3_mprintf ("%1.15f", z);
-	  gaiaOutClean (buf_z);
 	  if (iv > 0)
-	      buf = sqlite3_mprintf (",%s %s %s", buf_x, buf_y, buf_z);
+	      out_coords (out_buf, 15, ",% % %", x, y, z);
 	  else
-	      buf = sqlite3_mprintf ("%s %s %s", buf_x, buf_y, buf_z);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_z);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, 15, "% % %", x, y, z);
       }
 }
 
@@ -680,10 +895,6 @@ static void
 gaiaOutEwktLinestringM (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line)
 {
 /* formats an EWKT LINESTRINGM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_m;
-    char *buf;
     double x;
     double y;
     double m;
@@ -691,21 +902,10 @@ gaiaOutEwktLinestringM (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line)
     for (iv = 0; iv < line->Points; iv++)
       {
 	  gaiaGetPointXYM (line->Coords, iv, &x, &y, &m);
-	  buf_x = sqlite3_mprintf ("%1.15f", x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%1.15f", y);
-	  gaiaOutClean (buf_y);
-	  buf_m = sqlite3_mprintf ("%1.15f", m);
-	  gaiaOutClean (buf_m);
 	  if (iv > 0)
-	      buf = sqlite3_mprintf (",%s %s %s", buf_x, buf_y, buf_m);
+	      out_coords (out_buf, 15, ",% % %", x, y, m);
 	  else
-	      buf = sqlite3_mprintf ("%s %s %s", buf_x, buf_y, buf_m);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_m);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, 15, "% % %", x, y, m);
       }
 }
 
@@ -713,11 +913,6 @@ static void
 gaiaOutEwktLinestringZM (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line)
 {
 /* formats an EWKT LINESTRINGZM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf_m;
-    char *buf;
     double x;
     double y;
     double z;
@@ -726,25 +921,10 @@ gaiaOutEwktLinestringZM (gaiaOutBufferPtr out_buf, gaiaLinestringPtr line)
     for (iv = 0; iv < line->Points; iv++)
       {
 	  gaiaGetPointXYZM (line->Coords, iv, &x, &y, &z, &m);
-	  buf_x = sqlite3_mprintf ("%1.15f", x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%1.15f", y);
-	  gaiaOutClean (buf_y);
-	  buf_z = sqlite3_mprintf ("%1.15f", z);
-	  gaiaOutClean (buf_z);
-	  buf_m = sqlite3_mprintf ("%1.15f", m);
-	  gaiaOutClean (buf_m);
 	  if (iv > 0)
-	      buf =
-		  sqlite3_mprintf (",%s %s %s %s", buf_x, buf_y, buf_z, buf_m);
+	      out_coords (out_buf, 15, ",% % % %", x, y, z, m);
 	  else
-	      buf = sqlite3_mprintf ("%s %s %s %s", buf_x, buf_y, buf_z, buf_m);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_z);
-	  sqlite3_free (buf_m);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, 15, "% % % %", x, y, z, m);
       }
 }
 
@@ -753,9 +933,6 @@ gaiaOutPolygonStrict (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg,
 		      int precision)
 {
 /* formats a WKT POLYGON [Strict 2D] */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
     int ib;
     int iv;
     double x;
@@ -781,20 +958,12 @@ gaiaOutPolygonStrict (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg,
 	    {
 		gaiaGetPoint (ring->Coords, iv, &x, &y);
 	    }
-	  buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
 	  if (iv == 0)
-	      buf = sqlite3_mprintf ("(%s %s", buf_x, buf_y);
+	      out_coords (out_buf, precision, "(% %", x, y);
 	  else if (iv == (ring->Points - 1))
-	      buf = sqlite3_mprintf (",%s %s)", buf_x, buf_y);
+	      out_coords (out_buf, precision, ",% %)", x, y);
 	  else
-	      buf = sqlite3_mprintf (",%s %s", buf_x, buf_y);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, ",% %", x, y);
       }
     for (ib = 0; ib < polyg->NumInteriors; ib++)
       {
@@ -817,20 +986,12 @@ gaiaOutPolygonStrict (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg,
 		  {
 		      gaiaGetPoint (ring->Coords, iv, &x, &y);
 		  }
-		buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		gaiaOutClean (buf_x);
-		buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		gaiaOutClean (buf_y);
 		if (iv == 0)
-		    buf = sqlite3_mprintf (",(%s %s", buf_x, buf_y);
+		    out_coords (out_buf, precision, ",(% %", x, y);
 		else if (iv == (ring->Points - 1))
-		    buf = sqlite3_mprintf (",%s %s)", buf_x, buf_y);
+		    out_coords (out_buf, precision, ",% %)", x, y);
 		else
-		    buf = sqlite3_mprintf (",%s %s", buf_x, buf_y);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
+		    out_coords (out_buf, precision, ",% %", x, y);
 	    }
       }
 }
@@ -839,9 +1000,6 @@ static void
 gaiaOutPolygon (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg, int precision)
 {
 /* formats a WKT POLYGON */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
     int ib;
     int iv;
     double x;
@@ -850,26 +1008,12 @@ gaiaOutPolygon (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg, int precision)
     for (iv = 0; iv < ring->Points; iv++)
       {
 	  gaiaGetPoint (ring->Coords, iv, &x, &y);
-	  if (precision < 0)
-	      buf_x = sqlite3_mprintf ("%1.6f", x);
-	  else
-	      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  if (precision < 0)
-	      buf_y = sqlite3_mprintf ("%1.6f", y);
-	  else
-	      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
 	  if (iv == 0)
-	      buf = sqlite3_mprintf ("(%s %s", buf_x, buf_y);
+	      out_coords (out_buf, precision, "(% %", x, y);
 	  else if (iv == (ring->Points - 1))
-	      buf = sqlite3_mprintf (", %s %s)", buf_x, buf_y);
+	      out_coords (out_buf, precision, ", % %)", x, y);
 	  else
-	      buf = sqlite3_mprintf (", %s %s", buf_x, buf_y);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, ", % %", x, y);
       }
     for (ib = 0; ib < polyg->NumInteriors; ib++)
       {
@@ -877,26 +1021,12 @@ gaiaOutPolygon (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg, int precision)
 	  for (iv = 0; iv < ring->Points; iv++)
 	    {
 		gaiaGetPoint (ring->Coords, iv, &x, &y);
-		if (precision < 0)
-		    buf_x = sqlite3_mprintf ("%1.6f", x);
-		else
-		    buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		gaiaOutClean (buf_x);
-		if (precision < 0)
-		    buf_y = sqlite3_mprintf ("%1.6f", y);
-		else
-		    buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		gaiaOutClean (buf_y);
 		if (iv == 0)
-		    buf = sqlite3_mprintf (", (%s %s", buf_x, buf_y);
+		    out_coords (out_buf, precision, ", (% %", x, y);
 		else if (iv == (ring->Points - 1))
-		    buf = sqlite3_mprintf (", %s %s)", buf_x, buf_y);
+		    out_coords (out_buf, precision, ", % %)", x, y);
 		else
-		    buf = sqlite3_mprintf (", %s %s", buf_x, buf_y);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
+		    out_coords (out_buf, precision, ", % %", x, y);
 	    }
       }
 }
@@ -906,10 +1036,6 @@ gaiaOutPolygonZex (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg,
 		   int precision)
 {
 /* formats a WKT POLYGONZ */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf;
     int ib;
     int iv;
     double x;
@@ -919,32 +1045,12 @@ gaiaOutPolygonZex (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg,
     for (iv = 0; iv < ring->Points; iv++)
       {
 	  gaiaGetPointXYZ (ring->Coords, iv, &x, &y, &z);
-	  if (precision < 0)
-	      buf_x = sqlite3_mprintf ("%1.6f", x);
-	  else
-	      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  if (precision < 0)
-	      buf_y = sqlite3_mprintf ("%1.6f", y);
-	  else
-	      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
-	  if (precision < 0)
-	      buf_z = sqlite3_mprintf ("%1.6f", z);
-	  else
-	      buf_z = sqlite3_mprintf ("%.*f", precision, z);
-	  gaiaOutClean (buf_z);
 	  if (iv == 0)
-	      buf = sqlite3_mprintf ("(%s %s %s", buf_x, buf_y, buf_z);
+	      out_coords (out_buf, precision, "(% % %", x, y, z);
 	  else if (iv == (ring->Points - 1))
-	      buf = sqlite3_mprintf (", %s %s %s)", buf_x, buf_y, buf_z);
+	      out_coords (out_buf, precision, ", % % %)", x, y, z);
 	  else
-	      buf = sqlite3_mprintf (", %s %s %s", buf_x, buf_y, buf_z);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_z);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, ", % % %", x, y, z);
       }
     for (ib = 0; ib < polyg->NumInteriors; ib++)
       {
@@ -952,32 +1058,12 @@ gaiaOutPolygonZex (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg,
 	  for (iv = 0; iv < ring->Points; iv++)
 	    {
 		gaiaGetPointXYZ (ring->Coords, iv, &x, &y, &z);
-		if (precision < 0)
-		    buf_x = sqlite3_mprintf ("%1.6f", x);
-		else
-		    buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		gaiaOutClean (buf_x);
-		if (precision < 0)
-		    buf_y = sqlite3_mprintf ("%1.6f", y);
-		else
-		    buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		gaiaOutClean (buf_y);
-		if (precision < 0)
-		    buf_z = sqlite3_mprintf ("%1.6f", z);
-		else
-		    buf_z = sqlite3_mprintf ("%.*f", precision, z);
-		gaiaOutClean (buf_z);
 		if (iv == 0)
-		    buf = sqlite3_mprintf (", (%s %s %s", buf_x, buf_y, buf_z);
+		    out_coords (out_buf, precision, ", (% % %", x, y, z);
 		else if (iv == (ring->Points - 1))
-		    buf = sqlite3_mprintf (", %s %s %s)", buf_x, buf_y, buf_z);
+		    out_coords (out_buf, precision, ", % % %)", x, y, z);
 		else
-		    buf = sqlite3_mprintf (", %s %s %s", buf_x, buf_y, buf_z);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		sqlite3_free (buf_z);
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
+		    out_coords (out_buf, precision, ", % % %", x, y, z);
 	    }
       }
 }
@@ -996,10 +1082,6 @@ static void
 gaiaOutPolygonM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg, int precision)
 {
 /* formats a WKT POLYGONM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_m;
-    char *buf;
     int ib;
     int iv;
     double x;
@@ -1009,32 +1091,12 @@ gaiaOutPolygonM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg, int precision)
     for (iv = 0; iv < ring->Points; iv++)
       {
 	  gaiaGetPointXYM (ring->Coords, iv, &x, &y, &m);
-	  if (precision < 0)
-	      buf_x = sqlite3_mprintf ("%1.6f", x);
-	  else
-	      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  if (precision < 0)
-	      buf_y = sqlite3_mprintf ("%1.6f", y);
-	  else
-	      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
-	  if (precision < 0)
-	      buf_m = sqlite3_mprintf ("%1.6f", m);
-	  else
-	      buf_m = sqlite3_mprintf ("%.*f", precision, m);
-	  gaiaOutClean (buf_m);
 	  if (iv == 0)
-	      buf = sqlite3_mprintf ("(%s %s %s", buf_x, buf_y, buf_m);
+	      out_coords (out_buf, precision, "(% % %", x, y, m);
 	  else if (iv == (ring->Points - 1))
-	      buf = sqlite3_mprintf (", %s %s %s)", buf_x, buf_y, buf_m);
+	      out_coords (out_buf, precision, ", % % %)", x, y, m);
 	  else
-	      buf = sqlite3_mprintf (", %s %s %s", buf_x, buf_y, buf_m);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_m);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, ", % % %", x, y, m);
       }
     for (ib = 0; ib < polyg->NumInteriors; ib++)
       {
@@ -1042,32 +1104,12 @@ gaiaOutPolygonM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg, int precision)
 	  for (iv = 0; iv < ring->Points; iv++)
 	    {
 		gaiaGetPointXYM (ring->Coords, iv, &x, &y, &m);
-		if (precision < 0)
-		    buf_x = sqlite3_mprintf ("%1.6f", x);
-		else
-		    buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		gaiaOutClean (buf_x);
-		if (precision < 0)
-		    buf_y = sqlite3_mprintf ("%1.6f", y);
-		else
-		    buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		gaiaOutClean (buf_y);
-		if (precision < 0)
-		    buf_m = sqlite3_mprintf ("%1.6f", m);
-		else
-		    buf_m = sqlite3_mprintf ("%.*f", precision, m);
-		gaiaOutClean (buf_m);
 		if (iv == 0)
-		    buf = sqlite3_mprintf (", (%s %s %s", buf_x, buf_y, buf_m);
+		    out_coords (out_buf, precision, ", (% % %", x, y, m);
 		else if (iv == (ring->Points - 1))
-		    buf = sqlite3_mprintf (", %s %s %s)", buf_x, buf_y, buf_m);
+		    out_coords (out_buf, precision, ", % % %)", x, y, m);
 		else
-		    buf = sqlite3_mprintf (", %s %s %s", buf_x, buf_y, buf_m);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		sqlite3_free (buf_m);
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
+		    out_coords (out_buf, precision, ", % % %", x, y, m);
 	    }
       }
 }
@@ -1076,11 +1118,6 @@ static void
 gaiaOutPolygonZM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg, int precision)
 {
 /* formats a WKT POLYGONZM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf_m;
-    char *buf;
     int ib;
     int iv;
     double x;
@@ -1091,42 +1128,12 @@ gaiaOutPolygonZM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg, int precision)
     for (iv = 0; iv < ring->Points; iv++)
       {
 	  gaiaGetPointXYZM (ring->Coords, iv, &x, &y, &z, &m);
-	  if (precision < 0)
-	      buf_x = sqlite3_mprintf ("%1.6f", x);
-	  else
-	      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  if (precision < 0)
-	      buf_y = sqlite3_mprintf ("%1.6f", y);
-	  else
-	      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
-	  if (precision < 0)
-	      buf_z = sqlite3_mprintf ("%1.6f", z);
-	  else
-	      buf_z = sqlite3_mprintf ("%.*f", precision, z);
-	  gaiaOutClean (buf_z);
-	  if (precision < 0)
-	      buf_m = sqlite3_mprintf ("%1.6f", m);
-	  else
-	      buf_m = sqlite3_mprintf ("%.*f", precision, m);
-	  gaiaOutClean (buf_m);
 	  if (iv == 0)
-	      buf =
-		  sqlite3_mprintf ("(%s %s %s %s", buf_x, buf_y, buf_z, buf_m);
+	      out_coords (out_buf, precision, "(% % % %", x, y, z, m);
 	  else if (iv == (ring->Points - 1))
-	      buf =
-		  sqlite3_mprintf (", %s %s %s %s)", buf_x, buf_y, buf_z,
-				   buf_m);
+	      out_coords (out_buf, precision, ", % % % %)", x, y, z, m);
 	  else
-	      buf =
-		  sqlite3_mprintf (", %s %s %s %s", buf_x, buf_y, buf_z, buf_m);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_z);
-	  sqlite3_free (buf_m);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, ", % % % %", x, y, z, m);
       }
     for (ib = 0; ib < polyg->NumInteriors; ib++)
       {
@@ -1134,44 +1141,12 @@ gaiaOutPolygonZM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg, int precision)
 	  for (iv = 0; iv < ring->Points; iv++)
 	    {
 		gaiaGetPointXYZM (ring->Coords, iv, &x, &y, &z, &m);
-		if (precision < 0)
-		    buf_x = sqlite3_mprintf ("%1.6f", x);
-		else
-		    buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		gaiaOutClean (buf_x);
-		if (precision < 0)
-		    buf_y = sqlite3_mprintf ("%1.6f", y);
-		else
-		    buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		gaiaOutClean (buf_y);
-		if (precision < 0)
-		    buf_z = sqlite3_mprintf ("%1.6f", z);
-		else
-		    buf_z = sqlite3_mprintf ("%.*f", precision, z);
-		gaiaOutClean (buf_z);
-		if (precision < 0)
-		    buf_m = sqlite3_mprintf ("%1.6f", m);
-		else
-		    buf_m = sqlite3_mprintf ("%.*f", precision, m);
-		gaiaOutClean (buf_m);
 		if (iv == 0)
-		    buf =
-			sqlite3_mprintf (", (%s %s %s %s", buf_x, buf_y, buf_z,
-					 buf_m);
+		    out_coords (out_buf, precision, ", (% % % %", x, y, z, m);
 		else if (iv == (ring->Points - 1))
-		    buf =
-			sqlite3_mprintf (", %s %s %s %s)", buf_x, buf_y, buf_z,
-					 buf_m);
+		    out_coords (out_buf, precision, ", % % % %)", x, y, z, m);
 		else
-		    buf =
-			sqlite3_mprintf (", %s %s %s %s", buf_x, buf_y, buf_z,
-					 buf_m);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		sqlite3_free (buf_z);
-		sqlite3_free (buf_m);
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
+		    out_coords (out_buf, precision, ", % % % %", x, y, z, m);
 	    }
       }
 }
@@ -1180,9 +1155,6 @@ static void
 gaiaOutEwktPolygon (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
 {
 /* formats an EWKT POLYGON */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
     int ib;
     int iv;
     double x;
@@ -1191,20 +1163,12 @@ gaiaOutEwktPolygon (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
     for (iv = 0; iv < ring->Points; iv++)
       {
 	  gaiaGetPoint (ring->Coords, iv, &x, &y);
-	  buf_x = sqlite3_mprintf ("%1.15f", x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%1.15f", y);
-	  gaiaOutClean (buf_y);
 	  if (iv == 0)
-	      buf = sqlite3_mprintf ("(%s %s", buf_x, buf_y);
+	      out_coords (out_buf, 15, "(% %", x, y);
 	  else if (iv == (ring->Points - 1))
-	      buf = sqlite3_mprintf (",%s %s)", buf_x, buf_y);
+	      out_coords (out_buf, 15, ",% %)", x, y);
 	  else
-	      buf = sqlite3_mprintf (",%s %s", buf_x, buf_y);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, 15, ",% %", x, y);
       }
     for (ib = 0; ib < polyg->NumInteriors; ib++)
       {
@@ -1212,20 +1176,12 @@ gaiaOutEwktPolygon (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
 	  for (iv = 0; iv < ring->Points; iv++)
 	    {
 		gaiaGetPoint (ring->Coords, iv, &x, &y);
-		buf_x = sqlite3_mprintf ("%1.15f", x);
-		gaiaOutClean (buf_x);
-		buf_y = sqlite3_mprintf ("%1.15f", y);
-		gaiaOutClean (buf_y);
 		if (iv == 0)
-		    buf = sqlite3_mprintf (",(%s %s", buf_x, buf_y);
+		    out_coords (out_buf, 15, ",(% %", x, y);
 		else if (iv == (ring->Points - 1))
-		    buf = sqlite3_mprintf (",%s %s)", buf_x, buf_y);
+		    out_coords (out_buf, 15, ",% %)", x, y);
 		else
-		    buf = sqlite3_mprintf (",%s %s", buf_x, buf_y);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
+		    out_coords (out_buf, 15, ",% %", x, y);
 	    }
       }
 }
@@ -1234,10 +1190,6 @@ GAIAGEO_DECLARE void
 gaiaOutEwktPolygonZ (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
 {
 /* formats an EWKT POLYGONZ */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf;
     int ib;
     int iv;
     double x;
@@ -1247,23 +1199,12 @@ gaiaOutEwktPolygonZ (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
     for (iv = 0; iv < ring->Points; iv++)
       {
 	  gaiaGetPointXYZ (ring->Coords, iv, &x, &y, &z);
-	  buf_x = sqlite3_mprintf ("%1.15f", x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%1.15f", y);
-	  gaiaOutClean (buf_y);
-	  buf_z = sqlite3_mprintf ("%1.15f", z);
-	  gaiaOutClean (buf_z);
 	  if (iv == 0)
-	      buf = sqlite3_mprintf ("(%s %s %s", buf_x, buf_y, buf_z);
+	      out_coords (out_buf, 15, "(% % %", x, y, z);
 	  else if (iv == (ring->Points - 1))
-	      buf = sqlite3_mprintf (",%s %s %s)", buf_x, buf_y, buf_z);
+	      out_coords (out_buf, 15, ",% % %)", x, y, z);
 	  else
-	      buf = sqlite3_mprintf (",%s %s %s", buf_x, buf_y, buf_z);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_z);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, 15, ",% % %", x, y, z);
       }
     for (ib = 0; ib < polyg->NumInteriors; ib++)
       {
@@ -1271,23 +1212,12 @@ gaiaOutEwktPolygonZ (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
 	  for (iv = 0; iv < ring->Points; iv++)
 	    {
 		gaiaGetPointXYZ (ring->Coords, iv, &x, &y, &z);
-		buf_x = sqlite3_mprintf ("%1.15f", x);
-		gaiaOutClean (buf_x);
-		buf_y = sqlite3_mprintf ("%1.15f", y);
-		gaiaOutClean (buf_y);
-		buf_z = sqlite3_mprintf ("%1.15f", z);
-		gaiaOutClean (buf_z);
 		if (iv == 0)
-		    buf = sqlite3_mprintf (",(%s %s %s", buf_x, buf_y, buf_z);
+		    out_coords (out_buf, 15, ",(% % %", x, y, z);
 		else if (iv == (ring->Points - 1))
-		    buf = sqlite3_mprintf (",%s %s %s)", buf_x, buf_y, buf_z);
+		    out_coords (out_buf, 15, ",% % %)", x, y, z);
 		else
-		    buf = sqlite3_mprintf (",%s %s %s", buf_x, buf_y, buf_z);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		sqlite3_free (buf_z);
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
+		    out_coords (out_buf, 15, ",% % %", x, y, z);
 	    }
       }
 }
@@ -1296,10 +1226,6 @@ static void
 gaiaOutEwktPolygonM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
 {
 /* formats an EWKT POLYGONM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_m;
-    char *buf;
     int ib;
     int iv;
     double x;
@@ -1309,23 +1235,12 @@ gaiaOutEwktPolygonM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
     for (iv = 0; iv < ring->Points; iv++)
       {
 	  gaiaGetPointXYM (ring->Coords, iv, &x, &y, &m);
-	  buf_x = sqlite3_mprintf ("%1.15f", x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%1.15f", y);
-	  gaiaOutClean (buf_y);
-	  buf_m = sqlite3_mprintf ("%1.15f", m);
-	  gaiaOutClean (buf_m);
 	  if (iv == 0)
-	      buf = sqlite3_mprintf ("(%s %s %s", buf_x, buf_y, buf_m);
+	      out_coords (out_buf, 15, "(% % %", x, y, m);
 	  else if (iv == (ring->Points - 1))
-	      buf = sqlite3_mprintf (",%s %s %s)", buf_x, buf_y, buf_m);
+	      out_coords (out_buf, 15, ",% % %)", x, y, m);
 	  else
-	      buf = sqlite3_mprintf (",%s %s %s", buf_x, buf_y, buf_m);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_m);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, 15, ",% % %", x, y, m);
       }
     for (ib = 0; ib < polyg->NumInteriors; ib++)
       {
@@ -1333,23 +1248,12 @@ gaiaOutEwktPolygonM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
 	  for (iv = 0; iv < ring->Points; iv++)
 	    {
 		gaiaGetPointXYM (ring->Coords, iv, &x, &y, &m);
-		buf_x = sqlite3_mprintf ("%1.15f", x);
-		gaiaOutClean (buf_x);
-		buf_y = sqlite3_mprintf ("%1.15f", y);
-		gaiaOutClean (buf_y);
-		buf_m = sqlite3_mprintf ("%1.15f", m);
-		gaiaOutClean (buf_m);
 		if (iv == 0)
-		    buf = sqlite3_mprintf (",(%s %s %s", buf_x, buf_y, buf_m);
+		    out_coords (out_buf, 15, ",(% % %", x, y, m);
 		else if (iv == (ring->Points - 1))
-		    buf = sqlite3_mprintf (",%s %s %s)", buf_x, buf_y, buf_m);
+		    out_coords (out_buf, 15, ",% % %)", x, y, m);
 		else
-		    buf = sqlite3_mprintf (",%s %s %s", buf_x, buf_y, buf_m);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		sqlite3_free (buf_m);
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
+		    out_coords (out_buf, 15, ",% % %", x, y, m);
 	    }
       }
 }
@@ -1358,11 +1262,6 @@ static void
 gaiaOutEwktPolygonZM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
 {
 /* formats an EWKT POLYGONZM */
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
-    char *buf_m;
-    char *buf;
     int ib;
     int iv;
     double x;
@@ -1373,29 +1272,12 @@ gaiaOutEwktPolygonZM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
     for (iv = 0; iv < ring->Points; iv++)
       {
 	  gaiaGetPointXYZM (ring->Coords, iv, &x, &y, &z, &m);
-	  buf_x = sqlite3_mprintf ("%1.15f", x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%1.15f", y);
-	  gaiaOutClean (buf_y);
-	  buf_z = sqlite3_mprintf ("%1.15f", z);
-	  gaiaOutClean (buf_z);
-	  buf_m = sqlite3_mprintf ("%1.15f", m);
-	  gaiaOutClean (buf_m);
 	  if (iv == 0)
-	      buf =
-		  sqlite3_mprintf ("(%s %s %s %s", buf_x, buf_y, buf_z, buf_m);
+	      out_coords (out_buf, 15, "(% % % %", x, y, z, m);
 	  else if (iv == (ring->Points - 1))
-	      buf =
-		  sqlite3_mprintf (",%s %s %s %s)", buf_x, buf_y, buf_z, buf_m);
+	      out_coords (out_buf, 15, ",% % % %)", x, y, z, m);
 	  else
-	      buf =
-		  sqlite3_mprintf (",%s %s %s %s", buf_x, buf_y, buf_z, buf_m);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  sqlite3_free (buf_z);
-	  sqlite3_free (buf_m);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, 15, ",% % % %", x, y, z, m);
       }
     for (ib = 0; ib < polyg->NumInteriors; ib++)
       {
@@ -1403,32 +1285,12 @@ gaiaOutEwktPolygonZM (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polyg)
 	  for (iv = 0; iv < ring->Points; iv++)
 	    {
 		gaiaGetPointXYZM (ring->Coords, iv, &x, &y, &z, &m);
-		buf_x = sqlite3_mprintf ("%1.15f", x);
-		gaiaOutClean (buf_x);
-		buf_y = sqlite3_mprintf ("%1.15f", y);
-		gaiaOutClean (buf_y);
-		buf_z = sqlite3_mprintf ("%1.15f", z);
-		gaiaOutClean (buf_z);
-		buf_m = sqlite3_mprintf ("%1.15f", m);
-		gaiaOutClean (buf_m);
 		if (iv == 0)
-		    buf =
-			sqlite3_mprintf (",(%s %s %s %s", buf_x, buf_y, buf_z,
-					 buf_m);
+		    out_coords (out_buf, 15, ",(% % % %", x, y, z, m);
 		else if (iv == (ring->Points - 1))
-		    buf =
-			sqlite3_mprintf (",%s %s %s %s)", buf_x, buf_y, buf_z,
-					 buf_m);
+		    out_coords (out_buf, 15, ",% % % %)", x, y, z, m);
 		else
-		    buf =
-			sqlite3_mprintf (",%s %s %s %s", buf_x, buf_y, buf_z,
-					 buf_m);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		sqlite3_free (buf_z);
-		sqlite3_free (buf_m);
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
+		    out_coords (out_buf, 15, ",% % % %", x, y, z, m);
 	    }
       }
 }
@@ -2355,36 +2217,16 @@ static void
 SvgCoords (gaiaOutBufferPtr out_buf, gaiaPointPtr point, int precision)
 {
 /* formats POINT as SVG-attributes x,y */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
-    buf_x = sqlite3_mprintf ("%.*f", precision, point->X);
-    gaiaOutClean (buf_x);
-    buf_y = sqlite3_mprintf ("%.*f", precision, point->Y * -1);
-    gaiaOutClean (buf_y);
-    buf = sqlite3_mprintf ("x=\"%s\" y=\"%s\"", buf_x, buf_y);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+    out_coords (out_buf, precision, "x=\"%\" y=\"%\"", point->X,
+		point->Y * -1);
 }
 
 static void
 SvgCircle (gaiaOutBufferPtr out_buf, gaiaPointPtr point, int precision)
 {
 /* formats POINT as SVG-attributes cx,cy */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
-    buf_x = sqlite3_mprintf ("%.*f", precision, point->X);
-    gaiaOutClean (buf_x);
-    buf_y = sqlite3_mprintf ("%.*f", precision, point->Y * -1);
-    gaiaOutClean (buf_y);
-    buf = sqlite3_mprintf ("cx=\"%s\" cy=\"%s\"", buf_x, buf_y);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+    out_coords (out_buf, precision, "cx=\"%\" cy=\"%\"", point->X,
+		point->Y * -1);
 }
 
 static void
@@ -2392,9 +2234,6 @@ SvgPathRelative (gaiaOutBufferPtr out_buf, int dims, int points, double *coords,
 		 int precision, int closePath)
 {
 /* formats LINESTRING as SVG-path d-attribute with relative coordinate moves */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
     double x;
     double y;
     double z;
@@ -2420,23 +2259,16 @@ SvgPathRelative (gaiaOutBufferPtr out_buf, int dims, int points, double *coords,
 	    {
 		gaiaGetPoint (coords, iv, &x, &y);
 	    }
-	  buf_x = sqlite3_mprintf ("%.*f", precision, x - lastX);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%.*f", precision, (y - lastY) * -1);
-	  gaiaOutClean (buf_y);
-	  if (iv == 0)
-	      buf = sqlite3_mprintf ("M %s %s l ", buf_x, buf_y);
-	  else
-	      buf = sqlite3_mprintf ("%s %s ", buf_x, buf_y);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  lastX = x;
-	  lastY = y;
 	  if (iv == points - 1 && closePath == 1)
 	      gaiaAppendToOutBuffer (out_buf, "z ");
+	  else if (iv == 0)
+	      out_coords (out_buf, precision, "M % % l ", x - lastX,
+			  (y - lastY) * -1);
 	  else
-	      gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, "% % ", x - lastX,
+			  (y - lastY) * -1);
+	  lastX = x;
+	  lastY = y;
       }
 }
 
@@ -2445,9 +2277,6 @@ SvgPathAbsolute (gaiaOutBufferPtr out_buf, int dims, int points, double *coords,
 		 int precision, int closePath)
 {
 /* formats LINESTRING as SVG-path d-attribute with relative coordinate moves */
-    char *buf_x;
-    char *buf_y;
-    char *buf;
     double x;
     double y;
     double z;
@@ -2471,21 +2300,12 @@ SvgPathAbsolute (gaiaOutBufferPtr out_buf, int dims, int points, double *coords,
 	    {
 		gaiaGetPoint (coords, iv, &x, &y);
 	    }
-	  buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%.*f", precision, y * -1);
-	  gaiaOutClean (buf_y);
-	  if (iv == 0)
-	      buf = sqlite3_mprintf ("M %s %s L ", buf_x, buf_y);
-	  else
-	      buf = sqlite3_mprintf ("%s %s ", buf_x, buf_y);
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
 	  if (iv == points - 1 && closePath == 1)
 	      gaiaAppendToOutBuffer (out_buf, "z ");
+	  else if (iv == 0)
+	      out_coords (out_buf, precision, "M % % L ", x, y * -1);
 	  else
-	      gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, "% % ", x, y * -1);
       }
 }
 
@@ -2816,33 +2636,12 @@ static void
 out_kml_point (gaiaOutBufferPtr out_buf, gaiaPointPtr point, int precision)
 {
 /* formats POINT as KML [x,y] */
-    char *buf_x = NULL;
-    char *buf_y = NULL;
-    char *buf_z = NULL;
-    char *buf = NULL;
-    buf_x = sqlite3_mprintf ("%.*f", precision, point->X);
-    gaiaOutClean (buf_x);
-    buf_y = sqlite3_mprintf ("%.*f", precision, point->Y);
-    gaiaOutClean (buf_y);
-    if (point->DimensionModel == GAIA_XY_Z
-	|| point->DimensionModel == GAIA_XY_Z_M)
-      {
-	  buf_z = sqlite3_mprintf ("%.*f", precision, point->Z);
-	  gaiaOutClean (buf_z);
-      }
     gaiaAppendToOutBuffer (out_buf, "<Point><coordinates>");
     if (point->DimensionModel == GAIA_XY_Z
 	|| point->DimensionModel == GAIA_XY_Z_M)
-      {
-	  buf = sqlite3_mprintf ("%s,%s,%s", buf_x, buf_y, buf_z);
-	  sqlite3_free (buf_z);
-      }
+	out_coords (out_buf, precision, "%,%,%", point->X, point->Y, point->Z);
     else
-	buf = sqlite3_mprintf ("%s,%s", buf_x, buf_y);
-    sqlite3_free (buf_x);
-    sqlite3_free (buf_y);
-    gaiaAppendToOutBuffer (out_buf, buf);
-    sqlite3_free (buf);
+	out_coords (out_buf, precision, "%,%", point->X, point->Y);
     gaiaAppendToOutBuffer (out_buf, "</coordinates></Point>");
 }
 
@@ -2851,10 +2650,6 @@ out_kml_linestring (gaiaOutBuffer * out_buf, int dims, int points,
 		    double *coords, int precision)
 {
 /* formats LINESTRING as KML [x,y] */
-    char *buf_x = NULL;
-    char *buf_y = NULL;
-    char *buf_z = NULL;
-    char *buf = NULL;
     int iv;
     double x = 0.0;
     double y = 0.0;
@@ -2880,31 +2675,20 @@ out_kml_linestring (gaiaOutBuffer * out_buf, int dims, int points,
 	    {
 		gaiaGetPoint (coords, iv, &x, &y);
 	    }
-	  buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
 	  if (dims == GAIA_XY_Z || dims == GAIA_XY_Z_M)
 	    {
-		buf_z = sqlite3_mprintf ("%.*f", precision, z);
-		gaiaOutClean (buf_z);
 		if (iv == 0)
-		    buf = sqlite3_mprintf ("%s,%s,%s", buf_x, buf_y, buf_z);
+		    out_coords (out_buf, precision, "%,%,%", x, y, z);
 		else
-		    buf = sqlite3_mprintf (" %s,%s,%s", buf_x, buf_y, buf_z);
-		sqlite3_free (buf_z);
+		    out_coords (out_buf, precision, " %,%,%", x, y, z);
 	    }
 	  else
 	    {
 		if (iv == 0)
-		    buf = sqlite3_mprintf ("%s,%s", buf_x, buf_y);
+		    out_coords (out_buf, precision, "%,%", x, y);
 		else
-		    buf = sqlite3_mprintf (" %s,%s", buf_x, buf_y);
+		    out_coords (out_buf, precision, " %,%", x, y);
 	    }
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
       }
     gaiaAppendToOutBuffer (out_buf, "</coordinates></LineString>");
 }
@@ -2914,10 +2698,6 @@ out_kml_polygon (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polygon,
 		 int precision)
 {
 /* formats POLYGON as KML [x,y] */
-    char *buf_x = NULL;
-    char *buf_y = NULL;
-    char *buf_z = NULL;
-    char *buf = NULL;
     gaiaRingPtr ring;
     int iv;
     int ib;
@@ -2948,32 +2728,21 @@ out_kml_polygon (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polygon,
 	    {
 		gaiaGetPoint (ring->Coords, iv, &x, &y);
 	    }
-	  buf_x = sqlite3_mprintf ("%.*f", precision, x);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%.*f", precision, y);
-	  gaiaOutClean (buf_y);
 	  if (ring->DimensionModel == GAIA_XY_Z
 	      || ring->DimensionModel == GAIA_XY_Z_M)
 	    {
-		buf_z = sqlite3_mprintf ("%.*f", precision, z);
-		gaiaOutClean (buf_z);
 		if (iv == 0)
-		    buf = sqlite3_mprintf ("%s,%s,%s", buf_x, buf_y, buf_z);
+		    out_coords (out_buf, precision, "%,%,%", x, y, z);
 		else
-		    buf = sqlite3_mprintf (" %s,%s,%s", buf_x, buf_y, buf_z);
-		sqlite3_free (buf_z);
+		    out_coords (out_buf, precision, " %,%,%", x, y, z);
 	    }
 	  else
 	    {
 		if (iv == 0)
-		    buf = sqlite3_mprintf ("%s,%s", buf_x, buf_y);
+		    out_coords (out_buf, precision, "%,%", x, y);
 		else
-		    buf = sqlite3_mprintf (" %s,%s", buf_x, buf_y);
+		    out_coords (out_buf, precision, " %,%", x, y);
 	    }
-	  sqlite3_free (buf_x);
-	  sqlite3_free (buf_y);
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
       }
     gaiaAppendToOutBuffer (out_buf,
 			   "</coordinates></LinearRing></outerBoundaryIs>");
@@ -3002,35 +2771,21 @@ out_kml_polygon (gaiaOutBufferPtr out_buf, gaiaPolygonPtr polygon,
 		  {
 		      gaiaGetPoint (ring->Coords, iv, &x, &y);
 		  }
-		buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		gaiaOutClean (buf_x);
-		buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		gaiaOutClean (buf_y);
 		if (ring->DimensionModel == GAIA_XY_Z
 		    || ring->DimensionModel == GAIA_XY_Z_M)
 		  {
-		      buf_z = sqlite3_mprintf ("%.*f", precision, z);
-		      gaiaOutClean (buf_z);
 		      if (iv == 0)
-			  buf =
-			      sqlite3_mprintf ("%s,%s,%s", buf_x, buf_y, buf_z);
+			  out_coords (out_buf, precision, "%,%,%", x, y, z);
 		      else
-			  buf =
-			      sqlite3_mprintf (" %s,%s,%s", buf_x, buf_y,
-					       buf_z);
-		      sqlite3_free (buf_z);
+			  out_coords (out_buf, precision, " %,%,%", x, y, z);
 		  }
 		else
 		  {
 		      if (iv == 0)
-			  buf = sqlite3_mprintf ("%s,%s", buf_x, buf_y);
+			  out_coords (out_buf, precision, "%,%", x, y);
 		      else
-			  buf = sqlite3_mprintf (" %s,%s", buf_x, buf_y);
+			  out_coords (out_buf, precision, " %,%", x, y);
 		  }
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
 	    }
 	  gaiaAppendToOutBuffer (out_buf,
 				 "</coordinates></LinearRing></innerBoundaryIs>");
@@ -3237,10 +2992,6 @@ gaiaOutGml (gaiaOutBufferPtr out_buf, int version, int precision,
     int is_multi = 1;
     int is_coll = 0;
     char buf[2048];
-    char *xbuf;
-    char *buf_x;
-    char *buf_y;
-    char *buf_z;
     if (!geom)
 	return;
     if (precision > 18)
@@ -3338,47 +3089,14 @@ gaiaOutGml (gaiaOutBufferPtr out_buf, int version, int precision,
 	  else
 	      strcat (buf, "<gml:coordinates>");
 	  gaiaAppendToOutBuffer (out_buf, buf);
-	  buf_x = sqlite3_mprintf ("%.*f", precision, point->X);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%.*f", precision, point->Y);
-	  gaiaOutClean (buf_y);
 	  if (point->DimensionModel == GAIA_XY_Z
 	      || point->DimensionModel == GAIA_XY_Z_M)
-	    {
-		buf_z = sqlite3_mprintf ("%.*f", precision, point->Z);
-		gaiaOutClean (buf_z);
-		if (version == 3)
-		  {
-		      xbuf = sqlite3_mprintf ("%s %s %s", buf_x, buf_y, buf_z);
-		      sqlite3_free (buf_x);
-		      sqlite3_free (buf_y);
-		      sqlite3_free (buf_z);
-		  }
-		else
-		  {
-		      xbuf = sqlite3_mprintf ("%s,%s,%s", buf_x, buf_y, buf_z);
-		      sqlite3_free (buf_x);
-		      sqlite3_free (buf_y);
-		      sqlite3_free (buf_z);
-		  }
-	    }
+	      out_coords (out_buf, precision,
+			  (version == 3) ? "% % %" : "%,%,%", point->X,
+			  point->Y, point->Z);
 	  else
-	    {
-		if (version == 3)
-		  {
-		      xbuf = sqlite3_mprintf ("%s %s", buf_x, buf_y);
-		      sqlite3_free (buf_x);
-		      sqlite3_free (buf_y);
-		  }
-		else
-		  {
-		      xbuf = sqlite3_mprintf ("%s,%s", buf_x, buf_y);
-		      sqlite3_free (buf_x);
-		      sqlite3_free (buf_y);
-		  }
-	    }
-	  gaiaAppendToOutBuffer (out_buf, xbuf);
-	  sqlite3_free (xbuf);
+	      out_coords (out_buf, precision, (version == 3) ? "% %" : "%,%",
+			  point->X, point->Y);
 	  if (version == 3)
 	      strcpy (buf, "</gml:pos>");
 	  else
@@ -3478,60 +3196,14 @@ gaiaOutGml (gaiaOutBufferPtr out_buf, int version, int precision,
 		  {
 		      gaiaGetPoint (line->Coords, iv, &x, &y);
 		  }
-		if (iv == 0)
-		    *buf = '\0';
-		else
-		    strcpy (buf, " ");
+		if (iv > 0)
+		    gaiaAppendToOutBuffer (out_buf, " ");
 		if (has_z)
-		  {
-		      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		      gaiaOutClean (buf_x);
-		      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		      gaiaOutClean (buf_y);
-		      buf_z = sqlite3_mprintf ("%.*f", precision, z);
-		      gaiaOutClean (buf_z);
-		      if (version == 3)
-			{
-			    xbuf =
-				sqlite3_mprintf ("%s%s %s %s", buf, buf_x,
-						 buf_y, buf_z);
-			    sqlite3_free (buf_x);
-			    sqlite3_free (buf_y);
-			    sqlite3_free (buf_z);
-			}
-		      else
-			{
-			    xbuf =
-				sqlite3_mprintf ("%s%s,%s,%s", buf, buf_x,
-						 buf_y, buf_z);
-			    sqlite3_free (buf_x);
-			    sqlite3_free (buf_y);
-			    sqlite3_free (buf_z);
-			}
-		  }
+		    out_coords (out_buf, precision,
+				(version == 3) ? "% % %" : "%,%,%", x, y, z);
 		else
-		  {
-		      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		      gaiaOutClean (buf_x);
-		      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		      gaiaOutClean (buf_y);
-		      if (version == 3)
-			{
-			    xbuf =
-				sqlite3_mprintf ("%s%s %s", buf, buf_x, buf_y);
-			    sqlite3_free (buf_x);
-			    sqlite3_free (buf_y);
-			}
-		      else
-			{
-			    xbuf =
-				sqlite3_mprintf ("%s%s,%s", buf, buf_x, buf_y);
-			    sqlite3_free (buf_x);
-			    sqlite3_free (buf_y);
-			}
-		  }
-		gaiaAppendToOutBuffer (out_buf, xbuf);
-		sqlite3_free (xbuf);
+		    out_coords (out_buf, precision,
+				(version == 3) ? "% %" : "%,%", x, y);
 	    }
 	  if (is_multi)
 	    {
@@ -3656,60 +3328,14 @@ gaiaOutGml (gaiaOutBufferPtr out_buf, int version, int precision,
 		  {
 		      gaiaGetPoint (ring->Coords, iv, &x, &y);
 		  }
-		if (iv == 0)
-		    *buf = '\0';
-		else
-		    strcpy (buf, " ");
+		if (iv > 0)
+		    gaiaAppendToOutBuffer (out_buf, " ");
 		if (has_z)
-		  {
-		      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		      gaiaOutClean (buf_x);
-		      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		      gaiaOutClean (buf_y);
-		      buf_z = sqlite3_mprintf ("%.*f", precision, z);
-		      gaiaOutClean (buf_z);
-		      if (version == 3)
-			{
-			    xbuf =
-				sqlite3_mprintf ("%s%s %s %s", buf, buf_x,
-						 buf_y, buf_z);
-			    sqlite3_free (buf_x);
-			    sqlite3_free (buf_y);
-			    sqlite3_free (buf_z);
-			}
-		      else
-			{
-			    xbuf =
-				sqlite3_mprintf ("%s%s,%s,%s", buf, buf_x,
-						 buf_y, buf_z);
-			    sqlite3_free (buf_x);
-			    sqlite3_free (buf_y);
-			    sqlite3_free (buf_z);
-			}
-		  }
+		    out_coords (out_buf, precision,
+				(version == 3) ? "% % %" : "%,%,%", x, y, z);
 		else
-		  {
-		      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		      gaiaOutClean (buf_x);
-		      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		      gaiaOutClean (buf_y);
-		      if (version == 3)
-			{
-			    xbuf =
-				sqlite3_mprintf ("%s%s %s", buf, buf_x, buf_y);
-			    sqlite3_free (buf_x);
-			    sqlite3_free (buf_y);
-			}
-		      else
-			{
-			    xbuf =
-				sqlite3_mprintf ("%s%s,%s", buf, buf_x, buf_y);
-			    sqlite3_free (buf_x);
-			    sqlite3_free (buf_y);
-			}
-		  }
-		gaiaAppendToOutBuffer (out_buf, xbuf);
-		sqlite3_free (xbuf);
+		    out_coords (out_buf, precision,
+				(version == 3) ? "% %" : "%,%", x, y);
 	    }
 	  /* closing the Exterior Ring */
 	  if (version == 3)
@@ -3769,62 +3395,15 @@ gaiaOutGml (gaiaOutBufferPtr out_buf, int version, int precision,
 			{
 			    gaiaGetPoint (ring->Coords, iv, &x, &y);
 			}
-		      if (iv == 0)
-			  *buf = '\0';
-		      else
-			  strcpy (buf, " ");
+		      if (iv > 0)
+			  gaiaAppendToOutBuffer (out_buf, " ");
 		      if (has_z)
-			{
-			    buf_x = sqlite3_mprintf ("%.*f", precision, x);
-			    gaiaOutClean (buf_x);
-			    buf_y = sqlite3_mprintf ("%.*f", precision, y);
-			    gaiaOutClean (buf_y);
-			    buf_z = sqlite3_mprintf ("%.*f", precision, z);
-			    gaiaOutClean (buf_z);
-			    if (version == 3)
-			      {
-				  xbuf =
-				      sqlite3_mprintf ("%s%s %s %s", buf, buf_x,
-						       buf_y, buf_z);
-				  sqlite3_free (buf_x);
-				  sqlite3_free (buf_y);
-				  sqlite3_free (buf_z);
-			      }
-			    else
-			      {
-				  xbuf =
-				      sqlite3_mprintf ("%s%s,%s,%s", buf, buf_x,
-						       buf_y, buf_z);
-				  sqlite3_free (buf_x);
-				  sqlite3_free (buf_y);
-				  sqlite3_free (buf_z);
-			      }
-			}
+			  out_coords (out_buf, precision,
+				      (version == 3) ? "% % %" : "%,%,%", x, y,
+				      z);
 		      else
-			{
-			    buf_x = sqlite3_mprintf ("%.*f", precision, x);
-			    gaiaOutClean (buf_x);
-			    buf_y = sqlite3_mprintf ("%.*f", precision, y);
-			    gaiaOutClean (buf_y);
-			    if (version == 3)
-			      {
-				  xbuf =
-				      sqlite3_mprintf ("%s%s %s", buf, buf_x,
-						       buf_y);
-				  sqlite3_free (buf_x);
-				  sqlite3_free (buf_y);
-			      }
-			    else
-			      {
-				  xbuf =
-				      sqlite3_mprintf ("%s%s,%s", buf, buf_x,
-						       buf_y);
-				  sqlite3_free (buf_x);
-				  sqlite3_free (buf_y);
-			      }
-			}
-		      gaiaAppendToOutBuffer (out_buf, xbuf);
-		      sqlite3_free (xbuf);
+			  out_coords (out_buf, precision,
+				      (version == 3) ? "% %" : "%,%", x, y);
 		  }
 		/* closing the Interior Ring */
 		if (version == 3)
@@ -3917,12 +3496,9 @@ gaiaOutGeoJSON (gaiaOutBufferPtr out_buf, gaiaGeomCollPtr geom, int precision,
     int is_multi = 0;
     int multi_count = 0;
     char *bbox;
+    gaiaOutBuffer bbox_buf;
     char crs[2048];
     char *buf;
-    char *buf_x;
-    char *buf_y;
-    char *buf_m;
-    char *buf_z = NULL;
     char endJson[16];
     if (!geom)
 	return;
@@ -3932,6 +3508,7 @@ gaiaOutGeoJSON (gaiaOutBufferPtr out_buf, gaiaGeomCollPtr geom, int precision,
     if (options != 0)
       {
 	  bbox = NULL;
+	  gaiaOutBufferInitialize (&bbox_buf);
 	  *crs = '\0';
 	  if (geom->Srid > 0)
 	    {
@@ -3954,21 +3531,9 @@ gaiaOutGeoJSON (gaiaOutBufferPtr out_buf, gaiaGeomCollPtr geom, int precision,
 	    {
 		/* including BBOX */
 		gaiaMbrGeometry (geom);
-		buf_x = sqlite3_mprintf ("%.*f", precision, geom->MinX);
-		gaiaOutClean (buf_x);
-		buf_y = sqlite3_mprintf ("%.*f", precision, geom->MinY);
-		gaiaOutClean (buf_y);
-		buf_z = sqlite3_mprintf ("%.*f", precision, geom->MaxX);
-		gaiaOutClean (buf_z);
-		buf_m = sqlite3_mprintf ("%.*f", precision, geom->MaxY);
-		gaiaOutClean (buf_m);
-		bbox =
-		    sqlite3_mprintf (",\"bbox\":[%s,%s,%s,%s]", buf_x, buf_y,
-				     buf_z, buf_m);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		sqlite3_free (buf_z);
-		sqlite3_free (buf_m);
+		out_coords (&bbox_buf, precision, ",\"bbox\":[%,%,%,%]",
+			    geom->MinX, geom->MinY, geom->MaxX, geom->MaxY);
+		bbox = bbox_buf.Buffer;
 	    }
 	  switch (geom->DeclaredType)
 	    {
@@ -4021,8 +3586,7 @@ gaiaOutGeoJSON (gaiaOutBufferPtr out_buf, gaiaGeomCollPtr geom, int precision,
 		is_multi = 1;
 		break;
 	    };
-	  if (bbox)
-	      sqlite3_free (bbox);
+	  gaiaOutBufferReset (&bbox_buf);
       }
     else
       {
@@ -4090,33 +3654,12 @@ gaiaOutGeoJSON (gaiaOutBufferPtr out_buf, gaiaGeomCollPtr geom, int precision,
 		/* adding a further Point */
 		gaiaAppendToOutBuffer (out_buf, ",");
 	    }
-	  buf_x = sqlite3_mprintf ("%.*f", precision, point->X);
-	  gaiaOutClean (buf_x);
-	  buf_y = sqlite3_mprintf ("%.*f", precision, point->Y);
-	  gaiaOutClean (buf_y);
-	  has_z = 0;
 	  if (point->DimensionModel == GAIA_XY_Z
 	      || point->DimensionModel == GAIA_XY_Z_M)
-	    {
-		buf_z = sqlite3_mprintf ("%.*f", precision, point->Z);
-		gaiaOutClean (buf_z);
-		has_z = 1;
-	    }
-	  if (has_z)
-	    {
-		buf = sqlite3_mprintf ("[%s,%s,%s]", buf_x, buf_y, buf_z);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-		sqlite3_free (buf_z);
-	    }
+	      out_coords (out_buf, precision, "[%,%,%]", point->X, point->Y,
+			  point->Z);
 	  else
-	    {
-		buf = sqlite3_mprintf ("[%s,%s]", buf_x, buf_y);
-		sqlite3_free (buf_x);
-		sqlite3_free (buf_y);
-	    }
-	  gaiaAppendToOutBuffer (out_buf, buf);
-	  sqlite3_free (buf);
+	      out_coords (out_buf, precision, "[%,%]", point->X, point->Y);
 	  if (is_multi)
 	    {
 		gaiaAppendToOutBuffer (out_buf, "}");
@@ -4166,39 +3709,18 @@ gaiaOutGeoJSON (gaiaOutBufferPtr out_buf, gaiaGeomCollPtr geom, int precision,
 		  }
 		if (has_z)
 		  {
-		      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		      gaiaOutClean (buf_x);
-		      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		      gaiaOutClean (buf_y);
-		      buf_z = sqlite3_mprintf ("%.*f", precision, z);
-		      gaiaOutClean (buf_z);
 		      if (iv == 0)
-			  buf =
-			      sqlite3_mprintf ("[%s,%s,%s]", buf_x, buf_y,
-					       buf_z);
+			  out_coords (out_buf, precision, "[%,%,%]", x, y, z);
 		      else
-			  buf =
-			      sqlite3_mprintf (",[%s,%s,%s]", buf_x, buf_y,
-					       buf_z);
-		      sqlite3_free (buf_x);
-		      sqlite3_free (buf_y);
-		      sqlite3_free (buf_z);
+			  out_coords (out_buf, precision, ",[%,%,%]", x, y, z);
 		  }
 		else
 		  {
-		      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		      gaiaOutClean (buf_x);
-		      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		      gaiaOutClean (buf_y);
 		      if (iv == 0)
-			  buf = sqlite3_mprintf ("[%s,%s]", buf_x, buf_y);
+			  out_coords (out_buf, precision, "[%,%]", x, y);
 		      else
-			  buf = sqlite3_mprintf (",[%s,%s]", buf_x, buf_y);
-		      sqlite3_free (buf_x);
-		      sqlite3_free (buf_y);
+			  out_coords (out_buf, precision, ",[%,%]", x, y);
 		  }
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
 	    }
 	  /* closing the LineString */
 	  gaiaAppendToOutBuffer (out_buf, "]");
@@ -4252,39 +3774,18 @@ gaiaOutGeoJSON (gaiaOutBufferPtr out_buf, gaiaGeomCollPtr geom, int precision,
 		  }
 		if (has_z)
 		  {
-		      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		      gaiaOutClean (buf_x);
-		      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		      gaiaOutClean (buf_y);
-		      buf_z = sqlite3_mprintf ("%.*f", precision, z);
-		      gaiaOutClean (buf_z);
 		      if (iv == 0)
-			  buf =
-			      sqlite3_mprintf ("[[%s,%s,%s]", buf_x, buf_y,
-					       buf_z);
+			  out_coords (out_buf, precision, "[[%,%,%]", x, y, z);
 		      else
-			  buf =
-			      sqlite3_mprintf (",[%s,%s,%s]", buf_x, buf_y,
-					       buf_z);
-		      sqlite3_free (buf_x);
-		      sqlite3_free (buf_y);
-		      sqlite3_free (buf_z);
+			  out_coords (out_buf, precision, ",[%,%,%]", x, y, z);
 		  }
 		else
 		  {
-		      buf_x = sqlite3_mprintf ("%.*f", precision, x);
-		      gaiaOutClean (buf_x);
-		      buf_y = sqlite3_mprintf ("%.*f", precision, y);
-		      gaiaOutClean (buf_y);
 		      if (iv == 0)
-			  buf = sqlite3_mprintf ("[[%s,%s]", buf_x, buf_y);
+			  out_coords (out_buf, precision, "[[%,%]", x, y);
 		      else
-			  buf = sqlite3_mprintf (",[%s,%s]", buf_x, buf_y);
-		      sqlite3_free (buf_x);
-		      sqlite3_free (buf_y);
+			  out_coords (out_buf, precision, ",[%,%]", x, y);
 		  }
-		gaiaAppendToOutBuffer (out_buf, buf);
-		sqlite3_free (buf);
 	    }
 	  /* closing the Exterior Ring */
 	  gaiaAppendToOutBuffer (out_buf, "]");
@@ -4317,41 +3818,22 @@ gaiaOutGeoJSON (gaiaOutBufferPtr out_buf, gaiaGeomCollPtr geom, int precision,
 			}
 		      if (has_z)
 			{
-			    buf_x = sqlite3_mprintf ("%.*f", precision, x);
-			    gaiaOutClean (buf_x);
-			    buf_y = sqlite3_mprintf ("%.*f", precision, y);
-			    gaiaOutClean (buf_y);
-			    buf_z = sqlite3_mprintf ("%.*f", precision, z);
-			    gaiaOutClean (buf_z);
 			    if (iv == 0)
-				buf =
-				    sqlite3_mprintf (",[[%s,%s,%s]", buf_x,
-						     buf_y, buf_z);
+				out_coords (out_buf, precision, ",[[%,%,%]", x,
+					    y, z);
 			    else
-				buf =
-				    sqlite3_mprintf (",[%s,%s,%s]", buf_x,
-						     buf_y, buf_z);
-			    sqlite3_free (buf_x);
-			    sqlite3_free (buf_y);
-			    sqlite3_free (buf_z);
+				out_coords (out_buf, precision, ",[%,%,%]", x,
+					    y, z);
 			}
 		      else
 			{
-			    buf_x = sqlite3_mprintf ("%.*f", precision, x);
-			    gaiaOutClean (buf_x);
-			    buf_y = sqlite3_mprintf ("%.*f", precision, y);
-			    gaiaOutClean (buf_y);
 			    if (iv == 0)
-				buf =
-				    sqlite3_mprintf (",[[%s,%s]", buf_x, buf_y);
+				out_coords (out_buf, precision, ",[[%,%]", x,
+					    y);
 			    else
-				buf =
-				    sqlite3_mprintf (",[%s,%s]", buf_x, buf_y);
-			    sqlite3_free (buf_x);
-			    sqlite3_free (buf_y);
+				out_coords (out_buf, precision, ",[%,%]", x,
+					    y);
 			}
-		      gaiaAppendToOutBuffer (out_buf, buf);
-		      sqlite3_free (buf);
 		  }
 		/* closing the Interior Ring */
 		gaiaAppendToOutBuffer (out_buf, "]");
@@ -4367,3 +3849,591 @@ gaiaOutGeoJSON (gaiaOutBufferPtr out_buf, gaiaGeomCollPtr geom, int precision,
       }
     gaiaAppendToOutBuffer (out_buf, endJson);
 }
+
+/*
+/ a fast hand-written WKT / EWKT reader
+/
+/ a single recursive descent pass directly building the final Geometry:
+/ the vertices of each Linestring or Ring are counted in advance, so
+/ that every coordinate array is allocated just once, and there are no
+/ tokens or intermediate points at all
+/
+/ only plain well-formed notations are accepted: any other input (and
+/ any syntax error) is simply rejected, thus leaving it to the LEMON
+/ parsers, which still are the reference implementation for both the
+/ syntax and the error reporting
+*/
+
+#define WKT_MAX_DEPTH	32	/* max nesting of GEOMETRYCOLLECTIONs */
+
+struct wkt_reader
+{
+/* the WKT / EWKT reader state */
+    const char *p;		/* the current position */
+    int ewkt;			/* EWKT syntax */
+    int dimension_model;
+    int dims;			/* coordinates per vertex */
+    int depth;			/* GEOMETRYCOLLECTION nesting */
+};
+
+/* powers of ten exactly representable as doubles */
+static const double wkt_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int
+wkt_is_space (char c)
+{
+/* the same whitespaces accepted by the FLEX lexers */
+    return (c == ' ' || c == '\t' || c == '\n');
+}
+
+static void
+wkt_skip_spaces (struct wkt_reader *rd)
+{
+    while (wkt_is_space (*rd->p))
+	rd->p++;
+}
+
+static int
+wkt_match (struct wkt_reader *rd, char c)
+{
+/* consuming a single punctuation char (and any following whitespace) */
+    if (*rd->p != c)
+	return 0;
+    rd->p++;
+    wkt_skip_spaces (rd);
+    return 1;
+}
+
+static int
+wkt_parse_number (struct wkt_reader *rd, double *value)
+{
+/*
+/ parsing a number: [+-]digits[.digits][(e|E)[+-]digits]
+/
+/ up to 19 significant digits and a decimal exponent in the -22/+22
+/ range are directly computed by a single (and thus correctly rounded)
+/ multiplication or division; any other case is left to strtod(),
+/ so to always get exactly the same value returned by atof()
+*/
+    const char *start = rd->p;
+    const char *p = rd->p;
+    sqlite3_uint64 mantissa = 0;
+    int significant = 0;
+    int too_long = 0;
+    int int_digits = 0;
+    int frac_digits = 0;
+    int has_point = 0;
+    int negative = 0;
+    int exp10 = 0;
+    int exp_value = 0;
+    int exp_digits = 0;
+    int exp_negative = 0;
+    double v;
+
+    if (*p == '-' || *p == '+')
+      {
+	  negative = (*p == '-');
+	  p++;
+      }
+    while (*p >= '0' && *p <= '9')
+      {
+	  if (significant < 19)
+	    {
+		mantissa = (mantissa * 10) + (*p - '0');
+		if (mantissa != 0)
+		    significant++;
+	    }
+	  else
+	      too_long = 1;
+	  int_digits++;
+	  p++;
+      }
+    if (*p == '.')
+      {
+	  has_point = 1;
+	  p++;
+	  while (*p >= '0' && *p <= '9')
+	    {
+		if (significant < 19)
+		  {
+		      mantissa = (mantissa * 10) + (*p - '0');
+		      if (mantissa != 0)
+			  significant++;
+		      exp10--;
+		  }
+		else
+		    too_long = 1;
+		frac_digits++;
+		p++;
+	    }
+      }
+    if (int_digits + frac_digits == 0)
+	return 0;
+    if (*p == 'e' || *p == 'E')
+      {
+	  if (has_point && frac_digits == 0)
+	      return 0;		/* "1.e5" is not a valid WKT number */
+	  p++;
+	  if (*p == '-' || *p == '+')
+	    {
+		exp_negative = (*p == '-');
+		p++;
+	    }
+	  while (*p >= '0' && *p <= '9')
+	    {
+		if (exp_value < 100000)
+		    exp_value = (exp_value * 10) + (*p - '0');
+		exp_digits++;
+		p++;
+	    }
+	  if (exp_digits == 0)
+	      return 0;
+	  exp10 += exp_negative ? -exp_value : exp_value;
+      }
+    if (!wkt_is_space (*p) && *p != ',' && *p != ')')
+	return 0;
+
+    if (!too_long && mantissa <= 9007199254740992ULL && exp10 >= -22
+	&& exp10 <= 22)
+      {
+	  /* fast path: both operands are exact */
+	  v = (double) mantissa;
+	  if (exp10 < 0)
+	      v /= wkt_pow10[-exp10];
+	  else
+	      v *= wkt_pow10[exp10];
+	  *value = negative ? -v : v;
+      }
+    else
+	*value = strtod (start, NULL);
+    rd->p = p;
+    return 1;
+}
+
+static int
+wkt_parse_vertex (struct wkt_reader *rd, double *coords)
+{
+/* parsing a vertex: whitespace separated coordinates */
+    int i;
+    for (i = 0; i < rd->dims; i++)
+      {
+	  if (i > 0)
+	    {
+		if (!wkt_is_space (*rd->p))
+		    return 0;
+		wkt_skip_spaces (rd);
+	    }
+	  if (!wkt_parse_number (rd, coords + i))
+	      return 0;
+      }
+    wkt_skip_spaces (rd);
+    return 1;
+}
+
+static int
+wkt_count_vertices (const char *p)
+{
+/* pre-scanning a Linestring or Ring (p just after its opening bracket) */
+    int count = 1;
+    while (1)
+      {
+	  switch (*p)
+	    {
+	    case ',':
+		count++;
+		break;
+	    case ')':
+		return count;
+	    case '(':
+	    case '\0':
+		return -1;
+	    };
+	  p++;
+      }
+}
+
+static int
+wkt_count_rings (const char *p)
+{
+/* pre-scanning a Polygon (p just after its opening bracket) */
+    int count = 0;
+    int depth = 0;
+    while (*p != '\0')
+      {
+	  if (*p == '(')
+	    {
+		if (depth == 0)
+		    count++;
+		depth++;
+	    }
+	  else if (*p == ')')
+	    {
+		if (depth == 0)
+		    return count;
+		depth--;
+	    }
+	  p++;
+      }
+    return -1;
+}
+
+static int
+wkt_parse_coords (struct wkt_reader *rd, double *coords, int points)
+{
+/* parsing a list of vertices: (x y, x y, ...) */
+    int iv;
+    if (!wkt_match (rd, '('))
+	return 0;
+    for (iv = 0; iv < points; iv++)
+      {
+	  if (iv > 0 && !wkt_match (rd, ','))
+	      return 0;
+	  if (!wkt_parse_vertex (rd, coords + (iv * rd->dims)))
+	      return 0;
+      }
+    return wkt_match (rd, ')');
+}
+
+static void
+wkt_add_point (struct wkt_reader *rd, gaiaGeomCollPtr geom,
+	       const double *coords)
+{
+/* adding a Point to the Geometry */
+    switch (rd->dimension_model)
+      {
+      case GAIA_XY_Z:
+	  gaiaAddPointToGeomCollXYZ (geom, coords[0], coords[1], coords[2]);
+	  break;
+      case GAIA_XY_M:
+	  gaiaAddPointToGeomCollXYM (geom, coords[0], coords[1], coords[2]);
+	  break;
+      case GAIA_XY_Z_M:
+	  gaiaAddPointToGeomCollXYZM (geom, coords[0], coords[1], coords[2],
+				      coords[3]);
+	  break;
+      default:
+	  gaiaAddPointToGeomColl (geom, coords[0], coords[1]);
+	  break;
+      };
+}
+
+static int
+wkt_parse_point (struct wkt_reader *rd, gaiaGeomCollPtr geom)
+{
+/* parsing a Point: (x y) */
+    double coords[4];
+    if (!wkt_match (rd, '('))
+	return 0;
+    if (!wkt_parse_vertex (rd, coords))
+	return 0;
+    if (!wkt_match (rd, ')'))
+	return 0;
+    wkt_add_point (rd, geom, coords);
+    return 1;
+}
+
+static int
+wkt_parse_linestring (struct wkt_reader *rd, gaiaGeomCollPtr geom)
+{
+/* parsing a Linestring: (x y, x y, ...) */
+    gaiaLinestringPtr line;
+    int points;
+    if (*rd->p != '(')
+	return 0;
+    points = wkt_count_vertices (rd->p + 1);
+    if (points < 2)
+	return 0;
+    line = gaiaAddLinestringToGeomColl (geom, points);
+    return wkt_parse_coords (rd, line->Coords, points);
+}
+
+static int
+wkt_parse_polygon (struct wkt_reader *rd, gaiaGeomCollPtr geom)
+{
+/* parsing a Polygon: ((x y, x y, ...), (x y, x y, ...) ...) */
+    gaiaPolygonPtr polyg;
+    gaiaRingPtr ring;
+    int rings;
+    int points;
+    int ib;
+    if (*rd->p != '(')
+	return 0;
+    rings = wkt_count_rings (rd->p + 1);
+    if (rings < 1)
+	return 0;
+    rd->p++;
+    wkt_skip_spaces (rd);
+    if (*rd->p != '(')
+	return 0;
+    points = wkt_count_vertices (rd->p + 1);
+    if (points < 4)
+	return 0;
+    polyg = gaiaAddPolygonToGeomColl (geom, points, rings - 1);
+    if (!wkt_parse_coords (rd, polyg->Exterior->Coords, points))
+	return 0;
+    for (ib = 0; ib < rings - 1; ib++)
+      {
+	  if (!wkt_match (rd, ','))
+	      return 0;
+	  if (*rd->p != '(')
+	      return 0;
+	  points = wkt_count_vertices (rd->p + 1);
+	  if (points < 4)
+	      return 0;
+	  ring = gaiaAddInteriorRing (polyg, ib, points);
+	  if (!wkt_parse_coords (rd, ring->Coords, points))
+	      return 0;
+      }
+    return wkt_match (rd, ')');
+}
+
+static int
+wkt_parse_multipoint (struct wkt_reader *rd, gaiaGeomCollPtr geom)
+{
+/* parsing a MultiPoint: either (x y, x y, ...) or ((x y), (x y), ...) */
+    double coords[4];
+    int bracketed;
+    if (!wkt_match (rd, '('))
+	return 0;
+    bracketed = (*rd->p == '(');
+    while (1)
+      {
+	  if (bracketed && !wkt_match (rd, '('))
+	      return 0;
+	  if (!wkt_parse_vertex (rd, coords))
+	      return 0;
+	  if (bracketed && !wkt_match (rd, ')'))
+	      return 0;
+	  wkt_add_point (rd, geom, coords);
+	  if (wkt_match (rd, ')'))
+	      return 1;
+	  if (!wkt_match (rd, ','))
+	      return 0;
+      }
+}
+
+static int
+wkt_parse_multi (struct wkt_reader *rd, gaiaGeomCollPtr geom,
+		 int (*parse_item) (struct wkt_reader *, gaiaGeomCollPtr))
+{
+/* parsing a MultiLinestring or a MultiPolygon: (item, item, ...) */
+    if (!wkt_match (rd, '('))
+	return 0;
+    while (1)
+      {
+	  if (!parse_item (rd, geom))
+	      return 0;
+	  if (wkt_match (rd, ')'))
+	      return 1;
+	  if (!wkt_match (rd, ','))
+	      return 0;
+      }
+}
+
+static int
+wkt_match_keyword (struct wkt_reader *rd, const char *keyword)
+{
+/* case-insensitive matching of a keyword */
+    int len = strlen (keyword);
+    if (strncasecmp (rd->p, keyword, len) != 0)
+	return 0;
+    rd->p += len;
+    return 1;
+}
+
+static int
+wkt_parse_tag (struct wkt_reader *rd, int *type, int *dimension_model)
+{
+/*
+/ parsing a Geometry class tag:
+/ - WKT: POINT, POINT Z, POINT M, POINT ZM (whitespace is optional)
+/ - EWKT: POINT or POINTM only
+*/
+    if (wkt_match_keyword (rd, "GEOMETRYCOLLECTION"))
+	*type = GAIA_GEOMETRYCOLLECTION;
+    else if (wkt_match_keyword (rd, "MULTIPOINT"))
+	*type = GAIA_MULTIPOINT;
+    else if (wkt_match_keyword (rd, "MULTILINESTRING"))
+	*type = GAIA_MULTILINESTRING;
+    else if (wkt_match_keyword (rd, "MULTIPOLYGON"))
+	*type = GAIA_MULTIPOLYGON;
+    else if (wkt_match_keyword (rd, "POINT"))
+	*type = GAIA_POINT;
+    else if (wkt_match_keyword (rd, "LINESTRING"))
+	*type = GAIA_LINESTRING;
+    else if (wkt_match_keyword (rd, "POLYGON"))
+	*type = GAIA_POLYGON;
+    else
+	return 0;
+    *dimension_model = GAIA_XY;
+    if (rd->ewkt)
+      {
+	  if (wkt_match_keyword (rd, "M"))
+	      *dimension_model = GAIA_XY_M;
+      }
+    else
+      {
+	  wkt_skip_spaces (rd);
+	  if (wkt_match_keyword (rd, "ZM"))
+	      *dimension_model = GAIA_XY_Z_M;
+	  else if (wkt_match_keyword (rd, "Z"))
+	      *dimension_model = GAIA_XY_Z;
+	  else if (wkt_match_keyword (rd, "M"))
+	      *dimension_model = GAIA_XY_M;
+      }
+    wkt_skip_spaces (rd);
+    return 1;
+}
+
+static int wkt_parse_collection (struct wkt_reader *rd, gaiaGeomCollPtr geom);
+
+static int
+wkt_parse_body (struct wkt_reader *rd, gaiaGeomCollPtr geom, int type)
+{
+/* parsing the body of a Geometry of the given class */
+    switch (type)
+      {
+      case GAIA_POINT:
+	  return wkt_parse_point (rd, geom);
+      case GAIA_LINESTRING:
+	  return wkt_parse_linestring (rd, geom);
+      case GAIA_POLYGON:
+	  return wkt_parse_polygon (rd, geom);
+      case GAIA_MULTIPOINT:
+	  return wkt_parse_multipoint (rd, geom);
+      case GAIA_MULTILINESTRING:
+	  return wkt_parse_multi (rd, geom, wkt_parse_linestring);
+      case GAIA_MULTIPOLYGON:
+	  return wkt_parse_multi (rd, geom, wkt_parse_polygon);
+      case GAIA_GEOMETRYCOLLECTION:
+	  return wkt_parse_collection (rd, geom);
+      };
+    return 0;
+}
+
+static int
+wkt_parse_collection (struct wkt_reader *rd, gaiaGeomCollPtr geom)
+{
+/* parsing a GeometryCollection: nested collections are flattened */
+    int type;
+    int dimension_model;
+    int ok;
+    if (rd->depth >= WKT_MAX_DEPTH)
+	return 0;
+    if (!wkt_match (rd, '('))
+	return 0;
+    while (1)
+      {
+	  if (!wkt_parse_tag (rd, &type, &dimension_model))
+	      return 0;
+	  /* all items must have the same dimensions of the collection */
+	  if (rd->ewkt)
+	      ok = ((dimension_model == GAIA_XY_M) ==
+		    (rd->dimension_model == GAIA_XY_M));
+	  else
+	      ok = (dimension_model == rd->dimension_model);
+	  if (!ok)
+	      return 0;
+	  rd->depth++;
+	  ok = wkt_parse_body (rd, geom, type);
+	  rd->depth--;
+	  if (!ok)
+	      return 0;
+	  if (wkt_match (rd, ')'))
+	      return 1;
+	  if (!wkt_match (rd, ','))
+	      return 0;
+      }
+}
+
+static int
+ewkt_count_dims (const char *p)
+{
+/* EWKT: pre-scanning the first vertex so to identify the dimensions */
+    int count = 0;
+    while (*p != '\0' && !(*p >= '0' && *p <= '9') && *p != '-' && *p != '+'
+	   && *p != '.')
+	p++;
+    while (*p != '\0' && *p != ',' && *p != ')')
+      {
+	  count++;
+	  while (*p != '\0' && *p != ',' && *p != ')' && !wkt_is_space (*p))
+	      p++;
+	  while (wkt_is_space (*p))
+	      p++;
+      }
+    return count;
+}
+
+SPATIALITE_PRIVATE void *
+gaiaFastParseWkt (const unsigned char *buffer, int ewkt)
+{
+/*
+/ attempting to parse a WKT (or EWKT, without the SRID= prefix)
+/ by using the fast reader
+/
+/ returns NULL whenever the LEMON parser is required
+*/
+    struct wkt_reader rd;
+    gaiaGeomCollPtr geom;
+    int type;
+    int dims;
+
+    rd.p = (const char *) buffer;
+    rd.ewkt = ewkt;
+    rd.depth = 0;
+    wkt_skip_spaces (&rd);
+    if (!wkt_parse_tag (&rd, &type, &(rd.dimension_model)))
+	return NULL;
+    if (ewkt && rd.dimension_model == GAIA_XY)
+      {
+	  /* EWKT: the dimensions depend on the coordinates */
+	  dims = ewkt_count_dims (rd.p);
+	  if (dims == 3)
+	      rd.dimension_model = GAIA_XY_Z;
+	  else if (dims == 4)
+	      rd.dimension_model = GAIA_XY_Z_M;
+	  else if (dims != 2)
+	      return NULL;
+      }
+    switch (rd.dimension_model)
+      {
+      case GAIA_XY_Z:
+	  geom = gaiaAllocGeomCollXYZ ();
+	  rd.dims = 3;
+	  break;
+      case GAIA_XY_M:
+	  geom = gaiaAllocGeomCollXYM ();
+	  rd.dims = 3;
+	  break;
+      case GAIA_XY_Z_M:
+	  geom = gaiaAllocGeomCollXYZM ();
+	  rd.dims = 4;
+	  break;
+      default:
+	  geom = gaiaAllocGeomColl ();
+	  rd.dims = 2;
+	  break;
+      };
+    geom->DeclaredType = type;
+    if (type == GAIA_POINT)
+      {
+	  /* a POINT also declares its dimensions */
+	  if (rd.dimension_model == GAIA_XY_Z)
+	      geom->DeclaredType = GAIA_POINTZ;
+	  else if (rd.dimension_model == GAIA_XY_M)
+	      geom->DeclaredType = GAIA_POINTM;
+	  else if (rd.dimension_model == GAIA_XY_Z_M)
+	      geom->DeclaredType = GAIA_POINTZM;
+      }
+
+    if (!wkt_parse_body (&rd, geom, type) || *rd.p != '\0')
+      {
+	  gaiaFreeGeomColl (geom);
+	  return NULL;
+      }
+    return geom;
+}
@@ -346,7 +346,7 @@ extern "C"
 
  \return 0 on failure, any other value on success
 
- \sa load_shapefile_ex, load_shapefile_ex2, load_shapefile_ex3
+ \sa load_shapefile_ex, load_shapefile_ex2, load_shapefile_ex3, load_shapefile_ex4
 
  \note this function simply calls load_shapefile_ex by passing 
   implicit gype="AUTO" and pk_column=NULL arguments
@@ -383,7 +383,7 @@ extern "C"
 
  \return 0 on failure, any other value on success
 
- \sa load_shapefile, load_shapefile_ex2, load_shapefile_ex3
+ \sa load_shapefile, load_shapefile_ex2, load_shapefile_ex3, load_shapefile_ex4
 
  \note the Shapefile format doesn't supports any distinction between
   LINESTRINGs and MULTILINESTRINGs, or between POLYGONs and MULTIPOLYGONs;
@@ -428,7 +428,7 @@ extern "C"
 
  \return 0 on failure, any other value on success
 
- \sa load_shapefile, load_shapefile_ex, load_shapefile_ex3
+ \sa load_shapefile, load_shapefile_ex, load_shapefile_ex3, load_shapefile_ex4
 
  \note the Shapefile format doesn't supports any distinction between
   LINESTRINGs and MULTILINESTRINGs, or between POLYGONs and MULTIPOLYGONs;
@@ -476,7 +476,7 @@ extern "C"
 
  \return 0 on failure, any other value on success
 
- \sa load_shapefile, load_shapefile_ex, load_shapefile_ex2
+ \sa load_shapefile, load_shapefile_ex, load_shapefile_ex2, load_shapefile_ex4
 
  \note the Shapefile format doesn't supports any distinction between
   LINESTRINGs and MULTILINESTRINGs, or between POLYGONs and MULTIPOLYGONs;
@@ -496,6 +496,55 @@ extern "C"
 					       int text_date, int *rows,
 					       int colname_case, char *err_msg);
 
+/**
+ Loads an external Shapefile into a newly created table
+
+ \param sqlite handle to current DB connection
+ \param shp_path pathname of the Shapefile to be imported (no suffix) 
+ \param table the name of the table to be created
+ \param charset a valid GNU ICONV charset to be used for DBF text strings
+ \param srid the SRID to be set for Geometries
+ \param geo_column the name of the geometry column
+ \param gtype expected to be one of: "LINESTRING", "LINESTRINGZ", 
+  "LINESTRINGM", "LINESTRINGZM", "MULTILINESTRING", "MULTILINESTRINGZ",
+  "MULTILINESTRINGM", "MULTILINESTRINGZM", "POLYGON", "POLYGONZ", "POLYGONM", 
+  "POLYGONZM", "MULTIPOLYGON", "MULTIPOLYGONZ", "MULTIPOLYGONM", 
+  "MULTIPOLYGONZM" or "AUTO".
+ \param pk_column name of the Primary Key column; if NULL or mismatching
+ then "PK_UID" will be assumed by default.
+ \param coerce2d if TRUE any Geometry will be casted to 2D [XY]
+ \param compressed if TRUE compressed Geometries will be created
+ \param verbose if TRUE a short report is shown on stderr
+ \param spatial_index if TRUE an R*Tree Spatial Index will be created
+ \param text_dates is TRUE all DBF dates will be considered as TEXT
+ \param rows on completion will contain the total number of imported rows
+ \param colname_case one between GAIA_DBF_COLNAME_LOWERCASE, 
+	GAIA_DBF_COLNAME_UPPERCASE or GAIA_DBF_COLNAME_CASE_IGNORE.
+ \param threads number of worker threads used for reading and decoding
+  the Shapefile entities; 1 means a plain single-threaded import.
+ \param err_msg on completion will contain an error message (if any)
+
+ \return 0 on failure, any other value on success
+
+ \sa load_shapefile, load_shapefile_ex, load_shapefile_ex2, 
+ load_shapefile_ex3
+
+ \note when threads is greater than 1 the entities will be read, 
+  decoded and encoded as BLOB Geometries by several worker threads,
+  while the calling thread will INSERT them into the DB in their 
+  original order; the resulting table is exactly the same.
+ \n on Windows the import is always single-threaded.
+ */
+    SPATIALITE_DECLARE int load_shapefile_ex4 (sqlite3 * sqlite, char *shp_path,
+					       char *table, char *charset,
+					       int srid, char *geo_column,
+					       char *gtype, char *pk_column,
+					       int coerce2d, int compressed,
+					       int verbose, int spatial_index,
+					       int text_date, int *rows,
+					       int colname_case, int threads,
+					       char *err_msg);
+
 /**
  Loads an external DBF file into a newly created table
 
@@ -1965,6 +2014,189 @@ extern "C"
 						const char *oneway_to,
 						int overwrite);
 
+/**
+ Will attempt to create a VirtualRouting from an input table,
+ optionally supporting Contraction Hierarchies
+
+ \param db_handle handle to the current SQLite connection
+ \param cache a memory pointer returned by spatialite_alloc_connection()
+ \param routing_data_table name of the Routing Data Table to be created.
+ \param virtual_routing_table name of the VirtualRouting Table to be created.
+ \param input_table name of the input table to be processed.
+ \param from_column name of the input table column containing NodeFrom.
+ \param to_column name of the input table column containing NodeTo.
+ \param geom_column name of the input table column containing Linestring Geometries
+ (could be eventually NULL).
+ \param cost_column name of the input table column containing Cost values
+ (could be eventually NULL).
+ \param name_column name of the input table column containing RoadName
+ (could be eventually NULL).
+ \param a_star_enabled if set to TRUE the Routing Data Table will support
+ both Djiskra's Shortest Path and A* algorithms.
+ \param bidirectional if set to TRUE all input arcs/links will be assumed
+ to be bidirectional (from-to and to-from).
+ \param oneway_from name of the input table column containing OneWayFrom
+ (could be eventually NULL).
+ \param oneway_to name of the input table column containing OneWayTo
+ (could be eventually NULL).
+ \param overwrite if set to TRUE both the Routing Data Table and the
+ VirtualRouting Table will be dropped if already existing.
+ \param ch_enabled if set to TRUE a Contraction Hierarchy will be
+ built and stored into the Routing Data Table (shortcut edges and
+ node ranks), so that the VirtualRouting Table will support the
+ bidirectional "CH" algorithm as well.
+
+ \return 0 on failure, any other value on success
+
+ \sa gaia_create_routing
+
+ \note building a Contraction Hierarchy may require a noticeable
+ time on huge networks, but will make all Point-to-Point queries
+ dramatically faster.
+ */
+    SPATIALITE_DECLARE int gaia_create_routing_ex (sqlite3 * db_handle,
+						   const void *cache,
+						   const char
+						   *routing_data_table,
+						   const char
+						   *virtual_routing_table,
+						   const char *input_table,
+						   const char *from_column,
+						   const char *to_column,
+						   const char *geom_column,
+						   const char *cost_column,
+						   const char *name_column,
+						   int a_star_enabled,
+						   int bidirectional,
+						   const char *oneway_from,
+						   const char *oneway_to,
+						   int overwrite,
+						   int ch_enabled);
+
+/**
+ Will attempt to store Turn penalties and restrictions into an
+ already existing Routing Data Table
+
+ \param db_handle handle to the current SQLite connection
+ \param cache a memory pointer returned by spatialite_alloc_connection()
+ \param routing_data_table name of the Routing Data Table.
+ \param input_table name of the input table containing all Turns.
+ \param from_link_column name of the input table column containing the
+ ROWID of the incoming Link.
+ \param to_link_column name of the input table column containing the
+ ROWID of the outcoming Link.
+ \param cost_column name of the input table column containing the Turn
+ penalty (could be eventually NULL). a NULL or negative penalty
+ (or a NULL cost_column) will forbid the Turn.
+
+ \return 0 on failure, any other value on success
+
+ \sa gaia_create_routing_ex, gaia_create_routing_profiles
+
+ \note any previous Turn will be replaced. a VirtualRouting Table
+ will then run an edge-based (turn-aware) search for both the Dijkstra
+ and A* algorithms. the Turn applies wherever the two Links meet
+ (both directions of a bidirectional Link share the same ROWID, so that
+ a Turn from a Link into itself will forbid or penalize U-turns).
+ */
+    SPATIALITE_DECLARE int gaia_create_routing_turns (sqlite3 * db_handle,
+						      const void *cache,
+						      const char
+						      *routing_data_table,
+						      const char *input_table,
+						      const char
+						      *from_link_column,
+						      const char
+						      *to_link_column,
+						      const char *cost_column);
+
+/**
+ Will attempt to store Time Dependent travel time profiles into an
+ already existing Routing Data Table
+
+ \param db_handle handle to the current SQLite connection
+ \param cache a memory pointer returned by spatialite_alloc_connection()
+ \param routing_data_table name of the Routing Data Table.
+ \param input_table name of the input table containing all profiles.
+ \param link_column name of the input table column containing the
+ ROWID of the Link.
+ \param time_column name of the input table column containing the Time
+ of the day (seconds since midnight, 0 - 86399) of each breakpoint.
+ \param cost_column name of the input table column containing the
+ travel time (seconds) required by the Link when entering at that Time.
+
+ \return 0 on failure, any other value on success
+
+ \sa gaia_create_routing_ex, gaia_create_routing_turns
+
+ \note any previous profile will be replaced. profiles are piecewise
+ linear and periodic over a whole day; Links without any profile will
+ always cost their ordinary Cost. profiles are only used when the
+ DepartureTime column of the VirtualRouting Table has been set.
+ */
+    SPATIALITE_DECLARE int gaia_create_routing_profiles (sqlite3 * db_handle,
+							 const void *cache,
+							 const char
+							 *routing_data_table,
+							 const char
+							 *input_table,
+							 const char
+							 *link_column,
+							 const char
+							 *time_column,
+							 const char
+							 *cost_column);
+
+/**
+ Will attempt to incrementally update some Links of an already existing
+ Routing Data Table, so to avoid a full rebuild
+
+ \param db_handle handle to the current SQLite connection
+ \param cache a memory pointer returned by spatialite_alloc_connection()
+ \param routing_data_table name of the Routing Data Table.
+ \param link_rowids array of ROWIDs (referencing the input table) of all
+ the Links to be updated.
+ \param count number of items into the link_rowids array.
+ \param cost_column name of the input table column containing the Cost
+ of each Link (could be eventually NULL, in this case the Cost will be
+ the Geometry length).
+ \param bidirectional if TRUE all Links will be assumed to be bidirectional.
+ \param oneway_from name of the input table column containing the
+ OneWay From/To indicator (could be eventually NULL).
+ \param oneway_to name of the input table column containing the OneWay
+ To/From indicator (could be eventually NULL).
+
+ \return 0 on failure, any other value on success
+
+ \sa gaia_create_routing_ex
+
+ \note the input table and the NodeFrom / NodeTo columns are the ones
+ recorded by CreateRouting, and all other arguments are expected to be
+ the same passed to gaia_create_routing_ex(). a Link no longer existing
+ in the input table (or having a NULL Cost) will be removed; all the
+ referenced Nodes must already exist. any Contraction Hierarchy will
+ be discarded. any VirtualRouting Table will then automatically reload
+ just the modified Blocks before executing its next query.
+ */
+    SPATIALITE_DECLARE int gaia_create_routing_update_links (sqlite3 *
+							     db_handle,
+							     const void
+							     *cache,
+							     const char
+							     *routing_data_table,
+							     const
+							     sqlite3_int64 *
+							     link_rowids,
+							     int count,
+							     const char
+							     *cost_column,
+							     int
+							     bidirectional,
+							     const char
+							     *oneway_from,
+							     const char
+							     *oneway_to);
+
 /**
   Will attempt to retrieve the Full Extent from an R*Tree (SpatiaLite)
    
@@ -2012,6 +2244,94 @@ extern "C"
 								       void
 								       *cache);
 
+/**
+ Will evaluate a Spatial Join on several worker threads
+
+ \param db_handle handle to the current SQLite connection
+ \param cache a memory pointer returned by spatialite_alloc_connection()
+ \param left_table name of the Left input table.
+ \param left_geom name of the Left Geometry column.
+ \param right_table name of the Right input table; must be supported by
+ an R*Tree Spatial Index.
+ \param right_geom name of the Right Geometry column.
+ \param predicate name of the Spatial Predicate to be evaluated, one of
+ Intersects, Contains, Within, Touches, Crosses, Overlaps, Covers,
+ CoveredBy, Equals (all of them requiring GEOS, an ST_ prefix is allowed),
+ MbrIntersects, MbrContains, MbrWithin, MbrOverlaps, MbrTouches or MbrEqual.
+ \param out_table name of the output table to be created; will contain
+ two columns (left_rowid, right_rowid).
+ \param threads max number of worker threads; a value less than 1 means
+ as many threads as the available processors.
+ \param count on completion will contain the number of joined pairs.
+
+ \return 0 on failure, any other value on success
+
+ \note the Left table is partitioned into grid cells (if it has an
+ R*Tree Spatial Index) or into ROWID ranges; each worker thread evaluates
+ partitions on its own read-only connection, and the calling connection
+ is the only one INSERTing into the output table.
+ In-memory DBs, and calls issued while a transaction is pending on the
+ calling connection (whose uncommitted changes would be invisible to the
+ worker connections), are always processed on the calling connection alone.
+ */
+    SPATIALITE_DECLARE int gaia_parallel_spatial_join (sqlite3 * db_handle,
+						       const void *cache,
+						       const char *left_table,
+						       const char *left_geom,
+						       const char
+						       *right_table,
+						       const char
+						       *right_geom,
+						       const char *predicate,
+						       const char *out_table,
+						       int threads,
+						       sqlite3_int64 * count);
+
+    SPATIALITE_DECLARE const char
+	*gaia_parallel_spatial_join_get_last_error (const void *cache);
+
+/**
+ Will find the K nearest Features for every row of a table
+
+ \param db_handle handle to the current SQLite connection
+ \param cache a memory pointer returned by spatialite_alloc_connection()
+ \param point_table name of the table containing the reference Geometries.
+ \param point_geom name of the reference Geometry column.
+ \param target_table name of the table (or Spatial View) to be searched;
+ must be supported by an R*Tree Spatial Index.
+ \param target_geom name of the searched Geometry column.
+ \param k max number of nearest Features for each reference Geometry
+ (from 1 to 10000).
+ \param out_table name of the output table to be created; will contain
+ four columns (point_rowid, pos, target_rowid, distance).
+ \param threads max number of worker threads; a value less than 1 means
+ as many threads as the available processors.
+ \param count on completion will contain the number of output rows.
+
+ \return 0 on failure, any other value on success
+
+ \note reference Geometries are sorted along a Hilbert curve and then
+ evaluated in blocks; each connection prepares its KNN statements only
+ once for the whole batch. Each worker thread evaluates blocks on its own
+ read-only connection, and the calling connection is the only one
+ INSERTing into the output table.
+ In-memory DBs, and calls issued while a transaction is pending on the
+ calling connection (whose uncommitted changes would be invisible to the
+ worker connections), are always processed on the calling connection alone.
+ Requires both GEOS and KNN support.
+ */
+    SPATIALITE_DECLARE int gaia_knn_join (sqlite3 * db_handle,
+					  const void *cache,
+					  const char *point_table,
+					  const char *point_geom,
+					  const char *target_table,
+					  const char *target_geom, int k,
+					  const char *out_table, int threads,
+					  sqlite3_int64 * count);
+
+    SPATIALITE_DECLARE const char *gaia_knn_join_get_last_error (const void
+								 *cache);
+
     SPATIALITE_DECLARE int gaiaGPKG2Spatialite (sqlite3 * handle_in,
 						const char *gpkg_in_path,
 						sqlite3 * handle_out,
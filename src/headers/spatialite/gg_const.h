@@ -330,6 +330,18 @@ extern "C"
 #define GAIA_NET_A_STAR_COEFF	0xa5
 /** VirtualNetwork internal markers: BLOCK */
 #define GAIA_NET_BLOCK		0xed
+/** VirtualNetwork internal markers: Contraction Hierarchies BLOCK */
+#define GAIA_NET_CH_BLOCK	0xec
+/** VirtualNetwork internal markers: Turn penalties/restrictions BLOCK */
+#define GAIA_NET_TURN_BLOCK	0xeb
+/** VirtualNetwork internal markers: Time Dependent profiles BLOCK */
+#define GAIA_NET_TD_BLOCK	0xea
+/** VirtualNetwork internal markers: incremental updates BLOCK */
+#define GAIA_NET_UPDATE_BLOCK	0xe9
+/** VirtualNetwork internal: Id of the incremental updates Generation */
+#define GAIA_NET_UPDATE_STAMP_ID	-1
+/** VirtualNetwork internal: Id of the incremental updates Log */
+#define GAIA_NET_UPDATE_LOG_ID	-2
 
 /* constants used for Coordinate Dimensions */
 /** Coordinate Dimensions: XY */
@@ -445,6 +457,10 @@ extern "C"
 /** WKT style is ESRI */
 #define GAIA_PROJ_WKT_ESRI	4
 
+/* constants used for decimal precision of Text notations */
+/** shortest decimal digits reading back as exactly the same double */
+#define GAIA_PRECISION_SHORTEST	-1000
+
 /* macros */
 /**
  macro extracting XY coordinates
@@ -164,6 +164,27 @@ extern "C"
 					 int little_endian,
 					 int little_endian_arch);
 
+/**
+ Import an array of DOUBLE values in endian-aware fashion
+ 
+ \param values the internal array (output buffer).
+ \param p endian-dependent representation (input buffer).
+ \param count number of DOUBLE values to be imported.
+ \param little_endian 0 if the input buffer is big-endian: any other value
+ for little-endian.
+ \param little_endian_arch the value returned by gaiaEndianArch()
+
+ \sa gaiaEndianArch, gaiaImport64, gaiaExport64Array
+
+ \note you are expected to pass an input buffer corresponding to an
+ allocation size of (at least) 8 * count bytes; when the input buffer and
+ the CPU share the same byte ordering the whole array is copied at once.
+ */
+    GAIAGEO_DECLARE void gaiaImport64Array (double *values,
+					    const unsigned char *p, int count,
+					    int little_endian,
+					    int little_endian_arch);
+
 /**
  Import an INT-64 in endian-aware fashion
  
@@ -273,6 +294,26 @@ extern "C"
 				       int little_endian,
 				       int little_endian_arch);
 
+/**
+ Export an array of DOUBLE values in endian-aware fashion
+ 
+ \param p endian-dependent representation (output buffer).
+ \param values the internal array to be exported.
+ \param count number of DOUBLE values to be exported.
+ \param little_endian 0 if the output buffer has to be big-endian: any other value
+ for little-endian.
+ \param little_endian_arch the value returned by gaiaEndianArch()
+
+ \sa gaiaEndianArch, gaiaExport64, gaiaImport64Array
+
+ \note you are expected to pass an output buffer corresponding to an
+ allocation size of (at least) 8 * count bytes.
+ */
+    GAIAGEO_DECLARE void gaiaExport64Array (unsigned char *p,
+					    const double *values, int count,
+					    int little_endian,
+					    int little_endian_arch);
+
 /**
  Export an INT-64 value in endian-aware fashion
  
@@ -337,6 +378,27 @@ extern "C"
     GAIAGEO_DECLARE void gaiaAppendToOutBuffer (gaiaOutBufferPtr buf,
 						const char *text);
 
+/**
+ Appends a formatted double at the end of Text output buffer
+
+ \param buf pointer to gaiaOutBufferStruct structure.
+ \param value the double value to be appended.
+ \param precision the number of decimal digits to be used; any negative
+ value will select the default precision (6 decimal digits), and
+ GAIA_PRECISION_SHORTEST will select the shortest decimal representation
+ reading back as exactly the same double.
+
+ \sa gaiaOutBufferInitialize, gaiaAppendToOutBuffer
+
+ \note the value is always formatted in plain positional notation,
+ suppressing any trailing zero and never exceeding 16 significant digits
+ (unless GAIA_PRECISION_SHORTEST was required); this is the same format
+ used by all Text notations (WKT, EWKT, GeoJSON, KML, GML, SVG).
+ */
+    GAIAGEO_DECLARE void gaiaAppendDoubleToOutBuffer (gaiaOutBufferPtr buf,
+						      double value,
+						      int precision);
+
 /**
  Creates a BLOB-Geometry representing a Point (BLOB-Geometry)
 
@@ -580,6 +642,113 @@ extern "C"
 								 int
 								 gpkg_amphibious);
 
+/**
+ Initializes a read-only view over a SpatiaLite BLOB-Geometry
+
+ \param view pointer to the view to be initialized
+ \param blob pointer to BLOB-Geometry
+ \param size the BLOB's size
+
+ \return 0 on failure: any other value on success.
+
+ \sa gaiaBlobViewGeometryType, gaiaBlobViewGetPoint,
+ gaiaBlobViewGetLinestring, gaiaBlobViewGetLinestringVertex,
+ gaiaBlobViewGetPolygon, gaiaFromSpatiaLiteBlobWkbEx
+
+ \note the view never allocates any memory, and simply references the
+ BLOB buffer; so the BLOB must remain valid while the view is in use.
+ \n only perfectly regular SpatiaLite BLOBs (including TinyPoint) are
+ accepted: GPKG Geometry-BLOBs or malformed BLOBs will cause a failure,
+ and the caller is then expected to fall back to gaiaFromSpatiaLiteBlobWkbEx().
+ */
+    GAIAGEO_DECLARE int gaiaBlobViewInit (gaiaBlobViewPtr view,
+					  const unsigned char *blob,
+					  unsigned int size);
+
+/**
+ Determines the Geometry Class of a BLOB-Geometry view
+
+ \param view pointer to an initialized view
+
+ \return the Geometry Class (same as gaiaGeometryType() would
+ return for the corresponding Geometry object)
+
+ \sa gaiaBlobViewInit, gaiaGeometryType
+ */
+    GAIAGEO_DECLARE int gaiaBlobViewGeometryType (gaiaBlobViewPtr view);
+
+/**
+ Reads a POINT from a BLOB-Geometry view
+
+ \param view pointer to an initialized view
+ \param index relative index of the POINT [first POINT has index 0]
+ \param x on completion will contain the X coordinate
+ \param y on completion will contain the Y coordinate
+ \param z on completion will contain the Z coordinate (0.0 if not supported)
+ \param m on completion will contain the M coordinate (0.0 if not supported)
+
+ \return 0 on failure: any other value on success.
+
+ \sa gaiaBlobViewInit
+ */
+    GAIAGEO_DECLARE int gaiaBlobViewGetPoint (gaiaBlobViewPtr view,
+					      int index, double *x,
+					      double *y, double *z, double *m);
+
+/**
+ Retrieves the number of vertices of a LINESTRING from a BLOB-Geometry view
+
+ \param view pointer to an initialized view
+ \param index relative index of the LINESTRING [first LINESTRING has index 0]
+ \param points on completion will contain the number of vertices
+
+ \return 0 on failure: any other value on success.
+
+ \sa gaiaBlobViewInit, gaiaBlobViewGetLinestringVertex
+ */
+    GAIAGEO_DECLARE int gaiaBlobViewGetLinestring (gaiaBlobViewPtr view,
+						   int index, int *points);
+
+/**
+ Reads a single vertex of a LINESTRING from a BLOB-Geometry view
+
+ \param view pointer to an initialized view
+ \param index relative index of the LINESTRING [first LINESTRING has index 0]
+ \param vertex relative index of the vertex [first vertex has index 0]
+ \param x on completion will contain the X coordinate
+ \param y on completion will contain the Y coordinate
+ \param z on completion will contain the Z coordinate (0.0 if not supported)
+ \param m on completion will contain the M coordinate (0.0 if not supported)
+
+ \return 0 on failure: any other value on success.
+
+ \sa gaiaBlobViewInit, gaiaBlobViewGetLinestring
+
+ \note vertices of compressed LINESTRINGs are expanded on demand, so
+ the returned values are exactly the same the full decoder would return.
+ */
+    GAIAGEO_DECLARE int gaiaBlobViewGetLinestringVertex (gaiaBlobViewPtr
+							 view, int index,
+							 int vertex,
+							 double *x,
+							 double *y,
+							 double *z,
+							 double *m);
+
+/**
+ Retrieves the number of Interior Rings of a POLYGON from a BLOB-Geometry view
+
+ \param view pointer to an initialized view
+ \param index relative index of the POLYGON [first POLYGON has index 0]
+ \param interiors on completion will contain the number of Interior Rings
+
+ \return 0 on failure: any other value on success.
+
+ \sa gaiaBlobViewInit
+ */
+    GAIAGEO_DECLARE int gaiaBlobViewGetPolygon (gaiaBlobViewPtr view,
+						int index, int *interiors);
+
 /**
  Creates a BLOB-Geometry corresponding to a Geometry object
 
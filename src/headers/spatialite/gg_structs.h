@@ -271,6 +271,62 @@ extern "C"
  */
     typedef gaiaGeomColl *gaiaGeomCollPtr;
 
+/**
+ Read-only view over a SpatiaLite BLOB-Geometry
+
+ \sa gaiaBlobViewInit
+ */
+    typedef struct gaiaBlobViewStruct
+    {
+/* a read-only SpatiaLite BLOB-Geometry view */
+/** BLOB-Geometry buffer */
+	const unsigned char *blob;	/* the BLOB buffer (not owned) */
+/** BLOB-Geometry buffer size (in bytes) */
+	unsigned int size;	/* buffer size */
+/** BLOB-Geometry endian arch */
+	int little_endian;	/* littleEndian - bigEndian */
+/** CPU endian arch */
+	int endian_arch;	/* littleEndian - bigEndian arch for target CPU */
+/** the SRID */
+	int Srid;		/* the SRID value */
+/** one of GAIA_XY, GAIA_XY_Z, GAIA_XY_M, GAIA_XY_ZM */
+	int DimensionModel;	/* (x,y), (x,y,z), (x,y,m) or (x,y,z,m) */
+/** the Geometry Class declared by the BLOB */
+	int DeclaredType;	/* the declared TYPE */
+/** MBR: min X */
+	double MinX;		/* MBR - BBOX */
+/** MBR: min Y */
+	double MinY;		/* MBR - BBOX */
+/** MBR: max X */
+	double MaxX;		/* MBR - BBOX */
+/** MBR: max Y */
+	double MaxY;		/* MBR - BBOX */
+/** number of POINT items */
+	int NumPoints;		/* how many POINTs */
+/** number of LINESTRING items */
+	int NumLinestrings;	/* how many LINESTRINGs */
+/** number of POLYGON items */
+	int NumPolygons;	/* how many POLYGONs */
+/** total number of RINGs (both exterior and interior) */
+	int NumRings;		/* how many RINGs */
+/** total number of vertices */
+	int NumVertices;	/* how many vertices */
+/** number of elementary items [internal] */
+	int items;		/* elementary items count */
+/** TRUE for MULTIxx and GEOMETRYCOLLECTION [internal] */
+	int collection;		/* items are preceded by an entity header */
+/** type of the only elementary item [internal] */
+	int item_type;		/* not a collection: the item type */
+/** offset of the first elementary item [internal] */
+	unsigned int first_item;	/* first item offset */
+    } gaiaBlobView;
+/**
+ Typedef for BLOB-Geometry view structure
+
+ \sa gaiaBlobView
+ */
+    typedef gaiaBlobView *gaiaBlobViewPtr;
+
 /**
  Container similar to LINESTRING [internally used]
  */
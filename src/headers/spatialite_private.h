@@ -114,11 +114,19 @@ extern "C"
     {
 	unsigned char gaiaBlob[64];
 	int gaiaBlobSize;
-	uLong crc32;
+	sqlite3_uint64 hash;
+	sqlite3_int64 lastUsed;
 	void *geosGeom;
 	void *preparedGeosGeom;
     };
 
+    struct splite_geos_cache_seen
+    {
+	/* a BLOB seen once, not yet promoted into the GEOS cache */
+	sqlite3_uint64 hash;
+	int gaiaBlobSize;
+    };
+
     struct splite_xmlSchema_cache_item
     {
 	time_t timestamp;
@@ -147,6 +155,38 @@ extern "C"
 	struct splite_vtable_extent *next;
     };
 
+    struct splite_deferred_rtree_item
+    {
+	/* an R*Tree entry queued by RTreeAlign() in deferred mode */
+	sqlite3_int64 pkid;
+	double minx;
+	double miny;
+	double maxx;
+	double maxy;
+	int seq;		/* queuing order */
+    };
+
+    struct splite_deferred_rtree
+    {
+	/* all the pending entries of the same R*Tree */
+	char *rtree_name;
+	struct splite_deferred_rtree_item *items;
+	int count;
+	int allocated;
+	struct splite_deferred_rtree *next;
+    };
+
+    struct splite_shp_mapping
+    {
+	/* a Shapefile memory mapped for zero-copy reading */
+	const unsigned char *shp;	/* the .shp file */
+	size_t shp_size;
+	const unsigned char *shx;	/* the .shx file */
+	size_t shx_size;
+	const unsigned char *dbf;	/* the .dbf file */
+	size_t dbf_size;
+    };
+
     struct gaia_variant_value
     {
 	/* a struct/union intended to store a SQLite Variant Value */
@@ -160,6 +200,18 @@ extern "C"
 
 #define MAX_XMLSCHEMA_CACHE	16
 
+/*
+/ the default GEOS cache should hold the whole working set of a typical
+/ point-in-polygon Join (some tens of Polygons); a lookup is a plain
+/ scan comparing sizes and hashes, so it stays cheap at this size
+*/
+#define GEOS_CACHE_DEFAULT_SIZE	64
+#define GEOS_CACHE_MAX_SIZE	1024
+#define GEOS_CACHE_SEEN_SIZE	256
+
+#define UNION_DEFAULT_BATCH_SIZE	64
+#define UNION_MAX_BATCH_SIZE	65536
+
     struct splite_internal_cache
     {
 	unsigned char magic1;
@@ -175,8 +227,14 @@ extern "C"
 	char *cutterMessage;
 	char *storedProcError;
 	char *createRoutingError;
-	struct splite_geos_cache_item cacheItem1;
-	struct splite_geos_cache_item cacheItem2;
+	char *parallelJoinError;
+	char *knnJoinError;
+	struct splite_geos_cache_item *geosCache;
+	int geosCacheSize;
+	sqlite3_int64 geosCacheTick;
+	sqlite3_int64 geosCacheHits;
+	sqlite3_int64 geosCacheMisses;
+	struct splite_geos_cache_seen geosCacheSeen[GEOS_CACHE_SEEN_SIZE];
 	struct splite_xmlSchema_cache_item xmlSchemaCache[MAX_XMLSCHEMA_CACHE];
 	int pool_index;
 	void (*geos_warning) (const char *fmt, ...);
@@ -216,12 +274,18 @@ extern "C"
 	int buffer_join_style;
 	double buffer_mitre_limit;
 	int buffer_quadrant_segments;
+	int union_batch_size;
+	int union_spatial_sort;
 	int proj6_cached;
 	void *proj6_cached_pj;
 	char *proj6_cached_string_1;
 	char *proj6_cached_string_2;
 	void *proj6_cached_area;
 	int is_pause_enabled;
+	int deferred_rtree_enabled;
+	int deferred_rtree_lost;
+	struct splite_deferred_rtree *first_deferred_rtree;
+	struct splite_deferred_rtree *last_deferred_rtree;
     };
 
     struct epsg_defs
@@ -406,6 +470,35 @@ extern "C"
 						const unsigned char *table,
 						const char *column);
 
+    SPATIALITE_PRIVATE int truncateSpatialIndex (void *p_sqlite,
+						 const char *table,
+						 const char *column);
+
+    SPATIALITE_PRIVATE int flushDeferredSpatialIndex (void *p_sqlite,
+						      const void *cache);
+
+    SPATIALITE_PRIVATE int splite_map_shapefile (void *p_shp,
+						 struct splite_shp_mapping
+						 *mapping);
+
+    SPATIALITE_PRIVATE void splite_unmap_shapefile (struct splite_shp_mapping
+						    *mapping);
+
+    SPATIALITE_PRIVATE void splite_check_mapped_shapefile (void *p_shp,
+							   struct
+							   splite_shp_mapping
+							   *mapping);
+
+    SPATIALITE_PRIVATE int splite_read_mapped_shp_entity (void *p_shp,
+							  struct
+							  splite_shp_mapping
+							  *mapping,
+							  int current_row,
+							  int srid,
+							  int text_dates,
+							  unsigned char **blob,
+							  int *blob_size);
+
     SPATIALITE_PRIVATE int validateRowid (void *p_sqlite, const char *table);
 
     SPATIALITE_PRIVATE int doComputeFieldInfos (void *p_sqlite,
@@ -939,6 +1032,11 @@ extern "C"
 							   splite_geos_cache_item
 							   *p);
 
+    SPATIALITE_PRIVATE int splite_set_geos_cache_size (const void *p_cache,
+						       int size);
+
+    SPATIALITE_PRIVATE void splite_reset_geos_cache (const void *p_cache);
+
     SPATIALITE_PRIVATE void splite_free_xml_schema_cache_item (struct
 							       splite_xmlSchema_cache_item
 							       *p);
@@ -1006,6 +1104,36 @@ extern "C"
 						  int blob_sz, double *E,
 						  double *N, double *Z);
 
+    SPATIALITE_PRIVATE void *gaiaFastParseWkt (const unsigned char *buffer,
+					       int ewkt);
+
+    SPATIALITE_PRIVATE void *gaiaAllocArenaGeomColl (int size_hint,
+						     void **arena);
+
+    SPATIALITE_PRIVATE void gaiaFreeArenaGeomColl (void *geom);
+
+    SPATIALITE_PRIVATE void *gaiaFromSpatiaLiteBlobWkbArena (const unsigned
+							     char *blob,
+							     unsigned int
+							     size,
+							     int gpkg_mode,
+							     int
+							     gpkg_amphibious);
+
+    SPATIALITE_PRIVATE void gaiaArenaAddPoint (void *arena, void *geom,
+					       double x, double y, double z,
+					       double m, int dimension_model);
+
+    SPATIALITE_PRIVATE void *gaiaArenaAddLinestring (void *arena, void *geom,
+						     int vert);
+
+    SPATIALITE_PRIVATE void *gaiaArenaAddPolygon (void *arena, void *geom,
+						  int vert, int interiors);
+
+    SPATIALITE_PRIVATE void *gaiaArenaAddInteriorRing (void *arena,
+						       void *polyg, int pos,
+						       int vert);
+
 /* Topology SQL functions */
     SPATIALITE_PRIVATE void *fromRTGeom (const void *ctx, const void *rtgeom,
 					 const int dimension_model,
@@ -1297,6 +1425,18 @@ extern "C"
 					      double *maxy, int *srid,
 					      const void *cache);
 
+    SPATIALITE_PRIVATE int add_deferred_rtree_item (const char *rtree_name,
+						    sqlite3_int64 pkid,
+						    double minx, double miny,
+						    double maxx, double maxy,
+						    const void *cache);
+
+    SPATIALITE_PRIVATE void reset_deferred_rtrees (const void *cache);
+
+    SPATIALITE_PRIVATE int count_deferred_rtree_items (const char
+						       *rtree_name,
+						       const void *cache);
+
 /* Topology-Network SQL functions */
     SPATIALITE_PRIVATE void fnctaux_GetLastNetworkException (const void
 							     *context,
@@ -84,6 +84,11 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #define strncasecmp	_strnicmp
 #endif
 
+#ifndef _WIN32
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
 /* 64 bit integer: portable format for printf() */
 #if defined(_WIN32) && !defined(__MINGW32__)
 #define FRMT64 "%I64d"
@@ -572,12 +577,534 @@ load_shapefile_ex2 (sqlite3 * sqlite, char *shp_path, char *table,
 			       GAIA_DBF_COLNAME_LOWERCASE, err_msg);
 }
 
+#ifndef _WIN32			/* POSIX threads: supporting pipelined import */
+
+#define SHP_IMPORT_MAX_THREADS		64
+#define SHP_IMPORT_SLOTS_PER_THREAD	256
+
+#define SHP_ROW_EMPTY	0
+#define SHP_ROW_READY	1
+#define SHP_ROW_DELETED	2
+#define SHP_ROW_EOF	3
+#define SHP_ROW_ERROR	4
+
+struct shp_import_value
+{
+/* a DBF value copied by some worker thread */
+    int type;
+    sqlite3_int64 int_value;
+    double dbl_value;
+    char *txt_value;
+};
+
+struct shp_import_row
+{
+/* a Shapefile entity already decoded by some worker thread */
+    int row;
+    int state;
+    struct shp_import_value *values;
+    unsigned char *blob;
+    int blob_size;
+    char *error;
+};
+
+struct shp_import_pipeline
+{
+/* 
+/ the pipelined Shapefile import:
+/ - N worker threads each one reading/decoding the entities 
+/   (row % N), converting the DBF charset and encoding the BLOB
+/   Geometries
+/ - a single writer (the calling thread) consuming all rows
+/   in their original order and INSERTing them into the DB
+/ the bounded ring of slots is shared by all threads
+*/
+    pthread_mutex_t mutex;
+    pthread_cond_t ready;
+    pthread_cond_t consumed;
+    int writer_waiting;
+    int workers_waiting;
+    struct shp_import_row *slots;
+    int n_slots;
+    int n_fields;
+    int n_threads;
+    int next_row;
+    int abort;
+    const char *shp_path;
+    const char *charset;
+    int srid;
+    int text_dates;
+    int compressed;
+    int effective_type;
+    int effective_dims;
+};
+
+struct shp_import_worker
+{
+/* a worker thread */
+    struct shp_import_pipeline *pipeline;
+    int index;
+    pthread_t thread;
+    int started;
+};
+
+static void
+shp_import_release_row (struct shp_import_pipeline *pipeline,
+			struct shp_import_row *slot)
+{
+/* releasing a consumed slot */
+    int i;
+    for (i = 0; i < pipeline->n_fields; i++)
+      {
+	  struct shp_import_value *value = slot->values + i;
+	  if (value->txt_value != NULL)
+	      free (value->txt_value);
+	  value->txt_value = NULL;
+      }
+    if (slot->blob != NULL)
+	free (slot->blob);
+    slot->blob = NULL;
+    if (slot->error != NULL)
+	free (slot->error);
+    slot->error = NULL;
+    pthread_mutex_lock (&(pipeline->mutex));
+    slot->state = SHP_ROW_EMPTY;
+    pipeline->next_row += 1;
+    if (pipeline->workers_waiting
+	&& (pipeline->next_row % SHP_IMPORT_SLOTS_PER_THREAD) == 0)
+      {
+	  /* waking the workers only from time to time */
+	  pthread_cond_broadcast (&(pipeline->consumed));
+      }
+    pthread_mutex_unlock (&(pipeline->mutex));
+}
+
+static void
+shp_import_copy_row (struct shp_import_pipeline *pipeline,
+		     gaiaShapefilePtr shp, struct shp_import_row *slot)
+{
+/* copying the current entity into a slot */
+    int i = 0;
+    gaiaDbfFieldPtr dbf_field = shp->Dbf->First;
+    while (dbf_field && i < pipeline->n_fields)
+      {
+	  struct shp_import_value *value = slot->values + i;
+	  value->type = GAIA_NULL_VALUE;
+	  if (dbf_field->Value)
+	    {
+		value->type = dbf_field->Value->Type;
+		value->int_value = dbf_field->Value->IntValue;
+		value->dbl_value = dbf_field->Value->DblValue;
+		if (dbf_field->Value->TxtValue != NULL)
+		  {
+		      value->txt_value =
+			  malloc (strlen (dbf_field->Value->TxtValue) + 1);
+		      strcpy (value->txt_value, dbf_field->Value->TxtValue);
+		  }
+	    }
+	  i++;
+	  dbf_field = dbf_field->Next;
+      }
+    if (shp->Dbf->Geometry)
+      {
+	  if (pipeline->compressed)
+	      gaiaToCompressedBlobWkb (shp->Dbf->Geometry, &(slot->blob),
+				       &(slot->blob_size));
+	  else
+	      gaiaToSpatiaLiteBlobWkb (shp->Dbf->Geometry, &(slot->blob),
+				       &(slot->blob_size));
+      }
+}
+
+static void *
+shp_import_worker_thread (void *arg)
+{
+/* a worker thread: reading and decoding Shapefile entities */
+    struct shp_import_worker *worker = (struct shp_import_worker *) arg;
+    struct shp_import_pipeline *pipeline = worker->pipeline;
+    struct shp_import_row *slot;
+    int row = worker->index;
+    int state;
+    int ret;
+    char *error = NULL;
+    gaiaShapefilePtr shp = gaiaAllocShapefile ();
+    gaiaOpenShpRead (shp, pipeline->shp_path, pipeline->charset, "UTF-8");
+    shp->EffectiveType = pipeline->effective_type;
+    shp->EffectiveDims = pipeline->effective_dims;
+    while (1)
+      {
+	  /* waiting for a free slot */
+	  slot = pipeline->slots + (row % pipeline->n_slots);
+	  pthread_mutex_lock (&(pipeline->mutex));
+	  while (!pipeline->abort
+		 && row - pipeline->next_row >= pipeline->n_slots)
+	    {
+		pipeline->workers_waiting += 1;
+		pthread_cond_wait (&(pipeline->consumed), &(pipeline->mutex));
+		pipeline->workers_waiting -= 1;
+	    }
+	  ret = pipeline->abort;
+	  pthread_mutex_unlock (&(pipeline->mutex));
+	  if (ret)
+	      break;
+
+	  if (!(shp->Valid))
+	    {
+		error =
+		    sqlite3_mprintf
+		    ("load shapefile error: cannot open shapefile '%s'",
+		     pipeline->shp_path);
+		ret = 0;
+	    }
+	  else
+	      ret =
+		  gaiaReadShpEntity_ex (shp, row, pipeline->srid,
+					pipeline->text_dates);
+	  if (ret < 0)
+	      state = SHP_ROW_DELETED;
+	  else if (!ret)
+	    {
+		if (error == NULL && shp->LastError)
+		    error = sqlite3_mprintf ("%s", shp->LastError);
+		state = (error == NULL) ? SHP_ROW_EOF : SHP_ROW_ERROR;
+	    }
+	  else
+	    {
+		shp_import_copy_row (pipeline, shp, slot);
+		state = SHP_ROW_READY;
+	    }
+	  if (error != NULL)
+	    {
+		slot->error = malloc (strlen (error) + 1);
+		strcpy (slot->error, error);
+		sqlite3_free (error);
+	    }
+
+	  /* handing the slot to the writer */
+	  pthread_mutex_lock (&(pipeline->mutex));
+	  slot->row = row;
+	  slot->state = state;
+	  if (pipeline->writer_waiting)
+	      pthread_cond_signal (&(pipeline->ready));
+	  pthread_mutex_unlock (&(pipeline->mutex));
+	  if (state == SHP_ROW_EOF || state == SHP_ROW_ERROR)
+	      break;
+	  row += pipeline->n_threads;
+      }
+    gaiaFreeShapefile (shp);
+    return NULL;
+}
+
+static struct shp_import_pipeline *
+shp_import_start (gaiaShapefilePtr shp, int n_threads, const char *shp_path,
+		  const char *charset, int srid, int text_dates,
+		  int compressed, struct shp_import_worker **p_workers)
+{
+/* creating the pipeline and starting all worker threads */
+    struct shp_import_pipeline *pipeline;
+    struct shp_import_worker *workers;
+    gaiaDbfFieldPtr dbf_field;
+    int i;
+
+    if (n_threads > SHP_IMPORT_MAX_THREADS)
+	n_threads = SHP_IMPORT_MAX_THREADS;
+    pipeline = malloc (sizeof (struct shp_import_pipeline));
+    if (pipeline == NULL)
+	return NULL;
+    pipeline->n_fields = 0;
+    dbf_field = shp->Dbf->First;
+    while (dbf_field)
+      {
+	  pipeline->n_fields++;
+	  dbf_field = dbf_field->Next;
+      }
+    pipeline->n_threads = n_threads;
+    pipeline->n_slots = n_threads * SHP_IMPORT_SLOTS_PER_THREAD;
+    pipeline->slots =
+	malloc (sizeof (struct shp_import_row) * pipeline->n_slots);
+    for (i = 0; i < pipeline->n_slots; i++)
+      {
+	  struct shp_import_row *slot = pipeline->slots + i;
+	  slot->row = -1;
+	  slot->state = SHP_ROW_EMPTY;
+	  slot->blob = NULL;
+	  slot->blob_size = 0;
+	  slot->error = NULL;
+	  slot->values =
+	      calloc (pipeline->n_fields + 1,
+		      sizeof (struct shp_import_value));
+      }
+    pipeline->next_row = 0;
+    pipeline->abort = 0;
+    pipeline->writer_waiting = 0;
+    pipeline->workers_waiting = 0;
+    pipeline->shp_path = shp_path;
+    pipeline->charset = charset;
+    pipeline->srid = srid;
+    pipeline->text_dates = text_dates;
+    pipeline->compressed = compressed;
+    pipeline->effective_type = shp->EffectiveType;
+    pipeline->effective_dims = shp->EffectiveDims;
+    pthread_mutex_init (&(pipeline->mutex), NULL);
+    pthread_cond_init (&(pipeline->ready), NULL);
+    pthread_cond_init (&(pipeline->consumed), NULL);
+
+    workers = malloc (sizeof (struct shp_import_worker) * n_threads);
+    for (i = 0; i < n_threads; i++)
+      {
+	  struct shp_import_worker *worker = workers + i;
+	  worker->pipeline = pipeline;
+	  worker->index = i;
+	  worker->started =
+	      (pthread_create
+	       (&(worker->thread), NULL, shp_import_worker_thread,
+		worker) == 0);
+	  if (!worker->started)
+	    {
+		/* 
+		   / unable to start all threads: the missing rows 
+		   / would never be produced, so we'll give up
+		 */
+		pthread_mutex_lock (&(pipeline->mutex));
+		pipeline->abort = 1;
+		pthread_cond_broadcast (&(pipeline->consumed));
+		pthread_mutex_unlock (&(pipeline->mutex));
+	    }
+      }
+    *p_workers = workers;
+    return pipeline;
+}
+
+static void
+shp_import_stop (struct shp_import_pipeline *pipeline,
+		 struct shp_import_worker *workers)
+{
+/* stopping all worker threads and destroying the pipeline */
+    int i;
+    pthread_mutex_lock (&(pipeline->mutex));
+    pipeline->abort = 1;
+    pthread_cond_broadcast (&(pipeline->consumed));
+    pthread_mutex_unlock (&(pipeline->mutex));
+    for (i = 0; i < pipeline->n_threads; i++)
+      {
+	  if (workers[i].started)
+	      pthread_join (workers[i].thread, NULL);
+      }
+    for (i = 0; i < pipeline->n_slots; i++)
+      {
+	  struct shp_import_row *slot = pipeline->slots + i;
+	  shp_import_release_row (pipeline, slot);
+	  free (slot->values);
+      }
+    pthread_cond_destroy (&(pipeline->ready));
+    pthread_cond_destroy (&(pipeline->consumed));
+    pthread_mutex_destroy (&(pipeline->mutex));
+    free (pipeline->slots);
+    free (pipeline);
+    free (workers);
+}
+
+static struct shp_import_row *
+shp_import_next_row (struct shp_import_pipeline *pipeline, int row)
+{
+/* waiting until the next row (in the original order) will be available */
+    struct shp_import_row *slot =
+	pipeline->slots + (row % pipeline->n_slots);
+    pthread_mutex_lock (&(pipeline->mutex));
+    while (!pipeline->abort
+	   && (slot->state == SHP_ROW_EMPTY || slot->row != row))
+      {
+	  if (pipeline->workers_waiting)
+	      pthread_cond_broadcast (&(pipeline->consumed));
+	  pipeline->writer_waiting = 1;
+	  pthread_cond_wait (&(pipeline->ready), &(pipeline->mutex));
+	  pipeline->writer_waiting = 0;
+      }
+    if (slot->state == SHP_ROW_EMPTY || slot->row != row)
+	slot = NULL;
+    pthread_mutex_unlock (&(pipeline->mutex));
+    return slot;
+}
+
+static int
+shp_import_pipelined (sqlite3 * sqlite, sqlite3_stmt * stmt,
+		      gaiaShapefilePtr shp, int n_threads,
+		      const char *shp_path, const char *charset, int srid,
+		      int text_dates, int compressed, const char *pk_name,
+		      int pk_type, int *p_rows, int *p_deleted, char *err_msg)
+{
+/* 
+/ inserting all rows from the Shapefile, the decoding being
+/ delegated to several worker threads
+/
+/ returns 1 on success, 0 on failure
+*/
+    struct shp_import_pipeline *pipeline;
+    struct shp_import_worker *workers = NULL;
+    struct shp_import_row *slot;
+    gaiaDbfFieldPtr dbf_field;
+    int pk_index = -1;
+    int current_row = 0;
+    int deleted = 0;
+    int result = 1;
+    int cnt;
+    int i;
+    int ret;
+
+    i = 0;
+    dbf_field = shp->Dbf->First;
+    while (dbf_field)
+      {
+	  if (strcasecmp (pk_name, dbf_field->Name) == 0)
+	      pk_index = i;
+	  i++;
+	  dbf_field = dbf_field->Next;
+      }
+    pipeline =
+	shp_import_start (shp, n_threads, shp_path, charset, srid, text_dates,
+			  compressed, &workers);
+    if (pipeline == NULL)
+	return 0;
+    while (1)
+      {
+	  slot = shp_import_next_row (pipeline, current_row);
+	  if (slot == NULL)
+	    {
+		/* some worker thread failed to start */
+		if (!err_msg)
+		    spatialite_e
+			("load shapefile error: unable to start a thread\n");
+		else
+		    sprintf (err_msg,
+			     "load shapefile error: unable to start a thread\n");
+		result = 0;
+		break;
+	    }
+	  if (slot->state == SHP_ROW_EOF)
+	      break;
+	  if (slot->state == SHP_ROW_ERROR)
+	    {
+		if (!err_msg)
+		    spatialite_e ("%s\n", slot->error);
+		else
+		    sprintf (err_msg, "%s\n", slot->error);
+		result = 0;
+		break;
+	    }
+	  if (slot->state == SHP_ROW_DELETED)
+	    {
+		/* found a DBF deleted record */
+		current_row++;
+		deleted++;
+		shp_import_release_row (pipeline, slot);
+		continue;
+	    }
+	  current_row++;
+	  /* binding query params */
+	  sqlite3_reset (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  if (pk_index >= 0
+	      && slot->values[pk_index].type != GAIA_NULL_VALUE)
+	    {
+		/* Primary Key value */
+		struct shp_import_value *value = slot->values + pk_index;
+		if (pk_type == SQLITE_TEXT)
+		  {
+		      if (value->txt_value == NULL)
+			  sqlite3_bind_null (stmt, 1);
+		      else
+			  sqlite3_bind_text (stmt, 1, value->txt_value,
+					     strlen (value->txt_value),
+					     SQLITE_STATIC);
+		  }
+		else if (pk_type == SQLITE_FLOAT)
+		    sqlite3_bind_double (stmt, 1, value->dbl_value);
+		else
+		    sqlite3_bind_int64 (stmt, 1, value->int_value);
+	    }
+	  else
+	      sqlite3_bind_int (stmt, 1, current_row);
+	  cnt = 0;
+	  for (i = 0; i < pipeline->n_fields; i++)
+	    {
+		/* column values */
+		struct shp_import_value *value = slot->values + i;
+		if (i == pk_index)
+		    continue;	/* skipping the Primary Key field */
+		switch (value->type)
+		  {
+		  case GAIA_INT_VALUE:
+		      sqlite3_bind_int64 (stmt, cnt + 2, value->int_value);
+		      break;
+		  case GAIA_DOUBLE_VALUE:
+		      sqlite3_bind_double (stmt, cnt + 2, value->dbl_value);
+		      break;
+		  case GAIA_TEXT_VALUE:
+		      if (value->txt_value == NULL)
+			  sqlite3_bind_null (stmt, cnt + 2);
+		      else
+			  sqlite3_bind_text (stmt, cnt + 2, value->txt_value,
+					     strlen (value->txt_value),
+					     SQLITE_STATIC);
+		      break;
+		  default:
+		      sqlite3_bind_null (stmt, cnt + 2);
+		      break;
+		  };
+		cnt++;
+	    }
+	  if (slot->blob != NULL)
+	      sqlite3_bind_blob (stmt, cnt + 2, slot->blob, slot->blob_size,
+				 SQLITE_STATIC);
+	  else
+	    {
+		/* handling a NULL-Geometry */
+		sqlite3_bind_null (stmt, cnt + 2);
+	    }
+	  ret = sqlite3_step (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  shp_import_release_row (pipeline, slot);
+	  if (ret == SQLITE_DONE || ret == SQLITE_ROW)
+	      ;
+	  else
+	    {
+		if (!err_msg)
+		    spatialite_e ("load shapefile error: <%s>\n",
+				  sqlite3_errmsg (sqlite));
+		else
+		    sprintf (err_msg, "load shapefile error: <%s>\n",
+			     sqlite3_errmsg (sqlite));
+		result = 0;
+		break;
+	    }
+      }
+    shp_import_stop (pipeline, workers);
+    *p_rows = current_row;
+    *p_deleted = deleted;
+    return result;
+}
+
+#endif /* end POSIX threads */
+
 SPATIALITE_DECLARE int
 load_shapefile_ex3 (sqlite3 * sqlite, char *shp_path, char *table,
 		    char *charset, int srid, char *g_column, char *gtype,
 		    char *pk_column, int coerce2d, int compressed,
 		    int verbose, int spatial_index, int text_dates, int *rows,
 		    int colname_case, char *err_msg)
+{
+    return load_shapefile_ex4 (sqlite, shp_path, table, charset, srid, g_column,
+			       gtype, pk_column, coerce2d, compressed, verbose,
+			       spatial_index, text_dates, rows, colname_case, 1,
+			       err_msg);
+}
+
+SPATIALITE_DECLARE int
+load_shapefile_ex4 (sqlite3 * sqlite, char *shp_path, char *table,
+		    char *charset, int srid, char *g_column, char *gtype,
+		    char *pk_column, int coerce2d, int compressed,
+		    int verbose, int spatial_index, int text_dates, int *rows,
+		    int colname_case, int threads, char *err_msg)
 {
     sqlite3_stmt *stmt = NULL;
     int ret;
@@ -1356,6 +1883,26 @@ load_shapefile_ex3 (sqlite3 * sqlite, char *shp_path, char *table,
 	  sqlError = 1;
 	  goto clean_up;
       }
+#ifndef _WIN32
+    if (threads > 1)
+      {
+	  /* never using more worker threads than available processors */
+	  long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+	  if (cpus > 0 && threads > cpus)
+	      threads = (int) cpus;
+      }
+    if (threads > 1)
+      {
+	  /* pipelined import: decoding the rows on several threads */
+	  if (!shp_import_pipelined
+	      (sqlite, stmt, shp, threads, shp_path, charset, srid,
+	       text_dates, compressed, pk_name, pk_type, &current_row,
+	       &deleted, err_msg))
+	      sqlError = 1;
+	  sqlite3_finalize (stmt);
+	  goto clean_up;
+      }
+#endif
     current_row = 0;
     while (1)
       {
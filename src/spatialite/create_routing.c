@@ -74,6 +74,8 @@ the terms of any one of the MPL, the GPL or the LGPL.
 
 #define MAX_BLOCK	1048576
 
+#define CH_WITNESS_MAX_SETTLED	500
+
 static void
 gaia_create_routing_set_error (const void *ctx, const char *errmsg)
 {
@@ -2050,13 +2052,609 @@ output_node (unsigned char *auxbuf, int *size, int index, int has_ids,
     return 1;
 }
 
+/*
+/
+/  Contraction Hierarchies preprocessing
+/
+////////////////////////////////////////////////////////////
+/
+/ all Nodes are contracted one at time following a lazily
+/ updated priority (edge difference plus already contracted
+/ neighbours); a shortcut is added whenever a bounded local
+/ (witness) search fails to find an alternative path at least
+/ as cheap as the one passing through the contracted Node.
+/ the rank of each Node and all upward edges (both original
+/ Links and shortcuts) are then stored into the Routing Data
+/ table as GAIA_NET_CH_BLOCKs following the ordinary blocks
+/
+*/
+
+struct ch_edge
+{
+/* an edge of the Contraction Hierarchy */
+    int node;			/* the other Node */
+    int middle;			/* the contracted Node; -1 for an original Link */
+    sqlite3_int64 rowid;	/* the original Link ROWID */
+    double cost;
+};
+
+struct ch_edge_list
+{
+/* a dynamic list of edges */
+    struct ch_edge *edges;
+    int count;
+    int max;
+};
+
+struct ch_node
+{
+/* a Node of the Contraction Hierarchy */
+    struct ch_edge_list out;	/* outcoming edges */
+    struct ch_edge_list in;	/* incoming edges */
+    int rank;			/* contraction order; -1 while not yet contracted */
+    int deleted_neighbours;
+    unsigned int stamp;		/* witness search: visited marker */
+    double dist;		/* witness search: tentative cost */
+    int settled;		/* witness search: settled marker */
+};
+
+struct ch_heap_item
+{
+    double key;
+    int node;
+};
+
+struct ch_heap
+{
+/* a min-priority queue supporting lazy deletion */
+    struct ch_heap_item *items;
+    int count;
+    int max;
+};
+
+struct ch_graph
+{
+/* the Contraction Hierarchy being built */
+    int n_nodes;
+    struct ch_node *nodes;
+    struct ch_heap witness;
+    unsigned int stamp;
+};
+
+static int
+ch_heap_push (struct ch_heap *heap, double key, int node)
+{
+/* inserting an item into the heap */
+    int i;
+    if (heap->count == heap->max)
+      {
+	  int max = (heap->max == 0) ? 1024 : heap->max * 2;
+	  struct ch_heap_item *items =
+	      realloc (heap->items, sizeof (struct ch_heap_item) * max);
+	  if (items == NULL)
+	      return 0;
+	  heap->items = items;
+	  heap->max = max;
+      }
+    i = heap->count++;
+    while (i > 0)
+      {
+	  int parent = (i - 1) / 2;
+	  if (heap->items[parent].key <= key)
+	      break;
+	  heap->items[i] = heap->items[parent];
+	  i = parent;
+      }
+    heap->items[i].key = key;
+    heap->items[i].node = node;
+    return 1;
+}
+
+static struct ch_heap_item
+ch_heap_pop (struct ch_heap *heap)
+{
+/* removing the min-priority item from the heap */
+    struct ch_heap_item top = heap->items[0];
+    struct ch_heap_item last = heap->items[--heap->count];
+    int i = 0;
+    while (1)
+      {
+	  int c = (i * 2) + 1;
+	  if (c >= heap->count)
+	      break;
+	  if (c + 1 < heap->count
+	      && heap->items[c + 1].key < heap->items[c].key)
+	      c++;
+	  if (last.key <= heap->items[c].key)
+	      break;
+	  heap->items[i] = heap->items[c];
+	  i = c;
+      }
+    if (heap->count > 0)
+	heap->items[i] = last;
+    return top;
+}
+
+static int
+ch_add_edge (struct ch_edge_list *list, int node, int middle,
+	     sqlite3_int64 rowid, double cost)
+{
+/* appending an edge to some list */
+    struct ch_edge *edge;
+    if (list->count == list->max)
+      {
+	  int max = (list->max == 0) ? 4 : list->max * 2;
+	  struct ch_edge *edges =
+	      realloc (list->edges, sizeof (struct ch_edge) * max);
+	  if (edges == NULL)
+	      return 0;
+	  list->edges = edges;
+	  list->max = max;
+      }
+    edge = list->edges + list->count++;
+    edge->node = node;
+    edge->middle = middle;
+    edge->rowid = rowid;
+    edge->cost = cost;
+    return 1;
+}
+
+static int
+ch_add_arc (struct ch_graph *graph, int from, int to, int middle,
+	    sqlite3_int64 rowid, double cost)
+{
+/* inserting an arc (original Link or shortcut) into the graph */
+    if (!ch_add_edge (&(graph->nodes[from].out), to, middle, rowid, cost))
+	return 0;
+    return ch_add_edge (&(graph->nodes[to].in), from, middle, rowid, cost);
+}
+
+static void
+ch_free_graph (struct ch_graph *graph)
+{
+/* memory cleanup - destroying the Contraction Hierarchy */
+    int i;
+    if (graph->nodes != NULL)
+      {
+	  for (i = 0; i < graph->n_nodes; i++)
+	    {
+		struct ch_node *node = graph->nodes + i;
+		if (node->out.edges != NULL)
+		    free (node->out.edges);
+		if (node->in.edges != NULL)
+		    free (node->in.edges);
+	    }
+	  free (graph->nodes);
+      }
+    if (graph->witness.items != NULL)
+	free (graph->witness.items);
+}
+
+static int
+ch_witness_search (struct ch_graph *graph, int source, int excluded,
+		   double max_cost)
+{
+/*
+/ bounded Dijkstra search from Source not passing through the
+/ Node being contracted; visited Nodes are marked by the current
+/ stamp, so that no global reset is ever required
+*/
+    struct ch_heap *heap = &(graph->witness);
+    struct ch_node *node;
+    int settled = 0;
+    int i;
+
+    graph->stamp++;
+    if (graph->stamp == 0)
+      {
+	  /* stamp wrap-around */
+	  for (i = 0; i < graph->n_nodes; i++)
+	      graph->nodes[i].stamp = 0;
+	  graph->stamp = 1;
+      }
+    heap->count = 0;
+    node = graph->nodes + source;
+    node->stamp = graph->stamp;
+    node->dist = 0.0;
+    node->settled = 0;
+    if (!ch_heap_push (heap, 0.0, source))
+	return 0;
+    while (heap->count > 0)
+      {
+	  struct ch_heap_item item = ch_heap_pop (heap);
+	  node = graph->nodes + item.node;
+	  if (node->settled || item.key > node->dist)
+	      continue;
+	  if (item.key > max_cost)
+	      break;
+	  node->settled = 1;
+	  if (++settled > CH_WITNESS_MAX_SETTLED)
+	      break;
+	  for (i = 0; i < node->out.count; i++)
+	    {
+		struct ch_edge *edge = node->out.edges + i;
+		struct ch_node *next = graph->nodes + edge->node;
+		double dist = item.key + edge->cost;
+		if (edge->node == excluded || next->rank >= 0)
+		    continue;
+		if (dist > max_cost)
+		    continue;
+		if (next->stamp != graph->stamp)
+		  {
+		      next->stamp = graph->stamp;
+		      next->settled = 0;
+		  }
+		else if (dist >= next->dist)
+		    continue;
+		next->dist = dist;
+		if (!ch_heap_push (heap, dist, edge->node))
+		    return 0;
+	    }
+      }
+    return 1;
+}
+
+static int
+ch_contract_node (struct ch_graph *graph, int index, int simulate,
+		  int *shortcuts)
+{
+/*
+/ contracting a Node (or simply counting the required shortcuts
+/ when in simulation mode)
+*/
+    struct ch_node *node = graph->nodes + index;
+    int i;
+    int j;
+
+    *shortcuts = 0;
+    for (i = 0; i < node->in.count; i++)
+      {
+	  struct ch_edge *in = node->in.edges + i;
+	  double max_cost = -1.0;
+	  if (in->node == index || graph->nodes[in->node].rank >= 0)
+	      continue;
+	  for (j = 0; j < node->out.count; j++)
+	    {
+		struct ch_edge *out = node->out.edges + j;
+		if (out->node == index || out->node == in->node
+		    || graph->nodes[out->node].rank >= 0)
+		    continue;
+		if (in->cost + out->cost > max_cost)
+		    max_cost = in->cost + out->cost;
+	    }
+	  if (max_cost < 0.0)
+	      continue;
+	  if (!ch_witness_search (graph, in->node, index, max_cost))
+	      return 0;
+	  for (j = 0; j < node->out.count; j++)
+	    {
+		struct ch_edge *out = node->out.edges + j;
+		struct ch_node *to = graph->nodes + out->node;
+		double cost = in->cost + out->cost;
+		if (out->node == index || out->node == in->node
+		    || to->rank >= 0)
+		    continue;
+		if (to->stamp == graph->stamp && to->dist <= cost)
+		    continue;	/* a witness path exists */
+		*shortcuts += 1;
+		if (simulate)
+		    continue;
+		if (!ch_add_arc (graph, in->node, out->node, index, -1, cost))
+		    return 0;
+	    }
+      }
+    return 1;
+}
+
+static int
+ch_priority (struct ch_graph *graph, int index, int *priority)
+{
+/* computing the contraction priority of some Node */
+    struct ch_node *node = graph->nodes + index;
+    int removed = 0;
+    int shortcuts;
+    int i;
+    for (i = 0; i < node->in.count; i++)
+      {
+	  if (graph->nodes[node->in.edges[i].node].rank < 0)
+	      removed++;
+      }
+    for (i = 0; i < node->out.count; i++)
+      {
+	  if (graph->nodes[node->out.edges[i].node].rank < 0)
+	      removed++;
+      }
+    if (!ch_contract_node (graph, index, 1, &shortcuts))
+	return 0;
+    *priority = shortcuts - removed + node->deleted_neighbours;
+    return 1;
+}
+
+static int
+ch_build (struct ch_graph *graph)
+{
+/* contracting all Nodes following their priority order */
+    struct ch_heap queue;
+    int rank = 0;
+    int priority;
+    int shortcuts;
+    int i;
+    int ok = 0;
+
+    memset (&queue, 0, sizeof (struct ch_heap));
+    for (i = 0; i < graph->n_nodes; i++)
+      {
+	  if (!ch_priority (graph, i, &priority))
+	      goto end;
+	  if (!ch_heap_push (&queue, priority, i))
+	      goto end;
+      }
+    while (queue.count > 0)
+      {
+	  struct ch_heap_item item = ch_heap_pop (&queue);
+	  struct ch_node *node = graph->nodes + item.node;
+	  if (node->rank >= 0)
+	      continue;
+	  /* lazy update: the priority could be changed meanwhile */
+	  if (!ch_priority (graph, item.node, &priority))
+	      goto end;
+	  if (queue.count > 0 && priority > queue.items[0].key)
+	    {
+		if (!ch_heap_push (&queue, priority, item.node))
+		    goto end;
+		continue;
+	    }
+	  if (!ch_contract_node (graph, item.node, 0, &shortcuts))
+	      goto end;
+	  node = graph->nodes + item.node;
+	  node->rank = rank++;
+	  for (i = 0; i < node->in.count; i++)
+	      graph->nodes[node->in.edges[i].node].deleted_neighbours += 1;
+	  for (i = 0; i < node->out.count; i++)
+	      graph->nodes[node->out.edges[i].node].deleted_neighbours += 1;
+      }
+    ok = 1;
+  end:
+    if (queue.items != NULL)
+	free (queue.items);
+    return ok;
+}
+
+static int
+ch_load_graph (sqlite3 * db_handle, const void *cache, struct ch_graph *graph,
+	       int n_nodes)
+{
+/* loading all Links from the Temp-Table */
+    const char *sql;
+    sqlite3_stmt *stmt = NULL;
+    int ret;
+
+    graph->n_nodes = n_nodes;
+    graph->nodes = calloc (n_nodes, sizeof (struct ch_node));
+    if (graph->nodes == NULL)
+      {
+	  gaia_create_routing_set_error (cache, "insufficient memory");
+	  return 0;
+      }
+    for (ret = 0; ret < n_nodes; ret++)
+	graph->nodes[ret].rank = -1;
+    sql = "SELECT rowid, index_from, index_to, cost "
+	"FROM create_routing_links "
+	"WHERE index_from IS NOT NULL AND index_to IS NOT NULL";
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt, NULL);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    while (1)
+      {
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;
+	  if (ret == SQLITE_ROW)
+	    {
+		sqlite3_int64 rowid = sqlite3_column_int64 (stmt, 0);
+		int from = sqlite3_column_int (stmt, 1);
+		int to = sqlite3_column_int (stmt, 2);
+		double cost = sqlite3_column_double (stmt, 3);
+		if (from < 0 || from >= n_nodes || to < 0 || to >= n_nodes)
+		  {
+		      sqlite3_finalize (stmt);
+		      gaia_create_routing_set_error (cache,
+						     "Contraction Hierarchies: invalid Node index");
+		      return 0;
+		  }
+		if (from == to)
+		    continue;	/* ignoring self-loops */
+		if (!ch_add_arc (graph, from, to, -1, rowid, cost))
+		  {
+		      sqlite3_finalize (stmt);
+		      gaia_create_routing_set_error (cache,
+						     "insufficient memory");
+		      return 0;
+		  }
+	    }
+	  else
+	      goto sql_error;
+      }
+    sqlite3_finalize (stmt);
+    return 1;
+
+  sql_error:
+    {
+	char *msg =
+	    sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	gaia_create_routing_set_error (cache, msg);
+	sqlite3_free (msg);
+    }
+    if (stmt != NULL)
+	sqlite3_finalize (stmt);
+    return 0;
+}
+
+static unsigned char *
+ch_output_edge (unsigned char *out, const struct ch_edge *edge,
+		int endian_arch)
+{
+/* exporting an upward edge into NETWORK-DATA */
+    *out++ = GAIA_NET_ARC;
+    gaiaExport32 (out, edge->node, 1, endian_arch);	/* the other Node internal index */
+    out += 4;
+    gaiaExport32 (out, edge->middle, 1, endian_arch);	/* the contracted Node internal index */
+    out += 4;
+    gaiaExportI64 (out, edge->rowid, 1, endian_arch);	/* the Link rowid */
+    out += 8;
+    gaiaExport64 (out, edge->cost, 1, endian_arch);	/* the edge Cost */
+    out += 8;
+    *out++ = GAIA_NET_END;
+    return out;
+}
+
+static int
+ch_output_node (struct ch_graph *graph, int index, unsigned char *auxbuf,
+		int *size, int endian_arch)
+{
+/* exporting a Contraction Hierarchies Node into NETWORK-DATA */
+    struct ch_node *node = graph->nodes + index;
+    unsigned char *out = auxbuf;
+    int n_forward = 0;
+    int n_backward = 0;
+    int i;
+
+    for (i = 0; i < node->out.count; i++)
+      {
+	  if (graph->nodes[node->out.edges[i].node].rank > node->rank)
+	      n_forward++;
+      }
+    for (i = 0; i < node->in.count; i++)
+      {
+	  if (graph->nodes[node->in.edges[i].node].rank > node->rank)
+	      n_backward++;
+      }
+    if (n_forward > 32767 || n_backward > 32767
+	|| (15 + ((n_forward + n_backward) * 26)) > MAX_BLOCK)
+	return 0;
+
+    *out++ = GAIA_NET_NODE;
+    gaiaExport32 (out, index, 1, endian_arch);	/* the Node internal index */
+    out += 4;
+    gaiaExport32 (out, node->rank, 1, endian_arch);	/* the Node rank */
+    out += 4;
+    gaiaExport16 (out, n_forward, 1, endian_arch);	/* # of upward outcoming edges */
+    out += 2;
+    gaiaExport16 (out, n_backward, 1, endian_arch);	/* # of upward incoming edges */
+    out += 2;
+    for (i = 0; i < node->out.count; i++)
+      {
+	  struct ch_edge *edge = node->out.edges + i;
+	  if (graph->nodes[edge->node].rank > node->rank)
+	      out = ch_output_edge (out, edge, endian_arch);
+      }
+    for (i = 0; i < node->in.count; i++)
+      {
+	  struct ch_edge *edge = node->in.edges + i;
+	  if (graph->nodes[edge->node].rank > node->rank)
+	      out = ch_output_edge (out, edge, endian_arch);
+      }
+    *out++ = GAIA_NET_END;
+    *size = out - auxbuf;
+    return 1;
+}
+
+static int
+do_insert_block (sqlite3 * db_handle, const void *cache,
+		 sqlite3_stmt * stmt_out, unsigned char *buf, int size)
+{
+/* inserting a further (CH, Turns or Profiles) data block */
+    int ret;
+    sqlite3_reset (stmt_out);
+    sqlite3_clear_bindings (stmt_out);
+    sqlite3_bind_null (stmt_out, 1);
+    sqlite3_bind_blob (stmt_out, 2, buf, size, SQLITE_STATIC);
+    ret = sqlite3_step (stmt_out);
+    if (ret == SQLITE_DONE || ret == SQLITE_ROW)
+	return 1;
+    else
+      {
+	  char *msg =
+	      sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+      }
+    return 0;
+}
+
+static int
+do_create_ch_data (sqlite3 * db_handle, const void *cache,
+		   sqlite3_stmt * stmt_out, int n_nodes, unsigned char *buf,
+		   unsigned char *auxbuf, int endian_arch)
+{
+/* building the Contraction Hierarchy and storing its data blocks */
+    struct ch_graph graph;
+    unsigned char *out;
+    int nodes_cnt;
+    int size;
+    int i;
+    int ok = 0;
+
+    memset (&graph, 0, sizeof (struct ch_graph));
+    if (!ch_load_graph (db_handle, cache, &graph, n_nodes))
+	goto end;
+    if (!ch_build (&graph))
+      {
+	  gaia_create_routing_set_error (cache, "insufficient memory");
+	  goto end;
+      }
+
+    out = buf;
+    *out++ = GAIA_NET_CH_BLOCK;
+    gaiaExport16 (out, 0, 1, endian_arch);	/* how many Nodes are into this block */
+    out += 2;
+    nodes_cnt = 0;
+    for (i = 0; i < graph.n_nodes; i++)
+      {
+	  if (!ch_output_node (&graph, i, auxbuf, &size, endian_arch))
+	    {
+		gaia_create_routing_set_error (cache,
+					       "Contraction Hierarchies: too many shortcuts on a single Node");
+		goto end;
+	    }
+	  if (size >= (MAX_BLOCK - (out - buf)) || nodes_cnt == 32767)
+	    {
+		/* inserting the last block */
+		gaiaExport16 (buf + 1, nodes_cnt, 1, endian_arch);	/* how many Nodes are into this block */
+		if (!do_insert_block (db_handle, cache, stmt_out, buf, out - buf))
+		    goto end;
+		/* preparing a new block */
+		out = buf;
+		*out++ = GAIA_NET_CH_BLOCK;
+		gaiaExport16 (out, 0, 1, endian_arch);	/* how many Nodes are into this block */
+		out += 2;
+		nodes_cnt = 0;
+	    }
+	  /* inserting the current Node into the block */
+	  nodes_cnt++;
+	  memcpy (out, auxbuf, size);
+	  out += size;
+      }
+    if (nodes_cnt)
+      {
+	  /* inserting the last data block */
+	  gaiaExport16 (buf + 1, nodes_cnt, 1, endian_arch);	/* how many Nodes are into this block */
+	  if (!do_insert_block (db_handle, cache, stmt_out, buf, out - buf))
+	      goto end;
+      }
+    ok = 1;
+  end:
+    ch_free_graph (&graph);
+    return ok;
+}
+
 static int
 do_create_data (sqlite3 * db_handle, const void *cache,
 		const char *output_table, const char *input_table,
 		const char *from_column, const char *to_column,
 		const char *geom_column, const char *name_column,
-		int a_star_enabled, double a_star_coeff, int has_ids,
-		int n_nodes, int max_code_length)
+		int a_star_enabled, double a_star_coeff, int ch_enabled,
+		int has_ids, int n_nodes, int max_code_length)
 {
 /* creating and populating the Routing Data table */
     char *sql;
@@ -2291,6 +2889,17 @@ do_create_data (sqlite3 * db_handle, const void *cache,
 	    }
       }
 
+    if (ch_enabled)
+      {
+	  /* inserting the Contraction Hierarchies data blocks */
+	  if (!do_create_ch_data
+	      (db_handle, cache, stmt_out, n_nodes, buf, auxbuf, endian_arch))
+	    {
+		error = 1;
+		goto error;
+	    }
+      }
+
   error:
     if (auxbuf != NULL)
 	free (auxbuf);
@@ -3010,20 +3619,1804 @@ do_create_routing_nodes (sqlite3 * db_handle, const void *cache,
     return 0;
 }
 
-SPATIALITE_DECLARE int
-gaia_create_routing_nodes (sqlite3 * db_handle,
-			   const void *cache,
-			   const char *db_prefix,
-			   const char *table,
-			   const char *geom_column,
-			   const char *from_column, const char *to_column)
+/*
+/
+/  Turn penalties/restrictions and Time Dependent profiles
+/
+////////////////////////////////////////////////////////////
+/
+/ both are stored into an already existing Routing Data table
+/ as further blocks (GAIA_NET_TURN_BLOCK and GAIA_NET_TD_BLOCK)
+/ following all the ordinary and CH blocks; Links are always
+/ referenced by their ROWID, and will be resolved by VirtualRouting
+/ when loading the graph
+/
+*/
+
+static int
+do_check_extra_columns (sqlite3 * db_handle, const void *cache,
+			const char *table, const char **columns, int count)
 {
-/* attempting to create a Routing Nodes columns for a spatial table */
-    const char *sql;
+/* testing if the input table really contains all required columns */
+    char *xtable;
+    char *sql;
     int ret;
-    char *geom_name = NULL;
-
-    if (db_handle == NULL || cache == NULL)
+    int i;
+    int ic;
+    char **results;
+    int rows;
+    int n_columns;
+    int found;
+
+    xtable = gaiaDoubleQuotedSql (table);
+    sql = sqlite3_mprintf ("PRAGMA table_info(\"%s\")", xtable);
+    free (xtable);
+    ret =
+	sqlite3_get_table (db_handle, sql, &results, &rows, &n_columns, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  char *msg =
+	      sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+	  return 0;
+      }
+    if (rows < 1)
+      {
+	  char *msg =
+	      sqlite3_mprintf ("Input Table \"%s\" does not exist", table);
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+	  sqlite3_free_table (results);
+	  return 0;
+      }
+    for (ic = 0; ic < count; ic++)
+      {
+	  if (columns[ic] == NULL)
+	      continue;
+	  found = 0;
+	  for (i = 1; i <= rows; i++)
+	    {
+		const char *col_name = results[(i * n_columns) + 1];
+		if (strcasecmp (col_name, columns[ic]) == 0)
+		    found = 1;
+	    }
+	  if (!found)
+	    {
+		char *msg = sqlite3_mprintf ("Input Table \"%s\": column \"%s\" "
+					     "does not exist", table,
+					     columns[ic]);
+		gaia_create_routing_set_error (cache, msg);
+		sqlite3_free (msg);
+		sqlite3_free_table (results);
+		return 0;
+	    }
+      }
+    sqlite3_free_table (results);
+    return 1;
+}
+
+static int
+do_begin_extra_blocks (sqlite3 * db_handle, const void *cache,
+		       const char *routing_data_table, unsigned char marker,
+		       sqlite3_stmt ** stmt_out)
+{
+/* 
+/ discarding all the previous blocks of the same kind and
+/ preparing the statement inserting the new ones
+*/
+    char *xtable;
+    char *sql;
+    int ret;
+    sqlite3_stmt *stmt;
+
+    if (!do_check_data_table (db_handle, routing_data_table))
+      {
+	  char *msg =
+	      sqlite3_mprintf ("Routing Data Table \"%s\" does not exist",
+			       routing_data_table);
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+	  return 0;
+      }
+
+    xtable = gaiaDoubleQuotedSql (routing_data_table);
+    sql =
+	sqlite3_mprintf
+	("DELETE FROM \"%s\" WHERE Id > 0 AND substr(NetworkData, 1, 1) = ?",
+	 xtable);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    sqlite3_bind_blob (stmt, 1, &marker, 1, SQLITE_TRANSIENT);
+    ret = sqlite3_step (stmt);
+    sqlite3_finalize (stmt);
+    if (ret != SQLITE_DONE)
+	goto sql_error;
+
+    sql =
+	sqlite3_mprintf
+	("INSERT INTO \"%s\" (Id, NetworkData) VALUES (?, ?)", xtable);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), stmt_out, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    free (xtable);
+    return 1;
+
+  sql_error:
+    free (xtable);
+    {
+	char *msg =
+	    sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	gaia_create_routing_set_error (cache, msg);
+	sqlite3_free (msg);
+    }
+    return 0;
+}
+
+static int
+do_create_turns_data (sqlite3 * db_handle, const void *cache,
+		      const char *routing_data_table, const char *input_table,
+		      const char *from_link_column, const char *to_link_column,
+		      const char *cost_column)
+{
+/* populating the Turns data blocks */
+    char *sql;
+    char *xtable;
+    char *xfrom;
+    char *xto;
+    char *xcost;
+    int ret;
+    sqlite3_stmt *stmt_in = NULL;
+    sqlite3_stmt *stmt_out = NULL;
+    unsigned char *buf = NULL;
+    unsigned char *out;
+    int turns_cnt = 0;
+    int ok = 0;
+    int endian_arch = gaiaEndianArch ();
+
+    if (!do_begin_extra_blocks
+	(db_handle, cache, routing_data_table, GAIA_NET_TURN_BLOCK, &stmt_out))
+	goto end;
+
+    xtable = gaiaDoubleQuotedSql (input_table);
+    xfrom = gaiaDoubleQuotedSql (from_link_column);
+    xto = gaiaDoubleQuotedSql (to_link_column);
+    if (cost_column == NULL)
+	sql = sqlite3_mprintf ("SELECT \"%s\", \"%s\", NULL FROM \"%s\" "
+			       "WHERE \"%s\" IS NOT NULL AND \"%s\" IS NOT NULL",
+			       xfrom, xto, xtable, xfrom, xto);
+    else
+      {
+	  xcost = gaiaDoubleQuotedSql (cost_column);
+	  sql = sqlite3_mprintf ("SELECT \"%s\", \"%s\", \"%s\" FROM \"%s\" "
+				 "WHERE \"%s\" IS NOT NULL AND \"%s\" IS NOT NULL",
+				 xfrom, xto, xcost, xtable, xfrom, xto);
+	  free (xcost);
+      }
+    free (xtable);
+    free (xfrom);
+    free (xto);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt_in, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+
+    buf = malloc (MAX_BLOCK);
+    if (buf == NULL)
+      {
+	  gaia_create_routing_set_error (cache, "insufficient memory");
+	  goto end;
+      }
+    out = buf;
+    *out++ = GAIA_NET_TURN_BLOCK;
+    gaiaExport16 (out, 0, 1, endian_arch);	/* how many Turns are into this block */
+    out += 2;
+    while (1)
+      {
+	  /* scrolling the result set rows */
+	  sqlite3_int64 from_rowid;
+	  sqlite3_int64 to_rowid;
+	  double cost = -1.0;	/* a forbidden turn */
+	  ret = sqlite3_step (stmt_in);
+	  if (ret == SQLITE_DONE)
+	      break;		/* end of result set */
+	  if (ret != SQLITE_ROW)
+	      goto sql_error;
+	  from_rowid = sqlite3_column_int64 (stmt_in, 0);
+	  to_rowid = sqlite3_column_int64 (stmt_in, 1);
+	  if (sqlite3_column_type (stmt_in, 2) == SQLITE_INTEGER
+	      || sqlite3_column_type (stmt_in, 2) == SQLITE_FLOAT)
+	    {
+		cost = sqlite3_column_double (stmt_in, 2);
+		if (cost < 0.0)
+		    cost = -1.0;
+	    }
+	  if ((MAX_BLOCK - (out - buf)) < 26 || turns_cnt == 32767)
+	    {
+		/* inserting the last block */
+		gaiaExport16 (buf + 1, turns_cnt, 1, endian_arch);	/* how many Turns are into this block */
+		if (!do_insert_block
+		    (db_handle, cache, stmt_out, buf, out - buf))
+		    goto end;
+		/* preparing a new block */
+		out = buf;
+		*out++ = GAIA_NET_TURN_BLOCK;
+		gaiaExport16 (out, 0, 1, endian_arch);	/* how many Turns are into this block */
+		out += 2;
+		turns_cnt = 0;
+	    }
+	  *out++ = GAIA_NET_ARC;
+	  gaiaExportI64 (out, from_rowid, 1, endian_arch);	/* the incoming Link rowid */
+	  out += 8;
+	  gaiaExportI64 (out, to_rowid, 1, endian_arch);	/* the outcoming Link rowid */
+	  out += 8;
+	  gaiaExport64 (out, cost, 1, endian_arch);	/* the Turn Cost; < 0 forbidden */
+	  out += 8;
+	  *out++ = GAIA_NET_END;
+	  turns_cnt++;
+      }
+    if (turns_cnt)
+      {
+	  /* inserting the last data block */
+	  gaiaExport16 (buf + 1, turns_cnt, 1, endian_arch);	/* how many Turns are into this block */
+	  if (!do_insert_block (db_handle, cache, stmt_out, buf, out - buf))
+	      goto end;
+      }
+    ok = 1;
+    goto end;
+
+  sql_error:
+    {
+	char *msg =
+	    sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	gaia_create_routing_set_error (cache, msg);
+	sqlite3_free (msg);
+    }
+  end:
+    if (buf != NULL)
+	free (buf);
+    if (stmt_in != NULL)
+	sqlite3_finalize (stmt_in);
+    if (stmt_out != NULL)
+	sqlite3_finalize (stmt_out);
+    return ok;
+}
+
+static unsigned char *
+do_output_profile (unsigned char *out, sqlite3_int64 rowid,
+		   const double *points, int count, int endian_arch)
+{
+/* exporting a Time Dependent profile into NETWORK-DATA */
+    int i;
+    *out++ = GAIA_NET_ARC;
+    gaiaExportI64 (out, rowid, 1, endian_arch);	/* the Link rowid */
+    out += 8;
+    gaiaExport16 (out, count, 1, endian_arch);	/* # of breakpoints */
+    out += 2;
+    for (i = 0; i < count; i++)
+      {
+	  gaiaExport64 (out, points[i * 2], 1, endian_arch);	/* the Time of the day */
+	  out += 8;
+	  gaiaExport64 (out, points[(i * 2) + 1], 1, endian_arch);	/* the Cost at that Time */
+	  out += 8;
+      }
+    *out++ = GAIA_NET_END;
+    return out;
+}
+
+static int
+do_flush_profile (sqlite3 * db_handle, const void *cache,
+		  sqlite3_stmt * stmt_out, unsigned char *buf,
+		  unsigned char **out, int *profiles_cnt, sqlite3_int64 rowid,
+		  const double *points, int count, int endian_arch)
+{
+/* appending a Time Dependent profile into the current block */
+    int size = 12 + (count * 16);
+    if (count == 0)
+	return 1;
+    if (count > 32767 || size > (MAX_BLOCK - 3))
+      {
+	  gaia_create_routing_set_error (cache,
+					 "Time Dependent profile: too many breakpoints on a single Link");
+	  return 0;
+      }
+    if ((MAX_BLOCK - (*out - buf)) < size || *profiles_cnt == 32767)
+      {
+	  /* inserting the last block */
+	  gaiaExport16 (buf + 1, *profiles_cnt, 1, endian_arch);	/* how many Profiles are into this block */
+	  if (!do_insert_block (db_handle, cache, stmt_out, buf, *out - buf))
+	      return 0;
+	  /* preparing a new block */
+	  *out = buf;
+	  *(*out)++ = GAIA_NET_TD_BLOCK;
+	  gaiaExport16 (*out, 0, 1, endian_arch);	/* how many Profiles are into this block */
+	  *out += 2;
+	  *profiles_cnt = 0;
+      }
+    *out = do_output_profile (*out, rowid, points, count, endian_arch);
+    *profiles_cnt += 1;
+    return 1;
+}
+
+static int
+do_create_profiles_data (sqlite3 * db_handle, const void *cache,
+			 const char *routing_data_table,
+			 const char *input_table, const char *link_column,
+			 const char *time_column, const char *cost_column)
+{
+/* populating the Time Dependent profiles data blocks */
+    char *sql;
+    char *xtable;
+    char *xlink;
+    char *xtime;
+    char *xcost;
+    int ret;
+    sqlite3_stmt *stmt_in = NULL;
+    sqlite3_stmt *stmt_out = NULL;
+    unsigned char *buf = NULL;
+    unsigned char *out;
+    double *points = NULL;
+    int count = 0;
+    int max = 0;
+    int first = 1;
+    sqlite3_int64 current = 0;
+    int profiles_cnt = 0;
+    int ok = 0;
+    int endian_arch = gaiaEndianArch ();
+
+    if (!do_begin_extra_blocks
+	(db_handle, cache, routing_data_table, GAIA_NET_TD_BLOCK, &stmt_out))
+	goto end;
+
+    xtable = gaiaDoubleQuotedSql (input_table);
+    xlink = gaiaDoubleQuotedSql (link_column);
+    xtime = gaiaDoubleQuotedSql (time_column);
+    xcost = gaiaDoubleQuotedSql (cost_column);
+    sql = sqlite3_mprintf ("SELECT \"%s\", \"%s\", \"%s\" FROM \"%s\" "
+			   "WHERE \"%s\" IS NOT NULL AND \"%s\" IS NOT NULL "
+			   "AND \"%s\" IS NOT NULL ORDER BY \"%s\", \"%s\"",
+			   xlink, xtime, xcost, xtable, xlink, xtime, xcost,
+			   xlink, xtime);
+    free (xtable);
+    free (xlink);
+    free (xtime);
+    free (xcost);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt_in, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+
+    buf = malloc (MAX_BLOCK);
+    if (buf == NULL)
+      {
+	  gaia_create_routing_set_error (cache, "insufficient memory");
+	  goto end;
+      }
+    out = buf;
+    *out++ = GAIA_NET_TD_BLOCK;
+    gaiaExport16 (out, 0, 1, endian_arch);	/* how many Profiles are into this block */
+    out += 2;
+    while (1)
+      {
+	  /* scrolling the result set rows */
+	  sqlite3_int64 rowid;
+	  double tm;
+	  double cost;
+	  ret = sqlite3_step (stmt_in);
+	  if (ret == SQLITE_DONE)
+	      break;		/* end of result set */
+	  if (ret != SQLITE_ROW)
+	      goto sql_error;
+	  rowid = sqlite3_column_int64 (stmt_in, 0);
+	  tm = sqlite3_column_double (stmt_in, 1);
+	  cost = sqlite3_column_double (stmt_in, 2);
+	  if (tm < 0.0 || tm >= 86400.0)
+	    {
+		gaia_create_routing_set_error (cache,
+					       "Time Dependent profile: Time out of range [0 - 86400)");
+		goto end;
+	    }
+	  if (cost < 0.0)
+	    {
+		gaia_create_routing_set_error (cache,
+					       "Time Dependent profile: negative Cost");
+		goto end;
+	    }
+	  if (!first && rowid != current)
+	    {
+		/* completing the previous Link */
+		if (!do_flush_profile
+		    (db_handle, cache, stmt_out, buf, &out, &profiles_cnt,
+		     current, points, count, endian_arch))
+		    goto end;
+		count = 0;
+	    }
+	  first = 0;
+	  current = rowid;
+	  if (count == max)
+	    {
+		double *new_points;
+		max = (max == 0) ? 32 : max * 2;
+		new_points = realloc (points, sizeof (double) * 2 * max);
+		if (new_points == NULL)
+		  {
+		      gaia_create_routing_set_error (cache,
+						     "insufficient memory");
+		      goto end;
+		  }
+		points = new_points;
+	    }
+	  points[count * 2] = tm;
+	  points[(count * 2) + 1] = cost;
+	  count++;
+      }
+    if (!do_flush_profile
+	(db_handle, cache, stmt_out, buf, &out, &profiles_cnt, current,
+	 points, count, endian_arch))
+	goto end;
+    if (profiles_cnt)
+      {
+	  /* inserting the last data block */
+	  gaiaExport16 (buf + 1, profiles_cnt, 1, endian_arch);	/* how many Profiles are into this block */
+	  if (!do_insert_block (db_handle, cache, stmt_out, buf, out - buf))
+	      goto end;
+      }
+    ok = 1;
+    goto end;
+
+  sql_error:
+    {
+	char *msg =
+	    sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	gaia_create_routing_set_error (cache, msg);
+	sqlite3_free (msg);
+    }
+  end:
+    if (points != NULL)
+	free (points);
+    if (buf != NULL)
+	free (buf);
+    if (stmt_in != NULL)
+	sqlite3_finalize (stmt_in);
+    if (stmt_out != NULL)
+	sqlite3_finalize (stmt_out);
+    return ok;
+}
+
+static int
+do_end_extra_blocks (sqlite3 * db_handle, const void *cache,
+		     const char *savepoint, int ok)
+{
+/* releasing (or rolling back) the Savepoint */
+    char *sql;
+    int ret;
+    if (!ok)
+      {
+	  sql = sqlite3_mprintf ("ROLLBACK TO %s", savepoint);
+	  sqlite3_exec (db_handle, sql, NULL, NULL, NULL);
+	  sqlite3_free (sql);
+      }
+    sql = sqlite3_mprintf ("RELEASE SAVEPOINT %s", savepoint);
+    ret = sqlite3_exec (db_handle, sql, NULL, NULL, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK && ok)
+      {
+	  char *msg =
+	      sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+	  return 0;
+      }
+    return ok;
+}
+
+/*
+/
+/  Incremental updates
+/
+////////////////////////////////////////////////////////////
+/
+/ a few Links are read again from the input table, and only the
+/ ordinary Blocks containing their NodeFrom (both old and new) will be
+/ rewritten in place; any Contraction Hierarchies Block will be
+/ discarded, because the shortcuts could be no longer valid.
+/
+/ two further rows (having negative Ids, and thus preceding the
+/ header) allow any VirtualRouting table to detect an updated network
+/ and to reload just the modified Blocks:
+/ - GAIA_NET_UPDATE_STAMP_ID: the current Generation
+/ - GAIA_NET_UPDATE_LOG_ID: the Id of every modified Block and the
+/   Generation of its most recent change
+/
+*/
+
+struct upd_header
+{
+/* the Routing Data header */
+    int n_nodes;
+    int has_ids;
+    int max_code_length;
+    int a_star;
+    double a_star_coeff;
+    char *input_table;
+    char *from_column;
+    char *to_column;
+    char *geom_column;		/* NULL if there is no Geometry */
+};
+
+struct upd_node_key
+{
+/* a Node referenced by some updated Link */
+    sqlite3_int64 id;
+    const char *code;		/* NULL if Nodes are identified by Ids */
+    int is_from;		/* some updated Link starts from this Node */
+    int index;			/* the Node internal index; -1 if not found */
+};
+
+struct upd_arc
+{
+/* an updated Link (just a single direction) */
+    sqlite3_int64 rowid;
+    sqlite3_int64 id_from;
+    char *cod_from;
+    sqlite3_int64 id_to;
+    char *cod_to;
+    double cost;
+    int index_from;
+    int index_to;
+};
+
+struct upd_out_arc
+{
+/* helper struct: an arc to be written into a rewritten Block */
+    sqlite3_int64 rowid;
+    int index_to;
+    double cost;
+};
+
+struct upd_context
+{
+/* the incremental update of a Routing Data table */
+    int endian_arch;
+    struct upd_header hdr;
+    double a_star_coeff;	/* the A* coeff; could be lowered by the update */
+    sqlite3_int64 *rowids;	/* sorted, no duplicates */
+    int n_rowids;
+    struct upd_arc *arcs;
+    int n_arcs;
+    int max_arcs;
+    struct upd_node_key *keys;	/* sorted, no duplicates */
+    int n_keys;
+    sqlite3_int64 *dirty;	/* Ids of all Blocks to be rewritten */
+    int n_dirty;
+    int max_dirty;
+    sqlite3_int64 *ch_blocks;	/* Ids of all CH Blocks to be discarded */
+    int n_ch_blocks;
+    int max_ch_blocks;
+};
+
+static char *
+do_parse_header_name (const unsigned char **ptr, const unsigned char *end,
+		      unsigned char marker, int endian_arch)
+{
+/* parsing a varlen name from the HEADER block */
+    const unsigned char *p = *ptr;
+    char *name;
+    int len;
+    if (end - p < 3 || *p != marker)
+	return NULL;
+    len = gaiaImport16 (p + 1, 1, endian_arch);
+    p += 3;
+    if (len < 1 || end - p < len || *(p + len - 1) != '\0')
+	return NULL;
+    name = malloc (len);
+    memcpy (name, p, len);
+    *ptr = p + len;
+    return name;
+}
+
+static void
+do_free_header (struct upd_header *hdr)
+{
+/* memory cleanup - Routing Data header */
+    if (hdr->input_table != NULL)
+	free (hdr->input_table);
+    if (hdr->from_column != NULL)
+	free (hdr->from_column);
+    if (hdr->to_column != NULL)
+	free (hdr->to_column);
+    if (hdr->geom_column != NULL)
+	free (hdr->geom_column);
+}
+
+static int
+do_parse_header (const unsigned char *blob, int size, int endian_arch,
+		 struct upd_header *hdr)
+{
+/* parsing the HEADER block (only the 64 bit format is supported) */
+    const unsigned char *end = blob + size;
+    const unsigned char *ptr;
+    char *name;
+    memset (hdr, 0, sizeof (struct upd_header));
+    if (size < 9)
+	return 0;
+    if (*blob == GAIA_NET64_A_STAR_START)
+	hdr->a_star = 1;
+    else if (*blob != GAIA_NET64_START)
+	return 0;
+    if (*(blob + 1) != GAIA_NET_HEADER)
+	return 0;
+    hdr->n_nodes = gaiaImport32 (blob + 2, 1, endian_arch);
+    if (*(blob + 6) == GAIA_NET_ID)
+	hdr->has_ids = 1;
+    else if (*(blob + 6) != GAIA_NET_CODE)
+	return 0;
+    hdr->max_code_length = *(blob + 7);
+    ptr = blob + 8;
+    hdr->input_table =
+	do_parse_header_name (&ptr, end, GAIA_NET_TABLE, endian_arch);
+    if (hdr->input_table == NULL)
+	return 0;
+    hdr->from_column =
+	do_parse_header_name (&ptr, end, GAIA_NET_FROM, endian_arch);
+    if (hdr->from_column == NULL)
+	return 0;
+    hdr->to_column = do_parse_header_name (&ptr, end, GAIA_NET_TO, endian_arch);
+    if (hdr->to_column == NULL)
+	return 0;
+    hdr->geom_column =
+	do_parse_header_name (&ptr, end, GAIA_NET_GEOM, endian_arch);
+    if (hdr->geom_column == NULL)
+	return 0;
+    if (*(hdr->geom_column) == '\0')
+      {
+	  free (hdr->geom_column);
+	  hdr->geom_column = NULL;
+      }
+    name = do_parse_header_name (&ptr, end, GAIA_NET_NAME, endian_arch);
+    if (name == NULL)
+	return 0;
+    free (name);
+    if (hdr->a_star)
+      {
+	  if (end - ptr < 9 || *ptr != GAIA_NET_A_STAR_COEFF)
+	      return 0;
+	  hdr->a_star_coeff = gaiaImport64 (ptr + 1, 1, endian_arch);
+	  ptr += 9;
+      }
+    if (ptr >= end || *ptr != GAIA_NET_END)
+	return 0;
+    return 1;
+}
+
+static int
+do_append_block_id (sqlite3_int64 ** ids, int *count, int *max,
+		    sqlite3_int64 id)
+{
+/* appending a further Block Id */
+    if (*count == *max)
+      {
+	  int new_max = (*max == 0) ? 64 : *max * 2;
+	  sqlite3_int64 *new_ids =
+	      realloc (*ids, sizeof (sqlite3_int64) * new_max);
+	  if (new_ids == NULL)
+	      return 0;
+	  *ids = new_ids;
+	  *max = new_max;
+      }
+    *(*ids + *count) = id;
+    *count += 1;
+    return 1;
+}
+
+static int
+cmp_upd_rowids (const void *p1, const void *p2)
+{
+/* compares two ROWIDs (for qsort / bsearch) */
+    sqlite3_int64 r1 = *((const sqlite3_int64 *) p1);
+    sqlite3_int64 r2 = *((const sqlite3_int64 *) p2);
+    if (r1 == r2)
+	return 0;
+    if (r1 > r2)
+	return 1;
+    return -1;
+}
+
+static int
+cmp_upd_node_keys (const void *p1, const void *p2)
+{
+/* compares two Node keys (for qsort / bsearch) */
+    const struct upd_node_key *k1 = (const struct upd_node_key *) p1;
+    const struct upd_node_key *k2 = (const struct upd_node_key *) p2;
+    if (k1->code != NULL && k2->code != NULL)
+	return strcmp (k1->code, k2->code);
+    if (k1->id == k2->id)
+	return 0;
+    if (k1->id > k2->id)
+	return 1;
+    return -1;
+}
+
+static int
+cmp_upd_arcs (const void *p1, const void *p2)
+{
+/* compares two updated Links by NodeFrom internal index (for qsort) */
+    const struct upd_arc *a1 = (const struct upd_arc *) p1;
+    const struct upd_arc *a2 = (const struct upd_arc *) p2;
+    if (a1->index_from == a2->index_from)
+	return cmp_upd_rowids (&(a1->rowid), &(a2->rowid));
+    return a1->index_from - a2->index_from;
+}
+
+static int
+cmp_upd_out_arcs (const void *p1, const void *p2)
+{
+/* compares two arcs by Cost and NodeTo (the CreateRouting order) */
+    const struct upd_out_arc *a1 = (const struct upd_out_arc *) p1;
+    const struct upd_out_arc *a2 = (const struct upd_out_arc *) p2;
+    if (a1->cost < a2->cost)
+	return -1;
+    if (a1->cost > a2->cost)
+	return 1;
+    if (a1->index_to != a2->index_to)
+	return a1->index_to - a2->index_to;
+    return cmp_upd_rowids (&(a1->rowid), &(a2->rowid));
+}
+
+static void
+do_free_upd_context (struct upd_context *ctx)
+{
+/* memory cleanup - incremental update */
+    int i;
+    do_free_header (&(ctx->hdr));
+    if (ctx->rowids != NULL)
+	free (ctx->rowids);
+    if (ctx->arcs != NULL)
+      {
+	  for (i = 0; i < ctx->n_arcs; i++)
+	    {
+		struct upd_arc *arc = ctx->arcs + i;
+		if (arc->cod_from != NULL)
+		    free (arc->cod_from);
+		if (arc->cod_to != NULL)
+		    free (arc->cod_to);
+	    }
+	  free (ctx->arcs);
+      }
+    if (ctx->keys != NULL)
+	free (ctx->keys);
+    if (ctx->dirty != NULL)
+	free (ctx->dirty);
+    if (ctx->ch_blocks != NULL)
+	free (ctx->ch_blocks);
+}
+
+static int
+do_add_upd_arc (struct upd_context *ctx, sqlite3_int64 rowid,
+		sqlite3_int64 id_from, const char *cod_from,
+		sqlite3_int64 id_to, const char *cod_to, double cost)
+{
+/* appending a further updated Link (just a single direction) */
+    struct upd_arc *arc;
+    if (ctx->n_arcs == ctx->max_arcs)
+      {
+	  int max = (ctx->max_arcs == 0) ? 64 : ctx->max_arcs * 2;
+	  struct upd_arc *arcs =
+	      realloc (ctx->arcs, sizeof (struct upd_arc) * max);
+	  if (arcs == NULL)
+	      return 0;
+	  ctx->arcs = arcs;
+	  ctx->max_arcs = max;
+      }
+    arc = ctx->arcs + ctx->n_arcs;
+    memset (arc, 0, sizeof (struct upd_arc));
+    ctx->n_arcs += 1;
+    arc->rowid = rowid;
+    arc->id_from = id_from;
+    arc->id_to = id_to;
+    if (cod_from != NULL)
+      {
+	  arc->cod_from = malloc (strlen (cod_from) + 1);
+	  strcpy (arc->cod_from, cod_from);
+      }
+    if (cod_to != NULL)
+      {
+	  arc->cod_to = malloc (strlen (cod_to) + 1);
+	  strcpy (arc->cod_to, cod_to);
+      }
+    arc->cost = cost;
+    arc->index_from = -1;
+    arc->index_to = -1;
+    return 1;
+}
+
+static int
+do_fetch_upd_links (sqlite3 * db_handle, const void *cache,
+		    struct upd_context *ctx, const char *cost_column,
+		    int bidirectional, const char *oneway_from,
+		    const char *oneway_to)
+{
+/*
+/ reading again all the updated Links from the input table
+/ a Link no longer existing (or having a NULL cost) is simply removed
+*/
+    struct upd_header *hdr = &(ctx->hdr);
+    char *sql;
+    char *xtable;
+    char *xfrom;
+    char *xto;
+    char *xgeom = NULL;
+    char *xcost = NULL;
+    char *xoneway_from = NULL;
+    char *xoneway_to = NULL;
+    char *length;
+    int is_geographic = 0;
+    int ret;
+    int i;
+    int ok = 0;
+    sqlite3_stmt *stmt = NULL;
+    char *msg;
+
+    if (cost_column == NULL || hdr->a_star)
+      {
+	  /* the Geometry length is required */
+	  int srid;
+	  int dims;
+	  if (hdr->geom_column == NULL)
+	    {
+		gaia_create_routing_set_error (cache,
+					       "Both Geometry Column and Cost Column Names are NULL at the same time");
+		return 0;
+	    }
+	  if (!do_search_srid
+	      (db_handle, hdr->input_table, hdr->geom_column, &srid, &dims,
+	       &is_geographic))
+	    {
+		msg = sqlite3_mprintf ("Unable to find geometry %Q.%Q",
+				       hdr->input_table, hdr->geom_column);
+		gaia_create_routing_set_error (cache, msg);
+		sqlite3_free (msg);
+		return 0;
+	    }
+	  xgeom = gaiaDoubleQuotedSql (hdr->geom_column);
+	  if (is_geographic)
+	      length = sqlite3_mprintf ("ST_Length(\"%s\", 1)", xgeom);
+	  else
+	      length = sqlite3_mprintf ("ST_Length(\"%s\")", xgeom);
+	  free (xgeom);
+      }
+    else
+	length = sqlite3_mprintf ("NULL");
+    if (cost_column != NULL)
+	xcost = gaiaDoubleQuotedSql (cost_column);
+    if (oneway_from != NULL)
+	xoneway_from = gaiaDoubleQuotedSql (oneway_from);
+    if (oneway_to != NULL)
+	xoneway_to = gaiaDoubleQuotedSql (oneway_to);
+    xtable = gaiaDoubleQuotedSql (hdr->input_table);
+    xfrom = gaiaDoubleQuotedSql (hdr->from_column);
+    xto = gaiaDoubleQuotedSql (hdr->to_column);
+    sql =
+	sqlite3_mprintf
+	("SELECT \"%s\", \"%s\", %s, %s%s%s, %s%s%s, %s%s%s FROM \"%s\" WHERE ROWID = ?",
+	 xfrom, xto, length, (xcost == NULL) ? "NULL" : "\"",
+	 (xcost == NULL) ? "" : xcost, (xcost == NULL) ? "" : "\"",
+	 (xoneway_from == NULL) ? "NULL" : "\"",
+	 (xoneway_from == NULL) ? "" : xoneway_from,
+	 (xoneway_from == NULL) ? "" : "\"",
+	 (xoneway_to == NULL) ? "NULL" : "\"",
+	 (xoneway_to == NULL) ? "" : xoneway_to,
+	 (xoneway_to == NULL) ? "" : "\"", xtable);
+    free (xtable);
+    free (xfrom);
+    free (xto);
+    sqlite3_free (length);
+    if (xcost != NULL)
+	free (xcost);
+    if (xoneway_from != NULL)
+	free (xoneway_from);
+    if (xoneway_to != NULL)
+	free (xoneway_to);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+
+    ctx->a_star_coeff = hdr->a_star_coeff;
+    for (i = 0; i < ctx->n_rowids; i++)
+      {
+	  sqlite3_int64 rowid = ctx->rowids[i];
+	  sqlite3_int64 id_from = -1;
+	  sqlite3_int64 id_to = -1;
+	  const char *from = NULL;
+	  const char *to = NULL;
+	  double cost = -1.0;
+	  int from_to = 1;
+	  int to_from = 1;
+	  sqlite3_reset (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  sqlite3_bind_int64 (stmt, 1, rowid);
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      continue;		/* removed Link */
+	  if (ret != SQLITE_ROW)
+	      goto sql_error;
+	  if (hdr->has_ids)
+	    {
+		if (sqlite3_column_type (stmt, 0) != SQLITE_INTEGER)
+		  {
+		      msg =
+			  sqlite3_mprintf
+			  ("NodeFrom column \"%s\": found a mismatching value",
+			   hdr->from_column);
+		      goto error;
+		  }
+		if (sqlite3_column_type (stmt, 1) != SQLITE_INTEGER)
+		  {
+		      msg =
+			  sqlite3_mprintf
+			  ("NodeTo column \"%s\": found a mismatching value",
+			   hdr->to_column);
+		      goto error;
+		  }
+		id_from = sqlite3_column_int64 (stmt, 0);
+		id_to = sqlite3_column_int64 (stmt, 1);
+	    }
+	  else
+	    {
+		if (sqlite3_column_type (stmt, 0) != SQLITE_TEXT)
+		  {
+		      msg =
+			  sqlite3_mprintf
+			  ("NodeFrom column \"%s\": found a mismatching value",
+			   hdr->from_column);
+		      goto error;
+		  }
+		if (sqlite3_column_type (stmt, 1) != SQLITE_TEXT)
+		  {
+		      msg =
+			  sqlite3_mprintf
+			  ("NodeTo column \"%s\": found a mismatching value",
+			   hdr->to_column);
+		      goto error;
+		  }
+		from = (const char *) sqlite3_column_text (stmt, 0);
+		to = (const char *) sqlite3_column_text (stmt, 1);
+		if ((int) strlen (from) > hdr->max_code_length
+		    || (int) strlen (to) > hdr->max_code_length)
+		  {
+		      msg =
+			  sqlite3_mprintf
+			  ("Link %lld: Node Code too long, a full CreateRouting is required",
+			   rowid);
+		      goto error;
+		  }
+	    }
+	  if (cost_column != NULL)
+	    {
+		if (sqlite3_column_type (stmt, 3) == SQLITE_NULL)
+		    continue;	/* closed Link */
+		if (sqlite3_column_type (stmt, 3) != SQLITE_FLOAT
+		    && sqlite3_column_type (stmt, 3) != SQLITE_INTEGER)
+		  {
+		      msg =
+			  sqlite3_mprintf
+			  ("Cost column \"%s\": found a value that's not a DOUBLE",
+			   cost_column);
+		      goto error;
+		  }
+		cost = sqlite3_column_double (stmt, 3);
+		if (cost <= 0.0)
+		  {
+		      msg =
+			  sqlite3_mprintf
+			  ("Cost column \"%s\": found a negative or zero value",
+			   cost_column);
+		      goto error;
+		  }
+	    }
+	  if (cost_column == NULL || hdr->a_star)
+	    {
+		double len;
+		if (sqlite3_column_type (stmt, 2) != SQLITE_FLOAT)
+		  {
+		      msg =
+			  sqlite3_mprintf
+			  ("Geometry column \"%s\": ST_Length() returned an invalid value",
+			   hdr->geom_column);
+		      goto error;
+		  }
+		len = sqlite3_column_double (stmt, 2);
+		if (cost_column == NULL)
+		    cost = len;
+		else if (len > 0.0 && cost / len < ctx->a_star_coeff)
+		    ctx->a_star_coeff = cost / len;
+	    }
+	  if (oneway_from != NULL)
+	    {
+		if (sqlite3_column_type (stmt, 4) != SQLITE_INTEGER)
+		  {
+		      msg =
+			  sqlite3_mprintf
+			  ("OnewayFromTo column \"%s\": found a value that's not an INTEGER",
+			   oneway_from);
+		      goto error;
+		  }
+		from_to = sqlite3_column_int (stmt, 4);
+	    }
+	  if (oneway_to != NULL)
+	    {
+		if (sqlite3_column_type (stmt, 5) != SQLITE_INTEGER)
+		  {
+		      msg =
+			  sqlite3_mprintf
+			  ("OnewayToFrom column \"%s\": found a value that's not an INTEGER",
+			   oneway_to);
+		      goto error;
+		  }
+		to_from = sqlite3_column_int (stmt, 5);
+	    }
+	  if (!bidirectional)
+	      to_from = 0;
+	  if (from_to || !bidirectional)
+	    {
+		if (!do_add_upd_arc
+		    (ctx, rowid, id_from, from, id_to, to, cost))
+		    goto no_memory;
+	    }
+	  if (to_from)
+	    {
+		if (!do_add_upd_arc
+		    (ctx, rowid, id_to, to, id_from, from, cost))
+		    goto no_memory;
+	    }
+      }
+    ok = 1;
+    goto end;
+
+  no_memory:
+    gaia_create_routing_set_error (cache, "insufficient memory");
+    goto end;
+  error:
+    gaia_create_routing_set_error (cache, msg);
+    sqlite3_free (msg);
+    goto end;
+  sql_error:
+    msg = sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+    gaia_create_routing_set_error (cache, msg);
+    sqlite3_free (msg);
+  end:
+    if (stmt != NULL)
+	sqlite3_finalize (stmt);
+    return ok;
+}
+
+static int
+do_prepare_upd_keys (struct upd_context *ctx)
+{
+/* preparing the sorted list of all Nodes referenced by updated Links */
+    int i;
+    int n = 0;
+    if (ctx->n_arcs == 0)
+	return 1;
+    ctx->keys = malloc (sizeof (struct upd_node_key) * ctx->n_arcs * 2);
+    if (ctx->keys == NULL)
+	return 0;
+    for (i = 0; i < ctx->n_arcs; i++)
+      {
+	  struct upd_arc *arc = ctx->arcs + i;
+	  struct upd_node_key *key = ctx->keys + n++;
+	  key->id = arc->id_from;
+	  key->code = arc->cod_from;
+	  key->is_from = 1;
+	  key->index = -1;
+	  key = ctx->keys + n++;
+	  key->id = arc->id_to;
+	  key->code = arc->cod_to;
+	  key->is_from = 0;
+	  key->index = -1;
+      }
+    qsort (ctx->keys, n, sizeof (struct upd_node_key), cmp_upd_node_keys);
+    ctx->n_keys = 0;
+    for (i = 0; i < n; i++)
+      {
+	  /* removing duplicates */
+	  struct upd_node_key *key = ctx->keys + i;
+	  if (ctx->n_keys > 0
+	      && cmp_upd_node_keys (ctx->keys + ctx->n_keys - 1, key) == 0)
+	    {
+		if (key->is_from)
+		    ctx->keys[ctx->n_keys - 1].is_from = 1;
+		continue;
+	    }
+	  ctx->keys[ctx->n_keys++] = *key;
+      }
+    return 1;
+}
+
+static struct upd_node_key *
+do_find_upd_key (struct upd_context *ctx, sqlite3_int64 id, const char *code)
+{
+/* searching a Node referenced by some updated Link */
+    struct upd_node_key key;
+    if (ctx->n_keys == 0)
+	return NULL;
+    key.id = id;
+    key.code = code;
+    return bsearch (&key, ctx->keys, ctx->n_keys,
+		    sizeof (struct upd_node_key), cmp_upd_node_keys);
+}
+
+static int
+do_upd_node_header_size (struct upd_context *ctx)
+{
+/* the size of each Node, Links excluded */
+    int size = 5;
+    if (ctx->hdr.has_ids)
+	size += 8;
+    else
+	size += ctx->hdr.max_code_length;
+    if (ctx->hdr.a_star)
+	size += 16;
+    return size + 2;
+}
+
+static int
+do_scan_upd_block (struct upd_context *ctx, const unsigned char *blob,
+		   int size, char *code, int *dirty)
+{
+/*
+/ scanning an ordinary Block: the internal index of each referenced
+/ Node will be retrieved, and the Block will be marked as dirty if it
+/ contains any Node affected by the update
+*/
+    const unsigned char *in = blob + 3;
+    const unsigned char *end = blob + size;
+    int node_size = do_upd_node_header_size (ctx);
+    int nodes;
+    int i;
+    int ia;
+    *dirty = 0;
+    nodes = gaiaImport16 (blob + 1, 1, ctx->endian_arch);
+    for (i = 0; i < nodes; i++)
+      {
+	  struct upd_node_key *key;
+	  sqlite3_int64 id = -1;
+	  int index;
+	  int links;
+	  if (end - in < node_size || *in != GAIA_NET_NODE)
+	      return 0;
+	  index = gaiaImport32 (in + 1, 1, ctx->endian_arch);
+	  if (ctx->hdr.has_ids)
+	    {
+		id = gaiaImportI64 (in + 5, 1, ctx->endian_arch);
+		key = do_find_upd_key (ctx, id, NULL);
+	    }
+	  else
+	    {
+		memcpy (code, in + 5, ctx->hdr.max_code_length);
+		*(code + ctx->hdr.max_code_length) = '\0';
+		key = do_find_upd_key (ctx, -1, code);
+	    }
+	  if (key != NULL)
+	    {
+		key->index = index;
+		if (key->is_from)
+		    *dirty = 1;
+	    }
+	  links = gaiaImport16 (in + node_size - 2, 1, ctx->endian_arch);
+	  in += node_size;
+	  if (links < 0 || end - in < (links * 22) + 1)
+	      return 0;
+	  for (ia = 0; ia < links; ia++)
+	    {
+		sqlite3_int64 rowid = gaiaImportI64 (in + 1, 1,
+						     ctx->endian_arch);
+		if (bsearch
+		    (&rowid, ctx->rowids, ctx->n_rowids,
+		     sizeof (sqlite3_int64), cmp_upd_rowids) != NULL)
+		    *dirty = 1;
+		in += 22;
+	    }
+	  if (*in++ != GAIA_NET_END)
+	      return 0;
+      }
+    return 1;
+}
+
+static int
+do_scan_upd_blocks (sqlite3 * db_handle, const void *cache,
+		    const char *routing_data_table, struct upd_context *ctx)
+{
+/* scanning all the Blocks */
+    char *sql;
+    char *xtable;
+    char *code;
+    char *msg;
+    int ret;
+    int i;
+    int ok = 0;
+    sqlite3_stmt *stmt = NULL;
+
+    code = malloc (ctx->hdr.max_code_length + 1);
+    xtable = gaiaDoubleQuotedSql (routing_data_table);
+    sql =
+	sqlite3_mprintf ("SELECT Id, NetworkData FROM \"%s\" WHERE Id > 0",
+			 xtable);
+    free (xtable);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    while (1)
+      {
+	  sqlite3_int64 id;
+	  const unsigned char *blob;
+	  int size;
+	  int dirty;
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;
+	  if (ret != SQLITE_ROW)
+	      goto sql_error;
+	  if (sqlite3_column_type (stmt, 1) != SQLITE_BLOB)
+	      continue;
+	  id = sqlite3_column_int64 (stmt, 0);
+	  blob = sqlite3_column_blob (stmt, 1);
+	  size = sqlite3_column_bytes (stmt, 1);
+	  if (size < 3)
+	      continue;
+	  if (*blob == GAIA_NET_CH_BLOCK)
+	    {
+		if (!do_append_block_id
+		    (&(ctx->ch_blocks), &(ctx->n_ch_blocks),
+		     &(ctx->max_ch_blocks), id))
+		    goto no_memory;
+		continue;
+	    }
+	  if (*blob != GAIA_NET_BLOCK)
+	      continue;
+	  if (!do_scan_upd_block (ctx, blob, size, code, &dirty))
+	    {
+		msg =
+		    sqlite3_mprintf ("Routing Data Table \"%s\": invalid Block %lld",
+				     routing_data_table, id);
+		gaia_create_routing_set_error (cache, msg);
+		sqlite3_free (msg);
+		goto end;
+	    }
+	  if (dirty)
+	    {
+		if (!do_append_block_id
+		    (&(ctx->dirty), &(ctx->n_dirty), &(ctx->max_dirty), id))
+		    goto no_memory;
+	    }
+      }
+
+/* all referenced Nodes must already exist */
+    for (i = 0; i < ctx->n_keys; i++)
+      {
+	  struct upd_node_key *key = ctx->keys + i;
+	  if (key->index >= 0)
+	      continue;
+	  if (key->code != NULL)
+	      msg =
+		  sqlite3_mprintf
+		  ("Node \"%s\" not found: adding Nodes requires a full CreateRouting",
+		   key->code);
+	  else
+	      msg =
+		  sqlite3_mprintf
+		  ("Node %lld not found: adding Nodes requires a full CreateRouting",
+		   key->id);
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+	  goto end;
+      }
+    for (i = 0; i < ctx->n_arcs; i++)
+      {
+	  struct upd_arc *arc = ctx->arcs + i;
+	  arc->index_from =
+	      do_find_upd_key (ctx, arc->id_from, arc->cod_from)->index;
+	  arc->index_to = do_find_upd_key (ctx, arc->id_to, arc->cod_to)->index;
+      }
+    qsort (ctx->arcs, ctx->n_arcs, sizeof (struct upd_arc), cmp_upd_arcs);
+    ok = 1;
+    goto end;
+
+  no_memory:
+    gaia_create_routing_set_error (cache, "insufficient memory");
+    goto end;
+  sql_error:
+    msg = sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+    gaia_create_routing_set_error (cache, msg);
+    sqlite3_free (msg);
+  end:
+    free (code);
+    if (stmt != NULL)
+	sqlite3_finalize (stmt);
+    return ok;
+}
+
+static int
+do_find_first_upd_arc (struct upd_context *ctx, int index)
+{
+/* searching the first updated Link starting from some Node; -1 if none */
+    int lo = 0;
+    int hi = ctx->n_arcs;
+    while (lo < hi)
+      {
+	  int mid = lo + ((hi - lo) / 2);
+	  if (ctx->arcs[mid].index_from < index)
+	      lo = mid + 1;
+	  else
+	      hi = mid;
+      }
+    if (lo < ctx->n_arcs && ctx->arcs[lo].index_from == index)
+	return lo;
+    return -1;
+}
+
+static unsigned char *
+do_rewrite_upd_block (struct upd_context *ctx, const unsigned char *blob,
+		      int size, int *out_size)
+{
+/* rewriting an ordinary Block, replacing all the updated Links */
+    const unsigned char *in = blob + 3;
+    const unsigned char *end = blob + size;
+    int node_size = do_upd_node_header_size (ctx);
+    unsigned char *buf;
+    unsigned char *out;
+    struct upd_out_arc *arcs = NULL;
+    int max_arcs = 0;
+    int nodes;
+    int i;
+    int ia;
+
+    buf = malloc (size + (ctx->n_arcs * 22));
+    if (buf == NULL)
+	return NULL;
+    out = buf;
+    nodes = gaiaImport16 (blob + 1, 1, ctx->endian_arch);
+    memcpy (out, blob, 3);
+    out += 3;
+    for (i = 0; i < nodes; i++)
+      {
+	  int index;
+	  int links;
+	  int count = 0;
+	  int first;
+	  if (end - in < node_size || *in != GAIA_NET_NODE)
+	      goto error;
+	  index = gaiaImport32 (in + 1, 1, ctx->endian_arch);
+	  links = gaiaImport16 (in + node_size - 2, 1, ctx->endian_arch);
+	  if (links < 0 || end - in < node_size + (links * 22) + 1)
+	      goto error;
+	  if (links + ctx->n_arcs > max_arcs)
+	    {
+		struct upd_out_arc *new_arcs;
+		max_arcs = links + ctx->n_arcs;
+		new_arcs = realloc (arcs, sizeof (struct upd_out_arc) * max_arcs);
+		if (new_arcs == NULL)
+		    goto error;
+		arcs = new_arcs;
+	    }
+	  /* copying the Node itself */
+	  memcpy (out, in, node_size - 2);
+	  out += node_size - 2;
+	  in += node_size;
+	  /* preserving all Links not affected by the update */
+	  for (ia = 0; ia < links; ia++)
+	    {
+		sqlite3_int64 rowid = gaiaImportI64 (in + 1, 1,
+						     ctx->endian_arch);
+		if (bsearch
+		    (&rowid, ctx->rowids, ctx->n_rowids,
+		     sizeof (sqlite3_int64), cmp_upd_rowids) == NULL)
+		  {
+		      arcs[count].rowid = rowid;
+		      arcs[count].index_to =
+			  gaiaImport32 (in + 9, 1, ctx->endian_arch);
+		      arcs[count].cost =
+			  gaiaImport64 (in + 13, 1, ctx->endian_arch);
+		      count++;
+		  }
+		in += 22;
+	    }
+	  if (*in++ != GAIA_NET_END)
+	      goto error;
+	  /* adding all the updated Links starting from this Node */
+	  first = do_find_first_upd_arc (ctx, index);
+	  if (first >= 0)
+	    {
+		for (ia = first;
+		     ia < ctx->n_arcs && ctx->arcs[ia].index_from == index;
+		     ia++)
+		  {
+		      arcs[count].rowid = ctx->arcs[ia].rowid;
+		      arcs[count].index_to = ctx->arcs[ia].index_to;
+		      arcs[count].cost = ctx->arcs[ia].cost;
+		      count++;
+		  }
+	    }
+	  if (count > 32767)
+	      goto error;
+	  qsort (arcs, count, sizeof (struct upd_out_arc), cmp_upd_out_arcs);
+	  gaiaExport16 (out, count, 1, ctx->endian_arch);	/* # of outcoming arcs */
+	  out += 2;
+	  for (ia = 0; ia < count; ia++)
+	    {
+		*out++ = GAIA_NET_ARC;
+		gaiaExportI64 (out, arcs[ia].rowid, 1, ctx->endian_arch);	/* the Arc rowid */
+		out += 8;
+		gaiaExport32 (out, arcs[ia].index_to, 1, ctx->endian_arch);	/* the ToNode internal index */
+		out += 4;
+		gaiaExport64 (out, arcs[ia].cost, 1, ctx->endian_arch);	/* the Arc Cost */
+		out += 8;
+		*out++ = GAIA_NET_END;
+	    }
+	  *out++ = GAIA_NET_END;
+      }
+    if (arcs != NULL)
+	free (arcs);
+    *out_size = out - buf;
+    return buf;
+
+  error:
+    if (arcs != NULL)
+	free (arcs);
+    free (buf);
+    return NULL;
+}
+
+static int
+do_write_upd_row (sqlite3 * db_handle, const void *cache,
+		  const char *routing_data_table, sqlite3_int64 id,
+		  const unsigned char *blob, int size)
+{
+/* inserting or replacing a single row into the Routing Data table */
+    char *sql;
+    char *xtable;
+    int ret;
+    sqlite3_stmt *stmt;
+    xtable = gaiaDoubleQuotedSql (routing_data_table);
+    sql =
+	sqlite3_mprintf
+	("INSERT OR REPLACE INTO \"%s\" (Id, NetworkData) VALUES (?, ?)",
+	 xtable);
+    free (xtable);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    sqlite3_bind_int64 (stmt, 1, id);
+    sqlite3_bind_blob (stmt, 2, blob, size, SQLITE_STATIC);
+    ret = sqlite3_step (stmt);
+    sqlite3_finalize (stmt);
+    if (ret == SQLITE_DONE || ret == SQLITE_ROW)
+	return 1;
+  sql_error:
+    {
+	char *msg =
+	    sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	gaia_create_routing_set_error (cache, msg);
+	sqlite3_free (msg);
+    }
+    return 0;
+}
+
+static int
+do_update_generation (sqlite3 * db_handle, const void *cache,
+		      const char *routing_data_table, struct upd_context *ctx)
+{
+/* bumping the Generation and updating the Log of all modified Blocks */
+    char *sql;
+    char *xtable;
+    int ret;
+    int i;
+    int ok = 0;
+    sqlite3_stmt *stmt = NULL;
+    sqlite3_int64 generation = 0;
+    sqlite3_int64 *log = NULL;	/* pairs of Block Id and Generation */
+    int n_log = 0;
+    int n;
+    unsigned char *buf = NULL;
+    unsigned char *out;
+
+    xtable = gaiaDoubleQuotedSql (routing_data_table);
+    sql =
+	sqlite3_mprintf ("SELECT Id, NetworkData FROM \"%s\" WHERE Id IN (%d, %d)",
+			 xtable, GAIA_NET_UPDATE_STAMP_ID, GAIA_NET_UPDATE_LOG_ID);
+    free (xtable);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    while (1)
+      {
+	  const unsigned char *blob;
+	  int size;
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;
+	  if (ret != SQLITE_ROW)
+	      goto sql_error;
+	  if (sqlite3_column_type (stmt, 1) != SQLITE_BLOB)
+	      continue;
+	  blob = sqlite3_column_blob (stmt, 1);
+	  size = sqlite3_column_bytes (stmt, 1);
+	  if (size < 10 || *blob != GAIA_NET_UPDATE_BLOCK)
+	      continue;
+	  if (sqlite3_column_int64 (stmt, 0) == GAIA_NET_UPDATE_STAMP_ID)
+	      generation = gaiaImportI64 (blob + 1, 1, ctx->endian_arch);
+	  else
+	    {
+		n = gaiaImport32 (blob + 1, 1, ctx->endian_arch);
+		if (n < 0 || size < 6 + (n * 16))
+		    continue;
+		log = malloc (sizeof (sqlite3_int64) * 2 * (n + ctx->n_dirty));
+		if (log == NULL)
+		    goto no_memory;
+		for (i = 0; i < n; i++)
+		  {
+		      log[i * 2] =
+			  gaiaImportI64 (blob + 5 + (i * 16), 1,
+					 ctx->endian_arch);
+		      log[(i * 2) + 1] =
+			  gaiaImportI64 (blob + 13 + (i * 16), 1,
+					 ctx->endian_arch);
+		  }
+		n_log = n;
+	    }
+      }
+    sqlite3_finalize (stmt);
+    stmt = NULL;
+    generation++;
+    if (log == NULL)
+      {
+	  log = malloc (sizeof (sqlite3_int64) * 2 * (ctx->n_dirty + 1));
+	  if (log == NULL)
+	      goto no_memory;
+      }
+
+/* merging the Block Ids modified by this update */
+    for (i = 0; i < ctx->n_dirty; i++)
+      {
+	  log[n_log * 2] = ctx->dirty[i];
+	  log[(n_log * 2) + 1] = generation;
+	  n_log++;
+      }
+    qsort (log, n_log, sizeof (sqlite3_int64) * 2, cmp_upd_rowids);
+    n = 0;
+    for (i = 0; i < n_log; i++)
+      {
+	  if (n > 0 && log[(n - 1) * 2] == log[i * 2])
+	    {
+		/* the same Block: retaining the most recent Generation */
+		if (log[(i * 2) + 1] > log[((n - 1) * 2) + 1])
+		    log[((n - 1) * 2) + 1] = log[(i * 2) + 1];
+		continue;
+	    }
+	  log[n * 2] = log[i * 2];
+	  log[(n * 2) + 1] = log[(i * 2) + 1];
+	  n++;
+      }
+    n_log = n;
+
+/* writing the Log */
+    buf = malloc (6 + (n_log * 16));
+    if (buf == NULL)
+	goto no_memory;
+    out = buf;
+    *out++ = GAIA_NET_UPDATE_BLOCK;
+    gaiaExport32 (out, n_log, 1, ctx->endian_arch);	/* # of modified Blocks */
+    out += 4;
+    for (i = 0; i < n_log; i++)
+      {
+	  gaiaExportI64 (out, log[i * 2], 1, ctx->endian_arch);	/* the Block Id */
+	  out += 8;
+	  gaiaExportI64 (out, log[(i * 2) + 1], 1, ctx->endian_arch);	/* the Generation */
+	  out += 8;
+      }
+    *out++ = GAIA_NET_END;
+    if (!do_write_upd_row
+	(db_handle, cache, routing_data_table, GAIA_NET_UPDATE_LOG_ID, buf,
+	 out - buf))
+	goto end;
+
+/* writing the Generation */
+    out = buf;
+    *out++ = GAIA_NET_UPDATE_BLOCK;
+    gaiaExportI64 (out, generation, 1, ctx->endian_arch);	/* the current Generation */
+    out += 8;
+    *out++ = GAIA_NET_END;
+    if (!do_write_upd_row
+	(db_handle, cache, routing_data_table, GAIA_NET_UPDATE_STAMP_ID, buf,
+	 out - buf))
+	goto end;
+    ok = 1;
+    goto end;
+
+  no_memory:
+    gaia_create_routing_set_error (cache, "insufficient memory");
+    goto end;
+  sql_error:
+    {
+	char *msg =
+	    sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	gaia_create_routing_set_error (cache, msg);
+	sqlite3_free (msg);
+    }
+  end:
+    if (stmt != NULL)
+	sqlite3_finalize (stmt);
+    if (log != NULL)
+	free (log);
+    if (buf != NULL)
+	free (buf);
+    return ok;
+}
+
+static int
+do_apply_upd_blocks (sqlite3 * db_handle, const void *cache,
+		     const char *routing_data_table, struct upd_context *ctx)
+{
+/* rewriting all the dirty Blocks and discarding all the CH Blocks */
+    char *sql;
+    char *xtable;
+    int ret;
+    int i;
+    int ok = 0;
+    sqlite3_stmt *stmt_in = NULL;
+    sqlite3_stmt *stmt_out = NULL;
+    sqlite3_stmt *stmt_del = NULL;
+
+    xtable = gaiaDoubleQuotedSql (routing_data_table);
+    sql =
+	sqlite3_mprintf ("SELECT NetworkData FROM \"%s\" WHERE Id = ?", xtable);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt_in, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    sql =
+	sqlite3_mprintf ("UPDATE \"%s\" SET NetworkData = ? WHERE Id = ?",
+			 xtable);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt_out, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    sql = sqlite3_mprintf ("DELETE FROM \"%s\" WHERE Id = ?", xtable);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt_del, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+
+    for (i = 0; i < ctx->n_dirty; i++)
+      {
+	  unsigned char *buf;
+	  int size;
+	  sqlite3_reset (stmt_in);
+	  sqlite3_clear_bindings (stmt_in);
+	  sqlite3_bind_int64 (stmt_in, 1, ctx->dirty[i]);
+	  ret = sqlite3_step (stmt_in);
+	  if (ret != SQLITE_ROW)
+	      goto sql_error;
+	  buf =
+	      do_rewrite_upd_block (ctx, sqlite3_column_blob (stmt_in, 0),
+				    sqlite3_column_bytes (stmt_in, 0), &size);
+	  if (buf == NULL)
+	    {
+		char *msg = sqlite3_mprintf ("unable to rewrite Block %lld",
+					     ctx->dirty[i]);
+		gaia_create_routing_set_error (cache, msg);
+		sqlite3_free (msg);
+		goto end;
+	    }
+	  sqlite3_reset (stmt_out);
+	  sqlite3_clear_bindings (stmt_out);
+	  sqlite3_bind_blob (stmt_out, 1, buf, size, free);
+	  sqlite3_bind_int64 (stmt_out, 2, ctx->dirty[i]);
+	  ret = sqlite3_step (stmt_out);
+	  if (ret != SQLITE_DONE && ret != SQLITE_ROW)
+	      goto sql_error;
+      }
+    for (i = 0; i < ctx->n_ch_blocks; i++)
+      {
+	  sqlite3_reset (stmt_del);
+	  sqlite3_clear_bindings (stmt_del);
+	  sqlite3_bind_int64 (stmt_del, 1, ctx->ch_blocks[i]);
+	  ret = sqlite3_step (stmt_del);
+	  if (ret != SQLITE_DONE && ret != SQLITE_ROW)
+	      goto sql_error;
+      }
+    ok = 1;
+    goto end;
+
+  sql_error:
+    {
+	char *msg =
+	    sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	gaia_create_routing_set_error (cache, msg);
+	sqlite3_free (msg);
+    }
+  end:
+    free (xtable);
+    if (stmt_in != NULL)
+	sqlite3_finalize (stmt_in);
+    if (stmt_out != NULL)
+	sqlite3_finalize (stmt_out);
+    if (stmt_del != NULL)
+	sqlite3_finalize (stmt_del);
+    return ok;
+}
+
+static int
+do_update_a_star_coeff (sqlite3 * db_handle, const void *cache,
+			const char *routing_data_table,
+			struct upd_context *ctx)
+{
+/* lowering the A* Heuristic Coeff, so to keep it admissible */
+    char *sql;
+    char *xtable;
+    int ret;
+    int ok = 0;
+    sqlite3_stmt *stmt = NULL;
+    unsigned char *buf;
+    int size;
+
+    xtable = gaiaDoubleQuotedSql (routing_data_table);
+    sql =
+	sqlite3_mprintf ("SELECT NetworkData FROM \"%s\" WHERE Id = 0", xtable);
+    free (xtable);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    ret = sqlite3_step (stmt);
+    if (ret != SQLITE_ROW)
+	goto sql_error;
+/* the A* Coeff is always the last item before the END marker */
+    size = sqlite3_column_bytes (stmt, 0);
+    buf = malloc (size);
+    memcpy (buf, sqlite3_column_blob (stmt, 0), size);
+    sqlite3_finalize (stmt);
+    stmt = NULL;
+    gaiaExport64 (buf + size - 9, ctx->a_star_coeff, 1, ctx->endian_arch);
+    ok = do_write_upd_row (db_handle, cache, routing_data_table, 0, buf,
+			   size);
+    free (buf);
+    return ok;
+
+  sql_error:
+    {
+	char *msg =
+	    sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	gaia_create_routing_set_error (cache, msg);
+	sqlite3_free (msg);
+    }
+    if (stmt != NULL)
+	sqlite3_finalize (stmt);
+    return 0;
+}
+
+SPATIALITE_DECLARE int
+gaia_create_routing_nodes (sqlite3 * db_handle,
+			   const void *cache,
+			   const char *db_prefix,
+			   const char *table,
+			   const char *geom_column,
+			   const char *from_column, const char *to_column)
+{
+/* attempting to create a Routing Nodes columns for a spatial table */
+    const char *sql;
+    int ret;
+    char *geom_name = NULL;
+
+    if (db_handle == NULL || cache == NULL)
 	return 0;
 
     if (table == NULL)
@@ -3092,6 +5485,35 @@ gaia_create_routing (sqlite3 * db_handle,
 		     const char *oneway_to, int overwrite)
 {
 /* attempting to create a VirtualRouting from an input table */
+    return gaia_create_routing_ex (db_handle, cache, routing_data_table,
+				   virtual_routing_table, input_table,
+				   from_column, to_column, geom_column,
+				   cost_column, name_column, a_star_enabled,
+				   bidirectional, oneway_from, oneway_to,
+				   overwrite, 0);
+}
+
+SPATIALITE_DECLARE int
+gaia_create_routing_ex (sqlite3 * db_handle,
+			const void *cache,
+			const char *routing_data_table,
+			const char
+			*virtual_routing_table,
+			const char *input_table,
+			const char *from_column,
+			const char *to_column,
+			const char *geom_column,
+			const char *cost_column,
+			const char *name_column,
+			int a_star_enabled,
+			int bidirectional,
+			const char *oneway_from,
+			const char *oneway_to, int overwrite, int ch_enabled)
+{
+/* 
+/ attempting to create a VirtualRouting from an input table
+/ (optionally supporting Contraction Hierarchies)
+*/
     int has_ids;
     int n_nodes = 0;
     int max_code_length = 0;
@@ -3213,7 +5635,7 @@ gaia_create_routing (sqlite3 * db_handle,
     if (!do_create_data
 	(db_handle, cache, routing_data_table, input_table, from_column,
 	 to_column, geom_column, name_column, a_star_enabled, a_star_coeff,
-	 has_ids, n_nodes, max_code_length))
+	 ch_enabled, has_ids, n_nodes, max_code_length))
 	return 0;
 
 /* creating the VirtualRouting table */
@@ -3223,3 +5645,284 @@ gaia_create_routing (sqlite3 * db_handle,
 
     return 1;
 }
+
+SPATIALITE_DECLARE int
+gaia_create_routing_turns (sqlite3 * db_handle, const void *cache,
+			   const char *routing_data_table,
+			   const char *input_table,
+			   const char *from_link_column,
+			   const char *to_link_column, const char *cost_column)
+{
+/* attempting to store Turn penalties/restrictions into a Routing Data table */
+    const char *columns[3];
+    int ret;
+
+    if (db_handle == NULL || cache == NULL)
+	return 0;
+
+    gaia_create_routing_set_error (cache, NULL);
+    if (routing_data_table == NULL)
+      {
+	  gaia_create_routing_set_error (cache,
+					 "Routing Data Table Name is NULL");
+	  return 0;
+      }
+    if (input_table == NULL)
+      {
+	  gaia_create_routing_set_error (cache, "Input Table Name is NULL");
+	  return 0;
+      }
+    if (from_link_column == NULL)
+      {
+	  gaia_create_routing_set_error (cache, "FromLink Column Name is NULL");
+	  return 0;
+      }
+    if (to_link_column == NULL)
+      {
+	  gaia_create_routing_set_error (cache, "ToLink Column Name is NULL");
+	  return 0;
+      }
+    columns[0] = from_link_column;
+    columns[1] = to_link_column;
+    columns[2] = cost_column;
+    if (!do_check_extra_columns (db_handle, cache, input_table, columns, 3))
+	return 0;
+
+/* setting a global Savepoint */
+    ret =
+	sqlite3_exec (db_handle, "SAVEPOINT create_routing_turns", NULL, NULL,
+		      NULL);
+    if (ret != SQLITE_OK)
+      {
+	  char *msg =
+	      sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+	  return 0;
+      }
+    ret =
+	do_create_turns_data (db_handle, cache, routing_data_table,
+			      input_table, from_link_column, to_link_column,
+			      cost_column);
+    return do_end_extra_blocks (db_handle, cache, "create_routing_turns", ret);
+}
+
+SPATIALITE_DECLARE int
+gaia_create_routing_profiles (sqlite3 * db_handle, const void *cache,
+			      const char *routing_data_table,
+			      const char *input_table,
+			      const char *link_column,
+			      const char *time_column, const char *cost_column)
+{
+/* attempting to store Time Dependent profiles into a Routing Data table */
+    const char *columns[3];
+    int ret;
+
+    if (db_handle == NULL || cache == NULL)
+	return 0;
+
+    gaia_create_routing_set_error (cache, NULL);
+    if (routing_data_table == NULL)
+      {
+	  gaia_create_routing_set_error (cache,
+					 "Routing Data Table Name is NULL");
+	  return 0;
+      }
+    if (input_table == NULL)
+      {
+	  gaia_create_routing_set_error (cache, "Input Table Name is NULL");
+	  return 0;
+      }
+    if (link_column == NULL)
+      {
+	  gaia_create_routing_set_error (cache, "Link Column Name is NULL");
+	  return 0;
+      }
+    if (time_column == NULL)
+      {
+	  gaia_create_routing_set_error (cache, "Time Column Name is NULL");
+	  return 0;
+      }
+    if (cost_column == NULL)
+      {
+	  gaia_create_routing_set_error (cache, "Cost Column Name is NULL");
+	  return 0;
+      }
+    columns[0] = link_column;
+    columns[1] = time_column;
+    columns[2] = cost_column;
+    if (!do_check_extra_columns (db_handle, cache, input_table, columns, 3))
+	return 0;
+
+/* setting a global Savepoint */
+    ret =
+	sqlite3_exec (db_handle, "SAVEPOINT create_routing_profiles", NULL,
+		      NULL, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  char *msg =
+	      sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+	  return 0;
+      }
+    ret =
+	do_create_profiles_data (db_handle, cache, routing_data_table,
+				 input_table, link_column, time_column,
+				 cost_column);
+    return do_end_extra_blocks (db_handle, cache, "create_routing_profiles",
+				ret);
+}
+
+SPATIALITE_DECLARE int
+gaia_create_routing_update_links (sqlite3 * db_handle, const void *cache,
+				  const char *routing_data_table,
+				  const sqlite3_int64 * link_rowids,
+				  int count, const char *cost_column,
+				  int bidirectional, const char *oneway_from,
+				  const char *oneway_to)
+{
+/*
+/ attempting to incrementally update some Links of an already
+/ existing Routing Data table
+*/
+    struct upd_context ctx;
+    char *sql;
+    char *xtable;
+    int ret;
+    int i;
+    int ok = 0;
+    sqlite3_stmt *stmt;
+
+    if (db_handle == NULL || cache == NULL)
+	return 0;
+
+    gaia_create_routing_set_error (cache, NULL);
+    if (routing_data_table == NULL)
+      {
+	  gaia_create_routing_set_error (cache,
+					 "Routing Data Table Name is NULL");
+	  return 0;
+      }
+    if (link_rowids == NULL || count <= 0)
+      {
+	  gaia_create_routing_set_error (cache, "empty list of Link ROWIDs");
+	  return 0;
+      }
+    if (oneway_from == NULL && oneway_to != NULL)
+      {
+	  gaia_create_routing_set_error (cache,
+					 "OnewayFromTo is NULL but OnewayToFrom is NOT NULL");
+	  return 0;
+      }
+    if (oneway_from != NULL && oneway_to == NULL)
+      {
+	  gaia_create_routing_set_error (cache,
+					 "OnewayFromTo is NOT NULL but OnewayToFrom is NULL");
+	  return 0;
+      }
+    if (oneway_from != NULL && oneway_to != NULL && !bidirectional)
+      {
+	  gaia_create_routing_set_error (cache,
+					 "Both OnewayFromTo and OnewayToFrom are NOT NULL but Unidirectional has been specified");
+	  return 0;
+      }
+    if (!do_check_data_table (db_handle, routing_data_table))
+      {
+	  char *msg =
+	      sqlite3_mprintf ("Routing Data Table \"%s\" does not exist",
+			       routing_data_table);
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+	  return 0;
+      }
+
+    memset (&ctx, 0, sizeof (struct upd_context));
+    ctx.endian_arch = gaiaEndianArch ();
+
+/* parsing the HEADER block */
+    xtable = gaiaDoubleQuotedSql (routing_data_table);
+    sql =
+	sqlite3_mprintf ("SELECT NetworkData FROM \"%s\" WHERE Id = 0", xtable);
+    free (xtable);
+    ret = sqlite3_prepare_v2 (db_handle, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  char *msg =
+	      sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+	  return 0;
+      }
+    ret = sqlite3_step (stmt);
+    if (ret != SQLITE_ROW || sqlite3_column_type (stmt, 0) != SQLITE_BLOB
+	|| !do_parse_header (sqlite3_column_blob (stmt, 0),
+			     sqlite3_column_bytes (stmt, 0), ctx.endian_arch,
+			     &(ctx.hdr)))
+      {
+	  char *msg =
+	      sqlite3_mprintf
+	      ("Routing Data Table \"%s\": invalid or unsupported header",
+	       routing_data_table);
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+	  sqlite3_finalize (stmt);
+	  goto end;
+      }
+    sqlite3_finalize (stmt);
+
+/* sorting the Link ROWIDs */
+    ctx.rowids = malloc (sizeof (sqlite3_int64) * count);
+    if (ctx.rowids == NULL)
+      {
+	  gaia_create_routing_set_error (cache, "insufficient memory");
+	  goto end;
+      }
+    memcpy (ctx.rowids, link_rowids, sizeof (sqlite3_int64) * count);
+    qsort (ctx.rowids, count, sizeof (sqlite3_int64), cmp_upd_rowids);
+    for (i = 0; i < count; i++)
+      {
+	  if (ctx.n_rowids > 0
+	      && ctx.rowids[ctx.n_rowids - 1] == ctx.rowids[i])
+	      continue;
+	  ctx.rowids[ctx.n_rowids++] = ctx.rowids[i];
+      }
+
+/* reading the updated Links and locating the affected Blocks */
+    if (!do_fetch_upd_links
+	(db_handle, cache, &ctx, cost_column, bidirectional, oneway_from,
+	 oneway_to))
+	goto end;
+    if (!do_prepare_upd_keys (&ctx))
+      {
+	  gaia_create_routing_set_error (cache, "insufficient memory");
+	  goto end;
+      }
+    if (!do_scan_upd_blocks (db_handle, cache, routing_data_table, &ctx))
+	goto end;
+
+/* setting a global Savepoint */
+    ret =
+	sqlite3_exec (db_handle, "SAVEPOINT create_routing_update", NULL,
+		      NULL, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  char *msg =
+	      sqlite3_mprintf ("SQL error: %s", sqlite3_errmsg (db_handle));
+	  gaia_create_routing_set_error (cache, msg);
+	  sqlite3_free (msg);
+	  goto end;
+      }
+    ret = do_apply_upd_blocks (db_handle, cache, routing_data_table, &ctx);
+    if (ret && ctx.hdr.a_star && ctx.a_star_coeff < ctx.hdr.a_star_coeff)
+	ret =
+	    do_update_a_star_coeff (db_handle, cache, routing_data_table, &ctx);
+    if (ret)
+	ret = do_update_generation (db_handle, cache, routing_data_table, &ctx);
+    ok = do_end_extra_blocks (db_handle, cache, "create_routing_update", ret);
+
+  end:
+    do_free_upd_context (&ctx);
+    return ok;
+}
@@ -49,6 +49,19 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <string.h>
 #include <float.h>
 
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #if defined(_WIN32) && !defined(__MINGW32__)
 #include "config-msvc.h"
 #else
@@ -64,6 +77,7 @@ the terms of any one of the MPL, the GPL or the LGPL.
 
 #ifdef _WIN32
 #define strcasecmp	_stricmp
+#define strncasecmp	_strnicmp
 #endif /* not WIN32 */
 
 #if defined(_WIN32) && !defined(__MINGW32__)
@@ -83,27 +97,27 @@ memory structs used to store the MBR's cache
 the basic idea is to implement a hierarchy in order to avoid
 excessive memory fragmentation and achieve better performance
 
-- the cache is a linked-list of cache page elements
+- the cache is an array of cache page elements
   - each cache page contains an array of 32 cache blocks
-    - each cache block contains an array of 32 cache cells
+    - each cache block contains 32 cache cells
 so a single cache page con store up to 1024 cache cells
 
-*/
+both cache blocks and cache pages are stored as "structure of
+arrays" (separate MinX, MinY, MaxX and MaxY arrays), so that a
+whole block can be tested against the search frame using SIMD
+comparisons; a cache page never contains pointers, so it can be
+saved on a sidecar file and later memory-mapped as it is
+
+a sidecar file is only valid for the "generation" of the main table
+it was saved for; the generation is a counter maintained by triggers
+on the main table, incremented by any INSERT, DELETE or UPDATE
+changing the ROWID or the Geometry
 
-struct mbr_cache_cell
-{
-/* 
-a  cached entity 
 */
 
-/* the entity's ROWID */
-    sqlite3_int64 rowid;
-/* the MBR */
-    double minx;
-    double miny;
-    double maxx;
-    double maxy;
-};
+#define MBR_CACHE_MAGIC		"SPLMBRC2"
+#define MBR_CACHE_ENDIAN	0x01020304
+#define MBR_CACHE_HEADER	4096
 
 struct mbr_cache_block
 {
@@ -111,22 +125,18 @@ struct mbr_cache_block
 a block of 32 cached entities
 */
 
-/* 
+/*
 allocation bitmap: the meaning of each bit is:
 1 - corresponding cache cell is in use
 0 - corresponding cache cell is unused
 */
     unsigned int bitmap;
-/* 
-the MBR corresponding to this cache block 
-i.e. the combined MBR for any contained cell
-*/
-    double minx;
-    double miny;
-    double maxx;
-    double maxy;
-/* the cache cells array */
-    struct mbr_cache_cell cells[32];
+/* the cached entities: ROWIDs and MBRs */
+    sqlite3_int64 rowid[32];
+    double minx[32];
+    double miny[32];
+    double maxx[32];
+    double maxy[32];
 };
 
 struct mbr_cache_page
@@ -135,13 +145,13 @@ struct mbr_cache_page
 a page containing 32 cached blocks
 */
 
-/* 
+/*
 allocation bitmap: the meaning of each bit is:
 1 - corresponding cache block is in full
 0 - corresponding cache block is not full
 */
     unsigned int bitmap;
-/* 
+/*
 the MBR corresponding to this cache page
 i.e. the combined MBR for any contained block
 */
@@ -149,29 +159,60 @@ i.e. the combined MBR for any contained block
     double miny;
     double maxx;
     double maxy;
-/* the cache blocks array */
-    struct mbr_cache_block blocks[32];
 /* the min-max rowid for this page */
     sqlite3_int64 min_rowid;
     sqlite3_int64 max_rowid;
-/* pointer to next element into the cached pages linked list */
-    struct mbr_cache_page *next;
+/*
+the MBRs corresponding to each cache block
+i.e. the combined MBR for any contained cell
+*/
+    double block_minx[32];
+    double block_miny[32];
+    double block_maxx[32];
+    double block_maxy[32];
+/* the cache blocks array */
+    struct mbr_cache_block blocks[32];
+};
+
+struct mbr_cache_file_header
+{
+/* the header of a sidecar file storing a cache */
+    char magic[8];
+    unsigned int endian;
+    unsigned int page_size;
+    int n_pages;
+    int table_len;
+    int column_len;
+    int reserved;
+    sqlite3_int64 generation;
+/* followed by the table and column names (no terminator) */
 };
 
 struct mbr_cache
 {
 /*
 the MBR's cache
-implemented as a cache pages linked list
+implemented as an array of cache pages
 */
-
-/* pointers used to handle the cache pages linked list */
-    struct mbr_cache_page *first;
-    struct mbr_cache_page *last;
+    struct mbr_cache_page **pages;
+    int n_pages;
+    int max_pages;
 /*
- pointer used to identify the current cache page when inserting a new cache cell
+ index used to identify the current cache page when inserting a new cache cell
  */
-    struct mbr_cache_page *current;
+    int current;
+/* the memory mapped sidecar file (if any) */
+    unsigned char *mapping;
+    size_t mapping_size;
+    int n_mapped;		/* the first N pages live into the mapping */
+/* the main table generation this cache corresponds to */
+    sqlite3_int64 generation;
+/* changes applied through the virtual table since then */
+    sqlite3_int64 n_changes;
+/* set when the cache has been changed since it was last saved */
+    int dirty;
+/* set when the cache no longer matches any committed generation */
+    int stale;
 };
 
 typedef struct MbrCacheStruct
@@ -182,8 +223,10 @@ typedef struct MbrCacheStruct
     char *zErrMsg;		/* error message: USE INTERNALLY BY SQLITE */
     sqlite3 *db;		/* the sqlite db holding the virtual table */
     struct mbr_cache *cache;	/* the  MBR's cache */
+    char *vtable_name;		/* the virtual table itself */
     char *table_name;		/* the main table to be cached */
     char *column_name;		/* the column to be cached */
+    char *sidecar_path;		/* the sidecar file (may be NULL) */
     int error;			/* some previous error disables any operation */
 } MbrCache;
 typedef MbrCache *MbrCachePtr;
@@ -193,14 +236,14 @@ typedef struct MbrCacheCursortStruct
 /* extends the sqlite3_vtab_cursor struct */
     MbrCachePtr pVtab;		/* Virtual table of this cursor */
     int eof;			/* the EOF marker */
-/* 
-positioning parameters while performing a cache search 
+/*
+positioning parameters while performing a cache search
 */
-    struct mbr_cache_page *current_page;
+    int current_page;
     int current_block_index;
     int current_cell_index;
-    struct mbr_cache_cell *current_cell;
-/* 
+    struct mbr_cache_block *current_block;
+/*
 the strategy to use:
     0 = sequential scan
     1 = find rowid
@@ -225,74 +268,129 @@ static unsigned int
 cache_bitmask (int x)
 {
 /* return the bitmask corresponding to index X */
-    switch (x)
+    if (x < 0 || x > 31)
+	return 0x00000000;
+    return 0x80000000 >> x;
+}
+
+static unsigned int
+cache_scan_mbrs (const double *minx, const double *miny, const double *maxx,
+		 const double *maxy, double x1, double y1, double x2,
+		 double y2, int within)
+{
+/*
+tests 32 MBRs at once, returning the bitmap of the matching ones
+
+within = 0: MinX <= x1 && MinY <= y1 && MaxX >= x2 && MaxY >= y2
+within = 1: MinX >= x1 && MinY >= y1 && MaxX <= x2 && MaxY <= y2
+*/
+    unsigned int mask = 0x00000000;
+    int i;
+#if defined(__AVX__)
+    __m256d vx1 = _mm256_set1_pd (x1);
+    __m256d vy1 = _mm256_set1_pd (y1);
+    __m256d vx2 = _mm256_set1_pd (x2);
+    __m256d vy2 = _mm256_set1_pd (y2);
+    for (i = 0; i < 32; i += 4)
       {
-      case 0:
-	  return 0x80000000;
-      case 1:
-	  return 0x40000000;
-      case 2:
-	  return 0x20000000;
-      case 3:
-	  return 0x10000000;
-      case 4:
-	  return 0x08000000;
-      case 5:
-	  return 0x04000000;
-      case 6:
-	  return 0x02000000;
-      case 7:
-	  return 0x01000000;
-      case 8:
-	  return 0x00800000;
-      case 9:
-	  return 0x00400000;
-      case 10:
-	  return 0x00200000;
-      case 11:
-	  return 0x00100000;
-      case 12:
-	  return 0x00080000;
-      case 13:
-	  return 0x00040000;
-      case 14:
-	  return 0x00020000;
-      case 15:
-	  return 0x00010000;
-      case 16:
-	  return 0x00008000;
-      case 17:
-	  return 0x00004000;
-      case 18:
-	  return 0x00002000;
-      case 19:
-	  return 0x00001000;
-      case 20:
-	  return 0x00000800;
-      case 21:
-	  return 0x00000400;
-      case 22:
-	  return 0x00000200;
-      case 23:
-	  return 0x00000100;
-      case 24:
-	  return 0x00000080;
-      case 25:
-	  return 0x00000040;
-      case 26:
-	  return 0x00000020;
-      case 27:
-	  return 0x00000010;
-      case 28:
-	  return 0x00000008;
-      case 29:
-	  return 0x00000004;
-      case 30:
-	  return 0x00000002;
-      case 31:
-	  return 0x00000001;
-      };
-    return 0x00000000;
+	  __m256d r;
+	  unsigned int bits;
+	  if (within)
+	    {
+		r = _mm256_and_pd (_mm256_cmp_pd
+				   (_mm256_loadu_pd (minx + i), vx1,
+				    _CMP_GE_OQ),
+				   _mm256_cmp_pd (_mm256_loadu_pd (miny + i),
+						  vy1, _CMP_GE_OQ));
+		r = _mm256_and_pd (r,
+				   _mm256_cmp_pd (_mm256_loadu_pd (maxx + i),
+						  vx2, _CMP_LE_OQ));
+		r = _mm256_and_pd (r,
+				   _mm256_cmp_pd (_mm256_loadu_pd (maxy + i),
+						  vy2, _CMP_LE_OQ));
+	    }
+	  else
+	    {
+		r = _mm256_and_pd (_mm256_cmp_pd
+				   (_mm256_loadu_pd (minx + i), vx1,
+				    _CMP_LE_OQ),
+				   _mm256_cmp_pd (_mm256_loadu_pd (miny + i),
+						  vy1, _CMP_LE_OQ));
+		r = _mm256_and_pd (r,
+				   _mm256_cmp_pd (_mm256_loadu_pd (maxx + i),
+						  vx2, _CMP_GE_OQ));
+		r = _mm256_and_pd (r,
+				   _mm256_cmp_pd (_mm256_loadu_pd (maxy + i),
+						  vy2, _CMP_GE_OQ));
+	    }
+	  bits = (unsigned int) _mm256_movemask_pd (r);
+	  if (bits & 0x01)
+	      mask |= cache_bitmask (i);
+	  if (bits & 0x02)
+	      mask |= cache_bitmask (i + 1);
+	  if (bits & 0x04)
+	      mask |= cache_bitmask (i + 2);
+	  if (bits & 0x08)
+	      mask |= cache_bitmask (i + 3);
+      }
+#elif defined(__SSE2__)
+    __m128d vx1 = _mm_set1_pd (x1);
+    __m128d vy1 = _mm_set1_pd (y1);
+    __m128d vx2 = _mm_set1_pd (x2);
+    __m128d vy2 = _mm_set1_pd (y2);
+    for (i = 0; i < 32; i += 2)
+      {
+	  __m128d r;
+	  unsigned int bits;
+	  if (within)
+	    {
+		r = _mm_and_pd (_mm_cmpge_pd (_mm_loadu_pd (minx + i), vx1),
+				_mm_cmpge_pd (_mm_loadu_pd (miny + i), vy1));
+		r = _mm_and_pd (r,
+				_mm_cmple_pd (_mm_loadu_pd (maxx + i), vx2));
+		r = _mm_and_pd (r,
+				_mm_cmple_pd (_mm_loadu_pd (maxy + i), vy2));
+	    }
+	  else
+	    {
+		r = _mm_and_pd (_mm_cmple_pd (_mm_loadu_pd (minx + i), vx1),
+				_mm_cmple_pd (_mm_loadu_pd (miny + i), vy1));
+		r = _mm_and_pd (r,
+				_mm_cmpge_pd (_mm_loadu_pd (maxx + i), vx2));
+		r = _mm_and_pd (r,
+				_mm_cmpge_pd (_mm_loadu_pd (maxy + i), vy2));
+	    }
+	  bits = (unsigned int) _mm_movemask_pd (r);
+	  if (bits & 0x01)
+	      mask |= cache_bitmask (i);
+	  if (bits & 0x02)
+	      mask |= cache_bitmask (i + 1);
+      }
+#else
+    for (i = 0; i < 32; i++)
+      {
+	  int ok;
+	  if (within)
+	      ok = (minx[i] >= x1) & (miny[i] >= y1) & (maxx[i] <= x2) &
+		  (maxy[i] <= y2);
+	  else
+	      ok = (minx[i] <= x1) & (miny[i] <= y1) & (maxx[i] >= x2) &
+		  (maxy[i] >= y2);
+	  if (ok)
+	      mask |= cache_bitmask (i);
+      }
+#endif
+    return mask;
+}
+
+static unsigned int
+cache_scan_intersects (const double *minx, const double *miny,
+		       const double *maxx, const double *maxy, double q_minx,
+		       double q_miny, double q_maxx, double q_maxy)
+{
+/* bitmap of the MBRs intersecting the search frame */
+    return cache_scan_mbrs (minx, miny, maxx, maxy, q_maxx, q_maxy, q_minx,
+			    q_miny, 0);
 }
 
 static struct mbr_cache *
@@ -300,54 +398,98 @@ cache_alloc (void)
 {
 /* allocates and initializes an empty cache struct */
     struct mbr_cache *p = malloc (sizeof (struct mbr_cache));
-    p->first = NULL;
-    p->last = NULL;
-    p->current = NULL;
+    p->pages = NULL;
+    p->n_pages = 0;
+    p->max_pages = 0;
+    p->current = -1;
+    p->mapping = NULL;
+    p->mapping_size = 0;
+    p->n_mapped = 0;
+    p->generation = 0;
+    p->n_changes = 0;
+    p->dirty = 0;
+    p->stale = 0;
     return p;
 }
 
+static void
+cache_reset_block_mbr (struct mbr_cache_page *pp, int ib)
+{
+/* resetting the MBR of some cache block */
+    pp->block_minx[ib] = DBL_MAX;
+    pp->block_miny[ib] = DBL_MAX;
+    pp->block_maxx[ib] = -DBL_MAX;
+    pp->block_maxy[ib] = -DBL_MAX;
+}
+
 static struct mbr_cache_page *
 cache_page_alloc (void)
 {
 /* allocates and initializes a cache page */
     int i;
-    struct mbr_cache_block *pb;
     struct mbr_cache_page *p = malloc (sizeof (struct mbr_cache_page));
     p->bitmap = 0x00000000;
-    p->next = NULL;
     p->minx = DBL_MAX;
     p->miny = DBL_MAX;
     p->maxx = -DBL_MAX;
     p->maxy = -DBL_MAX;
     for (i = 0; i < 32; i++)
       {
-	  pb = p->blocks + i;
-	  pb->bitmap = 0x00000000;
-	  pb->minx = DBL_MAX;
-	  pb->miny = DBL_MAX;
-	  pb->maxx = -DBL_MAX;
-	  pb->maxy = DBL_MAX;
+	  p->blocks[i].bitmap = 0x00000000;
+	  cache_reset_block_mbr (p, i);
       }
     p->max_rowid = LONG64_MIN;
     p->min_rowid = LONG64_MAX;
     return p;
 }
 
+static int
+cache_append_page (struct mbr_cache *p, struct mbr_cache_page *pp)
+{
+/* appending a page into the cache pages array */
+    if (p->n_pages == p->max_pages)
+      {
+	  int max = (p->max_pages == 0) ? 64 : p->max_pages * 2;
+	  struct mbr_cache_page **pages =
+	      realloc (p->pages, sizeof (struct mbr_cache_page *) * max);
+	  if (pages == NULL)
+	      return 0;
+	  p->pages = pages;
+	  p->max_pages = max;
+      }
+    p->pages[p->n_pages] = pp;
+    p->current = p->n_pages;
+    p->n_pages += 1;
+    return 1;
+}
+
+static void
+cache_unmap (unsigned char *mapping, size_t size)
+{
+/* releasing a sidecar file mapping */
+    if (mapping == NULL)
+	return;
+#ifdef _WIN32
+    if (size)
+	size = size;		/* unused arg warning suppression */
+    free (mapping);
+#else
+    munmap (mapping, size);
+#endif
+}
+
 static void
 cache_destroy (struct mbr_cache *p)
 {
 /* memory cleanup; destroying a cache and any page into the cache */
-    struct mbr_cache_page *pp;
-    struct mbr_cache_page *ppn;
+    int i;
     if (!p)
 	return;
-    pp = p->first;
-    while (pp)
-      {
-	  ppn = pp->next;
-	  free (pp);
-	  pp = ppn;
-      }
+    for (i = p->n_mapped; i < p->n_pages; i++)
+	free (p->pages[i]);
+    if (p->pages)
+	free (p->pages);
+    cache_unmap (p->mapping, p->mapping_size);
     free (p);
 }
 
@@ -364,21 +506,6 @@ cache_get_free_block (struct mbr_cache_page *pp)
     return -1;
 }
 
-static void
-cache_fix_page_bitmap (struct mbr_cache_page *pp)
-{
-/* updating the cache page bitmap */
-    int ib;
-    for (ib = 0; ib < 32; ib++)
-      {
-	  if (pp->blocks[ib].bitmap == 0xffffffff)
-	    {
-		/* all the cells into this block are used; marking the page bitmap */
-		pp->bitmap |= cache_bitmask (ib);
-	    }
-      }
-}
-
 static int
 cache_get_free_cell (struct mbr_cache_block *pb)
 {
@@ -397,37 +524,29 @@ cache_get_free_page (struct mbr_cache *p)
 {
 /* return a pointer to the first cache page containing a free cell */
     struct mbr_cache_page *pp;
-    if (!(p->first))
-      {
-	  /* the cache is empty; so we surely need to allocate the first page */
-	  pp = cache_page_alloc ();
-	  p->first = pp;
-	  p->last = pp;
-	  p->current = pp;
-	  return pp;
-      }
-    if (p->current)
+    int i;
+    if (p->current >= 0)
       {
 	  /* checking if there is at least a free block into the current page */
-	  if (p->current->bitmap != 0xffffffff)
-	      return p->current;
+	  if (p->pages[p->current]->bitmap != 0xffffffff)
+	      return p->pages[p->current];
       }
-    pp = p->first;
-    while (pp)
+    for (i = 0; i < p->n_pages; i++)
       {
-	  /* scanning the page list in order to discover if there is an existing page not yet completely filled */
-	  if (pp->bitmap != 0xffffffff)
+	  /* scanning the page array in order to discover if there is an existing page not yet completely filled */
+	  if (p->pages[i]->bitmap != 0xffffffff)
 	    {
-		p->current = pp;
-		return pp;
+		p->current = i;
+		return p->pages[i];
 	    }
-	  pp = pp->next;
       }
 /* we have to allocate a new page */
     pp = cache_page_alloc ();
-    p->last->next = pp;
-    p->last = pp;
-    p->current = pp;
+    if (!cache_append_page (p, pp))
+      {
+	  free (pp);
+	  return NULL;
+      }
     return pp;
 }
 
@@ -437,26 +556,30 @@ cache_insert_cell (struct mbr_cache *p, sqlite3_int64 rowid, double minx,
 {
 /* inserting a new cell */
     struct mbr_cache_page *pp = cache_get_free_page (p);
-    int ib = cache_get_free_block (pp);
-    struct mbr_cache_block *pb = pp->blocks + ib;
-    int ic = cache_get_free_cell (pb);
-    struct mbr_cache_cell *pc = pb->cells + ic;
-    pc->rowid = rowid;
-    pc->minx = minx;
-    pc->miny = miny;
-    pc->maxx = maxx;
-    pc->maxy = maxy;
+    int ib;
+    struct mbr_cache_block *pb;
+    int ic;
+    if (pp == NULL)
+	return;
+    ib = cache_get_free_block (pp);
+    pb = pp->blocks + ib;
+    ic = cache_get_free_cell (pb);
+    pb->rowid[ic] = rowid;
+    pb->minx[ic] = minx;
+    pb->miny[ic] = miny;
+    pb->maxx[ic] = maxx;
+    pb->maxy[ic] = maxy;
 /* marking the cache cell as used into the block bitmap */
     pb->bitmap |= cache_bitmask (ic);
 /* updating the cache block MBR */
-    if (pb->minx > minx)
-	pb->minx = minx;
-    if (pb->maxx < maxx)
-	pb->maxx = maxx;
-    if (pb->miny > miny)
-	pb->miny = miny;
-    if (pb->maxy < maxy)
-	pb->maxy = maxy;
+    if (pp->block_minx[ib] > minx)
+	pp->block_minx[ib] = minx;
+    if (pp->block_maxx[ib] < maxx)
+	pp->block_maxx[ib] = maxx;
+    if (pp->block_miny[ib] > miny)
+	pp->block_miny[ib] = miny;
+    if (pp->block_maxy[ib] < maxy)
+	pp->block_maxy[ib] = maxy;
 /* updating the cache page MBR */
     if (pp->minx > minx)
 	pp->minx = minx;
@@ -467,20 +590,246 @@ cache_insert_cell (struct mbr_cache *p, sqlite3_int64 rowid, double minx,
     if (pp->maxy < maxy)
 	pp->maxy = maxy;
 /* fixing the cache page bitmap */
-    cache_fix_page_bitmap (pp);
+    if (pb->bitmap == 0xffffffff)
+	pp->bitmap |= cache_bitmask (ib);
 /* updating min-max rowid into the cache page */
     if (pp->min_rowid > rowid)
 	pp->min_rowid = rowid;
     if (pp->max_rowid < rowid)
 	pp->max_rowid = rowid;
+    p->dirty = 1;
+}
+
+static int
+cache_read_generation (sqlite3 * handle, const char *table,
+		       const char *column, sqlite3_int64 * generation)
+{
+/*
+retrieving the current generation of the main table
+
+fails if the generation isn't tracked, or if any of the triggers
+maintaining it is missing (e.g. the main table was dropped and
+then created again)
+*/
+    sqlite3_stmt *stmt;
+    int ret;
+    int ok = 0;
+    char *sql_statement;
+    sql_statement =
+	sqlite3_mprintf
+	("SELECT generation FROM main.mbrcache_generations "
+	 "WHERE f_table_name = Lower(%Q) AND f_geometry_column = Lower(%Q) "
+	 "AND (SELECT Count(*) FROM main.sqlite_master WHERE type = 'trigger' "
+	 "AND Lower(tbl_name) = Lower(%Q) AND Lower(name) IN "
+	 "(Lower('mcgi_' || %Q || '_' || %Q), Lower('mcgu_' || %Q || '_' || %Q), "
+	 "Lower('mcgd_' || %Q || '_' || %Q))) = 3", table, column, table, table,
+	 column, table, column, table, column);
+    ret =
+	sqlite3_prepare_v2 (handle, sql_statement, strlen (sql_statement),
+			    &stmt, NULL);
+    sqlite3_free (sql_statement);
+    if (ret != SQLITE_OK)
+	return 0;
+    ret = sqlite3_step (stmt);
+    if (ret == SQLITE_ROW)
+      {
+	  if (sqlite3_column_type (stmt, 0) == SQLITE_INTEGER)
+	    {
+		*generation = sqlite3_column_int64 (stmt, 0);
+		ok = 1;
+	    }
+      }
+    sqlite3_finalize (stmt);
+    return ok;
+}
+
+static int
+cache_install_generation (sqlite3 * handle, const char *table,
+			  const char *column)
+{
+/* creating (if not already existing) the triggers tracking the generation */
+    sqlite3_int64 generation;
+    int ret;
+    char *sql_statement;
+    char *raw;
+    char *xname;
+    char *xtable;
+    char *xcolumn;
+    if (cache_read_generation (handle, table, column, &generation))
+	return 1;
+    ret =
+	sqlite3_exec (handle,
+		      "CREATE TABLE IF NOT EXISTS main.mbrcache_generations (\n"
+		      "f_table_name TEXT NOT NULL,\n"
+		      "f_geometry_column TEXT NOT NULL,\n"
+		      "generation INTEGER NOT NULL,\n"
+		      "CONSTRAINT pk_mbrcache_generations PRIMARY KEY "
+		      "(f_table_name, f_geometry_column))", NULL, NULL, NULL);
+    if (ret != SQLITE_OK)
+	return 0;
+/*
+any trigger was missing, so the main table could have been changed
+without being tracked: the generation is anyway incremented, thus
+invalidating any previous sidecar file
+*/
+    sql_statement =
+	sqlite3_mprintf ("INSERT OR IGNORE INTO main.mbrcache_generations "
+			 "VALUES (Lower(%Q), Lower(%Q), 0)", table, column);
+    ret = sqlite3_exec (handle, sql_statement, NULL, NULL, NULL);
+    sqlite3_free (sql_statement);
+    if (ret != SQLITE_OK)
+	return 0;
+    sql_statement =
+	sqlite3_mprintf ("UPDATE main.mbrcache_generations "
+			 "SET generation = generation + 1 "
+			 "WHERE f_table_name = Lower(%Q) "
+			 "AND f_geometry_column = Lower(%Q)", table, column);
+    ret = sqlite3_exec (handle, sql_statement, NULL, NULL, NULL);
+    sqlite3_free (sql_statement);
+    if (ret != SQLITE_OK)
+	return 0;
+    xtable = gaiaDoubleQuotedSql (table);
+    xcolumn = gaiaDoubleQuotedSql (column);
+/* the INSERT trigger */
+    raw = sqlite3_mprintf ("mcgi_%s_%s", table, column);
+    xname = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    sql_statement =
+	sqlite3_mprintf ("DROP TRIGGER IF EXISTS main.\"%s\";\n"
+			 "CREATE TRIGGER main.\"%s\" AFTER INSERT ON \"%s\"\n"
+			 "FOR EACH ROW BEGIN\n"
+			 "UPDATE mbrcache_generations SET generation = generation + 1\n"
+			 "WHERE f_table_name = Lower(%Q) AND f_geometry_column = Lower(%Q);\nEND",
+			 xname, xname, xtable, table, column);
+    free (xname);
+    ret = sqlite3_exec (handle, sql_statement, NULL, NULL, NULL);
+    sqlite3_free (sql_statement);
+    if (ret != SQLITE_OK)
+	goto error;
+/* the UPDATE trigger */
+    raw = sqlite3_mprintf ("mcgu_%s_%s", table, column);
+    xname = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    sql_statement =
+	sqlite3_mprintf ("DROP TRIGGER IF EXISTS main.\"%s\";\n"
+			 "CREATE TRIGGER main.\"%s\" AFTER UPDATE ON \"%s\"\n"
+			 "FOR EACH ROW WHEN OLD.ROWID <> NEW.ROWID "
+			 "OR OLD.\"%s\" IS NOT NEW.\"%s\" BEGIN\n"
+			 "UPDATE mbrcache_generations SET generation = generation + 1\n"
+			 "WHERE f_table_name = Lower(%Q) AND f_geometry_column = Lower(%Q);\nEND",
+			 xname, xname, xtable, xcolumn, xcolumn, table, column);
+    free (xname);
+    ret = sqlite3_exec (handle, sql_statement, NULL, NULL, NULL);
+    sqlite3_free (sql_statement);
+    if (ret != SQLITE_OK)
+	goto error;
+/* the DELETE trigger */
+    raw = sqlite3_mprintf ("mcgd_%s_%s", table, column);
+    xname = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    sql_statement =
+	sqlite3_mprintf ("DROP TRIGGER IF EXISTS main.\"%s\";\n"
+			 "CREATE TRIGGER main.\"%s\" AFTER DELETE ON \"%s\"\n"
+			 "FOR EACH ROW BEGIN\n"
+			 "UPDATE mbrcache_generations SET generation = generation + 1\n"
+			 "WHERE f_table_name = Lower(%Q) AND f_geometry_column = Lower(%Q);\nEND",
+			 xname, xname, xtable, table, column);
+    free (xname);
+    ret = sqlite3_exec (handle, sql_statement, NULL, NULL, NULL);
+    sqlite3_free (sql_statement);
+    if (ret != SQLITE_OK)
+	goto error;
+    free (xtable);
+    free (xcolumn);
+    return 1;
+
+  error:
+    free (xtable);
+    free (xcolumn);
+    return 0;
+}
+
+static void
+cache_remove_generation (sqlite3 * handle, const char *vtable,
+			 const char *table, const char *column)
+{
+/*
+removing the triggers tracking the generation, as well as the generation
+itself; the mbrcache_generations table is dropped once it's empty
+
+nothing is removed while any other sidecar MbrCache (i.e. one declared
+with three arguments) seems to refer to the same main table: its sidecar
+file still depends on that generation
+(the row of the virtual table being dropped is still in sqlite_master)
+*/
+    int ret;
+    int i;
+    char *sql_statement;
+    char *raw;
+    char *xname;
+    sqlite3_stmt *stmt;
+    int count = -1;
+    const char *prefix[3] = { "mcgi", "mcgu", "mcgd" };
+    sql_statement =
+	sqlite3_mprintf ("SELECT Count(*) FROM main.sqlite_master "
+			 "WHERE type = 'table' AND sql LIKE "
+			 "'CREATE VIRTUAL TABLE%%MbrCache%%(%%,%%,%%)%%' "
+			 "AND sql LIKE '%%' || %Q || '%%' "
+			 "AND name <> %Q", table, vtable);
+    ret =
+	sqlite3_prepare_v2 (handle, sql_statement, strlen (sql_statement),
+			    &stmt, NULL);
+    sqlite3_free (sql_statement);
+    if (ret != SQLITE_OK)
+	return;
+    if (sqlite3_step (stmt) == SQLITE_ROW)
+	count = sqlite3_column_int (stmt, 0);
+    sqlite3_finalize (stmt);
+    if (count != 0)
+	return;
+    for (i = 0; i < 3; i++)
+      {
+	  raw = sqlite3_mprintf ("%s_%s_%s", prefix[i], table, column);
+	  xname = gaiaDoubleQuotedSql (raw);
+	  sqlite3_free (raw);
+	  sql_statement =
+	      sqlite3_mprintf ("DROP TRIGGER IF EXISTS main.\"%s\"", xname);
+	  free (xname);
+	  ret = sqlite3_exec (handle, sql_statement, NULL, NULL, NULL);
+	  sqlite3_free (sql_statement);
+	  if (ret != SQLITE_OK)
+	      return;
+      }
+    sql_statement =
+	sqlite3_mprintf ("DELETE FROM main.mbrcache_generations "
+			 "WHERE f_table_name = Lower(%Q) "
+			 "AND f_geometry_column = Lower(%Q)", table, column);
+    ret = sqlite3_exec (handle, sql_statement, NULL, NULL, NULL);
+    sqlite3_free (sql_statement);
+    if (ret != SQLITE_OK)
+	return;
+    sql_statement =
+	"SELECT Count(*) FROM main.mbrcache_generations";
+    ret =
+	sqlite3_prepare_v2 (handle, sql_statement, strlen (sql_statement),
+			    &stmt, NULL);
+    if (ret != SQLITE_OK)
+	return;
+    count = -1;
+    if (sqlite3_step (stmt) == SQLITE_ROW)
+	count = sqlite3_column_int (stmt, 0);
+    sqlite3_finalize (stmt);
+    if (count == 0)
+	sqlite3_exec (handle, "DROP TABLE main.mbrcache_generations", NULL,
+		      NULL, NULL);
 }
 
 static struct mbr_cache *
 cache_load (sqlite3 * handle, const char *table, const char *column)
 {
-/* 
+/*
 initial loading the MBR cache
-retrieving any existing entity from the main table 
+retrieving any existing entity from the main table
 */
     sqlite3_stmt *stmt;
     int ret;
@@ -566,145 +915,351 @@ retrieving any existing entity from the main table
     return p_cache;
 }
 
+static unsigned char *
+cache_map_file (const char *path, size_t * size)
+{
+/* mapping a whole sidecar file in memory */
+    FILE *in;
+    unsigned char *mapping;
+    long len;
+    in = fopen (path, "rb");
+    if (in == NULL)
+	return NULL;
+    if (fseek (in, 0, SEEK_END) != 0 || (len = ftell (in)) <= 0)
+      {
+	  fclose (in);
+	  return NULL;
+      }
+#ifdef _WIN32
+    mapping = malloc (len);
+    if (mapping != NULL)
+      {
+	  rewind (in);
+	  if (fread (mapping, 1, len, in) != (size_t) len)
+	    {
+		free (mapping);
+		mapping = NULL;
+	    }
+      }
+#else
+/*
+private copy-on-write mapping: untouched pages are shared by any
+process using the same sidecar file, changed pages become private
+*/
+    mapping =
+	mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno (in), 0);
+    if (mapping == MAP_FAILED)
+	mapping = NULL;
+#endif
+    fclose (in);
+    *size = len;
+    return mapping;
+}
+
 static int
-cache_find_next_cell (struct mbr_cache_page **page, int *i_block, int *i_cell,
-		      struct mbr_cache_cell **cell)
+cache_check_header (const unsigned char *header, const char *table,
+		    const char *column, struct mbr_cache_file_header *hdr)
 {
-/* finding next cached cell */
-    struct mbr_cache_page *pp = *page;
-    struct mbr_cache_block *pb;
-    struct mbr_cache_cell *pc;
+/* checking if a sidecar file header is a valid one for this table */
+    memcpy (hdr, header, sizeof (struct mbr_cache_file_header));
+    if (memcmp (hdr->magic, MBR_CACHE_MAGIC, 8) != 0
+	|| hdr->endian != MBR_CACHE_ENDIAN
+	|| hdr->page_size != sizeof (struct mbr_cache_page)
+	|| hdr->n_pages < 0 || hdr->table_len < 0 || hdr->column_len < 0)
+	return 0;
+    if (sizeof (struct mbr_cache_file_header) + hdr->table_len +
+	hdr->column_len > MBR_CACHE_HEADER)
+	return 0;
+/* checking if the sidecar file really belongs to this table */
+    if ((int) strlen (table) != hdr->table_len
+	|| (int) strlen (column) != hdr->column_len)
+	return 0;
+    if (strncasecmp
+	((const char *) header + sizeof (struct mbr_cache_file_header), table,
+	 hdr->table_len) != 0)
+	return 0;
+    if (strncasecmp
+	((const char *) header + sizeof (struct mbr_cache_file_header) +
+	 hdr->table_len, column, hdr->column_len) != 0)
+	return 0;
+    return 1;
+}
+
+static struct mbr_cache *
+cache_load_sidecar (const char *path, const char *table, const char *column,
+		    sqlite3_int64 generation)
+{
+/* attempting to load the MBR cache from a sidecar file */
+    struct mbr_cache *p_cache;
+    struct mbr_cache_file_header hdr;
+    unsigned char *mapping;
+    size_t size;
+    int i;
+    mapping = cache_map_file (path, &size);
+    if (mapping == NULL)
+	return NULL;
+    if (size < MBR_CACHE_HEADER)
+	goto invalid;
+    if (!cache_check_header (mapping, table, column, &hdr))
+	goto invalid;
+    if (size !=
+	MBR_CACHE_HEADER + (size_t) hdr.n_pages * sizeof (struct mbr_cache_page))
+	goto invalid;
+/* checking if the main table is still at the same generation */
+    if (hdr.generation != generation)
+	goto invalid;
+
+    p_cache = cache_alloc ();
+    p_cache->mapping = mapping;
+    p_cache->mapping_size = size;
+    p_cache->generation = hdr.generation;
+    for (i = 0; i < hdr.n_pages; i++)
+      {
+	  struct mbr_cache_page *pp = (struct mbr_cache_page *) (mapping +
+								 MBR_CACHE_HEADER
+								 +
+								 ((size_t) i *
+								  sizeof (struct
+									  mbr_cache_page)));
+	  if (!cache_append_page (p_cache, pp))
+	    {
+		p_cache->n_mapped = p_cache->n_pages;
+		cache_destroy (p_cache);
+		return NULL;
+	    }
+	  p_cache->n_mapped = p_cache->n_pages;
+      }
+    p_cache->current = -1;
+    return p_cache;
+
+  invalid:
+    cache_unmap (mapping, size);
+    return NULL;
+}
+
+static int
+cache_save_sidecar (struct mbr_cache *p, const char *path, const char *table,
+		    const char *column)
+{
+/*
+saving the MBR cache into a sidecar file
+
+the file is written under a temporary name and then renamed,
+so that any other process still mapping the previous version
+will never see a partially written file
+
+a sidecar file already saved by some other process for a later
+generation is never replaced; should another process save a later
+generation just after this check, the file left in place would
+simply be rejected on loading, because its generation no longer
+matches the main table one
+*/
+    struct mbr_cache_file_header hdr;
+    unsigned char header[MBR_CACHE_HEADER];
+    char *tmp_path;
+    FILE *in;
+    FILE *out;
+    int i;
+    int ok = 1;
+    int table_len = strlen (table);
+    int column_len = strlen (column);
+    if (sizeof (struct mbr_cache_file_header) + table_len + column_len >
+	MBR_CACHE_HEADER)
+	return 0;
+    in = fopen (path, "rb");
+    if (in != NULL)
+      {
+	  if (fread (header, 1, MBR_CACHE_HEADER, in) == MBR_CACHE_HEADER)
+	    {
+		if (cache_check_header (header, table, column, &hdr))
+		  {
+		      if (hdr.generation > p->generation)
+			  ok = 0;
+		  }
+	    }
+	  fclose (in);
+	  if (!ok)
+	      return 0;
+      }
+    memset (header, 0, MBR_CACHE_HEADER);
+    memset (&hdr, 0, sizeof (struct mbr_cache_file_header));
+    memcpy (hdr.magic, MBR_CACHE_MAGIC, 8);
+    hdr.endian = MBR_CACHE_ENDIAN;
+    hdr.page_size = sizeof (struct mbr_cache_page);
+    hdr.n_pages = p->n_pages;
+    hdr.table_len = table_len;
+    hdr.column_len = column_len;
+    hdr.generation = p->generation;
+    memcpy (header, &hdr, sizeof (struct mbr_cache_file_header));
+    memcpy (header + sizeof (struct mbr_cache_file_header), table, table_len);
+    memcpy (header + sizeof (struct mbr_cache_file_header) + table_len,
+	    column, column_len);
+
+#ifdef _WIN32
+    tmp_path = sqlite3_mprintf ("%s.%d.tmp", path, _getpid ());
+#else
+    tmp_path = sqlite3_mprintf ("%s.%d.tmp", path, (int) getpid ());
+#endif
+    out = fopen (tmp_path, "wb");
+    if (out == NULL)
+      {
+	  sqlite3_free (tmp_path);
+	  return 0;
+      }
+    if (fwrite (header, 1, MBR_CACHE_HEADER, out) != MBR_CACHE_HEADER)
+	ok = 0;
+    for (i = 0; ok && i < p->n_pages; i++)
+      {
+	  if (fwrite
+	      (p->pages[i], sizeof (struct mbr_cache_page), 1, out) != 1)
+	      ok = 0;
+      }
+    if (fclose (out) != 0)
+	ok = 0;
+    if (ok)
+      {
+#ifdef _WIN32
+	  remove (path);
+#endif
+	  if (rename (tmp_path, path) != 0)
+	      ok = 0;
+      }
+    if (!ok)
+	remove (tmp_path);
+    sqlite3_free (tmp_path);
+    if (ok)
+	p->dirty = 0;
+    return ok;
+}
+
+static int
+cache_find_next_cell (struct mbr_cache *p, int *i_page, int *i_block,
+		      int *i_cell)
+{
+/* finding next cached cell (starting just after the current one) */
+    int ip;
     int ib;
     int ic;
     int sib = *i_block;
-    int sic = *i_cell;
-    while (pp)
+    int sic = *i_cell + 1;
+    for (ip = *i_page; ip < p->n_pages; ip++)
       {
+	  struct mbr_cache_page *pp = p->pages[ip];
 	  for (ib = sib; ib < 32; ib++)
 	    {
-		pb = pp->blocks + ib;
+		struct mbr_cache_block *pb = pp->blocks + ib;
 		for (ic = sic; ic < 32; ic++)
 		  {
 		      if ((pb->bitmap & cache_bitmask (ic)) == 0x00000000)
 			  continue;
-		      pc = pb->cells + ic;
-		      if (pc == *cell)
-			{
-			    /* this one is the current cell */
-			    continue;
-			}
 		      /* next cell found */
-		      *page = pp;
+		      *i_page = ip;
 		      *i_block = ib;
 		      *i_cell = ic;
-		      *cell = pc;
 		      return 1;
 		  }
 		sic = 0;
 	    }
 	  sib = 0;
-	  pp = pp->next;
       }
     return 0;
 }
 
 static int
-cache_find_next_mbr (struct mbr_cache_page **page, int *i_block, int *i_cell,
-		     struct mbr_cache_cell **cell, double minx, double miny,
-		     double maxx, double maxy, int mode)
+cache_find_next_mbr (struct mbr_cache *p, int *i_page, int *i_block,
+		     int *i_cell, double minx, double miny, double maxx,
+		     double maxy, int mode)
 {
-/* finding next cached cell */
-    struct mbr_cache_page *pp = *page;
-    struct mbr_cache_block *pb;
-    struct mbr_cache_cell *pc;
+/* finding next cached cell (starting just after the current one) */
+    int ip;
     int ib;
     int ic;
     int sib = *i_block;
-    int sic = *i_cell;
-    int ok_mbr;
-    while (pp)
+    int sic = *i_cell + 1;
+    for (ip = *i_page; ip < p->n_pages; ip++)
       {
-	  ok_mbr = 0;
+	  struct mbr_cache_page *pp = p->pages[ip];
+	  unsigned int blocks;
 	  if (pp->maxx >= minx && pp->minx <= maxx && pp->maxy >= miny
 	      && pp->miny <= maxy)
-	      ok_mbr = 1;
-	  if (ok_mbr)
 	    {
+		/* checking all the block MBRs at once */
+		blocks =
+		    cache_scan_intersects (pp->block_minx, pp->block_miny,
+					   pp->block_maxx, pp->block_maxy,
+					   minx, miny, maxx, maxy);
 		for (ib = sib; ib < 32; ib++)
 		  {
-		      pb = pp->blocks + ib;
-		      ok_mbr = 0;
-		      if (pb->maxx >= minx && pb->minx <= maxx
-			  && pb->maxy >= miny && pb->miny <= maxy)
-			  ok_mbr = 1;
-		      if (ok_mbr)
+		      struct mbr_cache_block *pb = pp->blocks + ib;
+		      unsigned int cells;
+		      if ((blocks & cache_bitmask (ib)) == 0x00000000
+			  || pb->bitmap == 0x00000000 || sic > 31)
+			{
+			    sic = 0;
+			    continue;
+			}
+		      /* checking all the cell MBRs at once */
+		      if (mode == GAIA_FILTER_MBR_INTERSECTS)
+			{
+			    /* MBR INTERSECTS */
+			    cells =
+				cache_scan_intersects (pb->minx, pb->miny,
+						       pb->maxx, pb->maxy,
+						       minx, miny, maxx, maxy);
+			}
+		      else if (mode == GAIA_FILTER_MBR_CONTAINS)
+			{
+			    /* MBR CONTAINS */
+			    cells =
+				cache_scan_mbrs (pb->minx, pb->miny, pb->maxx,
+						 pb->maxy, minx, miny, maxx,
+						 maxy, 0);
+			}
+		      else
 			{
-			    for (ic = sic; ic < 32; ic++)
+			    /* MBR WITHIN */
+			    cells =
+				cache_scan_mbrs (pb->minx, pb->miny, pb->maxx,
+						 pb->maxy, minx, miny, maxx,
+						 maxy, 1);
+			}
+		      cells &= pb->bitmap;
+		      cells &= 0xffffffff >> sic;
+		      sic = 0;
+		      if (cells == 0x00000000)
+			  continue;
+		      for (ic = 0; ic < 32; ic++)
+			{
+			    if (cells & cache_bitmask (ic))
 			      {
-				  if ((pb->bitmap & cache_bitmask (ic)) ==
-				      0x00000000)
-				      continue;
-				  pc = pb->cells + ic;
-				  ok_mbr = 0;
-				  if (mode == GAIA_FILTER_MBR_INTERSECTS)
-				    {
-					/* MBR INTERSECTS */
-					if (pc->maxx >= minx && pc->minx <= maxx
-					    && pc->maxy >= miny
-					    && pc->miny <= maxy)
-					    ok_mbr = 1;
-				    }
-				  else if (mode == GAIA_FILTER_MBR_CONTAINS)
-				    {
-					/* MBR CONTAINS */
-					if (minx >= pc->minx && maxx <= pc->maxx
-					    && miny >= pc->miny
-					    && maxy <= pc->maxy)
-					    ok_mbr = 1;
-				    }
-				  else
-				    {
-					/* MBR WITHIN */
-					if (pc->minx >= minx && pc->maxx <= maxx
-					    && pc->miny >= miny
-					    && pc->maxy <= maxy)
-					    ok_mbr = 1;
-				    }
-				  if (ok_mbr)
-				    {
-					if (pc == *cell)
-					  {
-					      /* this one is the current cell */
-					      continue;
-					  }
-					/* next cell found */
-					*page = pp;
-					*i_block = ib;
-					*i_cell = ic;
-					*cell = pc;
-					return 1;
-				    }
+				  /* next cell found */
+				  *i_page = ip;
+				  *i_block = ib;
+				  *i_cell = ic;
+				  return 1;
 			      }
 			}
-		      sic = 0;
 		  }
 	    }
 	  sib = 0;
-	  pp = pp->next;
+	  sic = 0;
       }
     return 0;
 }
 
-static struct mbr_cache_cell *
-cache_find_by_rowid (struct mbr_cache_page *pp, sqlite3_int64 rowid)
+static int
+cache_find_by_rowid (struct mbr_cache *p, sqlite3_int64 rowid, int *i_page,
+		     int *i_block, int *i_cell)
 {
 /* trying to find a row by rowid from the Mbr cache */
+    struct mbr_cache_page *pp;
     struct mbr_cache_block *pb;
-    struct mbr_cache_cell *pc;
+    int ip;
     int ib;
     int ic;
-    while (pp)
+    for (ip = 0; ip < p->n_pages; ip++)
       {
+	  pp = p->pages[ip];
 	  if (rowid >= pp->min_rowid && rowid <= pp->max_rowid)
 	    {
 		for (ib = 0; ib < 32; ib++)
@@ -714,13 +1269,16 @@ cache_find_by_rowid (struct mbr_cache_page *pp, sqlite3_int64 rowid)
 			{
 			    if ((pb->bitmap & cache_bitmask (ic)) == 0x00000000)
 				continue;
-			    pc = pb->cells + ic;
-			    if (pc->rowid == rowid)
-				return pc;
+			    if (pb->rowid[ic] == rowid)
+			      {
+				  *i_page = ip;
+				  *i_block = ib;
+				  *i_cell = ic;
+				  return 1;
+			      }
 			}
 		  }
 	    }
-	  pp = pp->next;
       }
     return 0;
 }
@@ -730,28 +1288,23 @@ cache_update_page (struct mbr_cache_page *pp, int i_block)
 {
 /* updating the cache block and cache page MBR after a DELETE or UPDATE occurred */
     struct mbr_cache_block *pb;
-    struct mbr_cache_cell *pc;
     int ib;
     int ic;
 /* updating the cache block MBR */
     pb = pp->blocks + i_block;
-    pb->minx = DBL_MAX;
-    pb->miny = DBL_MAX;
-    pb->maxx = -DBL_MAX;
-    pb->maxy = -DBL_MAX;
+    cache_reset_block_mbr (pp, i_block);
     for (ic = 0; ic < 32; ic++)
       {
 	  if ((pb->bitmap & cache_bitmask (ic)) == 0x00000000)
 	      continue;
-	  pc = pb->cells + ic;
-	  if (pb->minx > pc->minx)
-	      pb->minx = pc->minx;
-	  if (pb->miny > pc->miny)
-	      pb->miny = pc->miny;
-	  if (pb->maxx < pc->maxx)
-	      pb->maxx = pc->maxx;
-	  if (pb->maxy < pc->maxy)
-	      pb->maxy = pc->maxy;
+	  if (pp->block_minx[i_block] > pb->minx[ic])
+	      pp->block_minx[i_block] = pb->minx[ic];
+	  if (pp->block_miny[i_block] > pb->miny[ic])
+	      pp->block_miny[i_block] = pb->miny[ic];
+	  if (pp->block_maxx[i_block] < pb->maxx[ic])
+	      pp->block_maxx[i_block] = pb->maxx[ic];
+	  if (pp->block_maxy[i_block] < pb->maxy[ic])
+	      pp->block_maxy[i_block] = pb->maxy[ic];
       }
 /* updating the cache page MBR */
     pp->minx = DBL_MAX;
@@ -763,110 +1316,134 @@ cache_update_page (struct mbr_cache_page *pp, int i_block)
     for (ib = 0; ib < 32; ib++)
       {
 	  pb = pp->blocks + ib;
+	  if (pb->bitmap == 0x00000000)
+	      continue;
+	  if (pp->minx > pp->block_minx[ib])
+	      pp->minx = pp->block_minx[ib];
+	  if (pp->miny > pp->block_miny[ib])
+	      pp->miny = pp->block_miny[ib];
+	  if (pp->maxx < pp->block_maxx[ib])
+	      pp->maxx = pp->block_maxx[ib];
+	  if (pp->maxy < pp->block_maxy[ib])
+	      pp->maxy = pp->block_maxy[ib];
 	  for (ic = 0; ic < 32; ic++)
 	    {
 		if ((pb->bitmap & cache_bitmask (ic)) == 0x00000000)
 		    continue;
-		pc = pb->cells + ic;
-		if (pp->minx > pc->minx)
-		    pp->minx = pc->minx;
-		if (pp->miny > pc->miny)
-		    pp->miny = pc->miny;
-		if (pp->maxx < pc->maxx)
-		    pp->maxx = pc->maxx;
-		if (pp->maxy < pc->maxy)
-		    pp->maxy = pc->maxy;
-		if (pp->min_rowid > pc->rowid)
-		    pp->min_rowid = pc->rowid;
-		if (pp->max_rowid < pc->rowid)
-		    pp->max_rowid = pc->rowid;
+		if (pp->min_rowid > pb->rowid[ic])
+		    pp->min_rowid = pb->rowid[ic];
+		if (pp->max_rowid < pb->rowid[ic])
+		    pp->max_rowid = pb->rowid[ic];
 	    }
       }
 }
 
 static int
-cache_delete_cell (struct mbr_cache_page *pp, sqlite3_int64 rowid)
+cache_delete_cell (struct mbr_cache *p, sqlite3_int64 rowid)
 {
 /* trying to delete a row identified by rowid from the Mbr cache */
-    struct mbr_cache_block *pb;
-    struct mbr_cache_cell *pc;
+    struct mbr_cache_page *pp;
+    int ip;
     int ib;
     int ic;
-    while (pp)
-      {
-	  if (rowid >= pp->min_rowid && rowid <= pp->max_rowid)
-	    {
-		for (ib = 0; ib < 32; ib++)
-		  {
-		      pb = pp->blocks + ib;
-		      for (ic = 0; ic < 32; ic++)
-			{
-			    if ((pb->bitmap & cache_bitmask (ic)) == 0x00000000)
-				continue;
-			    pc = pb->cells + ic;
-			    if (pc->rowid == rowid)
-			      {
-				  /* marking the cell as free */
-				  pb->bitmap &= ~(cache_bitmask (ic));
-				  /* marking the block as not full */
-				  pp->bitmap &= ~(cache_bitmask (ib));
-				  /* updating the cache block and cache page MBR */
-				  cache_update_page (pp, ib);
-				  return 1;
-			      }
-			}
-		  }
-	    }
-	  pp = pp->next;
-      }
-    return 0;
+    if (!cache_find_by_rowid (p, rowid, &ip, &ib, &ic))
+	return 0;
+    pp = p->pages[ip];
+/* marking the cell as free */
+    pp->blocks[ib].bitmap &= ~(cache_bitmask (ic));
+/* marking the block as not full */
+    pp->bitmap &= ~(cache_bitmask (ib));
+/* updating the cache block and cache page MBR */
+    cache_update_page (pp, ib);
+    p->dirty = 1;
+    return 1;
 }
 
 static int
-cache_update_cell (struct mbr_cache_page *pp, sqlite3_int64 rowid, double minx,
+cache_update_cell (struct mbr_cache *p, sqlite3_int64 rowid, double minx,
 		   double miny, double maxx, double maxy)
 {
 /* trying to update a row identified by rowid from the Mbr cache */
+    struct mbr_cache_page *pp;
     struct mbr_cache_block *pb;
-    struct mbr_cache_cell *pc;
+    int ip;
     int ib;
     int ic;
-    while (pp)
+    if (!cache_find_by_rowid (p, rowid, &ip, &ib, &ic))
+	return 0;
+    pp = p->pages[ip];
+    pb = pp->blocks + ib;
+/* updating the cell MBR */
+    pb->minx[ic] = minx;
+    pb->miny[ic] = miny;
+    pb->maxx[ic] = maxx;
+    pb->maxy[ic] = maxy;
+/* updating the cache block and cache page MBR */
+    cache_update_page (pp, ib);
+    p->dirty = 1;
+    return 1;
+}
+
+static struct mbr_cache *
+cache_open (MbrCachePtr p_vt)
+{
+/*
+loading the MBR cache
+a valid sidecar file (if any) is simply mapped, otherwise the
+cache is built from the main table and then saved
+*/
+    struct mbr_cache *p_cache = NULL;
+    sqlite3_int64 generation;
+    sqlite3_int64 generation2;
+    if (p_vt->sidecar_path)
       {
-	  if (rowid >= pp->min_rowid && rowid <= pp->max_rowid)
+	  if (!cache_read_generation
+	      (p_vt->db, p_vt->table_name, p_vt->column_name, &generation))
 	    {
-		for (ib = 0; ib < 32; ib++)
-		  {
-		      pb = pp->blocks + ib;
-		      for (ic = 0; ic < 32; ic++)
-			{
-			    if ((pb->bitmap & cache_bitmask (ic)) == 0x00000000)
-				continue;
-			    pc = pb->cells + ic;
-			    if (pc->rowid == rowid)
-			      {
-				  /* updating the cell MBR */
-				  pc->minx = minx;
-				  pc->miny = miny;
-				  pc->maxx = maxx;
-				  pc->maxy = maxy;
-				  /* updating the cache block and cache page MBR */
-				  cache_update_page (pp, ib);
-				  return 1;
-			      }
-			}
-		  }
+		/* untracked main table: the sidecar file can't be trusted */
+		sqlite3_free (p_vt->sidecar_path);
+		p_vt->sidecar_path = NULL;
 	    }
-	  pp = pp->next;
+	  else
+	      p_cache =
+		  cache_load_sidecar (p_vt->sidecar_path, p_vt->table_name,
+				      p_vt->column_name, generation);
       }
-    return 0;
+    if (p_cache)
+	return p_cache;
+    p_cache = cache_load (p_vt->db, p_vt->table_name, p_vt->column_name);
+    if (p_cache)
+	p_cache->dirty = 0;
+    if (p_cache && p_vt->sidecar_path)
+      {
+	  p_cache->generation = generation;
+	  if (!cache_read_generation
+	      (p_vt->db, p_vt->table_name, p_vt->column_name, &generation2)
+	      || generation2 != generation)
+	    {
+		/* some other process changed the main table in the meanwhile */
+		p_cache->stale = 1;
+	    }
+	  else if (sqlite3_get_autocommit (p_vt->db))
+	      cache_save_sidecar (p_cache, p_vt->sidecar_path,
+				  p_vt->table_name, p_vt->column_name);
+	  else
+	    {
+		/* 
+		   / the cache could contain still uncommitted changes,
+		   / so it will be saved on COMMIT
+		 */
+		p_cache->dirty = 1;
+	    }
+      }
+    return p_cache;
 }
 
 static int
-mbrc_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
-	     sqlite3_vtab ** ppVTab, char **pzErr)
+mbrc_init (sqlite3 * db, void *pAux, int argc, const char *const *argv,
+	   sqlite3_vtab ** ppVTab, char **pzErr, int create)
 {
-/* creates the virtual table and caches related Geometry column */
+/* creates or connects the virtual table and caches related Geometry column */
     int err;
     int ret;
     int i;
@@ -896,11 +1473,13 @@ mbrc_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
     p_vt->nRef = 0;
     p_vt->zErrMsg = NULL;
     p_vt->db = db;
+    p_vt->vtable_name = NULL;
     p_vt->table_name = NULL;
     p_vt->column_name = NULL;
+    p_vt->sidecar_path = NULL;
     p_vt->cache = NULL;
-/* checking for table_name and geo_column_name */
-    if (argc == 5)
+/* checking for table_name and geo_column_name [and sidecar_path] */
+    if (argc == 5 || argc == 6)
       {
 	  vtable = argv[2];
 	  len = strlen (vtable);
@@ -929,22 +1508,49 @@ mbrc_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 		xcolumn = gaiaDequotedSql (column);
 		column = xcolumn;
 	    }
+	  len = strlen (vtable);
+	  p_vt->vtable_name = sqlite3_malloc (len + 1);
+	  strcpy (p_vt->vtable_name, vtable);
 	  len = strlen (table);
 	  p_vt->table_name = sqlite3_malloc (len + 1);
 	  strcpy (p_vt->table_name, table);
 	  len = strlen (column);
 	  p_vt->column_name = sqlite3_malloc (len + 1);
 	  strcpy (p_vt->column_name, column);
+	  if (xvtable)
+	      free (xvtable);
 	  if (xtable)
 	      free (xtable);
 	  if (xcolumn)
 	      free (xcolumn);
+	  if (argc == 6)
+	    {
+		/*
+		   / the sidecar file allows other connections to simply map
+		   / the cache instead of rebuilding it; since this implies
+		   / writing to the local file-system it is only enabled when
+		   / SPATIALITE_SECURITY=relaxed
+		 */
+		const char *security_level = getenv ("SPATIALITE_SECURITY");
+		if (security_level != NULL
+		    && strcasecmp (security_level, "relaxed") == 0)
+		  {
+		      char *xpath = gaiaDequotedSql (argv[5]);
+		      if (xpath != NULL)
+			{
+			    len = strlen (xpath);
+			    p_vt->sidecar_path = sqlite3_malloc (len + 1);
+			    strcpy (p_vt->sidecar_path, xpath);
+			    free (xpath);
+			}
+		  }
+	    }
       }
     else
       {
 	  *pzErr =
 	      sqlite3_mprintf
-	      ("[MbrCache module] CREATE VIRTUAL: illegal arg list {table_name, geo_column_name}");
+	      ("[MbrCache module] CREATE VIRTUAL: illegal arg list {table_name, geo_column_name [, sidecar_path]}");
 	  return SQLITE_ERROR;
       }
 /* retrieving the base table columns */
@@ -1015,16 +1621,34 @@ mbrc_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 	  return SQLITE_ERROR;
       }
     sqlite3_free (sql_statement);
+    if (create && p_vt->sidecar_path)
+      {
+	  /* the sidecar file requires the main table generation to be tracked */
+	  if (!cache_install_generation
+	      (db, p_vt->table_name, p_vt->column_name))
+	    {
+		sqlite3_free (p_vt->sidecar_path);
+		p_vt->sidecar_path = NULL;
+	    }
+      }
     *ppVTab = (sqlite3_vtab *) p_vt;
     return SQLITE_OK;
 }
 
+static int
+mbrc_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
+	     sqlite3_vtab ** ppVTab, char **pzErr)
+{
+/* creates the virtual table */
+    return mbrc_init (db, pAux, argc, argv, ppVTab, pzErr, 1);
+}
+
 static int
 mbrc_connect (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 	      sqlite3_vtab ** ppVTab, char **pzErr)
 {
-/* connects the virtual table - simply aliases mbrc_create() */
-    return mbrc_create (db, pAux, argc, argv, ppVTab, pzErr);
+/* connects the virtual table */
+    return mbrc_init (db, pAux, argc, argv, ppVTab, pzErr, 0);
 }
 
 static int
@@ -1099,10 +1723,14 @@ mbrc_disconnect (sqlite3_vtab * pVTab)
     MbrCachePtr p_vt = (MbrCachePtr) pVTab;
     if (p_vt->cache)
 	cache_destroy (p_vt->cache);
+    if (p_vt->vtable_name)
+	sqlite3_free (p_vt->vtable_name);
     if (p_vt->table_name)
 	sqlite3_free (p_vt->table_name);
     if (p_vt->column_name)
 	sqlite3_free (p_vt->column_name);
+    if (p_vt->sidecar_path)
+	sqlite3_free (p_vt->sidecar_path);
     sqlite3_free (p_vt);
     return SQLITE_OK;
 }
@@ -1110,7 +1738,14 @@ mbrc_disconnect (sqlite3_vtab * pVTab)
 static int
 mbrc_destroy (sqlite3_vtab * pVTab)
 {
-/* destroys the virtual table - simply aliases mbrc_disconnect() */
+/* 
+/ destroys the virtual table - also removing the generation tracking
+/ on the main table, if it was installed for a sidecar file
+*/
+    MbrCachePtr p_vt = (MbrCachePtr) pVTab;
+    if (!p_vt->error && p_vt->sidecar_path)
+	cache_remove_generation (p_vt->db, p_vt->vtable_name,
+				 p_vt->table_name, p_vt->column_name);
     return mbrc_disconnect (pVTab);
 }
 
@@ -1118,16 +1753,16 @@ static void
 mbrc_read_row_unfiltered (MbrCacheCursorPtr cursor)
 {
 /* trying to read the next row from the Mbr cache - unfiltered mode */
-    struct mbr_cache_page *page = cursor->current_page;
-    struct mbr_cache_cell *cell = cursor->current_cell;
+    struct mbr_cache *cache = cursor->pVtab->cache;
+    int i_page = cursor->current_page;
     int i_block = cursor->current_block_index;
     int i_cell = cursor->current_cell_index;
-    if (cache_find_next_cell (&page, &i_block, &i_cell, &cell))
+    if (cache_find_next_cell (cache, &i_page, &i_block, &i_cell))
       {
-	  cursor->current_page = page;
+	  cursor->current_page = i_page;
 	  cursor->current_block_index = i_block;
 	  cursor->current_cell_index = i_cell;
-	  cursor->current_cell = cell;
+	  cursor->current_block = cache->pages[i_page]->blocks + i_block;
       }
     else
 	cursor->eof = 1;
@@ -1137,18 +1772,18 @@ static void
 mbrc_read_row_filtered (MbrCacheCursorPtr cursor)
 {
 /* trying to read the next row from the Mbr cache - spatially filter mode */
-    struct mbr_cache_page *page = cursor->current_page;
-    struct mbr_cache_cell *cell = cursor->current_cell;
+    struct mbr_cache *cache = cursor->pVtab->cache;
+    int i_page = cursor->current_page;
     int i_block = cursor->current_block_index;
     int i_cell = cursor->current_cell_index;
     if (cache_find_next_mbr
-	(&page, &i_block, &i_cell, &cell, cursor->minx, cursor->miny,
+	(cache, &i_page, &i_block, &i_cell, cursor->minx, cursor->miny,
 	 cursor->maxx, cursor->maxy, cursor->mbr_mode))
       {
-	  cursor->current_page = page;
+	  cursor->current_page = i_page;
 	  cursor->current_block_index = i_block;
 	  cursor->current_cell_index = i_cell;
-	  cursor->current_cell = cell;
+	  cursor->current_block = cache->pages[i_page]->blocks + i_block;
       }
     else
 	cursor->eof = 1;
@@ -1158,13 +1793,20 @@ static void
 mbrc_read_row_by_rowid (MbrCacheCursorPtr cursor, sqlite3_int64 rowid)
 {
 /* trying to find a row by rowid from the Mbr cache */
-    struct mbr_cache_cell *cell =
-	cache_find_by_rowid (cursor->pVtab->cache->first, rowid);
-    if (cell)
-	cursor->current_cell = cell;
+    struct mbr_cache *cache = cursor->pVtab->cache;
+    int i_page;
+    int i_block;
+    int i_cell;
+    if (cache_find_by_rowid (cache, rowid, &i_page, &i_block, &i_cell))
+      {
+	  cursor->current_page = i_page;
+	  cursor->current_block_index = i_block;
+	  cursor->current_cell_index = i_cell;
+	  cursor->current_block = cache->pages[i_page]->blocks + i_block;
+      }
     else
       {
-	  cursor->current_cell = NULL;
+	  cursor->current_block = NULL;
 	  cursor->eof = 1;
       }
 }
@@ -1186,12 +1828,17 @@ mbrc_open (sqlite3_vtab * pVTab, sqlite3_vtab_cursor ** ppCursor)
 	  return SQLITE_OK;
       }
     if (!(p_vt->cache))
-	p_vt->cache =
-	    cache_load (p_vt->db, p_vt->table_name, p_vt->column_name);
-    cursor->current_page = cursor->pVtab->cache->first;
+	p_vt->cache = cache_open (p_vt);
+    if (!(p_vt->cache))
+      {
+	  cursor->eof = 1;
+	  *ppCursor = (sqlite3_vtab_cursor *) cursor;
+	  return SQLITE_OK;
+      }
+    cursor->current_page = 0;
     cursor->current_block_index = 0;
-    cursor->current_cell_index = 0;
-    cursor->current_cell = NULL;
+    cursor->current_cell_index = -1;
+    cursor->current_block = NULL;
     cursor->eof = 0;
     *ppCursor = (sqlite3_vtab_cursor *) cursor;
     return SQLITE_OK;
@@ -1213,15 +1860,15 @@ mbrc_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
     MbrCacheCursorPtr cursor = (MbrCacheCursorPtr) pCursor;
     if (idxStr || argc)
 	idxStr = idxStr;	/* unused arg warning suppression */
-    if (cursor->pVtab->error)
+    if (cursor->pVtab->error || !(cursor->pVtab->cache))
       {
 	  cursor->eof = 1;
 	  return SQLITE_OK;
       }
-    cursor->current_page = cursor->pVtab->cache->first;
+    cursor->current_page = 0;
     cursor->current_block_index = 0;
-    cursor->current_cell_index = 0;
-    cursor->current_cell = NULL;
+    cursor->current_cell_index = -1;
+    cursor->current_block = NULL;
     cursor->eof = 0;
     cursor->strategy = idxNum;
     if (idxNum == 0)
@@ -1311,30 +1958,27 @@ mbrc_column (sqlite3_vtab_cursor * pCursor, sqlite3_context * pContext,
 {
 /* fetching value for the Nth column */
     MbrCacheCursorPtr cursor = (MbrCacheCursorPtr) pCursor;
-    if (!(cursor->current_cell))
+    struct mbr_cache_block *pb = cursor->current_block;
+    int ic = cursor->current_cell_index;
+    if (!pb)
 	sqlite3_result_null (pContext);
     else
       {
 	  if (column == 0)
 	    {
 		/* the PRIMARY KEY column */
-		sqlite3_result_int64 (pContext, cursor->current_cell->rowid);
+		sqlite3_result_int64 (pContext, pb->rowid[ic]);
 	    }
 	  if (column == 1)
 	    {
 		/* the MBR column */
 		char *envelope = sqlite3_mprintf ("POLYGON(("
 						  "%1.2f %1.2f, %1.2f %1.2f, %1.2f %1.2f, %1.2f %1.2f, %1.2f %1.2f))",
-						  cursor->current_cell->minx,
-						  cursor->current_cell->miny,
-						  cursor->current_cell->maxx,
-						  cursor->current_cell->miny,
-						  cursor->current_cell->maxx,
-						  cursor->current_cell->maxy,
-						  cursor->current_cell->minx,
-						  cursor->current_cell->maxy,
-						  cursor->current_cell->minx,
-						  cursor->current_cell->miny);
+						  pb->minx[ic], pb->miny[ic],
+						  pb->maxx[ic], pb->miny[ic],
+						  pb->maxx[ic], pb->maxy[ic],
+						  pb->minx[ic], pb->maxy[ic],
+						  pb->minx[ic], pb->miny[ic]);
 		sqlite3_result_text (pContext, envelope, strlen (envelope),
 				     sqlite3_free);
 	    }
@@ -1347,7 +1991,8 @@ mbrc_rowid (sqlite3_vtab_cursor * pCursor, sqlite_int64 * pRowid)
 {
 /* fetching the ROWID */
     MbrCacheCursorPtr cursor = (MbrCacheCursorPtr) pCursor;
-    *pRowid = cursor->current_cell->rowid;
+    *pRowid =
+	cursor->current_block->rowid[cursor->current_cell_index];
     return SQLITE_OK;
 }
 
@@ -1371,15 +2016,17 @@ mbrc_update (sqlite3_vtab * pVTab, int argc, sqlite3_value ** argv,
     if (p_vtab->error)
 	return SQLITE_OK;
     if (!(p_vtab->cache))
-	p_vtab->cache =
-	    cache_load (p_vtab->db, p_vtab->table_name, p_vtab->column_name);
+	p_vtab->cache = cache_open (p_vtab);
+    if (!(p_vtab->cache))
+	return SQLITE_ERROR;
     if (argc == 1)
       {
 	  /* performing a DELETE */
 	  if (sqlite3_value_type (argv[0]) == SQLITE_INTEGER)
 	    {
 		rowid = sqlite3_value_int64 (argv[0]);
-		cache_delete_cell (p_vtab->cache->first, rowid);
+		if (cache_delete_cell (p_vtab->cache, rowid))
+		    p_vtab->cache->n_changes++;
 	    }
 	  else
 	      illegal = 1;
@@ -1404,12 +2051,19 @@ mbrc_update (sqlite3_vtab * pVTab, int argc, sqlite3_value ** argv,
 			      {
 				  if (mode == GAIA_FILTER_MBR_DECLARE)
 				    {
+					int ip;
+					int ib;
+					int ic;
 					if (!cache_find_by_rowid
-					    (p_vtab->cache->first, rowid))
-					    cache_insert_cell (p_vtab->cache,
-							       rowid, minx,
-							       miny, maxx,
-							       maxy);
+					    (p_vtab->cache, rowid, &ip, &ib,
+					     &ic))
+					  {
+					      cache_insert_cell (p_vtab->cache,
+								 rowid, minx,
+								 miny, maxx,
+								 maxy);
+					      p_vtab->cache->n_changes++;
+					  }
 				    }
 				  else
 				      illegal = 1;
@@ -1440,9 +2094,12 @@ mbrc_update (sqlite3_vtab * pVTab, int argc, sqlite3_value ** argv,
 				 &mode))
 			      {
 				  if (mode == GAIA_FILTER_MBR_DECLARE)
-				      cache_update_cell (p_vtab->cache->first,
-							 rowid, minx, miny,
-							 maxx, maxy);
+				    {
+					if (cache_update_cell
+					    (p_vtab->cache, rowid, minx, miny,
+					     maxx, maxy))
+					    p_vtab->cache->n_changes++;
+				    }
 				  else
 				      illegal = 1;
 			      }
@@ -1473,27 +2130,51 @@ mbrc_begin (sqlite3_vtab * pVTab)
 static int
 mbrc_sync (sqlite3_vtab * pVTab)
 {
-/* BEGIN TRANSACTION */
-    if (pVTab)
-	pVTab = pVTab;		/* unused arg warning suppression */
+/*
+SYNC TRANSACTION - checking the cache against the main table generation
+
+the cache still matches the main table only if the generation has been
+incremented exactly once for each change applied to the cache; any other
+change (e.g. committed by some other connection, or not reaching the
+cache) makes it stale, and a stale cache will never be saved
+*/
+    MbrCachePtr p_vt = (MbrCachePtr) pVTab;
+    struct mbr_cache *p = p_vt->cache;
+    sqlite3_int64 generation;
+    if (p_vt->sidecar_path && p && p->dirty && !(p->stale))
+      {
+	  if (!cache_read_generation
+	      (p_vt->db, p_vt->table_name, p_vt->column_name, &generation)
+	      || generation != p->generation + p->n_changes)
+	      p->stale = 1;
+	  else
+	    {
+		p->generation = generation;
+		p->n_changes = 0;
+	    }
+      }
     return SQLITE_OK;
 }
 
 static int
 mbrc_commit (sqlite3_vtab * pVTab)
 {
-/* BEGIN TRANSACTION */
-    if (pVTab)
-	pVTab = pVTab;		/* unused arg warning suppression */
+/* COMMIT TRANSACTION - refreshing the sidecar file (if any) */
+    MbrCachePtr p_vt = (MbrCachePtr) pVTab;
+    if (p_vt->sidecar_path && p_vt->cache && p_vt->cache->dirty
+	&& !(p_vt->cache->stale))
+	cache_save_sidecar (p_vt->cache, p_vt->sidecar_path,
+			    p_vt->table_name, p_vt->column_name);
     return SQLITE_OK;
 }
 
 static int
 mbrc_rollback (sqlite3_vtab * pVTab)
 {
-/* BEGIN TRANSACTION */
-    if (pVTab)
-	pVTab = pVTab;		/* unused arg warning suppression */
+/* ROLLBACK TRANSACTION - the cache still contains the discarded changes */
+    MbrCachePtr p_vt = (MbrCachePtr) pVTab;
+    if (p_vt->cache && p_vt->cache->dirty)
+	p_vt->cache->stale = 1;
     return SQLITE_OK;
 }
 
@@ -53,6 +53,7 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <stdio.h>
 #include <string.h>
 #include <float.h>
+#include <math.h>
 
 #if defined(_WIN32) && !defined(__MINGW32__)
 #include "config-msvc.h"
@@ -68,6 +69,7 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <spatialite_private.h>
 #include <spatialite/gaiaaux.h>
 #include <spatialite/gaiageo.h>
+#include <spatialite/geopackage.h>
 
 #ifdef _WIN32
 #define strcasecmp	_stricmp
@@ -82,6 +84,40 @@ struct rtree_envelope
     double maxy;
 };
 
+struct rtree_bulk_cell
+{
+/* a struct wrapping a single R*Tree cell to be bulk loaded */
+    sqlite3_int64 id;		/* leaf: ROWID - inner: child node number */
+    float minx;
+    float maxx;
+    float miny;
+    float maxy;
+};
+
+struct rtree_bulk_ref
+{
+/* a struct wrapping a ROWID to leaf-node back-reference */
+    sqlite3_int64 rowid;
+    sqlite3_int64 node_no;
+};
+
+struct rtree_bulk_loader
+{
+/* a struct supporting the R*Tree bulk loader */
+    int node_size;
+    int max_cells;
+    sqlite3_int64 next_node;
+    unsigned char *buf;
+    char *xparent;
+    char *xrowid;
+    struct rtree_bulk_ref *refs;
+    int n_refs;
+    sqlite3_stmt *stmt_root;
+    sqlite3_stmt *stmt_node;
+    sqlite3_stmt *stmt_parent;
+    sqlite3_stmt *stmt_rowid;
+};
+
 struct spatial_index_str
 {
 /* a struct to implement a linked list of spatial-indexes */
@@ -4102,6 +4138,914 @@ validateRowid (void *p_sqlite, const char *table)
     return 0;
 }
 
+static float
+rtree_bulk_value_down (double d)
+{
+/* rounding a double towards -Infinity (just as the R*Tree module does) */
+    float f = (float) d;
+    if (f > d)
+	f = (float) (d * (d < 0 ? (1.0 + 1.0 / 8388608.0) :
+			  (1.0 - 1.0 / 8388608.0)));
+    return f;
+}
+
+static float
+rtree_bulk_value_up (double d)
+{
+/* rounding a double towards +Infinity (just as the R*Tree module does) */
+    float f = (float) d;
+    if (f < d)
+	f = (float) (d * (d < 0 ? (1.0 - 1.0 / 8388608.0) :
+			  (1.0 + 1.0 / 8388608.0)));
+    return f;
+}
+
+static int
+cmp_rtree_bulk_x (const void *p1, const void *p2)
+{
+/* compares two R*Tree cells by X center [for QSORT] */
+    struct rtree_bulk_cell *c1 = (struct rtree_bulk_cell *) p1;
+    struct rtree_bulk_cell *c2 = (struct rtree_bulk_cell *) p2;
+    double x1 = (double) c1->minx + (double) c1->maxx;
+    double x2 = (double) c2->minx + (double) c2->maxx;
+    if (x1 < x2)
+	return -1;
+    if (x1 > x2)
+	return 1;
+    return 0;
+}
+
+static int
+cmp_rtree_bulk_y (const void *p1, const void *p2)
+{
+/* compares two R*Tree cells by Y center [for QSORT] */
+    struct rtree_bulk_cell *c1 = (struct rtree_bulk_cell *) p1;
+    struct rtree_bulk_cell *c2 = (struct rtree_bulk_cell *) p2;
+    double y1 = (double) c1->miny + (double) c1->maxy;
+    double y2 = (double) c2->miny + (double) c2->maxy;
+    if (y1 < y2)
+	return -1;
+    if (y1 > y2)
+	return 1;
+    return 0;
+}
+
+static void
+rtree_bulk_str_sort (struct rtree_bulk_cell *cells, int count, int max_cells)
+{
+/* 
+/ sorting a level of R*Tree cells accordingly to the 
+/ Sort-Tile-Recursive (STR) packing algorithm:
+/ - cells are sorted by X and then split into vertical slices
+/ - each slice is then sorted by Y
+*/
+    int leaves = (count + max_cells - 1) / max_cells;
+    int slices = (int) ceil (sqrt ((double) leaves));
+    int slice_size = slices * max_cells;
+    int i;
+    qsort (cells, count, sizeof (struct rtree_bulk_cell), cmp_rtree_bulk_x);
+    for (i = 0; i < count; i += slice_size)
+      {
+	  int n = count - i;
+	  if (n > slice_size)
+	      n = slice_size;
+	  qsort (cells + i, n, sizeof (struct rtree_bulk_cell),
+		 cmp_rtree_bulk_y);
+      }
+}
+
+static void
+rtree_bulk_put32 (unsigned char *p, unsigned int value)
+{
+/* encoding a 32 bit unsigned int as big-endian */
+    *(p + 0) = (value >> 24) & 0xff;
+    *(p + 1) = (value >> 16) & 0xff;
+    *(p + 2) = (value >> 8) & 0xff;
+    *(p + 3) = value & 0xff;
+}
+
+static void
+rtree_bulk_put_float (unsigned char *p, float value)
+{
+/* encoding a float as big-endian */
+    unsigned int bits;
+    memcpy (&bits, &value, sizeof (float));
+    rtree_bulk_put32 (p, bits);
+}
+
+static int
+rtree_bulk_get_mbr (const unsigned char *blob, int size,
+		    struct rtree_bulk_cell *cell)
+{
+/* decoding the MBR directly from the BLOB header */
+    double minx;
+    double miny;
+    double maxx;
+    double maxy;
+    if (gaiaGetMbrMinX (blob, size, &minx) && gaiaGetMbrMinY (blob, size, &miny)
+	&& gaiaGetMbrMaxX (blob, size, &maxx)
+	&& gaiaGetMbrMaxY (blob, size, &maxy))
+	;
+    else
+      {
+#ifdef ENABLE_GEOPACKAGE	/* GEOPACKAGE enabled: supporting GPKG geometries */
+	  int has_z;
+	  double min_z;
+	  double max_z;
+	  int has_m;
+	  double min_m;
+	  double max_m;
+	  if (!gaiaIsValidGPB (blob, size))
+	      return 0;
+	  if (!gaiaGetEnvelopeFromGPB
+	      (blob, size, &minx, &maxx, &miny, &maxy, &has_z, &min_z, &max_z,
+	       &has_m, &min_m, &max_m))
+	      return 0;
+#else
+	  return 0;
+#endif /* end GEOPACKAGE: supporting GPKG geometries */
+      }
+    cell->minx = rtree_bulk_value_down (minx);
+    cell->maxx = rtree_bulk_value_up (maxx);
+    cell->miny = rtree_bulk_value_down (miny);
+    cell->maxy = rtree_bulk_value_up (maxy);
+    return 1;
+}
+
+static sqlite3_stmt *
+rtree_bulk_prepare_refs (sqlite3 * sqlite, const char *quoted,
+			 const char *column, int count)
+{
+/* preparing a multi-row INSERT into the ROWID/PARENT shadow tables */
+    char *sql;
+    char *prev;
+    int i;
+    int ret;
+    sqlite3_stmt *stmt;
+    if (strcmp (column, "rowid") == 0)
+	sql =
+	    sqlite3_mprintf ("INSERT INTO \"%s\" (rowid, nodeno) VALUES (?, ?)",
+			     quoted);
+    else
+	sql =
+	    sqlite3_mprintf
+	    ("INSERT INTO \"%s\" (nodeno, parentnode) VALUES (?, ?)", quoted);
+    for (i = 1; i < count; i++)
+      {
+	  prev = sql;
+	  sql = sqlite3_mprintf ("%s, (?, ?)", prev);
+	  sqlite3_free (prev);
+      }
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return NULL;
+    return stmt;
+}
+
+static int
+rtree_bulk_write_node (sqlite3 * sqlite, struct rtree_bulk_loader *loader,
+		       struct rtree_bulk_cell *cells, int count, int depth,
+		       int is_root, struct rtree_bulk_cell *parent)
+{
+/* writing a fully packed R*Tree node into the shadow tables */
+    sqlite3_int64 node_no;
+    unsigned char *p;
+    sqlite3_stmt *stmt;
+    int i;
+    int ret;
+
+    if (is_root)
+	node_no = 1;
+    else
+	node_no = loader->next_node++;
+    memset (loader->buf, 0, loader->node_size);
+    if (is_root)
+      {
+	  /* only the Root node declares the Tree depth */
+	  *(loader->buf + 0) = (depth >> 8) & 0xff;
+	  *(loader->buf + 1) = depth & 0xff;
+      }
+    *(loader->buf + 2) = (count >> 8) & 0xff;
+    *(loader->buf + 3) = count & 0xff;
+    p = loader->buf + 4;
+    for (i = 0; i < count; i++)
+      {
+	  struct rtree_bulk_cell *cell = cells + i;
+	  rtree_bulk_put32 (p, (unsigned int) ((cell->id >> 32) & 0xffffffff));
+	  rtree_bulk_put32 (p + 4, (unsigned int) (cell->id & 0xffffffff));
+	  rtree_bulk_put_float (p + 8, cell->minx);
+	  rtree_bulk_put_float (p + 12, cell->maxx);
+	  rtree_bulk_put_float (p + 16, cell->miny);
+	  rtree_bulk_put_float (p + 20, cell->maxy);
+	  p += 24;
+	  if (i == 0)
+	    {
+		parent->minx = cell->minx;
+		parent->maxx = cell->maxx;
+		parent->miny = cell->miny;
+		parent->maxy = cell->maxy;
+	    }
+	  else
+	    {
+		if (cell->minx < parent->minx)
+		    parent->minx = cell->minx;
+		if (cell->maxx > parent->maxx)
+		    parent->maxx = cell->maxx;
+		if (cell->miny < parent->miny)
+		    parent->miny = cell->miny;
+		if (cell->maxy > parent->maxy)
+		    parent->maxy = cell->maxy;
+	    }
+      }
+    parent->id = node_no;
+
+/* inserting the Node itself */
+    if (is_root)
+      {
+	  stmt = loader->stmt_root;
+	  sqlite3_reset (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  sqlite3_bind_blob (stmt, 1, loader->buf, loader->node_size,
+			     SQLITE_STATIC);
+      }
+    else
+      {
+	  stmt = loader->stmt_node;
+	  sqlite3_reset (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  sqlite3_bind_int64 (stmt, 1, node_no);
+	  sqlite3_bind_blob (stmt, 2, loader->buf, loader->node_size,
+			     SQLITE_STATIC);
+      }
+    ret = sqlite3_step (stmt);
+    if (ret != SQLITE_DONE && ret != SQLITE_ROW)
+	return 0;
+
+    if (depth == 0)
+      {
+	  /* ROWID back-references will be inserted later in ROWID order */
+	  for (i = 0; i < count; i++)
+	    {
+		struct rtree_bulk_ref *ref = loader->refs + loader->n_refs;
+		ref->rowid = (cells + i)->id;
+		ref->node_no = node_no;
+		loader->n_refs += 1;
+	    }
+	  return 1;
+      }
+
+/* inserting the PARENT back-references */
+    if (count == loader->max_cells)
+	stmt = loader->stmt_parent;
+    else
+      {
+	  /* a partially filled node: one-shot statement */
+	  stmt =
+	      rtree_bulk_prepare_refs (sqlite, loader->xparent, "parentnode",
+				       count);
+	  if (stmt == NULL)
+	      return 0;
+      }
+    sqlite3_reset (stmt);
+    sqlite3_clear_bindings (stmt);
+    for (i = 0; i < count; i++)
+      {
+	  sqlite3_bind_int64 (stmt, (i * 2) + 1, (cells + i)->id);
+	  sqlite3_bind_int64 (stmt, (i * 2) + 2, node_no);
+      }
+    ret = sqlite3_step (stmt);
+    if (count != loader->max_cells)
+	sqlite3_finalize (stmt);
+    if (ret != SQLITE_DONE && ret != SQLITE_ROW)
+	return 0;
+    return 1;
+}
+
+static int
+cmp_rtree_bulk_refs (const void *p1, const void *p2)
+{
+/* compares two ROWID back-references [for QSORT] */
+    struct rtree_bulk_ref *r1 = (struct rtree_bulk_ref *) p1;
+    struct rtree_bulk_ref *r2 = (struct rtree_bulk_ref *) p2;
+    if (r1->rowid < r2->rowid)
+	return -1;
+    if (r1->rowid > r2->rowid)
+	return 1;
+    return 0;
+}
+
+static int
+rtree_bulk_write_rowids (sqlite3 * sqlite, struct rtree_bulk_loader *loader)
+{
+/* 
+/ inserting all ROWID back-references in ascending order
+/ (appending to the B*Tree is by far faster than random inserts)
+*/
+    sqlite3_stmt *stmt;
+    int base;
+    int i;
+    int ret;
+    qsort (loader->refs, loader->n_refs, sizeof (struct rtree_bulk_ref),
+	   cmp_rtree_bulk_refs);
+    for (base = 0; base < loader->n_refs; base += loader->max_cells)
+      {
+	  int count = loader->n_refs - base;
+	  if (count > loader->max_cells)
+	      count = loader->max_cells;
+	  if (count == loader->max_cells)
+	      stmt = loader->stmt_rowid;
+	  else
+	    {
+		/* the last chunk: one-shot statement */
+		stmt =
+		    rtree_bulk_prepare_refs (sqlite, loader->xrowid, "rowid",
+					     count);
+		if (stmt == NULL)
+		    return 0;
+	    }
+	  sqlite3_reset (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  for (i = 0; i < count; i++)
+	    {
+		struct rtree_bulk_ref *ref = loader->refs + base + i;
+		sqlite3_bind_int64 (stmt, (i * 2) + 1, ref->rowid);
+		sqlite3_bind_int64 (stmt, (i * 2) + 2, ref->node_no);
+	    }
+	  ret = sqlite3_step (stmt);
+	  if (count != loader->max_cells)
+	      sqlite3_finalize (stmt);
+	  if (ret != SQLITE_DONE && ret != SQLITE_ROW)
+	      return 0;
+      }
+    return 1;
+}
+
+static int
+rtree_bulk_prepare (sqlite3 * sqlite, const char *rtree,
+		    struct rtree_bulk_loader *loader)
+{
+/* checking the R*Tree shadow tables and preparing the SQL statements */
+    char *raw;
+    char *quoted;
+    char *sql;
+    int ret;
+    int count = 0;
+    int is_empty = 1;
+    sqlite3_stmt *stmt;
+
+/* the R*Tree should not support any auxiliary column */
+    raw = sqlite3_mprintf ("%s_rowid", rtree);
+    quoted = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    sql = sqlite3_mprintf ("PRAGMA table_info(\"%s\")", quoted);
+    free (quoted);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+	count++;
+    sqlite3_finalize (stmt);
+    if (count != 2)
+	return 0;
+
+/* the R*Tree is expected to be still empty */
+    raw = sqlite3_mprintf ("%s_rowid", rtree);
+    quoted = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    sql = sqlite3_mprintf ("SELECT rowid FROM \"%s\" LIMIT 1", quoted);
+    free (quoted);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+	is_empty = 0;
+    sqlite3_finalize (stmt);
+    if (!is_empty)
+	return 0;
+
+/* retrieving the Node size from the Root node */
+    raw = sqlite3_mprintf ("%s_node", rtree);
+    quoted = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    sql =
+	sqlite3_mprintf ("SELECT length(data) FROM \"%s\" WHERE nodeno = 1",
+			 quoted);
+    free (quoted);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+	loader->node_size = sqlite3_column_int (stmt, 0);
+    sqlite3_finalize (stmt);
+    loader->max_cells = (loader->node_size - 4) / 24;
+    if (loader->max_cells < 3)
+	return 0;
+    loader->buf = malloc (loader->node_size);
+    loader->next_node = 2;
+
+/* preparing the INSERT statements */
+    raw = sqlite3_mprintf ("%s_node", rtree);
+    quoted = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    sql = sqlite3_mprintf ("UPDATE \"%s\" SET data = ? WHERE nodeno = 1",
+			   quoted);
+    ret =
+	sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &(loader->stmt_root),
+			    NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  free (quoted);
+	  return 0;
+      }
+    sql =
+	sqlite3_mprintf ("INSERT INTO \"%s\" (nodeno, data) VALUES (?, ?)",
+			 quoted);
+    free (quoted);
+    ret =
+	sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &(loader->stmt_node),
+			    NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    raw = sqlite3_mprintf ("%s_parent", rtree);
+    loader->xparent = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    loader->stmt_parent =
+	rtree_bulk_prepare_refs (sqlite, loader->xparent, "parentnode",
+				 loader->max_cells);
+    if (loader->stmt_parent == NULL)
+	return 0;
+    raw = sqlite3_mprintf ("%s_rowid", rtree);
+    loader->xrowid = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    loader->stmt_rowid =
+	rtree_bulk_prepare_refs (sqlite, loader->xrowid, "rowid",
+				 loader->max_cells);
+    if (loader->stmt_rowid == NULL)
+	return 0;
+    return 1;
+}
+
+static int
+bulkBuildSpatialIndex (sqlite3 * sqlite, const char *table,
+		       const char *column)
+{
+/*
+/ attempting to bulk load an empty SpatialIndex [RTree]
+/
+/ the MBRs are directly decoded from the BLOB headers, then
+/ they are STR-sorted and written as fully packed nodes
+/ directly into the R*Tree shadow tables
+/
+/ returns 1 on success, 0 if the ordinary INSERT path 
+/ should be used instead
+*/
+    struct rtree_bulk_loader loader;
+    struct rtree_bulk_cell *cells = NULL;
+    struct rtree_bulk_cell *parents;
+    struct rtree_bulk_cell root;
+    int count = 0;
+    int allocated = 0;
+    int depth = 0;
+    int savepoint = 0;
+    int i;
+    char *rtree;
+    char *quoted_table;
+    char *quoted_column;
+    char *sql;
+    int ret;
+    sqlite3_stmt *stmt;
+    int result = 0;
+
+    memset (&loader, 0, sizeof (struct rtree_bulk_loader));
+    rtree = sqlite3_mprintf ("idx_%s_%s", table, column);
+    if (!rtree_bulk_prepare (sqlite, rtree, &loader))
+	goto stop;
+
+/* loading all MBRs */
+    quoted_table = gaiaDoubleQuotedSql (table);
+    quoted_column = gaiaDoubleQuotedSql (column);
+    sql = sqlite3_mprintf ("SELECT ROWID, \"%s\" FROM \"%s\"", quoted_column,
+			   quoted_table);
+    free (quoted_table);
+    free (quoted_column);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto stop;
+    while (1)
+      {
+	  struct rtree_bulk_cell *cell;
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;
+	  if (ret != SQLITE_ROW)
+	    {
+		sqlite3_finalize (stmt);
+		goto stop;
+	    }
+	  if (sqlite3_column_type (stmt, 1) != SQLITE_BLOB)
+	      continue;
+	  if (count >= allocated)
+	    {
+		struct rtree_bulk_cell *save = cells;
+		allocated = (allocated == 0) ? 4096 : allocated * 2;
+		cells =
+		    realloc (cells,
+			     sizeof (struct rtree_bulk_cell) * allocated);
+		if (cells == NULL)
+		  {
+		      cells = save;
+		      sqlite3_finalize (stmt);
+		      goto stop;
+		  }
+	    }
+	  cell = cells + count;
+	  if (!rtree_bulk_get_mbr
+	      (sqlite3_column_blob (stmt, 1), sqlite3_column_bytes (stmt, 1),
+	       cell))
+	      continue;
+	  if (cell->minx > cell->maxx || cell->miny > cell->maxy)
+	    {
+		/* invalid MBR: leaving the R*Tree module to raise the error */
+		sqlite3_finalize (stmt);
+		goto stop;
+	    }
+	  cell->id = sqlite3_column_int64 (stmt, 0);
+	  count++;
+      }
+    sqlite3_finalize (stmt);
+
+/* building the Tree bottom-up, one level at each time */
+    if (count > 0)
+      {
+	  loader.refs = malloc (sizeof (struct rtree_bulk_ref) * count);
+	  if (loader.refs == NULL)
+	      goto stop;
+      }
+    if (sqlite3_exec
+	(sqlite, "SAVEPOINT rtree_bulk_load", NULL, NULL, NULL) != SQLITE_OK)
+	goto stop;
+    savepoint = 1;
+    while (count > loader.max_cells)
+      {
+	  int nodes = (count + loader.max_cells - 1) / loader.max_cells;
+	  rtree_bulk_str_sort (cells, count, loader.max_cells);
+	  parents = malloc (sizeof (struct rtree_bulk_cell) * nodes);
+	  if (parents == NULL)
+	      goto stop;
+	  for (i = 0; i < nodes; i++)
+	    {
+		int base = i * loader.max_cells;
+		int n = count - base;
+		if (n > loader.max_cells)
+		    n = loader.max_cells;
+		if (!rtree_bulk_write_node
+		    (sqlite, &loader, cells + base, n, depth, 0, parents + i))
+		  {
+		      free (parents);
+		      goto stop;
+		  }
+	    }
+	  free (cells);
+	  cells = parents;
+	  count = nodes;
+	  depth++;
+      }
+    if (!rtree_bulk_write_node
+	(sqlite, &loader, cells, count, depth, 1, &root))
+	goto stop;
+    if (!rtree_bulk_write_rowids (sqlite, &loader))
+	goto stop;
+    result = 1;
+
+  stop:
+    if (cells != NULL)
+	free (cells);
+    if (savepoint)
+      {
+	  if (!result)
+	      sqlite3_exec (sqlite, "ROLLBACK TO SAVEPOINT rtree_bulk_load",
+			    NULL, NULL, NULL);
+	  sqlite3_exec (sqlite, "RELEASE SAVEPOINT rtree_bulk_load", NULL,
+			NULL, NULL);
+      }
+    if (loader.buf != NULL)
+	free (loader.buf);
+    if (loader.stmt_root != NULL)
+	sqlite3_finalize (loader.stmt_root);
+    if (loader.stmt_node != NULL)
+	sqlite3_finalize (loader.stmt_node);
+    if (loader.stmt_parent != NULL)
+	sqlite3_finalize (loader.stmt_parent);
+    if (loader.stmt_rowid != NULL)
+	sqlite3_finalize (loader.stmt_rowid);
+    if (loader.xparent != NULL)
+	free (loader.xparent);
+    if (loader.xrowid != NULL)
+	free (loader.xrowid);
+    if (loader.refs != NULL)
+	free (loader.refs);
+    sqlite3_free (rtree);
+    return result;
+}
+
+SPATIALITE_PRIVATE int
+truncateSpatialIndex (void *p_sqlite, const char *table, const char *column)
+{
+/* 
+/ quickly emptying a SpatialIndex [RTree] by directly resetting
+/ its shadow tables (deleting row by row is painfully slow)
+/
+/ returns 1 on success, 0 on failure
+*/
+    sqlite3 *sqlite = (sqlite3 *) p_sqlite;
+    char *rtree;
+    char *raw;
+    char *quoted_node;
+    char *quoted_parent;
+    char *quoted_rowid;
+    char *sql;
+    int ret;
+
+    rtree = sqlite3_mprintf ("idx_%s_%s", table, column);
+    raw = sqlite3_mprintf ("%s_node", rtree);
+    quoted_node = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    raw = sqlite3_mprintf ("%s_parent", rtree);
+    quoted_parent = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    raw = sqlite3_mprintf ("%s_rowid", rtree);
+    quoted_rowid = gaiaDoubleQuotedSql (raw);
+    sqlite3_free (raw);
+    sqlite3_free (rtree);
+    sql = sqlite3_mprintf ("SAVEPOINT rtree_truncate;"
+			   "DELETE FROM \"%s\" WHERE nodeno <> 1;"
+			   "UPDATE \"%s\" SET data = zeroblob(length(data)) "
+			   "WHERE nodeno = 1;"
+			   "DELETE FROM \"%s\";"
+			   "DELETE FROM \"%s\";"
+			   "RELEASE SAVEPOINT rtree_truncate",
+			   quoted_node, quoted_node, quoted_parent,
+			   quoted_rowid);
+    free (quoted_node);
+    free (quoted_parent);
+    free (quoted_rowid);
+    ret = sqlite3_exec (sqlite, sql, NULL, NULL, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  sqlite3_exec (sqlite, "ROLLBACK TO SAVEPOINT rtree_truncate;"
+			"RELEASE SAVEPOINT rtree_truncate", NULL, NULL, NULL);
+	  return 0;
+      }
+    return 1;
+}
+
+static int
+cmp_deferred_rtree_pkid (const void *p1, const void *p2)
+{
+/* compares two pending R*Tree entries by PKID and queuing order [for QSORT] */
+    struct splite_deferred_rtree_item *i1 =
+	(struct splite_deferred_rtree_item *) p1;
+    struct splite_deferred_rtree_item *i2 =
+	(struct splite_deferred_rtree_item *) p2;
+    if (i1->pkid < i2->pkid)
+	return -1;
+    if (i1->pkid > i2->pkid)
+	return 1;
+    if (i1->seq < i2->seq)
+	return -1;
+    if (i1->seq > i2->seq)
+	return 1;
+    return 0;
+}
+
+static int
+deferred_rtree_refresh (sqlite3 * sqlite, struct splite_deferred_rtree *rtree)
+{
+/*
+/ re-reading the current MBR of each pending entry from the
+/ main table, so that rows later updated or deleted within
+/ the same transaction will be correctly handled
+/
+/ returns 0 on failure
+*/
+    char *sql;
+    char *table = NULL;
+    char *column = NULL;
+    char *quoted_table;
+    char *quoted_column;
+    int ret;
+    int i;
+    int count = 0;
+    sqlite3_stmt *stmt;
+
+/* identifying the Geometry supported by this R*Tree */
+    sql = "SELECT f_table_name, f_geometry_column FROM geometry_columns "
+	"WHERE spatial_index_enabled = 1 AND "
+	"Upper('idx_' || f_table_name || '_' || f_geometry_column) = Upper(?)";
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    if (ret != SQLITE_OK)
+	return 1;		/* not a SpatiaLite DB: using the queued MBRs */
+    sqlite3_bind_text (stmt, 1, rtree->rtree_name,
+		       strlen (rtree->rtree_name), SQLITE_STATIC);
+    while (1)
+      {
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;
+	  if (ret == SQLITE_ROW)
+	    {
+		if (table == NULL)
+		  {
+		      table =
+			  sqlite3_mprintf ("%s",
+					   sqlite3_column_text (stmt, 0));
+		      column =
+			  sqlite3_mprintf ("%s",
+					   sqlite3_column_text (stmt, 1));
+		  }
+	    }
+	  else
+	      break;
+      }
+    sqlite3_finalize (stmt);
+    if (table == NULL)
+	return 1;		/* unknown Geometry: using the queued MBRs */
+
+    quoted_table = gaiaDoubleQuotedSql (table);
+    quoted_column = gaiaDoubleQuotedSql (column);
+    sqlite3_free (table);
+    sqlite3_free (column);
+    sql = sqlite3_mprintf ("SELECT \"%s\" FROM \"%s\" WHERE ROWID = ?",
+			   quoted_column, quoted_table);
+    free (quoted_table);
+    free (quoted_column);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    for (i = 0; i < rtree->count; i++)
+      {
+	  struct splite_deferred_rtree_item *item = rtree->items + i;
+	  struct rtree_bulk_cell cell;
+	  sqlite3_reset (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  sqlite3_bind_int64 (stmt, 1, item->pkid);
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      continue;		/* deleted row */
+	  if (ret != SQLITE_ROW)
+	    {
+		sqlite3_finalize (stmt);
+		return 0;
+	    }
+	  if (sqlite3_column_type (stmt, 0) != SQLITE_BLOB)
+	      continue;		/* NULL Geometry */
+	  if (!rtree_bulk_get_mbr
+	      (sqlite3_column_blob (stmt, 0), sqlite3_column_bytes (stmt, 0),
+	       &cell))
+	      continue;
+	  item = rtree->items + count;
+	  item->pkid = rtree->items[i].pkid;
+	  item->minx = cell.minx;
+	  item->miny = cell.miny;
+	  item->maxx = cell.maxx;
+	  item->maxy = cell.maxy;
+	  count++;
+      }
+    sqlite3_finalize (stmt);
+    rtree->count = count;
+    return 1;
+}
+
+static int
+deferred_rtree_apply (sqlite3 * sqlite, struct splite_deferred_rtree *rtree)
+{
+/* 
+/ applying all pending entries of a single R*Tree
+/
+/ returns the number of written entries, -1 on failure
+*/
+    char *quoted_rtree;
+    char *sql;
+    int ret;
+    int i;
+    int count = 0;
+    sqlite3_stmt *stmt;
+    struct splite_deferred_rtree_item *items = rtree->items;
+
+/* 
+/ sorting by PKID: only the last queued entry of each PKID is
+/ significant, and the R*Tree "_rowid" shadow table will then
+/ be written in ascending order (way faster than any spatial 
+/ ordering of the entries)
+*/
+    qsort (items, rtree->count, sizeof (struct splite_deferred_rtree_item),
+	   cmp_deferred_rtree_pkid);
+    for (i = 0; i < rtree->count; i++)
+      {
+	  if (i + 1 < rtree->count && items[i + 1].pkid == items[i].pkid)
+	      continue;
+	  items[count++] = items[i];
+      }
+    rtree->count = count;
+    if (!deferred_rtree_refresh (sqlite, rtree))
+	return -1;
+
+    quoted_rtree = gaiaDoubleQuotedSql (rtree->rtree_name);
+    sql =
+	sqlite3_mprintf
+	("INSERT OR REPLACE INTO \"%s\" (pkid, xmin, ymin, xmax, ymax) "
+	 "VALUES (?, ?, ?, ?, ?)", quoted_rtree);
+    free (quoted_rtree);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return -1;
+    count = 0;
+    for (i = 0; i < rtree->count; i++)
+      {
+	  struct splite_deferred_rtree_item *item = items + i;
+	  sqlite3_reset (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  sqlite3_bind_int64 (stmt, 1, item->pkid);
+	  sqlite3_bind_double (stmt, 2, item->minx);
+	  sqlite3_bind_double (stmt, 3, item->miny);
+	  sqlite3_bind_double (stmt, 4, item->maxx);
+	  sqlite3_bind_double (stmt, 5, item->maxy);
+	  ret = sqlite3_step (stmt);
+	  if (ret != SQLITE_DONE && ret != SQLITE_ROW)
+	    {
+		sqlite3_finalize (stmt);
+		return -1;
+	    }
+	  count++;
+      }
+    sqlite3_finalize (stmt);
+    return count;
+}
+
+SPATIALITE_PRIVATE int
+flushDeferredSpatialIndex (void *p_sqlite, const void *p_cache)
+{
+/*
+/ applying all the R*Tree entries queued by RTreeAlign()
+/ while in deferred SpatialIndex mode; each R*Tree is
+/ updated in a single sorted batch, using the same
+/ prepared statement for all its entries
+/
+/ the queue is only emptied on success: on failure all
+/ R*Tree changes are rolled back and the pending entries
+/ are retained, so that COMMIT will still fail
+/
+/ returns the number of written entries, -1 on failure
+/ (or if some entry has been lost while queuing)
+*/
+    sqlite3 *sqlite = (sqlite3 *) p_sqlite;
+    struct splite_internal_cache *cache =
+	(struct splite_internal_cache *) p_cache;
+    struct splite_deferred_rtree *rtree;
+    int total = 0;
+    int count;
+
+    if (cache->first_deferred_rtree == NULL)
+	return (cache->deferred_rtree_lost) ? -1 : 0;
+    if (sqlite3_exec
+	(sqlite, "SAVEPOINT rtree_deferred_flush", NULL, NULL,
+	 NULL) != SQLITE_OK)
+	return -1;
+    rtree = cache->first_deferred_rtree;
+    while (rtree != NULL)
+      {
+	  count = deferred_rtree_apply (sqlite, rtree);
+	  if (count < 0)
+	    {
+		total = -1;
+		break;
+	    }
+	  total += count;
+	  rtree = rtree->next;
+      }
+    if (total < 0)
+	sqlite3_exec (sqlite,
+		      "ROLLBACK TO SAVEPOINT rtree_deferred_flush", NULL,
+		      NULL, NULL);
+    else
+	reset_deferred_rtrees (cache);
+    sqlite3_exec (sqlite, "RELEASE SAVEPOINT rtree_deferred_flush", NULL,
+		  NULL, NULL);
+    if (cache->deferred_rtree_lost)
+	return -1;
+    return total;
+}
+
 SPATIALITE_PRIVATE int
 buildSpatialIndexEx (void *p_sqlite, const unsigned char *table,
 		     const char *column)
@@ -4124,6 +5068,10 @@ buildSpatialIndexEx (void *p_sqlite, const unsigned char *table,
 	  return -2;
       }
 
+    if (bulkBuildSpatialIndex (sqlite, (const char *) table, column))
+	return 0;
+
+/* falling back to the ordinary R*Tree INSERT path */
     raw = sqlite3_mprintf ("idx_%s_%s", table, column);
     quoted_rtree = gaiaDoubleQuotedSql (raw);
     sqlite3_free (raw);
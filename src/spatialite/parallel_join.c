@@ -0,0 +1,1079 @@
+/*
+
+ parallel_join.c -- Parallel Spatial Join on worker connections
+
+ version 5.0, 2020 August 1
+
+ Author: Sandro Furieri a.furieri@lqt.it
+
+ ------------------------------------------------------------------------------
+
+ Version: MPL 1.1/GPL 2.0/LGPL 2.1
+
+ The contents of this file are subject to the Mozilla Public License Version
+ 1.1 (the "License"); you may not use this file except in compliance with
+ the License. You may obtain a copy of the License at
+ http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS" basis,
+WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+for the specific language governing rights and limitations under the
+License.
+
+The Original Code is the SpatiaLite library
+
+The Initial Developer of the Original Code is Alessandro Furieri
+
+Portions created by the Initial Developer are Copyright (C) 2020
+the Initial Developer. All Rights Reserved.
+
+Contributor(s):
+
+Alternatively, the contents of this file may be used under the terms of
+either the GNU General Public License Version 2 or later (the "GPL"), or
+the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+in which case the provisions of the GPL or the LGPL are applicable instead
+of those above. If you wish to allow use of your version of this file only
+under the terms of either the GPL or the LGPL, and not to allow others to
+use your version of this file under the terms of the MPL, indicate your
+decision by deleting the provisions above and replace them with the notice
+and other provisions required by the GPL or the LGPL. If you do not delete
+the provisions above, a recipient may use your version of this file under
+the terms of any one of the MPL, the GPL or the LGPL.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#if defined(_WIN32) && !defined(__MINGW32__)
+#include "config-msvc.h"
+#else
+#include "config.h"
+#endif
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+#include <spatialite/sqlite.h>
+#include <spatialite/debug.h>
+#include <spatialite/gaiaaux.h>
+
+#include <spatialite.h>
+#include <spatialite_private.h>
+
+#ifdef _WIN32
+#define strcasecmp	_stricmp
+#define strncasecmp	_strnicmp
+#endif /* not WIN32 */
+
+#define PAR_JOIN_MAX_THREADS		64
+#define PAR_JOIN_TASKS_PER_THREAD	16
+#define PAR_JOIN_CHUNK_PAIRS		4096
+#define PAR_JOIN_CHUNKS_PER_THREAD	4
+
+struct par_join_predicate
+{
+/* a supported Spatial Predicate */
+    const char *name;
+    const char *sql_name;
+    int requires_geos;
+};
+
+static struct par_join_predicate par_join_predicates[] = {
+    {"Intersects", "ST_Intersects", 1},
+    {"Contains", "ST_Contains", 1},
+    {"Within", "ST_Within", 1},
+    {"Touches", "ST_Touches", 1},
+    {"Crosses", "ST_Crosses", 1},
+    {"Overlaps", "ST_Overlaps", 1},
+    {"Covers", "ST_Covers", 1},
+    {"CoveredBy", "ST_CoveredBy", 1},
+    {"Equals", "ST_Equals", 1},
+    {"MbrIntersects", "MbrIntersects", 0},
+    {"MbrContains", "MbrContains", 0},
+    {"MbrWithin", "MbrWithin", 0},
+    {"MbrOverlaps", "MbrOverlaps", 0},
+    {"MbrTouches", "MbrTouches", 0},
+    {"MbrEqual", "MbrEqual", 0},
+    {NULL, NULL, 0}
+};
+
+struct par_join_task
+{
+/*
+/ a partition of the Left table:
+/ - a grid cell containing the lower-left corner of the R*Tree
+/   entries (when the Left table has a Spatial Index)
+/ - a range of ROWIDs (when the Left table has no Spatial Index)
+*/
+    double minx;
+    double miny;
+    double maxx;
+    double maxy;
+    sqlite3_int64 min_rowid;
+    sqlite3_int64 max_rowid;
+};
+
+struct par_join_chunk
+{
+/* a block of joined (left, right) ROWID pairs */
+    sqlite3_int64 *pairs;
+    int count;
+    struct par_join_chunk *next;
+};
+
+struct par_join
+{
+/* the Parallel Spatial Join */
+    const char *db_path;
+    char *sql;
+    int grid_mode;
+    struct par_join_task *tasks;
+    int n_tasks;
+    int next_task;
+    int abort;
+    char *error;
+#ifndef _WIN32
+    pthread_mutex_t mutex;
+    pthread_cond_t produced;
+    pthread_cond_t consumed;
+    struct par_join_chunk *first;
+    struct par_join_chunk *last;
+    int n_chunks;
+    int max_chunks;
+    int n_running;
+    int n_ready;
+#endif
+};
+
+static void
+par_join_set_error (const void *ctx, const char *errmsg)
+{
+/* setting the ParallelSpatialJoin Last Error Message */
+    struct splite_internal_cache *cache = (struct splite_internal_cache *) ctx;
+    if (cache != NULL)
+      {
+	  int len;
+	  if (cache->parallelJoinError != NULL)
+	    {
+		free (cache->parallelJoinError);
+		cache->parallelJoinError = NULL;
+	    }
+	  if (errmsg == NULL)
+	      return;
+
+	  len = strlen (errmsg);
+	  cache->parallelJoinError = malloc (len + 1);
+	  strcpy (cache->parallelJoinError, errmsg);
+      }
+}
+
+SPATIALITE_DECLARE const char *
+gaia_parallel_spatial_join_get_last_error (const void *p_cache)
+{
+/* return the last ParallelSpatialJoin Error Message (if any) */
+    struct splite_internal_cache *cache =
+	(struct splite_internal_cache *) p_cache;
+
+    if (cache == NULL)
+	return NULL;
+    return cache->parallelJoinError;
+}
+
+static const struct par_join_predicate *
+par_join_find_predicate (const char *predicate)
+{
+/* searching a supported Spatial Predicate (ST_ prefix is optional) */
+    const struct par_join_predicate *p = par_join_predicates;
+    if (strncasecmp (predicate, "ST_", 3) == 0)
+	predicate += 3;
+    while (p->name != NULL)
+      {
+	  if (strcasecmp (p->name, predicate) == 0)
+	      return p;
+	  p++;
+      }
+    return NULL;
+}
+
+static int
+par_join_check_geometry (sqlite3 * sqlite, const char *table,
+			 const char *geometry, int *spatial_index)
+{
+/* checking if some Geometry Column exists and has a R*Tree */
+    char *sql;
+    char **results;
+    int rows;
+    int columns;
+    int i;
+    int ret;
+    int ok = 0;
+    sql =
+	sqlite3_mprintf
+	("SELECT spatial_index_enabled FROM main.geometry_columns "
+	 "WHERE Upper(f_table_name) = Upper(%Q) AND "
+	 "Upper(f_geometry_column) = Upper(%Q)", table, geometry);
+    ret = sqlite3_get_table (sqlite, sql, &results, &rows, &columns, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    for (i = 1; i <= rows; i++)
+      {
+	  ok = 1;
+	  *spatial_index = atoi (results[(i * columns) + 0]) == 1 ? 1 : 0;
+      }
+    sqlite3_free_table (results);
+    return ok;
+}
+
+static int
+par_join_check_out_table (sqlite3 * sqlite, const char *out_table)
+{
+/* checking if the output table already exists */
+    char *sql;
+    char **results;
+    int rows;
+    int columns;
+    int ret;
+    sql =
+	sqlite3_mprintf
+	("SELECT name FROM main.sqlite_master WHERE Upper(name) = Upper(%Q)",
+	 out_table);
+    ret = sqlite3_get_table (sqlite, sql, &results, &rows, &columns, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    sqlite3_free_table (results);
+    if (rows > 0)
+	return 0;
+    return 1;
+}
+
+static int
+par_join_grid_tasks (sqlite3 * sqlite, struct par_join *join,
+		     const char *idx_name, int n_wanted)
+{
+/* partitioning the Left table by grid cells */
+    char *xidx;
+    char *sql;
+    sqlite3_stmt *stmt = NULL;
+    int ret;
+    int ok = 0;
+    double minx = 0.0;
+    double miny = 0.0;
+    double maxx = 0.0;
+    double maxy = 0.0;
+    int side;
+    int row;
+    int col;
+    int i;
+
+    xidx = gaiaDoubleQuotedSql (idx_name);
+    sql =
+	sqlite3_mprintf
+	("SELECT Min(xmin), Min(ymin), Max(xmin), Max(ymin) FROM main.\"%s\"",
+	 xidx);
+    free (xidx);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    while (1)
+      {
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;
+	  if (ret != SQLITE_ROW)
+	    {
+		sqlite3_finalize (stmt);
+		return 0;
+	    }
+	  if (sqlite3_column_type (stmt, 0) == SQLITE_NULL)
+	      continue;
+	  minx = sqlite3_column_double (stmt, 0);
+	  miny = sqlite3_column_double (stmt, 1);
+	  maxx = sqlite3_column_double (stmt, 2);
+	  maxy = sqlite3_column_double (stmt, 3);
+	  ok = 1;
+      }
+    sqlite3_finalize (stmt);
+    if (!ok)
+      {
+	  /* empty Spatial Index */
+	  join->n_tasks = 0;
+	  return 1;
+      }
+
+/*
+/ the lower-left corner of each R*Tree entry falls in exactly
+/ one cell, because cells are half-open and the outermost ones
+/ are unbounded: so no Left feature can ever be joined twice
+*/
+    side = (int) ceil (sqrt ((double) n_wanted));
+    if (side < 1)
+	side = 1;
+    join->tasks = malloc (sizeof (struct par_join_task) * side * side);
+    if (join->tasks == NULL)
+	return 0;
+    i = 0;
+    for (row = 0; row < side; row++)
+      {
+	  for (col = 0; col < side; col++)
+	    {
+		struct par_join_task *task = join->tasks + i++;
+		task->minx =
+		    (col == 0) ? -DBL_MAX : minx + ((maxx - minx) * col) / side;
+		task->maxx =
+		    (col == side - 1) ? DBL_MAX : minx +
+		    ((maxx - minx) * (col + 1)) / side;
+		task->miny =
+		    (row == 0) ? -DBL_MAX : miny + ((maxy - miny) * row) / side;
+		task->maxy =
+		    (row == side - 1) ? DBL_MAX : miny +
+		    ((maxy - miny) * (row + 1)) / side;
+		task->min_rowid = 0;
+		task->max_rowid = 0;
+	    }
+      }
+    join->n_tasks = i;
+    return 1;
+}
+
+static int
+par_join_rowid_tasks (sqlite3 * sqlite, struct par_join *join,
+		      const char *left_table, int n_wanted)
+{
+/* partitioning the Left table by ROWID ranges */
+    char *xtable;
+    char *sql;
+    sqlite3_stmt *stmt = NULL;
+    int ret;
+    int ok = 0;
+    sqlite3_int64 min_rowid = 0;
+    sqlite3_int64 max_rowid = 0;
+    sqlite3_int64 step;
+    sqlite3_int64 base;
+    int i;
+
+    xtable = gaiaDoubleQuotedSql (left_table);
+    sql =
+	sqlite3_mprintf ("SELECT Min(ROWID), Max(ROWID) FROM main.\"%s\"",
+			 xtable);
+    free (xtable);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    while (1)
+      {
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;
+	  if (ret != SQLITE_ROW)
+	    {
+		sqlite3_finalize (stmt);
+		return 0;
+	    }
+	  if (sqlite3_column_type (stmt, 0) == SQLITE_NULL)
+	      continue;
+	  min_rowid = sqlite3_column_int64 (stmt, 0);
+	  max_rowid = sqlite3_column_int64 (stmt, 1);
+	  ok = 1;
+      }
+    sqlite3_finalize (stmt);
+    if (!ok)
+      {
+	  /* empty table */
+	  join->n_tasks = 0;
+	  return 1;
+      }
+
+    step = ((max_rowid - min_rowid) / n_wanted) + 1;
+    join->tasks = malloc (sizeof (struct par_join_task) * n_wanted);
+    if (join->tasks == NULL)
+	return 0;
+    i = 0;
+    base = min_rowid;
+    while (base <= max_rowid && i < n_wanted)
+      {
+	  struct par_join_task *task = join->tasks + i++;
+	  task->minx = 0.0;
+	  task->miny = 0.0;
+	  task->maxx = 0.0;
+	  task->maxy = 0.0;
+	  task->min_rowid = base;
+	  if (max_rowid - base < step)
+	      task->max_rowid = max_rowid;
+	  else
+	      task->max_rowid = base + step - 1;
+	  if (task->max_rowid == max_rowid)
+	      break;
+	  base = task->max_rowid + 1;
+      }
+    join->n_tasks = i;
+    return 1;
+}
+
+static char *
+par_join_build_sql (const char *left_table, const char *left_geom,
+		    const char *left_idx, const char *right_table,
+		    const char *right_geom, const char *right_idx,
+		    const char *predicate)
+{
+/* building the SQL query evaluating a single partition */
+    char *sql;
+    char *prev;
+    char *xltable = gaiaDoubleQuotedSql (left_table);
+    char *xlgeom = gaiaDoubleQuotedSql (left_geom);
+    char *xrtable = gaiaDoubleQuotedSql (right_table);
+    char *xrgeom = gaiaDoubleQuotedSql (right_geom);
+    char *xridx = gaiaDoubleQuotedSql (right_idx);
+    sql =
+	sqlite3_mprintf
+	("SELECT l.ROWID, r.ROWID FROM main.\"%s\" AS l, main.\"%s\" AS r "
+	 "WHERE ", xltable, xrtable);
+    prev = sql;
+    if (left_idx != NULL)
+      {
+	  char *xlidx = gaiaDoubleQuotedSql (left_idx);
+	  sql =
+	      sqlite3_mprintf
+	      ("%sl.ROWID IN (SELECT pkid FROM main.\"%s\" WHERE "
+	       "xmin >= ? AND xmin < ? AND ymin >= ? AND ymin < ?) ", prev,
+	       xlidx);
+	  free (xlidx);
+      }
+    else
+	sql = sqlite3_mprintf ("%sl.ROWID BETWEEN ? AND ? ", prev);
+    sqlite3_free (prev);
+    prev = sql;
+    sql =
+	sqlite3_mprintf
+	("%sAND r.ROWID IN (SELECT pkid FROM main.\"%s\" WHERE "
+	 "xmin <= MbrMaxX(l.\"%s\") AND xmax >= MbrMinX(l.\"%s\") AND "
+	 "ymin <= MbrMaxY(l.\"%s\") AND ymax >= MbrMinY(l.\"%s\")) "
+	 "AND %s(l.\"%s\", r.\"%s\") = 1", prev, xridx, xlgeom, xlgeom,
+	 xlgeom, xlgeom, predicate, xlgeom, xrgeom);
+    sqlite3_free (prev);
+    free (xltable);
+    free (xlgeom);
+    free (xrtable);
+    free (xrgeom);
+    free (xridx);
+    return sql;
+}
+
+static void
+par_join_bind_task (sqlite3_stmt * stmt, struct par_join *join,
+		    struct par_join_task *task)
+{
+/* binding the current partition */
+    sqlite3_reset (stmt);
+    sqlite3_clear_bindings (stmt);
+    if (join->grid_mode)
+      {
+	  sqlite3_bind_double (stmt, 1, task->minx);
+	  sqlite3_bind_double (stmt, 2, task->maxx);
+	  sqlite3_bind_double (stmt, 3, task->miny);
+	  sqlite3_bind_double (stmt, 4, task->maxy);
+      }
+    else
+      {
+	  sqlite3_bind_int64 (stmt, 1, task->min_rowid);
+	  sqlite3_bind_int64 (stmt, 2, task->max_rowid);
+      }
+}
+
+static int
+par_join_serial (sqlite3 * sqlite, struct par_join *join,
+		 sqlite3_stmt * stmt_out, sqlite3_int64 * count)
+{
+/*
+/ evaluating all partitions on the current connection
+/ (in-memory DBs or no thread support)
+*/
+    sqlite3_stmt *stmt = NULL;
+    int ret;
+    int i;
+    ret =
+	sqlite3_prepare_v2 (sqlite, join->sql, strlen (join->sql), &stmt, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  join->error = sqlite3_mprintf ("%s", sqlite3_errmsg (sqlite));
+	  return 0;
+      }
+    for (i = 0; i < join->n_tasks; i++)
+      {
+	  par_join_bind_task (stmt, join, join->tasks + i);
+	  while (1)
+	    {
+		ret = sqlite3_step (stmt);
+		if (ret == SQLITE_DONE)
+		    break;
+		if (ret != SQLITE_ROW)
+		  {
+		      join->error =
+			  sqlite3_mprintf ("%s", sqlite3_errmsg (sqlite));
+		      sqlite3_finalize (stmt);
+		      return 0;
+		  }
+		sqlite3_reset (stmt_out);
+		sqlite3_clear_bindings (stmt_out);
+		sqlite3_bind_int64 (stmt_out, 1,
+				    sqlite3_column_int64 (stmt, 0));
+		sqlite3_bind_int64 (stmt_out, 2,
+				    sqlite3_column_int64 (stmt, 1));
+		ret = sqlite3_step (stmt_out);
+		if (ret != SQLITE_DONE && ret != SQLITE_ROW)
+		  {
+		      join->error =
+			  sqlite3_mprintf ("%s", sqlite3_errmsg (sqlite));
+		      sqlite3_finalize (stmt);
+		      return 0;
+		  }
+		*count += 1;
+	    }
+      }
+    sqlite3_finalize (stmt);
+    return 1;
+}
+
+#ifndef _WIN32			/* POSIX threads: supporting parallel execution */
+
+static void
+par_join_set_thread_error (struct par_join *join, const char *msg)
+{
+/* recording the first error raised by some worker thread */
+    pthread_mutex_lock (&(join->mutex));
+    if (join->error == NULL)
+	join->error = sqlite3_mprintf ("%s", msg);
+    join->abort = 1;
+    pthread_cond_broadcast (&(join->produced));
+    pthread_cond_broadcast (&(join->consumed));
+    pthread_mutex_unlock (&(join->mutex));
+}
+
+static int
+par_join_push_chunk (struct par_join *join, struct par_join_chunk *chunk)
+{
+/* handing over a block of pairs to the writer */
+    int ok = 1;
+    pthread_mutex_lock (&(join->mutex));
+    while (join->n_chunks >= join->max_chunks && !join->abort)
+	pthread_cond_wait (&(join->consumed), &(join->mutex));
+    if (join->abort)
+	ok = 0;
+    else
+      {
+	  if (join->first == NULL)
+	      join->first = chunk;
+	  if (join->last != NULL)
+	      join->last->next = chunk;
+	  join->last = chunk;
+	  join->n_chunks += 1;
+	  pthread_cond_signal (&(join->produced));
+      }
+    pthread_mutex_unlock (&(join->mutex));
+    return ok;
+}
+
+static struct par_join_chunk *
+par_join_alloc_chunk (void)
+{
+/* allocating an empty block of pairs */
+    struct par_join_chunk *chunk = malloc (sizeof (struct par_join_chunk));
+    if (chunk == NULL)
+	return NULL;
+    chunk->pairs = malloc (sizeof (sqlite3_int64) * 2 * PAR_JOIN_CHUNK_PAIRS);
+    if (chunk->pairs == NULL)
+      {
+	  free (chunk);
+	  return NULL;
+      }
+    chunk->count = 0;
+    chunk->next = NULL;
+    return chunk;
+}
+
+static void
+par_join_free_chunk (struct par_join_chunk *chunk)
+{
+/* memory cleanup - destroying a block of pairs */
+    if (chunk == NULL)
+	return;
+    free (chunk->pairs);
+    free (chunk);
+}
+
+static void *
+par_join_worker_thread (void *arg)
+{
+/* a worker thread: evaluating partitions on its own connection */
+    struct par_join *join = (struct par_join *) arg;
+    sqlite3 *handle = NULL;
+    void *cache = NULL;
+    sqlite3_stmt *stmt = NULL;
+    struct par_join_chunk *chunk = NULL;
+    int ret;
+    int index;
+
+    ret =
+	sqlite3_open_v2 (join->db_path, &handle,
+			 SQLITE_OPEN_READONLY | SQLITE_OPEN_FULLMUTEX, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  par_join_set_thread_error (join, sqlite3_errmsg (handle));
+	  sqlite3_close (handle);
+	  handle = NULL;
+	  goto end;
+      }
+    cache = spatialite_alloc_connection ();
+    spatialite_internal_init (handle, cache);
+
+/*
+/ starting a read transaction and immediately acquiring a SHARED
+/ lock; the writer will never start INSERTing before all workers
+/ are ready, so that a pending lock can never lock them out
+*/
+    ret =
+	sqlite3_exec (handle,
+		      "BEGIN; SELECT Count(*) FROM main.sqlite_master", NULL,
+		      NULL, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  par_join_set_thread_error (join, sqlite3_errmsg (handle));
+	  goto end;
+      }
+    ret =
+	sqlite3_prepare_v2 (handle, join->sql, strlen (join->sql), &stmt,
+			    NULL);
+    if (ret != SQLITE_OK)
+      {
+	  par_join_set_thread_error (join, sqlite3_errmsg (handle));
+	  goto end;
+      }
+    pthread_mutex_lock (&(join->mutex));
+    join->n_ready += 1;
+    pthread_cond_broadcast (&(join->produced));
+    pthread_mutex_unlock (&(join->mutex));
+
+    while (1)
+      {
+	  /* fetching the next partition to be evaluated */
+	  pthread_mutex_lock (&(join->mutex));
+	  if (join->abort || join->next_task >= join->n_tasks)
+	      index = -1;
+	  else
+	      index = join->next_task++;
+	  pthread_mutex_unlock (&(join->mutex));
+	  if (index < 0)
+	      break;
+
+	  par_join_bind_task (stmt, join, join->tasks + index);
+	  while (1)
+	    {
+		ret = sqlite3_step (stmt);
+		if (ret == SQLITE_DONE)
+		    break;
+		if (ret != SQLITE_ROW)
+		  {
+		      par_join_set_thread_error (join,
+						 sqlite3_errmsg (handle));
+		      goto end;
+		  }
+		if (chunk == NULL)
+		  {
+		      chunk = par_join_alloc_chunk ();
+		      if (chunk == NULL)
+			{
+			    par_join_set_thread_error (join,
+						       "insufficient memory");
+			    goto end;
+			}
+		  }
+		chunk->pairs[chunk->count * 2] =
+		    sqlite3_column_int64 (stmt, 0);
+		chunk->pairs[(chunk->count * 2) + 1] =
+		    sqlite3_column_int64 (stmt, 1);
+		chunk->count += 1;
+		if (chunk->count == PAR_JOIN_CHUNK_PAIRS)
+		  {
+		      if (!par_join_push_chunk (join, chunk))
+			  goto end;
+		      chunk = NULL;
+		  }
+	    }
+      }
+    if (chunk != NULL)
+      {
+	  if (par_join_push_chunk (join, chunk))
+	      chunk = NULL;
+      }
+
+  end:
+    par_join_free_chunk (chunk);
+    if (stmt != NULL)
+	sqlite3_finalize (stmt);
+    if (handle != NULL)
+      {
+	  sqlite3_exec (handle, "ROLLBACK", NULL, NULL, NULL);
+	  sqlite3_close (handle);
+      }
+    if (cache != NULL)
+	spatialite_internal_cleanup (cache);
+    pthread_mutex_lock (&(join->mutex));
+    join->n_running -= 1;
+    pthread_cond_broadcast (&(join->produced));
+    pthread_mutex_unlock (&(join->mutex));
+    return NULL;
+}
+
+static int
+par_join_get_busy_timeout (sqlite3 * sqlite)
+{
+/* retrieving the current busy-timeout of the writer connection */
+    sqlite3_stmt *stmt;
+    int timeout = 0;
+    int ret;
+
+    ret = sqlite3_prepare_v2 (sqlite, "PRAGMA busy_timeout", -1, &stmt, NULL);
+    if (ret != SQLITE_OK)
+	return 0;
+    if (sqlite3_step (stmt) == SQLITE_ROW)
+	timeout = sqlite3_column_int (stmt, 0);
+    sqlite3_finalize (stmt);
+    return timeout;
+}
+
+static int
+par_join_parallel (sqlite3 * sqlite, struct par_join *join, int threads,
+		   sqlite3_stmt * stmt_out, sqlite3_int64 * count)
+{
+/*
+/ evaluating all partitions on N worker threads, each one
+/ having its own read-only connection and its own internal cache;
+/ the calling thread is the only writer
+*/
+    pthread_t workers[PAR_JOIN_MAX_THREADS];
+    int n_workers = 0;
+    int ret;
+    int i;
+    int ok = 1;
+
+    pthread_mutex_init (&(join->mutex), NULL);
+    pthread_cond_init (&(join->produced), NULL);
+    pthread_cond_init (&(join->consumed), NULL);
+    join->first = NULL;
+    join->last = NULL;
+    join->n_chunks = 0;
+    join->max_chunks = threads * PAR_JOIN_CHUNKS_PER_THREAD;
+    join->n_running = 0;
+    join->n_ready = 0;
+
+    for (i = 0; i < threads; i++)
+      {
+	  pthread_mutex_lock (&(join->mutex));
+	  join->n_running += 1;
+	  pthread_mutex_unlock (&(join->mutex));
+	  if (pthread_create
+	      (&(workers[n_workers]), NULL, par_join_worker_thread, join) != 0)
+	    {
+		pthread_mutex_lock (&(join->mutex));
+		join->n_running -= 1;
+		pthread_mutex_unlock (&(join->mutex));
+		break;
+	    }
+	  n_workers++;
+      }
+    if (n_workers == 0)
+      {
+	  join->error = sqlite3_mprintf ("unable to start any worker thread");
+	  ok = 0;
+	  goto end;
+      }
+
+/* waiting until all workers have acquired their read lock */
+    pthread_mutex_lock (&(join->mutex));
+    while (join->n_ready + (n_workers - join->n_running) < n_workers
+	   && !join->abort)
+	pthread_cond_wait (&(join->produced), &(join->mutex));
+    pthread_mutex_unlock (&(join->mutex));
+
+    while (1)
+      {
+	  /* consuming the pairs found by the workers */
+	  struct par_join_chunk *chunk;
+	  pthread_mutex_lock (&(join->mutex));
+	  while (join->first == NULL && join->n_running > 0 && !join->abort)
+	      pthread_cond_wait (&(join->produced), &(join->mutex));
+	  if (join->abort || join->first == NULL)
+	    {
+		pthread_mutex_unlock (&(join->mutex));
+		break;
+	    }
+	  chunk = join->first;
+	  join->first = chunk->next;
+	  if (join->first == NULL)
+	      join->last = NULL;
+	  join->n_chunks -= 1;
+	  pthread_cond_signal (&(join->consumed));
+	  pthread_mutex_unlock (&(join->mutex));
+
+	  for (i = 0; i < chunk->count; i++)
+	    {
+		sqlite3_reset (stmt_out);
+		sqlite3_clear_bindings (stmt_out);
+		sqlite3_bind_int64 (stmt_out, 1, chunk->pairs[i * 2]);
+		sqlite3_bind_int64 (stmt_out, 2, chunk->pairs[(i * 2) + 1]);
+		ret = sqlite3_step (stmt_out);
+		if (ret != SQLITE_DONE && ret != SQLITE_ROW)
+		  {
+		      par_join_set_thread_error (join,
+						 sqlite3_errmsg (sqlite));
+		      break;
+		  }
+		*count += 1;
+	    }
+	  par_join_free_chunk (chunk);
+      }
+
+  end:
+    for (i = 0; i < n_workers; i++)
+	pthread_join (workers[i], NULL);
+    while (join->first != NULL)
+      {
+	  struct par_join_chunk *chunk = join->first;
+	  join->first = chunk->next;
+	  par_join_free_chunk (chunk);
+      }
+    if (join->error != NULL)
+	ok = 0;
+    pthread_cond_destroy (&(join->produced));
+    pthread_cond_destroy (&(join->consumed));
+    pthread_mutex_destroy (&(join->mutex));
+    return ok;
+}
+
+#endif /* end POSIX threads */
+
+SPATIALITE_DECLARE int
+gaia_parallel_spatial_join (sqlite3 * sqlite, const void *cache,
+			    const char *left_table, const char *left_geom,
+			    const char *right_table, const char *right_geom,
+			    const char *predicate, const char *out_table,
+			    int threads, sqlite3_int64 * count)
+{
+/* attempting to evaluate a Spatial Join on several threads */
+    const struct par_join_predicate *pred;
+    struct par_join join;
+    int left_rtree = 0;
+    int right_rtree = 0;
+    char *left_idx = NULL;
+    char *right_idx;
+    char *sql;
+    char *xtable;
+    char *errMsg = NULL;
+    sqlite3_stmt *stmt_out = NULL;
+    const char *db_path;
+    int in_transaction = 0;
+    int ret;
+    int ok;
+
+    *count = 0;
+    if (sqlite == NULL || cache == NULL)
+	return 0;
+    par_join_set_error (cache, NULL);
+    if (left_table == NULL || left_geom == NULL || right_table == NULL
+	|| right_geom == NULL || predicate == NULL || out_table == NULL)
+      {
+	  par_join_set_error (cache, "NULL argument");
+	  return 0;
+      }
+
+/* checking the Spatial Predicate */
+    pred = par_join_find_predicate (predicate);
+    if (pred == NULL)
+      {
+	  par_join_set_error (cache, "unsupported Spatial Predicate");
+	  return 0;
+      }
+#ifdef OMIT_GEOS		/* GEOS is not supported */
+    if (pred->requires_geos)
+      {
+	  par_join_set_error (cache,
+			      "this Spatial Predicate requires GEOS support");
+	  return 0;
+      }
+#endif
+
+/* checking both Geometry Columns and the output table */
+    if (!par_join_check_geometry (sqlite, left_table, left_geom, &left_rtree))
+      {
+	  par_join_set_error (cache, "Left Geometry Column does not exist");
+	  return 0;
+      }
+    if (!par_join_check_geometry
+	(sqlite, right_table, right_geom, &right_rtree))
+      {
+	  par_join_set_error (cache, "Right Geometry Column does not exist");
+	  return 0;
+      }
+    if (!right_rtree)
+      {
+	  par_join_set_error (cache,
+			      "Right Geometry Column has no R*Tree Spatial Index");
+	  return 0;
+      }
+    if (!par_join_check_out_table (sqlite, out_table))
+      {
+	  par_join_set_error (cache, "the output table already exists");
+	  return 0;
+      }
+
+    if (threads < 1)
+      {
+#ifndef _WIN32
+	  long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+	  threads = (cpus > 0) ? (int) cpus : 1;
+#else
+	  threads = 1;
+#endif
+      }
+    if (threads > PAR_JOIN_MAX_THREADS)
+	threads = PAR_JOIN_MAX_THREADS;
+
+/* worker connections can only share a file-based DB */
+    db_path = sqlite3_db_filename (sqlite, "main");
+    if (db_path == NULL || *db_path == '\0')
+	threads = 1;
+/*
+/ worker connections only see committed data, so that any uncommitted
+/ change made by a pending transaction would be silently ignored
+*/
+    if (!sqlite3_get_autocommit (sqlite))
+	threads = 1;
+
+    memset (&join, 0, sizeof (struct par_join));
+    join.db_path = db_path;
+    right_idx = sqlite3_mprintf ("idx_%s_%s", right_table, right_geom);
+    if (left_rtree)
+      {
+	  left_idx = sqlite3_mprintf ("idx_%s_%s", left_table, left_geom);
+	  join.grid_mode = 1;
+	  ok = par_join_grid_tasks (sqlite, &join, left_idx,
+				    threads * PAR_JOIN_TASKS_PER_THREAD);
+      }
+    else
+	ok = par_join_rowid_tasks (sqlite, &join, left_table,
+				   threads * PAR_JOIN_TASKS_PER_THREAD);
+    if (!ok)
+      {
+	  par_join_set_error (cache, "unable to partition the Left table");
+	  goto error;
+      }
+    join.sql =
+	par_join_build_sql (left_table, left_geom, left_idx, right_table,
+			    right_geom, right_idx, pred->sql_name);
+
+/* creating the output table */
+    if (sqlite3_get_autocommit (sqlite))
+      {
+	  ret = sqlite3_exec (sqlite, "BEGIN", NULL, NULL, &errMsg);
+	  if (ret != SQLITE_OK)
+	    {
+		par_join_set_error (cache, errMsg);
+		sqlite3_free (errMsg);
+		goto error;
+	    }
+	  in_transaction = 1;
+      }
+    xtable = gaiaDoubleQuotedSql (out_table);
+    sql =
+	sqlite3_mprintf ("CREATE TABLE main.\"%s\" (\n"
+			 "left_rowid INTEGER NOT NULL,\n"
+			 "right_rowid INTEGER NOT NULL)", xtable);
+    ret = sqlite3_exec (sqlite, sql, NULL, NULL, &errMsg);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  free (xtable);
+	  par_join_set_error (cache, errMsg);
+	  sqlite3_free (errMsg);
+	  goto error;
+      }
+    sql =
+	sqlite3_mprintf
+	("INSERT INTO main.\"%s\" (left_rowid, right_rowid) VALUES (?, ?)",
+	 xtable);
+    free (xtable);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt_out, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  par_join_set_error (cache, sqlite3_errmsg (sqlite));
+	  goto error;
+      }
+
+#ifndef _WIN32
+    if (threads > 1)
+      {
+	  /*
+	     / while the workers hold their SHARED locks any attempt by the
+	     / writer to spill dirty pages into the DB (which requires an
+	     / EXCLUSIVE lock) is bound to fail; it must fail immediately
+	     / instead of stalling until the busy-timeout expires
+	   */
+	  int timeout = par_join_get_busy_timeout (sqlite);
+	  sqlite3_busy_timeout (sqlite, 0);
+	  ok = par_join_parallel (sqlite, &join, threads, stmt_out, count);
+	  sqlite3_busy_timeout (sqlite, timeout);
+      }
+    else
+#endif
+	ok = par_join_serial (sqlite, &join, stmt_out, count);
+    sqlite3_finalize (stmt_out);
+    stmt_out = NULL;
+    if (!ok)
+      {
+	  par_join_set_error (cache, join.error);
+	  goto error;
+      }
+
+    if (in_transaction)
+      {
+	  ret = sqlite3_exec (sqlite, "COMMIT", NULL, NULL, &errMsg);
+	  if (ret != SQLITE_OK)
+	    {
+		par_join_set_error (cache, errMsg);
+		sqlite3_free (errMsg);
+		goto error;
+	    }
+      }
+    sqlite3_free (join.sql);
+    sqlite3_free (join.error);
+    if (join.tasks != NULL)
+	free (join.tasks);
+    sqlite3_free (left_idx);
+    sqlite3_free (right_idx);
+    return 1;
+
+  error:
+    if (stmt_out != NULL)
+	sqlite3_finalize (stmt_out);
+    if (in_transaction)
+	sqlite3_exec (sqlite, "ROLLBACK", NULL, NULL, NULL);
+    sqlite3_free (join.sql);
+    sqlite3_free (join.error);
+    if (join.tasks != NULL)
+	free (join.tasks);
+    sqlite3_free (left_idx);
+    sqlite3_free (right_idx);
+    *count = 0;
+    return 0;
+}
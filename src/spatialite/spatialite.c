@@ -143,19 +143,29 @@ Regione Toscana - Settore Sistema Informativo Territoriale ed Ambientale
 
 #define GAIA_UNUSED() if (argc || argv) argc = argc;
 
-struct gaia_geom_chain_item
-{
-/* a struct used to store a chain item */
-    gaiaGeomCollPtr geom;
-    struct gaia_geom_chain_item *next;
+/* max depth of the Union aggregate cascade */
+#define UNION_MAX_LEVELS	64
+/* number of batches buffered by the spatially sorted Union aggregate */
+#define UNION_SORT_WINDOW	16
+
+struct gaia_union_agg
+{
+/* a struct used by the cascaded Union aggregate */
+    const void *data;
+    int batch_size;
+    int spatial_sort;
+    int error;
+    gaiaGeomCollPtr *pending;
+    int n_pending;
+    int max_pending;
+    gaiaGeomCollPtr levels[UNION_MAX_LEVELS];
 };
 
-struct gaia_geom_chain
+struct gaia_union_sort_item
 {
-/* a struct used to store a dynamic chain of GeometryCollections */
-    int all_polygs;
-    struct gaia_geom_chain_item *first;
-    struct gaia_geom_chain_item *last;
+/* a struct used to sort pending Union Geometries in Z-order */
+    unsigned int key;
+    gaiaGeomCollPtr geom;
 };
 
 #ifndef OMIT_GEOCALLBACKS	/* supporting RTree geometry callbacks */
@@ -1254,6 +1264,31 @@ fnct_GeometryConstraints (sqlite3_context * context, int argc,
       }
 }
 
+static int
+rtree_align_get_mbr (const unsigned char *blob, int size, double *minx,
+		     double *miny, double *maxx, double *maxy)
+{
+/* 
+/ retrieving the MBR of a BLOB-Geometry; whenever possible
+/ it's directly read from the BLOB header, so to avoid
+/ a full (and expensive) parsing of the whole Geometry
+*/
+    gaiaGeomCollPtr geom;
+    if (gaiaGetMbrMinX (blob, size, minx) && gaiaGetMbrMinY (blob, size, miny)
+	&& gaiaGetMbrMaxX (blob, size, maxx)
+	&& gaiaGetMbrMaxY (blob, size, maxy))
+	return 1;
+    geom = gaiaFromSpatiaLiteBlobWkb (blob, size);
+    if (geom == NULL)
+	return 0;
+    *minx = geom->MinX;
+    *miny = geom->MinY;
+    *maxx = geom->MaxX;
+    *maxy = geom->MaxY;
+    gaiaFreeGeomColl (geom);
+    return 1;
+}
+
 static void
 fnct_RTreeAlign (sqlite3_context * context, int argc, sqlite3_value ** argv)
 {
@@ -1266,18 +1301,39 @@ fnct_RTreeAlign (sqlite3_context * context, int argc, sqlite3_value ** argv)
 / 1 - successful update
 / 0 - update failure
 /
+/ when the deferred SpatialIndex mode is enabled the R*Tree
+/ entry is simply queued, and will be later written by
+/ FlushDeferredSpatialIndex()
+/
+/ the queue is never flushed from here: RTreeAlign() is called
+/ by triggers, and any R*Tree change made while the triggering
+/ statement is pending would be undone if that statement fails,
+/ silently losing the entries queued by previous statements.
+/ FlushDeferredSpatialIndex() can be called between statements
+/ so to bound the memory used by the queue
+/
+/ note: the INSERT statement is never cached across calls,
+/ because any statement left unfinalized would cause
+/ sqlite3_close() to fail; the deferred mode is the way
+/ to write many entries by a single prepared statement
+/
 */
     unsigned char *p_blob = NULL;
     int n_bytes = 0;
     sqlite3_int64 pkid;
     const char *rtree_table;
+    char *rtree_name = NULL;
     char *table_name;
     int len;
-    char pkv[64];
-    gaiaGeomCollPtr geom = NULL;
+    double minx;
+    double miny;
+    double maxx;
+    double maxy;
     int ret;
     char *sql_statement;
+    sqlite3_stmt *stmt;
     sqlite3 *sqlite = sqlite3_context_db_handle (context);
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
     GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
     if (sqlite3_value_type (argv[0]) == SQLITE_TEXT)
 	rtree_table = (const char *) sqlite3_value_text (argv[0]);
@@ -1301,56 +1357,85 @@ fnct_RTreeAlign (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  sqlite3_result_int (context, -1);
 	  return;
       }
-    if (sqlite3_value_type (argv[2]) == SQLITE_BLOB)
+    if (sqlite3_value_type (argv[2]) != SQLITE_BLOB)
       {
-	  p_blob = (unsigned char *) sqlite3_value_blob (argv[2]);
-	  n_bytes = sqlite3_value_bytes (argv[2]);
-	  geom = gaiaFromSpatiaLiteBlobWkb (p_blob, n_bytes);
+	  /* NULL geometry: nothing to do */
+	  sqlite3_result_int (context, 1);
+	  return;
       }
-
-    if (geom == NULL)
+    p_blob = (unsigned char *) sqlite3_value_blob (argv[2]);
+    n_bytes = sqlite3_value_bytes (argv[2]);
+    if (!rtree_align_get_mbr (p_blob, n_bytes, &minx, &miny, &maxx, &maxy))
       {
-	  /* NULL geometry: nothing to do */
+	  /* invalid geometry: nothing to do */
 	  sqlite3_result_int (context, 1);
+	  return;
       }
-    else
+
+    if (*(rtree_table + 0) == '"'
+	&& *(rtree_table + strlen (rtree_table) - 1) == '"')
       {
-	  /* INSERTing into the R*Tree */
-	  if (*(rtree_table + 0) == '"'
-	      && *(rtree_table + strlen (rtree_table) - 1) == '"')
+	  /* earlier versions may pass an already quoted name */
+	  len = strlen (rtree_table);
+	  table_name = malloc (len + 1);
+	  strcpy (table_name, rtree_table);
+	  rtree_name = gaiaDequotedSql (table_name);
+	  free (table_name);
+	  if (rtree_name == NULL)
 	    {
-		/* earlier versions may pass an already quoted name */
-		char *dequoted_table_name;
-		len = strlen (rtree_table);
-		table_name = malloc (len + 1);
-		strcpy (table_name, rtree_table);
-		dequoted_table_name = gaiaDequotedSql (table_name);
-		free (table_name);
-		if (dequoted_table_name == NULL)
-		  {
-		      sqlite3_result_int (context, -1);
-		      return;
-		  }
-		table_name = gaiaDoubleQuotedSql (dequoted_table_name);
-		free (dequoted_table_name);
+		sqlite3_result_int (context, -1);
+		return;
 	    }
-	  else
-	      table_name = gaiaDoubleQuotedSql (rtree_table);
-	  sprintf (pkv, FRMT64, pkid);
-	  sql_statement =
-	      sqlite3_mprintf
-	      ("INSERT INTO \"%s\" (pkid, xmin, ymin, xmax, ymax) "
-	       "VALUES (%s, %1.12f, %1.12f, %1.12f, %1.12f)", table_name,
-	       pkv, geom->MinX, geom->MinY, geom->MaxX, geom->MaxY);
-	  gaiaFreeGeomColl (geom);
-	  ret = sqlite3_exec (sqlite, sql_statement, NULL, NULL, NULL);
-	  sqlite3_free (sql_statement);
-	  free (table_name);
-	  if (ret != SQLITE_OK)
-	      sqlite3_result_int (context, 0);
-	  else
-	      sqlite3_result_int (context, 1);
+	  rtree_table = rtree_name;
       }
+
+    if (cache != NULL && cache->deferred_rtree_enabled)
+      {
+	  /* deferred mode: simply queuing the R*Tree entry */
+	  ret =
+	      add_deferred_rtree_item (rtree_table, pkid, minx, miny, maxx,
+				       maxy, cache);
+	  if (rtree_name != NULL)
+	      free (rtree_name);
+	  if (!ret)
+	    {
+		/* a lost entry: COMMIT will be vetoed */
+		cache->deferred_rtree_lost = 1;
+		sqlite3_result_int (context, 0);
+		return;
+	    }
+	  sqlite3_result_int (context, 1);
+	  return;
+      }
+
+/* INSERTing into the R*Tree */
+    table_name = gaiaDoubleQuotedSql (rtree_table);
+    if (rtree_name != NULL)
+	free (rtree_name);
+    sql_statement =
+	sqlite3_mprintf ("INSERT INTO \"%s\" (pkid, xmin, ymin, xmax, ymax) "
+			 "VALUES (?, ?, ?, ?, ?)", table_name);
+    free (table_name);
+    ret =
+	sqlite3_prepare_v2 (sqlite, sql_statement, strlen (sql_statement),
+			    &stmt, NULL);
+    sqlite3_free (sql_statement);
+    if (ret != SQLITE_OK)
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    sqlite3_bind_int64 (stmt, 1, pkid);
+    sqlite3_bind_double (stmt, 2, minx);
+    sqlite3_bind_double (stmt, 3, miny);
+    sqlite3_bind_double (stmt, 4, maxx);
+    sqlite3_bind_double (stmt, 5, maxy);
+    ret = sqlite3_step (stmt);
+    sqlite3_finalize (stmt);
+    if (ret == SQLITE_DONE || ret == SQLITE_ROW)
+	sqlite3_result_int (context, 1);
+    else
+	sqlite3_result_int (context, 0);
 }
 
 static void
@@ -7531,15 +7616,20 @@ recover_spatial_index (sqlite3 * sqlite, const unsigned char *table,
 	return -1;
 
 /* erasing the R*Tree table */
-    idx_name = sqlite3_mprintf ("idx_%s_%s", table, geom);
-    xidx_name = gaiaDoubleQuotedSql (idx_name);
-    sqlite3_free (idx_name);
-    sql_statement = sqlite3_mprintf ("DELETE FROM \"%s\"", xidx_name);
-    free (xidx_name);
-    ret = sqlite3_exec (sqlite, sql_statement, NULL, NULL, &errMsg);
-    sqlite3_free (sql_statement);
-    if (ret != SQLITE_OK)
-	goto error;
+    if (!truncateSpatialIndex
+	(sqlite, (const char *) table, (const char *) geom))
+      {
+	  /* falling back to the ordinary R*Tree DELETE path */
+	  idx_name = sqlite3_mprintf ("idx_%s_%s", table, geom);
+	  xidx_name = gaiaDoubleQuotedSql (idx_name);
+	  sqlite3_free (idx_name);
+	  sql_statement = sqlite3_mprintf ("DELETE FROM \"%s\"", xidx_name);
+	  free (xidx_name);
+	  ret = sqlite3_exec (sqlite, sql_statement, NULL, NULL, &errMsg);
+	  sqlite3_free (sql_statement);
+	  if (ret != SQLITE_OK)
+	      goto error;
+      }
 /* populating the R*Tree table from scratch */
     status = buildSpatialIndexEx (sqlite, table, (const char *) geom);
     if (status == 0)
@@ -10088,13 +10178,14 @@ fnct_AsText (sqlite3_context * context, int argc, sqlite3_value ** argv)
     n_bytes = sqlite3_value_bytes (argv[0]);
     gaiaOutBufferInitialize (&out_buf);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
       {
-	  if (decimal_precision >= 0)
+	  if (decimal_precision >= 0
+	      || decimal_precision == GAIA_PRECISION_SHORTEST)
 	      gaiaOutWktEx (&out_buf, geo, decimal_precision);
 	  else
 	      gaiaOutWkt (&out_buf, geo);
@@ -10107,7 +10198,7 @@ fnct_AsText (sqlite3_context * context, int argc, sqlite3_value ** argv)
 		out_buf.Buffer = NULL;
 	    }
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
     gaiaOutBufferReset (&out_buf);
 }
 
@@ -10153,8 +10244,8 @@ fnct_AsWkt (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     gaiaOutBufferInitialize (&out_buf);
     if (!geo)
 	sqlite3_result_null (context);
@@ -10170,7 +10261,7 @@ fnct_AsWkt (sqlite3_context * context, int argc, sqlite3_value ** argv)
 		out_buf.Buffer = NULL;
 	    }
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
     gaiaOutBufferReset (&out_buf);
 }
 
@@ -10215,8 +10306,8 @@ fnct_AsSvg (sqlite3_context * context, int argc, sqlite3_value ** argv,
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
       {
 	  sqlite3_result_null (context);
@@ -10246,7 +10337,7 @@ fnct_AsSvg (sqlite3_context * context, int argc, sqlite3_value ** argv,
 		out_buf.Buffer = NULL;
 	    }
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
     gaiaOutBufferReset (&out_buf);
 }
 
@@ -10299,7 +10390,7 @@ fnct_AsKml1 (sqlite3_context * context, int argc, sqlite3_value ** argv)
     int len;
     gaiaOutBuffer out_buf;
     gaiaGeomCollPtr geo = NULL;
-    gaiaGeomCollPtr geo_wgs84;
+    gaiaGeomCollPtr geo_wgs84 = NULL;
     char *proj_from = NULL;
     char *proj_to = NULL;
     int precision = 15;
@@ -10333,8 +10424,8 @@ fnct_AsKml1 (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     gaiaOutBufferInitialize (&out_buf);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -10378,11 +10469,12 @@ fnct_AsKml1 (sqlite3_context * context, int argc, sqlite3_value ** argv)
 		      goto stop;
 		  }
 		/* ok, reprojection was successful */
-		gaiaFreeGeomColl (geo);
-		geo = geo_wgs84;
 	    }
 	  /* produce KML-notation - actual work is done in gaiageo/gg_wkt.c */
-	  gaiaOutBareKml (&out_buf, geo, precision);
+	  if (geo_wgs84 != NULL)
+	      gaiaOutBareKml (&out_buf, geo_wgs84, precision);
+	  else
+	      gaiaOutBareKml (&out_buf, geo, precision);
 	  if (out_buf.Error || out_buf.Buffer == NULL)
 	      sqlite3_result_null (context);
 	  else
@@ -10393,7 +10485,8 @@ fnct_AsKml1 (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	    }
       }
   stop:
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
+    gaiaFreeGeomColl (geo_wgs84);
     gaiaOutBufferReset (&out_buf);
 }
 
@@ -10411,7 +10504,7 @@ fnct_AsKml3 (sqlite3_context * context, int argc, sqlite3_value ** argv)
     int len;
     gaiaOutBuffer out_buf;
     gaiaGeomCollPtr geo = NULL;
-    gaiaGeomCollPtr geo_wgs84;
+    gaiaGeomCollPtr geo_wgs84 = NULL;
     sqlite3_int64 int_value;
     double dbl_value;
     const char *name;
@@ -10519,8 +10612,8 @@ fnct_AsKml3 (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	    }
       }
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -10564,11 +10657,12 @@ fnct_AsKml3 (sqlite3_context * context, int argc, sqlite3_value ** argv)
 		      goto stop;
 		  }
 		/* ok, reprojection was successful */
-		gaiaFreeGeomColl (geo);
-		geo = geo_wgs84;
 	    }
 	  /* produce KML-notation - actual work is done in gaiageo/gg_wkt.c */
-	  gaiaOutFullKml (&out_buf, name, desc, geo, precision);
+	  if (geo_wgs84 != NULL)
+	      gaiaOutFullKml (&out_buf, name, desc, geo_wgs84, precision);
+	  else
+	      gaiaOutFullKml (&out_buf, name, desc, geo, precision);
 	  if (out_buf.Error || out_buf.Buffer == NULL)
 	      sqlite3_result_null (context);
 	  else
@@ -10579,7 +10673,8 @@ fnct_AsKml3 (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	    }
       }
   stop:
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
+    gaiaFreeGeomColl (geo_wgs84);
     if (name_malloc)
 	free (name_malloc);
     if (desc_malloc)
@@ -10698,8 +10793,8 @@ fnct_AsGml (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     gaiaOutBufferInitialize (&out_buf);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -10715,7 +10810,7 @@ fnct_AsGml (sqlite3_context * context, int argc, sqlite3_value ** argv)
 		out_buf.Buffer = NULL;
 	    }
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
     gaiaOutBufferReset (&out_buf);
 }
 
@@ -10755,7 +10850,10 @@ fnct_AsGeoJSON (sqlite3_context * context, int argc, sqlite3_value ** argv)
     struct splite_internal_cache *cache = sqlite3_user_data (context);
     GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
     if (cache != NULL)
-	gpkg_amphibious = cache->gpkg_mode = cache->gpkg_mode;;
+      {
+	  gpkg_amphibious = cache->gpkg_amphibious_mode;
+	  gpkg_mode = cache->gpkg_mode;
+      }
     if (argc == 3)
       {
 	  if (sqlite3_value_type (argv[0]) == SQLITE_BLOB
@@ -10804,8 +10902,8 @@ fnct_AsGeoJSON (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     gaiaOutBufferInitialize (&out_buf);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -10821,7 +10919,7 @@ fnct_AsGeoJSON (sqlite3_context * context, int argc, sqlite3_value ** argv)
 		out_buf.Buffer = NULL;
 	    }
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
     gaiaOutBufferReset (&out_buf);
 }
 
@@ -10856,8 +10954,8 @@ fnct_AsBinary (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -10868,7 +10966,7 @@ fnct_AsBinary (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  else
 	      sqlite3_result_blob (context, p_result, len, free);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -10921,8 +11019,8 @@ fnct_AsFGF (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  return;
       }
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -10933,7 +11031,7 @@ fnct_AsFGF (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  else
 	      sqlite3_result_blob (context, p_result, len, free);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -15617,15 +15715,15 @@ fnct_IsPolygonCW (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_int (context, -1);
     else
       {
 	  int retval = gaiaCheckClockwise (geo);
 	  sqlite3_result_int (context, retval);
-	  gaiaFreeGeomColl (geo);
+	  gaiaFreeArenaGeomColl (geo);
       }
 }
 
@@ -15660,15 +15758,15 @@ fnct_IsPolygonCCW (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_int (context, -1);
     else
       {
 	  int retval = gaiaCheckCounterClockwise (geo);
 	  sqlite3_result_int (context, retval);
-	  gaiaFreeGeomColl (geo);
+	  gaiaFreeArenaGeomColl (geo);
       }
 }
 
@@ -15706,8 +15804,8 @@ fnct_Dimension (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -15715,7 +15813,7 @@ fnct_Dimension (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  dim = gaiaDimension (geo);
 	  sqlite3_result_int (context, dim);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -15751,8 +15849,8 @@ fnct_CoordDimension (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -15779,7 +15877,7 @@ fnct_CoordDimension (sqlite3_context * context, int argc, sqlite3_value ** argv)
 		sqlite3_result_text (context, p_result, len, free);
 	    }
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -15813,8 +15911,8 @@ fnct_NDims (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -15829,7 +15927,7 @@ fnct_NDims (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	      result = 4;
 	  sqlite3_result_int (context, result);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -15852,6 +15950,7 @@ fnct_GeometryType (sqlite3_context * context, int argc, sqlite3_value ** argv)
     char *p_type = NULL;
     char *p_result = NULL;
     gaiaGeomCollPtr geo = NULL;
+    gaiaBlobView view;
     GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
     if (sqlite3_value_type (argv[0]) != SQLITE_BLOB)
       {
@@ -15860,139 +15959,143 @@ fnct_GeometryType (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
-    geo = gaiaFromSpatiaLiteBlobWkb (p_blob, n_bytes);
-    if (!geo)
+    if (gaiaBlobViewInit (&view, p_blob, n_bytes))
+	type = gaiaBlobViewGeometryType (&view);
+    else
       {
-#ifdef ENABLE_GEOPACKAGE	/* GEOPACKAGE enabled: supporting GPKG geometries */
-	  if (gaiaIsValidGPB (p_blob, n_bytes))
+	  geo = gaiaFromSpatiaLiteBlobWkb (p_blob, n_bytes);
+	  if (!geo)
 	    {
-		char *gpb_type = gaiaGetGeometryTypeFromGPB (p_blob, n_bytes);
-		if (gpb_type == NULL)
-		    sqlite3_result_null (context);
-		else
+#ifdef ENABLE_GEOPACKAGE	/* GEOPACKAGE enabled: supporting GPKG geometries */
+		if (gaiaIsValidGPB (p_blob, n_bytes))
 		  {
-		      len = strlen (gpb_type);
-		      sqlite3_result_text (context, gpb_type, len, free);
+		      char *gpb_type =
+			  gaiaGetGeometryTypeFromGPB (p_blob, n_bytes);
+		      if (gpb_type == NULL)
+			  sqlite3_result_null (context);
+		      else
+			{
+			    len = strlen (gpb_type);
+			    sqlite3_result_text (context, gpb_type, len, free);
+			}
+		      return;
 		  }
+		else
+#endif /* end GEOPACKAGE: supporting GPKG geometries */
+		    sqlite3_result_null (context);
 		return;
 	    }
-	  else
-#endif /* end GEOPACKAGE: supporting GPKG geometries */
-	      sqlite3_result_null (context);
+	  type = gaiaGeometryType (geo);
+	  gaiaFreeGeomColl (geo);
+      }
+    switch (type)
+      {
+      case GAIA_POINT:
+	  p_type = "POINT";
+	  break;
+      case GAIA_POINTZ:
+	  p_type = "POINT Z";
+	  break;
+      case GAIA_POINTM:
+	  p_type = "POINT M";
+	  break;
+      case GAIA_POINTZM:
+	  p_type = "POINT ZM";
+	  break;
+      case GAIA_MULTIPOINT:
+	  p_type = "MULTIPOINT";
+	  break;
+      case GAIA_MULTIPOINTZ:
+	  p_type = "MULTIPOINT Z";
+	  break;
+      case GAIA_MULTIPOINTM:
+	  p_type = "MULTIPOINT M";
+	  break;
+      case GAIA_MULTIPOINTZM:
+	  p_type = "MULTIPOINT ZM";
+	  break;
+      case GAIA_LINESTRING:
+      case GAIA_COMPRESSED_LINESTRING:
+	  p_type = "LINESTRING";
+	  break;
+      case GAIA_LINESTRINGZ:
+      case GAIA_COMPRESSED_LINESTRINGZ:
+	  p_type = "LINESTRING Z";
+	  break;
+      case GAIA_LINESTRINGM:
+      case GAIA_COMPRESSED_LINESTRINGM:
+	  p_type = "LINESTRING M";
+	  break;
+      case GAIA_LINESTRINGZM:
+      case GAIA_COMPRESSED_LINESTRINGZM:
+	  p_type = "LINESTRING ZM";
+	  break;
+      case GAIA_MULTILINESTRING:
+	  p_type = "MULTILINESTRING";
+	  break;
+      case GAIA_MULTILINESTRINGZ:
+	  p_type = "MULTILINESTRING Z";
+	  break;
+      case GAIA_MULTILINESTRINGM:
+	  p_type = "MULTILINESTRING M";
+	  break;
+      case GAIA_MULTILINESTRINGZM:
+	  p_type = "MULTILINESTRING ZM";
+	  break;
+      case GAIA_POLYGON:
+      case GAIA_COMPRESSED_POLYGON:
+	  p_type = "POLYGON";
+	  break;
+      case GAIA_POLYGONZ:
+      case GAIA_COMPRESSED_POLYGONZ:
+	  p_type = "POLYGON Z";
+	  break;
+      case GAIA_POLYGONM:
+      case GAIA_COMPRESSED_POLYGONM:
+	  p_type = "POLYGON M";
+	  break;
+      case GAIA_POLYGONZM:
+      case GAIA_COMPRESSED_POLYGONZM:
+	  p_type = "POLYGON ZM";
+	  break;
+      case GAIA_MULTIPOLYGON:
+	  p_type = "MULTIPOLYGON";
+	  break;
+      case GAIA_MULTIPOLYGONZ:
+	  p_type = "MULTIPOLYGON Z";
+	  break;
+      case GAIA_MULTIPOLYGONM:
+	  p_type = "MULTIPOLYGON M";
+	  break;
+      case GAIA_MULTIPOLYGONZM:
+	  p_type = "MULTIPOLYGON ZM";
+	  break;
+      case GAIA_GEOMETRYCOLLECTION:
+	  p_type = "GEOMETRYCOLLECTION";
+	  break;
+      case GAIA_GEOMETRYCOLLECTIONZ:
+	  p_type = "GEOMETRYCOLLECTION Z";
+	  break;
+      case GAIA_GEOMETRYCOLLECTIONM:
+	  p_type = "GEOMETRYCOLLECTION M";
+	  break;
+      case GAIA_GEOMETRYCOLLECTIONZM:
+	  p_type = "GEOMETRYCOLLECTION ZM";
+	  break;
+      };
+    if (p_type)
+      {
+	  len = strlen (p_type);
+	  p_result = malloc (len + 1);
+	  strcpy (p_result, p_type);
       }
+    if (!p_result)
+	sqlite3_result_null (context);
     else
       {
-	  type = gaiaGeometryType (geo);
-	  switch (type)
-	    {
-	    case GAIA_POINT:
-		p_type = "POINT";
-		break;
-	    case GAIA_POINTZ:
-		p_type = "POINT Z";
-		break;
-	    case GAIA_POINTM:
-		p_type = "POINT M";
-		break;
-	    case GAIA_POINTZM:
-		p_type = "POINT ZM";
-		break;
-	    case GAIA_MULTIPOINT:
-		p_type = "MULTIPOINT";
-		break;
-	    case GAIA_MULTIPOINTZ:
-		p_type = "MULTIPOINT Z";
-		break;
-	    case GAIA_MULTIPOINTM:
-		p_type = "MULTIPOINT M";
-		break;
-	    case GAIA_MULTIPOINTZM:
-		p_type = "MULTIPOINT ZM";
-		break;
-	    case GAIA_LINESTRING:
-	    case GAIA_COMPRESSED_LINESTRING:
-		p_type = "LINESTRING";
-		break;
-	    case GAIA_LINESTRINGZ:
-	    case GAIA_COMPRESSED_LINESTRINGZ:
-		p_type = "LINESTRING Z";
-		break;
-	    case GAIA_LINESTRINGM:
-	    case GAIA_COMPRESSED_LINESTRINGM:
-		p_type = "LINESTRING M";
-		break;
-	    case GAIA_LINESTRINGZM:
-	    case GAIA_COMPRESSED_LINESTRINGZM:
-		p_type = "LINESTRING ZM";
-		break;
-	    case GAIA_MULTILINESTRING:
-		p_type = "MULTILINESTRING";
-		break;
-	    case GAIA_MULTILINESTRINGZ:
-		p_type = "MULTILINESTRING Z";
-		break;
-	    case GAIA_MULTILINESTRINGM:
-		p_type = "MULTILINESTRING M";
-		break;
-	    case GAIA_MULTILINESTRINGZM:
-		p_type = "MULTILINESTRING ZM";
-		break;
-	    case GAIA_POLYGON:
-	    case GAIA_COMPRESSED_POLYGON:
-		p_type = "POLYGON";
-		break;
-	    case GAIA_POLYGONZ:
-	    case GAIA_COMPRESSED_POLYGONZ:
-		p_type = "POLYGON Z";
-		break;
-	    case GAIA_POLYGONM:
-	    case GAIA_COMPRESSED_POLYGONM:
-		p_type = "POLYGON M";
-		break;
-	    case GAIA_POLYGONZM:
-	    case GAIA_COMPRESSED_POLYGONZM:
-		p_type = "POLYGON ZM";
-		break;
-	    case GAIA_MULTIPOLYGON:
-		p_type = "MULTIPOLYGON";
-		break;
-	    case GAIA_MULTIPOLYGONZ:
-		p_type = "MULTIPOLYGON Z";
-		break;
-	    case GAIA_MULTIPOLYGONM:
-		p_type = "MULTIPOLYGON M";
-		break;
-	    case GAIA_MULTIPOLYGONZM:
-		p_type = "MULTIPOLYGON ZM";
-		break;
-	    case GAIA_GEOMETRYCOLLECTION:
-		p_type = "GEOMETRYCOLLECTION";
-		break;
-	    case GAIA_GEOMETRYCOLLECTIONZ:
-		p_type = "GEOMETRYCOLLECTION Z";
-		break;
-	    case GAIA_GEOMETRYCOLLECTIONM:
-		p_type = "GEOMETRYCOLLECTION M";
-		break;
-	    case GAIA_GEOMETRYCOLLECTIONZM:
-		p_type = "GEOMETRYCOLLECTION ZM";
-		break;
-	    };
-	  if (p_type)
-	    {
-		len = strlen (p_type);
-		p_result = malloc (len + 1);
-		strcpy (p_result, p_type);
-	    }
-	  if (!p_result)
-	      sqlite3_result_null (context);
-	  else
-	    {
-		len = strlen (p_result);
-		sqlite3_result_text (context, p_result, len, free);
-	    }
+	  len = strlen (p_result);
+	  sqlite3_result_text (context, p_result, len, free);
       }
-    gaiaFreeGeomColl (geo);
 }
 
 static void
@@ -16691,8 +16794,8 @@ fnct_Envelope (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -16712,7 +16815,7 @@ fnct_Envelope (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  gaiaFreeGeomColl (bbox);
 	  sqlite3_result_blob (context, p_result, len, free);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -17668,6 +17771,43 @@ fnct_RTreeDistWithin (sqlite3_rtree_geometry * p, int nCoord, double *aCoord,
 }
 #endif /* end RTree geometry callbacks */
 
+static int
+blob_view_simple_point (gaiaBlobViewPtr view, double *x, double *y,
+			double *z, double *m)
+{
+/* helper function
+/ same as simplePoint(), but directly reading the BLOB
+*/
+    if (view->NumPoints != 1 || view->NumLinestrings != 0
+	|| view->NumPolygons != 0)
+	return 0;
+    return gaiaBlobViewGetPoint (view, 0, x, y, z, m);
+}
+
+static int
+blob_view_simple_linestring (gaiaBlobViewPtr view, int *points)
+{
+/* helper function
+/ same as simpleLinestring(), but directly reading the BLOB
+*/
+    if (view->NumPoints != 0 || view->NumLinestrings != 1
+	|| view->NumPolygons != 0)
+	return 0;
+    return gaiaBlobViewGetLinestring (view, 0, points);
+}
+
+static int
+blob_view_simple_polygon (gaiaBlobViewPtr view, int *interiors)
+{
+/* helper function
+/ same as simplePolygon(), but directly reading the BLOB
+*/
+    if (view->NumPoints != 0 || view->NumLinestrings != 0
+	|| view->NumPolygons != 1)
+	return 0;
+    return gaiaBlobViewGetPolygon (view, 0, interiors);
+}
+
 static void
 fnct_X (sqlite3_context * context, int argc, sqlite3_value ** argv)
 {
@@ -17681,6 +17821,11 @@ fnct_X (sqlite3_context * context, int argc, sqlite3_value ** argv)
     int n_bytes;
     gaiaGeomCollPtr geo = NULL;
     gaiaPointPtr point;
+    gaiaBlobView view;
+    double x;
+    double y;
+    double z;
+    double m;
     int gpkg_amphibious = 0;
     int gpkg_mode = 0;
     struct splite_internal_cache *cache = sqlite3_user_data (context);
@@ -17697,6 +17842,15 @@ fnct_X (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
+    if (!gpkg_mode && gaiaBlobViewInit (&view, p_blob, n_bytes))
+      {
+	  /* reading the POINT straight from the BLOB */
+	  if (blob_view_simple_point (&view, &x, &y, &z, &m))
+	      sqlite3_result_double (context, x);
+	  else
+	      sqlite3_result_null (context);
+	  return;
+      }
     geo =
 	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
 				     gpkg_amphibious);
@@ -17726,6 +17880,11 @@ fnct_Y (sqlite3_context * context, int argc, sqlite3_value ** argv)
     int n_bytes;
     gaiaGeomCollPtr geo = NULL;
     gaiaPointPtr point;
+    gaiaBlobView view;
+    double x;
+    double y;
+    double z;
+    double m;
     int gpkg_amphibious = 0;
     int gpkg_mode = 0;
     struct splite_internal_cache *cache = sqlite3_user_data (context);
@@ -17742,6 +17901,15 @@ fnct_Y (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
+    if (!gpkg_mode && gaiaBlobViewInit (&view, p_blob, n_bytes))
+      {
+	  /* reading the POINT straight from the BLOB */
+	  if (blob_view_simple_point (&view, &x, &y, &z, &m))
+	      sqlite3_result_double (context, y);
+	  else
+	      sqlite3_result_null (context);
+	  return;
+      }
     geo =
 	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
 				     gpkg_amphibious);
@@ -17771,6 +17939,11 @@ fnct_Z (sqlite3_context * context, int argc, sqlite3_value ** argv)
     int n_bytes;
     gaiaGeomCollPtr geo = NULL;
     gaiaPointPtr point;
+    gaiaBlobView view;
+    double x;
+    double y;
+    double z;
+    double m;
     int gpkg_amphibious = 0;
     int gpkg_mode = 0;
     struct splite_internal_cache *cache = sqlite3_user_data (context);
@@ -17787,6 +17960,17 @@ fnct_Z (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
+    if (!gpkg_mode && gaiaBlobViewInit (&view, p_blob, n_bytes))
+      {
+	  /* reading the POINT straight from the BLOB */
+	  if (blob_view_simple_point (&view, &x, &y, &z, &m)
+	      && (view.DimensionModel == GAIA_XY_Z
+		  || view.DimensionModel == GAIA_XY_Z_M))
+	      sqlite3_result_double (context, z);
+	  else
+	      sqlite3_result_null (context);
+	  return;
+      }
     geo =
 	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
 				     gpkg_amphibious);
@@ -17822,6 +18006,11 @@ fnct_M (sqlite3_context * context, int argc, sqlite3_value ** argv)
     int n_bytes;
     gaiaGeomCollPtr geo = NULL;
     gaiaPointPtr point;
+    gaiaBlobView view;
+    double x;
+    double y;
+    double z;
+    double m;
     int gpkg_amphibious = 0;
     int gpkg_mode = 0;
     struct splite_internal_cache *cache = sqlite3_user_data (context);
@@ -17838,6 +18027,17 @@ fnct_M (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
+    if (!gpkg_mode && gaiaBlobViewInit (&view, p_blob, n_bytes))
+      {
+	  /* reading the POINT straight from the BLOB */
+	  if (blob_view_simple_point (&view, &x, &y, &z, &m)
+	      && (view.DimensionModel == GAIA_XY_M
+		  || view.DimensionModel == GAIA_XY_Z_M))
+	      sqlite3_result_double (context, m);
+	  else
+	      sqlite3_result_null (context);
+	  return;
+      }
     geo =
 	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
 				     gpkg_amphibious);
@@ -17873,6 +18073,8 @@ fnct_NumPoints (sqlite3_context * context, int argc, sqlite3_value ** argv)
     int n_bytes;
     gaiaGeomCollPtr geo = NULL;
     gaiaLinestringPtr line;
+    gaiaBlobView view;
+    int points;
     int gpkg_amphibious = 0;
     int gpkg_mode = 0;
     struct splite_internal_cache *cache = sqlite3_user_data (context);
@@ -17889,9 +18091,18 @@ fnct_NumPoints (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
+    if (!gpkg_mode && gaiaBlobViewInit (&view, p_blob, n_bytes))
+      {
+	  /* no need to decode the whole Geometry */
+	  if (blob_view_simple_linestring (&view, &points))
+	      sqlite3_result_int (context, points);
+	  else
+	      sqlite3_result_null (context);
+	  return;
+      }
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -17902,7 +18113,43 @@ fnct_NumPoints (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  else
 	      sqlite3_result_int (context, line->Points);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
+}
+
+static void
+point_n_result (sqlite3_context * context, int srid, int dimension_model,
+		double x, double y, double z, double m, int gpkg_mode,
+		int tiny_point)
+{
+/* helper function: returning a POINT extracted by point_n() */
+    int len;
+    unsigned char *p_result = NULL;
+    gaiaGeomCollPtr result;
+    if (dimension_model == GAIA_XY_Z)
+      {
+	  result = gaiaAllocGeomCollXYZ ();
+	  gaiaAddPointToGeomCollXYZ (result, x, y, z);
+      }
+    else if (dimension_model == GAIA_XY_M)
+      {
+	  result = gaiaAllocGeomCollXYM ();
+	  gaiaAddPointToGeomCollXYM (result, x, y, m);
+      }
+    else if (dimension_model == GAIA_XY_Z_M)
+      {
+	  result = gaiaAllocGeomCollXYZM ();
+	  gaiaAddPointToGeomCollXYZM (result, x, y, z, m);
+      }
+    else
+      {
+	  result = gaiaAllocGeomColl ();
+	  gaiaAddPointToGeomColl (result, x, y);
+      }
+    result->Srid = srid;
+    gaiaToSpatiaLiteBlobWkbEx2 (result, &p_result, &len, gpkg_mode,
+				tiny_point);
+    gaiaFreeGeomColl (result);
+    sqlite3_result_blob (context, p_result, len, free);
 }
 
 static void
@@ -17920,15 +18167,14 @@ point_n (sqlite3_context * context, int argc, sqlite3_value ** argv,
     unsigned char *p_blob;
     int n_bytes;
     int vertex;
-    int len;
     double x;
     double y;
     double z;
     double m;
-    unsigned char *p_result = NULL;
     gaiaGeomCollPtr geo = NULL;
-    gaiaGeomCollPtr result;
     gaiaLinestringPtr line;
+    gaiaBlobView view;
+    int points;
     int gpkg_amphibious = 0;
     int gpkg_mode = 0;
     int tiny_point = 0;
@@ -17961,6 +18207,26 @@ point_n (sqlite3_context * context, int argc, sqlite3_value ** argv,
 	vertex = 1;		/* StartPoint() */
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
+    if (!gpkg_mode && gaiaBlobViewInit (&view, p_blob, n_bytes))
+      {
+	  /* reading the vertex straight from the BLOB */
+	  if (!blob_view_simple_linestring (&view, &points))
+	      sqlite3_result_null (context);
+	  else
+	    {
+		if (vertex < 0)
+		    vertex = points - 1;
+		else
+		    vertex -= 1;	/* decreasing the point index by 1, because PointN counts starting at index 1 */
+		if (gaiaBlobViewGetLinestringVertex
+		    (&view, 0, vertex, &x, &y, &z, &m))
+		    point_n_result (context, view.Srid, view.DimensionModel,
+				    x, y, z, m, gpkg_mode, tiny_point);
+		else
+		    sqlite3_result_null (context);
+	    }
+	  return;
+      }
     geo =
 	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
 				     gpkg_amphibious);
@@ -17979,47 +18245,30 @@ point_n (sqlite3_context * context, int argc, sqlite3_value ** argv,
 		    vertex -= 1;	/* decreasing the point index by 1, because PointN counts starting at index 1 */
 		if (vertex >= 0 && vertex < line->Points)
 		  {
+		      z = 0.0;
+		      m = 0.0;
 		      if (line->DimensionModel == GAIA_XY_Z)
 			{
 			    gaiaGetPointXYZ (line->Coords, vertex, &x, &y, &z);
-			    result = gaiaAllocGeomCollXYZ ();
-			    result->Srid = geo->Srid;
-			    gaiaAddPointToGeomCollXYZ (result, x, y, z);
 			}
 		      else if (line->DimensionModel == GAIA_XY_M)
 			{
 			    gaiaGetPointXYM (line->Coords, vertex, &x, &y, &m);
-			    result = gaiaAllocGeomCollXYM ();
-			    result->Srid = geo->Srid;
-			    gaiaAddPointToGeomCollXYM (result, x, y, m);
 			}
 		      else if (line->DimensionModel == GAIA_XY_Z_M)
 			{
 			    gaiaGetPointXYZM (line->Coords, vertex, &x, &y,
 					      &z, &m);
-			    result = gaiaAllocGeomCollXYZM ();
-			    result->Srid = geo->Srid;
-			    gaiaAddPointToGeomCollXYZM (result, x, y, z, m);
 			}
 		      else
 			{
 			    gaiaGetPoint (line->Coords, vertex, &x, &y);
-			    result = gaiaAllocGeomColl ();
-			    result->Srid = geo->Srid;
-			    gaiaAddPointToGeomColl (result, x, y);
 			}
+		      point_n_result (context, geo->Srid, line->DimensionModel,
+				      x, y, z, m, gpkg_mode, tiny_point);
 		  }
 		else
-		    result = NULL;
-		if (!result)
 		    sqlite3_result_null (context);
-		else
-		  {
-		      gaiaToSpatiaLiteBlobWkbEx2 (result, &p_result, &len,
-						  gpkg_mode, tiny_point);
-		      gaiaFreeGeomColl (result);
-		      sqlite3_result_blob (context, p_result, len, free);
-		  }
 	    }
       }
     gaiaFreeGeomColl (geo);
@@ -18158,6 +18407,8 @@ fnct_NumInteriorRings (sqlite3_context * context, int argc,
     int n_bytes;
     gaiaGeomCollPtr geo = NULL;
     gaiaPolygonPtr polyg;
+    gaiaBlobView view;
+    int interiors;
     int gpkg_amphibious = 0;
     int gpkg_mode = 0;
     struct splite_internal_cache *cache = sqlite3_user_data (context);
@@ -18174,9 +18425,18 @@ fnct_NumInteriorRings (sqlite3_context * context, int argc,
       }
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
+    if (!gpkg_mode && gaiaBlobViewInit (&view, p_blob, n_bytes))
+      {
+	  /* no need to decode the whole Geometry */
+	  if (blob_view_simple_polygon (&view, &interiors))
+	      sqlite3_result_int (context, interiors);
+	  else
+	      sqlite3_result_null (context);
+	  return;
+      }
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -18187,7 +18447,7 @@ fnct_NumInteriorRings (sqlite3_context * context, int argc,
 	  else
 	      sqlite3_result_int (context, polyg->NumInteriors);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -18318,6 +18578,7 @@ fnct_NumGeometries (sqlite3_context * context, int argc, sqlite3_value ** argv)
     gaiaLinestringPtr line;
     gaiaPolygonPtr polyg;
     gaiaGeomCollPtr geo = NULL;
+    gaiaBlobView view;
     int gpkg_amphibious = 0;
     int gpkg_mode = 0;
     struct splite_internal_cache *cache = sqlite3_user_data (context);
@@ -18334,9 +18595,17 @@ fnct_NumGeometries (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
+    if (!gpkg_mode && gaiaBlobViewInit (&view, p_blob, n_bytes))
+      {
+	  /* no need to decode the whole Geometry */
+	  sqlite3_result_int (context,
+			      view.NumPoints + view.NumLinestrings +
+			      view.NumPolygons);
+	  return;
+      }
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -18364,7 +18633,7 @@ fnct_NumGeometries (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	    }
 	  sqlite3_result_int (context, cnt);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -18385,6 +18654,7 @@ fnct_NPoints (sqlite3_context * context, int argc, sqlite3_value ** argv)
     gaiaPolygonPtr polyg;
     gaiaRingPtr rng;
     gaiaGeomCollPtr geo = NULL;
+    gaiaBlobView view;
     int gpkg_amphibious = 0;
     int gpkg_mode = 0;
     struct splite_internal_cache *cache = sqlite3_user_data (context);
@@ -18401,9 +18671,15 @@ fnct_NPoints (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
+    if (!gpkg_mode && gaiaBlobViewInit (&view, p_blob, n_bytes))
+      {
+	  /* no need to decode the whole Geometry */
+	  sqlite3_result_int (context, view.NumVertices);
+	  return;
+      }
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -18438,7 +18714,7 @@ fnct_NPoints (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	    }
 	  sqlite3_result_int (context, cnt);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -18456,6 +18732,7 @@ fnct_NRings (sqlite3_context * context, int argc, sqlite3_value ** argv)
     int cnt = 0;
     gaiaPolygonPtr polyg;
     gaiaGeomCollPtr geo = NULL;
+    gaiaBlobView view;
     int gpkg_amphibious = 0;
     int gpkg_mode = 0;
     struct splite_internal_cache *cache = sqlite3_user_data (context);
@@ -18472,9 +18749,15 @@ fnct_NRings (sqlite3_context * context, int argc, sqlite3_value ** argv)
       }
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
+    if (!gpkg_mode && gaiaBlobViewInit (&view, p_blob, n_bytes))
+      {
+	  /* no need to decode the whole Geometry */
+	  sqlite3_result_int (context, view.NumRings);
+	  return;
+      }
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -18488,7 +18771,7 @@ fnct_NRings (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	    }
 	  sqlite3_result_int (context, cnt);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static int
@@ -21171,8 +21454,8 @@ fnct_ToEWKB (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
       {
 	  sqlite3_result_null (context);
@@ -21191,7 +21474,7 @@ fnct_ToEWKB (sqlite3_context * context, int argc, sqlite3_value ** argv)
 		out_buf.Buffer = NULL;
 	    }
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
     gaiaOutBufferReset (&out_buf);
 }
 
@@ -21227,8 +21510,8 @@ fnct_ToEWKT (sqlite3_context * context, int argc, sqlite3_value ** argv)
     n_bytes = sqlite3_value_bytes (argv[0]);
     gaiaOutBufferInitialize (&out_buf);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -21243,7 +21526,7 @@ fnct_ToEWKT (sqlite3_context * context, int argc, sqlite3_value ** argv)
 		out_buf.Buffer = NULL;
 	    }
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
     gaiaOutBufferReset (&out_buf);
 }
 
@@ -23353,15 +23636,15 @@ fnct_IsClosed (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_int (context, -1);
     else
       {
 	  sqlite3_result_int (context, gaiaIsClosedGeom (geo));
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -23396,8 +23679,8 @@ fnct_IsSimple (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_int (context, -1);
     else
@@ -23412,7 +23695,7 @@ fnct_IsSimple (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  else
 	      sqlite3_result_int (context, ret);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -23448,8 +23731,8 @@ fnct_IsRing (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_int (context, -1);
     else
@@ -23467,7 +23750,7 @@ fnct_IsRing (sqlite3_context * context, int argc, sqlite3_value ** argv)
 		sqlite3_result_int (context, ret);
 	    }
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -23612,8 +23895,8 @@ length_common (const void *p_cache, sqlite3_context * context, int argc,
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -23775,7 +24058,7 @@ length_common (const void *p_cache, sqlite3_context * context, int argc,
 	      sqlite3_result_double (context, length);
       }
   stop:
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -23852,8 +24135,8 @@ fnct_3dLength (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -23864,7 +24147,7 @@ fnct_3dLength (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  else
 	      sqlite3_result_double (context, length);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -24044,8 +24327,8 @@ fnct_ToTWKB (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	      with_bbox = 1;
       }
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -24060,7 +24343,7 @@ fnct_ToTWKB (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  else
 	      sqlite3_result_blob (context, twkb, size_twkb, free);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -24117,8 +24400,8 @@ fnct_AsEncodedPolyline (sqlite3_context * context, int argc,
 	      precision = value;
       }
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -24139,7 +24422,7 @@ fnct_AsEncodedPolyline (sqlite3_context * context, int argc,
 	      invalid = 1;
 	  if (invalid)
 	    {
-		gaiaFreeGeomColl (geo);
+		gaiaFreeArenaGeomColl (geo);
 		sqlite3_result_null (context);
 		return;
 	    }
@@ -24151,7 +24434,7 @@ fnct_AsEncodedPolyline (sqlite3_context * context, int argc,
 	  else
 	      sqlite3_result_text (context, encoded, size_encoded, free);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static void
@@ -24262,8 +24545,8 @@ fnct_Area (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -24295,7 +24578,7 @@ fnct_Area (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  else
 	      sqlite3_result_double (context, area);
       }
-    gaiaFreeGeomColl (geo);
+    gaiaFreeArenaGeomColl (geo);
 }
 
 static gaiaGeomCollPtr
@@ -25030,38 +25313,207 @@ fnct_Intersection (sqlite3_context * context, int argc, sqlite3_value ** argv)
 }
 
 static int
-gaia_union_polygs (gaiaGeomCollPtr geom)
+cmp_union_sort_items (const void *p1, const void *p2)
+{
+/* compares two Union items by their Morton key */
+    const struct gaia_union_sort_item *i1 =
+	(const struct gaia_union_sort_item *) p1;
+    const struct gaia_union_sort_item *i2 =
+	(const struct gaia_union_sort_item *) p2;
+    if (i1->key < i2->key)
+	return -1;
+    if (i1->key > i2->key)
+	return 1;
+    return 0;
+}
+
+static unsigned int
+gaia_union_morton (unsigned int x, unsigned int y)
 {
-/* testing if this geometry simply contains Polygons */
-    int pts = 0;
-    int lns = 0;
-    int pgs = 0;
-    gaiaPointPtr pt;
-    gaiaLinestringPtr ln;
-    gaiaPolygonPtr pg;
-    pt = geom->FirstPoint;
-    while (pt)
+/* interleaving two 16-bit values into a 32-bit Morton (Z-order) key */
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    y &= 0x0000ffff;
+    y = (y | (y << 8)) & 0x00ff00ff;
+    y = (y | (y << 4)) & 0x0f0f0f0f;
+    y = (y | (y << 2)) & 0x33333333;
+    y = (y | (y << 1)) & 0x55555555;
+    return x | (y << 1);
+}
+
+static void
+gaia_union_sort_pending (struct gaia_union_agg *agg)
+{
+/* sorting the pending Geometries in Z-order of their MBR centers */
+    int i;
+    double minx = DBL_MAX;
+    double miny = DBL_MAX;
+    double maxx = -DBL_MAX;
+    double maxy = -DBL_MAX;
+    double sx;
+    double sy;
+    struct gaia_union_sort_item *items;
+    if (agg->n_pending < 3)
+	return;
+    items = malloc (sizeof (struct gaia_union_sort_item) * agg->n_pending);
+    if (items == NULL)
+	return;
+    for (i = 0; i < agg->n_pending; i++)
+      {
+	  gaiaGeomCollPtr geom = agg->pending[i];
+	  double cx = (geom->MinX + geom->MaxX) / 2.0;
+	  double cy = (geom->MinY + geom->MaxY) / 2.0;
+	  if (cx < minx)
+	      minx = cx;
+	  if (cx > maxx)
+	      maxx = cx;
+	  if (cy < miny)
+	      miny = cy;
+	  if (cy > maxy)
+	      maxy = cy;
+      }
+    sx = (maxx > minx) ? 65535.0 / (maxx - minx) : 0.0;
+    sy = (maxy > miny) ? 65535.0 / (maxy - miny) : 0.0;
+    for (i = 0; i < agg->n_pending; i++)
+      {
+	  gaiaGeomCollPtr geom = agg->pending[i];
+	  double cx = (geom->MinX + geom->MaxX) / 2.0;
+	  double cy = (geom->MinY + geom->MaxY) / 2.0;
+	  items[i].key =
+	      gaia_union_morton ((unsigned int) ((cx - minx) * sx),
+				 (unsigned int) ((cy - miny) * sy));
+	  items[i].geom = geom;
+      }
+    qsort (items, agg->n_pending, sizeof (struct gaia_union_sort_item),
+	   cmp_union_sort_items);
+    for (i = 0; i < agg->n_pending; i++)
+	agg->pending[i] = items[i].geom;
+    free (items);
+}
+
+static gaiaGeomCollPtr
+gaia_union_reduce (const void *data, gaiaGeomCollPtr * geoms, int count)
+{
+/* 
+/ collecting a batch of Geometries into a single collection and 
+/ then applying UnaryUnion; all input Geometries will be freed 
+*/
+    int i;
+    gaiaGeomCollPtr aggregate = geoms[0];
+    gaiaGeomCollPtr result;
+    for (i = 1; i < count; i++)
       {
-	  pts++;
-	  pt = pt->Next;
+	  if (data != NULL)
+	      gaiaMergeGeometries_r (data, aggregate, geoms[i]);
+	  else
+	      gaiaMergeGeometries (aggregate, geoms[i]);
+	  gaiaFreeGeomColl (geoms[i]);
+	  geoms[i] = NULL;
       }
-    ln = geom->FirstLinestring;
-    while (ln)
+    geoms[0] = NULL;
+    if (gaiaIsEmpty (aggregate))
+	return aggregate;
+    if (data != NULL)
+	result = gaiaUnaryUnion_r (data, aggregate);
+    else
+	result = gaiaUnaryUnion (aggregate);
+    gaiaFreeGeomColl (aggregate);
+    return result;
+}
+
+static void
+gaia_union_push_partial (struct gaia_union_agg *agg, gaiaGeomCollPtr partial)
+{
+/*
+/ cascading a partial Union into the levels stack: exactly as in
+/ a binary counter two partials of the same level are united and
+/ the result is carried to the next level, so that each Geometry
+/ only takes part in about log2(N / batch_size) Union operations
+*/
+    int level = 0;
+    gaiaGeomCollPtr pair[2];
+    if (gaiaIsEmpty (partial))
       {
-	  lns++;
-	  ln = ln->Next;
+	  /* nothing to unite */
+	  gaiaFreeGeomColl (partial);
+	  return;
       }
-    pg = geom->FirstPolygon;
-    while (pg)
+    while (1)
       {
-	  pgs++;
-	  pg = pg->Next;
+	  if (agg->levels[level] == NULL)
+	    {
+		agg->levels[level] = partial;
+		return;
+	    }
+	  pair[0] = agg->levels[level];
+	  pair[1] = partial;
+	  agg->levels[level] = NULL;
+	  partial = gaia_union_reduce (agg->data, pair, 2);
+	  if (partial == NULL)
+	    {
+		agg->error = 1;
+		return;
+	    }
+	  if (level < UNION_MAX_LEVELS - 1)
+	      level++;
       }
-    if (pts || lns)
-	return 0;
-    if (!pgs)
-	return 0;
-    return 1;
+}
+
+static void
+gaia_union_flush_pending (struct gaia_union_agg *agg)
+{
+/* reducing all pending Geometries, batch by batch */
+    int base = 0;
+    if (agg->n_pending == 0)
+	return;
+    if (agg->spatial_sort)
+	gaia_union_sort_pending (agg);
+    while (base < agg->n_pending)
+      {
+	  gaiaGeomCollPtr partial;
+	  int count = agg->n_pending - base;
+	  if (count > agg->batch_size)
+	      count = agg->batch_size;
+	  if (agg->error)
+	    {
+		int i;
+		for (i = base; i < base + count; i++)
+		  {
+		      gaiaFreeGeomColl (agg->pending[i]);
+		      agg->pending[i] = NULL;
+		  }
+	    }
+	  else
+	    {
+		partial =
+		    gaia_union_reduce (agg->data, agg->pending + base, count);
+		if (partial == NULL)
+		    agg->error = 1;
+		else
+		    gaia_union_push_partial (agg, partial);
+	    }
+	  base += count;
+      }
+    agg->n_pending = 0;
+}
+
+static void
+gaia_free_union_agg (struct gaia_union_agg *agg)
+{
+/* memory cleanup - Union aggregate */
+    int i;
+    for (i = 0; i < agg->n_pending; i++)
+	gaiaFreeGeomColl (agg->pending[i]);
+    for (i = 0; i < UNION_MAX_LEVELS; i++)
+      {
+	  if (agg->levels[i] != NULL)
+	      gaiaFreeGeomColl (agg->levels[i]);
+      }
+    free (agg->pending);
+    free (agg);
 }
 
 static void
@@ -25072,21 +25524,29 @@ fnct_Union_step (sqlite3_context * context, int argc, sqlite3_value ** argv)
 /
 / aggregate function - STEP
 /
+/ Geometries are accumulated in batches; each full batch is reduced
+/ by UnaryUnion and the partial results are then cascaded (united
+/ pairwise), so that peak memory stays bounded by the batch size
+/ and by the depth of the cascade
+/
 */
-    struct gaia_geom_chain *chain;
-    struct gaia_geom_chain_item *item;
+    struct gaia_union_agg *agg;
     unsigned char *p_blob;
     int n_bytes;
     gaiaGeomCollPtr geom;
-    struct gaia_geom_chain **p;
+    struct gaia_union_agg **p;
     int gpkg_amphibious = 0;
     int gpkg_mode = 0;
+    int batch_size = UNION_DEFAULT_BATCH_SIZE;
+    int spatial_sort = 0;
     struct splite_internal_cache *cache = sqlite3_user_data (context);
     GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
     if (cache != NULL)
       {
 	  gpkg_amphibious = cache->gpkg_amphibious_mode;
 	  gpkg_mode = cache->gpkg_mode;
+	  batch_size = cache->union_batch_size;
+	  spatial_sort = cache->union_spatial_sort;
       }
     if (sqlite3_value_type (argv[0]) != SQLITE_BLOB)
       {
@@ -25100,46 +25560,42 @@ fnct_Union_step (sqlite3_context * context, int argc, sqlite3_value ** argv)
 				     gpkg_amphibious);
     if (!geom)
 	return;
-    p = sqlite3_aggregate_context (context, sizeof (struct gaia_geom_chain **));
+    p = sqlite3_aggregate_context (context, sizeof (struct gaia_union_agg **));
     if (!(*p))
       {
 	  /* this is the first row */
-	  chain = malloc (sizeof (struct gaia_geom_chain));
-	  *p = chain;
-	  item = malloc (sizeof (struct gaia_geom_chain_item));
-	  item->geom = geom;
-	  item->next = NULL;
-	  chain->all_polygs = gaia_union_polygs (geom);
-	  chain->first = item;
-	  chain->last = item;
-      }
-    else
-      {
-	  /* subsequent rows */
-	  chain = *p;
-	  item = malloc (sizeof (struct gaia_geom_chain_item));
-	  item->geom = geom;
-	  item->next = NULL;
-	  if (!gaia_union_polygs (geom))
-	      chain->all_polygs = 0;
-	  chain->last->next = item;
-	  chain->last = item;
+	  agg = calloc (1, sizeof (struct gaia_union_agg));
+	  if (agg == NULL)
+	    {
+		gaiaFreeGeomColl (geom);
+		return;
+	    }
+	  if (batch_size < 2)
+	      batch_size = 2;
+	  agg->data = cache;
+	  agg->batch_size = batch_size;
+	  agg->spatial_sort = spatial_sort;
+	  agg->max_pending =
+	      spatial_sort ? batch_size * UNION_SORT_WINDOW : batch_size;
+	  agg->pending = malloc (sizeof (gaiaGeomCollPtr) * agg->max_pending);
+	  if (agg->pending == NULL)
+	    {
+		free (agg);
+		gaiaFreeGeomColl (geom);
+		return;
+	    }
+	  *p = agg;
       }
-}
-
-static void
-gaia_free_geom_chain (struct gaia_geom_chain *chain)
-{
-    struct gaia_geom_chain_item *p = chain->first;
-    struct gaia_geom_chain_item *pn;
-    while (p)
+    agg = *p;
+    if (agg->error)
       {
-	  pn = p->next;
-	  gaiaFreeGeomColl (p->geom);
-	  free (p);
-	  p = pn;
+	  /* some previous Union already failed */
+	  gaiaFreeGeomColl (geom);
+	  return;
       }
-    free (chain);
+    agg->pending[agg->n_pending++] = geom;
+    if (agg->n_pending >= agg->max_pending)
+	gaia_union_flush_pending (agg);
 }
 
 static void
@@ -25151,13 +25607,11 @@ fnct_Union_final (sqlite3_context * context)
 / aggregate function - FINAL
 /
 */
-    gaiaGeomCollPtr tmp;
-    struct gaia_geom_chain *chain;
-    struct gaia_geom_chain_item *item;
-    gaiaGeomCollPtr aggregate = NULL;
-    gaiaGeomCollPtr result;
-    void *data = sqlite3_user_data (context);
-    struct gaia_geom_chain **p = sqlite3_aggregate_context (context, 0);
+    struct gaia_union_agg *agg;
+    gaiaGeomCollPtr result = NULL;
+    gaiaGeomCollPtr partial;
+    int i;
+    struct gaia_union_agg **p = sqlite3_aggregate_context (context, 0);
     int gpkg_mode = 0;
     int tiny_point = 0;
     struct splite_internal_cache *cache = sqlite3_user_data (context);
@@ -25171,36 +25625,40 @@ fnct_Union_final (sqlite3_context * context)
 	  sqlite3_result_null (context);
 	  return;
       }
-    chain = *p;
+    agg = *p;
+    if (agg == NULL)
+      {
+	  sqlite3_result_null (context);
+	  return;
+      }
 
-/* applying UnaryUnion */
-    item = chain->first;
-    while (item)
+/* reducing the last incomplete batch */
+    gaia_union_flush_pending (agg);
+/* and then uniting together all partial results, lowest level first */
+    for (i = 0; i < UNION_MAX_LEVELS && !agg->error; i++)
       {
-	  gaiaGeomCollPtr geom = item->geom;
-	  if (item == chain->first)
+	  gaiaGeomCollPtr pair[2];
+	  partial = agg->levels[i];
+	  if (partial == NULL)
+	      continue;
+	  agg->levels[i] = NULL;
+	  if (result == NULL)
 	    {
-		/* initializing the aggregate geometry */
-		aggregate = geom;
-		item->geom = NULL;
-		item = item->next;
+		result = partial;
 		continue;
 	    }
-	  if (data != NULL)
-	      tmp = gaiaMergeGeometries_r (data, aggregate, geom);
-	  else
-	      tmp = gaiaMergeGeometries (aggregate, geom);
-	  gaiaFreeGeomColl (geom);
-	  item->geom = NULL;
-	  aggregate = tmp;
-	  item = item->next;
+	  pair[0] = partial;
+	  pair[1] = result;
+	  result = gaia_union_reduce (agg->data, pair, 2);
+	  if (result == NULL)
+	      agg->error = 1;
       }
-    if (data != NULL)
-	result = gaiaUnaryUnion_r (data, aggregate);
-    else
-	result = gaiaUnaryUnion (aggregate);
-    gaiaFreeGeomColl (aggregate);
-    gaia_free_geom_chain (chain);
+    if (agg->error && result != NULL)
+      {
+	  gaiaFreeGeomColl (result);
+	  result = NULL;
+      }
+    gaia_free_union_agg (agg);
 
     if (result == NULL)
 	sqlite3_result_null (context);
@@ -36749,6 +37207,12 @@ fnct_create_routing (sqlite3_context * context, int argc, sqlite3_value ** argv)
 /               geom-column TEXT , cost-column TEXT , name-column TEXT ,
 /               a-star-enabled BOOLEAN , bidirectional BOOLEAN ,
 /               oneway-from TEXT , oneway-to TEXT , overwrite BOOLEAN )
+/ CreateRouting(routing-data-table TEXT , virtual-routing-table TEXT , 
+/               input-table TEXT , from-column TEXT , to-column TEXT , 
+/               geom-column TEXT , cost-column TEXT , name-column TEXT ,
+/               a-star-enabled BOOLEAN , bidirectional BOOLEAN ,
+/               oneway-from TEXT , oneway-to TEXT , overwrite BOOLEAN ,
+/               contraction-hierarchies BOOLEAN )
 /
 / returns:
 / 1 on succes
@@ -36767,6 +37231,7 @@ fnct_create_routing (sqlite3_context * context, int argc, sqlite3_value ** argv)
     const char *oneway_from = NULL;
     const char *oneway_to = NULL;
     int overwrite = 0;
+    int ch_enabled = 0;
     const char *msg;
     sqlite3 *sqlite = sqlite3_context_db_handle (context);
     struct splite_internal_cache *cache = sqlite3_user_data (context);
@@ -36834,11 +37299,17 @@ fnct_create_routing (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	      goto invalid_argument_13;
 	  overwrite = sqlite3_value_int (argv[12]);
       }
-    if (gaia_create_routing
+    if (argc >= 14)
+      {
+	  if (sqlite3_value_type (argv[13]) != SQLITE_INTEGER)
+	      goto invalid_argument_14;
+	  ch_enabled = sqlite3_value_int (argv[13]);
+      }
+    if (gaia_create_routing_ex
 	(sqlite, cache, routing_data_table, virtual_routing_table,
 	 input_table, from_column, to_column, geom_column, cost_column,
 	 name_column, a_star_enabled, bidirectional, oneway_from, oneway_to,
-	 overwrite))
+	 overwrite, ch_enabled))
 	sqlite3_result_int (context, 1);
     else
       {
@@ -36932,6 +37403,372 @@ fnct_create_routing (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	"CreateRouting exception - illegal OverWrite option [not an INTEGER].";
     sqlite3_result_error (context, msg, -1);
     return;
+
+  invalid_argument_14:
+    msg =
+	"CreateRouting exception - illegal Contraction Hierarchies option [not an INTEGER].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+}
+
+static void
+fnct_create_routing_turns (sqlite3_context * context, int argc,
+			   sqlite3_value ** argv)
+{
+/* SQL function:
+/ CreateRoutingTurns(routing-data-table TEXT , input-table TEXT ,
+/                    from-link-column TEXT , to-link-column TEXT )
+/ CreateRoutingTurns(routing-data-table TEXT , input-table TEXT ,
+/                    from-link-column TEXT , to-link-column TEXT ,
+/                    cost-column TEXT )
+/
+/ returns:
+/ 1 on succes
+/ raises an exception on invalid arguments or errors
+*/
+    const char *routing_data_table;
+    const char *input_table;
+    const char *from_link_column;
+    const char *to_link_column;
+    const char *cost_column = NULL;
+    const char *msg;
+    sqlite3 *sqlite = sqlite3_context_db_handle (context);
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (sqlite3_value_type (argv[0]) != SQLITE_TEXT)
+	goto invalid_argument_1;
+    routing_data_table = (const char *) sqlite3_value_text (argv[0]);
+    if (sqlite3_value_type (argv[1]) != SQLITE_TEXT)
+	goto invalid_argument_2;
+    input_table = (const char *) sqlite3_value_text (argv[1]);
+    if (sqlite3_value_type (argv[2]) != SQLITE_TEXT)
+	goto invalid_argument_3;
+    from_link_column = (const char *) sqlite3_value_text (argv[2]);
+    if (sqlite3_value_type (argv[3]) != SQLITE_TEXT)
+	goto invalid_argument_4;
+    to_link_column = (const char *) sqlite3_value_text (argv[3]);
+    if (argc >= 5)
+      {
+	  if (sqlite3_value_type (argv[4]) == SQLITE_NULL)
+	      cost_column = NULL;
+	  else if (sqlite3_value_type (argv[4]) == SQLITE_TEXT)
+	      cost_column = (const char *) sqlite3_value_text (argv[4]);
+	  else
+	      goto invalid_argument_5;
+      }
+    if (gaia_create_routing_turns
+	(sqlite, cache, routing_data_table, input_table, from_link_column,
+	 to_link_column, cost_column))
+	sqlite3_result_int (context, 1);
+    else
+      {
+	  /* there was an error, raising an Exception */
+	  char *msg_err;
+	  msg = gaia_create_routing_get_last_error (cache);
+	  if (msg == NULL)
+	      msg_err =
+		  sqlite3_mprintf
+		  ("CreateRoutingTurns exception - Unknown reason");
+	  else
+	      msg_err =
+		  sqlite3_mprintf ("CreateRoutingTurns exception - %s", msg);
+	  sqlite3_result_error (context, msg_err, -1);
+	  sqlite3_free (msg_err);
+      }
+    return;
+
+  invalid_argument_1:
+    msg =
+	"CreateRoutingTurns exception - illegal Routing Data Table Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_2:
+    msg =
+	"CreateRoutingTurns exception - illegal Input Table Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_3:
+    msg =
+	"CreateRoutingTurns exception - illegal FromLink Column Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_4:
+    msg =
+	"CreateRoutingTurns exception - illegal ToLink Column Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_5:
+    msg =
+	"CreateRoutingTurns exception - illegal Cost Column Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+}
+
+static void
+fnct_create_routing_profiles (sqlite3_context * context, int argc,
+			      sqlite3_value ** argv)
+{
+/* SQL function:
+/ CreateRoutingProfiles(routing-data-table TEXT , input-table TEXT ,
+/                       link-column TEXT , time-column TEXT ,
+/                       cost-column TEXT )
+/
+/ returns:
+/ 1 on succes
+/ raises an exception on invalid arguments or errors
+*/
+    const char *routing_data_table;
+    const char *input_table;
+    const char *link_column;
+    const char *time_column;
+    const char *cost_column;
+    const char *msg;
+    sqlite3 *sqlite = sqlite3_context_db_handle (context);
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (sqlite3_value_type (argv[0]) != SQLITE_TEXT)
+	goto invalid_argument_1;
+    routing_data_table = (const char *) sqlite3_value_text (argv[0]);
+    if (sqlite3_value_type (argv[1]) != SQLITE_TEXT)
+	goto invalid_argument_2;
+    input_table = (const char *) sqlite3_value_text (argv[1]);
+    if (sqlite3_value_type (argv[2]) != SQLITE_TEXT)
+	goto invalid_argument_3;
+    link_column = (const char *) sqlite3_value_text (argv[2]);
+    if (sqlite3_value_type (argv[3]) != SQLITE_TEXT)
+	goto invalid_argument_4;
+    time_column = (const char *) sqlite3_value_text (argv[3]);
+    if (sqlite3_value_type (argv[4]) != SQLITE_TEXT)
+	goto invalid_argument_5;
+    cost_column = (const char *) sqlite3_value_text (argv[4]);
+    if (gaia_create_routing_profiles
+	(sqlite, cache, routing_data_table, input_table, link_column,
+	 time_column, cost_column))
+	sqlite3_result_int (context, 1);
+    else
+      {
+	  /* there was an error, raising an Exception */
+	  char *msg_err;
+	  msg = gaia_create_routing_get_last_error (cache);
+	  if (msg == NULL)
+	      msg_err =
+		  sqlite3_mprintf
+		  ("CreateRoutingProfiles exception - Unknown reason");
+	  else
+	      msg_err =
+		  sqlite3_mprintf ("CreateRoutingProfiles exception - %s",
+				   msg);
+	  sqlite3_result_error (context, msg_err, -1);
+	  sqlite3_free (msg_err);
+      }
+    return;
+
+  invalid_argument_1:
+    msg =
+	"CreateRoutingProfiles exception - illegal Routing Data Table Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_2:
+    msg =
+	"CreateRoutingProfiles exception - illegal Input Table Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_3:
+    msg =
+	"CreateRoutingProfiles exception - illegal Link Column Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_4:
+    msg =
+	"CreateRoutingProfiles exception - illegal Time Column Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_5:
+    msg =
+	"CreateRoutingProfiles exception - illegal Cost Column Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+}
+
+static sqlite3_int64 *
+parse_link_rowids (sqlite3_value * value, int *count)
+{
+/* parsing a single Link ROWID or a comma separated list of ROWIDs */
+    sqlite3_int64 *rowids;
+    const char *p;
+    int max = 1;
+    *count = 0;
+    if (sqlite3_value_type (value) == SQLITE_INTEGER)
+      {
+	  rowids = malloc (sizeof (sqlite3_int64));
+	  *rowids = sqlite3_value_int64 (value);
+	  *count = 1;
+	  return rowids;
+      }
+    if (sqlite3_value_type (value) != SQLITE_TEXT)
+	return NULL;
+    for (p = (const char *) sqlite3_value_text (value); *p != '\0'; p++)
+      {
+	  if (*p == ',')
+	      max++;
+      }
+    rowids = malloc (sizeof (sqlite3_int64) * max);
+    p = (const char *) sqlite3_value_text (value);
+    while (1)
+      {
+	  char *end;
+	  while (*p == ' ')
+	      p++;
+	  if (*p < '0' || *p > '9')
+	      goto invalid;
+	  rowids[*count] = strtoll (p, &end, 10);
+	  *count += 1;
+	  p = end;
+	  while (*p == ' ')
+	      p++;
+	  if (*p == '\0')
+	      break;
+	  if (*p != ',')
+	      goto invalid;
+	  p++;
+      }
+    return rowids;
+  invalid:
+    free (rowids);
+    *count = 0;
+    return NULL;
+}
+
+static void
+fnct_create_routing_update_links (sqlite3_context * context, int argc,
+				  sqlite3_value ** argv)
+{
+/* SQL function:
+/ CreateRouting_UpdateLinks(routing-data-table TEXT , link-rowids ,
+/                           cost-column TEXT )
+/ CreateRouting_UpdateLinks(routing-data-table TEXT , link-rowids ,
+/                           cost-column TEXT , bidirectional BOOLEAN )
+/ CreateRouting_UpdateLinks(routing-data-table TEXT , link-rowids ,
+/                           cost-column TEXT , bidirectional BOOLEAN ,
+/                           oneway-from TEXT , oneway-to TEXT )
+/
+/ link-rowids could be a single INTEGER or a TEXT string containing
+/ a comma separated list of ROWIDs
+/
+/ returns:
+/ 1 on succes
+/ raises an exception on invalid arguments or errors
+*/
+    const char *routing_data_table;
+    sqlite3_int64 *link_rowids = NULL;
+    int count;
+    const char *cost_column;
+    int bidirectional = 1;
+    const char *oneway_from = NULL;
+    const char *oneway_to = NULL;
+    const char *msg;
+    sqlite3 *sqlite = sqlite3_context_db_handle (context);
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (sqlite3_value_type (argv[0]) != SQLITE_TEXT)
+	goto invalid_argument_1;
+    routing_data_table = (const char *) sqlite3_value_text (argv[0]);
+    if (sqlite3_value_type (argv[2]) == SQLITE_NULL)
+	cost_column = NULL;
+    else if (sqlite3_value_type (argv[2]) == SQLITE_TEXT)
+	cost_column = (const char *) sqlite3_value_text (argv[2]);
+    else
+	goto invalid_argument_3;
+    if (argc >= 4)
+      {
+	  if (sqlite3_value_type (argv[3]) != SQLITE_INTEGER)
+	      goto invalid_argument_4;
+	  bidirectional = sqlite3_value_int (argv[3]);
+      }
+    if (argc >= 6)
+      {
+	  if (sqlite3_value_type (argv[4]) == SQLITE_NULL)
+	      oneway_from = NULL;
+	  else if (sqlite3_value_type (argv[4]) == SQLITE_TEXT)
+	      oneway_from = (const char *) sqlite3_value_text (argv[4]);
+	  else
+	      goto invalid_argument_5;
+	  if (sqlite3_value_type (argv[5]) == SQLITE_NULL)
+	      oneway_to = NULL;
+	  else if (sqlite3_value_type (argv[5]) == SQLITE_TEXT)
+	      oneway_to = (const char *) sqlite3_value_text (argv[5]);
+	  else
+	      goto invalid_argument_6;
+      }
+    link_rowids = parse_link_rowids (argv[1], &count);
+    if (link_rowids == NULL)
+	goto invalid_argument_2;
+    if (gaia_create_routing_update_links
+	(sqlite, cache, routing_data_table, link_rowids, count, cost_column,
+	 bidirectional, oneway_from, oneway_to))
+	sqlite3_result_int (context, 1);
+    else
+      {
+	  /* there was an error, raising an Exception */
+	  char *msg_err;
+	  msg = gaia_create_routing_get_last_error (cache);
+	  if (msg == NULL)
+	      msg_err =
+		  sqlite3_mprintf
+		  ("CreateRouting_UpdateLinks exception - Unknown reason");
+	  else
+	      msg_err =
+		  sqlite3_mprintf ("CreateRouting_UpdateLinks exception - %s",
+				   msg);
+	  sqlite3_result_error (context, msg_err, -1);
+	  sqlite3_free (msg_err);
+      }
+    free (link_rowids);
+    return;
+
+  invalid_argument_1:
+    msg =
+	"CreateRouting_UpdateLinks exception - illegal Routing Data Table Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_2:
+    msg =
+	"CreateRouting_UpdateLinks exception - illegal Link ROWIDs [not an INTEGER or a comma separated list].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_3:
+    msg =
+	"CreateRouting_UpdateLinks exception - illegal Cost Column Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_4:
+    msg =
+	"CreateRouting_UpdateLinks exception - illegal Bidirectional option [not an INTEGER].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_5:
+    msg =
+	"CreateRouting_UpdateLinks exception - illegal OnewayFromTo Column Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_6:
+    msg =
+	"CreateRouting_UpdateLinks exception - illegal OnewayToFrom Column Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
 }
 
 static void
@@ -36961,6 +37798,297 @@ fnct_create_routing_get_last_error (sqlite3_context * context, int argc,
 	sqlite3_result_text (context, err_msg, strlen (err_msg), SQLITE_STATIC);
 }
 
+static void
+fnct_parallel_spatial_join (sqlite3_context * context, int argc,
+			    sqlite3_value ** argv)
+{
+/* SQL function:
+/ ParallelSpatialJoin(left-table TEXT , left-geom TEXT ,
+/                     right-table TEXT , right-geom TEXT ,
+/                     predicate TEXT , out-table TEXT )
+/ ParallelSpatialJoin(left-table TEXT , left-geom TEXT ,
+/                     right-table TEXT , right-geom TEXT ,
+/                     predicate TEXT , out-table TEXT , threads INT )
+/
+/ creates the output table (left_rowid, right_rowid) containing all
+/ pairs of features satisfying the Spatial Predicate; the Left table
+/ is partitioned by grid cells (or by ROWID ranges) and each partition
+/ is evaluated by a worker thread on its own connection
+/
+/ returns:
+/ the number of joined pairs on success
+/ raises an exception on invalid arguments or errors
+*/
+    const char *left_table;
+    const char *left_geom;
+    const char *right_table;
+    const char *right_geom;
+    const char *predicate;
+    const char *out_table;
+    int threads = 0;
+    sqlite3_int64 count;
+    const char *msg;
+    sqlite3 *sqlite = sqlite3_context_db_handle (context);
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (sqlite3_value_type (argv[0]) != SQLITE_TEXT)
+	goto invalid_argument_1;
+    left_table = (const char *) sqlite3_value_text (argv[0]);
+    if (sqlite3_value_type (argv[1]) != SQLITE_TEXT)
+	goto invalid_argument_2;
+    left_geom = (const char *) sqlite3_value_text (argv[1]);
+    if (sqlite3_value_type (argv[2]) != SQLITE_TEXT)
+	goto invalid_argument_3;
+    right_table = (const char *) sqlite3_value_text (argv[2]);
+    if (sqlite3_value_type (argv[3]) != SQLITE_TEXT)
+	goto invalid_argument_4;
+    right_geom = (const char *) sqlite3_value_text (argv[3]);
+    if (sqlite3_value_type (argv[4]) != SQLITE_TEXT)
+	goto invalid_argument_5;
+    predicate = (const char *) sqlite3_value_text (argv[4]);
+    if (sqlite3_value_type (argv[5]) != SQLITE_TEXT)
+	goto invalid_argument_6;
+    out_table = (const char *) sqlite3_value_text (argv[5]);
+    if (argc >= 7)
+      {
+	  if (sqlite3_value_type (argv[6]) != SQLITE_INTEGER)
+	      goto invalid_argument_7;
+	  threads = sqlite3_value_int (argv[6]);
+      }
+    if (gaia_parallel_spatial_join
+	(sqlite, cache, left_table, left_geom, right_table, right_geom,
+	 predicate, out_table, threads, &count))
+	sqlite3_result_int64 (context, count);
+    else
+      {
+	  /* there was an error, raising an Exception */
+	  char *msg_err;
+	  msg = gaia_parallel_spatial_join_get_last_error (cache);
+	  if (msg == NULL)
+	      msg_err =
+		  sqlite3_mprintf
+		  ("ParallelSpatialJoin exception - Unknown reason");
+	  else
+	      msg_err =
+		  sqlite3_mprintf ("ParallelSpatialJoin exception - %s", msg);
+	  sqlite3_result_error (context, msg_err, -1);
+	  sqlite3_free (msg_err);
+      }
+    return;
+
+  invalid_argument_1:
+    msg =
+	"ParallelSpatialJoin exception - illegal Left Table Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_2:
+    msg =
+	"ParallelSpatialJoin exception - illegal Left Geometry Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_3:
+    msg =
+	"ParallelSpatialJoin exception - illegal Right Table Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_4:
+    msg =
+	"ParallelSpatialJoin exception - illegal Right Geometry Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_5:
+    msg =
+	"ParallelSpatialJoin exception - illegal Spatial Predicate [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_6:
+    msg =
+	"ParallelSpatialJoin exception - illegal Output Table Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_7:
+    msg =
+	"ParallelSpatialJoin exception - illegal Threads [not an INTEGER].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+}
+
+static void
+fnct_parallel_spatial_join_get_last_error (sqlite3_context * context,
+					   int argc, sqlite3_value ** argv)
+{
+/* SQL function:
+/ ParallelSpatialJoin_GetLastError()
+/
+/ returns:
+/ the most recent error message raised by ParallelSpatialJoin
+/ or NULL if no such message is available
+*/
+    const char *err_msg;
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_null (context);
+	  return;
+      }
+
+    err_msg = gaia_parallel_spatial_join_get_last_error (cache);
+    if (err_msg == NULL)
+	sqlite3_result_null (context);
+    else
+	sqlite3_result_text (context, err_msg, strlen (err_msg), SQLITE_STATIC);
+}
+
+#ifndef OMIT_GEOS		/* only if GEOS is enabled */
+#ifndef OMIT_KNN		/* only if KNN is enabled */
+static void
+fnct_knn_join (sqlite3_context * context, int argc, sqlite3_value ** argv)
+{
+/* SQL function:
+/ KNN_Join(point-table TEXT , point-geom TEXT , target-table TEXT ,
+/          target-geom TEXT , k INT , out-table TEXT )
+/ KNN_Join(point-table TEXT , point-geom TEXT , target-table TEXT ,
+/          target-geom TEXT , k INT , out-table TEXT , threads INT )
+/
+/ creates the output table (point_rowid, pos, target_rowid, distance)
+/ containing the K nearest Target features for every Point; Points
+/ are processed in Hilbert order, split into blocks evaluated by
+/ worker threads on their own connections
+/
+/ returns:
+/ the number of output rows on success
+/ raises an exception on invalid arguments or errors
+*/
+    const char *point_table;
+    const char *point_geom;
+    const char *target_table;
+    const char *target_geom;
+    int k;
+    const char *out_table;
+    int threads = 0;
+    sqlite3_int64 count;
+    const char *msg;
+    sqlite3 *sqlite = sqlite3_context_db_handle (context);
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (sqlite3_value_type (argv[0]) != SQLITE_TEXT)
+	goto invalid_argument_1;
+    point_table = (const char *) sqlite3_value_text (argv[0]);
+    if (sqlite3_value_type (argv[1]) != SQLITE_TEXT)
+	goto invalid_argument_2;
+    point_geom = (const char *) sqlite3_value_text (argv[1]);
+    if (sqlite3_value_type (argv[2]) != SQLITE_TEXT)
+	goto invalid_argument_3;
+    target_table = (const char *) sqlite3_value_text (argv[2]);
+    if (sqlite3_value_type (argv[3]) != SQLITE_TEXT)
+	goto invalid_argument_4;
+    target_geom = (const char *) sqlite3_value_text (argv[3]);
+    if (sqlite3_value_type (argv[4]) != SQLITE_INTEGER)
+	goto invalid_argument_5;
+    k = sqlite3_value_int (argv[4]);
+    if (sqlite3_value_type (argv[5]) != SQLITE_TEXT)
+	goto invalid_argument_6;
+    out_table = (const char *) sqlite3_value_text (argv[5]);
+    if (argc >= 7)
+      {
+	  if (sqlite3_value_type (argv[6]) != SQLITE_INTEGER)
+	      goto invalid_argument_7;
+	  threads = sqlite3_value_int (argv[6]);
+      }
+    if (gaia_knn_join
+	(sqlite, cache, point_table, point_geom, target_table, target_geom, k,
+	 out_table, threads, &count))
+	sqlite3_result_int64 (context, count);
+    else
+      {
+	  /* there was an error, raising an Exception */
+	  char *msg_err;
+	  msg = gaia_knn_join_get_last_error (cache);
+	  if (msg == NULL)
+	      msg_err = sqlite3_mprintf ("KNN_Join exception - Unknown reason");
+	  else
+	      msg_err = sqlite3_mprintf ("KNN_Join exception - %s", msg);
+	  sqlite3_result_error (context, msg_err, -1);
+	  sqlite3_free (msg_err);
+      }
+    return;
+
+  invalid_argument_1:
+    msg = "KNN_Join exception - illegal Point Table Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_2:
+    msg =
+	"KNN_Join exception - illegal Point Geometry Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_3:
+    msg =
+	"KNN_Join exception - illegal Target Table Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_4:
+    msg =
+	"KNN_Join exception - illegal Target Geometry Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_5:
+    msg = "KNN_Join exception - illegal K [not an INTEGER].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_6:
+    msg =
+	"KNN_Join exception - illegal Output Table Name [not a TEXT string].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+
+  invalid_argument_7:
+    msg = "KNN_Join exception - illegal Threads [not an INTEGER].";
+    sqlite3_result_error (context, msg, -1);
+    return;
+}
+
+static void
+fnct_knn_join_get_last_error (sqlite3_context * context, int argc,
+			      sqlite3_value ** argv)
+{
+/* SQL function:
+/ KNN_Join_GetLastError()
+/
+/ returns:
+/ the most recent error message raised by KNN_Join
+/ or NULL if no such message is available
+*/
+    const char *err_msg;
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_null (context);
+	  return;
+      }
+
+    err_msg = gaia_knn_join_get_last_error (cache);
+    if (err_msg == NULL)
+	sqlite3_result_null (context);
+    else
+	sqlite3_result_text (context, err_msg, strlen (err_msg), SQLITE_STATIC);
+}
+#endif /* end KNN conditional */
+#endif /* end GEOS conditional */
+
 #ifndef OMIT_FREEXL		/* FREEXL is enabled */
 static void
 fnct_ImportXLS (sqlite3_context * context, int argc, sqlite3_value ** argv)
@@ -37233,6 +38361,11 @@ fnct_ImportSHP (sqlite3_context * context, int argc, sqlite3_value ** argv)
 /           INT coerce2d, INT compressed, INT spatial_index,
 /           INT text_dates, TEXT colname_case, INT update_statistics,
 /           INT verbose)
+/ ImportSHP(TEXT filename, TEXT table, TEXT charset, INT srid, 
+/           TEXT geom_column, TEXT pk_column, TEXT geom_type,
+/           INT coerce2d, INT compressed, INT spatial_index,
+/           INT text_dates, TEXT colname_case, INT update_statistics,
+/           INT verbose, INT threads)
 /
 / returns:
 / the number of imported rows
@@ -37249,6 +38382,7 @@ fnct_ImportSHP (sqlite3_context * context, int argc, sqlite3_value ** argv)
     int text_dates = 0;
     int update_statistics = 1;
     int verbose = 1;
+    int threads = 1;
     char *pk_column = NULL;
     char *geo_column = NULL;
     char *geom_type = NULL;
@@ -37394,12 +38528,22 @@ fnct_ImportSHP (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	  else
 	      verbose = sqlite3_value_int (argv[13]);
       }
+    if (argc > 14)
+      {
+	  if (sqlite3_value_type (argv[14]) != SQLITE_INTEGER)
+	    {
+		sqlite3_result_null (context);
+		return;
+	    }
+	  else
+	      threads = sqlite3_value_int (argv[14]);
+      }
 
     ret =
-	load_shapefile_ex3 (db_handle, path, table, charset, srid, geo_column,
+	load_shapefile_ex4 (db_handle, path, table, charset, srid, geo_column,
 			    geom_type, pk_column, coerce2d, compressed,
 			    verbose, spatial_index, text_dates, &rows,
-			    colname_case, NULL);
+			    colname_case, threads, NULL);
 
     if (rows < 0 || !ret)
 	sqlite3_result_null (context);
@@ -38361,8 +39505,8 @@ fnct_GeodesicLength (sqlite3_context * context, int argc, sqlite3_value ** argv)
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -38429,7 +39573,7 @@ fnct_GeodesicLength (sqlite3_context * context, int argc, sqlite3_value ** argv)
 	    }
 	  else
 	      sqlite3_result_null (context);
-	  gaiaFreeGeomColl (geo);
+	  gaiaFreeArenaGeomColl (geo);
       }
 }
 
@@ -38472,8 +39616,8 @@ fnct_GreatCircleLength (sqlite3_context * context, int argc,
     p_blob = (unsigned char *) sqlite3_value_blob (argv[0]);
     n_bytes = sqlite3_value_bytes (argv[0]);
     geo =
-	gaiaFromSpatiaLiteBlobWkbEx (p_blob, n_bytes, gpkg_mode,
-				     gpkg_amphibious);
+	gaiaFromSpatiaLiteBlobWkbArena (p_blob, n_bytes, gpkg_mode,
+				        gpkg_amphibious);
     if (!geo)
 	sqlite3_result_null (context);
     else
@@ -38521,7 +39665,7 @@ fnct_GreatCircleLength (sqlite3_context * context, int argc,
 	    }
 	  else
 	      sqlite3_result_null (context);
-	  gaiaFreeGeomColl (geo);
+	  gaiaFreeArenaGeomColl (geo);
       }
 }
 
@@ -44763,6 +45907,157 @@ fnct_Pause (sqlite3_context * context, int argc, sqlite3_value ** argv)
 #endif
 }
 
+static int
+deferred_rtree_commit_hook (void *p_cache)
+{
+/*
+/ COMMIT hook (deferred SpatialIndex mode)
+/
+/ SQLite forbids executing any SQL statement from within a COMMIT
+/ hook, so the pending R*Tree entries can't be flushed here: the
+/ COMMIT is then vetoed (and thus rolled back) rather than leaving
+/ a stale SpatialIndex behind; the same applies if some entry has
+/ been lost while queuing
+*/
+    struct splite_internal_cache *cache =
+	(struct splite_internal_cache *) p_cache;
+    if (cache->first_deferred_rtree != NULL || cache->deferred_rtree_lost)
+	return 1;
+    cache->deferred_rtree_enabled = 0;
+    return 0;
+}
+
+static void
+deferred_rtree_rollback_hook (void *p_cache)
+{
+/* ROLLBACK hook (deferred SpatialIndex mode) */
+    struct splite_internal_cache *cache =
+	(struct splite_internal_cache *) p_cache;
+    reset_deferred_rtrees (cache);
+    cache->deferred_rtree_lost = 0;
+    cache->deferred_rtree_enabled = 0;
+}
+
+static void
+fnct_EnableDeferredSpatialIndex (sqlite3_context * context, int argc,
+				 sqlite3_value ** argv)
+{
+/* SQL function:
+/ EnableDeferredSpatialIndex ( void )
+/
+/ the deferred SpatialIndex mode only lasts until the end of
+/ the current transaction, so a transaction must already be
+/ open; a COMMIT will fail if any R*Tree entry is still pending
+/
+/ this mode takes over both the COMMIT and ROLLBACK hooks of the
+/ connection (sqlite3_commit_hook and sqlite3_rollback_hook):
+/ any hook previously installed by the application is replaced,
+/ and is not restored when the mode ends
+/
+/ returns: 1 on success
+/ raises an exception if no transaction is currently open
+*/
+    sqlite3 *sqlite = sqlite3_context_db_handle (context);
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    if (sqlite3_get_autocommit (sqlite))
+      {
+	  sqlite3_result_error (context,
+				"EnableDeferredSpatialIndex() exception - "
+				"no transaction is currently open.", -1);
+	  return;
+      }
+    sqlite3_commit_hook (sqlite, deferred_rtree_commit_hook, cache);
+    sqlite3_rollback_hook (sqlite, deferred_rtree_rollback_hook, cache);
+    cache->deferred_rtree_enabled = 1;
+    sqlite3_result_int (context, 1);
+}
+
+static void
+fnct_DisableDeferredSpatialIndex (sqlite3_context * context, int argc,
+				  sqlite3_value ** argv)
+{
+/* SQL function:
+/ DisableDeferredSpatialIndex ( void )
+/
+/ all pending R*Tree entries are flushed before disabling
+/ the deferred SpatialIndex mode (and removing its COMMIT
+/ and ROLLBACK hooks); on failure the mode stays enabled,
+/ so that COMMIT will still fail
+/
+/ returns: the number of flushed R*Tree entries
+/ or -1 on failure
+*/
+    int ret;
+    sqlite3 *sqlite = sqlite3_context_db_handle (context);
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    ret = flushDeferredSpatialIndex (sqlite, cache);
+    if (ret >= 0)
+      {
+	  cache->deferred_rtree_enabled = 0;
+	  sqlite3_commit_hook (sqlite, NULL, NULL);
+	  sqlite3_rollback_hook (sqlite, NULL, NULL);
+      }
+    sqlite3_result_int (context, ret);
+}
+
+static void
+fnct_IsDeferredSpatialIndexEnabled (sqlite3_context * context, int argc,
+				    sqlite3_value ** argv)
+{
+/* SQL function:
+/ IsDeferredSpatialIndexEnabled ( void )
+/
+/ returns: TRUE or FALSE
+*/
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    if (cache->deferred_rtree_enabled)
+	sqlite3_result_int (context, 1);
+    else
+	sqlite3_result_int (context, 0);
+}
+
+static void
+fnct_FlushDeferredSpatialIndex (sqlite3_context * context, int argc,
+				sqlite3_value ** argv)
+{
+/* SQL function:
+/ FlushDeferredSpatialIndex ( void )
+/
+/ writes all R*Tree entries queued in deferred SpatialIndex mode;
+/ this must be called before COMMIT, that otherwise will fail
+/
+/ returns: the number of flushed R*Tree entries
+/ or -1 on failure
+*/
+    sqlite3 *sqlite = sqlite3_context_db_handle (context);
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    sqlite3_result_int (context, flushDeferredSpatialIndex (sqlite, cache));
+}
+
 static void
 fnct_setDecimalPrecision (sqlite3_context * context, int argc,
 			  sqlite3_value ** argv)
@@ -44770,6 +46065,7 @@ fnct_setDecimalPrecision (sqlite3_context * context, int argc,
 /* SQL function:
 / SetDecimalPrecision ( int precision )
 / a negative precision identifies the default setting
+/ GAIA_PRECISION_SHORTEST (-1000) selects the shortest round-trip format
 /
 / returns: nothing
 */
@@ -44782,7 +46078,7 @@ fnct_setDecimalPrecision (sqlite3_context * context, int argc,
 	precision = sqlite3_value_int (argv[0]);
     else
 	return;
-    if (precision < 0)
+    if (precision < 0 && precision != GAIA_PRECISION_SHORTEST)
 	precision = -1;
     else if (precision == 6)
 	precision = -1;
@@ -45209,6 +46505,237 @@ fnct_bufferoptions_get_quadsegs (sqlite3_context * context, int argc,
     sqlite3_result_int (context, cache->buffer_quadrant_segments);
 }
 
+static void
+fnct_geoscache_set_size (sqlite3_context * context, int argc,
+			 sqlite3_value ** argv)
+{
+/* SQL function:
+/ GeosCache_SetSize ( int items )
+/
+/ sets the max number of Prepared Geometries held by the GEOS cache
+/ returns: 1 on success, 0 on failure
+*/
+    int value;
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    if (sqlite3_value_type (argv[0]) == SQLITE_INTEGER)
+	value = sqlite3_value_int (argv[0]);
+    else
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    sqlite3_result_int (context, splite_set_geos_cache_size (cache, value));
+}
+
+static void
+fnct_geoscache_get_size (sqlite3_context * context, int argc,
+			 sqlite3_value ** argv)
+{
+/* SQL function:
+/ GeosCache_GetSize ( void )
+/
+/ returns: an Integer on success, NULL on failure
+*/
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_null (context);
+	  return;
+      }
+    if (cache->geosCache == NULL)
+	sqlite3_result_int (context, GEOS_CACHE_DEFAULT_SIZE);
+    else
+	sqlite3_result_int (context, cache->geosCacheSize);
+}
+
+static void
+fnct_geoscache_get_hits (sqlite3_context * context, int argc,
+			 sqlite3_value ** argv)
+{
+/* SQL function:
+/ GeosCache_GetHits ( void )
+/
+/ returns: the number of times a cached Prepared Geometry has been
+/ reused, NULL on failure
+*/
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_null (context);
+	  return;
+      }
+    sqlite3_result_int64 (context, cache->geosCacheHits);
+}
+
+static void
+fnct_geoscache_get_misses (sqlite3_context * context, int argc,
+			   sqlite3_value ** argv)
+{
+/* SQL function:
+/ GeosCache_GetMisses ( void )
+/
+/ returns: the number of times no cached Prepared Geometry was
+/ available, NULL on failure
+*/
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_null (context);
+	  return;
+      }
+    sqlite3_result_int64 (context, cache->geosCacheMisses);
+}
+
+static void
+fnct_geoscache_reset (sqlite3_context * context, int argc,
+		      sqlite3_value ** argv)
+{
+/* SQL function:
+/ GeosCache_Reset ( void )
+/
+/ releases all cached Prepared Geometries and resets the hit/miss counters
+/ returns: 1 on success, 0 on failure
+*/
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    splite_reset_geos_cache (cache);
+    sqlite3_result_int (context, 1);
+}
+
+static void
+fnct_unionoptions_reset (sqlite3_context * context, int argc,
+			 sqlite3_value ** argv)
+{
+/* SQL function:
+/ UnionOptions_Reset ( void )
+/
+/ returns: 1 on success, 0 on failure
+*/
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    cache->union_batch_size = UNION_DEFAULT_BATCH_SIZE;
+    cache->union_spatial_sort = 0;
+    sqlite3_result_int (context, 1);
+}
+
+static void
+fnct_unionoptions_set_batch_size (sqlite3_context * context, int argc,
+				  sqlite3_value ** argv)
+{
+/* SQL function:
+/ UnionOptions_SetBatchSize ( int items )
+/
+/ sets how many Geometries the GUnion() aggregate reduces at once
+/ returns: 1 on success, 0 on failure
+*/
+    int value;
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    if (sqlite3_value_type (argv[0]) == SQLITE_INTEGER)
+	value = sqlite3_value_int (argv[0]);
+    else
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    if (value < 2)
+	value = 2;
+    if (value > UNION_MAX_BATCH_SIZE)
+	value = UNION_MAX_BATCH_SIZE;
+    cache->union_batch_size = value;
+    sqlite3_result_int (context, 1);
+}
+
+static void
+fnct_unionoptions_get_batch_size (sqlite3_context * context, int argc,
+				  sqlite3_value ** argv)
+{
+/* SQL function:
+/ UnionOptions_GetBatchSize ( void )
+/
+/ returns: an Integer on success, NULL on failure
+*/
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_null (context);
+	  return;
+      }
+    sqlite3_result_int (context, cache->union_batch_size);
+}
+
+static void
+fnct_unionoptions_set_spatial_sort (sqlite3_context * context, int argc,
+				    sqlite3_value ** argv)
+{
+/* SQL function:
+/ UnionOptions_SetSpatialSort ( bool mode )
+/
+/ if TRUE the GUnion() aggregate will sort the input Geometries in
+/ Z-order before reducing them
+/ returns: 1 on success, 0 on failure
+*/
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    if (sqlite3_value_type (argv[0]) == SQLITE_INTEGER)
+	cache->union_spatial_sort = sqlite3_value_int (argv[0]) ? 1 : 0;
+    else
+      {
+	  sqlite3_result_int (context, 0);
+	  return;
+      }
+    sqlite3_result_int (context, 1);
+}
+
+static void
+fnct_unionoptions_get_spatial_sort (sqlite3_context * context, int argc,
+				    sqlite3_value ** argv)
+{
+/* SQL function:
+/ UnionOptions_GetSpatialSort ( void )
+/
+/ returns: 1 (TRUE) or 0 (FALSE) on success, NULL on failure
+*/
+    struct splite_internal_cache *cache = sqlite3_user_data (context);
+    GAIA_UNUSED ();		/* LCOV_EXCL_LINE */
+    if (cache == NULL)
+      {
+	  sqlite3_result_null (context);
+	  return;
+      }
+    sqlite3_result_int (context, cache->union_spatial_sort);
+}
+
 static void
 fnct_addVirtualTableExtent (sqlite3_context * context, int argc,
 			    sqlite3_value ** argv)
@@ -46171,7 +47698,7 @@ register_spatialite_sql_functions (void *p_db, const void *p_cache)
 				SQLITE_UTF8 | SQLITE_DETERMINISTIC, 0,
 				fnct_GeometryConstraints, 0, 0, 0);
     sqlite3_create_function_v2 (db, "RTreeAlign", 3,
-				SQLITE_UTF8 | SQLITE_DETERMINISTIC, 0,
+				SQLITE_UTF8 | SQLITE_DETERMINISTIC, cache,
 				fnct_RTreeAlign, 0, 0, 0);
     sqlite3_create_function_v2 (db, "IsValidFont", 1,
 				SQLITE_UTF8 | SQLITE_DETERMINISTIC, 0,
@@ -48683,9 +50210,44 @@ register_spatialite_sql_functions (void *p_db, const void *p_cache)
 				fnct_create_routing, 0, 0, 0);
     sqlite3_create_function_v2 (db, "CreateRouting", 13, SQLITE_UTF8, cache,
 				fnct_create_routing, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "CreateRouting", 14, SQLITE_UTF8, cache,
+				fnct_create_routing, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "CreateRoutingTurns", 4, SQLITE_UTF8,
+				cache, fnct_create_routing_turns, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "CreateRoutingTurns", 5, SQLITE_UTF8,
+				cache, fnct_create_routing_turns, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "CreateRoutingProfiles", 5, SQLITE_UTF8,
+				cache, fnct_create_routing_profiles, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "CreateRouting_UpdateLinks", 3,
+				SQLITE_UTF8, cache,
+				fnct_create_routing_update_links, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "CreateRouting_UpdateLinks", 4,
+				SQLITE_UTF8, cache,
+				fnct_create_routing_update_links, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "CreateRouting_UpdateLinks", 6,
+				SQLITE_UTF8, cache,
+				fnct_create_routing_update_links, 0, 0, 0);
     sqlite3_create_function_v2 (db, "CreateRouting_GetLastError", 0,
 				SQLITE_UTF8, cache,
 				fnct_create_routing_get_last_error, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "ParallelSpatialJoin", 6, SQLITE_UTF8,
+				cache, fnct_parallel_spatial_join, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "ParallelSpatialJoin", 7, SQLITE_UTF8,
+				cache, fnct_parallel_spatial_join, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "ParallelSpatialJoin_GetLastError", 0,
+				SQLITE_UTF8, cache,
+				fnct_parallel_spatial_join_get_last_error, 0, 0,
+				0);
+#ifndef OMIT_GEOS		/* only if GEOS is enabled */
+#ifndef OMIT_KNN		/* only if KNN is enabled */
+    sqlite3_create_function_v2 (db, "KNN_Join", 6, SQLITE_UTF8, cache,
+				fnct_knn_join, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "KNN_Join", 7, SQLITE_UTF8, cache,
+				fnct_knn_join, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "KNN_Join_GetLastError", 0, SQLITE_UTF8,
+				cache, fnct_knn_join_get_last_error, 0, 0, 0);
+#endif /* end KNN conditional */
+#endif /* end GEOS conditional */
 
 /*
 // enabling BlobFromFile, BlobToFile and XB_LoadXML, XB_StoreXML, 
@@ -48801,6 +50363,9 @@ register_spatialite_sql_functions (void *p_db, const void *p_cache)
 	  sqlite3_create_function_v2 (db, "ImportSHP", 14,
 				      SQLITE_UTF8 | SQLITE_DETERMINISTIC, 0,
 				      fnct_ImportSHP, 0, 0, 0);
+	  sqlite3_create_function_v2 (db, "ImportSHP", 15,
+				      SQLITE_UTF8 | SQLITE_DETERMINISTIC, 0,
+				      fnct_ImportSHP, 0, 0, 0);
 #ifdef PROJ_NEW			/* supporting new PROJ.6 */
 	  sqlite3_create_function_v2 (db, "PROJ_GuessSridFromSHP", 1,
 				      SQLITE_UTF8 | SQLITE_DETERMINISTIC, cache,
@@ -48969,6 +50534,19 @@ register_spatialite_sql_functions (void *p_db, const void *p_cache)
 				SQLITE_UTF8 | SQLITE_DETERMINISTIC, cache,
 				fnct_Pause, 0, 0, 0);
 
+    sqlite3_create_function_v2 (db, "EnableDeferredSpatialIndex", 0,
+				SQLITE_UTF8, cache,
+				fnct_EnableDeferredSpatialIndex, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "DisableDeferredSpatialIndex", 0,
+				SQLITE_UTF8, cache,
+				fnct_DisableDeferredSpatialIndex, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "IsDeferredSpatialIndexEnabled", 0,
+				SQLITE_UTF8, cache,
+				fnct_IsDeferredSpatialIndexEnabled, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "FlushDeferredSpatialIndex", 0,
+				SQLITE_UTF8, cache,
+				fnct_FlushDeferredSpatialIndex, 0, 0, 0);
+
     sqlite3_create_function_v2 (db, "SetDecimalPrecision", 1,
 				SQLITE_UTF8 | SQLITE_DETERMINISTIC, cache,
 				fnct_setDecimalPrecision, 0, 0, 0);
@@ -49053,6 +50631,40 @@ register_spatialite_sql_functions (void *p_db, const void *p_cache)
 				SQLITE_UTF8 | SQLITE_DETERMINISTIC, cache,
 				fnct_bufferoptions_get_quadsegs, 0, 0, 0);
 
+/* the internal cache of GEOS Prepared Geometries */
+    sqlite3_create_function_v2 (db, "GeosCache_SetSize", 1,
+				SQLITE_UTF8, cache,
+				fnct_geoscache_set_size, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "GeosCache_GetSize", 0,
+				SQLITE_UTF8, cache,
+				fnct_geoscache_get_size, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "GeosCache_GetHits", 0,
+				SQLITE_UTF8, cache,
+				fnct_geoscache_get_hits, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "GeosCache_GetMisses", 0,
+				SQLITE_UTF8, cache,
+				fnct_geoscache_get_misses, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "GeosCache_Reset", 0,
+				SQLITE_UTF8, cache,
+				fnct_geoscache_reset, 0, 0, 0);
+
+/* options for the GUnion() aggregate */
+    sqlite3_create_function_v2 (db, "UnionOptions_Reset", 0,
+				SQLITE_UTF8, cache,
+				fnct_unionoptions_reset, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "UnionOptions_SetBatchSize", 1,
+				SQLITE_UTF8, cache,
+				fnct_unionoptions_set_batch_size, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "UnionOptions_GetBatchSize", 0,
+				SQLITE_UTF8, cache,
+				fnct_unionoptions_get_batch_size, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "UnionOptions_SetSpatialSort", 1,
+				SQLITE_UTF8, cache,
+				fnct_unionoptions_set_spatial_sort, 0, 0, 0);
+    sqlite3_create_function_v2 (db, "UnionOptions_GetSpatialSort", 0,
+				SQLITE_UTF8, cache,
+				fnct_unionoptions_get_spatial_sort, 0, 0, 0);
+
 /* some Geodesic functions */
     sqlite3_create_function_v2 (db, "GreatCircleLength", 1,
 				SQLITE_UTF8 | SQLITE_DETERMINISTIC, cache,
@@ -51060,7 +52672,7 @@ init_spatialite_virtualtables (void *p_db, const void *p_cache)
 /* initializing the VirtualBBox  extension */
     virtualbbox_extension_init (db, p_cache);
 /* initializing the VirtualSpatialIndex  extension */
-    virtual_spatialindex_extension_init (db);
+    virtual_spatialindex_extension_init (db, p_cache);
 /* initializing the VirtualElementary  extension */
     virtual_elementary_extension_init (db);
 
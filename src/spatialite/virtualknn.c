@@ -60,53 +60,42 @@ CIG: 644544015A
 IMPORTANT NOTE: how KNN works
 
 the KNN module is implemented on the top of an SQLite's R*Tree, and
-more specifically is built around the sqlite3_rtree_query_callback()
-function.
-
-this API allows to directly explore the R*Tree hierarchy; for each
-node found within the Tree the registered callback will be invoked
-so to determine if the current Tree node (aka BBOX) should be further
-expanded or should be ignored.
-while the process goes on all Tree levels will be traversed until it
-reaches Level=0 (Leaves aka Terminal Nodes) where the indexed
-Geometries will be finally referenced by their individual ROWID and BBOX
-
-in a most usual Spatial Index query the R*Tree will be simply
-traversed starting from Root Nodes (higher level) and progressively
-descending level by level toward Leaf Nodes (indexed Geometries); in
-this specific case the BBOX to be searched is clearly defined, so the
-callback function should simply check if each Node BBOX do effectively
-intersect the reference BBOX and that's all.
-
-the access strategy required by a KNN query is much more complex than
-this, because there is no reference BBOX at all (the search radius is
-unknown in this case); so it should be dynamically built by repeatedly
-querying the R*Tree until a satisfying solution is found.
-
-step #1
--------
-we'll descend the Tree by exploring a Level at each time so to
-identify the lower-level BBOX containing the reference Geometry.
-if no BBOX directly contains the reference Geometry then the
-nearest one will be identified.
-
-step #2
--------
-the reference Geometry will now be buffered so to completely
-cover the BBOX identified in the previous step.
-
-step #3
--------
-an ordinary Spatial Index query will be now performed, using
-the buffered Geometry as the search frame, so to identify
-all nearest features.
-
-step #4
--------
-if the total number of nearest features identified by the
-previous query is less than requested, then the buffer
-radius will be repeatedly expanded until all requested
-nearest features will be found.
+more specifically directly reads the R*Tree Nodes from the "_node"
+shadow table supporting the Spatial Index.
+
+each Node is a BLOB containing a short header (Tree depth and number
+of cells) followed by the cells themselves; every cell is a ROWID
+followed by a BBOX (four big-endian 32 bit floats, rounded outwards).
+on Level=0 (Leaves aka Terminal Nodes) the ROWID identifies an indexed
+Geometry, on any higher Level it identifies a child Node.
+
+the Tree is explored by a best-first traversal (Hjaltason & Samet)
+using a priority queue ordered by distance from the reference Geometry:
+
+- the Root Node is expanded first, and each one of its cells is queued
+  using the distance between its BBOX and the reference Geometry MBR;
+  this one is a lower bound of the distance of any Geometry contained
+  within that BBOX.
+- the nearest queued item is then repeatedly extracted:
+  a) a Node is simply expanded, queueing all its cells
+  b) a Leaf cell is queued again, this time using the exact distance
+     between the indexed Geometry and the reference Geometry
+  c) an exact distance cannot be lower than any other queued distance,
+     so the corresponding Geometry is surely the next nearest one
+     and is immediately returned as a result row.
+
+this way only the Nodes effectively intersecting the search radius are
+ever read, no search frame has to be guessed in advance, and rows are
+returned one at time so that a LIMIT clause will stop the traversal.
+
+on long/lat layers (geographic SRIDs) all distances are measured in
+meters on the Ellipsoid: Nodes are queued using a lower bound of the
+geodesic distance (great-circle distance on a sphere whose radius is
+the smallest curvature radius of the Ellipsoid, correctly wrapping
+around the antimeridian), and the exact ellipsoidal distance is only
+computed for the Leaf cells surviving this pruning; Point to Point
+distances are directly computed by gaiaGeodesicDistance(), any other
+case falls back to ST_Distance(..., 1).
 
 */
 
@@ -126,11 +115,18 @@ nearest features will be found.
 #ifndef OMIT_GEOS		/* GEOS is supported */
 #ifndef OMIT_KNN		/* only if KNN is enabled */
 
+#ifndef _WIN32
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
 #include <spatialite/sqlite.h>
 
 #include <spatialite/spatialite.h>
 #include <spatialite/gaiaaux.h>
 #include <spatialite/gaiageo.h>
+#include <spatialite.h>
+#include <spatialite_private.h>
 
 #if defined(_WIN32) && !defined(__MINGW32__)
 #define strcasecmp    _stricmp
@@ -145,14 +141,32 @@ static struct sqlite3_module my_knn_module;
 /
 ******************************************************************************/
 
+#define VKNN_MAX_ITEMS	10000	/* max number of nearest Features */
+#define VKNN_CELL_SIZE	24	/* R*Tree cell: ROWID + 2D BBOX */
+
+#define VKNN_ENTRY	-1	/* a Leaf cell: BBOX lower bound */
+#define VKNN_FEATURE	-2	/* a Leaf cell: exact distance */
+
+#define VKNN_NO_SRID	-2147483647	/* Ellipsoid not yet set */
+#define VKNN_DEG2RAD	0.0174532925199432958
+
 typedef struct VKnnItemStruct
 {
-/* a Feature item into the KNN sorted array */
+/* a Feature item returned by KNN */
     sqlite3_int64 rowid;
     double dist;
 } VKnnItem;
 typedef VKnnItem *VKnnItemPtr;
 
+typedef struct VKnnHeapItemStruct
+{
+/* an item into the best-first priority queue */
+    sqlite3_int64 id;		/* Node number or Feature ROWID */
+    double dist;		/* lower bound or exact distance */
+    int level;			/* Node level, VKNN_ENTRY or VKNN_FEATURE */
+} VKnnHeapItem;
+typedef VKnnHeapItem *VKnnHeapItemPtr;
+
 typedef struct VKnnContextStruct
 {
 /* current KNN context */
@@ -161,32 +175,27 @@ typedef struct VKnnContextStruct
     unsigned char *blob;
     int blob_size;
     sqlite3_stmt *stmt_dist;
-    sqlite3_stmt *stmt_map_dist;
-    sqlite3_stmt *stmt_rect_dist;
-    sqlite3_stmt *stmt_pt_dist;
-    sqlite3_stmt *stmt_buffer;
-    sqlite3_stmt *stmt_rtree;
-    sqlite3_stmt *stmt_rtree_count;
-    double bbox_minx;
-    double bbox_miny;
-    double bbox_maxx;
-    double bbox_maxy;
-    double minx;
-    double miny;
-    double maxx;
-    double maxy;
-    double min_dist;
-    double rtree_minx;
-    double rtree_miny;
-    double rtree_maxx;
-    double rtree_maxy;
-    int level;
-    int current_level;
-    VKnnItemPtr knn_array;
+    sqlite3_stmt *stmt_geom;
+    sqlite3_stmt *stmt_node;
+    int is_geographic;
+    double ref_minx;
+    double ref_miny;
+    double ref_maxx;
+    double ref_maxy;
+    int ref_is_point;
+    double ref_x;
+    double ref_y;
+    int geo_srid;
+    double geo_a;
+    double geo_b;
+    double geo_rf;
+    double geo_radius;
+    VKnnHeapItemPtr heap;
+    int heap_count;
+    int heap_max;
     int max_items;
-    double max_dist;
     int curr_items;
-    int rtree_count;
+    VKnnItem current;
 } VKnnContext;
 typedef VKnnContext *VKnnContextPtr;
 
@@ -197,7 +206,6 @@ typedef struct VirtualKnnStruct
     int nRef;			/* # references: USED INTERNALLY BY SQLITE */
     char *zErrMsg;		/* error message: USE INTERNALLY BY SQLITE */
     sqlite3 *db;		/* the sqlite db holding the virtual table */
-    VKnnContextPtr knn_ctx;	/* KNN context */
 } VirtualKnn;
 typedef VirtualKnn *VirtualKnnPtr;
 
@@ -207,6 +215,7 @@ typedef struct VirtualKnnCursorStruct
     VirtualKnnPtr pVtab;	/* Virtual table of this cursor */
     int eof;			/* the EOF marker */
     int CurrentIndex;		/* index of the current KNN item */
+    VKnnContextPtr knn_ctx;	/* KNN context */
 } VirtualKnnCursor;
 typedef VirtualKnnCursor *VirtualKnnCursorPtr;
 
@@ -221,32 +230,28 @@ vknn_empty_context (VKnnContextPtr ctx)
     ctx->blob = NULL;
     ctx->blob_size = 0;
     ctx->stmt_dist = NULL;
-    ctx->stmt_map_dist = NULL;
-    ctx->stmt_rect_dist = NULL;
-    ctx->stmt_pt_dist = NULL;
-    ctx->stmt_buffer = NULL;
-    ctx->stmt_rtree = NULL;
-    ctx->stmt_rtree_count = NULL;
-    ctx->bbox_minx = -DBL_MAX;
-    ctx->bbox_miny = -DBL_MAX;
-    ctx->bbox_maxx = DBL_MAX;
-    ctx->bbox_maxy = DBL_MAX;
-    ctx->minx = DBL_MAX;
-    ctx->miny = DBL_MAX;
-    ctx->maxx = -DBL_MAX;
-    ctx->maxy = -DBL_MAX;
-    ctx->min_dist = DBL_MAX;
-    ctx->rtree_minx = -DBL_MAX;
-    ctx->rtree_miny = -DBL_MAX;
-    ctx->rtree_maxx = DBL_MAX;
-    ctx->rtree_maxy = DBL_MAX;
-    ctx->level = 0;
-    ctx->current_level = 0;
+    ctx->stmt_geom = NULL;
+    ctx->stmt_node = NULL;
+    ctx->is_geographic = 0;
+    ctx->ref_minx = DBL_MAX;
+    ctx->ref_miny = DBL_MAX;
+    ctx->ref_maxx = -DBL_MAX;
+    ctx->ref_maxy = -DBL_MAX;
+    ctx->ref_is_point = 0;
+    ctx->ref_x = 0.0;
+    ctx->ref_y = 0.0;
+    ctx->geo_srid = VKNN_NO_SRID;
+    ctx->geo_a = 0.0;
+    ctx->geo_b = 0.0;
+    ctx->geo_rf = 0.0;
+    ctx->geo_radius = 0.0;
+    ctx->heap = NULL;
+    ctx->heap_count = 0;
+    ctx->heap_max = 0;
     ctx->max_items = 0;
-    ctx->knn_array = NULL;
     ctx->curr_items = 0;
-    ctx->rtree_count = 0;
-    ctx->max_dist = -DBL_MAX;
+    ctx->current.rowid = 0;
+    ctx->current.dist = DBL_MAX;
 }
 
 static VKnnContextPtr
@@ -272,63 +277,72 @@ vknn_reset_context (VKnnContextPtr ctx)
 	free (ctx->blob);
     if (ctx->stmt_dist != NULL)
 	sqlite3_finalize (ctx->stmt_dist);
-    if (ctx->stmt_map_dist != NULL)
-	sqlite3_finalize (ctx->stmt_map_dist);
-    if (ctx->stmt_rect_dist != NULL)
-	sqlite3_finalize (ctx->stmt_rect_dist);
-    if (ctx->stmt_pt_dist != NULL)
-	sqlite3_finalize (ctx->stmt_pt_dist);
-    if (ctx->stmt_buffer != NULL)
-	sqlite3_finalize (ctx->stmt_buffer);
-    if (ctx->stmt_rtree != NULL)
-	sqlite3_finalize (ctx->stmt_rtree);
-    if (ctx->stmt_rtree_count != NULL)
-	sqlite3_finalize (ctx->stmt_rtree_count);
-    if (ctx->knn_array != NULL)
-	free (ctx->knn_array);
+    if (ctx->stmt_geom != NULL)
+	sqlite3_finalize (ctx->stmt_geom);
+    if (ctx->stmt_node != NULL)
+	sqlite3_finalize (ctx->stmt_node);
+    if (ctx->heap != NULL)
+	free (ctx->heap);
     vknn_empty_context (ctx);
 }
 
 static void
-vknn_rtree_count (VKnnContextPtr ctx)
+vknn_set_reference (VKnnContextPtr ctx, gaiaGeomCollPtr geom)
 {
-/* approximatively counting how many entries are into the R*Tree */
-    int ret;
-    sqlite3_stmt *stmt;
-
+/* setting the reference Geometry (its MBR must be already computed) */
+    if (ctx->blob != NULL)
+	free (ctx->blob);
+    ctx->blob = NULL;
+    ctx->blob_size = 0;
+    gaiaToSpatiaLiteBlobWkb (geom, &(ctx->blob), &(ctx->blob_size));
+    ctx->ref_minx = geom->MinX;
+    ctx->ref_miny = geom->MinY;
+    ctx->ref_maxx = geom->MaxX;
+    ctx->ref_maxy = geom->MaxY;
+    ctx->ref_is_point = 0;
+    if (geom->FirstPoint != NULL && geom->FirstPoint == geom->LastPoint
+	&& geom->FirstLinestring == NULL && geom->FirstPolygon == NULL)
+      {
+	  ctx->ref_is_point = 1;
+	  ctx->ref_x = geom->FirstPoint->X;
+	  ctx->ref_y = geom->FirstPoint->Y;
+      }
+}
 
-    ctx->rtree_count = 0;
-    if (ctx == NULL)
-	return;
-    stmt = ctx->stmt_rtree_count;
-    if (stmt == NULL)
+static void
+vknn_set_ellipsoid (VKnnContextPtr ctx, sqlite3 * sqlite, int srid)
+{
+/* 
+/ setting the Ellipsoid used for geodesic distances 
+/ (the same one ST_Distance(..., 1) would use for this SRID)
+*/
+    double e2;
+    if (!ctx->is_geographic || srid == ctx->geo_srid)
 	return;
-    sqlite3_reset (stmt);
-    while (1)
+    ctx->geo_srid = srid;
+    if (!getEllipsoidParams
+	(sqlite, srid, &(ctx->geo_a), &(ctx->geo_b), &(ctx->geo_rf)))
       {
-	  /* scrolling the result set rows */
-	  ret = sqlite3_step (stmt);
-	  if (ret == SQLITE_DONE)
-	      break;		/* end of result set */
-	  if (ret == SQLITE_ROW)
-	    {
-		ctx->rtree_count += 1;
-	    }
-	  else
-	    {
-		ctx->rtree_count = 0;
-		break;
-	    }
+	  /* defaulting to WGS84 */
+	  ctx->geo_a = 6378137.0;
+	  ctx->geo_rf = 298.257223563;
+	  ctx->geo_b = ctx->geo_a * (1.0 - (1.0 / ctx->geo_rf));
       }
+/*
+/ the meridian radius of curvature at the Equator a*(1-e^2) is the
+/ smallest radius of curvature found anywhere on the Ellipsoid, so
+/ a sphere of this radius never overestimates a geodesic distance
+*/
+    e2 = ((ctx->geo_a * ctx->geo_a) -
+	  (ctx->geo_b * ctx->geo_b)) / (ctx->geo_a * ctx->geo_a);
+    ctx->geo_radius = ctx->geo_a * (1.0 - e2);
 }
 
 static void
 vknn_init_context (VKnnContextPtr ctx, const char *table, const char *column,
-		   gaiaGeomCollPtr geom, int max_items,
-		   sqlite3_stmt * stmt_dist, sqlite3_stmt * stmt_map_dist,
-		   sqlite3_stmt * stmt_rect_dist, sqlite3_stmt * stmt_pt_dist,
-		   sqlite3_stmt * stmt_buffer, sqlite3_stmt * stmt_rtree,
-		   sqlite3_stmt * stmt_rtree_count)
+		   gaiaGeomCollPtr geom, int max_items, int is_geographic,
+		   sqlite3_stmt * stmt_dist, sqlite3_stmt * stmt_geom,
+		   sqlite3_stmt * stmt_node)
 {
 /* initializing a KNN context */
     int i;
@@ -341,25 +355,13 @@ vknn_init_context (VKnnContextPtr ctx, const char *table, const char *column,
     i = strlen (column);
     ctx->column_name = malloc (i + 1);
     strcpy (ctx->column_name, column);
-    gaiaToSpatiaLiteBlobWkb (geom, &(ctx->blob), &(ctx->blob_size));
+    vknn_set_reference (ctx, geom);
     ctx->stmt_dist = stmt_dist;
-    ctx->stmt_map_dist = stmt_map_dist;
-    ctx->stmt_rect_dist = stmt_rect_dist;
-    ctx->stmt_pt_dist = stmt_pt_dist;
-    ctx->stmt_buffer = stmt_buffer;
-    ctx->stmt_rtree = stmt_rtree;
-    ctx->stmt_rtree_count = stmt_rtree_count;
+    ctx->stmt_geom = stmt_geom;
+    ctx->stmt_node = stmt_node;
+    ctx->is_geographic = is_geographic;
     ctx->max_items = max_items;
-    ctx->knn_array = malloc (sizeof (VKnnItem) * max_items);
-    for (i = 0; i < max_items; i++)
-      {
-	  /* initializing the KNN sorted array */
-	  VKnnItemPtr item = ctx->knn_array + i;
-	  item->rowid = 0;
-	  item->dist = DBL_MAX;
-      }
     ctx->curr_items = 0;
-    vknn_rtree_count (ctx);
 }
 
 static void
@@ -795,7 +797,6 @@ vknn_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
     p_vt->pModule = &my_knn_module;
     p_vt->nRef = 0;
     p_vt->zErrMsg = NULL;
-    p_vt->knn_ctx = vknn_create_context ();
 /* preparing the COLUMNs for this VIRTUAL TABLE */
     xname = gaiaDoubleQuotedSql (vtable);
     buf = sqlite3_mprintf ("CREATE TABLE \"%s\" (f_table_name TEXT, "
@@ -830,6 +831,8 @@ vknn_best_index (sqlite3_vtab * pVTab, sqlite3_index_info * pIdxInfo)
 {
 /* best index selection */
     int i;
+    int col;
+    int arg = 1;
     int err = 1;
     int table = 0;
     int geom_col = 0;
@@ -872,12 +875,22 @@ vknn_best_index (sqlite3_vtab * pVTab, sqlite3_index_info * pIdxInfo)
 		    pIdxInfo->idxNum = 2;
 	    }
 	  pIdxInfo->estimatedCost = 1.0;
-	  for (i = 0; i < pIdxInfo->nConstraint; i++)
+	  for (col = 0; col < 4; col++)
 	    {
-		if (pIdxInfo->aConstraint[i].usable)
+		/* 
+		/ passing the KNN args in column order; any other
+		/ constraint (e.g. LIMIT) is left to SQLite itself
+		*/
+		for (i = 0; i < pIdxInfo->nConstraint; i++)
 		  {
-		      pIdxInfo->aConstraintUsage[i].argvIndex = i + 1;
-		      pIdxInfo->aConstraintUsage[i].omit = 1;
+		      struct sqlite3_index_constraint *p =
+			  &(pIdxInfo->aConstraint[i]);
+		      if (p->usable && p->iColumn == col
+			  && p->op == SQLITE_INDEX_CONSTRAINT_EQ)
+			{
+			    pIdxInfo->aConstraintUsage[i].argvIndex = arg++;
+			    pIdxInfo->aConstraintUsage[i].omit = 1;
+			}
 		  }
 	    }
 	  err = 0;
@@ -895,8 +908,6 @@ vknn_disconnect (sqlite3_vtab * pVTab)
 {
 /* disconnects the virtual table */
     VirtualKnnPtr p_vt = (VirtualKnnPtr) pVTab;
-    if (p_vt->knn_ctx != NULL)
-	vknn_free_context (p_vt->knn_ctx);
     sqlite3_free (p_vt);
     return SQLITE_OK;
 }
@@ -918,6 +929,14 @@ vknn_open (sqlite3_vtab * pVTab, sqlite3_vtab_cursor ** ppCursor)
 	return SQLITE_ERROR;
     cursor->pVtab = (VirtualKnnPtr) pVTab;
     cursor->eof = 1;
+    cursor->CurrentIndex = 0;
+/* each cursor has its own KNN context (e.g. self-joins) */
+    cursor->knn_ctx = vknn_create_context ();
+    if (cursor->knn_ctx == NULL)
+      {
+	  sqlite3_free (cursor);
+	  return SQLITE_NOMEM;
+      }
     *ppCursor = (sqlite3_vtab_cursor *) cursor;
     return SQLITE_OK;
 }
@@ -926,88 +945,105 @@ static int
 vknn_close (sqlite3_vtab_cursor * pCursor)
 {
 /* closing the cursor */
+    VirtualKnnCursorPtr cursor = (VirtualKnnCursorPtr) pCursor;
+    if (cursor->knn_ctx != NULL)
+	vknn_free_context (cursor->knn_ctx);
     sqlite3_free (pCursor);
     return SQLITE_OK;
 }
 
-static void
-vknn_shift_items (VKnnContextPtr ctx, int index)
+static int
+vknn_heap_compare (VKnnHeapItemPtr a, VKnnHeapItemPtr b)
 {
-/* shifting down the Features sorted array */
-    int i;
-    for (i = ctx->max_items - 1; i > index; i--)
-      {
-	  VKnnItemPtr item1 = ctx->knn_array + i - 1;
-	  VKnnItemPtr item2 = ctx->knn_array + i;
-	  item2->rowid = item1->rowid;
-	  item2->dist = item1->dist;
-	  if ((i == ctx->max_items - 1) && item2->dist != DBL_MAX)
-	      ctx->max_dist = item2->dist;
-      }
+/* priority order: nearest first, exact distances before lower bounds */
+    if (a->dist < b->dist)
+	return -1;
+    if (a->dist > b->dist)
+	return 1;
+    if (a->level < b->level)
+	return -1;
+    if (a->level > b->level)
+	return 1;
+    return 0;
 }
 
-static void
-vknn_update_items (VKnnContextPtr ctx, sqlite3_int64 rowid, double dist)
+static int
+vknn_heap_push (VKnnContextPtr ctx, sqlite3_int64 id, double dist, int level)
 {
-/* updating the Features sorted array */
+/* inserting an item into the priority queue */
     int i;
-    if (ctx->curr_items == ctx->max_items)
+    VKnnHeapItem item;
+    if (ctx->heap_count >= ctx->heap_max)
       {
-	  if (dist >= ctx->max_dist)
-	      return;
+	  /* growing the priority queue */
+	  VKnnHeapItemPtr heap;
+	  int max = (ctx->heap_max == 0) ? 256 : ctx->heap_max * 2;
+	  heap = realloc (ctx->heap, sizeof (VKnnHeapItem) * max);
+	  if (heap == NULL)
+	      return 0;
+	  ctx->heap = heap;
+	  ctx->heap_max = max;
       }
-    for (i = 0; i < ctx->max_items; i++)
+    item.id = id;
+    item.dist = dist;
+    item.level = level;
+    i = ctx->heap_count;
+    ctx->heap_count += 1;
+    while (i > 0)
       {
-	  VKnnItemPtr item = ctx->knn_array + i;
-	  if (rowid == item->rowid)
-	      return;
-	  if (dist < item->dist)
-	    {
-		vknn_shift_items (ctx, i);
-		item->rowid = rowid;
-		item->dist = dist;
-		break;
-	    }
+	  /* sifting up */
+	  int parent = (i - 1) / 2;
+	  if (vknn_heap_compare (ctx->heap + parent, &item) <= 0)
+	      break;
+	  ctx->heap[i] = ctx->heap[parent];
+	  i = parent;
       }
-    if (dist > ctx->max_dist)
-	ctx->max_dist = dist;
-    if (ctx->curr_items < ctx->max_items)
-	ctx->curr_items += 1;
+    ctx->heap[i] = item;
+    return 1;
 }
 
-static int
-vknn_check_mbr (VKnnContextPtr ctx, double rtree_minx, double rtree_miny,
-		double rtree_maxx, double rtree_maxy)
-{
-/* comparing two MBRs */
-    if (rtree_minx >= ctx->bbox_minx && rtree_maxx <= ctx->bbox_maxx
-	&& rtree_miny >= ctx->bbox_miny && rtree_maxy <= ctx->bbox_maxy)
-	return FULLY_WITHIN;
-    if (rtree_maxx < ctx->bbox_minx)
-	return NOT_WITHIN;
-    if (rtree_minx > ctx->bbox_maxx)
-	return NOT_WITHIN;
-    if (rtree_maxy < ctx->bbox_miny)
-	return NOT_WITHIN;
-    if (rtree_miny > ctx->bbox_maxy)
-	return NOT_WITHIN;
-    return PARTLY_WITHIN;
+static void
+vknn_heap_pop (VKnnContextPtr ctx, VKnnHeapItemPtr out)
+{
+/* removing the nearest item from the priority queue */
+    VKnnHeapItem last;
+    int i = 0;
+    *out = ctx->heap[0];
+    ctx->heap_count -= 1;
+    if (ctx->heap_count == 0)
+	return;
+    last = ctx->heap[ctx->heap_count];
+    while (1)
+      {
+	  /* sifting down */
+	  int child = (2 * i) + 1;
+	  if (child >= ctx->heap_count)
+	      break;
+	  if (child + 1 < ctx->heap_count
+	      && vknn_heap_compare (ctx->heap + child + 1,
+				    ctx->heap + child) < 0)
+	      child++;
+	  if (vknn_heap_compare (&last, ctx->heap + child) <= 0)
+	      break;
+	  ctx->heap[i] = ctx->heap[child];
+	  i = child;
+      }
+    ctx->heap[i] = last;
 }
 
 static double
-vknn_compute_distance (VKnnContextPtr ctx, sqlite3_int64 rowid)
+vknn_compute_distance (VKnnContextPtr ctx, sqlite3_stmt * stmt,
+		       sqlite3_int64 rowid)
 {
-/* computing the distance between two geometries (in meters) */
+/* computing the distance between two geometries */
     double dist = DBL_MAX;
     int ret;
-    sqlite3_stmt *stmt;
     if (ctx == NULL)
 	return DBL_MAX;
     if (ctx->blob == NULL)
 	return DBL_MAX;
-    if (ctx->stmt_dist == NULL)
+    if (stmt == NULL)
 	return DBL_MAX;
-    stmt = ctx->stmt_dist;
     sqlite3_reset (stmt);
     sqlite3_clear_bindings (stmt);
     sqlite3_bind_blob (stmt, 1, ctx->blob, ctx->blob_size, SQLITE_STATIC);
@@ -1033,285 +1069,426 @@ vknn_compute_distance (VKnnContextPtr ctx, sqlite3_int64 rowid)
 }
 
 static double
-vknn_rect_distance (VKnnContextPtr ctx, double minx, double miny, double maxx,
-		    double maxy)
+vknn_geodesic_distance (VKnnContextPtr ctx, sqlite3_int64 rowid)
 {
-/* computing the distance between the geometry and an R*Tree BBOX */
+/* computing the geodesic distance (in meters) between two geometries */
     double dist = DBL_MAX;
     int ret;
-    sqlite3_stmt *stmt;
-    if (ctx == NULL)
-	return DBL_MAX;
-    if (ctx->blob == NULL)
-	return DBL_MAX;
-    if (ctx->stmt_rect_dist == NULL)
-	return DBL_MAX;
-    stmt = ctx->stmt_rect_dist;
-    sqlite3_reset (stmt);
-    sqlite3_clear_bindings (stmt);
-    sqlite3_bind_blob (stmt, 1, ctx->blob, ctx->blob_size, SQLITE_STATIC);
-    sqlite3_bind_double (stmt, 2, minx);
-    sqlite3_bind_double (stmt, 3, miny);
-    sqlite3_bind_double (stmt, 4, maxx);
-    sqlite3_bind_double (stmt, 5, maxy);
-    while (1)
+    int done = 0;
+    sqlite3_stmt *stmt = ctx->stmt_geom;
+    if (ctx->ref_is_point && stmt != NULL)
       {
-	  /* scrolling the result set rows */
+	  /* Point to Point: directly measuring on the Ellipsoid */
+	  sqlite3_reset (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  sqlite3_bind_int64 (stmt, 1, rowid);
 	  ret = sqlite3_step (stmt);
-	  if (ret == SQLITE_DONE)
-	      break;		/* end of result set */
 	  if (ret == SQLITE_ROW)
 	    {
-		if (sqlite3_column_type (stmt, 0) == SQLITE_FLOAT)
-		    dist = sqlite3_column_double (stmt, 0);
+		gaiaGeomCollPtr geom = NULL;
+		if (sqlite3_column_type (stmt, 0) == SQLITE_BLOB)
+		    geom =
+			gaiaFromSpatiaLiteBlobWkb (sqlite3_column_blob
+						   (stmt, 0),
+						   sqlite3_column_bytes (stmt,
+									 0));
+		if (geom == NULL)
+		    done = 1;	/* NULL or invalid Geometry */
+		else
+		  {
+		      gaiaPointPtr pt = geom->FirstPoint;
+		      if (pt != NULL && pt == geom->LastPoint
+			  && geom->FirstLinestring == NULL
+			  && geom->FirstPolygon == NULL)
+			{
+			    dist =
+				gaiaGeodesicDistance (ctx->geo_a, ctx->geo_b,
+						      ctx->geo_rf, ctx->ref_y,
+						      ctx->ref_x, pt->Y, pt->X);
+			    if (dist < 0.0)
+			      {
+				  /* failed convergence: nearly antipodal */
+				  dist =
+				      gaiaGreatCircleDistance (ctx->geo_a,
+							       ctx->geo_b,
+							       ctx->ref_y,
+							       ctx->ref_x,
+							       pt->Y, pt->X);
+			      }
+			    done = 1;
+			}
+		      gaiaFreeGeomColl (geom);
+		  }
 	    }
 	  else
-	    {
-		dist = DBL_MAX;
-		break;
-	    }
+	      done = 1;		/* deleted row or SQL error */
+	  sqlite3_reset (stmt);
       }
+    if (!done)
+	dist = vknn_compute_distance (ctx, ctx->stmt_dist, rowid);
     return dist;
 }
 
 static double
-vknn_pt_distance (VKnnContextPtr ctx, double x, double y)
+vknn_haversine (double angle)
 {
-/* computing the distance between the geometry and a point */
-    double dist = DBL_MAX;
-    int ret;
-    sqlite3_stmt *stmt;
-    if (ctx == NULL)
-	return DBL_MAX;
-    if (ctx->blob == NULL)
-	return DBL_MAX;
-    if (ctx->stmt_pt_dist == NULL)
-	return DBL_MAX;
-    stmt = ctx->stmt_pt_dist;
-    sqlite3_reset (stmt);
-    sqlite3_clear_bindings (stmt);
-    sqlite3_bind_blob (stmt, 1, ctx->blob, ctx->blob_size, SQLITE_STATIC);
-    sqlite3_bind_double (stmt, 2, x);
-    sqlite3_bind_double (stmt, 3, y);
-    while (1)
+/* haversine function: angle is in radians */
+    double s = sin (angle / 2.0);
+    return s * s;
+}
+
+static double
+vknn_geo_rect_distance (VKnnContextPtr ctx, double minx, double miny,
+			double maxx, double maxy)
+{
+/* 
+/ computing a lower bound of the geodesic distance (in meters) between
+/ the reference MBR and an R*Tree BBOX, both of them in long/lat
+/
+/ for any two points: hav(d) = hav(dLat) + cos(lat1) * cos(lat2) * hav(dLong)
+/ and each term is bounded from below by using the latitude gap, the
+/ longitude gap (wrapping around the antimeridian) and the highest
+/ absolute latitude found within each box.
+*/
+    double dlat = 0.0;
+    double dlon = 0.0;
+    double wrap;
+    double lat1;
+    double lat2;
+    double h;
+    double rad = VKNN_DEG2RAD;
+    if (maxy < ctx->ref_miny)
+	dlat = ctx->ref_miny - maxy;
+    else if (miny > ctx->ref_maxy)
+	dlat = miny - ctx->ref_maxy;
+    if (maxx < ctx->ref_minx)
       {
-	  /* scrolling the result set rows */
-	  ret = sqlite3_step (stmt);
-	  if (ret == SQLITE_DONE)
-	      break;		/* end of result set */
-	  if (ret == SQLITE_ROW)
-	    {
-		if (sqlite3_column_type (stmt, 0) == SQLITE_FLOAT)
-		    dist = sqlite3_column_double (stmt, 0);
-	    }
-	  else
-	    {
-		dist = DBL_MAX;
-		break;
-	    }
+	  dlon = ctx->ref_minx - maxx;
+	  wrap = 360.0 - (ctx->ref_maxx - minx);
+	  if (wrap < dlon)
+	      dlon = wrap;
       }
-    return dist;
+    else if (minx > ctx->ref_maxx)
+      {
+	  dlon = minx - ctx->ref_maxx;
+	  wrap = 360.0 - (maxx - ctx->ref_minx);
+	  if (wrap < dlon)
+	      dlon = wrap;
+      }
+    if (dlon < 0.0)
+	dlon = 0.0;
+    if (dlon > 180.0)
+	dlon = 180.0;
+    if (dlat > 180.0)
+	dlat = 180.0;
+    lat1 = fabs (ctx->ref_miny);
+    if (fabs (ctx->ref_maxy) > lat1)
+	lat1 = fabs (ctx->ref_maxy);
+    lat2 = fabs (miny);
+    if (fabs (maxy) > lat2)
+	lat2 = fabs (maxy);
+    if (lat1 > 90.0)
+	lat1 = 90.0;
+    if (lat2 > 90.0)
+	lat2 = 90.0;
+    h = vknn_haversine (dlat * rad) +
+	(cos (lat1 * rad) * cos (lat2 * rad) * vknn_haversine (dlon * rad));
+    if (h > 1.0)
+	h = 1.0;
+    return 2.0 * asin (sqrt (h)) * ctx->geo_radius;
+}
+
+static double
+vknn_rect_distance (VKnnContextPtr ctx, double minx, double miny, double maxx,
+		    double maxy)
+{
+/* 
+/ computing the distance between the reference MBR and an R*Tree BBOX
+/ (lower bound of the distance of any Geometry within the BBOX)
+*/
+    double dx = 0.0;
+    double dy = 0.0;
+    if (ctx->is_geographic)
+	return vknn_geo_rect_distance (ctx, minx, miny, maxx, maxy);
+    if (maxx < ctx->ref_minx)
+	dx = ctx->ref_minx - maxx;
+    else if (minx > ctx->ref_maxx)
+	dx = minx - ctx->ref_maxx;
+    if (maxy < ctx->ref_miny)
+	dy = ctx->ref_miny - maxy;
+    else if (miny > ctx->ref_maxy)
+	dy = miny - ctx->ref_maxy;
+    return sqrt ((dx * dx) + (dy * dy));
+}
+
+static int
+vknn_import_u16 (const unsigned char *p)
+{
+/* R*Tree Nodes are always big-endian */
+    return (p[0] << 8) | p[1];
+}
+
+static sqlite3_int64
+vknn_import_i64 (const unsigned char *p)
+{
+/* R*Tree Nodes are always big-endian */
+    sqlite3_uint64 value = 0;
+    int i;
+    for (i = 0; i < 8; i++)
+	value = (value << 8) | p[i];
+    return (sqlite3_int64) value;
+}
+
+static double
+vknn_import_float (const unsigned char *p)
+{
+/* R*Tree Nodes are always big-endian */
+    union
+    {
+	float value;
+	unsigned int bits;
+    } cvt;
+    cvt.bits =
+	((unsigned int) p[0] << 24) | ((unsigned int) p[1] << 16) |
+	((unsigned int) p[2] << 8) | (unsigned int) p[3];
+    return cvt.value;
 }
 
 static int
-vknn_bufferize (VKnnContextPtr ctx, double radius)
+vknn_expand_node (VKnnContextPtr ctx, sqlite3_int64 node_no, int level,
+		  int is_root)
 {
-/* computing the frame for an R*Tree query */
+/* queueing all cells of an R*Tree Node */
     int ret;
-    sqlite3_stmt *stmt;
-    if (ctx == NULL)
-	return 0;
-    if (ctx->blob == NULL)
-	return 0;
-    if (ctx->stmt_buffer == NULL)
+    int i;
+    int count;
+    const unsigned char *blob;
+    int size;
+    sqlite3_stmt *stmt = ctx->stmt_node;
+    if (stmt == NULL)
 	return 0;
-    stmt = ctx->stmt_buffer;
     sqlite3_reset (stmt);
     sqlite3_clear_bindings (stmt);
-    sqlite3_bind_blob (stmt, 1, ctx->blob, ctx->blob_size, SQLITE_STATIC);
-    sqlite3_bind_double (stmt, 2, radius);
-    while (1)
+    sqlite3_bind_int64 (stmt, 1, node_no);
+    ret = sqlite3_step (stmt);
+    if (ret != SQLITE_ROW)
+	return 0;
+    if (sqlite3_column_type (stmt, 0) != SQLITE_BLOB)
+	return 0;
+    blob = sqlite3_column_blob (stmt, 0);
+    size = sqlite3_column_bytes (stmt, 0);
+    if (size < 4)
+	return 0;
+    if (is_root)
+	level = vknn_import_u16 (blob);	/* the Tree depth */
+    count = vknn_import_u16 (blob + 2);
+    if (size < 4 + (count * VKNN_CELL_SIZE))
+	return 0;
+    for (i = 0; i < count; i++)
       {
-	  /* scrolling the result set rows */
-	  ret = sqlite3_step (stmt);
-	  if (ret == SQLITE_DONE)
-	      break;		/* end of result set */
-	  if (ret == SQLITE_ROW)
-	    {
-		if (sqlite3_column_type (stmt, 0) == SQLITE_FLOAT)
-		    ctx->rtree_minx = sqlite3_column_double (stmt, 0);
-		if (sqlite3_column_type (stmt, 1) == SQLITE_FLOAT)
-		    ctx->rtree_miny = sqlite3_column_double (stmt, 1);
-		if (sqlite3_column_type (stmt, 2) == SQLITE_FLOAT)
-		    ctx->rtree_maxx = sqlite3_column_double (stmt, 2);
-		if (sqlite3_column_type (stmt, 3) == SQLITE_FLOAT)
-		    ctx->rtree_maxy = sqlite3_column_double (stmt, 3);
-	    }
-	  else
-	    {
-		return 0;
-		break;
-	    }
+	  const unsigned char *cell = blob + 4 + (i * VKNN_CELL_SIZE);
+	  sqlite3_int64 id = vknn_import_i64 (cell);
+	  double minx = vknn_import_float (cell + 8);
+	  double maxx = vknn_import_float (cell + 12);
+	  double miny = vknn_import_float (cell + 16);
+	  double maxy = vknn_import_float (cell + 20);
+	  double dist = vknn_rect_distance (ctx, minx, miny, maxx, maxy);
+	  if (!vknn_heap_push
+	      (ctx, id, dist, (level == 0) ? VKNN_ENTRY : level - 1))
+	      return 0;
       }
     return 1;
 }
 
 static int
-vknn_rtree_query (VKnnContextPtr ctx)
+vknn_fetch_next (VKnnContextPtr ctx)
 {
-/* Querying the RTree - Intersections */
-    int err = 0;
-    int count = 0;
-    int ret;
-    sqlite3_stmt *stmt;
-    if (ctx == NULL)
-	return 0;
-    if (ctx->stmt_rtree == NULL)
+/* 
+/ best-first traversal: locating the next nearest Feature
+/ returns 1 on success, 0 if there are no more Features
+*/
+    VKnnHeapItem item;
+    double dist;
+    if (ctx->curr_items >= ctx->max_items)
 	return 0;
-    stmt = ctx->stmt_rtree;
-    sqlite3_reset (stmt);
-    sqlite3_clear_bindings (stmt);
-    sqlite3_bind_double (stmt, 1, ctx->rtree_maxx);
-    sqlite3_bind_double (stmt, 2, ctx->rtree_minx);
-    sqlite3_bind_double (stmt, 3, ctx->rtree_maxy);
-    sqlite3_bind_double (stmt, 4, ctx->rtree_miny);
-    while (1)
+    while (ctx->heap_count > 0)
       {
-	  /* scrolling the result set rows */
-	  ret = sqlite3_step (stmt);
-	  if (ret == SQLITE_DONE)
-	      break;		/* end of result set */
-	  if (ret == SQLITE_ROW)
+	  vknn_heap_pop (ctx, &item);
+	  if (item.level == VKNN_FEATURE)
 	    {
-		double dist;
-		sqlite3_int64 rowid = sqlite3_column_int64 (stmt, 0);
-		dist = vknn_compute_distance (ctx, rowid);
-		vknn_update_items (ctx, rowid, dist);
-		count++;
+		/* no other queued item could be nearer than this one */
+		ctx->current.rowid = item.id;
+		ctx->current.dist = item.dist;
+		ctx->curr_items += 1;
+		return 1;
 	    }
-	  else
+	  if (item.level == VKNN_ENTRY)
 	    {
-		err = 1;
-		break;
+		/* replacing the BBOX lower bound by the exact distance */
+		if (ctx->is_geographic)
+		    dist = vknn_geodesic_distance (ctx, item.id);
+		else
+		    dist = vknn_compute_distance (ctx, ctx->stmt_dist, item.id);
+		if (dist == DBL_MAX)
+		    continue;	/* NULL or invalid Geometry */
+		if (!vknn_heap_push (ctx, item.id, dist, VKNN_FEATURE))
+		    return 0;
+		continue;
 	    }
+	  if (!vknn_expand_node (ctx, item.id, item.level, 0))
+	      return 0;
       }
-    if (err)
-	return -1;
-    return count;
+    return 0;
 }
 
 static int
-vknn_query_callback (sqlite3_rtree_query_info * info)
+vknn_start (VKnnContextPtr ctx)
 {
-/* R*Tree Query Callback function */
-    double rtree_minx;
-    double rtree_maxx;
-    double rtree_miny;
-    double rtree_maxy;
-    double dist;
-    int mode;
-    VKnnContextPtr ctx = (VKnnContextPtr) (info->pContext);
-    if (info->nCoord != 4)
-      {
-	  /* invalid RTree */
-	  info->eWithin = NOT_WITHIN;
-	  return SQLITE_OK;
-      }
-
-/* fetching the node's BBOX */
-    rtree_minx = info->aCoord[0];
-    rtree_maxx = info->aCoord[1];
-    rtree_miny = info->aCoord[2];
-    rtree_maxy = info->aCoord[3];
-    if (info->iLevel > ctx->current_level)
-      {
-	  mode =
-	      vknn_check_mbr (ctx, rtree_minx, rtree_miny, rtree_maxx,
-			      rtree_maxy);
-	  if (mode == FULLY_WITHIN || mode == PARTLY_WITHIN)
-	    {
-		/* overlaps the current reference frame; to be further expanded */
-		info->eWithin = FULLY_WITHIN;
-	    }
-	  else
-	      info->eWithin = NOT_WITHIN;
-      }
-    else
-      {
-	  dist =
-	      vknn_rect_distance (ctx, rtree_minx, rtree_miny, rtree_maxx,
-				  rtree_maxy);
-	  if (dist < ctx->min_dist)
-	    {
-		ctx->minx = rtree_minx;
-		ctx->miny = rtree_miny;
-		ctx->maxx = rtree_maxx;
-		ctx->maxy = rtree_maxy;
-		ctx->min_dist = dist;
-		ctx->level = info->iLevel;
-	    }
-	  info->eWithin = NOT_WITHIN;
-      }
-    return SQLITE_OK;
+/* starting a best-first traversal from the Root Node */
+    ctx->heap_count = 0;
+    ctx->curr_items = 0;
+    return vknn_expand_node (ctx, 1, 0, 1);
 }
 
 static int
-vknn_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
-	     int argc, sqlite3_value ** argv)
+vknn_prepare_statements (sqlite3 * sqlite, const char *db_prefix,
+			 const char *xtable, const char *xgeom,
+			 int is_geographic, sqlite3_stmt ** stmt_dist,
+			 sqlite3_stmt ** stmt_geom, sqlite3_stmt ** stmt_node)
 {
-/* setting up a cursor filter */
-    char *db_prefix = NULL;
-    char *table_name = NULL;
-    char *geom_column = NULL;
-    char *xtable = NULL;
-    char *xgeom = NULL;
+/* preparing all SQL statements required by a KNN context */
     char *xgeomQ;
     char *xtableQ;
     char *idx_name;
     char *idx_nameQ;
     char *sql_statement;
-    gaiaGeomCollPtr geom = NULL;
-    int ok_table = 0;
-    int ok_geom = 0;
-    int ok_max = 0;
-    int max_items = 3;
-    int is_geographic;
-    const unsigned char *blob;
-    int size;
-    int exists;
     int ret;
-    double radius;
-    double dist;
-    sqlite3_stmt *stmt = NULL;
-    sqlite3_stmt *stmt_dist = NULL;
-    sqlite3_stmt *stmt_map_dist = NULL;
-    sqlite3_stmt *stmt_rect_dist = NULL;
-    sqlite3_stmt *stmt_pt_dist = NULL;
-    sqlite3_stmt *stmt_buffer = NULL;
-    sqlite3_stmt *stmt_rtree = NULL;
-    sqlite3_stmt *stmt_rtree_count = NULL;
-    VirtualKnnCursorPtr cursor = (VirtualKnnCursorPtr) pCursor;
-    VirtualKnnPtr knn = (VirtualKnnPtr) cursor->pVtab;
-    VKnnContextPtr vknn_context = knn->knn_ctx;
-    if (idxStr)
-	idxStr = idxStr;	/* unused arg warning suppression */
-    cursor->eof = 1;
-    if (idxStr)
-	idxStr = idxStr;	/* unused arg warning suppression */
-    cursor->eof = 1;
-    if (idxNum == 1 && argc == 3)
-      {
-	  /* retrieving the Table/Column/Geometry params */
-	  if (sqlite3_value_type (argv[0]) == SQLITE_TEXT)
-	    {
-		char *tn = (char *) sqlite3_value_text (argv[0]);
-		vknn_parse_table_name (tn, &db_prefix, &table_name);
-		ok_table = 1;
-	    }
-	  if (sqlite3_value_type (argv[1]) == SQLITE_TEXT)
-	    {
-		geom_column = (char *) sqlite3_value_text (argv[1]);
-		ok_geom = 1;
+    *stmt_dist = NULL;
+    *stmt_geom = NULL;
+    *stmt_node = NULL;
+
+/* building the Distance query */
+    xgeomQ = gaiaDoubleQuotedSql (xgeom);
+    xtableQ = gaiaDoubleQuotedSql (xtable);
+    if (is_geographic)
+	sql_statement =
+	    sqlite3_mprintf
+	    ("SELECT ST_Distance(?, \"%s\", 1) FROM \"%s\" WHERE rowid = ?",
+	     xgeomQ, xtableQ);
+    else
+	sql_statement =
+	    sqlite3_mprintf
+	    ("SELECT ST_Distance(?, \"%s\") FROM \"%s\" WHERE rowid = ?",
+	     xgeomQ, xtableQ);
+    free (xgeomQ);
+    free (xtableQ);
+    ret =
+	sqlite3_prepare_v2 (sqlite, sql_statement, strlen (sql_statement),
+			    stmt_dist, NULL);
+    sqlite3_free (sql_statement);
+    if (ret != SQLITE_OK)
+	goto error;
+
+    if (is_geographic)
+      {
+	  /* building the Geometry query - geodesic distances */
+	  xgeomQ = gaiaDoubleQuotedSql (xgeom);
+	  xtableQ = gaiaDoubleQuotedSql (xtable);
+	  sql_statement =
+	      sqlite3_mprintf ("SELECT \"%s\" FROM \"%s\" WHERE rowid = ?",
+			       xgeomQ, xtableQ);
+	  free (xgeomQ);
+	  free (xtableQ);
+	  ret =
+	      sqlite3_prepare_v2 (sqlite, sql_statement, strlen (sql_statement),
+				  stmt_geom, NULL);
+	  sqlite3_free (sql_statement);
+	  if (ret != SQLITE_OK)
+	      goto error;
+      }
+
+/* building the RTree query - Nodes */
+    idx_name = sqlite3_mprintf ("idx_%s_%s_node", xtable, xgeom);
+    idx_nameQ = gaiaDoubleQuotedSql (idx_name);
+    if (db_prefix == NULL)
+      {
+	  sql_statement =
+	      sqlite3_mprintf
+	      ("SELECT data FROM main.\"%s\" WHERE nodeno = ?", idx_nameQ);
+      }
+    else
+      {
+	  char *quoted_db = gaiaDoubleQuotedSql (db_prefix);
+	  sql_statement =
+	      sqlite3_mprintf
+	      ("SELECT data FROM \"%s\".\"%s\" WHERE nodeno = ?", quoted_db,
+	       idx_nameQ);
+	  free (quoted_db);
+      }
+    free (idx_nameQ);
+    sqlite3_free (idx_name);
+    ret =
+	sqlite3_prepare_v2 (sqlite, sql_statement, strlen (sql_statement),
+			    stmt_node, NULL);
+    sqlite3_free (sql_statement);
+    if (ret != SQLITE_OK)
+	goto error;
+    return 1;
+
+  error:
+    if (*stmt_dist != NULL)
+	sqlite3_finalize (*stmt_dist);
+    if (*stmt_geom != NULL)
+	sqlite3_finalize (*stmt_geom);
+    *stmt_dist = NULL;
+    *stmt_geom = NULL;
+    return 0;
+}
+
+static int
+vknn_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
+	     int argc, sqlite3_value ** argv)
+{
+/* setting up a cursor filter */
+    char *db_prefix = NULL;
+    char *table_name = NULL;
+    char *geom_column = NULL;
+    char *xtable = NULL;
+    char *xgeom = NULL;
+    gaiaGeomCollPtr geom = NULL;
+    int ok_table = 0;
+    int ok_geom = 0;
+    int ok_max = 0;
+    int max_items = 3;
+    int is_geographic;
+    const unsigned char *blob;
+    int size;
+    int exists;
+    sqlite3_stmt *stmt_dist = NULL;
+    sqlite3_stmt *stmt_geom = NULL;
+    sqlite3_stmt *stmt_node = NULL;
+    VirtualKnnCursorPtr cursor = (VirtualKnnCursorPtr) pCursor;
+    VirtualKnnPtr knn = (VirtualKnnPtr) cursor->pVtab;
+    VKnnContextPtr vknn_context = cursor->knn_ctx;
+    if (idxStr)
+	idxStr = idxStr;	/* unused arg warning suppression */
+    cursor->eof = 1;
+    if (idxStr)
+	idxStr = idxStr;	/* unused arg warning suppression */
+    cursor->eof = 1;
+    if (idxNum == 1 && argc == 3)
+      {
+	  /* retrieving the Table/Column/Geometry params */
+	  if (sqlite3_value_type (argv[0]) == SQLITE_TEXT)
+	    {
+		char *tn = (char *) sqlite3_value_text (argv[0]);
+		vknn_parse_table_name (tn, &db_prefix, &table_name);
+		ok_table = 1;
+	    }
+	  if (sqlite3_value_type (argv[1]) == SQLITE_TEXT)
+	    {
+		geom_column = (char *) sqlite3_value_text (argv[1]);
+		ok_geom = 1;
 	    }
 	  if (sqlite3_value_type (argv[2]) == SQLITE_BLOB)
 	    {
@@ -1373,8 +1550,8 @@ vknn_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 	  if (sqlite3_value_type (argv[3]) == SQLITE_INTEGER)
 	    {
 		max_items = sqlite3_value_int (argv[3]);
-		if (max_items > 1024)
-		    max_items = 1024;
+		if (max_items > VKNN_MAX_ITEMS)
+		    max_items = VKNN_MAX_ITEMS;
 		if (max_items < 1)
 		    max_items = 1;
 		ok_max = 1;
@@ -1405,8 +1582,8 @@ vknn_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 	  if (sqlite3_value_type (argv[2]) == SQLITE_INTEGER)
 	    {
 		max_items = sqlite3_value_int (argv[2]);
-		if (max_items > 1024)
-		    max_items = 1024;
+		if (max_items > VKNN_MAX_ITEMS)
+		    max_items = VKNN_MAX_ITEMS;
 		if (max_items < 1)
 		    max_items = 1;
 		ok_max = 1;
@@ -1432,224 +1609,29 @@ vknn_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
     if (!exists)
 	goto stop;
 
-/* building the Distance query */
-    xgeomQ = gaiaDoubleQuotedSql (xgeom);
-    xtableQ = gaiaDoubleQuotedSql (xtable);
-    if (is_geographic)
-	sql_statement =
-	    sqlite3_mprintf
-	    ("SELECT ST_Distance(?, \"%s\", 1) FROM \"%s\" WHERE rowid = ?",
-	     xgeomQ, xtableQ);
-    else
-	sql_statement =
-	    sqlite3_mprintf
-	    ("SELECT ST_Distance(?, \"%s\") FROM \"%s\" WHERE rowid = ?",
-	     xgeomQ, xtableQ);
-    free (xgeomQ);
-    free (xtableQ);
-    ret =
-	sqlite3_prepare_v2 (knn->db, sql_statement, strlen (sql_statement),
-			    &stmt_dist, NULL);
-    sqlite3_free (sql_statement);
-    if (ret != SQLITE_OK)
-	goto stop;
-
-/* building the Distance query - map units */
-    xgeomQ = gaiaDoubleQuotedSql (xgeom);
-    xtableQ = gaiaDoubleQuotedSql (xtable);
-    sql_statement =
-	sqlite3_mprintf
-	("SELECT ST_Distance(?, \"%s\") FROM \"%s\" WHERE rowid = ?",
-	 xgeomQ, xtableQ);
-    free (xgeomQ);
-    free (xtableQ);
-    ret =
-	sqlite3_prepare_v2 (knn->db, sql_statement, strlen (sql_statement),
-			    &stmt_map_dist, NULL);
-    sqlite3_free (sql_statement);
-    if (ret != SQLITE_OK)
-	goto stop;
-
-/* building the Distance query - RTree MBR */
-    sql_statement = "SELECT ST_Distance(?, BuildMbr(?, ?, ?, ?))";
-    ret =
-	sqlite3_prepare_v2 (knn->db, sql_statement, strlen (sql_statement),
-			    &stmt_rect_dist, NULL);
-    if (ret != SQLITE_OK)
-	goto stop;
-
-/* building the Distance query - Point */
-    sql_statement = "SELECT ST_Distance(?, MakePoint(?, ?))";
-    ret =
-	sqlite3_prepare_v2 (knn->db, sql_statement, strlen (sql_statement),
-			    &stmt_pt_dist, NULL);
-    if (ret != SQLITE_OK)
-	goto stop;
-
-/* building the Buffer query */
-    sql_statement =
-	"SELECT MbrMinX(x.g), MbrMinY(x.g), MbrMaxX(x.g), MbrMaxY(x.g) "
-	"FROM (SELECT ST_Buffer(ST_Envelope(?), ?) AS g) AS x";
-    ret =
-	sqlite3_prepare_v2 (knn->db, sql_statement, strlen (sql_statement),
-			    &stmt_buffer, NULL);
-    if (ret != SQLITE_OK)
-	goto stop;
-
-/* building the RTree query - Intersects */
-    idx_name = sqlite3_mprintf ("idx_%s_%s", xtable, xgeom);
-    idx_nameQ = gaiaDoubleQuotedSql (idx_name);
-    if (db_prefix == NULL)
-      {
-	  sql_statement =
-	      sqlite3_mprintf
-	      ("SELECT pkid FROM main.\"%s\" WHERE xmin <= ? AND xmax >= ? AND ymin <= ? AND ymax >= ?",
-	       idx_nameQ);
-      }
-    else
-      {
-	  char *quoted_db = gaiaDoubleQuotedSql (db_prefix);
-	  sql_statement =
-	      sqlite3_mprintf
-	      ("SELECT pkid FROM \"%s\".\"%s\" WHERE xmin <= ? AND xmax >= ? AND ymin <= ? AND ymax >= ?",
-	       quoted_db, idx_nameQ);
-	  free (quoted_db);
-      }
-    free (idx_nameQ);
-    sqlite3_free (idx_name);
-    ret =
-	sqlite3_prepare_v2 (knn->db, sql_statement, strlen (sql_statement),
-			    &stmt_rtree, NULL);
-    sqlite3_free (sql_statement);
-    if (ret != SQLITE_OK)
-	goto stop;
-
-/* building the RTree query - count items */
-    idx_name = sqlite3_mprintf ("idx_%s_%s", xtable, xgeom);
-    idx_nameQ = gaiaDoubleQuotedSql (idx_name);
-    if (db_prefix == NULL)
-      {
-	  sql_statement =
-	      sqlite3_mprintf ("SELECT pkid FROM \"%s\" LIMIT 1024", idx_nameQ);
-      }
-    else
-      {
-	  char *quoted_db = gaiaDoubleQuotedSql (db_prefix);
-	  sql_statement =
-	      sqlite3_mprintf ("SELECT pkid FROM \"%s\".\"%s\" LIMIT 1024",
-			       quoted_db, idx_nameQ);
-	  free (quoted_db);
-      }
-    sqlite3_free (idx_name);
-    free (idx_nameQ);
-    ret =
-	sqlite3_prepare_v2 (knn->db, sql_statement, strlen (sql_statement),
-			    &stmt_rtree_count, NULL);
-    sqlite3_free (sql_statement);
-    if (ret != SQLITE_OK)
+/* preparing the KNN statements */
+    if (!vknn_prepare_statements
+	(knn->db, db_prefix, xtable, xgeom, is_geographic, &stmt_dist,
+	 &stmt_geom, &stmt_node))
 	goto stop;
 
-/* installing the R*Tree query callback */
+/* initializing the KNN context */
     gaiaMbrGeometry (geom);
     vknn_init_context (vknn_context, xtable, xgeom, geom, max_items,
-		       stmt_dist, stmt_map_dist, stmt_rect_dist, stmt_pt_dist,
-		       stmt_buffer, stmt_rtree, stmt_rtree_count);
+		       is_geographic, stmt_dist, stmt_geom, stmt_node);
+    vknn_set_ellipsoid (vknn_context, knn->db, geom->Srid);
     gaiaFreeGeomColl (geom);
     geom = NULL;		/* releasing ownership on geom */
     stmt_dist = NULL;		/* releasing ownership on stmt_dist */
-    stmt_map_dist = NULL;	/* releasing ownership on stmt_map_dist */
-    stmt_rect_dist = NULL;	/* releasing ownership on stmt_rect */
-    stmt_pt_dist = NULL;	/* releasing ownership on stmt_point */
-    stmt_buffer = NULL;		/* releasing ownership on stmt_buffer */
-    stmt_rtree = NULL;		/* releasing ownership on stmt_rtree */
-    stmt_rtree_count = NULL;	/* releasing ownership on stmt_rtree_count */
-    sqlite3_rtree_query_callback (knn->db, "knn_position", vknn_query_callback,
-				  vknn_context, NULL);
-
-/* building the RTree query - callback */
-    idx_name = sqlite3_mprintf ("idx_%s_%s", xtable, xgeom);
-    idx_nameQ = gaiaDoubleQuotedSql (idx_name);
-    if (db_prefix == NULL)
-      {
-	  sql_statement =
-	      sqlite3_mprintf
-	      ("SELECT pkid FROM main.\"%s\" WHERE pkid MATCH knn_position(1)",
-	       idx_nameQ);
-      }
-    else
-      {
-	  char *quoted_db = gaiaDoubleQuotedSql (db_prefix);
-	  sql_statement =
-	      sqlite3_mprintf
-	      ("SELECT pkid FROM \"%s\".\"%s\" WHERE pkid MATCH knn_position(1)",
-	       quoted_db, idx_nameQ);
-	  free (quoted_db);
-      }
-    free (idx_nameQ);
-    sqlite3_free (idx_name);
-    ret =
-	sqlite3_prepare_v2 (knn->db, sql_statement, strlen (sql_statement),
-			    &stmt, NULL);
-    sqlite3_free (sql_statement);
-    if (ret != SQLITE_OK)
-	goto stop;
-
-    vknn_context->bbox_minx = -DBL_MAX;
-    vknn_context->bbox_miny = -DBL_MAX;
-    vknn_context->bbox_maxx = DBL_MAX;
-    vknn_context->bbox_maxy = DBL_MAX;
-    vknn_context->current_level = 1024;
-    while (1)
-      {
-	  /* repeatedly querying the R*Tree until finding the nearest BBOX */
-	  vknn_context->minx = DBL_MAX;
-	  vknn_context->miny = DBL_MAX;
-	  vknn_context->maxx = -DBL_MAX;
-	  vknn_context->maxy = -DBL_MAX;
-	  vknn_context->min_dist = DBL_MAX;
-	  sqlite3_step (stmt);
-	  vknn_context->bbox_minx = vknn_context->minx;
-	  vknn_context->bbox_miny = vknn_context->miny;
-	  vknn_context->bbox_maxx = vknn_context->maxx;
-	  vknn_context->bbox_maxy = vknn_context->maxy;
-	  if (vknn_context->level <= 1)
-	      break;
-	  vknn_context->current_level = vknn_context->level - 1;
-      }
-    radius =
-	vknn_pt_distance (vknn_context, vknn_context->bbox_minx,
-			  vknn_context->bbox_miny);
-    dist =
-	vknn_pt_distance (vknn_context, vknn_context->bbox_minx,
-			  vknn_context->bbox_maxy);
-    if (dist > radius)
-	radius = dist;
-    dist =
-	vknn_pt_distance (vknn_context, vknn_context->bbox_maxx,
-			  vknn_context->bbox_miny);
-    if (dist > radius)
-	radius = dist;
-    dist =
-	vknn_pt_distance (vknn_context, vknn_context->bbox_maxx,
-			  vknn_context->bbox_maxy);
-    if (dist > radius)
-	radius = dist;
-
-    while (1)
-      {
-	  if (!vknn_bufferize (vknn_context, radius))
-	      break;
-	  ret = vknn_rtree_query (vknn_context);
-	  if (ret <= 0 || ret >= max_items || ret >= vknn_context->rtree_count)
-	      break;
-	  radius *= 1.05;
-      }
+    stmt_geom = NULL;		/* releasing ownership on stmt_geom */
+    stmt_node = NULL;		/* releasing ownership on stmt_node */
 
-    if (vknn_context->curr_items == 0)
-	cursor->eof = 1;
-    else
-	cursor->eof = 0;
+/* locating the first nearest Feature */
     cursor->CurrentIndex = 0;
+    if (vknn_start (vknn_context) && vknn_fetch_next (vknn_context))
+	cursor->eof = 0;
+    else
+	cursor->eof = 1;
   stop:
     if (geom)
 	gaiaFreeGeomColl (geom);
@@ -1661,22 +1643,12 @@ vknn_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 	free (db_prefix);
     if (table_name)
 	free (table_name);
-    if (stmt != NULL)
-	sqlite3_finalize (stmt);
     if (stmt_dist != NULL)
 	sqlite3_finalize (stmt_dist);
-    if (stmt_map_dist != NULL)
-	sqlite3_finalize (stmt_map_dist);
-    if (stmt_rect_dist != NULL)
-	sqlite3_finalize (stmt_rect_dist);
-    if (stmt_pt_dist != NULL)
-	sqlite3_finalize (stmt_pt_dist);
-    if (stmt_buffer != NULL)
-	sqlite3_finalize (stmt_buffer);
-    if (stmt_rtree != NULL)
-	sqlite3_finalize (stmt_rtree);
-    if (stmt_rtree_count != NULL)
-	sqlite3_finalize (stmt_rtree_count);
+    if (stmt_geom != NULL)
+	sqlite3_finalize (stmt_geom);
+    if (stmt_node != NULL)
+	sqlite3_finalize (stmt_node);
     return SQLITE_OK;
 }
 
@@ -1685,9 +1657,9 @@ vknn_next (sqlite3_vtab_cursor * pCursor)
 {
 /* fetching a next row from cursor */
     VirtualKnnCursorPtr cursor = (VirtualKnnCursorPtr) pCursor;
-    VKnnContextPtr ctx = cursor->pVtab->knn_ctx;
+    VKnnContextPtr ctx = cursor->knn_ctx;
     cursor->CurrentIndex += 1;
-    if (cursor->CurrentIndex >= ctx->curr_items)
+    if (!vknn_fetch_next (ctx))
 	cursor->eof = 1;
     return SQLITE_OK;
 }
@@ -1706,14 +1678,14 @@ vknn_column (sqlite3_vtab_cursor * pCursor, sqlite3_context * pContext,
 {
 /* fetching value for the Nth column */
     VirtualKnnCursorPtr cursor = (VirtualKnnCursorPtr) pCursor;
-    VKnnContextPtr ctx = cursor->pVtab->knn_ctx;
+    VKnnContextPtr ctx = cursor->knn_ctx;
     VKnnItemPtr item = NULL;
     if (cursor || column)
 	cursor = cursor;	/* unused arg warning suppression */
     if (column)
 	column = column;	/* unused arg warning suppression */
-    if (cursor->CurrentIndex < ctx->curr_items)
-	item = ctx->knn_array + cursor->CurrentIndex;
+    if (!cursor->eof)
+	item = &(ctx->current);
     if (column == 0)
       {
 	  /* the Table Name column */
@@ -1829,6 +1801,1000 @@ vknn_rename (sqlite3_vtab * pVTab, const char *zNew)
     return SQLITE_ERROR;
 }
 
+/******************************************************************************
+/
+/ KNN_Join: nearest Features for every row of a table
+/
+******************************************************************************/
+
+#define KNN_JOIN_MAX_THREADS		64
+#define KNN_JOIN_BLOCK_POINTS		1024
+#define KNN_JOIN_CHUNK_ROWS		4096
+#define KNN_JOIN_CHUNKS_PER_THREAD	4
+
+struct knn_join_point
+{
+/* a reference Geometry, sorted along a Hilbert curve */
+    sqlite3_int64 rowid;
+    unsigned int hilbert;
+};
+
+struct knn_join_row
+{
+/* a single row of the output table */
+    sqlite3_int64 point_rowid;
+    sqlite3_int64 target_rowid;
+    int pos;
+    double distance;
+};
+
+struct knn_join_chunk
+{
+/* a block of output rows */
+    struct knn_join_row *rows;
+    int count;
+    struct knn_join_chunk *next;
+};
+
+struct knn_join_worker
+{
+/* the KNN state owned by a single connection */
+    VKnnContext ctx;
+    sqlite3 *handle;
+    sqlite3_stmt *stmt_point;
+};
+
+struct knn_join
+{
+/* the KNN Join */
+    const char *db_path;
+    const char *point_table;
+    const char *point_geom;
+    char *target_table;
+    char *target_geom;
+    int is_geographic;
+    int k;
+    struct knn_join_point *points;
+    int n_points;
+    int next_block;
+    int abort;
+    char *error;
+#ifndef _WIN32
+    pthread_mutex_t mutex;
+    pthread_cond_t produced;
+    pthread_cond_t consumed;
+    struct knn_join_chunk *first;
+    struct knn_join_chunk *last;
+    int n_chunks;
+    int max_chunks;
+    int n_running;
+    int n_ready;
+#endif
+};
+
+typedef int (*knn_join_emit) (void *data, struct knn_join_row * row);
+
+static void
+knn_join_set_error (const void *ctx, const char *errmsg)
+{
+/* setting the KNN_Join Last Error Message */
+    struct splite_internal_cache *cache = (struct splite_internal_cache *) ctx;
+    if (cache != NULL)
+      {
+	  int len;
+	  if (cache->knnJoinError != NULL)
+	    {
+		free (cache->knnJoinError);
+		cache->knnJoinError = NULL;
+	    }
+	  if (errmsg == NULL)
+	      return;
+
+	  len = strlen (errmsg);
+	  cache->knnJoinError = malloc (len + 1);
+	  strcpy (cache->knnJoinError, errmsg);
+      }
+}
+
+SPATIALITE_DECLARE const char *
+gaia_knn_join_get_last_error (const void *p_cache)
+{
+/* return the last KNN_Join Error Message (if any) */
+    struct splite_internal_cache *cache =
+	(struct splite_internal_cache *) p_cache;
+
+    if (cache == NULL)
+	return NULL;
+    return cache->knnJoinError;
+}
+
+static int
+knn_join_check_geometry (sqlite3 * sqlite, const char *table,
+			 const char *geometry)
+{
+/* checking if some Geometry Column exists */
+    char *sql;
+    char **results;
+    int rows;
+    int columns;
+    int ret;
+    sql =
+	sqlite3_mprintf
+	("SELECT f_geometry_column FROM main.geometry_columns "
+	 "WHERE Upper(f_table_name) = Upper(%Q) AND "
+	 "Upper(f_geometry_column) = Upper(%Q)", table, geometry);
+    ret = sqlite3_get_table (sqlite, sql, &results, &rows, &columns, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    sqlite3_free_table (results);
+    if (rows < 1)
+	return 0;
+    return 1;
+}
+
+static int
+knn_join_check_out_table (sqlite3 * sqlite, const char *out_table)
+{
+/* checking if the output table already exists */
+    char *sql;
+    char **results;
+    int rows;
+    int columns;
+    int ret;
+    sql =
+	sqlite3_mprintf
+	("SELECT name FROM main.sqlite_master WHERE Upper(name) = Upper(%Q)",
+	 out_table);
+    ret = sqlite3_get_table (sqlite, sql, &results, &rows, &columns, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    sqlite3_free_table (results);
+    if (rows > 0)
+	return 0;
+    return 1;
+}
+
+static unsigned int
+knn_join_hilbert (unsigned int x, unsigned int y)
+{
+/* position of a 16 bit cell along the Hilbert curve */
+    unsigned int rx;
+    unsigned int ry;
+    unsigned int s;
+    unsigned int d = 0;
+    for (s = 0x8000; s > 0; s /= 2)
+      {
+	  rx = (x & s) > 0;
+	  ry = (y & s) > 0;
+	  d += s * s * ((3 * rx) ^ ry);
+	  if (ry == 0)
+	    {
+		/* rotating the quadrant */
+		unsigned int t;
+		if (rx == 1)
+		  {
+		      x = 0xffff - x;
+		      y = 0xffff - y;
+		  }
+		t = x;
+		x = y;
+		y = t;
+	    }
+      }
+    return d;
+}
+
+static int
+cmp_knn_join_points (const void *p1, const void *p2)
+{
+/* compares two reference Geometries [Hilbert order] */
+    const struct knn_join_point *a = (const struct knn_join_point *) p1;
+    const struct knn_join_point *b = (const struct knn_join_point *) p2;
+    if (a->hilbert < b->hilbert)
+	return -1;
+    if (a->hilbert > b->hilbert)
+	return 1;
+    if (a->rowid < b->rowid)
+	return -1;
+    if (a->rowid > b->rowid)
+	return 1;
+    return 0;
+}
+
+static int
+knn_join_sort_points (sqlite3 * sqlite, struct knn_join *join)
+{
+/*
+/ loading all reference Geometries and sorting them along a
+/ Hilbert curve, so that consecutive KNN searches will mostly
+/ touch the same R*Tree Nodes
+*/
+    char *xtable;
+    char *xgeom;
+    char *sql;
+    sqlite3_stmt *stmt = NULL;
+    int ret;
+    int max = 0;
+    double minx = 0.0;
+    double miny = 0.0;
+    double maxx = 0.0;
+    double maxy = 0.0;
+    double scale_x;
+    double scale_y;
+
+    xtable = gaiaDoubleQuotedSql (join->point_table);
+    xgeom = gaiaDoubleQuotedSql (join->point_geom);
+    sql =
+	sqlite3_mprintf
+	("SELECT Count(*), Min(MbrMinX(\"%s\")), Min(MbrMinY(\"%s\")), "
+	 "Max(MbrMaxX(\"%s\")), Max(MbrMaxY(\"%s\")) FROM main.\"%s\" "
+	 "WHERE \"%s\" IS NOT NULL", xgeom, xgeom, xgeom, xgeom, xtable,
+	 xgeom);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto error;
+    ret = sqlite3_step (stmt);
+    if (ret != SQLITE_ROW)
+	goto error;
+    max = sqlite3_column_int (stmt, 0);
+    if (sqlite3_column_type (stmt, 1) == SQLITE_NULL)
+	max = 0;
+    else
+      {
+	  minx = sqlite3_column_double (stmt, 1);
+	  miny = sqlite3_column_double (stmt, 2);
+	  maxx = sqlite3_column_double (stmt, 3);
+	  maxy = sqlite3_column_double (stmt, 4);
+      }
+    sqlite3_finalize (stmt);
+    stmt = NULL;
+    if (max == 0)
+      {
+	  /* empty table */
+	  free (xtable);
+	  free (xgeom);
+	  return 1;
+      }
+    join->points = malloc (sizeof (struct knn_join_point) * max);
+    if (join->points == NULL)
+	goto error;
+    scale_x = (maxx > minx) ? 65535.0 / (maxx - minx) : 0.0;
+    scale_y = (maxy > miny) ? 65535.0 / (maxy - miny) : 0.0;
+
+    sql =
+	sqlite3_mprintf
+	("SELECT ROWID, (MbrMinX(\"%s\") + MbrMaxX(\"%s\")) / 2.0, "
+	 "(MbrMinY(\"%s\") + MbrMaxY(\"%s\")) / 2.0 FROM main.\"%s\" "
+	 "WHERE \"%s\" IS NOT NULL", xgeom, xgeom, xgeom, xgeom, xtable,
+	 xgeom);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto error;
+    while (1)
+      {
+	  /* scrolling the result set rows */
+	  struct knn_join_point *pt;
+	  double x;
+	  double y;
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;		/* end of result set */
+	  if (ret != SQLITE_ROW)
+	      goto error;
+	  if (join->n_points >= max)
+	      break;
+	  pt = join->points + join->n_points;
+	  x = sqlite3_column_double (stmt, 1);
+	  y = sqlite3_column_double (stmt, 2);
+	  pt->rowid = sqlite3_column_int64 (stmt, 0);
+	  pt->hilbert =
+	      knn_join_hilbert ((unsigned int) ((x - minx) * scale_x),
+				(unsigned int) ((y - miny) * scale_y));
+	  join->n_points += 1;
+      }
+    sqlite3_finalize (stmt);
+    free (xtable);
+    free (xgeom);
+    qsort (join->points, join->n_points, sizeof (struct knn_join_point),
+	   cmp_knn_join_points);
+    return 1;
+
+  error:
+    if (stmt != NULL)
+	sqlite3_finalize (stmt);
+    free (xtable);
+    free (xgeom);
+    return 0;
+}
+
+static int
+knn_join_open_worker (sqlite3 * sqlite, struct knn_join *join,
+		      struct knn_join_worker *worker)
+{
+/* preparing all statements required on some connection */
+    char *xtable;
+    char *xgeom;
+    char *sql;
+    int ret;
+    sqlite3_stmt *stmt_dist;
+    sqlite3_stmt *stmt_geom;
+    sqlite3_stmt *stmt_node;
+
+    vknn_empty_context (&(worker->ctx));
+    worker->handle = sqlite;
+    worker->stmt_point = NULL;
+    xtable = gaiaDoubleQuotedSql (join->point_table);
+    xgeom = gaiaDoubleQuotedSql (join->point_geom);
+    sql =
+	sqlite3_mprintf ("SELECT \"%s\" FROM main.\"%s\" WHERE ROWID = ?",
+			 xgeom, xtable);
+    free (xtable);
+    free (xgeom);
+    ret =
+	sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &(worker->stmt_point),
+			    NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return 0;
+    if (!vknn_prepare_statements
+	(sqlite, NULL, join->target_table, join->target_geom,
+	 join->is_geographic, &stmt_dist, &stmt_geom, &stmt_node))
+	return 0;
+    worker->ctx.stmt_dist = stmt_dist;
+    worker->ctx.stmt_geom = stmt_geom;
+    worker->ctx.stmt_node = stmt_node;
+    worker->ctx.is_geographic = join->is_geographic;
+    worker->ctx.max_items = join->k;
+    return 1;
+}
+
+static void
+knn_join_close_worker (struct knn_join_worker *worker)
+{
+/* memory cleanup - finalizing all statements */
+    if (worker->stmt_point != NULL)
+	sqlite3_finalize (worker->stmt_point);
+    worker->stmt_point = NULL;
+    vknn_reset_context (&(worker->ctx));
+}
+
+static int
+knn_join_eval_block (struct knn_join *join, struct knn_join_worker *worker,
+		     int block, knn_join_emit emit, void *data)
+{
+/* evaluating a block of consecutive reference Geometries */
+    VKnnContextPtr ctx = &(worker->ctx);
+    sqlite3_stmt *stmt = worker->stmt_point;
+    struct knn_join_row row;
+    int first = block * KNN_JOIN_BLOCK_POINTS;
+    int last = first + KNN_JOIN_BLOCK_POINTS;
+    int i;
+    int ret;
+    if (last > join->n_points)
+	last = join->n_points;
+    for (i = first; i < last; i++)
+      {
+	  gaiaGeomCollPtr geom = NULL;
+	  sqlite3_int64 rowid = join->points[i].rowid;
+	  sqlite3_reset (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  sqlite3_bind_int64 (stmt, 1, rowid);
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_ROW)
+	    {
+		if (sqlite3_column_type (stmt, 0) == SQLITE_BLOB)
+		    geom =
+			gaiaFromSpatiaLiteBlobWkb (sqlite3_column_blob
+						   (stmt, 0),
+						   sqlite3_column_bytes (stmt,
+									 0));
+	    }
+	  else if (ret != SQLITE_DONE)
+	      return 0;
+	  if (geom == NULL)
+	      continue;		/* deleted row or invalid Geometry */
+	  gaiaMbrGeometry (geom);
+	  vknn_set_reference (ctx, geom);
+	  vknn_set_ellipsoid (ctx, worker->handle, geom->Srid);
+	  gaiaFreeGeomColl (geom);
+	  if (!vknn_start (ctx))
+	      return 0;
+	  row.point_rowid = rowid;
+	  row.pos = 0;
+	  while (vknn_fetch_next (ctx))
+	    {
+		row.target_rowid = ctx->current.rowid;
+		row.distance = ctx->current.dist;
+		row.pos += 1;
+		if (!emit (data, &row))
+		    return 0;
+	    }
+      }
+    return 1;
+}
+
+static int
+knn_join_insert_row (sqlite3_stmt * stmt_out, struct knn_join_row *row)
+{
+/* INSERTing a single row into the output table */
+    int ret;
+    sqlite3_reset (stmt_out);
+    sqlite3_clear_bindings (stmt_out);
+    sqlite3_bind_int64 (stmt_out, 1, row->point_rowid);
+    sqlite3_bind_int (stmt_out, 2, row->pos);
+    sqlite3_bind_int64 (stmt_out, 3, row->target_rowid);
+    sqlite3_bind_double (stmt_out, 4, row->distance);
+    ret = sqlite3_step (stmt_out);
+    if (ret != SQLITE_DONE && ret != SQLITE_ROW)
+	return 0;
+    return 1;
+}
+
+struct knn_join_serial_sink
+{
+/* output rows are directly INSERTed by the calling connection */
+    sqlite3_stmt *stmt_out;
+    sqlite3_int64 *count;
+};
+
+static int
+knn_join_serial_emit (void *data, struct knn_join_row *row)
+{
+/* INSERTing a row found on the calling connection */
+    struct knn_join_serial_sink *sink = (struct knn_join_serial_sink *) data;
+    if (!knn_join_insert_row (sink->stmt_out, row))
+	return 0;
+    *(sink->count) += 1;
+    return 1;
+}
+
+static int
+knn_join_serial (sqlite3 * sqlite, struct knn_join *join,
+		 sqlite3_stmt * stmt_out, sqlite3_int64 * count)
+{
+/*
+/ evaluating all reference Geometries on the current connection
+/ (in-memory DBs or no thread support)
+*/
+    struct knn_join_worker worker;
+    struct knn_join_serial_sink sink;
+    int n_blocks =
+	(join->n_points + KNN_JOIN_BLOCK_POINTS - 1) / KNN_JOIN_BLOCK_POINTS;
+    int i;
+    int ok = 1;
+    sink.stmt_out = stmt_out;
+    sink.count = count;
+    if (!knn_join_open_worker (sqlite, join, &worker))
+      {
+	  join->error = sqlite3_mprintf ("%s", sqlite3_errmsg (sqlite));
+	  knn_join_close_worker (&worker);
+	  return 0;
+      }
+    for (i = 0; i < n_blocks; i++)
+      {
+	  if (!knn_join_eval_block
+	      (join, &worker, i, knn_join_serial_emit, &sink))
+	    {
+		join->error = sqlite3_mprintf ("%s", sqlite3_errmsg (sqlite));
+		ok = 0;
+		break;
+	    }
+      }
+    knn_join_close_worker (&worker);
+    return ok;
+}
+
+#ifndef _WIN32			/* POSIX threads: supporting parallel execution */
+
+static void
+knn_join_set_thread_error (struct knn_join *join, const char *msg)
+{
+/* recording the first error raised by some worker thread */
+    pthread_mutex_lock (&(join->mutex));
+    if (join->error == NULL)
+	join->error = sqlite3_mprintf ("%s", msg);
+    join->abort = 1;
+    pthread_cond_broadcast (&(join->produced));
+    pthread_cond_broadcast (&(join->consumed));
+    pthread_mutex_unlock (&(join->mutex));
+}
+
+static struct knn_join_chunk *
+knn_join_alloc_chunk (void)
+{
+/* allocating an empty block of output rows */
+    struct knn_join_chunk *chunk = malloc (sizeof (struct knn_join_chunk));
+    if (chunk == NULL)
+	return NULL;
+    chunk->rows = malloc (sizeof (struct knn_join_row) * KNN_JOIN_CHUNK_ROWS);
+    if (chunk->rows == NULL)
+      {
+	  free (chunk);
+	  return NULL;
+      }
+    chunk->count = 0;
+    chunk->next = NULL;
+    return chunk;
+}
+
+static void
+knn_join_free_chunk (struct knn_join_chunk *chunk)
+{
+/* memory cleanup - destroying a block of output rows */
+    if (chunk == NULL)
+	return;
+    free (chunk->rows);
+    free (chunk);
+}
+
+static int
+knn_join_push_chunk (struct knn_join *join, struct knn_join_chunk *chunk)
+{
+/* handing over a block of output rows to the writer */
+    int ok = 1;
+    pthread_mutex_lock (&(join->mutex));
+    while (join->n_chunks >= join->max_chunks && !join->abort)
+	pthread_cond_wait (&(join->consumed), &(join->mutex));
+    if (join->abort)
+	ok = 0;
+    else
+      {
+	  if (join->first == NULL)
+	      join->first = chunk;
+	  if (join->last != NULL)
+	      join->last->next = chunk;
+	  join->last = chunk;
+	  join->n_chunks += 1;
+	  pthread_cond_signal (&(join->produced));
+      }
+    pthread_mutex_unlock (&(join->mutex));
+    return ok;
+}
+
+struct knn_join_thread_sink
+{
+/* output rows are buffered by a worker thread */
+    struct knn_join *join;
+    struct knn_join_chunk *chunk;
+};
+
+static int
+knn_join_thread_emit (void *data, struct knn_join_row *row)
+{
+/* buffering a row found by some worker thread */
+    struct knn_join_thread_sink *sink = (struct knn_join_thread_sink *) data;
+    if (sink->chunk == NULL)
+      {
+	  sink->chunk = knn_join_alloc_chunk ();
+	  if (sink->chunk == NULL)
+	    {
+		knn_join_set_thread_error (sink->join, "insufficient memory");
+		return 0;
+	    }
+      }
+    sink->chunk->rows[sink->chunk->count] = *row;
+    sink->chunk->count += 1;
+    if (sink->chunk->count == KNN_JOIN_CHUNK_ROWS)
+      {
+	  if (!knn_join_push_chunk (sink->join, sink->chunk))
+	      return 0;
+	  sink->chunk = NULL;
+      }
+    return 1;
+}
+
+static void *
+knn_join_worker_thread (void *arg)
+{
+/* a worker thread: evaluating blocks on its own connection */
+    struct knn_join *join = (struct knn_join *) arg;
+    struct knn_join_worker worker;
+    struct knn_join_thread_sink sink;
+    sqlite3 *handle = NULL;
+    void *cache = NULL;
+    int n_blocks =
+	(join->n_points + KNN_JOIN_BLOCK_POINTS - 1) / KNN_JOIN_BLOCK_POINTS;
+    int ret;
+    int index;
+
+    vknn_empty_context (&(worker.ctx));
+    worker.handle = NULL;
+    worker.stmt_point = NULL;
+    sink.join = join;
+    sink.chunk = NULL;
+    ret =
+	sqlite3_open_v2 (join->db_path, &handle,
+			 SQLITE_OPEN_READONLY | SQLITE_OPEN_FULLMUTEX, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  knn_join_set_thread_error (join, sqlite3_errmsg (handle));
+	  sqlite3_close (handle);
+	  handle = NULL;
+	  goto end;
+      }
+    cache = spatialite_alloc_connection ();
+    spatialite_internal_init (handle, cache);
+
+/*
+/ starting a read transaction and immediately acquiring a SHARED
+/ lock; the writer will never start INSERTing before all workers
+/ are ready, so that a pending lock can never lock them out
+*/
+    ret =
+	sqlite3_exec (handle,
+		      "BEGIN; SELECT Count(*) FROM main.sqlite_master", NULL,
+		      NULL, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  knn_join_set_thread_error (join, sqlite3_errmsg (handle));
+	  goto end;
+      }
+    if (!knn_join_open_worker (handle, join, &worker))
+      {
+	  knn_join_set_thread_error (join, sqlite3_errmsg (handle));
+	  goto end;
+      }
+    pthread_mutex_lock (&(join->mutex));
+    join->n_ready += 1;
+    pthread_cond_broadcast (&(join->produced));
+    pthread_mutex_unlock (&(join->mutex));
+
+    while (1)
+      {
+	  /* fetching the next block to be evaluated */
+	  pthread_mutex_lock (&(join->mutex));
+	  if (join->abort || join->next_block >= n_blocks)
+	      index = -1;
+	  else
+	      index = join->next_block++;
+	  pthread_mutex_unlock (&(join->mutex));
+	  if (index < 0)
+	      break;
+	  if (!knn_join_eval_block
+	      (join, &worker, index, knn_join_thread_emit, &sink))
+	    {
+		knn_join_set_thread_error (join, sqlite3_errmsg (handle));
+		goto end;
+	    }
+      }
+    if (sink.chunk != NULL)
+      {
+	  if (knn_join_push_chunk (join, sink.chunk))
+	      sink.chunk = NULL;
+      }
+
+  end:
+    knn_join_free_chunk (sink.chunk);
+    knn_join_close_worker (&worker);
+    if (handle != NULL)
+      {
+	  sqlite3_exec (handle, "ROLLBACK", NULL, NULL, NULL);
+	  sqlite3_close (handle);
+      }
+    if (cache != NULL)
+	spatialite_internal_cleanup (cache);
+    pthread_mutex_lock (&(join->mutex));
+    join->n_running -= 1;
+    pthread_cond_broadcast (&(join->produced));
+    pthread_mutex_unlock (&(join->mutex));
+    return NULL;
+}
+
+static int
+knn_join_get_busy_timeout (sqlite3 * sqlite)
+{
+/* retrieving the current busy-timeout of the writer connection */
+    sqlite3_stmt *stmt;
+    int timeout = 0;
+    int ret;
+
+    ret = sqlite3_prepare_v2 (sqlite, "PRAGMA busy_timeout", -1, &stmt, NULL);
+    if (ret != SQLITE_OK)
+	return 0;
+    if (sqlite3_step (stmt) == SQLITE_ROW)
+	timeout = sqlite3_column_int (stmt, 0);
+    sqlite3_finalize (stmt);
+    return timeout;
+}
+
+static int
+knn_join_parallel (sqlite3 * sqlite, struct knn_join *join, int threads,
+		   sqlite3_stmt * stmt_out, sqlite3_int64 * count)
+{
+/*
+/ evaluating all blocks on N worker threads, each one having its
+/ own read-only connection and its own internal cache; the calling
+/ thread is the only writer
+*/
+    pthread_t workers[KNN_JOIN_MAX_THREADS];
+    int n_workers = 0;
+    int i;
+    int ok = 1;
+
+    pthread_mutex_init (&(join->mutex), NULL);
+    pthread_cond_init (&(join->produced), NULL);
+    pthread_cond_init (&(join->consumed), NULL);
+    join->first = NULL;
+    join->last = NULL;
+    join->n_chunks = 0;
+    join->max_chunks = threads * KNN_JOIN_CHUNKS_PER_THREAD;
+    join->n_running = 0;
+    join->n_ready = 0;
+
+    for (i = 0; i < threads; i++)
+      {
+	  pthread_mutex_lock (&(join->mutex));
+	  join->n_running += 1;
+	  pthread_mutex_unlock (&(join->mutex));
+	  if (pthread_create
+	      (&(workers[n_workers]), NULL, knn_join_worker_thread, join) != 0)
+	    {
+		pthread_mutex_lock (&(join->mutex));
+		join->n_running -= 1;
+		pthread_mutex_unlock (&(join->mutex));
+		break;
+	    }
+	  n_workers++;
+      }
+    if (n_workers == 0)
+      {
+	  join->error = sqlite3_mprintf ("unable to start any worker thread");
+	  ok = 0;
+	  goto end;
+      }
+
+/* waiting until all workers have acquired their read lock */
+    pthread_mutex_lock (&(join->mutex));
+    while (join->n_ready + (n_workers - join->n_running) < n_workers
+	   && !join->abort)
+	pthread_cond_wait (&(join->produced), &(join->mutex));
+    pthread_mutex_unlock (&(join->mutex));
+
+    while (1)
+      {
+	  /* consuming the rows found by the workers */
+	  struct knn_join_chunk *chunk;
+	  pthread_mutex_lock (&(join->mutex));
+	  while (join->first == NULL && join->n_running > 0 && !join->abort)
+	      pthread_cond_wait (&(join->produced), &(join->mutex));
+	  if (join->abort || join->first == NULL)
+	    {
+		pthread_mutex_unlock (&(join->mutex));
+		break;
+	    }
+	  chunk = join->first;
+	  join->first = chunk->next;
+	  if (join->first == NULL)
+	      join->last = NULL;
+	  join->n_chunks -= 1;
+	  pthread_cond_signal (&(join->consumed));
+	  pthread_mutex_unlock (&(join->mutex));
+
+	  for (i = 0; i < chunk->count; i++)
+	    {
+		if (!knn_join_insert_row (stmt_out, chunk->rows + i))
+		  {
+		      knn_join_set_thread_error (join,
+						 sqlite3_errmsg (sqlite));
+		      break;
+		  }
+		*count += 1;
+	    }
+	  knn_join_free_chunk (chunk);
+      }
+
+  end:
+    for (i = 0; i < n_workers; i++)
+	pthread_join (workers[i], NULL);
+    while (join->first != NULL)
+      {
+	  struct knn_join_chunk *chunk = join->first;
+	  join->first = chunk->next;
+	  knn_join_free_chunk (chunk);
+      }
+    if (join->error != NULL)
+	ok = 0;
+    pthread_cond_destroy (&(join->produced));
+    pthread_cond_destroy (&(join->consumed));
+    pthread_mutex_destroy (&(join->mutex));
+    return ok;
+}
+
+#endif /* end POSIX threads */
+
+SPATIALITE_DECLARE int
+gaia_knn_join (sqlite3 * sqlite, const void *cache, const char *point_table,
+	       const char *point_geom, const char *target_table,
+	       const char *target_geom, int k, const char *out_table,
+	       int threads, sqlite3_int64 * count)
+{
+/* attempting to find the K nearest Features for every reference Geometry */
+    struct knn_join join;
+    char *sql;
+    char *xtable;
+    char *errMsg = NULL;
+    sqlite3_stmt *stmt_out = NULL;
+    const char *db_path;
+    int in_transaction = 0;
+    int ret;
+    int ok;
+
+    *count = 0;
+    if (sqlite == NULL || cache == NULL)
+	return 0;
+    knn_join_set_error (cache, NULL);
+    if (point_table == NULL || point_geom == NULL || target_table == NULL
+	|| target_geom == NULL || out_table == NULL)
+      {
+	  knn_join_set_error (cache, "NULL argument");
+	  return 0;
+      }
+    if (k < 1 || k > VKNN_MAX_ITEMS)
+      {
+	  knn_join_set_error (cache, "K must be between 1 and 10000");
+	  return 0;
+      }
+
+    memset (&join, 0, sizeof (struct knn_join));
+    join.point_table = point_table;
+    join.point_geom = point_geom;
+    join.k = k;
+
+/* checking both Geometry Columns and the output table */
+    if (!knn_join_check_geometry (sqlite, point_table, point_geom))
+      {
+	  knn_join_set_error (cache, "Point Geometry Column does not exist");
+	  return 0;
+      }
+    if (!vknn_check_rtree
+	(sqlite, NULL, target_table, target_geom, &(join.target_table),
+	 &(join.target_geom), &(join.is_geographic)))
+      {
+	  knn_join_set_error (cache,
+			      "Target Geometry Column does not exist or has no R*Tree Spatial Index");
+	  return 0;
+      }
+    if (!knn_join_check_out_table (sqlite, out_table))
+      {
+	  knn_join_set_error (cache, "the output table already exists");
+	  goto error;
+      }
+
+    if (threads < 1)
+      {
+#ifndef _WIN32
+	  long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+	  threads = (cpus > 0) ? (int) cpus : 1;
+#else
+	  threads = 1;
+#endif
+      }
+    if (threads > KNN_JOIN_MAX_THREADS)
+	threads = KNN_JOIN_MAX_THREADS;
+
+/* worker connections can only share a file-based DB */
+    db_path = sqlite3_db_filename (sqlite, "main");
+    if (db_path == NULL || *db_path == '\0')
+	threads = 1;
+/*
+/ worker connections only see committed data, so that any uncommitted
+/ change made by a pending transaction would be silently ignored
+*/
+    if (!sqlite3_get_autocommit (sqlite))
+	threads = 1;
+    join.db_path = db_path;
+
+    if (!knn_join_sort_points (sqlite, &join))
+      {
+	  knn_join_set_error (cache, "unable to load the Point table");
+	  goto error;
+      }
+    if ((join.n_points + KNN_JOIN_BLOCK_POINTS - 1) / KNN_JOIN_BLOCK_POINTS <
+	threads)
+	threads =
+	    (join.n_points + KNN_JOIN_BLOCK_POINTS - 1) / KNN_JOIN_BLOCK_POINTS;
+
+/* creating the output table */
+    if (sqlite3_get_autocommit (sqlite))
+      {
+	  ret = sqlite3_exec (sqlite, "BEGIN", NULL, NULL, &errMsg);
+	  if (ret != SQLITE_OK)
+	    {
+		knn_join_set_error (cache, errMsg);
+		sqlite3_free (errMsg);
+		goto error;
+	    }
+	  in_transaction = 1;
+      }
+    xtable = gaiaDoubleQuotedSql (out_table);
+    sql =
+	sqlite3_mprintf ("CREATE TABLE main.\"%s\" (\n"
+			 "point_rowid INTEGER NOT NULL,\n"
+			 "pos INTEGER NOT NULL,\n"
+			 "target_rowid INTEGER NOT NULL,\n"
+			 "distance DOUBLE)", xtable);
+    ret = sqlite3_exec (sqlite, sql, NULL, NULL, &errMsg);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  free (xtable);
+	  knn_join_set_error (cache, errMsg);
+	  sqlite3_free (errMsg);
+	  goto error;
+      }
+    sql =
+	sqlite3_mprintf
+	("INSERT INTO main.\"%s\" (point_rowid, pos, target_rowid, distance) "
+	 "VALUES (?, ?, ?, ?)", xtable);
+    free (xtable);
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt_out, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  knn_join_set_error (cache, sqlite3_errmsg (sqlite));
+	  goto error;
+      }
+
+#ifndef _WIN32
+    if (threads > 1)
+      {
+	  /*
+	     / while the workers hold their SHARED locks any attempt by the
+	     / writer to spill dirty pages into the DB (which requires an
+	     / EXCLUSIVE lock) is bound to fail; it must fail immediately
+	     / instead of stalling until the busy-timeout expires
+	   */
+	  int timeout = knn_join_get_busy_timeout (sqlite);
+	  sqlite3_busy_timeout (sqlite, 0);
+	  ok = knn_join_parallel (sqlite, &join, threads, stmt_out, count);
+	  sqlite3_busy_timeout (sqlite, timeout);
+      }
+    else
+#endif
+	ok = knn_join_serial (sqlite, &join, stmt_out, count);
+    sqlite3_finalize (stmt_out);
+    stmt_out = NULL;
+    if (!ok)
+      {
+	  knn_join_set_error (cache, join.error);
+	  goto error;
+      }
+
+    if (in_transaction)
+      {
+	  ret = sqlite3_exec (sqlite, "COMMIT", NULL, NULL, &errMsg);
+	  if (ret != SQLITE_OK)
+	    {
+		knn_join_set_error (cache, errMsg);
+		sqlite3_free (errMsg);
+		goto error;
+	    }
+      }
+    sqlite3_free (join.error);
+    free (join.target_table);
+    free (join.target_geom);
+    if (join.points != NULL)
+	free (join.points);
+    return 1;
+
+  error:
+    if (stmt_out != NULL)
+	sqlite3_finalize (stmt_out);
+    if (in_transaction)
+	sqlite3_exec (sqlite, "ROLLBACK", NULL, NULL, NULL);
+    sqlite3_free (join.error);
+    free (join.target_table);
+    free (join.target_geom);
+    if (join.points != NULL)
+	free (join.points);
+    *count = 0;
+    return 0;
+}
+
 static int
 spliteKnnInit (sqlite3 * db)
 {
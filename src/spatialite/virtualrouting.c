@@ -60,6 +60,14 @@ the terms of any one of the MPL, the GPL or the LGPL.
 
 #ifndef OMIT_GEOS		/* GEOS is supported */
 
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+
 #include <spatialite/sqlite.h>
 
 #include <spatialite.h>
@@ -71,12 +79,15 @@ static struct sqlite3_module my_route_module;
 
 #define VROUTE_DIJKSTRA_ALGORITHM	1
 #define VROUTE_A_STAR_ALGORITHM	2
+#define VROUTE_CH_ALGORITHM	3
 
 #define VROUTE_ROUTING_SOLUTION		0xdd
 #define VROUTE_POINT2POINT_SOLUTION	0xcc
 #define VROUTE_POINT2POINT_ERROR	0xca
 #define VROUTE_RANGE_SOLUTION		0xbb
 #define VROUTE_TSP_SOLUTION			0xee
+#define VROUTE_MATRIX_SOLUTION		0xab
+#define VROUTE_ISOCHRONE_SOLUTION	0xac
 
 #define VROUTE_SHORTEST_PATH_FULL		0x70
 #define VROUTE_SHORTEST_PATH_NO_LINKS	0x71
@@ -87,10 +98,25 @@ static struct sqlite3_module my_route_module;
 #define VROUTE_SHORTEST_PATH			0x91
 #define VROUTE_TSP_NN					0x92
 #define VROUTE_TSP_GA					0x93
+#define VROUTE_COST_MATRIX				0x94
+#define VROUTE_ISOCHRONES				0x95
 
 #define VROUTE_INVALID_SRID	-1234
 
 #define	VROUTE_TSP_GA_MAX_ITERATIONS	512
+#define	VROUTE_TSP_GA_EPOCH		64
+#define	VROUTE_TSP_GA_MAX_ISLANDS	8
+#define	VROUTE_TSP_GA_MIN_CITIES	16
+#define	VROUTE_TSP_MAX_PASSES		64
+
+#define VROUTE_MATRIX_MAX_THREADS	16
+#define VROUTE_MATRIX_MIN_ORIGINS	4
+
+#define VROUTE_ISOCHRONE_MAX_BANDS	64
+
+#define VROUTE_SIDECAR_MAGIC	"SPLROUT1"
+#define VROUTE_SIDECAR_ENDIAN	0x01020304
+#define VROUTE_SIDECAR_ALIGN(x)	((((size_t)(x)) + 7) & ~((size_t) 7))
 
 #define VROUTE_POINT2POINT_FROM	1
 #define VROUTE_POINT2POINT_TO	2
@@ -137,29 +163,135 @@ typedef DestinationCandidatesList *DestinationCandidatesListPtr;
 /
 ******************************************************************************/
 
+/*
+/ both Links and Nodes contain no pointers at all, so that the
+/ whole graph can be directly mapped from a sidecar file
+*/
+
 typedef struct RouteLinkStruct
 {
 /* a LINK */
-    const struct RouteNodeStruct *NodeFrom;
-    const struct RouteNodeStruct *NodeTo;
     sqlite3_int64 LinkRowid;
     double Cost;
+    int NodeFrom;		/* internal index of the From Node */
+    int NodeTo;			/* internal index of the To Node */
 } RouteLink;
 typedef RouteLink *RouteLinkPtr;
 
 typedef struct RouteNodeStruct
 {
 /* a NODE */
-    int InternalIndex;
     sqlite3_int64 Id;
-    char *Code;
     double CoordX;
     double CoordY;
-    int NumLinks;
-    RouteLinkPtr Links;
+    int InternalIndex;
+    int CodeOffset;		/* position into the Codes table; -1 if none */
 } RouteNode;
 typedef RouteNode *RouteNodePtr;
 
+typedef struct RoutingSidecarHeaderStruct
+{
+/*
+/ the header of a sidecar file storing a routing graph; it's followed
+/ by the Nodes, LinkOffsets, Links and Codes arrays (8-bytes aligned)
+*/
+    char Magic[8];
+    unsigned int Endian;
+    int NodeSize;
+    int LinkSize;
+    int NumNodes;
+    int NumLinks;
+    int CodesSize;
+    sqlite3_int64 DataHash;	/* FNV-1a hash of all Network Blocks */
+} RoutingSidecarHeader;
+typedef RoutingSidecarHeader *RoutingSidecarHeaderPtr;
+
+typedef struct RouteChEdgeStruct
+{
+/* a Contraction Hierarchies upward EDGE */
+    int NodeIndex;		/* the other Node */
+    int MiddleIndex;		/* the contracted Node; -1 for an original Link */
+    RouteLinkPtr Link;		/* the original Link (if any) */
+    double Cost;
+} RouteChEdge;
+typedef RouteChEdge *RouteChEdgePtr;
+
+typedef struct RouteChNodeStruct
+{
+/* a Contraction Hierarchies NODE */
+    int Rank;
+    int NumForward;
+    RouteChEdgePtr Forward;	/* upward outcoming edges */
+    int NumBackward;
+    RouteChEdgePtr Backward;	/* upward incoming edges */
+} RouteChNode;
+typedef RouteChNode *RouteChNodePtr;
+
+typedef struct RouteTurnStruct
+{
+/* a TURN from some incoming Link into an outcoming Link */
+    int LinkTo;			/* the outcoming Link (index into Links) */
+    double Cost;		/* the Turn penalty; < 0.0 forbidden */
+} RouteTurn;
+typedef RouteTurn *RouteTurnPtr;
+
+typedef struct RouteProfilePointStruct
+{
+/* a breakpoint of a Time Dependent (piecewise linear) profile */
+    double Time;		/* seconds since midnight */
+    double Cost;		/* travel time when entering the Link at Time */
+} RouteProfilePoint;
+typedef RouteProfilePoint *RouteProfilePointPtr;
+
+typedef struct RouteLinkProfileStruct
+{
+/* the Time Dependent profile of some Link */
+    int First;			/* the first breakpoint */
+    int Count;			/* # breakpoints; 0 for a static Link */
+} RouteLinkProfile;
+typedef RouteLinkProfile *RouteLinkProfilePtr;
+
+typedef struct RouteTurnRawStruct
+{
+/* a TURN as stored into the Routing Data table */
+    sqlite3_int64 FromRowid;
+    sqlite3_int64 ToRowid;
+    double Cost;
+} RouteTurnRaw;
+typedef RouteTurnRaw *RouteTurnRawPtr;
+
+typedef struct RouteProfileRawStruct
+{
+/* a Time Dependent profile as stored into the Routing Data table */
+    sqlite3_int64 Rowid;
+    int First;
+    int Count;
+} RouteProfileRaw;
+typedef RouteProfileRaw *RouteProfileRawPtr;
+
+typedef struct RouteExtrasStruct
+{
+/* Turns and Time Dependent profiles, still to be resolved into Links */
+    int NumTurns;
+    int MaxTurns;
+    RouteTurnRawPtr Turns;
+    int NumProfiles;
+    int MaxProfiles;
+    RouteProfileRawPtr Profiles;
+    int NumPoints;
+    int MaxPoints;
+    RouteProfilePointPtr Points;
+} RouteExtras;
+typedef RouteExtras *RouteExtrasPtr;
+
+typedef struct RouteLinkRowidStruct
+{
+/* helper struct: searching Links by ROWID */
+    sqlite3_int64 Rowid;
+    int Index;
+} RouteLinkRowid;
+typedef RouteLinkRowid *RouteLinkRowidPtr;
+
 typedef struct RoutingStruct
 {
 /* the main NETWORK structure */
@@ -179,6 +311,38 @@ typedef struct RoutingStruct
     int HasZ;
     int Srid;
     RouteNodePtr Nodes;
+/*
+/ Links are stored in CSR form: the outcoming Links of the Nth Node
+/ are Links[LinkOffsets[N]] ... Links[LinkOffsets[N + 1] - 1]
+*/
+    int NumLinks;
+    int MaxLinks;
+    int *LinkOffsets;
+    RouteLinkPtr Links;
+/* all Node Codes, NULL-terminated, are interned into a single table */
+    int CodesSize;
+    int MaxCodes;
+    char *Codes;
+/* the memory mapped sidecar file (if any) holding all the arrays */
+    unsigned char *Mapping;
+    size_t MappingSize;
+    RouteChNodePtr ChNodes;	/* Contraction Hierarchies; NULL if unsupported */
+/*
+/ Turns are stored in CSR form: the Turns starting from the Nth Link
+/ are Turns[TurnOffsets[N]] ... Turns[TurnOffsets[N + 1] - 1]
+/ (NULL if no Turn is defined)
+*/
+    int NumTurns;
+    int *TurnOffsets;
+    RouteTurnPtr Turns;
+/* Time Dependent profiles, indexed by Link (NULL if undefined) */
+    int NumProfilePoints;
+    RouteProfilePointPtr ProfilePoints;
+    RouteLinkProfilePtr LinkProfiles;
+    double ProfileMinRatio;	/* lowest profile/ordinary Cost ratio (A*) */
+/* incremental updates (see CreateRouting_UpdateLinks) */
+    sqlite3_int64 Generation;	/* the Generation currently loaded */
+    sqlite3_int64 LastBlockId;	/* the Id of the last ordinary Block */
 } Routing;
 typedef Routing *RoutingPtr;
 
@@ -204,6 +368,7 @@ typedef struct RowSolutionStruct
 {
 /* a row into the shortest path solution */
     RouteLinkPtr Link;
+    double Cost;		/* the actual Cost (Time Dependent / Turns) */
     char *Name;
     struct RowSolutionStruct *Next;
 
@@ -274,6 +439,15 @@ typedef struct RoutingMultiDestStruct
 } RoutingMultiDest;
 typedef RoutingMultiDest *RoutingMultiDestPtr;
 
+typedef struct IsochroneBandStruct
+{
+/* a band of the Isochrones solution */
+    double Cost;		/* the Cost threshold */
+    unsigned char *Blob;	/* the polygon (BLOB-Geometry); NULL if none */
+    int Size;
+} IsochroneBand;
+typedef IsochroneBand *IsochroneBandPtr;
+
 typedef struct MultiSolutionStruct
 {
 /* multiple shortest path solutions */
@@ -281,6 +455,10 @@ typedef struct MultiSolutionStruct
     RouteNodePtr From;
     double MaxCost;
     RoutingMultiDestPtr MultiTo;
+    RoutingMultiDestPtr MultiFrom;	/* Cost Matrix origins */
+    double *Matrix;		/* Cost Matrix: Origins x Destinations; <0 unreachable */
+    int NumBands;		/* Isochrones: # bands */
+    IsochroneBandPtr Bands;	/* Isochrones: sorted by increasing Cost */
     ResultsetRowPtr FirstRow;
     ResultsetRowPtr LastRow;
     ResultsetRowPtr CurrentRow;
@@ -380,24 +558,6 @@ typedef struct TspTargetsStruct
 } TspTargets;
 typedef TspTargets *TspTargetsPtr;
 
-typedef struct TspGaSubDistanceStruct
-{
-/* a cache sub-item for storing TSP GA costs */
-    RouteNodePtr CityTo;
-    double Cost;
-} TspGaSubDistance;
-typedef TspGaSubDistance *TspGaSubDistancePtr;
-
-typedef struct TspGaDistanceStruct
-{
-/* a cache item for storing TSP GA costs */
-    RouteNodePtr CityFrom;
-    int Cities;
-    TspGaSubDistancePtr *Distances;
-    int NearestIndex;
-} TspGaDistance;
-typedef TspGaDistance *TspGaDistancePtr;
-
 typedef struct TspGaSolutionStruct
 {
 /* TSP GA solution struct */
@@ -414,14 +574,28 @@ typedef struct TspGaPopulationStruct
 /* TSP GA helper struct */
     int Count;
     int Cities;
-    TspGaSolutionPtr *Solutions;
-    TspGaSolutionPtr *Offsprings;
-    TspGaDistancePtr *Distances;
-    char *RandomSolutionsSql;
-    char *RandomIntervalSql;
+    RouteNodePtr *Nodes;	/* City #0 is the origin */
+    double *Matrix;		/* dense City-to-City Costs */
 } TspGaPopulation;
 typedef TspGaPopulation *TspGaPopulationPtr;
 
+typedef struct TspGaIslandStruct
+{
+/* a TSP GA island: a Population evolving on its own thread */
+    TspGaPopulationPtr ga;	/* shared and read-only */
+    int Count;
+    int *Tours;			/* Count Tours, each one of Cities items */
+    double *Costs;
+    int *Work;			/* parents, hybrid and scratch buffers */
+    char *Present;
+    double *Fwd;		/* cumulated Costs (local search) */
+    double *Rev;
+    sqlite3_uint64 Random;	/* PRNG state */
+    int Generations;
+    int Counter;
+} TspGaIsland;
+typedef TspGaIsland *TspGaIslandPtr;
+
 /******************************************************************************
 /
 / Dijkstra and A* common structs
@@ -440,32 +614,149 @@ typedef struct RoutingNode
     double Distance;
     double HeuristicDistance;
     int Inspected;
+    unsigned int Stamp;		/* the search this Node was last reset for */
 } RoutingNode;
 typedef RoutingNode *RoutingNodePtr;
 
+typedef struct HeapNode
+{
+    RoutingNodePtr Node;
+    double Distance;
+} HeapNode;
+typedef HeapNode *HeapNodePtr;
+
+typedef struct RoutingHeapStruct
+{
+    HeapNodePtr Nodes;
+    int Count;
+} RoutingHeap;
+typedef RoutingHeap *RoutingHeapPtr;
+
+typedef struct TdSearchLinkStruct
+{
+/* the status of a Link within an edge-based search */
+    unsigned int Stamp;
+    int Inspected;
+    int PreviousLink;		/* -1 when leaving the origin */
+    double Distance;		/* the Cost required to reach the Link's end */
+} TdSearchLink;
+typedef TdSearchLink *TdSearchLinkPtr;
+
+typedef struct TdHeapItemStruct
+{
+    int Link;
+    double Distance;
+} TdHeapItem;
+typedef TdHeapItem *TdHeapItemPtr;
+
+typedef struct TdSearchStruct
+{
+/* buffers supporting the edge-based (Turns / Time Dependent) search */
+    int Dim;
+    unsigned int Stamp;
+    TdSearchLinkPtr Links;
+    TdHeapItemPtr Heap;
+    int Count;
+    int Max;
+} TdSearch;
+typedef TdSearch *TdSearchPtr;
+
 typedef struct RoutingNodes
 {
+/*
+/ the search scratch area; it's kept by the Virtual Table and reused
+/ by every query, so that each search will only reset the Nodes
+/ it actually reaches (a Node is valid if its Stamp matches)
+*/
     RoutingNodePtr Nodes;
     RouteLinkPtr *LinksBuffer;
     RoutingNodePtr *NodesBuffer;
     int Dim;
     int DimLink;
+    unsigned int Stamp;		/* the current search */
+    RoutingHeapPtr Heap;
+    TdSearchPtr Td;		/* NULL if there are neither Turns nor Profiles */
+    double Departure;		/* seconds since midnight; < 0.0 if unset */
 } RoutingNodes;
 typedef RoutingNodes *RoutingNodesPtr;
 
-typedef struct HeapNode
+/******************************************************************************
+/
+/ Contraction Hierarchies structs
+/
+******************************************************************************/
+
+typedef struct ChSearchNodeStruct
 {
-    RoutingNodePtr Node;
+/* forward [0] and backward [1] search status of a Node */
+    unsigned int Stamp[2];
+    double Distance[2];
+    int PreviousNode[2];
+    RouteChEdgePtr Edge[2];
+} ChSearchNode;
+typedef ChSearchNode *ChSearchNodePtr;
+
+typedef struct ChHeapItemStruct
+{
+    int Node;
     double Distance;
-} HeapNode;
-typedef HeapNode *HeapNodePtr;
+} ChHeapItem;
+typedef ChHeapItem *ChHeapItemPtr;
 
-typedef struct RoutingHeapStruct
+typedef struct ChSearchStruct
 {
-    HeapNodePtr Nodes;
-    int Count;
-} RoutingHeap;
-typedef RoutingHeap *RoutingHeapPtr;
+/* buffers supporting the bidirectional Contraction Hierarchies search */
+    int Dim;
+    unsigned int Stamp;
+    ChSearchNodePtr Nodes;
+    ChHeapItemPtr Heap[2];
+    int Count[2];
+    int Max[2];
+} ChSearch;
+typedef ChSearch *ChSearchPtr;
+
+/******************************************************************************
+/
+/ Cost Matrix structs
+/
+******************************************************************************/
+
+typedef struct MatrixWorkerStruct
+{
+/* a Cost Matrix worker: each one owns its own search buffers */
+    RoutingPtr graph;
+    RoutingMultiDestPtr MultiFrom;
+    RoutingMultiDestPtr MultiTo;
+    double *Matrix;
+    int First;			/* the first Origin assigned to this worker */
+    int Step;			/* evaluating every Nth Origin */
+    int Error;
+} MatrixWorker;
+typedef MatrixWorker *MatrixWorkerPtr;
+
+/******************************************************************************
+/
+/ Isochrones structs
+/
+******************************************************************************/
+
+typedef struct IsochroneLinkStruct
+{
+/* a Link reached by the Isochrones search */
+    RouteLinkPtr Link;
+    double Start;		/* the Cost at the From Node */
+} IsochroneLink;
+typedef IsochroneLink *IsochroneLinkPtr;
+
+typedef struct IsochroneGeomStruct
+{
+/* the Geometry of a reached Link, as stored into the input table */
+    sqlite3_int64 Rowid;
+    sqlite3_int64 FromId;
+    char *FromCode;
+    gaiaGeomCollPtr Geometry;
+} IsochroneGeom;
+typedef IsochroneGeom *IsochroneGeomPtr;
 
 /******************************************************************************
 /
@@ -480,8 +771,11 @@ typedef struct virtualroutingStruct
     int nRef;			/* # references: USED INTERNALLY BY SQLITE */
     char *zErrMsg;		/* error message: USE INTERNALLY BY SQLITE */
     sqlite3 *db;		/* the sqlite db holding the virtual table */
+    char *dataTable;		/* the Routing Data table */
+    char *sidecarPath;		/* the sidecar file path (if any) */
     RoutingPtr graph;		/* the NETWORK structure */
     RoutingNodesPtr routing;	/* the ROUTING structure */
+    ChSearchPtr chSearch;	/* the Contraction Hierarchies search buffers */
     int currentAlgorithm;	/* the currently selected Shortest Path Algorithm */
     int currentRequest;		/* the currently selected Shortest Path Request */
     int currentOptions;		/* the currently selected Shortest Path Options */
@@ -500,6 +794,38 @@ typedef struct virtualroutingCursortStruct
 } virtualroutingCursor;
 typedef virtualroutingCursor *virtualroutingCursorPtr;
 
+static const char *
+route_node_code (RoutingPtr graph, const RouteNode * node)
+{
+/* returning the Code of some Node */
+    if (node->CodeOffset < 0)
+	return NULL;
+    return graph->Codes + node->CodeOffset;
+}
+
+static RouteNodePtr
+route_link_from (RoutingPtr graph, const RouteLink * link)
+{
+/* returning the From Node of some Link */
+    return graph->Nodes + link->NodeFrom;
+}
+
+static RouteNodePtr
+route_link_to (RoutingPtr graph, const RouteLink * link)
+{
+/* returning the To Node of some Link */
+    return graph->Nodes + link->NodeTo;
+}
+
+static RouteLinkPtr
+route_node_links (RoutingPtr graph, const RouteNode * node, int *count)
+{
+/* returning the outcoming Links of some Node */
+    int first = graph->LinkOffsets[node->InternalIndex];
+    *count = graph->LinkOffsets[node->InternalIndex + 1] - first;
+    return graph->Links + first;
+}
+
 /*
 /
 /  implementation of the Dijkstra Shortest Path algorithm
@@ -511,6 +837,34 @@ typedef virtualroutingCursor *virtualroutingCursorPtr;
 /
 */
 
+static RoutingHeapPtr
+routing_heap_init (int n)
+{
+/* allocating and initializing the Heap (min-priority queue) */
+    RoutingHeapPtr heap = malloc (sizeof (RoutingHeap));
+    heap->Count = 0;
+    heap->Nodes = malloc (sizeof (HeapNode) * (n + 1));
+    return heap;
+}
+
+static void
+routing_heap_reset (RoutingHeapPtr heap)
+{
+/* resetting the Heap (min-priority queue) */
+    if (heap == NULL)
+	return;
+    heap->Count = 0;
+}
+
+static void
+routing_heap_free (RoutingHeapPtr heap)
+{
+/* freeing the Heap (min-priority queue) */
+    if (heap->Nodes != NULL)
+	free (heap->Nodes);
+    free (heap);
+}
+
 static RoutingNodesPtr
 routing_init (RoutingPtr graph)
 {
@@ -521,6 +875,8 @@ routing_init (RoutingPtr graph)
     RoutingNodesPtr nd;
     RoutingNodePtr ndn;
     RouteNodePtr nn;
+    RouteLinkPtr links;
+    int num_links;
 /* allocating the main Nodes struct */
     nd = malloc (sizeof (RoutingNodes));
 /* allocating and initializing  Nodes array */
@@ -528,7 +884,7 @@ routing_init (RoutingPtr graph)
     nd->Dim = graph->NumNodes;
     nd->DimLink = 0;
 /* pre-alloc buffer strategy - GENSCHER 2010-01-05 */
-    for (i = 0; i < graph->NumNodes; cnt += graph->Nodes[i].NumLinks, i++);
+    cnt = graph->NumLinks;
     nd->NodesBuffer = malloc (sizeof (RoutingNodePtr) * cnt);
     nd->LinksBuffer = malloc (sizeof (RouteLinkPtr) * cnt);
 
@@ -537,22 +893,28 @@ routing_init (RoutingPtr graph)
       {
 	  /* initializing the Nodes array */
 	  nn = graph->Nodes + i;
+	  links = route_node_links (graph, nn, &num_links);
 	  ndn = nd->Nodes + i;
 	  ndn->Id = nn->InternalIndex;
-	  ndn->DimTo = nn->NumLinks;
+	  ndn->Stamp = 0;
+	  ndn->DimTo = num_links;
 	  ndn->Node = nn;
 	  ndn->To = &(nd->NodesBuffer[cnt]);
 	  ndn->Link = &(nd->LinksBuffer[cnt]);
-	  cnt += nn->NumLinks;
+	  cnt += num_links;
 
-	  for (j = 0; j < nn->NumLinks; j++)
+	  for (j = 0; j < num_links; j++)
 	    {
 		/*  setting the outcoming Links for the current Node */
 		nd->DimLink++;
-		ndn->To[j] = nd->Nodes + nn->Links[j].NodeTo->InternalIndex;
-		ndn->Link[j] = nn->Links + j;
+		ndn->To[j] = nd->Nodes + links[j].NodeTo;
+		ndn->Link[j] = links + j;
 	    }
       }
+    nd->Stamp = 0;
+    nd->Heap = routing_heap_init (graph->NumNodes);
+    nd->Td = NULL;
+    nd->Departure = -1.0;
     return (nd);
 }
 
@@ -560,6 +922,7 @@ static void
 routing_free (RoutingNodes * e)
 {
 /* memory cleanup; freeing the ROUTING struct */
+    routing_heap_free (e->Heap);
     free (e->LinksBuffer);
     free (e->NodesBuffer);
     free (e->Nodes);
@@ -567,31 +930,38 @@ routing_free (RoutingNodes * e)
 }
 
 static RoutingHeapPtr
-routing_heap_init (int n)
-{
-/* allocating and initializing the Heap (min-priority queue) */
-    RoutingHeapPtr heap = malloc (sizeof (RoutingHeap));
-    heap->Count = 0;
-    heap->Nodes = malloc (sizeof (HeapNode) * (n + 1));
-    return heap;
-}
-
-static void
-routing_heap_reset (RoutingHeapPtr heap)
+routing_begin (RoutingNodesPtr e)
 {
-/* resetting the Heap (min-priority queue) */
-    if (heap == NULL)
-	return;
-    heap->Count = 0;
+/* 
+/ starting a new search: all Nodes become implicitly invalid
+/ (a full reset is only required when the Stamp wraps around)
+*/
+    e->Stamp++;
+    if (e->Stamp == 0)
+      {
+	  int i;
+	  for (i = 0; i < e->Dim; i++)
+	      e->Nodes[i].Stamp = 0;
+	  e->Stamp = 1;
+      }
+    routing_heap_reset (e->Heap);
+    return e->Heap;
 }
 
-static void
-routing_heap_free (RoutingHeapPtr heap)
+static RoutingNodePtr
+routing_node (RoutingNodesPtr e, RoutingNodePtr n)
 {
-/* freeing the Heap (min-priority queue) */
-    if (heap->Nodes != NULL)
-	free (heap->Nodes);
-    free (heap);
+/* lazily resetting a Node the first time the current search reaches it */
+    if (n->Stamp != e->Stamp)
+      {
+	  n->PreviousNode = NULL;
+	  n->xLink = NULL;
+	  n->Inspected = 0;
+	  n->Distance = DBL_MAX;
+	  n->HeuristicDistance = DBL_MAX;
+	  n->Stamp = e->Stamp;
+      }
+    return n;
 }
 
 static void
@@ -753,6 +1123,7 @@ add_link_to_solution (ShortestPathSolutionPtr solution, RouteLinkPtr link)
 /* inserts a Link into the Shortest Path solution */
     RowSolutionPtr p = malloc (sizeof (RowSolution));
     p->Link = link;
+    p->Cost = link->Cost;
     p->Name = NULL;
     p->Next = NULL;
     solution->TotalCost += link->Cost;
@@ -1019,7 +1390,7 @@ findLinkCost (sqlite3_int64 linkRowid, ShortestPathSolutionPtr solution)
 	  if (row->Link != NULL)
 	    {
 		if (row->Link->LinkRowid == linkRowid)
-		    return row->Link->Cost;
+		    return row->Cost;
 	    }
 	  row = row->Next;
       }
@@ -1348,7 +1719,8 @@ build_solution (sqlite3 * handle, int options, RoutingPtr graph,
 			      {
 				  /* nodes are identified by TEXT codes */
 				  if (strcmp
-				      (pR->Link->NodeFrom->Code,
+				      (route_node_code
+				       (graph, route_link_from (graph, pR->Link)),
 				       pA->ToCode) == 0)
 				      reverse = 1;
 				  else
@@ -1357,7 +1729,8 @@ build_solution (sqlite3 * handle, int options, RoutingPtr graph,
 			    else
 			      {
 				  /* nodes are identified by INTEGER ids */
-				  if (pR->Link->NodeFrom->Id == pA->ToId)
+				  if (route_link_from (graph, pR->Link)->Id ==
+				      pA->ToId)
 				      reverse = 1;
 				  else
 				      reverse = 0;
@@ -1786,44 +2159,39 @@ build_tsp_solution (MultiSolutionPtr multiSolution, TspTargetsPtr targets,
 	  return;
       }
 
-    /* reordering the TSP solution */
-    oldS = targets->Solutions;
-    targets->Solutions =
-	malloc (sizeof (ShortestPathSolutionPtr) * targets->Count);
+    /* reordering the TSP solution (each route is used just once) */
+    oldS = malloc (sizeof (ShortestPathSolutionPtr) * (targets->Count + 1));
+    for (i = 0; i < targets->Count; i++)
+	*(oldS + i) = *(targets->Solutions + i);
+    *(oldS + targets->Count) = targets->LastSolution;
     from = multiSolution->From;
     for (k = 0; k < targets->Count; k++)
       {
 	  /* building the right sequence */
-	  found = 0;
-	  for (i = 0; i < targets->Count; i++)
+	  found = -1;
+	  for (i = 0; i <= targets->Count; i++)
 	    {
 		pS = *(oldS + i);
+		if (pS == NULL)
+		    continue;
+		if (found < 0)
+		    found = i;
 		if (pS->From == from)
 		  {
-		      *(targets->Solutions + k) = pS;
-		      from = pS->To;
-		      found = 1;
+		      found = i;
 		      break;
 		  }
 	    }
-	  if (!found)
-	    {
-		if (targets->LastSolution->From == from)
-		  {
-		      *(targets->Solutions + k) = targets->LastSolution;
-		      from = targets->LastSolution->To;
-		  }
-	    }
+	  pS = *(oldS + found);
+	  *(targets->Solutions + k) = pS;
+	  *(oldS + found) = NULL;
+	  from = pS->To;
       }
     /* adjusting the last route so to close a circular path */
-    for (i = 0; i < targets->Count; i++)
+    for (i = 0; i <= targets->Count; i++)
       {
-	  pS = *(oldS + i);
-	  if (pS->From == from)
-	    {
-		targets->LastSolution = pS;
-		break;
-	    }
+	  if (*(oldS + i) != NULL)
+	      targets->LastSolution = *(oldS + i);
       }
     free (oldS);
     row->Geometry = aux_build_tsp (multiSolution, targets, route_num, srid);
@@ -2022,20 +2390,12 @@ dijkstra_multi_shortest_path (sqlite3 * handle, int options, RoutingPtr graph,
     RoutingHeapPtr heap;
 /* setting From */
     from = multiSolution->From->InternalIndex;
-/* initializing the heap */
-    heap = routing_heap_init (e->DimLink);
-/* initializing the graph */
-    for (i = 0; i < e->Dim; i++)
-      {
-	  n = e->Nodes + i;
-	  n->PreviousNode = NULL;
-	  n->xLink = NULL;
-	  n->Inspected = 0;
-	  n->Distance = DBL_MAX;
-      }
+/* starting a new search (lazily resetting the graph and the heap) */
+    heap = routing_begin (e);
 /* queuing the From node into the heap */
-    e->Nodes[from].Distance = 0.0;
-    dijkstra_enqueue (heap, e->Nodes + from);
+    n = routing_node (e, e->Nodes + from);
+    n->Distance = 0.0;
+    dijkstra_enqueue (heap, n);
     while (heap->Count > 0)
       {
 	  /* Dijsktra loop */
@@ -2077,7 +2437,7 @@ dijkstra_multi_shortest_path (sqlite3 * handle, int options, RoutingPtr graph,
 	  n->Inspected = 1;
 	  for (i = 0; i < n->DimTo; i++)
 	    {
-		p_to = *(n->To + i);
+		p_to = routing_node (e, *(n->To + i));
 		p_link = *(n->Link + i);
 		if (p_to->Inspected == 0)
 		  {
@@ -2099,160 +2459,39 @@ dijkstra_multi_shortest_path (sqlite3 * handle, int options, RoutingPtr graph,
 		  }
 	    }
       }
-    routing_heap_free (heap);
 }
 
-static RouteNodePtr
-check_targets (RoutingNodePtr node, TspTargetsPtr targets)
+static void
+destroy_tsp_targets (TspTargetsPtr targets)
 {
-/* testing targets */
-    int i;
-    for (i = 0; i < targets->Count; i++)
+/* memory cleanup; destroying a TSP helper struct */
+    if (targets == NULL)
+	return;
+    if (targets->To != NULL)
+	free (targets->To);
+    if (targets->Found != NULL)
+	free (targets->Found);
+    if (targets->Costs != NULL)
+	free (targets->Costs);
+    if (targets->Solutions != NULL)
       {
-	  RouteNodePtr to = *(targets->To + i);
-	  if (to == NULL)
-	      continue;
-	  if (*(targets->Found + i) == 'Y')
-	      continue;
-	  if (node->Id == to->InternalIndex)
+	  int i;
+	  for (i = 0; i < targets->Count; i++)
 	    {
-		*(targets->Found + i) = 'Y';
-		return to;
+		ShortestPathSolutionPtr pS = *(targets->Solutions + i);
+		if (pS != NULL)
+		    delete_solution (pS);
 	    }
+	  free (targets->Solutions);
       }
-    return NULL;
+    if (targets->LastSolution != NULL)
+	delete_solution (targets->LastSolution);
+    free (targets);
 }
 
-static void
-update_targets (TspTargetsPtr targets, RouteNodePtr destination, double cost,
-		int *stop)
-{
-/* tupdating targets */
-    int i;
-    *stop = 1;
-    for (i = 0; i < targets->Count; i++)
-      {
-	  RouteNodePtr to = *(targets->To + i);
-	  if (to == NULL)
-	      continue;
-	  if (to == destination)
-	      *(targets->Costs + i) = cost;
-	  if (*(targets->Found + i) == 'Y')
-	      continue;
-	  *stop = 0;
-      }
-}
-
-
-static void
-dijkstra_targets_solve (RoutingNodesPtr e, TspTargetsPtr targets)
-{
-/* Shortest Path (multiple destinations) for TSP GA */
-    int from;
-    int i;
-    RouteNodePtr destination;
-    RoutingNodePtr n;
-    RoutingNodePtr p_to;
-    RouteLinkPtr p_link;
-    RoutingHeapPtr heap;
-/* setting From */
-    from = targets->From->InternalIndex;
-/* initializing the heap */
-    heap = routing_heap_init (e->DimLink);
-/* initializing the graph */
-    for (i = 0; i < e->Dim; i++)
-      {
-	  n = e->Nodes + i;
-	  n->PreviousNode = NULL;
-	  n->xLink = NULL;
-	  n->Inspected = 0;
-	  n->Distance = DBL_MAX;
-      }
-/* queuing the From node into the heap */
-    e->Nodes[from].Distance = 0.0;
-    dijkstra_enqueue (heap, e->Nodes + from);
-    while (heap->Count > 0)
-      {
-	  /* Dijsktra loop */
-	  n = routing_dequeue (heap);
-	  destination = check_targets (n, targets);
-	  if (destination != NULL)
-	    {
-		/* reached one of the targets */
-		int stop = 0;
-		double totalCost = 0.0;
-		int to = destination->InternalIndex;
-		n = e->Nodes + to;
-		while (n->PreviousNode != NULL)
-		  {
-		      /* computing the total Cost */
-		      totalCost += n->xLink->Cost;
-		      n = n->PreviousNode;
-		  }
-		/* updating targets */
-		update_targets (targets, destination, totalCost, &stop);
-		if (stop)
-		    break;
-	    }
-	  n->Inspected = 1;
-	  for (i = 0; i < n->DimTo; i++)
-	    {
-		p_to = *(n->To + i);
-		p_link = *(n->Link + i);
-		if (p_to->Inspected == 0)
-		  {
-		      if (p_to->Distance == DBL_MAX)
-			{
-			    /* queuing a new node into the heap */
-			    p_to->Distance = n->Distance + p_link->Cost;
-			    p_to->PreviousNode = n;
-			    p_to->xLink = p_link;
-			    dijkstra_enqueue (heap, p_to);
-			}
-		      else if (p_to->Distance > n->Distance + p_link->Cost)
-			{
-			    /* updating an already inserted node */
-			    p_to->Distance = n->Distance + p_link->Cost;
-			    p_to->PreviousNode = n;
-			    p_to->xLink = p_link;
-			}
-		  }
-	    }
-      }
-    routing_heap_free (heap);
-}
-
-static void
-destroy_tsp_targets (TspTargetsPtr targets)
-{
-/* memory cleanup; destroying a TSP helper struct */
-    if (targets == NULL)
-	return;
-    if (targets->To != NULL)
-	free (targets->To);
-    if (targets->Found != NULL)
-	free (targets->Found);
-    if (targets->Costs != NULL)
-	free (targets->Costs);
-    if (targets->Solutions != NULL)
-      {
-	  int i;
-	  for (i = 0; i < targets->Count; i++)
-	    {
-		ShortestPathSolutionPtr pS = *(targets->Solutions + i);
-		if (pS != NULL)
-		    delete_solution (pS);
-	    }
-	  free (targets->Solutions);
-      }
-    if (targets->LastSolution != NULL)
-	delete_solution (targets->LastSolution);
-    free (targets);
-}
-
-static TspTargetsPtr
-randomize_targets (sqlite3 * handle, RoutingPtr graph,
-		   MultiSolutionPtr multiSolution)
+static TspTargetsPtr
+randomize_targets (sqlite3 * handle, RoutingPtr graph,
+		   MultiSolutionPtr multiSolution)
 {
 /* creating and initializing the TSP helper struct */
     char *sql;
@@ -2432,20 +2671,12 @@ dijkstra_tsp_nn (sqlite3 * handle, int options, RoutingPtr graph,
 /* setting From */
     from = targets->From->InternalIndex;
     origin = targets->From;
-/* initializing the heap */
-    heap = routing_heap_init (e->DimLink);
-/* initializing the graph */
-    for (i = 0; i < e->Dim; i++)
-      {
-	  n = e->Nodes + i;
-	  n->PreviousNode = NULL;
-	  n->xLink = NULL;
-	  n->Inspected = 0;
-	  n->Distance = DBL_MAX;
-      }
+/* starting a new search (lazily resetting the graph and the heap) */
+    heap = routing_begin (e);
 /* queuing the From node into the heap */
-    e->Nodes[from].Distance = 0.0;
-    dijkstra_enqueue (heap, e->Nodes + from);
+    n = routing_node (e, e->Nodes + from);
+    n->Distance = 0.0;
+    dijkstra_enqueue (heap, n);
     while (heap->Count > 0)
       {
 	  /* Dijsktra loop */
@@ -2497,24 +2728,17 @@ dijkstra_tsp_nn (sqlite3 * handle, int options, RoutingPtr graph,
 
 		/* restarting from the current target */
 		from = to;
-		for (i = 0; i < e->Dim; i++)
-		  {
-		      n = e->Nodes + i;
-		      n->PreviousNode = NULL;
-		      n->xLink = NULL;
-		      n->Inspected = 0;
-		      n->Distance = DBL_MAX;
-		  }
-		e->Nodes[from].Distance = 0.0;
-		routing_heap_reset (heap);
-		dijkstra_enqueue (heap, e->Nodes + from);
+		heap = routing_begin (e);
+		n = routing_node (e, e->Nodes + from);
+		n->Distance = 0.0;
+		dijkstra_enqueue (heap, n);
 		origin = destination;
 		continue;
 	    }
 	  n->Inspected = 1;
 	  for (i = 0; i < n->DimTo; i++)
 	    {
-		p_to = *(n->To + i);
+		p_to = routing_node (e, *(n->To + i));
 		p_link = *(n->Link + i);
 		if (p_to->Inspected == 0)
 		  {
@@ -2536,7 +2760,17 @@ dijkstra_tsp_nn (sqlite3 * handle, int options, RoutingPtr graph,
 		  }
 	    }
       }
-    routing_heap_free (heap);
+}
+
+static int
+cmp_routing_nodes (const void *p1, const void *p2)
+{
+/* compares two traversed nodes by internal index [for QSORT] */
+    RoutingNodePtr pN1 = *((RoutingNodePtr *) p1);
+    RoutingNodePtr pN2 = *((RoutingNodePtr *) p2);
+    if (pN1->Id == pN2->Id)
+	return 0;
+    return (pN1->Id < pN2->Id) ? -1 : 1;
 }
 
 static RoutingNodePtr *
@@ -2549,33 +2783,37 @@ dijkstra_range_analysis (RoutingNodesPtr e, RouteNodePtr pfrom,
     RoutingNodePtr p_to;
     RoutingNodePtr n;
     RouteLinkPtr p_link;
-    int cnt;
+    int cnt = 0;
+    int max = 1024;
     RoutingNodePtr *result;
     RoutingHeapPtr heap;
 /* setting From */
     from = pfrom->InternalIndex;
-/* initializing the heap */
-    heap = routing_heap_init (e->DimLink);
-/* initializing the graph */
-    for (i = 0; i < e->Dim; i++)
-      {
-	  n = e->Nodes + i;
-	  n->PreviousNode = NULL;
-	  n->xLink = NULL;
-	  n->Inspected = 0;
-	  n->Distance = DBL_MAX;
-      }
+/* starting a new search (lazily resetting the graph and the heap) */
+    heap = routing_begin (e);
+    result = malloc (sizeof (RoutingNodePtr) * max);
 /* queuing the From node into the heap */
-    e->Nodes[from].Distance = 0.0;
-    dijkstra_enqueue (heap, e->Nodes + from);
+    n = routing_node (e, e->Nodes + from);
+    n->Distance = 0.0;
+    dijkstra_enqueue (heap, n);
     while (heap->Count > 0)
       {
 	  /* Dijsktra loop */
 	  n = routing_dequeue (heap);
 	  n->Inspected = 1;
+	  if (n->Id != from)
+	    {
+		/* collecting the traversed Nodes */
+		if (cnt >= max)
+		  {
+		      max *= 2;
+		      result = realloc (result, sizeof (RoutingNodePtr) * max);
+		  }
+		result[cnt++] = n;
+	    }
 	  for (i = 0; i < n->DimTo; i++)
 	    {
-		p_to = *(n->To + i);
+		p_to = routing_node (e, *(n->To + i));
 		p_link = *(n->Link + i);
 		if (p_to->Inspected == 0)
 		  {
@@ -2600,29 +2838,8 @@ dijkstra_range_analysis (RoutingNodesPtr e, RouteNodePtr pfrom,
 		  }
 	    }
       }
-    routing_heap_free (heap);
-    cnt = 0;
-    for (i = 0; i < e->Dim; i++)
-      {
-	  /* counting how many traversed Nodes */
-	  n = e->Nodes + i;
-	  if (n->Node->InternalIndex == from)
-	      continue;
-	  if (n->Inspected)
-	      cnt++;
-      }
-/* allocating the solution */
-    result = malloc (sizeof (RouteNodePtr) * cnt);
-    cnt = 0;
-    for (i = 0; i < e->Dim; i++)
-      {
-	  /* populating the resultset */
-	  n = e->Nodes + i;
-	  if (n->Node->InternalIndex == from)
-	      continue;
-	  if (n->Inspected)
-	      result[cnt++] = n;
-      }
+/* sorting the resultset by Node */
+    qsort (result, cnt, sizeof (RoutingNodePtr), cmp_routing_nodes);
     *ll = cnt;
     return (result);
 }
@@ -2699,23 +2916,14 @@ astar_shortest_path (RoutingNodesPtr e, RouteNodePtr nodes,
     pOrg = nodes + pAux->Id;
     pAux = e->Nodes + to;
     pDest = nodes + pAux->Id;
-/* initializing the heap */
-    heap = routing_heap_init (e->DimLink);
-/* initializing the graph */
-    for (i = 0; i < e->Dim; i++)
-      {
-	  n = e->Nodes + i;
-	  n->PreviousNode = NULL;
-	  n->xLink = NULL;
-	  n->Inspected = 0;
-	  n->Distance = DBL_MAX;
-	  n->HeuristicDistance = DBL_MAX;
-      }
+/* starting a new search (lazily resetting the graph and the heap) */
+    heap = routing_begin (e);
 /* queuing the From node into the heap */
-    e->Nodes[from].Distance = 0.0;
-    e->Nodes[from].HeuristicDistance =
+    n = routing_node (e, e->Nodes + from);
+    n->Distance = 0.0;
+    n->HeuristicDistance =
 	astar_heuristic_distance (pOrg, pDest, heuristic_coeff);
-    astar_enqueue (heap, e->Nodes + from);
+    astar_enqueue (heap, n);
     while (heap->Count > 0)
       {
 	  /* A* loop */
@@ -2728,7 +2936,7 @@ astar_shortest_path (RoutingNodesPtr e, RouteNodePtr nodes,
 	  n->Inspected = 1;
 	  for (i = 0; i < n->DimTo; i++)
 	    {
-		p_to = *(n->To + i);
+		p_to = routing_node (e, *(n->To + i));
 		p_link = *(n->Link + i);
 		if (p_to->Inspected == 0)
 		  {
@@ -2760,9 +2968,8 @@ astar_shortest_path (RoutingNodesPtr e, RouteNodePtr nodes,
 		  }
 	    }
       }
-    routing_heap_free (heap);
     cnt = 0;
-    n = e->Nodes + to;
+    n = routing_node (e, e->Nodes + to);
     while (n->PreviousNode != NULL)
       {
 	  /* counting how many Links are into the Shortest Path solution */
@@ -2786,2143 +2993,3542 @@ astar_shortest_path (RoutingNodesPtr e, RouteNodePtr nodes,
 
 /* END of A* Shortest Path implementation */
 
-static int
-cmp_nodes_code (const void *p1, const void *p2)
+/*
+/
+/  implementation of the edge-based (Turns / Time Dependent) search
+/
+////////////////////////////////////////////////////////////
+/
+/ each Link is a search state holding the Cost required in order
+/ to reach its end; so Turns can be checked when leaving a Link,
+/ and Time Dependent Links can be evaluated at the time they are
+/ actually entered (profiles are assumed to be FIFO)
+/
+*/
+
+static TdSearchPtr
+td_search_init (RoutingPtr graph)
 {
-/* compares two nodes  by CODE [for BSEARCH] */
-    RouteNodePtr pN1 = (RouteNodePtr) p1;
-    RouteNodePtr pN2 = (RouteNodePtr) p2;
-    return strcmp (pN1->Code, pN2->Code);
+/* allocating the edge-based search buffers */
+    TdSearchPtr search = malloc (sizeof (TdSearch));
+    if (search == NULL)
+	return NULL;
+    search->Dim = graph->NumLinks;
+    search->Stamp = 0;
+    search->Links = calloc (graph->NumLinks + 1, sizeof (TdSearchLink));
+    search->Heap = NULL;
+    search->Count = 0;
+    search->Max = 0;
+    if (search->Links == NULL)
+      {
+	  free (search);
+	  return NULL;
+      }
+    return search;
 }
 
-static int
-cmp_nodes_id (const void *p1, const void *p2)
+static void
+td_search_free (TdSearchPtr search)
 {
-/* compares two nodes  by ID [for BSEARCH] */
-    RouteNodePtr pN1 = (RouteNodePtr) p1;
-    RouteNodePtr pN2 = (RouteNodePtr) p2;
-    if (pN1->Id == pN2->Id)
-	return 0;
-    if (pN1->Id > pN2->Id)
-	return 1;
-    return -1;
+/* freeing the edge-based search buffers */
+    if (search == NULL)
+	return;
+    if (search->Heap != NULL)
+	free (search->Heap);
+    free (search->Links);
+    free (search);
 }
 
-static RouteNodePtr
-find_node_by_code (RoutingPtr graph, const char *code)
+static void
+td_next_stamp (TdSearchPtr search)
 {
-/* searching a Node (by Code) into the sorted list */
-    RouteNodePtr ret;
-    RouteNode pN;
-    pN.Code = (char *) code;
-    ret =
-	bsearch (&pN, graph->Nodes, graph->NumNodes, sizeof (RouteNode),
-		 cmp_nodes_code);
-    return ret;
+/* starting a new search: invalidating all previous Link status */
+    int i;
+    search->Stamp++;
+    if (search->Stamp == 0)
+      {
+	  /* stamp wrap-around */
+	  for (i = 0; i < search->Dim; i++)
+	      search->Links[i].Stamp = 0;
+	  search->Stamp = 1;
+      }
+    search->Count = 0;
 }
 
-static RouteNodePtr
-find_node_by_id (RoutingPtr graph, const sqlite3_int64 id)
+static TdSearchLinkPtr
+td_link (TdSearchPtr search, int link)
 {
-/* searching a Node (by Id) into the sorted list */
-    RouteNodePtr ret;
-    RouteNode pN;
-    pN.Id = id;
-    ret =
-	bsearch (&pN, graph->Nodes, graph->NumNodes, sizeof (RouteNode),
-		 cmp_nodes_id);
-    return ret;
+/* lazily resetting a Link the first time the current search reaches it */
+    TdSearchLinkPtr st = search->Links + link;
+    if (st->Stamp != search->Stamp)
+      {
+	  st->Stamp = search->Stamp;
+	  st->Inspected = 0;
+	  st->PreviousLink = -1;
+	  st->Distance = DBL_MAX;
+      }
+    return st;
 }
 
-static void
-vroute_delete_multiple_destinations (RoutingMultiDestPtr multiple)
+static int
+td_enqueue (TdSearchPtr search, int link, double distance)
 {
-/* deleting a multiple destinations request */
-    if (multiple == NULL)
-	return;
-    if (multiple->Found != NULL)
-	free (multiple->Found);
-    if (multiple->To != NULL)
-	free (multiple->To);
-    if (multiple->Ids != NULL)
-	free (multiple->Ids);
-    if (multiple->Codes != NULL)
+/* inserting a Link into the heap */
+    TdHeapItemPtr heap;
+    int i;
+    if (search->Count == search->Max)
       {
-	  int i;
-	  for (i = 0; i < multiple->Items; i++)
-	    {
-		char *p = *(multiple->Codes + i);
-		if (p != NULL)
-		    free (p);
-	    }
-	  free (multiple->Codes);
+	  int max = (search->Max == 0) ? 256 : search->Max * 2;
+	  heap = realloc (search->Heap, sizeof (TdHeapItem) * max);
+	  if (heap == NULL)
+	      return 0;
+	  search->Heap = heap;
+	  search->Max = max;
       }
-    free (multiple);
+    heap = search->Heap;
+    i = search->Count++;
+    while (i > 0)
+      {
+	  int parent = (i - 1) / 2;
+	  if (heap[parent].Distance <= distance)
+	      break;
+	  heap[i] = heap[parent];
+	  i = parent;
+      }
+    heap[i].Link = link;
+    heap[i].Distance = distance;
+    return 1;
 }
 
-static void
-vroute_add_multiple_code (RoutingMultiDestPtr multiple, char *code)
+static TdHeapItem
+td_dequeue (TdSearchPtr search)
 {
-/* adding an item to an helper struct for Multiple Destinations (by Code) */
-    *(multiple->Codes + multiple->Next) = code;
-    multiple->Next += 1;
+/* removing the min-priority Link from the heap */
+    TdHeapItemPtr heap = search->Heap;
+    TdHeapItem top = heap[0];
+    TdHeapItem last = heap[--search->Count];
+    int count = search->Count;
+    int i = 0;
+    while (1)
+      {
+	  int c = (i * 2) + 1;
+	  if (c >= count)
+	      break;
+	  if (c + 1 < count && heap[c + 1].Distance < heap[c].Distance)
+	      c++;
+	  if (last.Distance <= heap[c].Distance)
+	      break;
+	  heap[i] = heap[c];
+	  i = c;
+      }
+    if (count > 0)
+	heap[i] = last;
+    return top;
 }
 
-static void
-vroute_add_multiple_id (RoutingMultiDestPtr multiple, int id)
+static int
+td_is_active (RoutingPtr graph, RoutingNodesPtr e)
 {
-/* adding an item to an helper struct for Multiple Destinations (by Code) */
-    *(multiple->Ids + multiple->Next) = id;
-    multiple->Next += 1;
+/* testing if the edge-based search is required */
+    if (e->Td == NULL)
+	return 0;
+    if (graph->Turns != NULL)
+	return 1;
+    if (graph->LinkProfiles != NULL && e->Departure >= 0.0)
+	return 1;
+    return 0;
 }
 
-static char *
-vroute_parse_multiple_item (const char *start, const char *last)
+static double
+td_interpolate (double t0, double c0, double t1, double c1, double t)
 {
-/* attempting to parse an item form the multiple destinations list */
-    char *item;
-    const char *p_in = start;
-    char *p_out;
-    int len = last - start;
-    if (len <= 0)
-	return NULL;
+/* linear interpolation between two breakpoints */
+    if (t1 - t0 <= 0.0)
+	return c0;
+    return c0 + ((c1 - c0) * ((t - t0) / (t1 - t0)));
+}
 
-    item = malloc (len + 1);
-    p_in = start;
-    p_out = item;
-    while (p_in < last)
-	*p_out++ = *p_in++;
-    *p_out = '\0';
-    return item;
+static double
+td_link_cost (RoutingPtr graph, int link, double departure, double elapsed)
+{
+/* the Cost of some Link when entering it after "elapsed" seconds */
+    RouteLinkProfilePtr profile;
+    RouteProfilePointPtr pts;
+    double t;
+    int count;
+    int lo;
+    int hi;
+    if (graph->LinkProfiles == NULL || departure < 0.0)
+	return graph->Links[link].Cost;
+    profile = graph->LinkProfiles + link;
+    count = profile->Count;
+    if (count == 0)
+	return graph->Links[link].Cost;
+    pts = graph->ProfilePoints + profile->First;
+    if (count == 1)
+	return pts[0].Cost;
+    t = fmod (departure + elapsed, 86400.0);
+    if (t < pts[0].Time || t >= pts[count - 1].Time)
+      {
+	  /* wrapping around midnight */
+	  if (t < pts[0].Time)
+	      t += 86400.0;
+	  return td_interpolate (pts[count - 1].Time, pts[count - 1].Cost,
+				 pts[0].Time + 86400.0, pts[0].Cost, t);
+      }
+/* searching the first breakpoint following t */
+    lo = 1;
+    hi = count - 1;
+    while (lo < hi)
+      {
+	  int mid = lo + ((hi - lo) / 2);
+	  if (pts[mid].Time <= t)
+	      lo = mid + 1;
+	  else
+	      hi = mid;
+      }
+    return td_interpolate (pts[lo - 1].Time, pts[lo - 1].Cost, pts[lo].Time,
+			   pts[lo].Cost, t);
 }
 
-static RoutingMultiDestPtr
-vroute_as_multiple_destinations (sqlite3_int64 value)
+static double
+td_turn_cost (RoutingPtr graph, int from, int to)
 {
-/* allocatint a multiple destinations containign a single target */
-    RoutingMultiDestPtr multiple = NULL;
+/* the Cost of turning from some Link into another; < 0.0 forbidden */
+    int i;
+    if (graph->TurnOffsets == NULL)
+	return 0.0;
+    for (i = graph->TurnOffsets[from]; i < graph->TurnOffsets[from + 1]; i++)
+      {
+	  if (graph->Turns[i].LinkTo == to)
+	      return graph->Turns[i].Cost;
+      }
+    return 0.0;
+}
 
-/* allocating the helper struct */
-    multiple = malloc (sizeof (RoutingMultiDest));
-    multiple->CodeNode = 0;
-    multiple->Found = malloc (sizeof (char));
-    multiple->To = malloc (sizeof (RouteNodePtr));
-    *(multiple->Found + 0) = 'N';
-    *(multiple->To + 0) = NULL;
-    multiple->Items = 1;
-    multiple->Next = 0;
-    multiple->Ids = malloc (sizeof (sqlite3_int64));
-    multiple->Codes = NULL;
-    *(multiple->Ids + 0) = value;
-    return multiple;
+static int
+td_relax (RoutingPtr graph, TdSearchPtr td, int previous, int link,
+	  double elapsed, double departure, RouteNodePtr target, double coeff)
+{
+/* reaching some Link; returns 0 on failure */
+    TdSearchLinkPtr st = td_link (td, link);
+    double distance;
+    double key;
+    if (st->Inspected)
+	return 1;
+    distance = elapsed + td_link_cost (graph, link, departure, elapsed);
+    if (distance >= st->Distance)
+	return 1;
+    st->Distance = distance;
+    st->PreviousLink = previous;
+    key = distance;
+    if (target != NULL)
+	key +=
+	    astar_heuristic_distance (graph->Nodes +
+				      graph->Links[link].NodeTo, target, coeff);
+    return td_enqueue (td, link, key);
 }
 
-static DestinationCandidatesListPtr
-alloc_candidates (int code_node)
+static void
+td_set_solution_costs (ShortestPathSolutionPtr solution, const double *costs,
+		       int cnt)
 {
-/* allocating a list of multiple destination candidates */
-    DestinationCandidatesListPtr list =
-	malloc (sizeof (DestinationCandidatesList));
-    list->NodeCode = code_node;
-    list->First = NULL;
-    list->Last = NULL;
-    list->ValidItems = 0;
-    return list;
+/* replacing the ordinary Link Costs by the actual ones */
+    int i;
+    RowSolutionPtr row = solution->First;
+    solution->TotalCost = 0.0;
+    for (i = 0; i < cnt; i++)
+	solution->TotalCost += costs[i];
+    for (i = 0; i < cnt && row != NULL; i++)
+      {
+	  row->Cost = costs[i];
+	  row = row->Next;
+      }
 }
 
 static void
-delete_candidates (DestinationCandidatesListPtr list)
+td_add_solution (sqlite3 * handle, int options, RoutingPtr graph,
+		 TdSearchPtr td, MultiSolutionPtr multiSolution,
+		 RouteNodePtr destination, int last)
 {
-/* memory clean-up: destroying a list of multiple destination candidates */
-    DestinationCandidatePtr pC;
-    DestinationCandidatePtr pCn;
-    if (list == NULL)
-	return;
-
-    pC = list->First;
-    while (pC != NULL)
+/* adding a Shortest Path solution ending with the given Link */
+    int cnt = 0;
+    int k;
+    int link;
+    RouteLinkPtr *result;
+    double *costs;
+    ShortestPathSolutionPtr solution;
+    for (link = last; link >= 0; link = td->Links[link].PreviousLink)
       {
-	  pCn = pC->Next;
-	  free (pC);
-	  pC = pCn;
+	  /* counting how many Links are into the Shortest Path solution */
+	  cnt++;
       }
-    free (list);
+/* allocating the solution */
+    result = malloc (sizeof (RouteLinkPtr) * (cnt + 1));
+    costs = malloc (sizeof (double) * (cnt + 1));
+    k = cnt - 1;
+    for (link = last; link >= 0; link = td->Links[link].PreviousLink)
+      {
+	  /* inserting a Link (and its actual Cost) into the solution */
+	  int previous = td->Links[link].PreviousLink;
+	  result[k] = graph->Links + link;
+	  costs[k] = td->Links[link].Distance;
+	  if (previous >= 0)
+	      costs[k] -= td->Links[previous].Distance;
+	  k--;
+      }
+    solution = add2multiSolution (multiSolution, multiSolution->From,
+				  destination);
+    build_solution (handle, options, graph, solution, result, cnt);
+    td_set_solution_costs (solution, costs, cnt);
+    free (costs);
 }
 
-static int
-checkNumber (const char *str)
+static void
+td_shortest_path (sqlite3 * handle, int options, RoutingPtr graph,
+		  RoutingNodesPtr e, MultiSolutionPtr multiSolution,
+		  RouteNodePtr target)
 {
-/* testing for an unsignd integer */
-    int len;
+/* 
+/ Shortest Path (multiple destinations) - edge-based Dijkstra's algorithm
+/ or A* algorithm (single destination) when a target is given
+*/
+    TdSearchPtr td = e->Td;
+    RouteNodePtr from = multiSolution->From;
+    RouteNodePtr destination;
+    RouteLinkPtr links;
+    double departure = e->Departure;
+    double coeff = 0.0;
+    int num_links;
+    int first;
     int i;
-    len = strlen (str);
-    for (i = 0; i < len; i++)
+    if (target != NULL)
+      {
+	  /* the A* heuristic must never overestimate profiled Costs */
+	  coeff = graph->AStarHeuristicCoeff;
+	  if (graph->LinkProfiles != NULL && departure >= 0.0)
+	      coeff *= graph->ProfileMinRatio;
+      }
+    td_next_stamp (td);
+/* the origin could be a destination as well */
+    destination = check_multiTo (e->Nodes + from->InternalIndex,
+				 multiSolution->MultiTo);
+    if (destination != NULL)
+      {
+	  td_add_solution (handle, options, graph, td, multiSolution,
+			   destination, -1);
+	  if (end_multiTo (multiSolution->MultiTo))
+	      return;
+      }
+/* queuing all Links leaving the origin */
+    links = route_node_links (graph, from, &num_links);
+    first = links - graph->Links;
+    for (i = 0; i < num_links; i++)
       {
-	  if (*(str + i) < '0' || *(str + i) > '9')
-	      return 0;
+	  if (!td_relax
+	      (graph, td, -1, first + i, 0.0, departure, target, coeff))
+	      return;
       }
-    return 1;
+    while (td->Count > 0)
+      {
+	  /* Dijkstra (or A*) loop */
+	  TdHeapItem item = td_dequeue (td);
+	  TdSearchLinkPtr st = td->Links + item.Link;
+	  RouteLinkPtr pA = graph->Links + item.Link;
+	  if (st->Inspected)
+	      continue;		/* an obsolete heap entry */
+	  st->Inspected = 1;
+	  destination =
+	      check_multiTo (e->Nodes + pA->NodeTo, multiSolution->MultiTo);
+	  if (destination != NULL)
+	    {
+		/* reached one of the multiple destinations */
+		td_add_solution (handle, options, graph, td, multiSolution,
+				 destination, item.Link);
+		/* testing for end (all destinations already reached) */
+		if (end_multiTo (multiSolution->MultiTo))
+		    break;
+	    }
+	  links =
+	      route_node_links (graph, graph->Nodes + pA->NodeTo, &num_links);
+	  first = links - graph->Links;
+	  for (i = 0; i < num_links; i++)
+	    {
+		double turn = td_turn_cost (graph, item.Link, first + i);
+		if (turn < 0.0)
+		    continue;	/* forbidden Turn */
+		if (!td_relax
+		    (graph, td, item.Link, first + i, st->Distance + turn,
+		     departure, target, coeff))
+		    return;
+	    }
+      }
+}
+
+/* END of edge-based Shortest Path implementation */
+
+/*
+/
+/  implementation of the Contraction Hierarchies bidirectional search
+/
+*/
+
+static ChSearchPtr
+ch_search_init (RoutingPtr graph)
+{
+/* allocating the Contraction Hierarchies search buffers */
+    ChSearchPtr search = malloc (sizeof (ChSearch));
+    if (search == NULL)
+	return NULL;
+    search->Dim = graph->NumNodes;
+    search->Stamp = 0;
+    search->Nodes = calloc (graph->NumNodes, sizeof (ChSearchNode));
+    search->Heap[0] = NULL;
+    search->Heap[1] = NULL;
+    search->Count[0] = 0;
+    search->Count[1] = 0;
+    search->Max[0] = 0;
+    search->Max[1] = 0;
+    if (search->Nodes == NULL)
+      {
+	  free (search);
+	  return NULL;
+      }
+    return search;
 }
 
 static void
-addMultiCandidate (DestinationCandidatesListPtr list, char *item)
+ch_search_free (ChSearchPtr search)
 {
-/* adding a candidate to the list */
-    DestinationCandidatePtr pC;
-    if (list == NULL)
-	return;
-    if (item == NULL)
+/* freeing the Contraction Hierarchies search buffers */
+    if (search == NULL)
 	return;
-    if (list->NodeCode == 0)
+    if (search->Heap[0] != NULL)
+	free (search->Heap[0]);
+    if (search->Heap[1] != NULL)
+	free (search->Heap[1]);
+    free (search->Nodes);
+    free (search);
+}
+
+static unsigned int
+ch_next_stamp (ChSearchPtr search)
+{
+/* starting a new search: invalidating all previous Node status */
+    int i;
+    search->Stamp++;
+    if (search->Stamp == 0)
       {
-	  if (!checkNumber (item))
+	  /* stamp wrap-around */
+	  for (i = 0; i < search->Dim; i++)
 	    {
-		/* invalid: not a number */
-		free (item);
-		return;
+		search->Nodes[i].Stamp[0] = 0;
+		search->Nodes[i].Stamp[1] = 0;
 	    }
+	  search->Stamp = 1;
       }
+    search->Count[0] = 0;
+    search->Count[1] = 0;
+    return search->Stamp;
+}
 
-    pC = malloc (sizeof (DestinationCandidate));
-    if (list->NodeCode)
+static int
+ch_enqueue (ChSearchPtr search, int dir, int node, double distance)
+{
+/* inserting a Node into the forward/backward heap */
+    ChHeapItemPtr heap;
+    int i;
+    if (search->Count[dir] == search->Max[dir])
       {
-	  pC->Code = item;
-	  pC->Id = -1;
+	  int max = (search->Max[dir] == 0) ? 256 : search->Max[dir] * 2;
+	  heap = realloc (search->Heap[dir], sizeof (ChHeapItem) * max);
+	  if (heap == NULL)
+	      return 0;
+	  search->Heap[dir] = heap;
+	  search->Max[dir] = max;
       }
-    else
+    heap = search->Heap[dir];
+    i = search->Count[dir]++;
+    while (i > 0)
       {
-	  pC->Code = NULL;
-	  pC->Id = atoll (item);
-	  free (item);
+	  int parent = (i - 1) / 2;
+	  if (heap[parent].Distance <= distance)
+	      break;
+	  heap[i] = heap[parent];
+	  i = parent;
       }
-    pC->Valid = 'Y';
-    pC->Next = NULL;
-    if (list->First == NULL)
-	list->First = pC;
-    if (list->Last != NULL)
-	list->Last->Next = pC;
-    list->Last = pC;
+    heap[i].Node = node;
+    heap[i].Distance = distance;
+    return 1;
 }
 
-static void
-validateMultiCandidates (DestinationCandidatesListPtr list)
+static ChHeapItem
+ch_dequeue (ChSearchPtr search, int dir)
 {
-/* validating candidates */
-    DestinationCandidatePtr pC = list->First;
-    while (pC != NULL)
+/* removing the min-priority Node from the forward/backward heap */
+    ChHeapItemPtr heap = search->Heap[dir];
+    ChHeapItem top = heap[0];
+    ChHeapItem last = heap[--search->Count[dir]];
+    int count = search->Count[dir];
+    int i = 0;
+    while (1)
       {
-	  DestinationCandidatePtr pC2;
-	  if (pC->Valid == 'N')
-	    {
-		pC = pC->Next;
-		continue;
-	    }
-	  pC2 = pC->Next;
-	  while (pC2 != NULL)
-	    {
-		/* testing for duplicates */
-		if (pC2->Valid == 'N')
-		  {
-		      pC2 = pC2->Next;
-		      continue;
-		  }
-		if (list->NodeCode)
-		  {
-		      if (strcmp (pC->Code, pC2->Code) == 0)
-			{
-			    free (pC2->Code);
-			    pC2->Code = NULL;
-			    pC2->Valid = 'N';
-			}
-		  }
-		else
-		  {
-		      if (pC->Id == pC2->Id)
-			  pC2->Valid = 'N';
-		  }
-		pC2 = pC2->Next;
-	    }
-	  pC = pC->Next;
+	  int c = (i * 2) + 1;
+	  if (c >= count)
+	      break;
+	  if (c + 1 < count && heap[c + 1].Distance < heap[c].Distance)
+	      c++;
+	  if (last.Distance <= heap[c].Distance)
+	      break;
+	  heap[i] = heap[c];
+	  i = c;
       }
+    if (count > 0)
+	heap[i] = last;
+    return top;
+}
 
-    list->ValidItems = 0;
-    pC = list->First;
-    while (pC != NULL)
+static RouteChEdgePtr
+ch_find_edge (RouteChEdgePtr edges, int count, int node)
+{
+/* searching the cheapest edge connecting some Node */
+    RouteChEdgePtr found = NULL;
+    int i;
+    for (i = 0; i < count; i++)
       {
-	  if (pC->Valid == 'Y')
-	      list->ValidItems += 1;
-	  pC = pC->Next;
+	  RouteChEdgePtr edge = edges + i;
+	  if (edge->NodeIndex != node)
+	      continue;
+	  if (found == NULL || edge->Cost < found->Cost)
+	      found = edge;
       }
+    return found;
 }
 
-static RoutingMultiDestPtr
-vroute_get_multiple_destinations (int code_node, char delimiter,
-				  const char *str)
+static int
+ch_add_link (RouteLinkPtr ** links, int *count, int *max, RouteLinkPtr link)
 {
-/* parsing a multiple destinations request string */
-    RoutingMultiDestPtr multiple = NULL;
-    DestinationCandidatesListPtr list = alloc_candidates (code_node);
-    DestinationCandidatePtr pC;
-    char *item;
+/* appending a Link into the Shortest Path solution */
+    if (*count == *max)
+      {
+	  int new_max = (*max == 0) ? 64 : *max * 2;
+	  RouteLinkPtr *new_links =
+	      realloc (*links, sizeof (RouteLinkPtr) * new_max);
+	  if (new_links == NULL)
+	      return 0;
+	  *links = new_links;
+	  *max = new_max;
+      }
+    (*links)[*count] = link;
+    *count += 1;
+    return 1;
+}
+
+static int
+ch_unpack_edge (RoutingPtr graph, int from, int to, RouteChEdgePtr edge,
+		RouteLinkPtr ** links, int *count, int *max)
+{
+/* recursively expanding a shortcut into the original Links */
+    RouteChNodePtr middle;
+    RouteChEdgePtr first;
+    RouteChEdgePtr second;
+    if (edge->MiddleIndex < 0)
+	return ch_add_link (links, count, max, edge->Link);
+/*
+/ the contracted Node always has a lower rank than both ends:
+/ From->Middle is one of its upward incoming edges, and
+/ Middle->To is one of its upward outcoming edges
+*/
+    middle = graph->ChNodes + edge->MiddleIndex;
+    first = ch_find_edge (middle->Backward, middle->NumBackward, from);
+    second = ch_find_edge (middle->Forward, middle->NumForward, to);
+    if (first == NULL || second == NULL)
+	return 0;
+    if (!ch_unpack_edge
+	(graph, from, edge->MiddleIndex, first, links, count, max))
+	return 0;
+    return ch_unpack_edge (graph, edge->MiddleIndex, to, second, links,
+			   count, max);
+}
+
+static RouteLinkPtr *
+ch_shortest_path (RoutingPtr graph, ChSearchPtr search, RouteNodePtr pfrom,
+		  RouteNodePtr pto, int *ll)
+{
+/* identifying the Shortest Path - Contraction Hierarchies */
+    int from = pfrom->InternalIndex;
+    int to = pto->InternalIndex;
+    int meet = -1;
+    double best = DBL_MAX;
+    unsigned int stamp;
+    RouteLinkPtr *result = NULL;
+    RouteChEdgePtr *path = NULL;
+    int *path_nodes = NULL;
+    int count = 0;
+    int max = 0;
+    int fwd_len = 0;
+    int bwd_len = 0;
+    int len;
+    int dir;
     int i;
-    const char *prev = str;
-    const char *ptr = str;
+    int n;
+
+    *ll = 0;
+    stamp = ch_next_stamp (search);
+
+/* queuing the From node (forward) and the To node (backward) */
+    search->Nodes[from].Stamp[0] = stamp;
+    search->Nodes[from].Distance[0] = 0.0;
+    search->Nodes[from].PreviousNode[0] = -1;
+    search->Nodes[from].Edge[0] = NULL;
+    search->Nodes[to].Stamp[1] = stamp;
+    search->Nodes[to].Distance[1] = 0.0;
+    search->Nodes[to].PreviousNode[1] = -1;
+    search->Nodes[to].Edge[1] = NULL;
+    if (!ch_enqueue (search, 0, from, 0.0))
+	return NULL;
+    if (!ch_enqueue (search, 1, to, 0.0))
+	return NULL;
 
-/* populating a linked list */
-    while (1)
-      {
-	  int whitespace = 0;
-	  if (*ptr == '\0')
+    while (search->Count[0] > 0 || search->Count[1] > 0)
+      {
+	  /* bidirectional upward search */
+	  ChHeapItem item;
+	  ChSearchNodePtr node;
+	  RouteChNodePtr ch_node;
+	  RouteChEdgePtr edges;
+	  int num_edges;
+	  double min_fwd =
+	      (search->Count[0] > 0) ? search->Heap[0][0].Distance : DBL_MAX;
+	  double min_bwd =
+	      (search->Count[1] > 0) ? search->Heap[1][0].Distance : DBL_MAX;
+	  if (min_fwd >= best && min_bwd >= best)
+	      break;
+	  dir = (min_fwd <= min_bwd) ? 0 : 1;
+	  item = ch_dequeue (search, dir);
+	  node = search->Nodes + item.Node;
+	  if (item.Distance > node->Distance[dir])
+	      continue;		/* stale heap item */
+	  if (node->Stamp[1 - dir] == stamp)
+	    {
+		/* this Node has been reached by both searches */
+		double cost = item.Distance + node->Distance[1 - dir];
+		if (cost < best)
+		  {
+		      best = cost;
+		      meet = item.Node;
+		  }
+	    }
+	  ch_node = graph->ChNodes + item.Node;
+	  if (dir == 0)
 	    {
-		item = vroute_parse_multiple_item (prev, ptr);
-		addMultiCandidate (list, item);
-		break;
+		edges = ch_node->Forward;
+		num_edges = ch_node->NumForward;
 	    }
-	  if (*ptr == ' ' || *ptr == '\t' || *ptr == '\n' || *ptr == '\r')
-	      whitespace = 1;
-	  if (*ptr == delimiter || whitespace)
+	  else
 	    {
-		item = vroute_parse_multiple_item (prev, ptr);
-		addMultiCandidate (list, item);
-		ptr++;
-		prev = ptr;
-		continue;
+		edges = ch_node->Backward;
+		num_edges = ch_node->NumBackward;
 	    }
-	  ptr++;
+	  for (i = 0; i < num_edges; i++)
+	    {
+		RouteChEdgePtr edge = edges + i;
+		ChSearchNodePtr next = search->Nodes + edge->NodeIndex;
+		double distance = item.Distance + edge->Cost;
+		if (next->Stamp[dir] == stamp
+		    && next->Distance[dir] <= distance)
+		    continue;
+		next->Stamp[dir] = stamp;
+		next->Distance[dir] = distance;
+		next->PreviousNode[dir] = item.Node;
+		next->Edge[dir] = edge;
+		if (!ch_enqueue (search, dir, edge->NodeIndex, distance))
+		    return NULL;
+	    }
+      }
+    if (meet < 0)
+      {
+	  /* unreachable destination */
+	  return malloc (sizeof (RouteLinkPtr));
+      }
+
+/* collecting the upward edges: From ... Meet ... To */
+    for (n = meet; search->Nodes[n].PreviousNode[0] >= 0;
+	 n = search->Nodes[n].PreviousNode[0])
+	fwd_len++;
+    for (n = meet; search->Nodes[n].PreviousNode[1] >= 0;
+	 n = search->Nodes[n].PreviousNode[1])
+	bwd_len++;
+    len = fwd_len + bwd_len;
+    if (len == 0)
+	return malloc (sizeof (RouteLinkPtr));
+    path = malloc (sizeof (RouteChEdgePtr) * len);
+    path_nodes = malloc (sizeof (int) * (len + 1));
+    if (path == NULL || path_nodes == NULL)
+	goto error;
+    path_nodes[fwd_len] = meet;
+    i = fwd_len;
+    for (n = meet; search->Nodes[n].PreviousNode[0] >= 0;
+	 n = search->Nodes[n].PreviousNode[0])
+      {
+	  i--;
+	  path[i] = search->Nodes[n].Edge[0];
+	  path_nodes[i] = search->Nodes[n].PreviousNode[0];
       }
-    validateMultiCandidates (list);
-    if (list->ValidItems <= 0)
+    i = fwd_len;
+    for (n = meet; search->Nodes[n].PreviousNode[1] >= 0;
+	 n = search->Nodes[n].PreviousNode[1])
       {
-	  delete_candidates (list);
-	  return NULL;
+	  path[i] = search->Nodes[n].Edge[1];
+	  path_nodes[i + 1] = search->Nodes[n].PreviousNode[1];
+	  i++;
       }
 
-/* allocating the helper struct */
-    multiple = malloc (sizeof (RoutingMultiDest));
-    multiple->CodeNode = code_node;
-    multiple->Found = malloc (sizeof (char) * list->ValidItems);
-    multiple->To = malloc (sizeof (RouteNodePtr) * list->ValidItems);
-    for (i = 0; i < list->ValidItems; i++)
+/* expanding all shortcuts */
+    for (i = 0; i < len; i++)
       {
-	  *(multiple->Found + i) = 'N';
-	  *(multiple->To + i) = NULL;
+	  if (!ch_unpack_edge
+	      (graph, path_nodes[i], path_nodes[i + 1], path[i], &result,
+	       &count, &max))
+	      goto error;
       }
-    multiple->Items = list->ValidItems;
-    multiple->Next = 0;
-    if (code_node)
+    free (path);
+    free (path_nodes);
+    *ll = count;
+    return result;
+
+  error:
+    if (path != NULL)
+	free (path);
+    if (path_nodes != NULL)
+	free (path_nodes);
+    if (result != NULL)
+	free (result);
+    return NULL;
+}
+
+/* END of Contraction Hierarchies implementation */
+
+/*
+/
+/  implementation of the Cost Matrix (one-to-many Dijkstra, Costs only)
+/
+*/
+
+static int
+matrix_one_to_many (RoutingPtr graph, ChSearchPtr search, RouteNodePtr pfrom,
+		    RoutingMultiDestPtr multiTo, double *costs)
+{
+/*
+/ computing the Costs from a single Origin to all Destinations;
+/ the forward slot of the search buffers holds the tentative
+/ distances, the backward Stamp marks all Destinations still
+/ waiting to be settled, so to stop as soon as all are known
+*/
+    unsigned int stamp;
+    int pending = 0;
+    int i;
+    ChSearchNodePtr node;
+
+    stamp = ch_next_stamp (search);
+    for (i = 0; i < multiTo->Items; i++)
       {
-	  multiple->Ids = NULL;
-	  multiple->Codes = malloc (sizeof (char *) * list->ValidItems);
+	  RouteNodePtr to = *(multiTo->To + i);
+	  if (to == NULL)
+	      continue;
+	  node = search->Nodes + to->InternalIndex;
+	  if (node->Stamp[1] != stamp)
+	    {
+		node->Stamp[1] = stamp;
+		pending++;
+	    }
       }
-    else
-      {
-	  multiple->Ids = malloc (sizeof (sqlite3_int64) * list->ValidItems);
-	  multiple->Codes = NULL;
+    node = search->Nodes + pfrom->InternalIndex;
+    node->Stamp[0] = stamp;
+    node->Distance[0] = 0.0;
+    if (!ch_enqueue (search, 0, pfrom->InternalIndex, 0.0))
+	return 0;
+
+    while (search->Count[0] > 0 && pending > 0)
+      {
+	  ChHeapItem item = ch_dequeue (search, 0);
+	  RouteLinkPtr links;
+	  int num_links;
+	  node = search->Nodes + item.Node;
+	  if (item.Distance > node->Distance[0])
+	      continue;		/* stale heap item */
+	  if (node->Stamp[1] == stamp)
+	    {
+		/* a Destination has been settled */
+		node->Stamp[1] = 0;
+		pending--;
+	    }
+	  links = route_node_links (graph, graph->Nodes + item.Node,
+				    &num_links);
+	  for (i = 0; i < num_links; i++)
+	    {
+		RouteLinkPtr link = links + i;
+		int index = link->NodeTo;
+		ChSearchNodePtr next = search->Nodes + index;
+		double distance = item.Distance + link->Cost;
+		if (next->Stamp[0] == stamp && next->Distance[0] <= distance)
+		    continue;
+		next->Stamp[0] = stamp;
+		next->Distance[0] = distance;
+		if (!ch_enqueue (search, 0, index, distance))
+		    return 0;
+	    }
       }
 
-/* populating the array */
-    pC = list->First;
-    while (pC != NULL)
+/* collecting the Costs */
+    for (i = 0; i < multiTo->Items; i++)
       {
-	  if (pC->Valid == 'Y')
-	    {
-		if (code_node)
-		    vroute_add_multiple_code (multiple, pC->Code);
-		else
-		    vroute_add_multiple_id (multiple, pC->Id);
-	    }
-	  pC = pC->Next;
+	  RouteNodePtr to = *(multiTo->To + i);
+	  costs[i] = -1.0;
+	  if (to == NULL)
+	      continue;
+	  node = search->Nodes + to->InternalIndex;
+	  if (node->Stamp[0] == stamp)
+	      costs[i] = node->Distance[0];
       }
-    delete_candidates (list);
-    return multiple;
+    return 1;
 }
 
 static void
-delete_multiSolution (MultiSolutionPtr multiSolution)
+matrix_worker (MatrixWorkerPtr worker)
 {
-/* deleting the current solution */
-    ResultsetRowPtr pR;
-    ResultsetRowPtr pRn;
-    ShortestPathSolutionPtr pS;
-    ShortestPathSolutionPtr pSn;
-    RowNodeSolutionPtr pN;
-    RowNodeSolutionPtr pNn;
-    RowSolutionPtr pA;
-    RowSolutionPtr pAn;
-    gaiaGeomCollPtr pG;
-    gaiaGeomCollPtr pGn;
-    if (!multiSolution)
-	return;
-    if (multiSolution->MultiTo != NULL)
-	vroute_delete_multiple_destinations (multiSolution->MultiTo);
-    pS = multiSolution->First;
-    while (pS != NULL)
-      {
-	  pSn = pS->Next;
-	  delete_solution (pS);
-	  pS = pSn;
-      }
-    pN = multiSolution->FirstNode;
-    while (pN != NULL)
+/* evaluating all Origins assigned to this worker */
+    int n_to = worker->MultiTo->Items;
+    ChSearchPtr search;
+    int i;
+    int j;
+
+    search = ch_search_init (worker->graph);
+    if (search == NULL)
       {
-	  pNn = pN->Next;
-	  free (pN);
-	  pN = pNn;
+	  worker->Error = 1;
+	  return;
       }
-    pR = multiSolution->FirstRow;
-    while (pR != NULL)
+    for (i = worker->First; i < worker->MultiFrom->Items; i += worker->Step)
       {
-	  pRn = pR->Next;
-	  if (pR->Undefined != NULL)
-	      free (pR->Undefined);
-	  free (pR);
-	  pR = pRn;
+	  RouteNodePtr from = *(worker->MultiFrom->To + i);
+	  double *costs = worker->Matrix + ((size_t) i * n_to);
+	  if (from == NULL)
+	    {
+		/* undefined Origin */
+		for (j = 0; j < n_to; j++)
+		    costs[j] = -1.0;
+		continue;
+	    }
+	  if (!matrix_one_to_many
+	      (worker->graph, search, from, worker->MultiTo, costs))
+	    {
+		worker->Error = 1;
+		break;
+	    }
       }
-    pA = multiSolution->FirstLink;
-    while (pA != NULL)
+    ch_search_free (search);
+}
+
+#ifndef _WIN32			/* POSIX threads: supporting parallel execution */
+
+static void *
+matrix_worker_thread (void *arg)
+{
+/* a Cost Matrix worker thread */
+    matrix_worker ((MatrixWorkerPtr) arg);
+    return NULL;
+}
+
+static int
+matrix_threads (int origins)
+{
+/* determining how many threads are worth to be used */
+    long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    int threads = origins / VROUTE_MATRIX_MIN_ORIGINS;
+    if (cpus < 1)
+	cpus = 1;
+    if (threads > cpus)
+	threads = cpus;
+    if (threads > VROUTE_MATRIX_MAX_THREADS)
+	threads = VROUTE_MATRIX_MAX_THREADS;
+    if (threads < 1)
+	threads = 1;
+    return threads;
+}
+
+#endif
+
+static int
+cost_matrix_compute (RoutingPtr graph, RoutingMultiDestPtr multiFrom,
+		     RoutingMultiDestPtr multiTo, double *matrix)
+{
+/*
+/ computing a Cost Matrix: one search tree for each Origin;
+/ the Routing graph is read-only, so Origins can be safely spread
+/ across many threads, each one owning its own search buffers
+/
+/ returns 0 on failure
+*/
+    MatrixWorker workers[VROUTE_MATRIX_MAX_THREADS];
+    int threads = 1;
+    int i;
+#ifndef _WIN32
+    pthread_t handles[VROUTE_MATRIX_MAX_THREADS];
+    int started[VROUTE_MATRIX_MAX_THREADS];
+#endif
+
+#ifndef _WIN32
+    threads = matrix_threads (multiFrom->Items);
+#endif
+    for (i = 0; i < threads; i++)
+      {
+	  workers[i].graph = graph;
+	  workers[i].MultiFrom = multiFrom;
+	  workers[i].MultiTo = multiTo;
+	  workers[i].Matrix = matrix;
+	  workers[i].First = i;
+	  workers[i].Step = threads;
+	  workers[i].Error = 0;
+      }
+#ifndef _WIN32
+    for (i = 1; i < threads; i++)
+	started[i] =
+	    (pthread_create
+	     (&(handles[i]), NULL, matrix_worker_thread, workers + i) == 0);
+#endif
+    matrix_worker (workers + 0);
+#ifndef _WIN32
+    for (i = 1; i < threads; i++)
       {
-	  pAn = pA->Next;
-	  if (pA->Name)
-	      free (pA->Name);
-	  free (pA);
-	  pA = pAn;
+	  if (started[i])
+	      pthread_join (handles[i], NULL);
+	  else
+	      matrix_worker (workers + i);
       }
-    pG = multiSolution->FirstGeom;
-    while (pG != NULL)
+#endif
+    for (i = 0; i < threads; i++)
       {
-	  pGn = pG->Next;
-	  gaiaFreeGeomColl (pG);
-	  pG = pGn;
+	  if (workers[i].Error)
+	      return 0;
       }
-    free (multiSolution);
+    return 1;
 }
 
 static void
-reset_multiSolution (MultiSolutionPtr multiSolution)
+cost_matrix_solve (RoutingPtr graph, MultiSolutionPtr multiSolution)
 {
-/* resetting the current solution */
-    ResultsetRowPtr pR;
-    ResultsetRowPtr pRn;
-    ShortestPathSolutionPtr pS;
-    ShortestPathSolutionPtr pSn;
-    RowNodeSolutionPtr pN;
-    RowNodeSolutionPtr pNn;
-    RowSolutionPtr pA;
-    RowSolutionPtr pAn;
-    gaiaGeomCollPtr pG;
-    gaiaGeomCollPtr pGn;
-    if (!multiSolution)
+/* computing a Cost Matrix solution */
+    int n_from = multiSolution->MultiFrom->Items;
+    int n_to = multiSolution->MultiTo->Items;
+    multiSolution->Matrix = malloc (sizeof (double) * n_from * n_to);
+    if (multiSolution->Matrix == NULL)
 	return;
-    if (multiSolution->MultiTo != NULL)
-	vroute_delete_multiple_destinations (multiSolution->MultiTo);
-    pS = multiSolution->First;
-    while (pS != NULL)
-      {
-	  pSn = pS->Next;
-	  delete_solution (pS);
-	  pS = pSn;
-      }
-    pN = multiSolution->FirstNode;
-    while (pN != NULL)
-      {
-	  pNn = pN->Next;
-	  free (pN);
-	  pN = pNn;
-      }
-    pR = multiSolution->FirstRow;
-    while (pR != NULL)
-      {
-	  pRn = pR->Next;
-	  if (pR->Undefined != NULL)
-	      free (pR->Undefined);
-	  free (pR);
-	  pR = pRn;
-      }
-    pA = multiSolution->FirstLink;
-    while (pA != NULL)
-      {
-	  pAn = pA->Next;
-	  if (pA->Name)
-	      free (pA->Name);
-	  free (pA);
-	  pA = pAn;
-      }
-    pG = multiSolution->FirstGeom;
-    while (pG != NULL)
+    if (!cost_matrix_compute
+	(graph, multiSolution->MultiFrom, multiSolution->MultiTo,
+	 multiSolution->Matrix))
       {
-	  pGn = pG->Next;
-	  gaiaFreeGeomColl (pG);
-	  pG = pGn;
+	  free (multiSolution->Matrix);
+	  multiSolution->Matrix = NULL;
       }
-    multiSolution->From = NULL;
-    multiSolution->MultiTo = NULL;
-    multiSolution->First = NULL;
-    multiSolution->Last = NULL;
-    multiSolution->FirstRow = NULL;
-    multiSolution->LastRow = NULL;
-    multiSolution->FirstNode = NULL;
-    multiSolution->LastNode = NULL;
-    multiSolution->CurrentRow = NULL;
-    multiSolution->CurrentNodeRow = NULL;
-    multiSolution->CurrentRowId = 0;
-    multiSolution->FirstLink = NULL;
-    multiSolution->LastLink = NULL;
-    multiSolution->FirstGeom = NULL;
-    multiSolution->LastGeom = NULL;
 }
 
-static MultiSolutionPtr
-alloc_multiSolution (void)
-{
-/* allocates and initializes the current multiple-destinations solution */
-    MultiSolutionPtr p = malloc (sizeof (MultiSolution));
-    p->From = NULL;
-    p->MultiTo = NULL;
-    p->First = NULL;
-    p->Last = NULL;
-    p->FirstRow = NULL;
-    p->LastRow = NULL;
-    p->CurrentRow = NULL;
-    p->FirstNode = NULL;
-    p->LastNode = NULL;
-    p->CurrentNodeRow = NULL;
-    p->CurrentRowId = 0;
-    p->FirstLink = NULL;
-    p->LastLink = NULL;
-    p->FirstGeom = NULL;
-    p->LastGeom = NULL;
-    p->RouteNum = 0;
-    return p;
-}
+/* END of Cost Matrix implementation */
 
-static void
-delete_point2PointNode (Point2PointNodePtr p)
+static int
+cmp_nodes_id (const void *p1, const void *p2)
 {
-/* deleting a Point2Point Node */
-    if (p->codNode != NULL)
-	free (p->codNode);
-    free (p);
+/* compares two nodes  by ID [for BSEARCH] */
+    RouteNodePtr pN1 = (RouteNodePtr) p1;
+    RouteNodePtr pN2 = (RouteNodePtr) p2;
+    if (pN1->Id == pN2->Id)
+	return 0;
+    if (pN1->Id > pN2->Id)
+	return 1;
+    return -1;
 }
 
-static void
-delete_point2PointCandidate (Point2PointCandidatePtr p)
-{
-/* deleting a Point2Point candidate */
-    if (p->codNodeFrom != NULL)
-	free (p->codNodeFrom);
-    if (p->codNodeTo != NULL)
-	free (p->codNodeTo);
-    if (p->path != NULL)
-	gaiaFreeGeomColl (p->path);
-    free (p);
+static RouteNodePtr
+find_node_by_code (RoutingPtr graph, const char *code)
+{
+/* searching a Node (by Code) into the sorted list */
+    int lo = 0;
+    int hi = graph->NumNodes - 1;
+    while (lo <= hi)
+      {
+	  int mid = lo + ((hi - lo) / 2);
+	  RouteNodePtr pN = graph->Nodes + mid;
+	  const char *node_code = route_node_code (graph, pN);
+	  int cmp = (node_code == NULL) ? -1 : strcmp (node_code, code);
+	  if (cmp == 0)
+	      return pN;
+	  if (cmp < 0)
+	      lo = mid + 1;
+	  else
+	      hi = mid - 1;
+      }
+    return NULL;
+}
+
+static RouteNodePtr
+find_node_by_id (RoutingPtr graph, const sqlite3_int64 id)
+{
+/* searching a Node (by Id) into the sorted list */
+    RouteNodePtr ret;
+    RouteNode pN;
+    pN.Id = id;
+    ret =
+	bsearch (&pN, graph->Nodes, graph->NumNodes, sizeof (RouteNode),
+		 cmp_nodes_id);
+    return ret;
 }
 
 static void
-delete_point2PointSolution (Point2PointSolutionPtr p2pSolution)
+vroute_delete_multiple_destinations (RoutingMultiDestPtr multiple)
 {
-/* deleting the current Point2Point solution */
-    Point2PointCandidatePtr pC;
-    Point2PointCandidatePtr pCn;
-    Point2PointNodePtr pN;
-    Point2PointNodePtr pNn;
-    ResultsetRowPtr pR;
-    ResultsetRowPtr pRn;
-    pC = p2pSolution->firstFromCandidate;
-    while (pC != NULL)
+/* deleting a multiple destinations request */
+    if (multiple == NULL)
+	return;
+    if (multiple->Found != NULL)
+	free (multiple->Found);
+    if (multiple->To != NULL)
+	free (multiple->To);
+    if (multiple->Ids != NULL)
+	free (multiple->Ids);
+    if (multiple->Codes != NULL)
       {
-	  pCn = pC->next;
-	  delete_point2PointCandidate (pC);
-	  pC = pCn;
+	  int i;
+	  for (i = 0; i < multiple->Items; i++)
+	    {
+		char *p = *(multiple->Codes + i);
+		if (p != NULL)
+		    free (p);
+	    }
+	  free (multiple->Codes);
       }
-    pC = p2pSolution->firstToCandidate;
+    free (multiple);
+}
+
+static void
+vroute_add_multiple_code (RoutingMultiDestPtr multiple, char *code)
+{
+/* adding an item to an helper struct for Multiple Destinations (by Code) */
+    *(multiple->Codes + multiple->Next) = code;
+    multiple->Next += 1;
+}
+
+static void
+vroute_add_multiple_id (RoutingMultiDestPtr multiple, int id)
+{
+/* adding an item to an helper struct for Multiple Destinations (by Code) */
+    *(multiple->Ids + multiple->Next) = id;
+    multiple->Next += 1;
+}
+
+static char *
+vroute_parse_multiple_item (const char *start, const char *last)
+{
+/* attempting to parse an item form the multiple destinations list */
+    char *item;
+    const char *p_in = start;
+    char *p_out;
+    int len = last - start;
+    if (len <= 0)
+	return NULL;
+
+    item = malloc (len + 1);
+    p_in = start;
+    p_out = item;
+    while (p_in < last)
+	*p_out++ = *p_in++;
+    *p_out = '\0';
+    return item;
+}
+
+static RoutingMultiDestPtr
+vroute_as_multiple_destinations (sqlite3_int64 value)
+{
+/* allocatint a multiple destinations containign a single target */
+    RoutingMultiDestPtr multiple = NULL;
+
+/* allocating the helper struct */
+    multiple = malloc (sizeof (RoutingMultiDest));
+    multiple->CodeNode = 0;
+    multiple->Found = malloc (sizeof (char));
+    multiple->To = malloc (sizeof (RouteNodePtr));
+    *(multiple->Found + 0) = 'N';
+    *(multiple->To + 0) = NULL;
+    multiple->Items = 1;
+    multiple->Next = 0;
+    multiple->Ids = malloc (sizeof (sqlite3_int64));
+    multiple->Codes = NULL;
+    *(multiple->Ids + 0) = value;
+    return multiple;
+}
+
+static DestinationCandidatesListPtr
+alloc_candidates (int code_node)
+{
+/* allocating a list of multiple destination candidates */
+    DestinationCandidatesListPtr list =
+	malloc (sizeof (DestinationCandidatesList));
+    list->NodeCode = code_node;
+    list->First = NULL;
+    list->Last = NULL;
+    list->ValidItems = 0;
+    return list;
+}
+
+static void
+delete_candidates (DestinationCandidatesListPtr list)
+{
+/* memory clean-up: destroying a list of multiple destination candidates */
+    DestinationCandidatePtr pC;
+    DestinationCandidatePtr pCn;
+    if (list == NULL)
+	return;
+
+    pC = list->First;
     while (pC != NULL)
       {
-	  pCn = pC->next;
-	  delete_point2PointCandidate (pC);
+	  pCn = pC->Next;
+	  free (pC);
 	  pC = pCn;
       }
-    pN = p2pSolution->firstFromNode;
-    while (pN != NULL)
-      {
-	  pNn = pN->next;
-	  delete_point2PointNode (pN);
-	  pN = pNn;
-      }
-    pN = p2pSolution->firstToNode;
-    while (pN != NULL)
+    free (list);
+}
+
+static int
+checkNumber (const char *str)
+{
+/* testing for an unsignd integer */
+    int len;
+    int i;
+    len = strlen (str);
+    for (i = 0; i < len; i++)
       {
-	  pNn = pN->next;
-	  delete_point2PointNode (pN);
-	  pN = pNn;
+	  if (*(str + i) < '0' || *(str + i) > '9')
+	      return 0;
       }
-    pR = p2pSolution->FirstRow;
-    while (pR != NULL)
+    return 1;
+}
+
+static void
+addMultiCandidate (DestinationCandidatesListPtr list, char *item)
+{
+/* adding a candidate to the list */
+    DestinationCandidatePtr pC;
+    if (list == NULL)
+	return;
+    if (item == NULL)
+	return;
+    if (list->NodeCode == 0)
       {
-	  pRn = pR->Next;
-	  if (pR->Point2PointRole == VROUTE_POINT2POINT_START
-	      || pR->Point2PointRole == VROUTE_POINT2POINT_END)
+	  if (!checkNumber (item))
 	    {
-		/* deleting partial Links */
-		if (pR->linkRef != NULL)
-		  {
-		      if (pR->linkRef->Link != NULL)
-			  free (pR->linkRef->Link);
-		      if (pR->linkRef->Name != NULL)
-			  free (pR->linkRef->Name);
-		      free (pR->linkRef);
-		  }
+		/* invalid: not a number */
+		free (item);
+		return;
 	    }
-	  if (pR->Geometry != NULL)
-	      gaiaFreeGeomColl (pR->Geometry);
-	  if (pR->Undefined != NULL)
-	      free (pR->Undefined);
-	  free (pR);
-	  pR = pRn;
       }
-    if (p2pSolution->dynLine != NULL)
-	gaiaFreeDynamicLine (p2pSolution->dynLine);
-    free (p2pSolution);
+
+    pC = malloc (sizeof (DestinationCandidate));
+    if (list->NodeCode)
+      {
+	  pC->Code = item;
+	  pC->Id = -1;
+      }
+    else
+      {
+	  pC->Code = NULL;
+	  pC->Id = atoll (item);
+	  free (item);
+      }
+    pC->Valid = 'Y';
+    pC->Next = NULL;
+    if (list->First == NULL)
+	list->First = pC;
+    if (list->Last != NULL)
+	list->Last->Next = pC;
+    list->Last = pC;
 }
 
 static void
-reset_point2PointSolution (Point2PointSolutionPtr p2pSolution)
+validateMultiCandidates (DestinationCandidatesListPtr list)
 {
-/* resetting the current solution [Point2Point] */
-    Point2PointCandidatePtr pC;
-    Point2PointCandidatePtr pCn;
-    Point2PointNodePtr pN;
-    Point2PointNodePtr pNn;
-    ResultsetRowPtr pR;
-    ResultsetRowPtr pRn;
-    p2pSolution->validFrom = 0;
-    p2pSolution->xFrom = 0.0;
-    p2pSolution->yFrom = 0.0;
-    p2pSolution->zFrom = 0.0;
-    p2pSolution->validTo = 0;
-    p2pSolution->xTo = 0.0;
-    p2pSolution->yTo = 0.0;
-    p2pSolution->zTo = 0.0;
-    p2pSolution->srid = -1;
-    pC = p2pSolution->firstFromCandidate;
+/* validating candidates */
+    DestinationCandidatePtr pC = list->First;
     while (pC != NULL)
       {
-	  pCn = pC->next;
-	  delete_point2PointCandidate (pC);
-	  pC = pCn;
+	  DestinationCandidatePtr pC2;
+	  if (pC->Valid == 'N')
+	    {
+		pC = pC->Next;
+		continue;
+	    }
+	  pC2 = pC->Next;
+	  while (pC2 != NULL)
+	    {
+		/* testing for duplicates */
+		if (pC2->Valid == 'N')
+		  {
+		      pC2 = pC2->Next;
+		      continue;
+		  }
+		if (list->NodeCode)
+		  {
+		      if (strcmp (pC->Code, pC2->Code) == 0)
+			{
+			    free (pC2->Code);
+			    pC2->Code = NULL;
+			    pC2->Valid = 'N';
+			}
+		  }
+		else
+		  {
+		      if (pC->Id == pC2->Id)
+			  pC2->Valid = 'N';
+		  }
+		pC2 = pC2->Next;
+	    }
+	  pC = pC->Next;
       }
-    pC = p2pSolution->firstToCandidate;
+
+    list->ValidItems = 0;
+    pC = list->First;
     while (pC != NULL)
       {
-	  pCn = pC->next;
-	  delete_point2PointCandidate (pC);
-	  pC = pCn;
+	  if (pC->Valid == 'Y')
+	      list->ValidItems += 1;
+	  pC = pC->Next;
       }
-    p2pSolution->firstFromCandidate = NULL;
-    p2pSolution->lastFromCandidate = NULL;
-    p2pSolution->firstToCandidate = NULL;
-    p2pSolution->lastToCandidate = NULL;
-    pN = p2pSolution->firstFromNode;
-    while (pN != NULL)
+}
+
+static RoutingMultiDestPtr
+vroute_get_multiple_destinations (int code_node, char delimiter,
+				  const char *str)
+{
+/* parsing a multiple destinations request string */
+    RoutingMultiDestPtr multiple = NULL;
+    DestinationCandidatesListPtr list = alloc_candidates (code_node);
+    DestinationCandidatePtr pC;
+    char *item;
+    int i;
+    const char *prev = str;
+    const char *ptr = str;
+
+/* populating a linked list */
+    while (1)
       {
-	  pNn = pN->next;
-	  delete_point2PointNode (pN);
-	  pN = pNn;
+	  int whitespace = 0;
+	  if (*ptr == '\0')
+	    {
+		item = vroute_parse_multiple_item (prev, ptr);
+		addMultiCandidate (list, item);
+		break;
+	    }
+	  if (*ptr == ' ' || *ptr == '\t' || *ptr == '\n' || *ptr == '\r')
+	      whitespace = 1;
+	  if (*ptr == delimiter || whitespace)
+	    {
+		item = vroute_parse_multiple_item (prev, ptr);
+		addMultiCandidate (list, item);
+		ptr++;
+		prev = ptr;
+		continue;
+	    }
+	  ptr++;
       }
-    pN = p2pSolution->firstToNode;
-    while (pN != NULL)
+    validateMultiCandidates (list);
+    if (list->ValidItems <= 0)
       {
-	  pNn = pN->next;
-	  delete_point2PointNode (pN);
-	  pN = pNn;
+	  delete_candidates (list);
+	  return NULL;
       }
-    p2pSolution->firstFromNode = NULL;
-    p2pSolution->lastFromNode = NULL;
-    p2pSolution->firstToNode = NULL;
-    p2pSolution->lastToNode = NULL;
-    pR = p2pSolution->FirstRow;
-    while (pR != NULL)
+
+/* allocating the helper struct */
+    multiple = malloc (sizeof (RoutingMultiDest));
+    multiple->CodeNode = code_node;
+    multiple->Found = malloc (sizeof (char) * list->ValidItems);
+    multiple->To = malloc (sizeof (RouteNodePtr) * list->ValidItems);
+    for (i = 0; i < list->ValidItems; i++)
       {
-	  pRn = pR->Next;
-	  if (pR->Point2PointRole == VROUTE_POINT2POINT_START
-	      || pR->Point2PointRole == VROUTE_POINT2POINT_END)
+	  *(multiple->Found + i) = 'N';
+	  *(multiple->To + i) = NULL;
+      }
+    multiple->Items = list->ValidItems;
+    multiple->Next = 0;
+    if (code_node)
+      {
+	  multiple->Ids = NULL;
+	  multiple->Codes = malloc (sizeof (char *) * list->ValidItems);
+      }
+    else
+      {
+	  multiple->Ids = malloc (sizeof (sqlite3_int64) * list->ValidItems);
+	  multiple->Codes = NULL;
+      }
+
+/* populating the array */
+    pC = list->First;
+    while (pC != NULL)
+      {
+	  if (pC->Valid == 'Y')
 	    {
-		/* deleting partial Links */
-		if (pR->linkRef != NULL)
-		  {
-		      if (pR->linkRef->Link != NULL)
-			  free (pR->linkRef->Link);
-		      if (pR->linkRef->Name != NULL)
-			  free (pR->linkRef->Name);
-		      free (pR->linkRef);
-		  }
+		if (code_node)
+		    vroute_add_multiple_code (multiple, pC->Code);
+		else
+		    vroute_add_multiple_id (multiple, pC->Id);
 	    }
-	  if (pR->Geometry != NULL)
-	      gaiaFreeGeomColl (pR->Geometry);
-	  if (pR->Undefined != NULL)
-	      free (pR->Undefined);
-	  free (pR);
-	  pR = pRn;
+	  pC = pC->Next;
       }
-    p2pSolution->FirstRow = NULL;
-    p2pSolution->LastRow = NULL;
-    p2pSolution->CurrentRow = NULL;
-    p2pSolution->CurrentRowId = 0;
-    p2pSolution->totalCost = DBL_MAX;
-    p2pSolution->fromCandidate = NULL;
-    p2pSolution->toCandidate = NULL;
-    if (p2pSolution->dynLine != NULL)
-	gaiaFreeDynamicLine (p2pSolution->dynLine);
-    p2pSolution->dynLine = NULL;
-    p2pSolution->hasZ = 0;
-    p2pSolution->Mode = VROUTE_POINT2POINT_ERROR;
+    delete_candidates (list);
+    return multiple;
 }
 
-static Point2PointSolutionPtr
-alloc_point2PointSolution (void)
+static void
+delete_isochrone_bands (MultiSolutionPtr multiSolution)
 {
-/* allocates and initializes the current Point2Point solution */
-    Point2PointSolutionPtr p = malloc (sizeof (Point2PointSolution));
-    p->validFrom = 0;
-    p->xFrom = 0.0;
-    p->yFrom = 0.0;
-    p->zFrom = 0.0;
-    p->validTo = 0;
-    p->xTo = 0.0;
-    p->yTo = 0.0;
-    p->zTo = 0.0;
-    p->srid = -1;
-    p->firstFromCandidate = NULL;
-    p->lastFromCandidate = NULL;
-    p->firstToCandidate = NULL;
-    p->lastToCandidate = NULL;
-    p->firstFromNode = NULL;
-    p->lastFromNode = NULL;
-    p->firstToNode = NULL;
-    p->lastToNode = NULL;
-    p->FirstRow = NULL;
-    p->LastRow = NULL;
-    p->CurrentRow = NULL;
-    p->CurrentRowId = 0;
-    p->totalCost = DBL_MAX;
-    p->fromCandidate = NULL;
-    p->toCandidate = NULL;
-    p->dynLine = NULL;
-    p->hasZ = 0;
-    p->Mode = VROUTE_POINT2POINT_ERROR;
-    return p;
+/* deleting the Isochrones bands */
+    int i;
+    if (multiSolution->Bands == NULL)
+	return;
+    for (i = 0; i < multiSolution->NumBands; i++)
+      {
+	  if (multiSolution->Bands[i].Blob != NULL)
+	      free (multiSolution->Bands[i].Blob);
+      }
+    free (multiSolution->Bands);
+    multiSolution->Bands = NULL;
+    multiSolution->NumBands = 0;
 }
 
 static void
-find_srid (sqlite3 * handle, RoutingPtr graph)
+delete_multiSolution (MultiSolutionPtr multiSolution)
 {
-/* attempting to retrieve the appropriate Srid */
-    sqlite3_stmt *stmt;
-    int ret;
-    int type = GAIA_UNKNOWN;
-    int srid = VROUTE_INVALID_SRID;
-    char *sql;
-
-    graph->Srid = srid;
-    graph->HasZ = 0;
-
-    if (graph->GeometryColumn == NULL)
-	return;
-
-    sql =
-	sqlite3_mprintf
-	("SELECT geometry_type, srid FROM geometry_columns WHERE "
-	 "Lower(f_table_name) = Lower(%Q) AND Lower(f_geometry_column) = Lower(%Q)",
-	 graph->TableName, graph->GeometryColumn);
-    ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt, NULL);
-    sqlite3_free (sql);
-    if (ret != SQLITE_OK)
+/* deleting the current solution */
+    ResultsetRowPtr pR;
+    ResultsetRowPtr pRn;
+    ShortestPathSolutionPtr pS;
+    ShortestPathSolutionPtr pSn;
+    RowNodeSolutionPtr pN;
+    RowNodeSolutionPtr pNn;
+    RowSolutionPtr pA;
+    RowSolutionPtr pAn;
+    gaiaGeomCollPtr pG;
+    gaiaGeomCollPtr pGn;
+    if (!multiSolution)
 	return;
-    while (1)
+    if (multiSolution->MultiTo != NULL)
+	vroute_delete_multiple_destinations (multiSolution->MultiTo);
+    if (multiSolution->MultiFrom != NULL)
+	vroute_delete_multiple_destinations (multiSolution->MultiFrom);
+    if (multiSolution->Matrix != NULL)
+	free (multiSolution->Matrix);
+    delete_isochrone_bands (multiSolution);
+    pS = multiSolution->First;
+    while (pS != NULL)
       {
-	  ret = sqlite3_step (stmt);
-	  if (ret == SQLITE_DONE)
-	      break;
-	  if (ret == SQLITE_ROW)
-	    {
-		type = sqlite3_column_int (stmt, 0);
-		srid = sqlite3_column_int (stmt, 1);
-	    }
+	  pSn = pS->Next;
+	  delete_solution (pS);
+	  pS = pSn;
       }
-    sqlite3_finalize (stmt);
-
-    if (srid == VROUTE_INVALID_SRID)
+    pN = multiSolution->FirstNode;
+    while (pN != NULL)
       {
-	  /* it could be a Network based on some Spatial VIEW */
-	  sql =
-	      sqlite3_mprintf
-	      ("SELECT g.geometry_type, g.srid FROM views_geometry_columns AS v "
-	       "JOIN geometry_columns AS g ON (v.f_table_name = g.f_table_name "
-	       "AND v.f_geometry_column = g.f_geometry_column) "
-	       "WHERE Lower(v.view_name) = Lower(%Q) AND Lower(v.view_geometry) = Lower(%Q)",
-	       graph->TableName, graph->GeometryColumn);
-	  ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt, NULL);
-	  sqlite3_free (sql);
-	  if (ret != SQLITE_OK)
-	      return;
-	  while (1)
-	    {
-		ret = sqlite3_step (stmt);
-		if (ret == SQLITE_DONE)
-		    break;
-		if (ret == SQLITE_ROW)
-		  {
-		      type = sqlite3_column_int (stmt, 0);
-		      srid = sqlite3_column_int (stmt, 1);
-		  }
-	    }
-	  sqlite3_finalize (stmt);
+	  pNn = pN->Next;
+	  free (pN);
+	  pN = pNn;
       }
-
-    switch (type)
+    pR = multiSolution->FirstRow;
+    while (pR != NULL)
       {
-      case GAIA_POINTZ:
-      case GAIA_LINESTRINGZ:
-      case GAIA_POLYGONZ:
-      case GAIA_MULTIPOINTZ:
-      case GAIA_MULTILINESTRINGZ:
-      case GAIA_MULTIPOLYGONZ:
-      case GAIA_GEOMETRYCOLLECTIONZ:
-      case GAIA_POINTZM:
-      case GAIA_LINESTRINGZM:
-      case GAIA_POLYGONZM:
-      case GAIA_MULTIPOINTZM:
-      case GAIA_MULTILINESTRINGZM:
-      case GAIA_MULTIPOLYGONZM:
-      case GAIA_GEOMETRYCOLLECTIONZM:
-	  graph->HasZ = 1;
-	  break;
-      default:
-	  graph->HasZ = 0;
-	  break;
-      };
-    graph->Srid = srid;
+	  pRn = pR->Next;
+	  if (pR->Undefined != NULL)
+	      free (pR->Undefined);
+	  free (pR);
+	  pR = pRn;
+      }
+    pA = multiSolution->FirstLink;
+    while (pA != NULL)
+      {
+	  pAn = pA->Next;
+	  if (pA->Name)
+	      free (pA->Name);
+	  free (pA);
+	  pA = pAn;
+      }
+    pG = multiSolution->FirstGeom;
+    while (pG != NULL)
+      {
+	  pGn = pG->Next;
+	  gaiaFreeGeomColl (pG);
+	  pG = pGn;
+      }
+    free (multiSolution);
 }
 
 static void
-build_range_solution (MultiSolutionPtr multiSolution,
-		      RoutingNodePtr * range_nodes, int cnt, int srid)
+reset_multiSolution (MultiSolutionPtr multiSolution)
 {
-/* formatting the "within Cost range" solution */
-    int i;
-    if (cnt > 0)
+/* resetting the current solution */
+    ResultsetRowPtr pR;
+    ResultsetRowPtr pRn;
+    ShortestPathSolutionPtr pS;
+    ShortestPathSolutionPtr pSn;
+    RowNodeSolutionPtr pN;
+    RowNodeSolutionPtr pNn;
+    RowSolutionPtr pA;
+    RowSolutionPtr pAn;
+    gaiaGeomCollPtr pG;
+    gaiaGeomCollPtr pGn;
+    if (!multiSolution)
+	return;
+    if (multiSolution->MultiTo != NULL)
+	vroute_delete_multiple_destinations (multiSolution->MultiTo);
+    if (multiSolution->MultiFrom != NULL)
+	vroute_delete_multiple_destinations (multiSolution->MultiFrom);
+    if (multiSolution->Matrix != NULL)
+	free (multiSolution->Matrix);
+    delete_isochrone_bands (multiSolution);
+    pS = multiSolution->First;
+    while (pS != NULL)
       {
-	  /* building the solution */
-	  for (i = 0; i < cnt; i++)
-	    {
-		add_node_to_solution (multiSolution, range_nodes[i], srid, i);
-	    }
+	  pSn = pS->Next;
+	  delete_solution (pS);
+	  pS = pSn;
       }
-    if (range_nodes)
-	free (range_nodes);
+    pN = multiSolution->FirstNode;
+    while (pN != NULL)
+      {
+	  pNn = pN->Next;
+	  free (pN);
+	  pN = pNn;
+      }
+    pR = multiSolution->FirstRow;
+    while (pR != NULL)
+      {
+	  pRn = pR->Next;
+	  if (pR->Undefined != NULL)
+	      free (pR->Undefined);
+	  free (pR);
+	  pR = pRn;
+      }
+    pA = multiSolution->FirstLink;
+    while (pA != NULL)
+      {
+	  pAn = pA->Next;
+	  if (pA->Name)
+	      free (pA->Name);
+	  free (pA);
+	  pA = pAn;
+      }
+    pG = multiSolution->FirstGeom;
+    while (pG != NULL)
+      {
+	  pGn = pG->Next;
+	  gaiaFreeGeomColl (pG);
+	  pG = pGn;
+      }
+    multiSolution->From = NULL;
+    multiSolution->MultiTo = NULL;
+    multiSolution->MultiFrom = NULL;
+    multiSolution->Matrix = NULL;
+    multiSolution->First = NULL;
+    multiSolution->Last = NULL;
+    multiSolution->FirstRow = NULL;
+    multiSolution->LastRow = NULL;
+    multiSolution->FirstNode = NULL;
+    multiSolution->LastNode = NULL;
+    multiSolution->CurrentRow = NULL;
+    multiSolution->CurrentNodeRow = NULL;
+    multiSolution->CurrentRowId = 0;
+    multiSolution->FirstLink = NULL;
+    multiSolution->LastLink = NULL;
+    multiSolution->FirstGeom = NULL;
+    multiSolution->LastGeom = NULL;
 }
 
-static RouteNodePtr
-findSingleTo (RoutingMultiDestPtr multiple)
+static MultiSolutionPtr
+alloc_multiSolution (void)
 {
-/* testing for a single destination */
-    int i;
-    RouteNodePtr to = NULL;
-    int count = 0;
-    for (i = 0; i < multiple->Items; i++)
-      {
-	  RouteNodePtr p_to = *(multiple->To + i);
-	  if (p_to == NULL)
-	      continue;
-	  to = p_to;
-	  count++;
-      }
-    if (count == 1)
-	return to;
-    return NULL;
+/* allocates and initializes the current multiple-destinations solution */
+    MultiSolutionPtr p = malloc (sizeof (MultiSolution));
+    p->From = NULL;
+    p->MultiTo = NULL;
+    p->MultiFrom = NULL;
+    p->Matrix = NULL;
+    p->NumBands = 0;
+    p->Bands = NULL;
+    p->First = NULL;
+    p->Last = NULL;
+    p->FirstRow = NULL;
+    p->LastRow = NULL;
+    p->CurrentRow = NULL;
+    p->FirstNode = NULL;
+    p->LastNode = NULL;
+    p->CurrentNodeRow = NULL;
+    p->CurrentRowId = 0;
+    p->FirstLink = NULL;
+    p->LastLink = NULL;
+    p->FirstGeom = NULL;
+    p->LastGeom = NULL;
+    p->RouteNum = 0;
+    return p;
 }
 
 static void
-astar_solve (sqlite3 * handle, int options, RoutingPtr graph,
-	     RoutingNodesPtr routing, MultiSolutionPtr multiSolution)
+delete_point2PointNode (Point2PointNodePtr p)
 {
-/* computing an A* Shortest Path solution */
-    int cnt;
-    RouteLinkPtr *shortest_path;
-    ShortestPathSolutionPtr solution;
-    RouteNodePtr to = findSingleTo (multiSolution->MultiTo);
-    if (to == NULL)
-	return;
-    shortest_path =
-	astar_shortest_path (routing, graph->Nodes, multiSolution->From, to,
-			     graph->AStarHeuristicCoeff, &cnt);
-    solution = add2multiSolution (multiSolution, multiSolution->From, to);
-    build_solution (handle, options, graph, solution, shortest_path, cnt);
-    build_multi_solution (multiSolution);
+/* deleting a Point2Point Node */
+    if (p->codNode != NULL)
+	free (p->codNode);
+    free (p);
 }
 
 static void
-dijkstra_multi_solve (sqlite3 * handle, int options, RoutingPtr graph,
-		      RoutingNodesPtr routing, MultiSolutionPtr multiSolution)
+delete_point2PointCandidate (Point2PointCandidatePtr p)
 {
-/* computing a Dijkstra Shortest Path multiSolution */
-    int i;
-    RoutingMultiDestPtr multiple = multiSolution->MultiTo;
-    int node_code = graph->NodeCode;
+/* deleting a Point2Point candidate */
+    if (p->codNodeFrom != NULL)
+	free (p->codNodeFrom);
+    if (p->codNodeTo != NULL)
+	free (p->codNodeTo);
+    if (p->path != NULL)
+	gaiaFreeGeomColl (p->path);
+    free (p);
+}
 
-    dijkstra_multi_shortest_path (handle, options, graph, routing,
-				  multiSolution);
-/* testing if there are undefined or unresolved destinations */
-    for (i = 0; i < multiple->Items; i++)
+static void
+delete_point2PointSolution (Point2PointSolutionPtr p2pSolution)
+{
+/* deleting the current Point2Point solution */
+    Point2PointCandidatePtr pC;
+    Point2PointCandidatePtr pCn;
+    Point2PointNodePtr pN;
+    Point2PointNodePtr pNn;
+    ResultsetRowPtr pR;
+    ResultsetRowPtr pRn;
+    pC = p2pSolution->firstFromCandidate;
+    while (pC != NULL)
       {
-	  ShortestPathSolutionPtr row;
-	  RouteNodePtr to = *(multiple->To + i);
-	  if (node_code)
-	    {
-		/* Nodes are identified by Codes */
-		int len;
-		const char *code = *(multiple->Codes + i);
-		if (to == NULL)
-		  {
-		      row =
-			  add2multiSolution (multiSolution, multiSolution->From,
-					     NULL);
-		      len = strlen (code);
-		      row->Undefined = malloc (len + 1);
-		      strcpy (row->Undefined, code);
-		      continue;
-		  }
-		if (*(multiple->Found + i) != 'Y')
-		  {
-		      row =
-			  add2multiSolution (multiSolution, multiSolution->From,
-					     to);
-		      len = strlen (code);
-		      row->Undefined = malloc (len + 1);
-		      strcpy (row->Undefined, code);
-		  }
-	    }
-	  else
+	  pCn = pC->next;
+	  delete_point2PointCandidate (pC);
+	  pC = pCn;
+      }
+    pC = p2pSolution->firstToCandidate;
+    while (pC != NULL)
+      {
+	  pCn = pC->next;
+	  delete_point2PointCandidate (pC);
+	  pC = pCn;
+      }
+    pN = p2pSolution->firstFromNode;
+    while (pN != NULL)
+      {
+	  pNn = pN->next;
+	  delete_point2PointNode (pN);
+	  pN = pNn;
+      }
+    pN = p2pSolution->firstToNode;
+    while (pN != NULL)
+      {
+	  pNn = pN->next;
+	  delete_point2PointNode (pN);
+	  pN = pNn;
+      }
+    pR = p2pSolution->FirstRow;
+    while (pR != NULL)
+      {
+	  pRn = pR->Next;
+	  if (pR->Point2PointRole == VROUTE_POINT2POINT_START
+	      || pR->Point2PointRole == VROUTE_POINT2POINT_END)
 	    {
-		/* Nodes are identified by Ids */
-		sqlite3_int64 id = *(multiple->Ids + i);
-		if (to == NULL)
-		  {
-		      row =
-			  add2multiSolution (multiSolution, multiSolution->From,
-					     NULL);
-		      row->Undefined = malloc (4);
-		      strcpy (row->Undefined, "???");
-		      row->UndefinedId = id;
-		      continue;
-		  }
-		if (*(multiple->Found + i) != 'Y')
+		/* deleting partial Links */
+		if (pR->linkRef != NULL)
 		  {
-		      row =
-			  add2multiSolution (multiSolution, multiSolution->From,
-					     to);
-		      row->Undefined = malloc (4);
-		      strcpy (row->Undefined, "???");
-		      row->UndefinedId = id;
+		      if (pR->linkRef->Link != NULL)
+			  free (pR->linkRef->Link);
+		      if (pR->linkRef->Name != NULL)
+			  free (pR->linkRef->Name);
+		      free (pR->linkRef);
 		  }
 	    }
+	  if (pR->Geometry != NULL)
+	      gaiaFreeGeomColl (pR->Geometry);
+	  if (pR->Undefined != NULL)
+	      free (pR->Undefined);
+	  free (pR);
+	  pR = pRn;
       }
-    build_multi_solution (multiSolution);
-}
-
-static void
-dijkstra_within_cost_range (RoutingNodesPtr routing,
-			    MultiSolutionPtr multiSolution, int srid)
-{
-/* computing a Dijkstra "within cost range" solution */
-    int cnt;
-    RoutingNodePtr *range_nodes =
-	dijkstra_range_analysis (routing, multiSolution->From,
-				 multiSolution->MaxCost,
-				 &cnt);
-    build_range_solution (multiSolution, range_nodes, cnt, srid);
+    if (p2pSolution->dynLine != NULL)
+	gaiaFreeDynamicLine (p2pSolution->dynLine);
+    free (p2pSolution);
 }
 
 static void
-tsp_nn_solve (sqlite3 * handle, int options, RoutingPtr graph,
-	      RoutingNodesPtr routing, MultiSolutionPtr multiSolution)
+reset_point2PointSolution (Point2PointSolutionPtr p2pSolution)
 {
-/* computing a Dijkstra TSP NN Solution */
-    int i;
-    TspTargetsPtr targets = randomize_targets (handle, graph, multiSolution);
-    for (i = 0; i < targets->Count; i++)
+/* resetting the current solution [Point2Point] */
+    Point2PointCandidatePtr pC;
+    Point2PointCandidatePtr pCn;
+    Point2PointNodePtr pN;
+    Point2PointNodePtr pNn;
+    ResultsetRowPtr pR;
+    ResultsetRowPtr pRn;
+    p2pSolution->validFrom = 0;
+    p2pSolution->xFrom = 0.0;
+    p2pSolution->yFrom = 0.0;
+    p2pSolution->zFrom = 0.0;
+    p2pSolution->validTo = 0;
+    p2pSolution->xTo = 0.0;
+    p2pSolution->yTo = 0.0;
+    p2pSolution->zTo = 0.0;
+    p2pSolution->srid = -1;
+    pC = p2pSolution->firstFromCandidate;
+    while (pC != NULL)
       {
-	  /* checking for undefined targets */
-	  if (*(targets->To + i) == NULL)
-	      goto illegal;
+	  pCn = pC->next;
+	  delete_point2PointCandidate (pC);
+	  pC = pCn;
       }
-    dijkstra_tsp_nn (handle, options, graph, routing, targets);
-    build_tsp_solution (multiSolution, targets, graph->Srid);
-    destroy_tsp_targets (targets);
-    return;
-
-  illegal:
-    build_tsp_illegal_solution (multiSolution, targets);
-    destroy_tsp_targets (targets);
-}
-
-static void
-tsp_ga_random_solutions_sql (TspGaPopulationPtr ga)
-{
-/* building the Solutions randomizing SQL query */
-    int i;
-    char *sql;
-    char *prev_sql;
-
-    for (i = 0; i < ga->Count; i++)
+    pC = p2pSolution->firstToCandidate;
+    while (pC != NULL)
       {
-	  if (i == 0)
-	      sql = sqlite3_mprintf ("SELECT %d, Random() AS rnd\n", i);
-	  else
-	    {
-		prev_sql = sql;
-		sql =
-		    sqlite3_mprintf ("%sUNION\nSELECT %d, Random() AS rnd\n",
-				     prev_sql, i);
-		sqlite3_free (prev_sql);
-	    }
+	  pCn = pC->next;
+	  delete_point2PointCandidate (pC);
+	  pC = pCn;
       }
-    prev_sql = sql;
-    sql = sqlite3_mprintf ("%sORDER BY rnd LIMIT 2", prev_sql);
-    sqlite3_free (prev_sql);
-    ga->RandomSolutionsSql = sql;
-}
-
-static void
-tsp_ga_random_interval_sql (TspGaPopulationPtr ga)
-{
-/* building the Interval randomizing SQL query */
-    int i;
-    char *sql;
-    char *prev_sql;
-
-    for (i = 0; i < ga->Cities; i++)
+    p2pSolution->firstFromCandidate = NULL;
+    p2pSolution->lastFromCandidate = NULL;
+    p2pSolution->firstToCandidate = NULL;
+    p2pSolution->lastToCandidate = NULL;
+    pN = p2pSolution->firstFromNode;
+    while (pN != NULL)
       {
-	  if (i == 0)
-	      sql = sqlite3_mprintf ("SELECT %d, Random() AS rnd\n", i);
-	  else
-	    {
-		prev_sql = sql;
-		sql =
-		    sqlite3_mprintf ("%sUNION\nSELECT %d, Random() AS rnd\n",
-				     prev_sql, i);
-		sqlite3_free (prev_sql);
-	    }
+	  pNn = pN->next;
+	  delete_point2PointNode (pN);
+	  pN = pNn;
       }
-    prev_sql = sql;
-    sql = sqlite3_mprintf ("%sORDER BY rnd LIMIT 2", prev_sql);
-    sqlite3_free (prev_sql);
-    ga->RandomIntervalSql = sql;
-}
-
-static TspGaDistancePtr
-alloc_tsp_ga_distances (TspTargetsPtr targets)
-{
-/* allocating a TSP GA distances struct */
-    int i;
-    TspGaDistancePtr dist = malloc (sizeof (TspGaDistance));
-    dist->Cities = targets->Count;
-    dist->CityFrom = targets->From;
-    dist->Distances = malloc (sizeof (TspGaSubDistancePtr) * dist->Cities);
-    for (i = 0; i < dist->Cities; i++)
-      {
-	  TspGaSubDistancePtr sub = malloc (sizeof (TspGaSubDistance));
-	  double cost = *(targets->Costs + i);
-	  sub->CityTo = *(targets->To + i);
-	  sub->Cost = cost;
-	  *(dist->Distances + i) = sub;
-      }
-    dist->NearestIndex = -1;
-    return dist;
-}
-
-static void
-destroy_tsp_ga_distances (TspGaDistancePtr dist)
-{
-/* freeing a TSP GA distance struct */
-    if (dist == NULL)
-	return;
-    if (dist->Distances != NULL)
+    pN = p2pSolution->firstToNode;
+    while (pN != NULL)
       {
-	  int i;
-	  for (i = 0; i < dist->Cities; i++)
-	    {
-		TspGaSubDistancePtr sub = *(dist->Distances + i);
-		if (sub != NULL)
-		    free (sub);
-	    }
-	  free (dist->Distances);
+	  pNn = pN->next;
+	  delete_point2PointNode (pN);
+	  pN = pNn;
       }
-    free (dist);
-}
-
-static TspGaPopulationPtr
-build_tsp_ga_population (int count)
-{
-/* creating a TSP GA Population */
-    int i;
-    TspGaPopulationPtr ga = malloc (sizeof (TspGaPopulation));
-    ga->Count = count;
-    ga->Cities = count;
-    ga->Solutions = malloc (sizeof (TspGaSolutionPtr) * count);
-    ga->Offsprings = malloc (sizeof (TspGaSolutionPtr) * count);
-    for (i = 0; i < count; i++)
+    p2pSolution->firstFromNode = NULL;
+    p2pSolution->lastFromNode = NULL;
+    p2pSolution->firstToNode = NULL;
+    p2pSolution->lastToNode = NULL;
+    pR = p2pSolution->FirstRow;
+    while (pR != NULL)
       {
-	  *(ga->Offsprings + i) = NULL;
-	  *(ga->Solutions + i) = NULL;
+	  pRn = pR->Next;
+	  if (pR->Point2PointRole == VROUTE_POINT2POINT_START
+	      || pR->Point2PointRole == VROUTE_POINT2POINT_END)
+	    {
+		/* deleting partial Links */
+		if (pR->linkRef != NULL)
+		  {
+		      if (pR->linkRef->Link != NULL)
+			  free (pR->linkRef->Link);
+		      if (pR->linkRef->Name != NULL)
+			  free (pR->linkRef->Name);
+		      free (pR->linkRef);
+		  }
+	    }
+	  if (pR->Geometry != NULL)
+	      gaiaFreeGeomColl (pR->Geometry);
+	  if (pR->Undefined != NULL)
+	      free (pR->Undefined);
+	  free (pR);
+	  pR = pRn;
       }
-    ga->Distances = malloc (sizeof (TspGaDistancePtr) * count);
-    for (i = 0; i < count; i++)
-	*(ga->Distances + i) = NULL;
-    ga->RandomSolutionsSql = NULL;
-    tsp_ga_random_solutions_sql (ga);
-    ga->RandomIntervalSql = NULL;
-    tsp_ga_random_interval_sql (ga);
-    return ga;
+    p2pSolution->FirstRow = NULL;
+    p2pSolution->LastRow = NULL;
+    p2pSolution->CurrentRow = NULL;
+    p2pSolution->CurrentRowId = 0;
+    p2pSolution->totalCost = DBL_MAX;
+    p2pSolution->fromCandidate = NULL;
+    p2pSolution->toCandidate = NULL;
+    if (p2pSolution->dynLine != NULL)
+	gaiaFreeDynamicLine (p2pSolution->dynLine);
+    p2pSolution->dynLine = NULL;
+    p2pSolution->hasZ = 0;
+    p2pSolution->Mode = VROUTE_POINT2POINT_ERROR;
 }
 
-static void
-destroy_tsp_ga_solution (TspGaSolutionPtr solution)
+static Point2PointSolutionPtr
+alloc_point2PointSolution (void)
 {
-/* memory cleanup: destroyng a GA Solution */
-    if (solution == NULL)
-	return;
-    if (solution->CitiesFrom != NULL)
-	free (solution->CitiesFrom);
-    if (solution->CitiesTo != NULL)
-	free (solution->CitiesTo);
-    if (solution->Costs != NULL)
-	free (solution->Costs);
-    free (solution);
+/* allocates and initializes the current Point2Point solution */
+    Point2PointSolutionPtr p = malloc (sizeof (Point2PointSolution));
+    p->validFrom = 0;
+    p->xFrom = 0.0;
+    p->yFrom = 0.0;
+    p->zFrom = 0.0;
+    p->validTo = 0;
+    p->xTo = 0.0;
+    p->yTo = 0.0;
+    p->zTo = 0.0;
+    p->srid = -1;
+    p->firstFromCandidate = NULL;
+    p->lastFromCandidate = NULL;
+    p->firstToCandidate = NULL;
+    p->lastToCandidate = NULL;
+    p->firstFromNode = NULL;
+    p->lastFromNode = NULL;
+    p->firstToNode = NULL;
+    p->lastToNode = NULL;
+    p->FirstRow = NULL;
+    p->LastRow = NULL;
+    p->CurrentRow = NULL;
+    p->CurrentRowId = 0;
+    p->totalCost = DBL_MAX;
+    p->fromCandidate = NULL;
+    p->toCandidate = NULL;
+    p->dynLine = NULL;
+    p->hasZ = 0;
+    p->Mode = VROUTE_POINT2POINT_ERROR;
+    return p;
 }
 
 static void
-free_tsp_ga_offsprings (TspGaPopulationPtr ga)
+find_srid (sqlite3 * handle, RoutingPtr graph)
 {
-/* memory cleanup; freeing GA Offsprings */
-    int i;
-    if (ga == NULL)
-	return;
+/* attempting to retrieve the appropriate Srid */
+    sqlite3_stmt *stmt;
+    int ret;
+    int type = GAIA_UNKNOWN;
+    int srid = VROUTE_INVALID_SRID;
+    char *sql;
 
-    for (i = 0; i < ga->Count; i++)
-      {
-	  if (*(ga->Offsprings + i) != NULL)
-	      destroy_tsp_ga_solution (*(ga->Offsprings + i));
-	  *(ga->Offsprings + i) = NULL;
-      }
-}
+    graph->Srid = srid;
+    graph->HasZ = 0;
 
-static void
-destroy_tsp_ga_population (TspGaPopulationPtr ga)
-{
-/* memory cleanup; destroyng a GA Population */
-    int i;
-    if (ga == NULL)
+    if (graph->GeometryColumn == NULL)
 	return;
 
-    for (i = 0; i < ga->Count; i++)
-	destroy_tsp_ga_solution (*(ga->Solutions + i));
-    free (ga->Solutions);
-    free_tsp_ga_offsprings (ga);
-    free (ga->Offsprings);
-    if (ga->Distances != NULL)
+    sql =
+	sqlite3_mprintf
+	("SELECT geometry_type, srid FROM geometry_columns WHERE "
+	 "Lower(f_table_name) = Lower(%Q) AND Lower(f_geometry_column) = Lower(%Q)",
+	 graph->TableName, graph->GeometryColumn);
+    ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return;
+    while (1)
       {
-	  for (i = 0; i < ga->Cities; i++)
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;
+	  if (ret == SQLITE_ROW)
 	    {
-		TspGaDistancePtr dist = *(ga->Distances + i);
-		if (dist != NULL)
-		    destroy_tsp_ga_distances (dist);
+		type = sqlite3_column_int (stmt, 0);
+		srid = sqlite3_column_int (stmt, 1);
 	    }
       }
-    free (ga->Distances);
-    if (ga->RandomSolutionsSql != NULL)
-	sqlite3_free (ga->RandomSolutionsSql);
-    if (ga->RandomIntervalSql != NULL)
-	sqlite3_free (ga->RandomIntervalSql);
-    free (ga);
-}
-
-static int
-cmp_dist_from (const void *p1, const void *p2)
-{
-/* compares FROM distances [for BSEARCH] */
-    TspGaDistancePtr pD1 = (TspGaDistancePtr) p1;
-    TspGaDistancePtr pD2 = *((TspGaDistancePtr *) p2);
-    RouteNodePtr pN1 = pD1->CityFrom;
-    RouteNodePtr pN2 = pD2->CityFrom;
-    if (pN1 == pN2)
-	return 0;
-    if (pN1 > pN2)
-	return 1;
-    return -1;
-}
-
-static TspGaDistancePtr
-tsp_ga_find_from_distance (TspGaPopulationPtr ga, RouteNodePtr from)
-{
-/* searching the main FROM distance */
-    TspGaDistancePtr *ret;
-    TspGaDistance dist;
-    dist.CityFrom = from;
-    ret =
-	bsearch (&dist, ga->Distances, ga->Cities, sizeof (TspGaDistancePtr),
-		 cmp_dist_from);
-    if (ret == NULL)
-	return NULL;
-    return *ret;
-}
-
-static int
-cmp_dist_to (const void *p1, const void *p2)
-{
-/* compares TO distances [for BSEARCH] */
-    TspGaSubDistancePtr pD1 = (TspGaSubDistancePtr) p1;
-    TspGaSubDistancePtr pD2 = *((TspGaSubDistancePtr *) p2);
-    RouteNodePtr pN1 = pD1->CityTo;
-    RouteNodePtr pN2 = pD2->CityTo;
-    if (pN1 == pN2)
-	return 0;
-    if (pN1 > pN2)
-	return 1;
-    return -1;
-}
-
-static TspGaSubDistancePtr
-tsp_ga_find_to_distance (TspGaDistancePtr dist, RouteNodePtr to)
-{
-/* searching the main FROM distance */
-    TspGaSubDistancePtr *ret;
-    TspGaSubDistance sub;
-    sub.CityTo = to;
-    ret =
-	bsearch (&sub, dist->Distances, dist->Cities,
-		 sizeof (TspGaSubDistancePtr), cmp_dist_to);
-    if (ret == NULL)
-	return NULL;
-    return *ret;
-}
-
-static double
-tsp_ga_find_distance (TspGaPopulationPtr ga, RouteNodePtr from, RouteNodePtr to)
-{
-/* searching a cached distance */
-    TspGaSubDistancePtr sub;
-    TspGaDistancePtr dist = tsp_ga_find_from_distance (ga, from);
-    if (dist == NULL)
-	return DBL_MAX;
-
-    sub = tsp_ga_find_to_distance (dist, to);
-    if (sub != NULL)
-	return sub->Cost;
-    return DBL_MAX;
-}
-
-static void
-tsp_ga_random_solutions (sqlite3 * handle, TspGaPopulationPtr ga, int *index1,
-			 int *index2)
-{
-/* fetching two random TSP GA solutions */
-    int i;
-    int ret;
-    int n_rows;
-    int n_columns;
-    const char *value = NULL;
-    char **results;
-
-    *index1 = -1;
-    *index2 = -1;
+    sqlite3_finalize (stmt);
 
-    ret =
-	sqlite3_get_table (handle, ga->RandomSolutionsSql, &results, &n_rows,
-			   &n_columns, NULL);
-    if (ret != SQLITE_OK)
-	return;
-    if (n_rows >= 1)
+    if (srid == VROUTE_INVALID_SRID)
       {
-	  for (i = 1; i <= n_rows; i++)
+	  /* it could be a Network based on some Spatial VIEW */
+	  sql =
+	      sqlite3_mprintf
+	      ("SELECT g.geometry_type, g.srid FROM views_geometry_columns AS v "
+	       "JOIN geometry_columns AS g ON (v.f_table_name = g.f_table_name "
+	       "AND v.f_geometry_column = g.f_geometry_column) "
+	       "WHERE Lower(v.view_name) = Lower(%Q) AND Lower(v.view_geometry) = Lower(%Q)",
+	       graph->TableName, graph->GeometryColumn);
+	  ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt, NULL);
+	  sqlite3_free (sql);
+	  if (ret != SQLITE_OK)
+	      return;
+	  while (1)
 	    {
-		value = results[(i * n_columns) + 0];
-		if (i == 1)
-		    *index1 = atoi (value);
-		else
-		    *index2 = atoi (value);
+		ret = sqlite3_step (stmt);
+		if (ret == SQLITE_DONE)
+		    break;
+		if (ret == SQLITE_ROW)
+		  {
+		      type = sqlite3_column_int (stmt, 0);
+		      srid = sqlite3_column_int (stmt, 1);
+		  }
 	    }
+	  sqlite3_finalize (stmt);
       }
-    sqlite3_free_table (results);
+
+    switch (type)
+      {
+      case GAIA_POINTZ:
+      case GAIA_LINESTRINGZ:
+      case GAIA_POLYGONZ:
+      case GAIA_MULTIPOINTZ:
+      case GAIA_MULTILINESTRINGZ:
+      case GAIA_MULTIPOLYGONZ:
+      case GAIA_GEOMETRYCOLLECTIONZ:
+      case GAIA_POINTZM:
+      case GAIA_LINESTRINGZM:
+      case GAIA_POLYGONZM:
+      case GAIA_MULTIPOINTZM:
+      case GAIA_MULTILINESTRINGZM:
+      case GAIA_MULTIPOLYGONZM:
+      case GAIA_GEOMETRYCOLLECTIONZM:
+	  graph->HasZ = 1;
+	  break;
+      default:
+	  graph->HasZ = 0;
+	  break;
+      };
+    graph->Srid = srid;
 }
 
 static void
-tsp_ga_random_interval (sqlite3 * handle, TspGaPopulationPtr ga, int *index1,
-			int *index2)
+build_range_solution (MultiSolutionPtr multiSolution,
+		      RoutingNodePtr * range_nodes, int cnt, int srid)
 {
-/* fetching a random TSP GA interval */
+/* formatting the "within Cost range" solution */
     int i;
-    int ret;
-    int n_rows;
-    int n_columns;
-    const char *value = NULL;
-    char **results;
-
-    *index1 = -1;
-    *index2 = -1;
-
-    ret =
-	sqlite3_get_table (handle, ga->RandomIntervalSql, &results, &n_rows,
-			   &n_columns, NULL);
-    if (ret != SQLITE_OK)
-	return;
-    if (n_rows >= 1)
+    if (cnt > 0)
       {
-	  for (i = 1; i <= n_rows; i++)
+	  /* building the solution */
+	  for (i = 0; i < cnt; i++)
 	    {
-		value = results[(i * n_columns) + 0];
-		if (i == 1)
-		    *index1 = atoi (value);
-		else
-		    *index2 = atoi (value);
+		add_node_to_solution (multiSolution, range_nodes[i], srid, i);
 	    }
       }
-    sqlite3_free_table (results);
+    if (range_nodes)
+	free (range_nodes);
 }
 
-static void
-tps_ga_chromosome_update (TspGaSolutionPtr chromosome, RouteNodePtr from,
-			  RouteNodePtr to, double cost)
+static RouteNodePtr
+findSingleTo (RoutingMultiDestPtr multiple)
 {
-/* updating a chromosome (missing distance) */
-    int j;
-    for (j = 0; j < chromosome->Cities; j++)
+/* testing for a single destination */
+    int i;
+    RouteNodePtr to = NULL;
+    int count = 0;
+    for (i = 0; i < multiple->Items; i++)
       {
-	  RouteNodePtr n1 = *(chromosome->CitiesFrom + j);
-	  RouteNodePtr n2 = *(chromosome->CitiesTo + j);
-	  if (n1 == from && n2 == to)
-	      *(chromosome->Costs + j) = cost;
+	  RouteNodePtr p_to = *(multiple->To + i);
+	  if (p_to == NULL)
+	      continue;
+	  to = p_to;
+	  count++;
       }
+    if (count == 1)
+	return to;
+    return NULL;
 }
 
 static void
-tsp_ga_random_mutation (sqlite3 * handle, TspGaPopulationPtr ga,
-			TspGaSolutionPtr mutant)
+astar_solve (sqlite3 * handle, int options, RoutingPtr graph,
+	     RoutingNodesPtr routing, MultiSolutionPtr multiSolution)
 {
-/* introducing a random mutation */
-    RouteNodePtr mutation;
-    int j;
-    int idx1;
-    int idx2;
-
-/* applying a random mutation */
-    tsp_ga_random_interval (handle, ga, &idx1, &idx2);
-    mutation = *(mutant->CitiesFrom + idx1);
-    *(mutant->CitiesFrom + idx1) = *(mutant->CitiesFrom + idx2);
-    *(mutant->CitiesFrom + idx2) = mutation;
-
-/* adjusting From/To */
-    for (j = 1; j < mutant->Cities; j++)
-      {
-	  RouteNodePtr pFrom = *(mutant->CitiesFrom + j);
-	  *(mutant->CitiesTo + j - 1) = pFrom;
-      }
-    *(mutant->CitiesTo + mutant->Cities - 1) = *(mutant->CitiesFrom + 0);
-
-/* adjusting Costs */
-    mutant->TotalCost = 0.0;
-    for (j = 0; j < mutant->Cities; j++)
+/* computing an A* Shortest Path solution */
+    int cnt;
+    RouteLinkPtr *shortest_path;
+    ShortestPathSolutionPtr solution;
+    RouteNodePtr to = findSingleTo (multiSolution->MultiTo);
+    if (to == NULL)
+	return;
+    if (td_is_active (graph, routing))
       {
-	  RouteNodePtr pFrom = *(mutant->CitiesFrom + j);
-	  RouteNodePtr pTo = *(mutant->CitiesTo + j);
-	  double cost = tsp_ga_find_distance (ga, pFrom, pTo);
-	  tps_ga_chromosome_update (mutant, pFrom, pTo, cost);
-	  *(mutant->Costs + j) = cost;
-	  mutant->TotalCost += cost;
+	  /* edge-based A* (Turns / Time Dependent Costs) */
+	  td_shortest_path (handle, options, graph, routing, multiSolution,
+			    to);
+	  if (!end_multiTo (multiSolution->MultiTo))
+	    {
+		/* unreachable destination: empty solution */
+		shortest_path = malloc (sizeof (RouteLinkPtr));
+		solution =
+		    add2multiSolution (multiSolution, multiSolution->From, to);
+		build_solution (handle, options, graph, solution,
+				shortest_path, 0);
+	    }
+	  build_multi_solution (multiSolution);
+	  return;
       }
+    shortest_path =
+	astar_shortest_path (routing, graph->Nodes, multiSolution->From, to,
+			     graph->AStarHeuristicCoeff, &cnt);
+    solution = add2multiSolution (multiSolution, multiSolution->From, to);
+    build_solution (handle, options, graph, solution, shortest_path, cnt);
+    build_multi_solution (multiSolution);
 }
 
-static TspGaSolutionPtr
-tsp_ga_clone_solution (TspGaPopulationPtr ga, TspGaSolutionPtr original)
+static void
+dijkstra_multi_solve (sqlite3 * handle, int options, RoutingPtr graph,
+		      RoutingNodesPtr routing, MultiSolutionPtr multiSolution)
 {
-/* cloning a TSP GA solution */
-    int j;
-    TspGaSolutionPtr clone;
-    if (original == NULL)
-	return NULL;
+/* computing a Dijkstra Shortest Path multiSolution */
+    int i;
+    RoutingMultiDestPtr multiple = multiSolution->MultiTo;
+    int node_code = graph->NodeCode;
 
-    clone = malloc (sizeof (TspGaSolution));
-    clone->Cities = original->Cities;
-    clone->CitiesFrom = malloc (sizeof (RouteNodePtr) * ga->Cities);
-    clone->CitiesTo = malloc (sizeof (RouteNodePtr) * ga->Cities);
-    clone->Costs = malloc (sizeof (double) * ga->Cities);
-    for (j = 0; j < ga->Cities; j++)
+    if (td_is_active (graph, routing))
+	td_shortest_path (handle, options, graph, routing, multiSolution,
+			  NULL);
+    else
+	dijkstra_multi_shortest_path (handle, options, graph, routing,
+				      multiSolution);
+/* testing if there are undefined or unresolved destinations */
+    for (i = 0; i < multiple->Items; i++)
       {
-	  *(clone->CitiesFrom + j) = *(original->CitiesFrom + j);
-	  *(clone->CitiesTo + j) = *(original->CitiesTo + j);
-	  *(clone->Costs + j) = *(original->Costs + j);
-      }
-    clone->TotalCost = 0.0;
-    return clone;
-}
-
-static TspGaSolutionPtr
-tsp_ga_crossover (sqlite3 * handle, TspGaPopulationPtr ga, int mutation1,
-		  int mutation2)
-{
-/* creating a Crossover solution */
-    int j;
-    int idx1;
-    int idx2;
-    TspGaSolutionPtr hybrid;
-    TspGaSolutionPtr parent1 = NULL;
-    TspGaSolutionPtr parent2 = NULL;
-
-/* randomly choosing two parents */
-    tsp_ga_random_solutions (handle, ga, &idx1, &idx2);
-    if (idx1 >= 0 && idx1 < ga->Count)
-	parent1 = tsp_ga_clone_solution (ga, *(ga->Solutions + idx1));
-    if (idx2 >= 0 && idx2 < ga->Count)
-	parent2 = tsp_ga_clone_solution (ga, *(ga->Solutions + idx2));
-    if (parent1 == NULL || parent2 == NULL)
-	goto stop;
-
-    if (mutation1)
-	tsp_ga_random_mutation (handle, ga, parent1);
-    if (mutation2)
-	tsp_ga_random_mutation (handle, ga, parent2);
-
-/* creating an empty hybrid */
-    hybrid = malloc (sizeof (TspGaSolution));
-    hybrid->Cities = ga->Cities;
-    hybrid->CitiesFrom = malloc (sizeof (RouteNodePtr) * ga->Cities);
-    hybrid->CitiesTo = malloc (sizeof (RouteNodePtr) * ga->Cities);
-    hybrid->Costs = malloc (sizeof (double) * ga->Cities);
-    for (j = 0; j < ga->Cities; j++)
-      {
-	  *(hybrid->CitiesFrom + j) = NULL;
-	  *(hybrid->CitiesTo + j) = NULL;
-	  *(hybrid->Costs + j) = DBL_MAX;
+	  ShortestPathSolutionPtr row;
+	  RouteNodePtr to = *(multiple->To + i);
+	  if (node_code)
+	    {
+		/* Nodes are identified by Codes */
+		int len;
+		const char *code = *(multiple->Codes + i);
+		if (to == NULL)
+		  {
+		      row =
+			  add2multiSolution (multiSolution, multiSolution->From,
+					     NULL);
+		      len = strlen (code);
+		      row->Undefined = malloc (len + 1);
+		      strcpy (row->Undefined, code);
+		      continue;
+		  }
+		if (*(multiple->Found + i) != 'Y')
+		  {
+		      row =
+			  add2multiSolution (multiSolution, multiSolution->From,
+					     to);
+		      len = strlen (code);
+		      row->Undefined = malloc (len + 1);
+		      strcpy (row->Undefined, code);
+		  }
+	    }
+	  else
+	    {
+		/* Nodes are identified by Ids */
+		sqlite3_int64 id = *(multiple->Ids + i);
+		if (to == NULL)
+		  {
+		      row =
+			  add2multiSolution (multiSolution, multiSolution->From,
+					     NULL);
+		      row->Undefined = malloc (4);
+		      strcpy (row->Undefined, "???");
+		      row->UndefinedId = id;
+		      continue;
+		  }
+		if (*(multiple->Found + i) != 'Y')
+		  {
+		      row =
+			  add2multiSolution (multiSolution, multiSolution->From,
+					     to);
+		      row->Undefined = malloc (4);
+		      strcpy (row->Undefined, "???");
+		      row->UndefinedId = id;
+		  }
+	    }
       }
-    hybrid->TotalCost = 0.0;
+    build_multi_solution (multiSolution);
+}
 
-/* step #1: inheritance from the fist parent */
-    tsp_ga_random_interval (handle, ga, &idx1, &idx2);
-    if (idx1 < idx2)
+static void
+ch_solve (sqlite3 * handle, int options, RoutingPtr graph,
+	  ChSearchPtr search, RoutingNodesPtr routing,
+	  MultiSolutionPtr multiSolution)
+{
+/* computing a Contraction Hierarchies Shortest Path solution */
+    int cnt;
+    RouteLinkPtr *shortest_path;
+    ShortestPathSolutionPtr solution;
+    RouteNodePtr to = findSingleTo (multiSolution->MultiTo);
+    if (to == NULL)
+	return;
+    if (search == NULL || graph->ChNodes == NULL
+	|| td_is_active (graph, routing))
       {
-	  for (j = idx1; j <= idx2; j++)
-	      *(hybrid->CitiesFrom + j) = *(parent1->CitiesFrom + j);
+	  /* shortcuts ignore Turns and Time Dependent Costs */
+	  dijkstra_multi_solve (handle, options, graph, routing,
+				multiSolution);
+	  return;
       }
-    else
+    shortest_path =
+	ch_shortest_path (graph, search, multiSolution->From, to, &cnt);
+    if (shortest_path == NULL)
       {
-	  for (j = idx2; j <= idx1; j++)
-	      *(hybrid->CitiesFrom + j) = *(parent1->CitiesFrom + j);
+	  /* unexpected failure: defaulting to Dijkstra */
+	  dijkstra_multi_solve (handle, options, graph, routing,
+				multiSolution);
+	  return;
       }
+    solution = add2multiSolution (multiSolution, multiSolution->From, to);
+    build_solution (handle, options, graph, solution, shortest_path, cnt);
+    build_multi_solution (multiSolution);
+}
+
+static void
+dijkstra_within_cost_range (RoutingNodesPtr routing,
+			    MultiSolutionPtr multiSolution, int srid)
+{
+/* computing a Dijkstra "within cost range" solution */
+    int cnt;
+    RoutingNodePtr *range_nodes =
+	dijkstra_range_analysis (routing, multiSolution->From,
+				 multiSolution->MaxCost,
+				 &cnt);
+    build_range_solution (multiSolution, range_nodes, cnt, srid);
+}
+
+/*
+/
+/  implementation of Isochrones (many Cost thresholds, one single search)
+/
+////////////////////////////////////////////////////////////
+/
+/ a single Dijkstra search, bounded by the highest threshold,
+/ collects every reached Link and the Cost at its From Node;
+/ each band then buffers all its Link Geometries (partially
+/ reached Links being cut at the band threshold), so that the
+/ polygons are directly built from the network itself
+/
+*/
+
+static int
+cmp_isochrone_links (const void *p1, const void *p2)
+{
+/* compares two reached Links by Cost at the From Node [for QSORT] */
+    IsochroneLinkPtr pL1 = (IsochroneLinkPtr) p1;
+    IsochroneLinkPtr pL2 = (IsochroneLinkPtr) p2;
+    if (pL1->Start == pL2->Start)
+	return 0;
+    return (pL1->Start < pL2->Start) ? -1 : 1;
+}
+
+static int
+cmp_isochrone_rowids (const void *p1, const void *p2)
+{
+/* compares two ROWIDs [for QSORT] */
+    sqlite3_int64 r1 = *((sqlite3_int64 *) p1);
+    sqlite3_int64 r2 = *((sqlite3_int64 *) p2);
+    if (r1 == r2)
+	return 0;
+    return (r1 < r2) ? -1 : 1;
+}
+
+static int
+cmp_isochrone_geoms (const void *p1, const void *p2)
+{
+/* compares two Link Geometries by ROWID [for QSORT / BSEARCH] */
+    IsochroneGeomPtr pG1 = (IsochroneGeomPtr) p1;
+    IsochroneGeomPtr pG2 = (IsochroneGeomPtr) p2;
+    if (pG1->Rowid == pG2->Rowid)
+	return 0;
+    return (pG1->Rowid < pG2->Rowid) ? -1 : 1;
+}
 
-/* step #2: inheritance from the second parent */
-    for (j = 0; j < parent2->Cities; j++)
+static IsochroneLinkPtr
+isochrone_search (RoutingNodesPtr e, RouteNodePtr pfrom, double max_cost,
+		  int *count)
+{
+/* collecting all Links reached within the highest threshold */
+    int i;
+    RoutingNodePtr p_to;
+    RoutingNodePtr n;
+    RouteLinkPtr p_link;
+    int cnt = 0;
+    int max = 1024;
+    IsochroneLinkPtr result;
+    RoutingHeapPtr heap;
+/* starting a new search (lazily resetting the graph and the heap) */
+    heap = routing_begin (e);
+    result = malloc (sizeof (IsochroneLink) * max);
+/* queuing the From node into the heap */
+    n = routing_node (e, e->Nodes + pfrom->InternalIndex);
+    n->Distance = 0.0;
+    dijkstra_enqueue (heap, n);
+    while (heap->Count > 0)
       {
-	  RouteNodePtr p2From = *(parent2->CitiesFrom + j);
-	  int k;
-	  int found = 0;
-	  if (p2From == NULL)
-	      continue;
-	  for (k = 0; k < hybrid->Cities; k++)
+	  /* Dijsktra loop */
+	  n = routing_dequeue (heap);
+	  n->Inspected = 1;
+	  for (i = 0; i < n->DimTo; i++)
 	    {
-		RouteNodePtr p1From = *(hybrid->CitiesFrom + k);
-		if (p1From == NULL)
-		    continue;
-		if (p1From == p2From)
+		p_to = routing_node (e, *(n->To + i));
+		p_link = *(n->Link + i);
+		if (n->Distance < max_cost)
 		  {
-		      /* already present: skipping */
-		      found = 1;
-		      break;
+		      /* this Link is reached (at least partially) */
+		      if (cnt >= max)
+			{
+			    max *= 2;
+			    result =
+				realloc (result, sizeof (IsochroneLink) * max);
+			}
+		      result[cnt].Link = p_link;
+		      result[cnt].Start = n->Distance;
+		      cnt++;
 		  }
-	    }
-	  if (found)
-	      continue;
-	  for (k = 0; k < hybrid->Cities; k++)
-	    {
-		if (*(hybrid->CitiesFrom + k) == NULL
-		    && *(hybrid->CitiesTo + k) == NULL
-		    && *(hybrid->Costs + k) == DBL_MAX)
+		if (p_to->Inspected == 0)
 		  {
-		      /* found an empty slot: inserting */
-		      *(hybrid->CitiesFrom + k) = p2From;
-		      break;
+		      if (p_to->Distance == DBL_MAX)
+			{
+			    /* queuing a new node into the heap */
+			    if (n->Distance + p_link->Cost <= max_cost)
+			      {
+				  p_to->Distance = n->Distance + p_link->Cost;
+				  p_to->PreviousNode = n;
+				  p_to->xLink = p_link;
+				  dijkstra_enqueue (heap, p_to);
+			      }
+			}
+		      else if (p_to->Distance > n->Distance + p_link->Cost)
+			{
+			    /* updating an already inserted node */
+			    p_to->Distance = n->Distance + p_link->Cost;
+			    p_to->PreviousNode = n;
+			    p_to->xLink = p_link;
+			}
 		  }
 	    }
       }
-    destroy_tsp_ga_solution (parent1);
-    destroy_tsp_ga_solution (parent2);
-
-/* adjusting From/To */
-    for (j = 1; j < hybrid->Cities; j++)
-      {
-	  RouteNodePtr p1From = *(hybrid->CitiesFrom + j);
-	  *(hybrid->CitiesTo + j - 1) = p1From;
-      }
-    *(hybrid->CitiesTo + hybrid->Cities - 1) = *(hybrid->CitiesFrom + 0);
+/* sorting the reached Links by Cost, so that each band is a prefix */
+    qsort (result, cnt, sizeof (IsochroneLink), cmp_isochrone_links);
+    *count = cnt;
+    return result;
+}
 
-/* retrieving cached costs */
-    for (j = 0; j < hybrid->Cities; j++)
+static void
+isochrone_free_geoms (IsochroneGeomPtr geoms, int count)
+{
+/* memory cleanup; freeing the Link Geometries */
+    int i;
+    for (i = 0; i < count; i++)
       {
-	  RouteNodePtr pFrom = *(hybrid->CitiesFrom + j);
-	  RouteNodePtr pTo = *(hybrid->CitiesTo + j);
-	  double cost = tsp_ga_find_distance (ga, pFrom, pTo);
-	  tps_ga_chromosome_update (hybrid, pFrom, pTo, cost);
-	  hybrid->TotalCost += cost;
+	  IsochroneGeomPtr pG = geoms + i;
+	  if (pG->FromCode != NULL)
+	      free (pG->FromCode);
+	  if (pG->Geometry != NULL)
+	      gaiaFreeGeomColl (pG->Geometry);
       }
-    return hybrid;
-
-  stop:
-    if (parent1 != NULL)
-	destroy_tsp_ga_solution (parent1);
-    if (parent2 != NULL)
-	destroy_tsp_ga_solution (parent2);
-    return NULL;
+    free (geoms);
 }
 
-static void
-evalTspGaFitness (TspGaPopulationPtr ga)
+static IsochroneGeomPtr
+isochrone_fetch_geoms (sqlite3 * handle, RoutingPtr graph,
+		       IsochroneLinkPtr links, int n_links, int *count)
 {
-/* evaluating the comparative fitness of parents and offsprings */
-    int j;
+/* reading the Geometries of all reached Links */
     int i;
-    int index;
-    int already_defined = 0;
+    int j;
+    int cnt = 0;
+    int base;
+    int ret;
+    int block = 128;
+    int how_many;
+    char *xfrom;
+    char *xto;
+    char *xgeom;
+    char *xtable;
+    char *prefix;
+    sqlite3_stmt *stmt = NULL;
+    sqlite3_int64 *rowids;
+    IsochroneGeomPtr geoms;
+    gaiaOutBuffer sql_statement;
 
-    for (j = 0; j < ga->Count; j++)
+    *count = 0;
+    rowids = malloc (sizeof (sqlite3_int64) * (n_links + 1));
+    for (i = 0; i < n_links; i++)
+	rowids[i] = links[i].Link->LinkRowid;
+    qsort (rowids, n_links, sizeof (sqlite3_int64), cmp_isochrone_rowids);
+    for (i = 0; i < n_links; i++)
       {
-	  /* evaluating an offsprings */
-	  double max_cost = 0.0;
-	  TspGaSolutionPtr hybrid = *(ga->Offsprings + j);
+	  /* removing duplicate ROWIDs (e.g. bidirectional Links) */
+	  if (cnt > 0 && rowids[cnt - 1] == rowids[i])
+	      continue;
+	  rowids[cnt++] = rowids[i];
+      }
+    geoms = malloc (sizeof (IsochroneGeom) * (cnt + 1));
 
-	  for (i = 0; i < ga->Count; i++)
+    xfrom = gaiaDoubleQuotedSql (graph->FromColumn);
+    xto = gaiaDoubleQuotedSql (graph->ToColumn);
+    xgeom = gaiaDoubleQuotedSql (graph->GeometryColumn);
+    xtable = gaiaDoubleQuotedSql (graph->TableName);
+    prefix =
+	sqlite3_mprintf
+	("SELECT ROWID, \"%s\", \"%s\", \"%s\" FROM \"%s\" WHERE ROWID IN (",
+	 xfrom, xto, xgeom, xtable);
+    free (xfrom);
+    free (xto);
+    free (xgeom);
+    free (xtable);
+    for (base = 0; base < cnt; base += block)
+      {
+	  /* requesting max 128 links at each time */
+	  how_many = cnt - base;
+	  if (how_many > block)
+	      how_many = block;
+	  gaiaOutBufferInitialize (&sql_statement);
+	  gaiaAppendToOutBuffer (&sql_statement, prefix);
+	  for (i = 0; i < how_many; i++)
 	    {
-		/* searching the worst parent */
-		TspGaSolutionPtr old = *(ga->Solutions + i);
-		if (old->TotalCost > max_cost)
-		  {
-		      max_cost = old->TotalCost;
-		      index = i;
-		  }
-		if (old->TotalCost == hybrid->TotalCost)
-		    already_defined = 1;
+		if (i == 0)
+		    gaiaAppendToOutBuffer (&sql_statement, "?");
+		else
+		    gaiaAppendToOutBuffer (&sql_statement, ", ?");
 	    }
-	  if (max_cost > hybrid->TotalCost && !already_defined)
+	  gaiaAppendToOutBuffer (&sql_statement, ")");
+	  ret =
+	      sqlite3_prepare_v2 (handle, sql_statement.Buffer,
+				  strlen (sql_statement.Buffer), &stmt, NULL);
+	  gaiaOutBufferReset (&sql_statement);
+	  if (ret != SQLITE_OK)
+	      break;
+	  for (i = 0; i < how_many; i++)
+	      sqlite3_bind_int64 (stmt, i + 1, rowids[base + i]);
+	  while (1)
 	    {
-		/* inserting the new hybrid by replacing the worst parent */
-		TspGaSolutionPtr kill = *(ga->Solutions + index);
-		*(ga->Solutions + index) = hybrid;
-		*(ga->Offsprings + j) = NULL;
-		destroy_tsp_ga_solution (kill);
+		ret = sqlite3_step (stmt);
+		if (ret == SQLITE_DONE)
+		    break;
+		if (ret != SQLITE_ROW)
+		    break;
+		if (sqlite3_column_type (stmt, 3) == SQLITE_BLOB)
+		  {
+		      IsochroneGeomPtr pG = geoms + *count;
+		      const unsigned char *blob = sqlite3_column_blob (stmt, 3);
+		      int size = sqlite3_column_bytes (stmt, 3);
+		      pG->Geometry = gaiaFromSpatiaLiteBlobWkb (blob, size);
+		      if (pG->Geometry == NULL
+			  || pG->Geometry->FirstLinestring == NULL)
+			{
+			    if (pG->Geometry != NULL)
+				gaiaFreeGeomColl (pG->Geometry);
+			    continue;
+			}
+		      pG->Rowid = sqlite3_column_int64 (stmt, 0);
+		      pG->FromId = 0;
+		      pG->FromCode = NULL;
+		      if (graph->NodeCode)
+			{
+			    const char *code =
+				(const char *) sqlite3_column_text (stmt, 1);
+			    if (code != NULL)
+			      {
+				  j = strlen (code);
+				  pG->FromCode = malloc (j + 1);
+				  strcpy (pG->FromCode, code);
+			      }
+			}
+		      else
+			  pG->FromId = sqlite3_column_int64 (stmt, 1);
+		      *count += 1;
+		  }
 	    }
+	  sqlite3_finalize (stmt);
       }
+    sqlite3_free (prefix);
+    free (rowids);
+    qsort (geoms, *count, sizeof (IsochroneGeom), cmp_isochrone_geoms);
+    return geoms;
 }
 
-static MultiSolutionPtr
-tsp_ga_compute_route (sqlite3 * handle, int options, RouteNodePtr origin,
-		      RouteNodePtr destination, RoutingPtr graph,
-		      RoutingNodesPtr routing)
+static void
+isochrone_get_point (gaiaLinestringPtr ln, int iv, double *x, double *y)
 {
-/* computing a route from City to City */
-    RoutingMultiDestPtr to = NULL;
-    MultiSolutionPtr ms = alloc_multiSolution ();
-    ms->From = origin;
-    to = malloc (sizeof (RoutingMultiDest));
-    ms->MultiTo = to;
-    to->CodeNode = graph->NodeCode;
-    to->Found = malloc (sizeof (char));
-    to->To = malloc (sizeof (RouteNodePtr));
-    *(to->Found + 0) = 'N';
-    *(to->To + 0) = destination;
-    to->Items = 1;
-    to->Next = 0;
-    if (graph->NodeCode)
+/* retrieving a 2D Point from a Linestring of any dimension */
+    double z;
+    double m;
+    if (ln->DimensionModel == GAIA_XY_Z)
       {
-	  int len = strlen (destination->Code);
-	  to->Ids = NULL;
-	  to->Codes = malloc (sizeof (char *));
-	  *(to->Codes + 0) = malloc (len + 1);
-	  strcpy (*(to->Codes + 0), destination->Code);
+	  gaiaGetPointXYZ (ln->Coords, iv, x, y, &z);
+      }
+    else if (ln->DimensionModel == GAIA_XY_M)
+      {
+	  gaiaGetPointXYM (ln->Coords, iv, x, y, &m);
+      }
+    else if (ln->DimensionModel == GAIA_XY_Z_M)
+      {
+	  gaiaGetPointXYZM (ln->Coords, iv, x, y, &z, &m);
       }
     else
       {
-	  to->Ids = malloc (sizeof (sqlite3_int64));
-	  to->Codes = NULL;
-	  *(to->Ids + 0) = destination->Id;
+	  gaiaGetPoint (ln->Coords, iv, x, y);
       }
-
-    dijkstra_multi_shortest_path (handle, options, graph, routing, ms);
-    return (ms);
 }
 
 static void
-completing_tsp_ga_solution (sqlite3 * handle, int options,
-			    RouteNodePtr origin, RouteNodePtr destination,
-			    RoutingPtr graph, RoutingNodesPtr routing,
-			    TspTargetsPtr targets, int j)
+isochrone_add_line (gaiaGeomCollPtr lines, gaiaLinestringPtr ln,
+		    int reverse, double fraction, double *buf)
 {
-/* completing a TSP GA solution */
-    ShortestPathSolutionPtr solution;
-    MultiSolutionPtr result =
-	tsp_ga_compute_route (handle, options, origin, destination, graph,
-			      routing);
-
-    solution = result->First;
-    while (solution != NULL)
+/*
+/ adding a reached Link to the band Geometry; a partially
+/ reached Link is cut at the given fraction of its length
+/ (starting from its end if it's traversed in reverse)
+*/
+    int iv;
+    int cnt = 0;
+    double x;
+    double y;
+    double x0 = 0.0;
+    double y0 = 0.0;
+    double len = 0.0;
+    double target;
+    double walked = 0.0;
+    gaiaLinestringPtr out;
+    if (fraction > 1.0)
+	fraction = 1.0;
+    for (iv = 1; iv < ln->Points; iv++)
+      {
+	  isochrone_get_point (ln, iv - 1, &x0, &y0);
+	  isochrone_get_point (ln, iv, &x, &y);
+	  len += sqrt (((x - x0) * (x - x0)) + ((y - y0) * (y - y0)));
+      }
+    target = len * fraction;
+    for (iv = 0; iv < ln->Points; iv++)
       {
-	  RowSolutionPtr old;
-	  ShortestPathSolutionPtr newSolution = alloc_solution ();
-	  newSolution->From = origin;
-	  newSolution->To = destination;
-	  newSolution->TotalCost += solution->TotalCost;
-	  targets->TotalCost += solution->TotalCost;
-	  newSolution->Geometry = solution->Geometry;
-	  solution->Geometry = NULL;
-	  if (j < 0)
-	      targets->LastSolution = newSolution;
-	  else
-	      *(targets->Solutions + j) = newSolution;
-	  old = solution->First;
-	  while (old != NULL)
+	  isochrone_get_point (ln, reverse ? ln->Points - 1 - iv : iv, &x, &y);
+	  if (iv > 0)
 	    {
-		/* inserts a Link into the Shortest Path solution */
-		RowSolutionPtr p = malloc (sizeof (RowSolution));
-		p->Link = old->Link;
-		p->Name = old->Name;
-		old->Name = NULL;
-		p->Next = NULL;
-		if (!(newSolution->First))
-		    newSolution->First = p;
-		if (newSolution->Last)
-		    newSolution->Last->Next = p;
-		newSolution->Last = p;
-		old = old->Next;
+		double seg =
+		    sqrt (((x - x0) * (x - x0)) + ((y - y0) * (y - y0)));
+		if (walked + seg >= target && fraction < 1.0)
+		  {
+		      /* cutting the Link at the threshold */
+		      double ratio = (seg > 0.0) ? (target - walked) / seg : 0.0;
+		      buf[cnt * 2] = x0 + ((x - x0) * ratio);
+		      buf[(cnt * 2) + 1] = y0 + ((y - y0) * ratio);
+		      cnt++;
+		      break;
+		  }
+		walked += seg;
 	    }
-	  solution = solution->Next;
+	  buf[cnt * 2] = x;
+	  buf[(cnt * 2) + 1] = y;
+	  cnt++;
+	  x0 = x;
+	  y0 = y;
       }
-    delete_multiSolution (result);
+    if (cnt < 2)
+	return;
+    out = gaiaAddLinestringToGeomColl (lines, cnt);
+    for (iv = 0; iv < cnt; iv++)
+	gaiaSetPoint (out->Coords, iv, buf[iv * 2], buf[(iv * 2) + 1]);
 }
 
-static void
-set_tsp_ga_targets (sqlite3 * handle, int options, RoutingPtr graph,
-		    RoutingNodesPtr routing, TspGaSolutionPtr bestSolution,
-		    TspTargetsPtr targets)
+static int
+isochrone_is_reverse (RoutingPtr graph, IsochroneGeomPtr geom,
+		      RouteLinkPtr link)
 {
-/* preparing TSP GA targets (best solution found) */
-    int j;
-    RouteNodePtr from;
-    RouteNodePtr to;
-
-    for (j = 0; j < targets->Count; j++)
+/* checking if a Link is traversed against its Geometry orientation */
+    RouteNodePtr from = route_link_from (graph, link);
+    if (graph->NodeCode)
       {
-	  from = *(bestSolution->CitiesFrom + j);
-	  to = *(bestSolution->CitiesTo + j);
-	  completing_tsp_ga_solution (handle, options, from, to, graph, routing,
-				      targets, j);
-	  *(targets->To + j) = to;
-	  *(targets->Found + j) = 'Y';
+	  const char *code = route_node_code (graph, from);
+	  if (code == NULL || geom->FromCode == NULL)
+	      return 0;
+	  return strcmp (code, geom->FromCode) != 0;
       }
-    /* this is the final City closing the circular path */
-    from = *(bestSolution->CitiesFrom + targets->Count);
-    to = *(bestSolution->CitiesTo + targets->Count);
-    completing_tsp_ga_solution (handle, options, from, to, graph, routing,
-				targets, -1);
+    return from->Id != geom->FromId;
 }
 
-static TspTargetsPtr
-build_tsp_ga_solution_targets (int count, RouteNodePtr from)
+static void
+isochrone_build_band (sqlite3_stmt * stmt, RoutingPtr graph,
+		      IsochroneLinkPtr links, int n_links,
+		      IsochroneGeomPtr geoms, int n_geoms, double radius,
+		      IsochroneBandPtr band, double *buf)
 {
-/* creating and initializing the TSP helper struct - final solution */
+/* building the polygon of a single band */
     int i;
-    TspTargetsPtr targets = malloc (sizeof (TspTargets));
-    targets->Mode = VROUTE_TSP_SOLUTION;
-    targets->TotalCost = 0.0;
-    targets->Count = count;
-    targets->To = malloc (sizeof (RouteNodePtr *) * targets->Count);
-    targets->Found = malloc (sizeof (char) * targets->Count);
-    targets->Costs = malloc (sizeof (double) * targets->Count);
-    targets->Solutions =
-	malloc (sizeof (ShortestPathSolutionPtr) * targets->Count);
-    targets->LastSolution = NULL;
-    targets->From = from;
-    for (i = 0; i < targets->Count; i++)
+    IsochroneGeom key;
+    IsochroneGeomPtr geom;
+    gaiaGeomCollPtr lines;
+    unsigned char *blob;
+    int size;
+    lines = gaiaAllocGeomColl ();
+    lines->Srid = graph->Srid;
+    for (i = 0; i < n_links; i++)
+      {
+	  IsochroneLinkPtr pL = links + i;
+	  double fraction = 1.0;
+	  if (pL->Start >= band->Cost)
+	      break;		/* Links are sorted by Cost */
+	  key.Rowid = pL->Link->LinkRowid;
+	  geom =
+	      bsearch (&key, geoms, n_geoms, sizeof (IsochroneGeom),
+		       cmp_isochrone_geoms);
+	  if (geom == NULL)
+	      continue;
+	  if (pL->Link->Cost > 0.0)
+	      fraction = (band->Cost - pL->Start) / pL->Link->Cost;
+	  isochrone_add_line (lines, geom->Geometry->FirstLinestring,
+			      isochrone_is_reverse (graph, geom, pL->Link),
+			      fraction, buf);
+      }
+    if (lines->FirstLinestring != NULL)
       {
-	  *(targets->To + i) = NULL;
-	  *(targets->Found + i) = 'N';
-	  *(targets->Costs + i) = DBL_MAX;
-	  *(targets->Solutions + i) = NULL;
+	  /* buffering all reached Links */
+	  gaiaToSpatiaLiteBlobWkb (lines, &blob, &size);
+	  sqlite3_reset (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  sqlite3_bind_blob (stmt, 1, blob, size, free);
+	  sqlite3_bind_double (stmt, 2, radius);
+	  if (sqlite3_step (stmt) == SQLITE_ROW
+	      && sqlite3_column_type (stmt, 0) == SQLITE_BLOB)
+	    {
+		size = sqlite3_column_bytes (stmt, 0);
+		band->Blob = malloc (size);
+		memcpy (band->Blob, sqlite3_column_blob (stmt, 0), size);
+		band->Size = size;
+	    }
       }
-    return targets;
+    gaiaFreeGeomColl (lines);
 }
 
-static TspTargetsPtr
-tsp_ga_permuted_targets (RouteNodePtr from, RoutingMultiDestPtr multi,
-			 int index)
+static void
+isochrones_solve (sqlite3 * handle, RoutingPtr graph,
+		  RoutingNodesPtr routing, MultiSolutionPtr multiSolution,
+		  double radius)
 {
-/* initializing the TSP helper struct - permuted */
+/* computing an Isochrones solution: one polygon for each band */
     int i;
-    TspTargetsPtr targets = malloc (sizeof (TspTargets));
-    targets->Mode = VROUTE_ROUTING_SOLUTION;
-    targets->TotalCost = 0.0;
-    targets->Count = multi->Items;
-    targets->To = malloc (sizeof (RouteNodePtr *) * targets->Count);
-    targets->Found = malloc (sizeof (char) * targets->Count);
-    targets->Costs = malloc (sizeof (double) * targets->Count);
-    targets->Solutions =
-	malloc (sizeof (ShortestPathSolutionPtr) * targets->Count);
-    targets->LastSolution = NULL;
-    if (index < 0)
+    int n_links;
+    int n_geoms = 0;
+    int max_points = 0;
+    IsochroneLinkPtr links;
+    IsochroneGeomPtr geoms;
+    sqlite3_stmt *stmt;
+    double *buf;
+    links =
+	isochrone_search (routing, multiSolution->From,
+			  multiSolution->MaxCost, &n_links);
+    if (graph->GeometryColumn == NULL || graph->Srid == VROUTE_INVALID_SRID
+	|| n_links == 0)
+      {
+	  /* no Geometries at all */
+	  free (links);
+	  return;
+      }
+    if (sqlite3_prepare_v2
+	(handle, "SELECT ST_Buffer(?, ?, 8)", -1, &stmt, NULL) != SQLITE_OK)
       {
-	  /* no permutation */
-	  targets->From = from;
-	  for (i = 0; i < targets->Count; i++)
-	    {
-		*(targets->To + i) = *(multi->To + i);
-		*(targets->Found + i) = 'N';
-		*(targets->Costs + i) = DBL_MAX;
-		*(targets->Solutions + i) = NULL;
-	    }
+	  free (links);
+	  return;
       }
-    else
+    geoms = isochrone_fetch_geoms (handle, graph, links, n_links, &n_geoms);
+    for (i = 0; i < n_geoms; i++)
       {
-	  /* permuting */
-	  targets->From = *(multi->To + index);
-	  for (i = 0; i < targets->Count; i++)
-	    {
-		if (i == index)
-		  {
-		      *(targets->To + i) = from;
-		      *(targets->Found + i) = 'N';
-		      *(targets->Costs + i) = DBL_MAX;
-		      *(targets->Solutions + i) = NULL;
-		  }
-		else
-		  {
-		      *(targets->To + i) = *(multi->To + i);
-		      *(targets->Found + i) = 'N';
-		      *(targets->Costs + i) = DBL_MAX;
-		      *(targets->Solutions + i) = NULL;
-		  }
-	    }
+	  gaiaLinestringPtr ln = geoms[i].Geometry->FirstLinestring;
+	  if (ln->Points > max_points)
+	      max_points = ln->Points;
       }
-    return targets;
+    buf = malloc (sizeof (double) * 2 * (max_points + 1));
+    for (i = 0; i < multiSolution->NumBands; i++)
+	isochrone_build_band (stmt, graph, links, n_links, geoms, n_geoms,
+			      radius, multiSolution->Bands + i, buf);
+    sqlite3_finalize (stmt);
+    free (buf);
+    isochrone_free_geoms (geoms, n_geoms);
+    free (links);
 }
 
-static int
-build_tsp_nn_solution (TspGaPopulationPtr ga, TspTargetsPtr targets, int index)
+/* END of Isochrones implementation */
+
+static void
+tsp_nn_solve (sqlite3 * handle, int options, RoutingPtr graph,
+	      RoutingNodesPtr routing, MultiSolutionPtr multiSolution)
 {
-/* building a TSP NN solution */
-    int j;
+/* computing a Dijkstra TSP NN Solution */
     int i;
-    RouteNodePtr origin;
-    TspGaDistancePtr dist;
-    TspGaSubDistancePtr sub;
-    RouteNodePtr destination;
-    double cost;
-    TspGaSolutionPtr solution = malloc (sizeof (TspGaSolution));
-    solution->Cities = targets->Count + 1;
-    solution->CitiesFrom = malloc (sizeof (RouteNodePtr) * solution->Cities);
-    solution->CitiesTo = malloc (sizeof (RouteNodePtr) * solution->Cities);
-    solution->Costs = malloc (sizeof (double) * solution->Cities);
-    solution->TotalCost = 0.0;
-
-    origin = targets->From;
-    for (j = 0; j < targets->Count; j++)
-      {
-	  /* searching the nearest City */
-	  dist = tsp_ga_find_from_distance (ga, origin);
-	  if (dist == NULL)
-	      return 0;
-	  destination = NULL;
-	  cost = DBL_MAX;
-
-	  sub = *(dist->Distances + dist->NearestIndex);
-	  destination = sub->CityTo;
-	  cost = sub->Cost;
-	  /* excluding the last City (should be a closed circuit) */
-	  if (destination == targets->From)
-	      destination = NULL;
-	  if (destination != NULL)
-	    {
-		for (i = 0; i < targets->Count; i++)
-		  {
-		      /* checking if this City was already reached */
-		      RouteNodePtr city = *(targets->To + i);
-		      if (city == destination)
-			{
-			    if (*(targets->Found + i) == 'Y')
-				destination = NULL;
-			    else
-				*(targets->Found + i) = 'Y';
-			    break;
-			}
-		  }
-	    }
-	  if (destination == NULL)
-	    {
-		/* searching for an alternative destination */
-		double min = DBL_MAX;
-		int ind = -1;
-		int k;
-		for (k = 0; k < dist->Cities; k++)
-		  {
-		      sub = *(dist->Distances + k);
-		      RouteNodePtr city = sub->CityTo;
-		      /* excluding the last City (should be a closed circuit) */
-		      if (city == targets->From)
-			  continue;
-		      for (i = 0; i < targets->Count; i++)
-			{
-			    RouteNodePtr city2 = *(targets->To + i);
-			    if (*(targets->Found + i) == 'Y')
-				continue;
-			    if (city == city2)
-			      {
-				  if (sub->Cost < min)
-				    {
-					min = sub->Cost;
-					ind = k;
-				    }
-			      }
-			}
-		  }
-		if (ind >= 0)
-		  {
-		      sub = *(dist->Distances + ind);
-		      destination = sub->CityTo;
-		      cost = min;
-		      for (i = 0; i < targets->Count; i++)
-			{
-			    RouteNodePtr city = *(targets->To + i);
-			    if (city == destination)
-			      {
-				  *(targets->Found + i) = 'Y';
-				  break;
-			      }
-			}
-		  }
-	    }
-	  if (destination == NULL)
-	      return 0;
-	  *(solution->CitiesFrom + j) = origin;
-	  *(solution->CitiesTo + j) = destination;
-	  *(solution->Costs + j) = cost;
-	  solution->TotalCost += cost;
-	  origin = destination;
-      }
-
-/* returning to FROM so to close the circular path */
-    destination = targets->From;
-    for (i = 0; i < ga->Cities; i++)
+    TspTargetsPtr targets = randomize_targets (handle, graph, multiSolution);
+    for (i = 0; i < targets->Count; i++)
       {
-	  TspGaDistancePtr d = *(ga->Distances + i);
-	  if (d->CityFrom == origin)
-	    {
-		int k;
-		dist = *(ga->Distances + i);
-		for (k = 0; k < dist->Cities; k++)
-		  {
-		      sub = *(dist->Distances + k);
-		      RouteNodePtr city = sub->CityTo;
-		      if (city == destination)
-			{
-			    cost = sub->Cost;
-			    *(solution->CitiesFrom + targets->Count) = origin;
-			    *(solution->CitiesTo + targets->Count) =
-				destination;
-			    *(solution->Costs + targets->Count) = cost;
-			    solution->TotalCost += cost;
-			}
-		  }
-	    }
+	  /* checking for undefined targets */
+	  if (*(targets->To + i) == NULL)
+	      goto illegal;
       }
+    dijkstra_tsp_nn (handle, options, graph, routing, targets);
+    build_tsp_solution (multiSolution, targets, graph->Srid);
+    destroy_tsp_targets (targets);
+    return;
 
-/* inserting into the GA population */
-    *(ga->Solutions + index) = solution;
-    return 1;
-}
-
-static int
-cmp_nodes_addr (const void *p1, const void *p2)
-{
-/* compares two nodes  by addr [for QSORT] */
-    TspGaDistancePtr pD1 = *((TspGaDistancePtr *) p1);
-    TspGaDistancePtr pD2 = *((TspGaDistancePtr *) p2);
-    RouteNodePtr pN1 = pD1->CityFrom;
-    RouteNodePtr pN2 = pD2->CityFrom;
-    if (pN1 == pN2)
-	return 0;
-    if (pN1 > pN2)
-	return 1;
-    return -1;
+  illegal:
+    build_tsp_illegal_solution (multiSolution, targets);
+    destroy_tsp_targets (targets);
 }
 
-static int
-cmp_dist_addr (const void *p1, const void *p2)
-{
-/* compares two nodes  by addr [for QSORT] */
-    TspGaSubDistancePtr pD1 = *((TspGaSubDistancePtr *) p1);
-    TspGaSubDistancePtr pD2 = *((TspGaSubDistancePtr *) p2);
-    RouteNodePtr pN1 = pD1->CityTo;
-    RouteNodePtr pN2 = pD2->CityTo;
-    if (pN1 == pN2)
-	return 0;
-    if (pN1 > pN2)
-	return 1;
-    return -1;
+static TspGaPopulationPtr
+build_tsp_ga_population (int count)
+{
+/* creating a TSP GA Population */
+    TspGaPopulationPtr ga = malloc (sizeof (TspGaPopulation));
+    ga->Count = count;
+    ga->Cities = count;
+    ga->Nodes = NULL;
+    ga->Matrix = NULL;
+    return ga;
 }
 
 static void
-tsp_ga_sort_distances (TspGaPopulationPtr ga)
+destroy_tsp_ga_solution (TspGaSolutionPtr solution)
 {
-/* sorting Distances/Costs by Node addr */
-    int i;
-    qsort (ga->Distances, ga->Cities, sizeof (RouteNodePtr), cmp_nodes_addr);
-    for (i = 0; i < ga->Cities; i++)
-      {
-	  TspGaDistancePtr dist = *(ga->Distances + i);
-	  qsort (dist->Distances, dist->Cities, sizeof (TspGaSubDistancePtr),
-		 cmp_dist_addr);
-      }
-    for (i = 0; i < ga->Cities; i++)
-      {
-	  int k;
-	  int index = -1;
-	  double min = DBL_MAX;
-	  TspGaDistancePtr dist = *(ga->Distances + i);
-	  for (k = 0; k < dist->Cities; k++)
-	    {
-		TspGaSubDistancePtr sub = *(dist->Distances + k);
-		if (sub->Cost < min)
-		  {
-		      min = sub->Cost;
-		      index = k;
-		  }
-	    }
-	  if (index >= 0)
-	      dist->NearestIndex = index;
-      }
+/* memory cleanup: destroyng a GA Solution */
+    if (solution == NULL)
+	return;
+    if (solution->CitiesFrom != NULL)
+	free (solution->CitiesFrom);
+    if (solution->CitiesTo != NULL)
+	free (solution->CitiesTo);
+    if (solution->Costs != NULL)
+	free (solution->Costs);
+    free (solution);
 }
 
 static void
-tsp_ga_solve (sqlite3 * handle, int options, RoutingPtr graph,
-	      RoutingNodesPtr routing, MultiSolutionPtr multiSolution)
+destroy_tsp_ga_population (TspGaPopulationPtr ga)
 {
-/* computing a Dijkstra TSP GA Solution */
-    int i;
-    int j;
-    double min;
-    TspGaSolutionPtr bestSolution;
-    int count = 0;
-    int max_iterations = VROUTE_TSP_GA_MAX_ITERATIONS;
-    TspGaPopulationPtr ga = NULL;
-    RoutingMultiDestPtr multi;
-    TspTargetsPtr targets;
-    TspGaDistancePtr dist;
-
-    if (multiSolution == NULL)
-	return;
-    multi = multiSolution->MultiTo;
-    if (multi == NULL)
+/* memory cleanup; destroyng a GA Population */
+    if (ga == NULL)
 	return;
+    if (ga->Nodes != NULL)
+	free (ga->Nodes);
+    if (ga->Matrix != NULL)
+	free (ga->Matrix);
+    free (ga);
+}
 
-/* initialinzing the TSP GA helper struct */
-    ga = build_tsp_ga_population (multi->Items + 1);
+static sqlite3_uint64
+tsp_ga_random (sqlite3_uint64 * state)
+{
+/* in-process PRNG (xorshift64*): no SQL round trips */
+    sqlite3_uint64 x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 2685821657736338717ULL;
+}
 
-    for (i = -1; i < multi->Items; i++)
-      {
-	  /* determining all City-to-City distances (costs) */
-	  targets = tsp_ga_permuted_targets (multiSolution->From, multi, i);
-	  for (j = 0; j < targets->Count; j++)
+static int
+tsp_ga_random_int (sqlite3_uint64 * state, int n)
+{
+/* a random integer in the range [0, n) */
+    return (int) ((tsp_ga_random (state) >> 33) % (sqlite3_uint64) n);
+}
+
+static void
+tsp_ga_random_pair (sqlite3_uint64 * state, int n, int *index1, int *index2)
+{
+/* two distinct random integers in the range [0, n) */
+    *index1 = tsp_ga_random_int (state, n);
+    *index2 = tsp_ga_random_int (state, n - 1);
+    if (*index2 >= *index1)
+	*index2 += 1;
+}
+
+static int
+tsp_ga_build_matrix (RoutingPtr graph, TspGaPopulationPtr ga,
+		     RouteNodePtr from, RoutingMultiDestPtr multi)
+{
+/* 
+/ building the dense City-to-City Costs matrix (City #0 is the origin)
+/ returns 0 on failure
+*/
+    int i;
+    int n = ga->Cities;
+    RoutingMultiDest cities;
+    ga->Nodes = malloc (sizeof (RouteNodePtr) * n);
+    ga->Matrix = malloc (sizeof (double) * n * n);
+    if (ga->Nodes == NULL || ga->Matrix == NULL)
+	return 0;
+    *(ga->Nodes + 0) = from;
+    for (i = 1; i < n; i++)
+	*(ga->Nodes + i) = *(multi->To + i - 1);
+    memset (&cities, 0, sizeof (RoutingMultiDest));
+    cities.Items = n;
+    cities.To = ga->Nodes;
+    return cost_matrix_compute (graph, &cities, &cities, ga->Matrix);
+}
+
+static double
+tsp_ga_tour_cost (TspGaPopulationPtr ga, const int *tour)
+{
+/* computing the total Cost of a circular Tour */
+    int k;
+    int n = ga->Cities;
+    double cost = 0.0;
+    for (k = 0; k < n; k++)
+	cost += *(ga->Matrix + (tour[k] * n) + tour[(k + 1) % n]);
+    return cost;
+}
+
+static void
+tsp_ga_nn_tour (TspGaPopulationPtr ga, int start, int *tour, char *visited,
+		int *scratch)
+{
+/* building a Nearest Neighbour Tour starting from the given City */
+    int k;
+    int c;
+    int n = ga->Cities;
+    int current = start;
+    int pos = 0;
+    memset (visited, 0, n);
+    tour[0] = start;
+    visited[start] = 1;
+    for (k = 1; k < n; k++)
+      {
+	  /* searching the nearest City not yet visited */
+	  int nearest = -1;
+	  double min = DBL_MAX;
+	  for (c = 0; c < n; c++)
 	    {
-		/* checking for undefined targets */
-		if (*(targets->To + j) == NULL)
+		double cost = *(ga->Matrix + (current * n) + c);
+		if (visited[c])
+		    continue;
+		if (nearest < 0 || cost < min)
+		  {
+		      min = cost;
+		      nearest = c;
+		  }
+	    }
+	  tour[k] = nearest;
+	  visited[nearest] = 1;
+	  current = nearest;
+	  if (nearest == 0)
+	      pos = k;
+      }
+/* rotating the Tour so to start from the origin */
+    for (k = 0; k < n; k++)
+	scratch[k] = tour[(pos + k) % n];
+    memcpy (tour, scratch, sizeof (int) * n);
+}
+
+static void
+tsp_prefix_costs (TspGaPopulationPtr ga, const int *tour, double *fwd,
+		  double *rev)
+{
+/* cumulated forward and reverse Costs along a Tour */
+    int k;
+    int n = ga->Cities;
+    fwd[0] = 0.0;
+    rev[0] = 0.0;
+    for (k = 1; k < n; k++)
+      {
+	  fwd[k] = fwd[k - 1] + *(ga->Matrix + (tour[k - 1] * n) + tour[k]);
+	  rev[k] = rev[k - 1] + *(ga->Matrix + (tour[k] * n) + tour[k - 1]);
+      }
+}
+
+static int
+tsp_two_opt (TspGaPopulationPtr ga, int *tour, double *fwd, double *rev)
+{
+/*
+/ a 2-opt pass: reversing the Tour between positions i+1 and j
+/ whenever this reduces the total Cost
+/ cumulated forward and reverse Costs allow to evaluate each move
+/ in constant time even when Costs are asymmetric (oneways)
+/
+/ returns 1 if the Tour has been improved
+*/
+    int i;
+    int j;
+    int n = ga->Cities;
+    double *m = ga->Matrix;
+    int improved = 0;
+    tsp_prefix_costs (ga, tour, fwd, rev);
+    for (i = 0; i < n - 2; i++)
+      {
+	  for (j = i + 2; j < n; j++)
+	    {
+		int a = tour[i];
+		int b = tour[i + 1];
+		int c = tour[j];
+		int d = tour[(j + 1) % n];
+		double delta =
+		    m[(a * n) + c] + m[(b * n) + d] - m[(a * n) + b] -
+		    m[(c * n) + d] + (rev[j] - rev[i + 1]) - (fwd[j] -
+							       fwd[i + 1]);
+		if (delta < -1e-9)
 		  {
-		      int k;
-		      for (k = 0; k < targets->Count; k++)
+		      /* reversing the segment */
+		      int lo = i + 1;
+		      int hi = j;
+		      while (lo < hi)
 			{
-			    /* maskinkg unreachable targets */
-			    *(targets->Found + k) = 'Y';
+			    int swap = tour[lo];
+			    tour[lo++] = tour[hi];
+			    tour[hi--] = swap;
 			}
-		      build_tsp_illegal_solution (multiSolution, targets);
-		      destroy_tsp_targets (targets);
-		      goto invalid;
+		      tsp_prefix_costs (ga, tour, fwd, rev);
+		      improved = 1;
 		  }
 	    }
-	  dijkstra_targets_solve (routing, targets);
-	  for (j = 0; j < targets->Count; j++)
-	    {
-		/* checking for unreachable targets */
-		if (*(targets->Found + j) != 'Y')
+      }
+    return improved;
+}
+
+static int
+tsp_or_opt (TspGaPopulationPtr ga, int *tour, int *scratch)
+{
+/*
+/ an Or-opt pass: moving chains of 1 up to 3 consecutive Cities
+/ elsewhere whenever this reduces the total Cost
+/ the origin (position #0) is never moved
+/
+/ returns 1 if the Tour has been improved
+*/
+    int len;
+    int i;
+    int k;
+    int n = ga->Cities;
+    double *m = ga->Matrix;
+    int improved = 0;
+    for (len = 1; len <= 3; len++)
+      {
+	  for (i = 1; i + len <= n; i++)
+	    {
+		int p = tour[i - 1];
+		int s0 = tour[i];
+		int s1 = tour[i + len - 1];
+		int q = tour[(i + len) % n];
+		double gain;
+		if (len + 2 > n)
+		    break;
+		gain = m[(p * n) + s0] + m[(s1 * n) + q] - m[(p * n) + q];
+		for (k = 0; k < n; k++)
 		  {
-		      build_tsp_illegal_solution (multiSolution, targets);
-		      destroy_tsp_targets (targets);
-		      goto invalid;
+		      int x;
+		      int y;
+		      int w;
+		      int z;
+		      if (k >= i - 1 && k <= i + len - 1)
+			  continue;	/* Links adjacent to the chain */
+		      x = tour[k];
+		      y = tour[(k + 1) % n];
+		      if (m[(x * n) + s0] + m[(s1 * n) + y] - m[(x * n) + y] -
+			  gain >= -1e-9)
+			  continue;
+		      /* moving the chain right after position k */
+		      w = 0;
+		      for (z = 0; z < n; z++)
+			{
+			    if (z >= i && z < i + len)
+				continue;
+			    scratch[w++] = tour[z];
+			    if (z == k)
+			      {
+				  int s;
+				  for (s = 0; s < len; s++)
+				      scratch[w++] = tour[i + s];
+			      }
+			}
+		      memcpy (tour, scratch, sizeof (int) * n);
+		      improved = 1;
+		      break;
 		  }
 	    }
-	  /* inserting the distances/costs into the helper struct */
-	  dist = alloc_tsp_ga_distances (targets);
-	  *(ga->Distances + i + 1) = dist;
-	  destroy_tsp_targets (targets);
       }
-    tsp_ga_sort_distances (ga);
+    return improved;
+}
 
-    for (i = -1; i < multi->Items; i++)
+static void
+tsp_local_search (TspGaPopulationPtr ga, int *tour, double *fwd,
+		  double *rev, int *scratch)
+{
+/* refining a Tour by 2-opt and Or-opt up to a local optimum */
+    int passes = 0;
+    while (passes < VROUTE_TSP_MAX_PASSES)
       {
-	  /* initializing GA using permuted NN solutions */
-	  int ret;
-	  targets = tsp_ga_permuted_targets (multiSolution->From, multi, i);
-	  ret = build_tsp_nn_solution (ga, targets, i + 1);
-	  destroy_tsp_targets (targets);
-	  if (!ret)
-	      goto invalid;
+	  int improved = tsp_two_opt (ga, tour, fwd, rev);
+	  if (tsp_or_opt (ga, tour, scratch))
+	      improved = 1;
+	  if (!improved)
+	      break;
+	  passes++;
+      }
+}
+
+static void
+destroy_tsp_ga_island (TspGaIslandPtr island)
+{
+/* memory cleanup; destroying a TSP GA island */
+    if (island == NULL)
+	return;
+    if (island->Tours != NULL)
+	free (island->Tours);
+    if (island->Costs != NULL)
+	free (island->Costs);
+    if (island->Work != NULL)
+	free (island->Work);
+    if (island->Present != NULL)
+	free (island->Present);
+    if (island->Fwd != NULL)
+	free (island->Fwd);
+    free (island);
+}
+
+static TspGaIslandPtr
+alloc_tsp_ga_island (TspGaPopulationPtr ga, const int *tours,
+		     sqlite3_uint64 seed)
+{
+/* allocating a TSP GA island, seeded by the given Tours */
+    int i;
+    int n = ga->Cities;
+    TspGaIslandPtr island = malloc (sizeof (TspGaIsland));
+    if (island == NULL)
+	return NULL;
+    island->ga = ga;
+    island->Count = ga->Count;
+    island->Tours = malloc (sizeof (int) * ga->Count * n);
+    island->Costs = malloc (sizeof (double) * ga->Count);
+    island->Work = malloc (sizeof (int) * n * 4);
+    island->Present = malloc (n);
+    island->Fwd = malloc (sizeof (double) * n * 2);
+    if (island->Tours == NULL || island->Costs == NULL || island->Work == NULL
+	|| island->Present == NULL || island->Fwd == NULL)
+      {
+	  destroy_tsp_ga_island (island);
+	  return NULL;
+      }
+    island->Rev = island->Fwd + n;
+    memcpy (island->Tours, tours, sizeof (int) * ga->Count * n);
+    for (i = 0; i < ga->Count; i++)
+	*(island->Costs + i) = tsp_ga_tour_cost (ga, island->Tours + (i * n));
+    island->Random = (seed == 0) ? 0x9e3779b97f4a7c15ULL : seed;
+    island->Generations = 0;
+    island->Counter = 0;
+    return island;
+}
+
+static int
+tsp_ga_island_best (TspGaIslandPtr island)
+{
+/* searching the best Tour of an island */
+    int i;
+    int best = 0;
+    for (i = 1; i < island->Count; i++)
+      {
+	  if (*(island->Costs + i) < *(island->Costs + best))
+	      best = i;
+      }
+    return best;
+}
+
+static void
+tsp_ga_island_insert (TspGaIslandPtr island, const int *tour, double cost)
+{
+/* replacing the worst Tour (unless an equivalent one is already there) */
+    int i;
+    int worst = -1;
+    double max_cost = 0.0;
+    int n = island->ga->Cities;
+    for (i = 0; i < island->Count; i++)
+      {
+	  double old = *(island->Costs + i);
+	  if (old == cost)
+	      return;		/* already defined */
+	  if (old > max_cost)
+	    {
+		max_cost = old;
+		worst = i;
+	    }
+      }
+    if (worst < 0 || max_cost <= cost)
+	return;
+    memcpy (island->Tours + (worst * n), tour, sizeof (int) * n);
+    *(island->Costs + worst) = cost;
+}
+
+static void
+tsp_ga_mutation (TspGaIslandPtr island, int *tour)
+{
+/* introducing a random mutation (the origin is never moved) */
+    int idx1;
+    int idx2;
+    int swap;
+    int n = island->ga->Cities;
+    if (n < 3)
+	return;
+    tsp_ga_random_pair (&(island->Random), n - 1, &idx1, &idx2);
+    swap = tour[idx1 + 1];
+    tour[idx1 + 1] = tour[idx2 + 1];
+    tour[idx2 + 1] = swap;
+}
+
+static void
+tsp_ga_crossover (TspGaIslandPtr island, const int *parent1,
+		  const int *parent2, int *hybrid)
+{
+/*
+/ creating a Crossover solution: a random interval is inherited
+/ from the first parent, all other Cities follow the order they
+/ have into the second parent
+*/
+    int j;
+    int k;
+    int idx1;
+    int idx2;
+    int n = island->ga->Cities;
+    char *present = island->Present;
+    memset (present, 0, n);
+    for (j = 0; j < n; j++)
+	hybrid[j] = -1;
+    tsp_ga_random_pair (&(island->Random), n, &idx1, &idx2);
+    if (idx1 > idx2)
+      {
+	  int swap = idx1;
+	  idx1 = idx2;
+	  idx2 = swap;
+      }
+    for (j = idx1; j <= idx2; j++)
+      {
+	  /* inheritance from the first parent */
+	  hybrid[j] = parent1[j];
+	  present[parent1[j]] = 1;
       }
+    k = 0;
+    for (j = 0; j < n; j++)
+      {
+	  /* inheritance from the second parent */
+	  if (present[parent2[j]])
+	      continue;
+	  while (hybrid[k] >= 0)
+	      k++;
+	  hybrid[k] = parent2[j];
+      }
+}
 
-    while (max_iterations >= 0)
+static void
+tsp_ga_island_evolve (TspGaIslandPtr island)
+{
+/* sexual reproduction and darwinian selection on a TSP GA island */
+    int g;
+    int i;
+    int best;
+    TspGaPopulationPtr ga = island->ga;
+    int n = ga->Cities;
+    int *parent1 = island->Work;
+    int *parent2 = island->Work + n;
+    int *hybrid = island->Work + (n * 2);
+    int *scratch = island->Work + (n * 3);
+    for (g = 0; g < island->Generations; g++)
       {
-	  /* sexual reproduction and darwinian selection */
-	  for (i = 0; i < ga->Count; i++)
+	  for (i = 0; i < island->Count; i++)
 	    {
 		/* Genetic loop - with mutations */
-		TspGaSolutionPtr hybrid;
-		int mutation1 = 0;
-		int mutation2 = 0;
-		count++;
-		if (count % 13 == 0)
+		int idx1;
+		int idx2;
+		island->Counter += 1;
+		tsp_ga_random_pair (&(island->Random), island->Count, &idx1,
+				    &idx2);
+		memcpy (parent1, island->Tours + (idx1 * n), sizeof (int) * n);
+		memcpy (parent2, island->Tours + (idx2 * n), sizeof (int) * n);
+		if (island->Counter % 13 == 0)
 		  {
 		      /* introducing a random mutation on parent #1 */
-		      mutation1 = 1;
+		      tsp_ga_mutation (island, parent1);
 		  }
-		if (count % 16 == 0)
+		if (island->Counter % 16 == 0)
 		  {
 		      /* introducing a random mutation on parent #2 */
-		      mutation2 = 1;
+		      tsp_ga_mutation (island, parent2);
 		  }
-		hybrid = tsp_ga_crossover (handle, ga, mutation1, mutation2);
-		*(ga->Offsprings + i) = hybrid;
+		tsp_ga_crossover (island, parent1, parent2, hybrid);
+		tsp_ga_island_insert (island, hybrid,
+				      tsp_ga_tour_cost (ga, hybrid));
 	    }
-	  evalTspGaFitness (ga);
-	  free_tsp_ga_offsprings (ga);
-	  max_iterations--;
       }
+/* refining the best Tour by local search */
+    best = tsp_ga_island_best (island);
+    tsp_local_search (ga, island->Tours + (best * n), island->Fwd,
+		      island->Rev, scratch);
+    *(island->Costs + best) =
+	tsp_ga_tour_cost (ga, island->Tours + (best * n));
+}
 
-/* building the TSP GA solution */
-    min = DBL_MAX;
-    bestSolution = NULL;
-    for (i = 0; i < ga->Count; i++)
-      {
-	  /* searching the best solution */
-	  TspGaSolutionPtr old = *(ga->Solutions + i);
-	  if (old == NULL)
-	      continue;
-	  if (old->TotalCost < min)
-	    {
-		min = old->TotalCost;
-		bestSolution = old;
-	    }
-      }
-    if (bestSolution != NULL)
-      {
-	  targets =
-	      build_tsp_ga_solution_targets (multiSolution->MultiTo->Items,
-					     multiSolution->From);
-	  set_tsp_ga_targets (handle, options, graph, routing, bestSolution,
-			      targets);
-	  build_tsp_solution (multiSolution, targets, graph->Srid);
-	  destroy_tsp_targets (targets);
-      }
-    destroy_tsp_ga_population (ga);
-    return;
+#ifndef _WIN32			/* POSIX threads: supporting parallel execution */
 
-  invalid:
-    destroy_tsp_ga_population (ga);
+static void *
+tsp_ga_island_thread (void *arg)
+{
+/* a TSP GA island thread */
+    tsp_ga_island_evolve ((TspGaIslandPtr) arg);
+    return NULL;
+}
+
+static int
+tsp_ga_islands (int cities)
+{
+/* determining how many islands (threads) are worth to be used */
+    long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    int islands = cities / VROUTE_TSP_GA_MIN_CITIES;
+    if (cpus < 1)
+	cpus = 1;
+    if (islands > cpus)
+	islands = cpus;
+    if (islands > VROUTE_TSP_GA_MAX_ISLANDS)
+	islands = VROUTE_TSP_GA_MAX_ISLANDS;
+    if (islands < 1)
+	islands = 1;
+    return islands;
 }
 
+#endif
+
 static void
-network_free (RoutingPtr p)
+tsp_ga_evolve_islands (TspGaIslandPtr * islands, int count, int generations)
 {
-/* memory cleanup; freeing any allocation for the network struct */
-    RouteNodePtr pN;
+/* evolving all islands for some generations (in parallel if possible) */
     int i;
-    if (!p)
+#ifndef _WIN32
+    pthread_t handles[VROUTE_TSP_GA_MAX_ISLANDS];
+    int started[VROUTE_TSP_GA_MAX_ISLANDS];
+#endif
+    for (i = 0; i < count; i++)
+	islands[i]->Generations = generations;
+#ifndef _WIN32
+    for (i = 1; i < count; i++)
+	started[i] =
+	    (pthread_create
+	     (&(handles[i]), NULL, tsp_ga_island_thread, islands[i]) == 0);
+    tsp_ga_island_evolve (islands[0]);
+    for (i = 1; i < count; i++)
+      {
+	  if (started[i])
+	      pthread_join (handles[i], NULL);
+	  else
+	      tsp_ga_island_evolve (islands[i]);
+      }
+#else
+    for (i = 0; i < count; i++)
+	tsp_ga_island_evolve (islands[i]);
+#endif
+}
+
+static void
+tsp_ga_migration (TspGaIslandPtr * islands, int count)
+{
+/* each island sends its best Tour to the next one (ring topology) */
+    int i;
+    int n;
+    int *tours;
+    double *costs;
+    if (count < 2)
 	return;
-    for (i = 0; i < p->NumNodes; i++)
+    n = islands[0]->ga->Cities;
+    tours = malloc (sizeof (int) * n * count);
+    costs = malloc (sizeof (double) * count);
+    if (tours == NULL || costs == NULL)
+	goto stop;
+    for (i = 0; i < count; i++)
       {
-	  pN = p->Nodes + i;
-	  if (pN->Code)
-	      free (pN->Code);
-	  if (pN->Links)
-	      free (pN->Links);
+	  int best = tsp_ga_island_best (islands[i]);
+	  memcpy (tours + (i * n), islands[i]->Tours + (best * n),
+		  sizeof (int) * n);
+	  costs[i] = *(islands[i]->Costs + best);
       }
-    if (p->Nodes)
-	free (p->Nodes);
-    if (p->TableName)
-	free (p->TableName);
-    if (p->FromColumn)
-	free (p->FromColumn);
-    if (p->ToColumn)
-	free (p->ToColumn);
-    if (p->GeometryColumn)
-	free (p->GeometryColumn);
-    if (p->NameColumn)
-	free (p->NameColumn);
-    free (p);
+    for (i = 0; i < count; i++)
+	tsp_ga_island_insert (islands[(i + 1) % count], tours + (i * n),
+			      costs[i]);
+  stop:
+    if (tours != NULL)
+	free (tours);
+    if (costs != NULL)
+	free (costs);
 }
 
-static RoutingPtr
-network_init (const unsigned char *blob, int size)
+static TspGaSolutionPtr
+tsp_ga_tour_solution (TspGaPopulationPtr ga, const int *tour)
 {
-/* parsing the HEADER block */
-    RoutingPtr graph;
-    int net64;
-    int aStar = 0;
-    int nodes;
-    int node_code;
-    int max_code_length;
-    int endian_arch = gaiaEndianArch ();
-    const char *table;
-    const char *from;
-    const char *to;
-    const char *geom;
-    const char *name = NULL;
-    double a_star_coeff = 1.0;
-    int len;
-    int i;
-    const unsigned char *ptr;
-    if (size < 9)
-	return NULL;
-    if (*(blob + 0) == GAIA_NET_START)	/* signature - legacy format using 32bit ints */
-	net64 = 0;
-    else if (*(blob + 0) == GAIA_NET64_START)	/* signature - format using 64bit ints */
-	net64 = 1;
-    else if (*(blob + 0) == GAIA_NET64_A_STAR_START)	/* signature - format using 64bit ints AND supporting A* */
+/* converting a Tour into a TSP GA solution */
+    int j;
+    int n = ga->Cities;
+    TspGaSolutionPtr solution = malloc (sizeof (TspGaSolution));
+    solution->Cities = n;
+    solution->CitiesFrom = malloc (sizeof (RouteNodePtr) * n);
+    solution->CitiesTo = malloc (sizeof (RouteNodePtr) * n);
+    solution->Costs = malloc (sizeof (double) * n);
+    solution->TotalCost = 0.0;
+    for (j = 0; j < n; j++)
       {
-	  net64 = 1;
-	  aStar = 1;
+	  int from = tour[j];
+	  int to = tour[(j + 1) % n];
+	  double cost = *(ga->Matrix + (from * n) + to);
+	  *(solution->CitiesFrom + j) = *(ga->Nodes + from);
+	  *(solution->CitiesTo + j) = *(ga->Nodes + to);
+	  *(solution->Costs + j) = cost;
+	  solution->TotalCost += cost;
       }
-    else
-	return NULL;
-    if (*(blob + 1) != GAIA_NET_HEADER)	/* signature */
-	return NULL;
-    nodes = gaiaImport32 (blob + 2, 1, endian_arch);	/* # nodes */
-    if (nodes <= 0)
-	return NULL;
-    if (*(blob + 6) == GAIA_NET_CODE)	/* Nodes identified by a TEXT code */
-	node_code = 1;
-    else if (*(blob + 6) == GAIA_NET_ID)	/* Nodes indentified by an INTEGER id */
-	node_code = 0;
-    else
-	return NULL;
-    max_code_length = *(blob + 7);	/* Max TEXT Code length */
-    if (*(blob + 8) != GAIA_NET_TABLE)	/* signature for TABLE NAME */
-	return NULL;
-    ptr = blob + 9;
-    len = gaiaImport16 (ptr, 1, endian_arch);	/* TABLE NAME is varlen */
-    ptr += 2;
-    table = (char *) ptr;
-    ptr += len;
+    return solution;
+}
+
+static MultiSolutionPtr
+tsp_ga_compute_route (sqlite3 * handle, int options, RouteNodePtr origin,
+		      RouteNodePtr destination, RoutingPtr graph,
+		      RoutingNodesPtr routing)
+{
+/* computing a route from City to City */
+    RoutingMultiDestPtr to = NULL;
+    MultiSolutionPtr ms = alloc_multiSolution ();
+    ms->From = origin;
+    to = malloc (sizeof (RoutingMultiDest));
+    ms->MultiTo = to;
+    to->CodeNode = graph->NodeCode;
+    to->Found = malloc (sizeof (char));
+    to->To = malloc (sizeof (RouteNodePtr));
+    *(to->Found + 0) = 'N';
+    *(to->To + 0) = destination;
+    to->Items = 1;
+    to->Next = 0;
+    if (graph->NodeCode)
+      {
+	  const char *code = route_node_code (graph, destination);
+	  int len = strlen (code);
+	  to->Ids = NULL;
+	  to->Codes = malloc (sizeof (char *));
+	  *(to->Codes + 0) = malloc (len + 1);
+	  strcpy (*(to->Codes + 0), code);
+      }
+    else
+      {
+	  to->Ids = malloc (sizeof (sqlite3_int64));
+	  to->Codes = NULL;
+	  *(to->Ids + 0) = destination->Id;
+      }
+
+    dijkstra_multi_shortest_path (handle, options, graph, routing, ms);
+    return (ms);
+}
+
+static void
+completing_tsp_ga_solution (sqlite3 * handle, int options,
+			    RouteNodePtr origin, RouteNodePtr destination,
+			    RoutingPtr graph, RoutingNodesPtr routing,
+			    TspTargetsPtr targets, int j)
+{
+/* completing a TSP GA solution */
+    ShortestPathSolutionPtr solution;
+    MultiSolutionPtr result =
+	tsp_ga_compute_route (handle, options, origin, destination, graph,
+			      routing);
+
+    solution = result->First;
+    while (solution != NULL)
+      {
+	  RowSolutionPtr old;
+	  ShortestPathSolutionPtr newSolution = alloc_solution ();
+	  newSolution->From = origin;
+	  newSolution->To = destination;
+	  newSolution->TotalCost += solution->TotalCost;
+	  targets->TotalCost += solution->TotalCost;
+	  newSolution->Geometry = solution->Geometry;
+	  solution->Geometry = NULL;
+	  if (j < 0)
+	      targets->LastSolution = newSolution;
+	  else
+	      *(targets->Solutions + j) = newSolution;
+	  old = solution->First;
+	  while (old != NULL)
+	    {
+		/* inserts a Link into the Shortest Path solution */
+		RowSolutionPtr p = malloc (sizeof (RowSolution));
+		p->Link = old->Link;
+		p->Cost = old->Cost;
+		p->Name = old->Name;
+		old->Name = NULL;
+		p->Next = NULL;
+		if (!(newSolution->First))
+		    newSolution->First = p;
+		if (newSolution->Last)
+		    newSolution->Last->Next = p;
+		newSolution->Last = p;
+		old = old->Next;
+	    }
+	  solution = solution->Next;
+      }
+    delete_multiSolution (result);
+}
+
+static void
+set_tsp_ga_targets (sqlite3 * handle, int options, RoutingPtr graph,
+		    RoutingNodesPtr routing, TspGaSolutionPtr bestSolution,
+		    TspTargetsPtr targets)
+{
+/* preparing TSP GA targets (best solution found) */
+    int j;
+    RouteNodePtr from;
+    RouteNodePtr to;
+
+    for (j = 0; j < targets->Count; j++)
+      {
+	  from = *(bestSolution->CitiesFrom + j);
+	  to = *(bestSolution->CitiesTo + j);
+	  completing_tsp_ga_solution (handle, options, from, to, graph, routing,
+				      targets, j);
+	  *(targets->To + j) = to;
+	  *(targets->Found + j) = 'Y';
+      }
+    /* this is the final City closing the circular path */
+    from = *(bestSolution->CitiesFrom + targets->Count);
+    to = *(bestSolution->CitiesTo + targets->Count);
+    completing_tsp_ga_solution (handle, options, from, to, graph, routing,
+				targets, -1);
+}
+
+static TspTargetsPtr
+build_tsp_ga_solution_targets (int count, RouteNodePtr from)
+{
+/* creating and initializing the TSP helper struct - final solution */
+    int i;
+    TspTargetsPtr targets = malloc (sizeof (TspTargets));
+    targets->Mode = VROUTE_TSP_SOLUTION;
+    targets->TotalCost = 0.0;
+    targets->Count = count;
+    targets->To = malloc (sizeof (RouteNodePtr *) * targets->Count);
+    targets->Found = malloc (sizeof (char) * targets->Count);
+    targets->Costs = malloc (sizeof (double) * targets->Count);
+    targets->Solutions =
+	malloc (sizeof (ShortestPathSolutionPtr) * targets->Count);
+    targets->LastSolution = NULL;
+    targets->From = from;
+    for (i = 0; i < targets->Count; i++)
+      {
+	  *(targets->To + i) = NULL;
+	  *(targets->Found + i) = 'N';
+	  *(targets->Costs + i) = DBL_MAX;
+	  *(targets->Solutions + i) = NULL;
+      }
+    return targets;
+}
+
+static TspTargetsPtr
+tsp_ga_targets (RouteNodePtr from, RoutingMultiDestPtr multi)
+{
+/* initializing the TSP helper struct */
+    int i;
+    TspTargetsPtr targets = malloc (sizeof (TspTargets));
+    targets->Mode = VROUTE_ROUTING_SOLUTION;
+    targets->TotalCost = 0.0;
+    targets->Count = multi->Items;
+    targets->To = malloc (sizeof (RouteNodePtr *) * targets->Count);
+    targets->Found = malloc (sizeof (char) * targets->Count);
+    targets->Costs = malloc (sizeof (double) * targets->Count);
+    targets->Solutions =
+	malloc (sizeof (ShortestPathSolutionPtr) * targets->Count);
+    targets->LastSolution = NULL;
+    targets->From = from;
+    for (i = 0; i < targets->Count; i++)
+      {
+	  *(targets->To + i) = *(multi->To + i);
+	  *(targets->Found + i) = 'N';
+	  *(targets->Costs + i) = DBL_MAX;
+	  *(targets->Solutions + i) = NULL;
+      }
+    return targets;
+}
+
+static void
+tsp_ga_solve (sqlite3 * handle, int options, RoutingPtr graph,
+	      RoutingNodesPtr routing, MultiSolutionPtr multiSolution)
+{
+/*
+/ computing a Dijkstra TSP GA Solution
+/
+/ all City-to-City Costs are computed just once and stored into
+/ a dense matrix; then many islands (Populations) evolve in parallel,
+/ exchanging their best Tours every VROUTE_TSP_GA_EPOCH generations;
+/ the best Tour of each island is refined by 2-opt / Or-opt
+*/
+    int i;
+    int j;
+    int n;
+    int epoch;
+    int best;
+    int best_island;
+    int count = 1;
+    int unreachable = 0;
+    int *tours = NULL;
+    char *visited = NULL;
+    double *fwd = NULL;
+    sqlite3_uint64 seed;
+    TspGaIslandPtr islands[VROUTE_TSP_GA_MAX_ISLANDS];
+    TspGaSolutionPtr bestSolution;
+    TspGaPopulationPtr ga = NULL;
+    RoutingMultiDestPtr multi;
+    TspTargetsPtr targets;
+
+    if (multiSolution == NULL)
+	return;
+    multi = multiSolution->MultiTo;
+    if (multi == NULL)
+	return;
+
+/* initialinzing the TSP GA helper struct */
+    ga = build_tsp_ga_population (multi->Items + 1);
+    for (i = 0; i < VROUTE_TSP_GA_MAX_ISLANDS; i++)
+	islands[i] = NULL;
+
+/* checking for undefined targets */
+    targets = tsp_ga_targets (multiSolution->From, multi);
+    for (j = 0; j < targets->Count; j++)
+      {
+	  if (*(targets->To + j) == NULL)
+	    {
+		int k;
+		for (k = 0; k < targets->Count; k++)
+		  {
+		      /* maskinkg unreachable targets */
+		      *(targets->Found + k) = 'Y';
+		  }
+		build_tsp_illegal_solution (multiSolution, targets);
+		destroy_tsp_targets (targets);
+		goto invalid;
+	    }
+      }
+
+/* determining all City-to-City distances (costs) */
+    if (!tsp_ga_build_matrix (graph, ga, multiSolution->From, multi))
+      {
+	  destroy_tsp_targets (targets);
+	  goto invalid;
+      }
+    n = ga->Cities;
+    for (j = 0; j < targets->Count; j++)
+	*(targets->Found + j) = 'Y';
+    for (i = 0; i < n; i++)
+      {
+	  /* checking for unreachable targets */
+	  for (j = 0; j < n; j++)
+	    {
+		if (*(ga->Matrix + (i * n) + j) >= 0.0)
+		    continue;
+		if (i > 0)
+		    *(targets->Found + i - 1) = 'N';
+		if (j > 0)
+		    *(targets->Found + j - 1) = 'N';
+		unreachable = 1;
+	    }
+      }
+    if (unreachable)
+      {
+	  build_tsp_illegal_solution (multiSolution, targets);
+	  destroy_tsp_targets (targets);
+	  goto invalid;
+      }
+    destroy_tsp_targets (targets);
+
+/* initializing GA using NN solutions starting from each City */
+    tours = malloc (sizeof (int) * n * (n + 1));
+    visited = malloc (n);
+    if (tours == NULL || visited == NULL)
+	goto invalid;
+    fwd = malloc (sizeof (double) * n * 2);
+    if (fwd == NULL)
+	goto invalid;
+    for (i = 0; i < n; i++)
+      {
+	  /* NN Tours are refined by local search */
+	  tsp_ga_nn_tour (ga, i, tours + (i * n), visited, tours + (n * n));
+	  tsp_local_search (ga, tours + (i * n), fwd, fwd + n, tours + (n * n));
+      }
+#ifndef _WIN32
+    count = tsp_ga_islands (n);
+#endif
+    sqlite3_randomness (sizeof (sqlite3_uint64), &seed);
+    for (i = 0; i < count; i++)
+      {
+	  islands[i] =
+	      alloc_tsp_ga_island (ga, tours,
+				   seed + (i * 0x9e3779b97f4a7c15ULL));
+	  if (islands[i] == NULL)
+	      goto invalid;
+      }
+
+    for (epoch = 0; epoch < VROUTE_TSP_GA_MAX_ITERATIONS / VROUTE_TSP_GA_EPOCH;
+	 epoch++)
+      {
+	  /* evolving all islands, then exchanging their best Tours */
+	  tsp_ga_evolve_islands (islands, count, VROUTE_TSP_GA_EPOCH);
+	  tsp_ga_migration (islands, count);
+      }
+
+/* building the TSP GA solution */
+    best_island = 0;
+    best = tsp_ga_island_best (islands[0]);
+    for (i = 1; i < count; i++)
+      {
+	  /* searching the best solution */
+	  j = tsp_ga_island_best (islands[i]);
+	  if (*(islands[i]->Costs + j) < *(islands[best_island]->Costs + best))
+	    {
+		best_island = i;
+		best = j;
+	    }
+      }
+    bestSolution =
+	tsp_ga_tour_solution (ga, islands[best_island]->Tours + (best * n));
+    targets =
+	build_tsp_ga_solution_targets (multiSolution->MultiTo->Items,
+				       multiSolution->From);
+    set_tsp_ga_targets (handle, options, graph, routing, bestSolution, targets);
+    build_tsp_solution (multiSolution, targets, graph->Srid);
+    destroy_tsp_targets (targets);
+    destroy_tsp_ga_solution (bestSolution);
+
+  invalid:
+    for (i = 0; i < VROUTE_TSP_GA_MAX_ISLANDS; i++)
+	destroy_tsp_ga_island (islands[i]);
+    if (tours != NULL)
+	free (tours);
+    if (visited != NULL)
+	free (visited);
+    if (fwd != NULL)
+	free (fwd);
+    destroy_tsp_ga_population (ga);
+}
+
+static void
+network_ch_free (RoutingPtr graph)
+{
+/* memory cleanup; freeing the Contraction Hierarchies */
+    int i;
+    if (graph->ChNodes == NULL)
+	return;
+    for (i = 0; i < graph->NumNodes; i++)
+      {
+	  RouteChNodePtr pN = graph->ChNodes + i;
+	  if (pN->Forward)
+	      free (pN->Forward);
+	  if (pN->Backward)
+	      free (pN->Backward);
+      }
+    free (graph->ChNodes);
+    graph->ChNodes = NULL;
+}
+
+static void
+network_extras_free (RoutingPtr graph)
+{
+/* memory cleanup; freeing Turns and Time Dependent profiles */
+    if (graph->TurnOffsets != NULL)
+	free (graph->TurnOffsets);
+    if (graph->Turns != NULL)
+	free (graph->Turns);
+    if (graph->ProfilePoints != NULL)
+	free (graph->ProfilePoints);
+    if (graph->LinkProfiles != NULL)
+	free (graph->LinkProfiles);
+    graph->NumTurns = 0;
+    graph->TurnOffsets = NULL;
+    graph->Turns = NULL;
+    graph->NumProfilePoints = 0;
+    graph->ProfilePoints = NULL;
+    graph->LinkProfiles = NULL;
+    graph->ProfileMinRatio = 1.0;
+}
+
+static void
+network_sidecar_unmap (unsigned char *mapping, size_t size)
+{
+/* releasing a sidecar file mapping */
+    if (mapping == NULL)
+	return;
+#ifdef _WIN32
+    if (size)
+	size = size;		/* unused arg warning suppression */
+    free (mapping);
+#else
+    munmap (mapping, size);
+#endif
+}
+
+static void
+network_free (RoutingPtr p)
+{
+/* memory cleanup; freeing any allocation for the network struct */
+    if (!p)
+	return;
+    network_ch_free (p);
+    network_extras_free (p);
+    if (p->Mapping != NULL)
+      {
+	  /* all arrays belong to the memory mapped sidecar file */
+	  network_sidecar_unmap (p->Mapping, p->MappingSize);
+      }
+    else
+      {
+	  if (p->Nodes)
+	      free (p->Nodes);
+	  if (p->LinkOffsets)
+	      free (p->LinkOffsets);
+	  if (p->Links)
+	      free (p->Links);
+	  if (p->Codes)
+	      free (p->Codes);
+      }
+    if (p->TableName)
+	free (p->TableName);
+    if (p->FromColumn)
+	free (p->FromColumn);
+    if (p->ToColumn)
+	free (p->ToColumn);
+    if (p->GeometryColumn)
+	free (p->GeometryColumn);
+    if (p->NameColumn)
+	free (p->NameColumn);
+    free (p);
+}
+
+static RoutingPtr
+network_init (const unsigned char *blob, int size)
+{
+/* parsing the HEADER block */
+    RoutingPtr graph;
+    int net64;
+    int aStar = 0;
+    int nodes;
+    int node_code;
+    int max_code_length;
+    int endian_arch = gaiaEndianArch ();
+    const char *table;
+    const char *from;
+    const char *to;
+    const char *geom;
+    const char *name = NULL;
+    double a_star_coeff = 1.0;
+    int len;
+    const unsigned char *ptr;
+    if (size < 9)
+	return NULL;
+    if (*(blob + 0) == GAIA_NET_START)	/* signature - legacy format using 32bit ints */
+	net64 = 0;
+    else if (*(blob + 0) == GAIA_NET64_START)	/* signature - format using 64bit ints */
+	net64 = 1;
+    else if (*(blob + 0) == GAIA_NET64_A_STAR_START)	/* signature - format using 64bit ints AND supporting A* */
+      {
+	  net64 = 1;
+	  aStar = 1;
+      }
+    else
+	return NULL;
+    if (*(blob + 1) != GAIA_NET_HEADER)	/* signature */
+	return NULL;
+    nodes = gaiaImport32 (blob + 2, 1, endian_arch);	/* # nodes */
+    if (nodes <= 0)
+	return NULL;
+    if (*(blob + 6) == GAIA_NET_CODE)	/* Nodes identified by a TEXT code */
+	node_code = 1;
+    else if (*(blob + 6) == GAIA_NET_ID)	/* Nodes indentified by an INTEGER id */
+	node_code = 0;
+    else
+	return NULL;
+    max_code_length = *(blob + 7);	/* Max TEXT Code length */
+    if (*(blob + 8) != GAIA_NET_TABLE)	/* signature for TABLE NAME */
+	return NULL;
+    ptr = blob + 9;
+    len = gaiaImport16 (ptr, 1, endian_arch);	/* TABLE NAME is varlen */
+    ptr += 2;
+    table = (char *) ptr;
+    ptr += len;
     if (*ptr != GAIA_NET_FROM)	/* signature for FromNode COLUMN */
 	return NULL;
     ptr++;
@@ -4946,260 +6552,1157 @@ network_init (const unsigned char *blob, int size)
     ptr += len;
     if (net64)
       {
-	  if (*ptr != GAIA_NET_NAME)	/* signature for Name COLUMN - may be empty */
-	      return NULL;
-	  ptr++;
-	  len = gaiaImport16 (ptr, 1, endian_arch);	/* Name COLUMN is varlen */
-	  ptr += 2;
-	  name = (char *) ptr;
-	  ptr += len;
+	  if (*ptr != GAIA_NET_NAME)	/* signature for Name COLUMN - may be empty */
+	      return NULL;
+	  ptr++;
+	  len = gaiaImport16 (ptr, 1, endian_arch);	/* Name COLUMN is varlen */
+	  ptr += 2;
+	  name = (char *) ptr;
+	  ptr += len;
+      }
+    if (net64 && aStar)
+      {
+	  if (*ptr != GAIA_NET_A_STAR_COEFF)	/* signature for A* Heuristic Coeff */
+	      return NULL;
+	  ptr++;
+	  a_star_coeff = gaiaImport64 (ptr, 1, endian_arch);
+	  ptr += 8;
+      }
+    if (*ptr != GAIA_NET_END)	/* signature */
+	return NULL;
+    graph = malloc (sizeof (Routing));
+    graph->Srid = VROUTE_INVALID_SRID;
+    graph->HasZ = 0;
+    graph->Net64 = net64;
+    graph->AStar = aStar;
+    graph->EndianArch = endian_arch;
+    graph->CurrentIndex = 0;
+    graph->NodeCode = node_code;
+    graph->MaxCodeLength = max_code_length;
+    graph->NumNodes = nodes;
+    graph->ChNodes = NULL;
+    graph->Nodes = NULL;
+    graph->NumLinks = 0;
+    graph->MaxLinks = 0;
+    graph->LinkOffsets = NULL;
+    graph->Links = NULL;
+    graph->CodesSize = 0;
+    graph->MaxCodes = 0;
+    graph->Codes = NULL;
+    graph->Mapping = NULL;
+    graph->MappingSize = 0;
+    graph->NumTurns = 0;
+    graph->TurnOffsets = NULL;
+    graph->Turns = NULL;
+    graph->NumProfilePoints = 0;
+    graph->ProfilePoints = NULL;
+    graph->LinkProfiles = NULL;
+    graph->ProfileMinRatio = 1.0;
+    graph->Generation = 0;
+    graph->LastBlockId = 0;
+    len = strlen (table);
+    graph->TableName = malloc (len + 1);
+    strcpy (graph->TableName, table);
+    len = strlen (from);
+    graph->FromColumn = malloc (len + 1);
+    strcpy (graph->FromColumn, from);
+    len = strlen (to);
+    graph->ToColumn = malloc (len + 1);
+    strcpy (graph->ToColumn, to);
+    len = strlen (geom);
+    if (len <= 1)
+	graph->GeometryColumn = NULL;
+    else
+      {
+	  graph->GeometryColumn = malloc (len + 1);
+	  strcpy (graph->GeometryColumn, geom);
+      }
+    if (!net64)
+      {
+	  /* Name column is not supported */
+	  graph->NameColumn = NULL;
+      }
+    else
+      {
+	  len = strlen (name);
+	  if (len <= 1)
+	      graph->NameColumn = NULL;
+	  else
+	    {
+		graph->NameColumn = malloc (len + 1);
+		strcpy (graph->NameColumn, name);
+	    }
+      }
+    graph->AStarHeuristicCoeff = a_star_coeff;
+    return graph;
+}
+
+static void
+network_alloc (RoutingPtr graph)
+{
+/* allocating the arrays for a network to be parsed from its BLOBs */
+    int i;
+    graph->Nodes = malloc (sizeof (RouteNode) * graph->NumNodes);
+    for (i = 0; i < graph->NumNodes; i++)
+      {
+	  RouteNodePtr pN = graph->Nodes + i;
+	  pN->InternalIndex = i;
+	  pN->Id = -1;
+	  pN->CodeOffset = -1;
+	  pN->CoordX = DBL_MAX;
+	  pN->CoordY = DBL_MAX;
+      }
+/* LinkOffsets will temporarily contain the # Links of each Node */
+    graph->LinkOffsets = calloc (graph->NumNodes + 1, sizeof (int));
+    graph->MaxLinks = (graph->NumNodes < 1024) ? 1024 : graph->NumNodes;
+    graph->Links = malloc (sizeof (RouteLink) * graph->MaxLinks);
+    if (graph->NodeCode)
+      {
+	  graph->MaxCodes = 4096;
+	  graph->Codes = malloc (graph->MaxCodes);
+      }
+}
+
+static RouteLinkPtr
+network_add_link (RoutingPtr graph)
+{
+/* appending a further Link */
+    if (graph->NumLinks >= graph->MaxLinks)
+      {
+	  RouteLinkPtr links;
+	  int max = graph->MaxLinks * 2;
+	  links = realloc (graph->Links, sizeof (RouteLink) * max);
+	  if (links == NULL)
+	      return NULL;
+	  graph->Links = links;
+	  graph->MaxLinks = max;
+      }
+    return graph->Links + graph->NumLinks++;
+}
+
+static int
+network_add_code (RoutingPtr graph, const char *code)
+{
+/* interning a Node Code; returns its offset or -1 on failure */
+    int offset = graph->CodesSize;
+    int len = strlen (code) + 1;
+    if (graph->CodesSize + len > graph->MaxCodes)
+      {
+	  char *codes;
+	  int max = graph->MaxCodes * 2;
+	  while (graph->CodesSize + len > max)
+	      max *= 2;
+	  codes = realloc (graph->Codes, max);
+	  if (codes == NULL)
+	      return -1;
+	  graph->Codes = codes;
+	  graph->MaxCodes = max;
+      }
+    memcpy (graph->Codes + offset, code, len);
+    graph->CodesSize += len;
+    return offset;
+}
+
+static int
+network_build_csr (RoutingPtr graph)
+{
+/* 
+/ finalizing the CSR layout: LinkOffsets will be converted from 
+/ per-Node counts into offsets, and Links will be grouped by NodeFrom
+/ (CreateRouting always writes Nodes in ascending order, but anyway
+/ we'll never rely on this)
+*/
+    int i;
+    int sorted = 1;
+    int *offsets = graph->LinkOffsets;
+    int tot = 0;
+    for (i = 1; i < graph->NumLinks; i++)
+      {
+	  if (graph->Links[i].NodeFrom < graph->Links[i - 1].NodeFrom)
+	    {
+		sorted = 0;
+		break;
+	    }
+      }
+    for (i = 0; i < graph->NumNodes; i++)
+      {
+	  int cnt = offsets[i];
+	  offsets[i] = tot;
+	  tot += cnt;
+      }
+    offsets[graph->NumNodes] = tot;
+    if (tot != graph->NumLinks)
+	return 0;
+    if (!sorted)
+      {
+	  /* stable counting sort by NodeFrom */
+	  RouteLinkPtr links = malloc (sizeof (RouteLink) * (tot + 1));
+	  int *next = malloc (sizeof (int) * (graph->NumNodes + 1));
+	  if (links == NULL || next == NULL)
+	    {
+		if (links != NULL)
+		    free (links);
+		if (next != NULL)
+		    free (next);
+		return 0;
+	    }
+	  memcpy (next, offsets, sizeof (int) * (graph->NumNodes + 1));
+	  for (i = 0; i < tot; i++)
+	    {
+		RouteLinkPtr pA = graph->Links + i;
+		links[next[pA->NodeFrom]++] = *pA;
+	    }
+	  free (next);
+	  free (graph->Links);
+	  graph->Links = links;
+	  graph->MaxLinks = tot + 1;
+      }
+    return 1;
+}
+
+static int
+network_block (RoutingPtr graph, const unsigned char *blob, int size)
+{
+/* parsing a NETWORK Block */
+    const unsigned char *in = blob;
+    int nodes;
+    int i;
+    int ia;
+    int index;
+    char *code = NULL;
+    double x;
+    double y;
+    sqlite3_int64 nodeId = -1;
+    int links;
+    RouteNodePtr pN;
+    RouteLinkPtr pA;
+    sqlite3_int64 linkId;
+    int nodeToIdx;
+    double cost;
+    if (size < 3)
+	goto error;
+    if (*in++ != GAIA_NET_BLOCK)	/* signature */
+	goto error;
+    nodes = gaiaImport16 (in, 1, graph->EndianArch);	/* # Nodes */
+    in += 2;
+    code = malloc (graph->MaxCodeLength + 1);
+    for (i = 0; i < nodes; i++)
+      {
+	  /* parsing each node */
+	  if ((size - (in - blob)) < 5)
+	      goto error;
+	  if (*in++ != GAIA_NET_NODE)	/* signature */
+	      goto error;
+	  index = gaiaImport32 (in, 1, graph->EndianArch);	/* node internal index */
+	  in += 4;
+	  if (index < 0 || index >= graph->NumNodes)
+	      goto error;
+	  if (graph->NodeCode)
+	    {
+		/* Nodes are identified by a TEXT Code */
+		if ((size - (in - blob)) < graph->MaxCodeLength)
+		    goto error;
+		memcpy (code, in, graph->MaxCodeLength);
+		*(code + graph->MaxCodeLength) = '\0';
+		in += graph->MaxCodeLength;
+	    }
+	  else
+	    {
+		/* Nodes are identified by an INTEGER Id */
+		if (graph->Net64)
+		  {
+		      if ((size - (in - blob)) < 8)
+			  goto error;
+		      nodeId = gaiaImportI64 (in, 1, graph->EndianArch);	/* the Node ID: 64bit */
+		      in += 8;
+		  }
+		else
+		  {
+		      if ((size - (in - blob)) < 4)
+			  goto error;
+		      nodeId = gaiaImport32 (in, 1, graph->EndianArch);	/* the Node ID: 32bit */
+		      in += 4;
+		  }
+	    }
+	  if (graph->AStar)
+	    {
+		/* fetching node's X,Y coords */
+		if ((size - (in - blob)) < 8)
+		    goto error;
+		x = gaiaImport64 (in, 1, graph->EndianArch);	/* X coord */
+		in += 8;
+		if ((size - (in - blob)) < 8)
+		    goto error;
+		y = gaiaImport64 (in, 1, graph->EndianArch);	/* Y coord */
+		in += 8;
+	    }
+	  else
+	    {
+		x = DBL_MAX;
+		y = DBL_MAX;
+	    }
+	  if ((size - (in - blob)) < 2)
+	      goto error;
+	  links = gaiaImport16 (in, 1, graph->EndianArch);	/* # Links */
+	  in += 2;
+	  if (links < 0)
+	      goto error;
+	  /* initializing the Node */
+	  pN = graph->Nodes + index;
+	  pN->InternalIndex = index;
+	  if (graph->NodeCode)
+	    {
+		/* Nodes are identified by a TEXT Code */
+		pN->Id = -1;
+		pN->CodeOffset = network_add_code (graph, code);
+		if (pN->CodeOffset < 0)
+		    goto error;
+	    }
+	  else
+	    {
+		/* Nodes are identified by an INTEGER Id */
+		pN->Id = nodeId;
+		pN->CodeOffset = -1;
+	    }
+	  pN->CoordX = x;
+	  pN->CoordY = y;
+	  graph->LinkOffsets[index] += links;
+	  if (links)
+	    {
+		/* parsing the Links */
+		for (ia = 0; ia < links; ia++)
+		  {
+		      /* parsing each Link */
+		      if (graph->Net64)
+			{
+			    if ((size - (in - blob)) < 22)
+				goto error;
+			}
+		      else
+			{
+			    if ((size - (in - blob)) < 18)
+				goto error;
+			}
+		      if (*in++ != GAIA_NET_ARC)	/* signature */
+			  goto error;
+		      if (graph->Net64)
+			{
+			    linkId = gaiaImportI64 (in, 1, graph->EndianArch);	/* # Link ROWID: 64bit */
+			    in += 8;
+			}
+		      else
+			{
+			    linkId = gaiaImport32 (in, 1, graph->EndianArch);	/* # Link ROWID: 32bit */
+			    in += 4;
+			}
+		      nodeToIdx = gaiaImport32 (in, 1, graph->EndianArch);	/* # NodeTo internal index */
+		      in += 4;
+		      cost = gaiaImport64 (in, 1, graph->EndianArch);	/* # Cost */
+		      in += 8;
+		      if (*in++ != GAIA_NET_END)	/* signature */
+			  goto error;
+		      /* initializing the Link */
+		      if (nodeToIdx < 0 || nodeToIdx >= graph->NumNodes)
+			  goto error;
+		      pA = network_add_link (graph);
+		      if (pA == NULL)
+			  goto error;
+		      pA->NodeFrom = index;
+		      pA->NodeTo = nodeToIdx;
+		      pA->LinkRowid = linkId;
+		      pA->Cost = cost;
+		  }
+	    }
+	  if ((size - (in - blob)) < 1)
+	      goto error;
+	  if (*in++ != GAIA_NET_END)	/* signature */
+	      goto error;
+      }
+    free (code);
+    return 1;
+  error:
+    if (code != NULL)
+	free (code);
+    return 0;
+}
+
+static RouteLinkPtr
+find_ch_link (RoutingPtr graph, int from, int to, sqlite3_int64 rowid)
+{
+/* searching the original Link corresponding to some upward edge */
+    int num_links;
+    RouteLinkPtr links =
+	route_node_links (graph, graph->Nodes + from, &num_links);
+    RouteLinkPtr found = NULL;
+    int i;
+    for (i = 0; i < num_links; i++)
+      {
+	  RouteLinkPtr pA = links + i;
+	  if (pA->LinkRowid != rowid || pA->NodeTo != to)
+	      continue;
+	  if (found == NULL || pA->Cost < found->Cost)
+	      found = pA;
       }
-    if (net64 && aStar)
+    return found;
+}
+
+static int
+network_ch_block (RoutingPtr graph, const unsigned char *blob, int size)
+{
+/* parsing a Contraction Hierarchies Block */
+    const unsigned char *in = blob;
+    int nodes;
+    int i;
+    int ia;
+    int index;
+    int nodeIdx;
+    int middleIdx;
+    int forward;
+    int backward;
+    sqlite3_int64 linkId;
+    double cost;
+    RouteChNodePtr pN;
+    RouteChEdgePtr pE;
+    if (size < 3)
+	return 0;
+    if (*in++ != GAIA_NET_CH_BLOCK)	/* signature */
+	return 0;
+    nodes = gaiaImport16 (in, 1, graph->EndianArch);	/* # Nodes */
+    in += 2;
+    if (graph->ChNodes == NULL)
       {
-	  if (*ptr != GAIA_NET_A_STAR_COEFF)	/* signature for A* Heuristic Coeff */
-	      return NULL;
-	  ptr++;
-	  a_star_coeff = gaiaImport64 (ptr, 1, endian_arch);
-	  ptr += 8;
+	  /* allocating the Contraction Hierarchies */
+	  graph->ChNodes = malloc (sizeof (RouteChNode) * graph->NumNodes);
+	  if (graph->ChNodes == NULL)
+	      return 0;
+	  for (i = 0; i < graph->NumNodes; i++)
+	    {
+		pN = graph->ChNodes + i;
+		pN->Rank = -1;
+		pN->NumForward = 0;
+		pN->Forward = NULL;
+		pN->NumBackward = 0;
+		pN->Backward = NULL;
+	    }
+      }
+    for (i = 0; i < nodes; i++)
+      {
+	  /* parsing each node */
+	  if ((size - (in - blob)) < 13)
+	      return 0;
+	  if (*in++ != GAIA_NET_NODE)	/* signature */
+	      return 0;
+	  index = gaiaImport32 (in, 1, graph->EndianArch);	/* node internal index */
+	  in += 4;
+	  if (index < 0 || index >= graph->NumNodes)
+	      return 0;
+	  pN = graph->ChNodes + index;
+	  if (pN->Rank >= 0)
+	      return 0;		/* duplicate node */
+	  pN->Rank = gaiaImport32 (in, 1, graph->EndianArch);	/* node rank */
+	  in += 4;
+	  forward = gaiaImport16 (in, 1, graph->EndianArch);	/* # upward outcoming edges */
+	  in += 2;
+	  backward = gaiaImport16 (in, 1, graph->EndianArch);	/* # upward incoming edges */
+	  in += 2;
+	  if (pN->Rank < 0 || forward < 0 || backward < 0)
+	      return 0;
+	  if (forward)
+	    {
+		pN->Forward = malloc (sizeof (RouteChEdge) * forward);
+		if (pN->Forward == NULL)
+		    return 0;
+	    }
+	  pN->NumForward = forward;
+	  if (backward)
+	    {
+		pN->Backward = malloc (sizeof (RouteChEdge) * backward);
+		if (pN->Backward == NULL)
+		    return 0;
+	    }
+	  pN->NumBackward = backward;
+	  for (ia = 0; ia < forward + backward; ia++)
+	    {
+		/* parsing each upward edge */
+		if ((size - (in - blob)) < 26)
+		    return 0;
+		if (*in++ != GAIA_NET_ARC)	/* signature */
+		    return 0;
+		nodeIdx = gaiaImport32 (in, 1, graph->EndianArch);	/* # other Node internal index */
+		in += 4;
+		middleIdx = gaiaImport32 (in, 1, graph->EndianArch);	/* # contracted Node internal index */
+		in += 4;
+		linkId = gaiaImportI64 (in, 1, graph->EndianArch);	/* # Link ROWID */
+		in += 8;
+		cost = gaiaImport64 (in, 1, graph->EndianArch);	/* # Cost */
+		in += 8;
+		if (*in++ != GAIA_NET_END)	/* signature */
+		    return 0;
+		if (nodeIdx < 0 || nodeIdx >= graph->NumNodes)
+		    return 0;
+		if (middleIdx < -1 || middleIdx >= graph->NumNodes)
+		    return 0;
+		if (ia < forward)
+		    pE = pN->Forward + ia;
+		else
+		    pE = pN->Backward + (ia - forward);
+		pE->NodeIndex = nodeIdx;
+		pE->MiddleIndex = middleIdx;
+		pE->Cost = cost;
+		pE->Link = NULL;
+		if (middleIdx < 0)
+		  {
+		      /* an original Link */
+		      if (ia < forward)
+			  pE->Link = find_ch_link (graph, index, nodeIdx, linkId);
+		      else
+			  pE->Link = find_ch_link (graph, nodeIdx, index, linkId);
+		      if (pE->Link == NULL)
+			  return 0;
+		  }
+	    }
+	  if ((size - (in - blob)) < 1)
+	      return 0;
+	  if (*in++ != GAIA_NET_END)	/* signature */
+	      return 0;
+      }
+    return 1;
+}
+
+static int
+network_turn_block (RouteExtrasPtr extras, int endian_arch,
+		    const unsigned char *blob, int size)
+{
+/* parsing a Turns Block */
+    const unsigned char *in = blob;
+    int turns;
+    int i;
+    if (size < 3)
+	return 0;
+    if (*in++ != GAIA_NET_TURN_BLOCK)	/* signature */
+	return 0;
+    turns = gaiaImport16 (in, 1, endian_arch);	/* # Turns */
+    in += 2;
+    if (turns < 0 || (size - (in - blob)) < turns * 26)
+	return 0;
+    if (extras->NumTurns + turns > extras->MaxTurns)
+      {
+	  int max = extras->MaxTurns + turns + 1024;
+	  RouteTurnRawPtr new_turns =
+	      realloc (extras->Turns, sizeof (RouteTurnRaw) * max);
+	  if (new_turns == NULL)
+	      return 0;
+	  extras->Turns = new_turns;
+	  extras->MaxTurns = max;
+      }
+    for (i = 0; i < turns; i++)
+      {
+	  /* parsing each Turn */
+	  RouteTurnRawPtr pT = extras->Turns + extras->NumTurns;
+	  if (*in++ != GAIA_NET_ARC)	/* signature */
+	      return 0;
+	  pT->FromRowid = gaiaImportI64 (in, 1, endian_arch);	/* incoming Link ROWID */
+	  in += 8;
+	  pT->ToRowid = gaiaImportI64 (in, 1, endian_arch);	/* outcoming Link ROWID */
+	  in += 8;
+	  pT->Cost = gaiaImport64 (in, 1, endian_arch);	/* Turn Cost */
+	  in += 8;
+	  if (*in++ != GAIA_NET_END)	/* signature */
+	      return 0;
+	  extras->NumTurns += 1;
+      }
+    return 1;
+}
+
+static int
+network_td_block (RouteExtrasPtr extras, int endian_arch,
+		  const unsigned char *blob, int size)
+{
+/* parsing a Time Dependent profiles Block */
+    const unsigned char *in = blob;
+    int profiles;
+    int points;
+    int i;
+    int ip;
+    if (size < 3)
+	return 0;
+    if (*in++ != GAIA_NET_TD_BLOCK)	/* signature */
+	return 0;
+    profiles = gaiaImport16 (in, 1, endian_arch);	/* # Profiles */
+    in += 2;
+    for (i = 0; i < profiles; i++)
+      {
+	  /* parsing each Profile */
+	  RouteProfileRawPtr pP;
+	  if ((size - (in - blob)) < 12)
+	      return 0;
+	  if (*in++ != GAIA_NET_ARC)	/* signature */
+	      return 0;
+	  if (extras->NumProfiles == extras->MaxProfiles)
+	    {
+		int max = extras->MaxProfiles + 1024;
+		RouteProfileRawPtr new_profiles =
+		    realloc (extras->Profiles, sizeof (RouteProfileRaw) * max);
+		if (new_profiles == NULL)
+		    return 0;
+		extras->Profiles = new_profiles;
+		extras->MaxProfiles = max;
+	    }
+	  pP = extras->Profiles + extras->NumProfiles;
+	  pP->Rowid = gaiaImportI64 (in, 1, endian_arch);	/* Link ROWID */
+	  in += 8;
+	  points = gaiaImport16 (in, 1, endian_arch);	/* # breakpoints */
+	  in += 2;
+	  if (points <= 0 || (size - (in - blob)) < (points * 16) + 1)
+	      return 0;
+	  if (extras->NumPoints + points > extras->MaxPoints)
+	    {
+		int max = extras->MaxPoints + points + 4096;
+		RouteProfilePointPtr new_points =
+		    realloc (extras->Points, sizeof (RouteProfilePoint) * max);
+		if (new_points == NULL)
+		    return 0;
+		extras->Points = new_points;
+		extras->MaxPoints = max;
+	    }
+	  pP->First = extras->NumPoints;
+	  pP->Count = points;
+	  for (ip = 0; ip < points; ip++)
+	    {
+		RouteProfilePointPtr pt = extras->Points + extras->NumPoints;
+		pt->Time = gaiaImport64 (in, 1, endian_arch);	/* Time of the day */
+		in += 8;
+		pt->Cost = gaiaImport64 (in, 1, endian_arch);	/* Cost at that Time */
+		in += 8;
+		if (ip > 0 && pt->Time < (pt - 1)->Time)
+		    return 0;	/* unsorted breakpoints */
+		extras->NumPoints += 1;
+	    }
+	  if (*in++ != GAIA_NET_END)	/* signature */
+	      return 0;
+	  extras->NumProfiles += 1;
+      }
+    return 1;
+}
+
+static int
+cmp_link_rowids (const void *p1, const void *p2)
+{
+/* compares two Links by ROWID (for qsort) */
+    RouteLinkRowidPtr pL1 = (RouteLinkRowidPtr) p1;
+    RouteLinkRowidPtr pL2 = (RouteLinkRowidPtr) p2;
+    if (pL1->Rowid == pL2->Rowid)
+	return pL1->Index - pL2->Index;
+    if (pL1->Rowid > pL2->Rowid)
+	return 1;
+    return -1;
+}
+
+static int
+find_link_rowid (RouteLinkRowidPtr index, int count, sqlite3_int64 rowid)
+{
+/* searching the first Link having the given ROWID; -1 if not found */
+    int lo = 0;
+    int hi = count;
+    while (lo < hi)
+      {
+	  int mid = lo + ((hi - lo) / 2);
+	  if (index[mid].Rowid < rowid)
+	      lo = mid + 1;
+	  else
+	      hi = mid;
+      }
+    if (lo < count && index[lo].Rowid == rowid)
+	return lo;
+    return -1;
+}
+
+static int
+network_turns_resolve (RoutingPtr graph, RouteLinkRowidPtr index,
+		       RouteExtrasPtr extras)
+{
+/*
+/ resolving all Turns (by ROWID) into pairs of Links meeting at the
+/ same Node, then building the Turns CSR (keyed by incoming Link)
+*/
+    int i;
+    int pass;
+    int count = 0;
+    int *fill = NULL;
+    graph->TurnOffsets = calloc (graph->NumLinks + 1, sizeof (int));
+    if (graph->TurnOffsets == NULL)
+	return 0;
+    for (pass = 0; pass < 2; pass++)
+      {
+	  /* 1st pass: counting; 2nd pass: filling */
+	  for (i = 0; i < extras->NumTurns; i++)
+	    {
+		RouteTurnRawPtr pT = extras->Turns + i;
+		int ia = find_link_rowid (index, graph->NumLinks, pT->FromRowid);
+		int ib0 = find_link_rowid (index, graph->NumLinks, pT->ToRowid);
+		if (ia < 0 || ib0 < 0)
+		    continue;	/* undefined Link */
+		for (; ia < graph->NumLinks && index[ia].Rowid == pT->FromRowid;
+		     ia++)
+		  {
+		      RouteLinkPtr from = graph->Links + index[ia].Index;
+		      int ib;
+		      for (ib = ib0;
+			   ib < graph->NumLinks
+			   && index[ib].Rowid == pT->ToRowid; ib++)
+			{
+			    RouteLinkPtr to = graph->Links + index[ib].Index;
+			    if (to->NodeFrom != from->NodeTo)
+				continue;
+			    if (pass == 0)
+				graph->TurnOffsets[index[ia].Index + 1] += 1;
+			    else
+			      {
+				  RouteTurnPtr pR =
+				      graph->Turns + fill[index[ia].Index]++;
+				  pR->LinkTo = index[ib].Index;
+				  pR->Cost = (pT->Cost < 0.0) ? -1.0 : pT->Cost;
+			      }
+			}
+		  }
+	    }
+	  if (pass == 0)
+	    {
+		for (i = 0; i < graph->NumLinks; i++)
+		    graph->TurnOffsets[i + 1] += graph->TurnOffsets[i];
+		count = graph->TurnOffsets[graph->NumLinks];
+		if (count == 0)
+		    break;
+		graph->Turns = malloc (sizeof (RouteTurn) * count);
+		fill = malloc (sizeof (int) * graph->NumLinks);
+		if (graph->Turns == NULL || fill == NULL)
+		  {
+		      if (fill != NULL)
+			  free (fill);
+		      return 0;
+		  }
+		memcpy (fill, graph->TurnOffsets, sizeof (int) * graph->NumLinks);
+	    }
+      }
+    if (fill != NULL)
+	free (fill);
+    graph->NumTurns = count;
+    if (count == 0)
+      {
+	  /* no Turn at all referencing valid Links */
+	  free (graph->TurnOffsets);
+	  graph->TurnOffsets = NULL;
+      }
+    return 1;
+}
+
+static int
+network_profiles_resolve (RoutingPtr graph, RouteLinkRowidPtr index,
+			  RouteExtrasPtr extras)
+{
+/* resolving all Time Dependent profiles (by ROWID) into Links */
+    int i;
+    int found = 0;
+    graph->LinkProfiles = calloc (graph->NumLinks, sizeof (RouteLinkProfile));
+    if (graph->LinkProfiles == NULL)
+	return 0;
+    for (i = 0; i < extras->NumProfiles; i++)
+      {
+	  RouteProfileRawPtr pP = extras->Profiles + i;
+	  int il = find_link_rowid (index, graph->NumLinks, pP->Rowid);
+	  if (il < 0)
+	      continue;		/* undefined Link */
+	  for (; il < graph->NumLinks && index[il].Rowid == pP->Rowid; il++)
+	    {
+		/* both directions of a bidirectional Link share the profile */
+		RouteLinkPtr link = graph->Links + index[il].Index;
+		RouteLinkProfilePtr pLP = graph->LinkProfiles + index[il].Index;
+		int ip;
+		pLP->First = pP->First;
+		pLP->Count = pP->Count;
+		found = 1;
+		for (ip = 0; ip < pP->Count; ip++)
+		  {
+		      /* a lower bound for the A* heuristic */
+		      double cost = extras->Points[pP->First + ip].Cost;
+		      if (link->Cost > 0.0
+			  && cost / link->Cost < graph->ProfileMinRatio)
+			  graph->ProfileMinRatio = cost / link->Cost;
+		  }
+	    }
+      }
+    if (!found)
+      {
+	  free (graph->LinkProfiles);
+	  graph->LinkProfiles = NULL;
+	  return 1;
+      }
+/* the breakpoints now belong to the graph */
+    graph->ProfilePoints = extras->Points;
+    graph->NumProfilePoints = extras->NumPoints;
+    extras->Points = NULL;
+    return 1;
+}
+
+static int
+network_extras_resolve (RoutingPtr graph, RouteExtrasPtr extras)
+{
+/* resolving all Turns and Time Dependent profiles */
+    RouteLinkRowidPtr index;
+    int i;
+    int ok = 0;
+    if (extras->NumTurns == 0 && extras->NumProfiles == 0)
+	return 1;
+    index = malloc (sizeof (RouteLinkRowid) * graph->NumLinks);
+    if (index == NULL)
+	return 0;
+    for (i = 0; i < graph->NumLinks; i++)
+      {
+	  index[i].Rowid = graph->Links[i].LinkRowid;
+	  index[i].Index = i;
       }
-    if (*ptr != GAIA_NET_END)	/* signature */
-	return NULL;
-    graph = malloc (sizeof (Routing));
-    graph->Srid = VROUTE_INVALID_SRID;
-    graph->HasZ = 0;
-    graph->Net64 = net64;
-    graph->AStar = aStar;
-    graph->EndianArch = endian_arch;
-    graph->CurrentIndex = 0;
-    graph->NodeCode = node_code;
-    graph->MaxCodeLength = max_code_length;
-    graph->NumNodes = nodes;
-    graph->Nodes = malloc (sizeof (RouteNode) * nodes);
-    for (i = 0; i < nodes; i++)
+    qsort (index, graph->NumLinks, sizeof (RouteLinkRowid), cmp_link_rowids);
+    if (extras->NumTurns > 0)
       {
-	  graph->Nodes[i].Code = NULL;
-	  graph->Nodes[i].NumLinks = 0;
-	  graph->Nodes[i].Links = NULL;
+	  if (!network_turns_resolve (graph, index, extras))
+	      goto end;
       }
-    len = strlen (table);
-    graph->TableName = malloc (len + 1);
-    strcpy (graph->TableName, table);
-    len = strlen (from);
-    graph->FromColumn = malloc (len + 1);
-    strcpy (graph->FromColumn, from);
-    len = strlen (to);
-    graph->ToColumn = malloc (len + 1);
-    strcpy (graph->ToColumn, to);
-    len = strlen (geom);
-    if (len <= 1)
-	graph->GeometryColumn = NULL;
-    else
+    if (extras->NumProfiles > 0)
       {
-	  graph->GeometryColumn = malloc (len + 1);
-	  strcpy (graph->GeometryColumn, geom);
+	  if (!network_profiles_resolve (graph, index, extras))
+	      goto end;
       }
-    if (!net64)
+    ok = 1;
+  end:
+    free (index);
+    if (!ok)
+	network_extras_free (graph);
+    return ok;
+}
+
+static void
+network_extras_cleanup (RouteExtrasPtr extras)
+{
+/* freeing the Turns and Time Dependent profiles as parsed from Blocks */
+    if (extras->Turns != NULL)
+	free (extras->Turns);
+    if (extras->Profiles != NULL)
+	free (extras->Profiles);
+    if (extras->Points != NULL)
+	free (extras->Points);
+}
+
+static unsigned char *
+network_sidecar_map (const char *path, size_t * size)
+{
+/* mapping a whole sidecar file in memory (read only) */
+    FILE *in;
+    unsigned char *mapping;
+    long len;
+    in = fopen (path, "rb");
+    if (in == NULL)
+	return NULL;
+    if (fseek (in, 0, SEEK_END) != 0 || (len = ftell (in)) <= 0)
       {
-	  /* Name column is not supported */
-	  graph->NameColumn = NULL;
+	  fclose (in);
+	  return NULL;
       }
-    else
+#ifdef _WIN32
+    mapping = malloc (len);
+    if (mapping != NULL)
       {
-	  len = strlen (name);
-	  if (len <= 1)
-	      graph->NameColumn = NULL;
-	  else
+	  rewind (in);
+	  if (fread (mapping, 1, len, in) != (size_t) len)
 	    {
-		graph->NameColumn = malloc (len + 1);
-		strcpy (graph->NameColumn, name);
+		free (mapping);
+		mapping = NULL;
 	    }
       }
-    graph->AStarHeuristicCoeff = a_star_coeff;
-    return graph;
+#else
+/* a shared mapping: any process using the same sidecar file shares its pages */
+    mapping = mmap (NULL, len, PROT_READ, MAP_SHARED, fileno (in), 0);
+    if (mapping == MAP_FAILED)
+	mapping = NULL;
+#endif
+    fclose (in);
+    *size = len;
+    return mapping;
+}
+
+static size_t
+network_sidecar_layout (int nodes, int links, int codes, size_t * off_offsets,
+			size_t * off_links, size_t * off_codes)
+{
+/* computing the position of each array into a sidecar file */
+    size_t off_nodes = VROUTE_SIDECAR_ALIGN (sizeof (RoutingSidecarHeader));
+    *off_offsets =
+	VROUTE_SIDECAR_ALIGN (off_nodes + ((size_t) nodes * sizeof (RouteNode)));
+    *off_links =
+	VROUTE_SIDECAR_ALIGN (*off_offsets +
+			      ((size_t) (nodes + 1) * sizeof (int)));
+    *off_codes =
+	VROUTE_SIDECAR_ALIGN (*off_links + ((size_t) links * sizeof (RouteLink)));
+    return *off_codes + (size_t) codes;
 }
 
 static int
-network_block (RoutingPtr graph, const unsigned char *blob, int size)
+network_sidecar_check (RoutingPtr graph)
 {
-/* parsing a NETWORK Block */
-    const unsigned char *in = blob;
-    int nodes;
+/* 
+/ sanity check: a damaged sidecar file must never cause any 
+/ out of bounds access
+*/
     int i;
-    int ia;
-    int index;
-    char *code = NULL;
-    double x;
-    double y;
-    sqlite3_int64 nodeId = -1;
-    int links;
-    RouteNodePtr pN;
-    RouteLinkPtr pA;
-    int len;
-    sqlite3_int64 linkId;
-    int nodeToIdx;
-    double cost;
-    if (size < 3)
-	goto error;
-    if (*in++ != GAIA_NET_BLOCK)	/* signature */
-	goto error;
-    nodes = gaiaImport16 (in, 1, graph->EndianArch);	/* # Nodes */
-    in += 2;
-    code = malloc (graph->MaxCodeLength + 1);
-    for (i = 0; i < nodes; i++)
+    if (graph->LinkOffsets[0] != 0
+	|| graph->LinkOffsets[graph->NumNodes] != graph->NumLinks)
+	return 0;
+    if (graph->CodesSize > 0 && graph->Codes[graph->CodesSize - 1] != '\0')
+	return 0;
+    for (i = 0; i < graph->NumNodes; i++)
       {
-	  /* parsing each node */
-	  if ((size - (in - blob)) < 5)
-	      goto error;
-	  if (*in++ != GAIA_NET_NODE)	/* signature */
-	      goto error;
-	  index = gaiaImport32 (in, 1, graph->EndianArch);	/* node internal index */
-	  in += 4;
-	  if (index < 0 || index >= graph->NumNodes)
-	      goto error;
-	  if (graph->NodeCode)
-	    {
-		/* Nodes are identified by a TEXT Code */
-		if ((size - (in - blob)) < graph->MaxCodeLength)
-		    goto error;
-		memcpy (code, in, graph->MaxCodeLength);
-		*(code + graph->MaxCodeLength) = '\0';
-		in += graph->MaxCodeLength;
-	    }
-	  else
-	    {
-		/* Nodes are identified by an INTEGER Id */
-		if (graph->Net64)
-		  {
-		      if ((size - (in - blob)) < 8)
-			  goto error;
-		      nodeId = gaiaImportI64 (in, 1, graph->EndianArch);	/* the Node ID: 64bit */
-		      in += 8;
-		  }
-		else
-		  {
-		      if ((size - (in - blob)) < 4)
-			  goto error;
-		      nodeId = gaiaImport32 (in, 1, graph->EndianArch);	/* the Node ID: 32bit */
-		      in += 4;
-		  }
-	    }
-	  if (graph->AStar)
-	    {
-		/* fetching node's X,Y coords */
-		if ((size - (in - blob)) < 8)
-		    goto error;
-		x = gaiaImport64 (in, 1, graph->EndianArch);	/* X coord */
-		in += 8;
-		if ((size - (in - blob)) < 8)
-		    goto error;
-		y = gaiaImport64 (in, 1, graph->EndianArch);	/* Y coord */
-		in += 8;
-	    }
-	  else
-	    {
-		x = DBL_MAX;
-		y = DBL_MAX;
-	    }
-	  if ((size - (in - blob)) < 2)
-	      goto error;
-	  links = gaiaImport16 (in, 1, graph->EndianArch);	/* # Links */
-	  in += 2;
-	  if (links < 0)
-	      goto error;
-	  /* initializing the Node */
-	  pN = graph->Nodes + index;
-	  pN->InternalIndex = index;
-	  if (graph->NodeCode)
-	    {
-		/* Nodes are identified by a TEXT Code */
-		pN->Id = -1;
-		len = strlen (code);
-		pN->Code = malloc (len + 1);
-		strcpy (pN->Code, code);
-	    }
-	  else
-	    {
-		/* Nodes are identified by an INTEGER Id */
-		pN->Id = nodeId;
-		pN->Code = NULL;
-	    }
-	  pN->CoordX = x;
-	  pN->CoordY = y;
-	  pN->NumLinks = links;
-	  if (links)
-	    {
-		/* parsing the Links */
-		pN->Links = malloc (sizeof (RouteLink) * links);
-		for (ia = 0; ia < links; ia++)
-		  {
-		      /* parsing each Link */
-		      if (graph->Net64)
-			{
-			    if ((size - (in - blob)) < 22)
-				goto error;
-			}
-		      else
-			{
-			    if ((size - (in - blob)) < 18)
-				goto error;
-			}
-		      if (*in++ != GAIA_NET_ARC)	/* signature */
-			  goto error;
-		      if (graph->Net64)
-			{
-			    linkId = gaiaImportI64 (in, 1, graph->EndianArch);	/* # Link ROWID: 64bit */
-			    in += 8;
-			}
-		      else
-			{
-			    linkId = gaiaImport32 (in, 1, graph->EndianArch);	/* # Link ROWID: 32bit */
-			    in += 4;
-			}
-		      nodeToIdx = gaiaImport32 (in, 1, graph->EndianArch);	/* # NodeTo internal index */
-		      in += 4;
-		      cost = gaiaImport64 (in, 1, graph->EndianArch);	/* # Cost */
-		      in += 8;
-		      if (*in++ != GAIA_NET_END)	/* signature */
-			  goto error;
-		      pA = pN->Links + ia;
-		      /* initializing the Link */
-		      if (nodeToIdx < 0 || nodeToIdx >= graph->NumNodes)
-			  goto error;
-		      pA->NodeFrom = pN;
-		      pA->NodeTo = graph->Nodes + nodeToIdx;
-		      pA->LinkRowid = linkId;
-		      pA->Cost = cost;
-		  }
+	  RouteNodePtr pN = graph->Nodes + i;
+	  if (graph->LinkOffsets[i + 1] < graph->LinkOffsets[i])
+	      return 0;
+	  if (pN->InternalIndex != i || pN->CodeOffset >= graph->CodesSize)
+	      return 0;
+	  if (graph->NodeCode && pN->CodeOffset < 0)
+	      return 0;
+      }
+    for (i = 0; i < graph->NumLinks; i++)
+      {
+	  RouteLinkPtr pA = graph->Links + i;
+	  if (pA->NodeFrom < 0 || pA->NodeFrom >= graph->NumNodes
+	      || pA->NodeTo < 0 || pA->NodeTo >= graph->NumNodes)
+	      return 0;
+      }
+    return 1;
+}
+
+static int
+network_sidecar_attach (RoutingPtr graph, const char *path)
+{
+/* attempting to map the graph arrays from a sidecar file */
+    RoutingSidecarHeader hdr;
+    unsigned char *mapping;
+    size_t size;
+    size_t off_offsets;
+    size_t off_links;
+    size_t off_codes;
+    mapping = network_sidecar_map (path, &size);
+    if (mapping == NULL)
+	return 0;
+    if (size < sizeof (RoutingSidecarHeader))
+	goto invalid;
+    memcpy (&hdr, mapping, sizeof (RoutingSidecarHeader));
+    if (memcmp (hdr.Magic, VROUTE_SIDECAR_MAGIC, 8) != 0
+	|| hdr.Endian != VROUTE_SIDECAR_ENDIAN
+	|| hdr.NodeSize != sizeof (RouteNode)
+	|| hdr.LinkSize != sizeof (RouteLink)
+	|| hdr.NumNodes != graph->NumNodes || hdr.NumLinks < 0
+	|| hdr.CodesSize < 0)
+	goto invalid;
+    if (size !=
+	network_sidecar_layout (hdr.NumNodes, hdr.NumLinks, hdr.CodesSize,
+				&off_offsets, &off_links, &off_codes))
+	goto invalid;
+    graph->Mapping = mapping;
+    graph->MappingSize = size;
+    graph->Nodes =
+	(RouteNodePtr) (mapping +
+			VROUTE_SIDECAR_ALIGN (sizeof (RoutingSidecarHeader)));
+    graph->LinkOffsets = (int *) (mapping + off_offsets);
+    graph->NumLinks = hdr.NumLinks;
+    graph->Links = (RouteLinkPtr) (mapping + off_links);
+    graph->CodesSize = hdr.CodesSize;
+    graph->Codes = (hdr.CodesSize == 0) ? NULL : (char *) (mapping + off_codes);
+    if (!network_sidecar_check (graph))
+      {
+	  graph->Mapping = NULL;
+	  graph->MappingSize = 0;
+	  graph->Nodes = NULL;
+	  graph->LinkOffsets = NULL;
+	  graph->NumLinks = 0;
+	  graph->Links = NULL;
+	  graph->CodesSize = 0;
+	  graph->Codes = NULL;
+	  goto invalid;
+      }
+    return 1;
+  invalid:
+    network_sidecar_unmap (mapping, size);
+    return 0;
+}
+
+static sqlite3_int64
+network_sidecar_hash (RoutingPtr graph)
+{
+/* returning the DataHash stored into the mapped sidecar file */
+    RoutingSidecarHeader hdr;
+    memcpy (&hdr, graph->Mapping, sizeof (RoutingSidecarHeader));
+    return hdr.DataHash;
+}
+
+static int
+network_sidecar_save (RoutingPtr graph, const char *path,
+		      sqlite3_int64 data_hash)
+{
+/*
+/ saving the graph into a sidecar file
+
+/ the file is written under a temporary name and then renamed,
+/ so that any other process still mapping the previous version
+/ will never see a partially written file
+*/
+    RoutingSidecarHeader hdr;
+    unsigned char header[VROUTE_SIDECAR_ALIGN (sizeof (RoutingSidecarHeader))];
+    unsigned char pad[8];
+    size_t off_offsets;
+    size_t off_links;
+    size_t off_codes;
+    size_t pos;
+    char *tmp_path;
+    FILE *out;
+    int ok = 1;
+    memset (header, 0, sizeof (header));
+    memset (pad, 0, sizeof (pad));
+    memset (&hdr, 0, sizeof (RoutingSidecarHeader));
+    memcpy (hdr.Magic, VROUTE_SIDECAR_MAGIC, 8);
+    hdr.Endian = VROUTE_SIDECAR_ENDIAN;
+    hdr.NodeSize = sizeof (RouteNode);
+    hdr.LinkSize = sizeof (RouteLink);
+    hdr.NumNodes = graph->NumNodes;
+    hdr.NumLinks = graph->NumLinks;
+    hdr.CodesSize = graph->CodesSize;
+    hdr.DataHash = data_hash;
+    memcpy (header, &hdr, sizeof (RoutingSidecarHeader));
+    network_sidecar_layout (hdr.NumNodes, hdr.NumLinks, hdr.CodesSize,
+			    &off_offsets, &off_links, &off_codes);
+
+#ifdef _WIN32
+    tmp_path = sqlite3_mprintf ("%s.%d.tmp", path, _getpid ());
+#else
+    tmp_path = sqlite3_mprintf ("%s.%d.tmp", path, (int) getpid ());
+#endif
+    out = fopen (tmp_path, "wb");
+    if (out == NULL)
+      {
+	  sqlite3_free (tmp_path);
+	  return 0;
+      }
+    if (fwrite (header, 1, sizeof (header), out) != sizeof (header))
+	ok = 0;
+    pos = sizeof (header);
+    if (ok && graph->NumNodes > 0
+	&& fwrite (graph->Nodes, sizeof (RouteNode), graph->NumNodes,
+		   out) != (size_t) graph->NumNodes)
+	ok = 0;
+    pos += (size_t) graph->NumNodes * sizeof (RouteNode);
+    if (ok && fwrite (pad, 1, off_offsets - pos, out) != off_offsets - pos)
+	ok = 0;
+    if (ok
+	&& fwrite (graph->LinkOffsets, sizeof (int), graph->NumNodes + 1,
+		   out) != (size_t) (graph->NumNodes + 1))
+	ok = 0;
+    pos = off_offsets + ((size_t) (graph->NumNodes + 1) * sizeof (int));
+    if (ok && fwrite (pad, 1, off_links - pos, out) != off_links - pos)
+	ok = 0;
+    if (ok && graph->NumLinks > 0
+	&& fwrite (graph->Links, sizeof (RouteLink), graph->NumLinks,
+		   out) != (size_t) graph->NumLinks)
+	ok = 0;
+    pos = off_links + ((size_t) graph->NumLinks * sizeof (RouteLink));
+    if (ok && fwrite (pad, 1, off_codes - pos, out) != off_codes - pos)
+	ok = 0;
+    if (ok && graph->CodesSize > 0
+	&& fwrite (graph->Codes, 1, graph->CodesSize,
+		   out) != (size_t) graph->CodesSize)
+	ok = 0;
+    if (fclose (out) != 0)
+	ok = 0;
+    if (ok)
+      {
+#ifdef _WIN32
+	  remove (path);
+#endif
+	  if (rename (tmp_path, path) != 0)
+	      ok = 0;
+      }
+    if (!ok)
+	remove (tmp_path);
+    sqlite3_free (tmp_path);
+    return ok;
+}
+
+static sqlite3_int64
+network_hash_blob (sqlite3_int64 hash, const unsigned char *blob, int size)
+{
+/* FNV-1a hashing some Network Block */
+    sqlite3_uint64 h = (sqlite3_uint64) hash;
+    int i;
+    for (i = 0; i < size; i++)
+      {
+	  h ^= blob[i];
+	  h *= 1099511628211ULL;
+      }
+    return (sqlite3_int64) h;
+}
+
+static sqlite3_int64
+network_parse_generation (const unsigned char *blob, int size)
+{
+/* parsing the Generation of an incrementally updated network */
+    if (size < 10 || *blob != GAIA_NET_UPDATE_BLOCK
+	|| *(blob + 9) != GAIA_NET_END)
+	return 0;
+    return gaiaImportI64 (blob + 1, 1, gaiaEndianArch ());
+}
+
+static void
+network_ch_check (RoutingPtr graph)
+{
+/* checking the Contraction Hierarchies for completeness */
+    int i;
+    if (graph == NULL || graph->ChNodes == NULL)
+	return;
+    for (i = 0; i < graph->NumNodes; i++)
+      {
+	  if (graph->ChNodes[i].Rank < 0)
+	    {
+		network_ch_free (graph);
+		break;
 	    }
-	  else
-	      pN->Links = NULL;
-	  if ((size - (in - blob)) < 1)
-	      goto error;
-	  if (*in++ != GAIA_NET_END)	/* signature */
-	      goto error;
       }
-    free (code);
-    return 1;
-  error:
-    if (code != NULL)
-	free (code);
-    return 0;
 }
 
 static RoutingPtr
-load_network (sqlite3 * handle, const char *table)
+load_network_blocks (sqlite3 * handle, const char *table,
+		     const char *sidecar_path, sqlite3_int64 * data_hash)
 {
-/* loads the NETWORK struct */
+/* 
+/ loads the NETWORK struct from its BLOBs
+/
+/ if a sidecar path is given and the sidecar file is mapped, ordinary 
+/ Network Blocks are just hashed and never parsed; the caller is then
+/ expected to check the hash so to detect any stale sidecar file
+*/
     RoutingPtr graph = NULL;
     sqlite3_stmt *stmt;
     char *sql;
     int ret;
     int header = 1;
+    int csr = 0;
     const unsigned char *blob;
     int size;
     char *xname;
+    sqlite3_int64 hash = (sqlite3_int64) 14695981039346656037ULL;
+    sqlite3_int64 id;
+    sqlite3_int64 generation = 0;
+    RouteExtras extras;
+    memset (&extras, 0, sizeof (RouteExtras));
     xname = gaiaDoubleQuotedSql (table);
-    sql = sqlite3_mprintf ("SELECT NetworkData FROM \"%s\" ORDER BY Id", xname);
+    sql =
+	sqlite3_mprintf ("SELECT Id, NetworkData FROM \"%s\" ORDER BY Id",
+			 xname);
     free (xname);
     ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt, NULL);
     sqlite3_free (sql);
@@ -5212,16 +7715,35 @@ load_network (sqlite3 * handle, const char *table)
 	      break;
 	  if (ret == SQLITE_ROW)
 	    {
-		if (sqlite3_column_type (stmt, 0) == SQLITE_BLOB)
+		if (sqlite3_column_type (stmt, 1) == SQLITE_BLOB)
 		  {
+		      id = sqlite3_column_int64 (stmt, 0);
 		      blob =
-			  (const unsigned char *) sqlite3_column_blob (stmt, 0);
-		      size = sqlite3_column_bytes (stmt, 0);
+			  (const unsigned char *) sqlite3_column_blob (stmt, 1);
+		      size = sqlite3_column_bytes (stmt, 1);
+		      if (id < 0)
+			{
+			    /* incremental updates: just the Generation matters */
+			    if (id == GAIA_NET_UPDATE_STAMP_ID)
+				generation = network_parse_generation (blob,
+								       size);
+			    continue;
+			}
 		      if (header)
 			{
 			    /* parsing the HEADER block */
 			    graph = network_init (blob, size);
 			    header = 0;
+			    if (graph != NULL)
+			      {
+				  hash = network_hash_blob (hash, blob, size);
+				  if (sidecar_path != NULL
+				      && network_sidecar_attach (graph,
+								 sidecar_path))
+				      csr = 1;
+				  else
+				      network_alloc (graph);
+			      }
 			}
 		      else
 			{
@@ -5231,10 +7753,54 @@ load_network (sqlite3 * handle, const char *table)
 				  sqlite3_finalize (stmt);
 				  goto abort;
 			      }
-			    if (!network_block (graph, blob, size))
+			    if (size > 0 && *blob == GAIA_NET_TURN_BLOCK)
 			      {
-				  sqlite3_finalize (stmt);
-				  goto abort;
+				  /* Turns Block: resolved at the end */
+				  if (!network_turn_block
+				      (&extras, graph->EndianArch, blob, size))
+				    {
+					sqlite3_finalize (stmt);
+					goto abort;
+				    }
+			      }
+			    else if (size > 0 && *blob == GAIA_NET_TD_BLOCK)
+			      {
+				  /* Time Dependent Block: resolved at the end */
+				  if (!network_td_block
+				      (&extras, graph->EndianArch, blob, size))
+				    {
+					sqlite3_finalize (stmt);
+					goto abort;
+				    }
+			      }
+			    else if (size > 0 && *blob == GAIA_NET_CH_BLOCK)
+			      {
+				  /* Contraction Hierarchies Block */
+				  if (!csr)
+				    {
+					if (!network_build_csr (graph))
+					  {
+					      sqlite3_finalize (stmt);
+					      goto abort;
+					  }
+					csr = 1;
+				    }
+				  if (!network_ch_block (graph, blob, size))
+				    {
+					sqlite3_finalize (stmt);
+					goto abort;
+				    }
+			      }
+			    else
+			      {
+				  hash = network_hash_blob (hash, blob, size);
+				  if (graph->Mapping == NULL
+				      && !network_block (graph, blob, size))
+				    {
+					sqlite3_finalize (stmt);
+					goto abort;
+				    }
+				  graph->LastBlockId = id;
 			      }
 			}
 		  }
@@ -5251,13 +7817,480 @@ load_network (sqlite3 * handle, const char *table)
 	    }
       }
     sqlite3_finalize (stmt);
-    find_srid (handle, graph);
+    if (graph == NULL)
+	goto abort;
+    if (!csr)
+      {
+	  if (!network_build_csr (graph))
+	      goto abort;
+      }
+    network_ch_check (graph);
+    if (!network_extras_resolve (graph, &extras))
+	goto abort;
+    network_extras_cleanup (&extras);
+    graph->Generation = generation;
+    *data_hash = hash;
     return graph;
   abort:
+    network_extras_cleanup (&extras);
     network_free (graph);
     return NULL;
 }
 
+static RoutingPtr
+load_network (sqlite3 * handle, const char *table, const char *sidecar_path)
+{
+/* loads the NETWORK struct */
+    RoutingPtr graph;
+    sqlite3_int64 data_hash;
+    graph = load_network_blocks (handle, table, sidecar_path, &data_hash);
+    if (graph != NULL && graph->Mapping != NULL
+	&& network_sidecar_hash (graph) != data_hash)
+      {
+	  /* stale sidecar file: the network has been rebuilt since then */
+	  network_free (graph);
+	  graph = load_network_blocks (handle, table, NULL, &data_hash);
+      }
+    if (graph == NULL)
+	return NULL;
+    if (sidecar_path != NULL && graph->Mapping == NULL)
+      {
+	  /* 
+	     / saving a sidecar file; any further connection will then be
+	     / able to simply map the graph, sharing its memory pages
+	   */
+	  network_sidecar_save (graph, sidecar_path, data_hash);
+      }
+    find_srid (handle, graph);
+    return graph;
+}
+
+/*
+/
+/ incremental updates
+/
+/ CreateRouting_UpdateLinks() rewrites just a few ordinary Blocks,
+/ bumping the Generation and recording the Id of every modified Block;
+/ an already loaded network can then be patched by simply reloading
+/ all the Blocks modified since the Generation it was loaded from,
+/ replacing the outcoming Links of all the Nodes they contain
+/
+*/
+
+typedef struct RoutePatchNodeStruct
+{
+/* a Node reloaded from some modified Block */
+    int Index;			/* the Node internal index */
+    int First;			/* the first outcoming Link into the patch */
+    int Count;			/* # outcoming Links */
+} RoutePatchNode;
+typedef RoutePatchNode *RoutePatchNodePtr;
+
+typedef struct RoutePatchStruct
+{
+/* all the Nodes and Links reloaded from modified Blocks */
+    int NumNodes;
+    int MaxNodes;
+    RoutePatchNodePtr Nodes;
+    int NumLinks;
+    int MaxLinks;
+    RouteLinkPtr Links;
+} RoutePatch;
+typedef RoutePatch *RoutePatchPtr;
+
+static void
+network_patch_cleanup (RoutePatchPtr patch)
+{
+/* freeing all the Nodes and Links reloaded from modified Blocks */
+    if (patch->Nodes != NULL)
+	free (patch->Nodes);
+    if (patch->Links != NULL)
+	free (patch->Links);
+}
+
+static int
+cmp_patch_nodes (const void *p1, const void *p2)
+{
+/* compares two reloaded Nodes by internal index (for qsort) */
+    RoutePatchNodePtr pN1 = (RoutePatchNodePtr) p1;
+    RoutePatchNodePtr pN2 = (RoutePatchNodePtr) p2;
+    return pN1->Index - pN2->Index;
+}
+
+static int
+network_patch_block (RoutingPtr graph, RoutePatchPtr patch,
+		     const unsigned char *blob, int size)
+{
+/* parsing a modified NETWORK Block (64 bit format only) */
+    const unsigned char *in = blob;
+    int nodes;
+    int i;
+    int ia;
+    int node_size = 5 + (graph->NodeCode ? graph->MaxCodeLength : 8) +
+	(graph->AStar ? 16 : 0);
+    if (size < 3)
+	return 0;
+    if (*in++ != GAIA_NET_BLOCK)	/* signature */
+	return 0;
+    nodes = gaiaImport16 (in, 1, graph->EndianArch);	/* # Nodes */
+    in += 2;
+    for (i = 0; i < nodes; i++)
+      {
+	  /* parsing each node */
+	  RoutePatchNodePtr pN;
+	  int index;
+	  int links;
+	  if ((size - (in - blob)) < node_size + 2)
+	      return 0;
+	  if (*in != GAIA_NET_NODE)	/* signature */
+	      return 0;
+	  index = gaiaImport32 (in + 1, 1, graph->EndianArch);	/* node internal index */
+	  if (index < 0 || index >= graph->NumNodes)
+	      return 0;
+	  in += node_size;	/* Node Id/Code and coords are never changed */
+	  links = gaiaImport16 (in, 1, graph->EndianArch);	/* # Links */
+	  in += 2;
+	  if (links < 0 || (size - (in - blob)) < (links * 22) + 1)
+	      return 0;
+	  if (patch->NumNodes == patch->MaxNodes)
+	    {
+		int max = (patch->MaxNodes == 0) ? 1024 : patch->MaxNodes * 2;
+		RoutePatchNodePtr new_nodes =
+		    realloc (patch->Nodes, sizeof (RoutePatchNode) * max);
+		if (new_nodes == NULL)
+		    return 0;
+		patch->Nodes = new_nodes;
+		patch->MaxNodes = max;
+	    }
+	  if (patch->NumLinks + links > patch->MaxLinks)
+	    {
+		int max = (patch->NumLinks + links) * 2;
+		RouteLinkPtr new_links =
+		    realloc (patch->Links, sizeof (RouteLink) * max);
+		if (new_links == NULL)
+		    return 0;
+		patch->Links = new_links;
+		patch->MaxLinks = max;
+	    }
+	  pN = patch->Nodes + patch->NumNodes++;
+	  pN->Index = index;
+	  pN->First = patch->NumLinks;
+	  pN->Count = links;
+	  for (ia = 0; ia < links; ia++)
+	    {
+		/* parsing each Link */
+		RouteLinkPtr pA = patch->Links + patch->NumLinks++;
+		if (*in++ != GAIA_NET_ARC)	/* signature */
+		    return 0;
+		pA->NodeFrom = index;
+		pA->LinkRowid = gaiaImportI64 (in, 1, graph->EndianArch);	/* # Link ROWID */
+		in += 8;
+		pA->NodeTo = gaiaImport32 (in, 1, graph->EndianArch);	/* # NodeTo internal index */
+		in += 4;
+		pA->Cost = gaiaImport64 (in, 1, graph->EndianArch);	/* # Cost */
+		in += 8;
+		if (*in++ != GAIA_NET_END)	/* signature */
+		    return 0;
+		if (pA->NodeTo < 0 || pA->NodeTo >= graph->NumNodes)
+		    return 0;
+	    }
+	  if (*in++ != GAIA_NET_END)	/* signature */
+	      return 0;
+      }
+    return 1;
+}
+
+static int
+network_patch_read (sqlite3 * handle, const char *table, RoutingPtr graph,
+		    RoutePatchPtr patch, RouteExtrasPtr extras,
+		    double *a_star_coeff)
+{
+/* reloading all the Blocks modified since the currently loaded Generation */
+    sqlite3_stmt *stmt = NULL;
+    sqlite3_stmt *stmt_block = NULL;
+    char *sql;
+    char *xname;
+    int ret;
+    int ok = 0;
+    xname = gaiaDoubleQuotedSql (table);
+    sql =
+	sqlite3_mprintf
+	("SELECT Id, NetworkData FROM \"%s\" WHERE Id IN (0, %d)", xname,
+	 GAIA_NET_UPDATE_LOG_ID);
+    ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto end;
+    sql = sqlite3_mprintf ("SELECT NetworkData FROM \"%s\" WHERE Id = ?",
+			   xname);
+    ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt_block, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto end;
+    while (1)
+      {
+	  const unsigned char *blob;
+	  int size;
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;
+	  if (ret != SQLITE_ROW || sqlite3_column_type (stmt, 1) != SQLITE_BLOB)
+	      goto end;
+	  blob = (const unsigned char *) sqlite3_column_blob (stmt, 1);
+	  size = sqlite3_column_bytes (stmt, 1);
+	  if (sqlite3_column_int64 (stmt, 0) == 0)
+	    {
+		/* the HEADER block: the A* Coeff could have been lowered */
+		RoutingPtr header = network_init (blob, size);
+		if (header == NULL)
+		    goto end;
+		if (header->NumNodes != graph->NumNodes
+		    || header->NodeCode != graph->NodeCode
+		    || header->AStar != graph->AStar || !header->Net64)
+		  {
+		      network_free (header);
+		      goto end;
+		  }
+		*a_star_coeff = header->AStarHeuristicCoeff;
+		network_free (header);
+	    }
+	  else
+	    {
+		/* the Log: reloading any Block modified since then */
+		int n;
+		int i;
+		if (size < 6 || *blob != GAIA_NET_UPDATE_BLOCK)
+		    goto end;
+		n = gaiaImport32 (blob + 1, 1, graph->EndianArch);
+		if (n < 0 || size < 6 + (n * 16))
+		    goto end;
+		for (i = 0; i < n; i++)
+		  {
+		      sqlite3_int64 id =
+			  gaiaImportI64 (blob + 5 + (i * 16), 1,
+					 graph->EndianArch);
+		      sqlite3_int64 generation =
+			  gaiaImportI64 (blob + 13 + (i * 16), 1,
+					 graph->EndianArch);
+		      if (generation <= graph->Generation)
+			  continue;
+		      sqlite3_reset (stmt_block);
+		      sqlite3_bind_int64 (stmt_block, 1, id);
+		      if (sqlite3_step (stmt_block) != SQLITE_ROW)
+			  goto end;
+		      if (!network_patch_block
+			  (graph, patch,
+			   (const unsigned char *)
+			   sqlite3_column_blob (stmt_block, 0),
+			   sqlite3_column_bytes (stmt_block, 0)))
+			  goto end;
+		  }
+	    }
+      }
+    sqlite3_finalize (stmt);
+    stmt = NULL;
+
+/* Turns and Time Dependent profiles will be resolved again */
+    sql =
+	sqlite3_mprintf
+	("SELECT NetworkData FROM \"%s\" WHERE Id > ? ORDER BY Id", xname);
+    ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto end;
+    sqlite3_bind_int64 (stmt, 1, graph->LastBlockId);
+    while (1)
+      {
+	  const unsigned char *blob;
+	  int size;
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;
+	  if (ret != SQLITE_ROW || sqlite3_column_type (stmt, 0) != SQLITE_BLOB)
+	      goto end;
+	  blob = (const unsigned char *) sqlite3_column_blob (stmt, 0);
+	  size = sqlite3_column_bytes (stmt, 0);
+	  if (size > 0 && *blob == GAIA_NET_TURN_BLOCK)
+	    {
+		if (!network_turn_block (extras, graph->EndianArch, blob, size))
+		    goto end;
+	    }
+	  else if (size > 0 && *blob == GAIA_NET_TD_BLOCK)
+	    {
+		if (!network_td_block (extras, graph->EndianArch, blob, size))
+		    goto end;
+	    }
+      }
+    ok = 1;
+
+  end:
+    free (xname);
+    if (stmt != NULL)
+	sqlite3_finalize (stmt);
+    if (stmt_block != NULL)
+	sqlite3_finalize (stmt_block);
+    return ok;
+}
+
+static int
+network_patch_private (RoutingPtr graph)
+{
+/* a memory mapped sidecar file is read only: copying the Nodes and Codes */
+    RouteNodePtr nodes;
+    char *codes = NULL;
+    if (graph->Mapping == NULL)
+	return 1;
+    nodes = malloc (sizeof (RouteNode) * graph->NumNodes);
+    if (nodes == NULL)
+	return 0;
+    if (graph->CodesSize > 0)
+      {
+	  codes = malloc (graph->CodesSize);
+	  if (codes == NULL)
+	    {
+		free (nodes);
+		return 0;
+	    }
+	  memcpy (codes, graph->Codes, graph->CodesSize);
+      }
+    memcpy (nodes, graph->Nodes, sizeof (RouteNode) * graph->NumNodes);
+    graph->Nodes = nodes;
+    graph->Codes = codes;
+    graph->MaxCodes = graph->CodesSize;
+    return 1;
+}
+
+static int
+network_patch (sqlite3 * handle, const char *table, RoutingPtr graph,
+	       sqlite3_int64 generation)
+{
+/*
+/ patching an already loaded network; on failure (e.g. some
+/ unsupported change) the caller is expected to load it again
+*/
+    RoutePatch patch;
+    RouteExtras extras;
+    int *offsets = NULL;
+    RouteLinkPtr links = NULL;
+    double a_star_coeff = graph->AStarHeuristicCoeff;
+    int i;
+    int ip;
+    int tot;
+    int ok = 0;
+    if (!graph->Net64)
+	return 0;
+    memset (&patch, 0, sizeof (RoutePatch));
+    memset (&extras, 0, sizeof (RouteExtras));
+    if (!network_patch_read
+	(handle, table, graph, &patch, &extras, &a_star_coeff))
+	goto end;
+    qsort (patch.Nodes, patch.NumNodes, sizeof (RoutePatchNode),
+	   cmp_patch_nodes);
+
+/* building the new CSR arrays */
+    tot = graph->NumLinks;
+    for (ip = 0; ip < patch.NumNodes; ip++)
+      {
+	  RoutePatchNodePtr pN = patch.Nodes + ip;
+	  if (ip > 0 && (pN - 1)->Index == pN->Index)
+	      goto end;		/* duplicate Node */
+	  tot -= graph->LinkOffsets[pN->Index + 1] -
+	      graph->LinkOffsets[pN->Index];
+	  tot += pN->Count;
+      }
+    offsets = malloc (sizeof (int) * (graph->NumNodes + 1));
+    links = malloc (sizeof (RouteLink) * (tot + 1));
+    if (offsets == NULL || links == NULL)
+	goto end;
+    tot = 0;
+    ip = 0;
+    for (i = 0; i < graph->NumNodes; i++)
+      {
+	  offsets[i] = tot;
+	  if (ip < patch.NumNodes && patch.Nodes[ip].Index == i)
+	    {
+		/* this Node has been reloaded */
+		RoutePatchNodePtr pN = patch.Nodes + ip++;
+		memcpy (links + tot, patch.Links + pN->First,
+			sizeof (RouteLink) * pN->Count);
+		tot += pN->Count;
+	    }
+	  else
+	    {
+		int cnt = graph->LinkOffsets[i + 1] - graph->LinkOffsets[i];
+		memcpy (links + tot, graph->Links + graph->LinkOffsets[i],
+			sizeof (RouteLink) * cnt);
+		tot += cnt;
+	    }
+      }
+    offsets[graph->NumNodes] = tot;
+    if (!network_patch_private (graph))
+	goto end;
+
+/* replacing the Links; CH shortcuts referencing them are no longer valid */
+    network_ch_free (graph);
+    network_extras_free (graph);
+    if (graph->Mapping != NULL)
+      {
+	  network_sidecar_unmap (graph->Mapping, graph->MappingSize);
+	  graph->Mapping = NULL;
+	  graph->MappingSize = 0;
+      }
+    else
+      {
+	  free (graph->LinkOffsets);
+	  free (graph->Links);
+      }
+    graph->LinkOffsets = offsets;
+    graph->Links = links;
+    graph->NumLinks = tot;
+    graph->MaxLinks = tot + 1;
+    offsets = NULL;
+    links = NULL;
+    graph->AStarHeuristicCoeff = a_star_coeff;
+    graph->Generation = generation;
+    ok = network_extras_resolve (graph, &extras);
+
+  end:
+    if (offsets != NULL)
+	free (offsets);
+    if (links != NULL)
+	free (links);
+    network_patch_cleanup (&patch);
+    network_extras_cleanup (&extras);
+    return ok;
+}
+
+static sqlite3_int64
+network_generation (sqlite3 * handle, const char *table)
+{
+/* querying the current Generation of some Routing Data table */
+    sqlite3_stmt *stmt;
+    char *sql;
+    char *xname;
+    int ret;
+    sqlite3_int64 generation = 0;
+    xname = gaiaDoubleQuotedSql (table);
+    sql =
+	sqlite3_mprintf ("SELECT NetworkData FROM \"%s\" WHERE Id = %d", xname,
+			 GAIA_NET_UPDATE_STAMP_ID);
+    free (xname);
+    ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	return -1;
+    ret = sqlite3_step (stmt);
+    if (ret == SQLITE_ROW && sqlite3_column_type (stmt, 0) == SQLITE_BLOB)
+	generation =
+	    network_parse_generation ((const unsigned char *)
+				      sqlite3_column_blob (stmt, 0),
+				      sqlite3_column_bytes (stmt, 0));
+    else if (ret != SQLITE_DONE && ret != SQLITE_ROW)
+	generation = -1;
+    sqlite3_finalize (stmt);
+    return generation;
+}
+
 static void
 set_multi_by_id (RoutingMultiDestPtr multiple, RoutingPtr graph)
 {
@@ -5284,6 +8317,97 @@ set_multi_by_code (RoutingMultiDestPtr multiple, RoutingPtr graph)
       }
 }
 
+static RoutingMultiDestPtr
+vroute_get_multiple_origins (virtualroutingPtr net, sqlite3_value * value)
+{
+/* parsing the Cost Matrix Origins: a single Node or a delimited list */
+    RoutingMultiDestPtr multiple = NULL;
+    int node_code = net->graph->NodeCode;
+    if (sqlite3_value_type (value) == SQLITE_TEXT)
+	multiple =
+	    vroute_get_multiple_destinations (node_code,
+					      net->currentDelimiter,
+					      (const char *)
+					      sqlite3_value_text (value));
+    else if (!node_code && sqlite3_value_type (value) == SQLITE_INTEGER)
+	multiple =
+	    vroute_as_multiple_destinations (sqlite3_value_int64 (value));
+    if (multiple == NULL)
+	return NULL;
+    if (node_code)
+	set_multi_by_code (multiple, net->graph);
+    else
+	set_multi_by_id (multiple, net->graph);
+    return multiple;
+}
+
+static int
+cmp_isochrone_bands (const void *p1, const void *p2)
+{
+/* compares two Isochrones bands by Cost [for QSORT] */
+    IsochroneBandPtr pB1 = (IsochroneBandPtr) p1;
+    IsochroneBandPtr pB2 = (IsochroneBandPtr) p2;
+    if (pB1->Cost == pB2->Cost)
+	return 0;
+    return (pB1->Cost < pB2->Cost) ? -1 : 1;
+}
+
+static void
+vroute_set_isochrone_bands (virtualroutingPtr net,
+			    MultiSolutionPtr multiSolution,
+			    sqlite3_value * value)
+{
+/* parsing the Isochrones Cost thresholds: a single value or a delimited list */
+    double costs[VROUTE_ISOCHRONE_MAX_BANDS];
+    size_t count = 0;
+    size_t i;
+    if (sqlite3_value_type (value) == SQLITE_INTEGER
+	|| sqlite3_value_type (value) == SQLITE_FLOAT)
+	costs[count++] = sqlite3_value_double (value);
+    else if (sqlite3_value_type (value) == SQLITE_TEXT)
+      {
+	  const char *p = (const char *) sqlite3_value_text (value);
+	  while (1)
+	    {
+		char *end;
+		double cost = strtod (p, &end);
+		if (end == p || count >= VROUTE_ISOCHRONE_MAX_BANDS)
+		    return;
+		costs[count++] = cost;
+		p = end;
+		while (*p == ' ')
+		    p++;
+		if (*p == '\0')
+		    break;
+		if (*p != net->currentDelimiter)
+		    return;
+		p++;
+	    }
+      }
+    for (i = 0; i < count; i++)
+      {
+	  /* NaN and Infinity are never valid thresholds */
+	  if (isnan (costs[i]) || isinf (costs[i]) || costs[i] <= 0.0)
+	      return;
+      }
+    if (count == 0)
+	return;
+    multiSolution->Bands = malloc (sizeof (IsochroneBand) * count);
+    if (multiSolution->Bands == NULL)
+	return;
+    for (i = 0; i < count; i++)
+      {
+	  IsochroneBandPtr band = multiSolution->Bands + i;
+	  band->Cost = costs[i];
+	  band->Blob = NULL;
+	  band->Size = 0;
+      }
+    qsort (multiSolution->Bands, count, sizeof (IsochroneBand),
+	   cmp_isochrone_bands);
+    multiSolution->NumBands = (int) count;
+    multiSolution->MaxCost = multiSolution->Bands[count - 1].Cost;
+}
+
 static int
 do_check_valid_point (gaiaGeomCollPtr geom, int srid)
 {
@@ -5351,15 +8475,20 @@ do_check_by_code_point2point_oneway (RoutingPtr graph, sqlite3_int64 rowid,
 {
 /* checking if the Link do really joins the two nodes */
     int j;
+    int num_links;
+    RouteLinkPtr links;
     RouteNodePtr node = find_node_by_code (graph, node_from);
     if (node == NULL)
 	return 0;
-    for (j = 0; j < node->NumLinks; j++)
-      {
-	  RouteLinkPtr link = &(node->Links[j]);
-	  if (strcmp (link->NodeFrom->Code, node_from) == 0
-	      && strcmp (link->NodeTo->Code, node_to) == 0
-	      && link->LinkRowid == rowid)
+    links = route_node_links (graph, node, &num_links);
+    for (j = 0; j < num_links; j++)
+      {
+	  RouteLinkPtr link = links + j;
+	  if (strcmp
+	      (route_node_code (graph, route_link_from (graph, link)),
+	       node_from) == 0
+	      && strcmp (route_node_code (graph, route_link_to (graph, link)),
+			 node_to) == 0 && link->LinkRowid == rowid)
 	      return 1;
       }
     return 0;
@@ -5372,13 +8501,17 @@ do_check_by_id_point2point_oneway (RoutingPtr graph, sqlite3_int64 rowid,
 {
 /* checking if the Link do really joins the two nodes */
     int j;
+    int num_links;
+    RouteLinkPtr links;
     RouteNodePtr node = find_node_by_id (graph, node_from);
     if (node == NULL)
 	return 0;
-    for (j = 0; j < node->NumLinks; j++)
+    links = route_node_links (graph, node, &num_links);
+    for (j = 0; j < num_links; j++)
       {
-	  RouteLinkPtr link = &(node->Links[j]);
-	  if (link->NodeFrom->Id == node_from && link->NodeTo->Id == node_to
+	  RouteLinkPtr link = links + j;
+	  if (route_link_from (graph, link)->Id == node_from
+	      && route_link_to (graph, link)->Id == node_to
 	      && link->LinkRowid == rowid)
 	      return 1;
       }
@@ -6181,7 +9314,7 @@ add_point2point_node_to_by_id (Point2PointSolutionPtr p2p, sqlite3_int64 id,
 }
 
 static void
-point2point_eval_solution (Point2PointSolutionPtr p2p,
+point2point_eval_solution (RoutingPtr graph, Point2PointSolutionPtr p2p,
 			   ShortestPathSolutionPtr solution, int nodeCode)
 {
 /* attempting to identify the optimal Point2Point solution */
@@ -6194,7 +9327,9 @@ point2point_eval_solution (Point2PointSolutionPtr p2p,
 	    {
 		if (nodeCode)
 		  {
-		      if (strcmp (solution->From->Code, p_from->codNodeTo) == 0)
+		      if (strcmp
+			  (route_node_code (graph, solution->From),
+			   p_from->codNodeTo) == 0)
 			  ok = 1;
 		  }
 		else
@@ -6215,7 +9350,7 @@ point2point_eval_solution (Point2PointSolutionPtr p2p,
 			    if (nodeCode)
 			      {
 				  if (strcmp
-				      (solution->To->Code,
+				      (route_node_code (graph, solution->To),
 				       p_to->codNodeFrom) == 0)
 				      ok2 = 1;
 			      }
@@ -6319,8 +9454,8 @@ find_link (sqlite3 * sqlite, RoutingPtr graph, sqlite3_int64 linkRowid)
 		      if (ptr != NULL)
 			  free (ptr);
 		      ptr = malloc (sizeof (RouteLink));
-		      ptr->NodeFrom = from;
-		      ptr->NodeTo = to;
+		      ptr->NodeFrom = from->InternalIndex;
+		      ptr->NodeTo = to->InternalIndex;
 		      ptr->LinkRowid = linkRowid;
 		      ptr->Cost = 0.0;
 		  }
@@ -6647,15 +9782,22 @@ build_point2point_solution (sqlite3 * sqlite, int options, RoutingPtr graph,
 					  {
 					      /* Geometry is LINESTRING as expected */
 					      int reverse = 1;
+					      RouteLinkPtr link =
+						  row->linkRef->Link;
+					      RouteNodePtr n_from =
+						  route_link_from (graph,
+								   link);
+					      RouteNodePtr n_to =
+						  route_link_to (graph, link);
 					      if (graph->NodeCode)
 						{
 						    /* nodes are identified by TEXT codes */
 						    const char *from =
-							row->linkRef->
-							Link->NodeFrom->Code;
+							route_node_code (graph,
+									 n_from);
 						    const char *to =
-							row->linkRef->
-							Link->NodeTo->Code;
+							route_node_code (graph,
+									 n_to);
 						    if (strcmp (from_code, from)
 							== 0
 							&& strcmp (to_code,
@@ -6666,11 +9808,8 @@ build_point2point_solution (sqlite3 * sqlite, int options, RoutingPtr graph,
 						{
 						    /* nodes are identified by INTEGER ids */
 						    sqlite3_int64 from =
-							row->linkRef->
-							Link->NodeFrom->Id;
-						    sqlite3_int64 to =
-							row->linkRef->
-							Link->NodeTo->Id;
+							n_from->Id;
+						    sqlite3_int64 to = n_to->Id;
 						    if (from_id == from
 							&& to_id == to)
 							reverse = 0;
@@ -6678,7 +9817,7 @@ build_point2point_solution (sqlite3 * sqlite, int options, RoutingPtr graph,
 					      add2DynLine
 						  (p2p->dynLine, geom, reverse,
 						   0.0,
-						   row->linkRef->Link->Cost);
+						   row->linkRef->Cost);
 					  }
 					else
 					    error = 1;
@@ -6905,7 +10044,8 @@ point2point_resolve (virtualroutingCursorPtr cursor)
 	  solution = cursor->pVtab->multiSolution->First;
 	  while (solution != NULL)
 	    {
-		point2point_eval_solution (p2p, solution, graph->NodeCode);
+		point2point_eval_solution (graph, p2p, solution,
+					   graph->NodeCode);
 		solution = solution->Next;
 	    }
 	  p_node_from = p_node_from->next;
@@ -6953,6 +10093,10 @@ point2point_resolve (virtualroutingCursorPtr cursor)
     if (net->currentAlgorithm == VROUTE_A_STAR_ALGORITHM)
 	astar_solve (cursor->pVtab->db, VROUTE_SHORTEST_PATH_QUICK, graph,
 		     cursor->pVtab->routing, cursor->pVtab->multiSolution);
+    else if (net->currentAlgorithm == VROUTE_CH_ALGORITHM)
+	ch_solve (cursor->pVtab->db, VROUTE_SHORTEST_PATH_QUICK, graph,
+		  cursor->pVtab->chSearch, cursor->pVtab->routing,
+		  cursor->pVtab->multiSolution);
     else
 	dijkstra_multi_solve (cursor->pVtab->db, VROUTE_SHORTEST_PATH_QUICK,
 			      graph, cursor->pVtab->routing,
@@ -7024,6 +10168,7 @@ point2point_resolve (virtualroutingCursorPtr cursor)
 			 p2p->fromCandidate->linkRowid);
 	  row->linkRef = malloc (sizeof (RowSolution));
 	  row->linkRef->Link = link;
+	  row->linkRef->Cost = (link != NULL) ? link->Cost : 0.0;
 	  row->linkRef->Name = NULL;
 	  row->linkRef->Next = NULL;
 	  row->TotalCost = p2p->fromCandidate->pathLen;
@@ -7077,6 +10222,7 @@ point2point_resolve (virtualroutingCursorPtr cursor)
 			 p2p->toCandidate->linkRowid);
 	  row->linkRef = malloc (sizeof (RowSolution));
 	  row->linkRef->Link = link;
+	  row->linkRef->Cost = (link != NULL) ? link->Cost : 0.0;
 	  row->linkRef->Name = NULL;
 	  row->linkRef->Next = NULL;
 	  row->TotalCost = p2p->toCandidate->pathLen;
@@ -7130,6 +10276,7 @@ vroute_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
     int n_columns;
     char *vtable = NULL;
     char *table = NULL;
+    char *sidecar_path = NULL;
     const char *col_name = NULL;
     char **results;
     char *err_msg = NULL;
@@ -7141,16 +10288,29 @@ vroute_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
     if (pAux)
 	pAux = pAux;		/* unused arg warning suppression */
 /* checking for table_name and geo_column_name */
-    if (argc == 4)
+    if (argc == 4 || argc == 5)
       {
 	  vtable = gaiaDequotedSql (argv[2]);
 	  table = gaiaDequotedSql (argv[3]);
+	  if (argc == 5)
+	    {
+		/*
+		   / the sidecar file allows other connections to simply map
+		   / the graph instead of parsing it again; since this implies
+		   / writing to the local file-system it is only enabled when
+		   / SPATIALITE_SECURITY=relaxed
+		 */
+		const char *security_level = getenv ("SPATIALITE_SECURITY");
+		if (security_level != NULL
+		    && strcasecmp (security_level, "relaxed") == 0)
+		    sidecar_path = gaiaDequotedSql (argv[4]);
+	    }
       }
     else
       {
 	  *pzErr =
 	      sqlite3_mprintf
-	      ("[virtualrouting module] CREATE VIRTUAL: illegal arg list {NETWORK-DATAtable}\n");
+	      ("[virtualrouting module] CREATE VIRTUAL: illegal arg list {NETWORK-DATAtable [, sidecar_path]}\n");
 	  goto error;
       }
 /* retrieving the base table columns */
@@ -7192,12 +10352,12 @@ vroute_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 	  *pzErr =
 	      sqlite3_mprintf
 	      ("[virtualrouting module] cannot build a valid NETWORK\n");
-	  return SQLITE_ERROR;
+	  goto error;
       }
     p_vt = (virtualroutingPtr) sqlite3_malloc (sizeof (virtualrouting));
     if (!p_vt)
 	return SQLITE_NOMEM;
-    graph = load_network (db, table);
+    graph = load_network (db, table, sidecar_path);
     if (!graph)
       {
 	  /* something is going the wrong way */
@@ -7207,6 +10367,8 @@ vroute_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 	  goto error;
       }
     p_vt->db = db;
+    p_vt->dataTable = table;
+    p_vt->sidecarPath = sidecar_path;
     p_vt->graph = graph;
     p_vt->currentAlgorithm = VROUTE_DIJKSTRA_ALGORITHM;
     p_vt->currentRequest = VROUTE_SHORTEST_PATH;
@@ -7214,6 +10376,7 @@ vroute_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
     p_vt->currentDelimiter = ',';
     p_vt->Tolerance = 20.0;
     p_vt->routing = NULL;
+    p_vt->chSearch = NULL;
     p_vt->pModule = &my_route_module;
     p_vt->nRef = 0;
     p_vt->zErrMsg = NULL;
@@ -7229,7 +10392,8 @@ vroute_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 				     "RouteId INTEGER, RouteRow INTEGER, Role TEXT, "
 				     "LinkRowid INTEGER, NodeFrom TEXT, NodeTo TEXT,"
 				     "PointFrom BLOB, PointTo BLOB, Tolerance DOUBLE, "
-				     "Cost DOUBLE, Geometry BLOB, Name TEXT)",
+				     "Cost DOUBLE, Geometry BLOB, Name TEXT, "
+				     "DepartureTime DOUBLE)",
 				     xname);
 	    }
 	  else
@@ -7240,7 +10404,8 @@ vroute_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 				     "RouteId INTEGER, RouteRow INTEGER, Role TEXT, "
 				     "LinkRowid INTEGER, NodeFrom TEXT, NodeTo TEXT,"
 				     "PointFrom BLOB, PointTo BLOB, Tolerance DOUBLE, "
-				     "Cost DOUBLE, Geometry BLOB)", xname);
+				     "Cost DOUBLE, Geometry BLOB, "
+				     "DepartureTime DOUBLE)", xname);
 	    }
       }
     else
@@ -7253,7 +10418,8 @@ vroute_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 				     "RouteId INTEGER, RouteRow INTEGER, Role TEXT, "
 				     "LinkRowid INTEGER, NodeFrom INTEGER, NodeTo INTEGER, "
 				     "PointFrom BLOB, PointTo BLOB, Tolerance Double, "
-				     "Cost DOUBLE, Geometry BLOB, Name TEXT)",
+				     "Cost DOUBLE, Geometry BLOB, Name TEXT, "
+				     "DepartureTime DOUBLE)",
 				     xname);
 	    }
 	  else
@@ -7264,7 +10430,8 @@ vroute_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 				     "RouteId INTEGER, RouteRow INTEGER, Role TEXT, "
 				     "LinkRowid INTEGER, NodeFrom INTEGER, NodeTo INTEGER, "
 				     "PointFrom BLOB, PointTo BLOB, Tolerance DOUBLE, "
-				     "Cost DOUBLE, Geometry BLOB)", xname);
+				     "Cost DOUBLE, Geometry BLOB, "
+				     "DepartureTime DOUBLE)", xname);
 	    }
       }
     free (xname);
@@ -7280,7 +10447,10 @@ vroute_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
     sqlite3_free (sql);
     *ppVTab = (sqlite3_vtab *) p_vt;
     p_vt->routing = routing_init (p_vt->graph);
-    free (table);
+    if (p_vt->graph->ChNodes != NULL)
+	p_vt->chSearch = ch_search_init (p_vt->graph);
+    if (p_vt->graph->TurnOffsets != NULL || p_vt->graph->LinkProfiles != NULL)
+	p_vt->routing->Td = td_search_init (p_vt->graph);
     free (vtable);
     return SQLITE_OK;
   error:
@@ -7288,6 +10458,8 @@ vroute_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 	free (table);
     if (vtable)
 	free (vtable);
+    if (sidecar_path)
+	free (sidecar_path);
     return SQLITE_ERROR;
 }
 
@@ -7424,9 +10596,18 @@ vroute_disconnect (sqlite3_vtab * pVTab)
 /* disconnects the virtual table */
     virtualroutingPtr p_vt = (virtualroutingPtr) pVTab;
     if (p_vt->routing)
-	routing_free (p_vt->routing);
+      {
+	  td_search_free (p_vt->routing->Td);
+	  routing_free (p_vt->routing);
+      }
+    if (p_vt->chSearch)
+	ch_search_free (p_vt->chSearch);
     if (p_vt->graph)
 	network_free (p_vt->graph);
+    if (p_vt->dataTable)
+	free (p_vt->dataTable);
+    if (p_vt->sidecarPath)
+	free (p_vt->sidecarPath);
     sqlite3_free (p_vt);
     return SQLITE_OK;
 }
@@ -7442,7 +10623,25 @@ static void
 vroute_read_row (virtualroutingCursorPtr cursor)
 {
 /* trying to read a "row" from Shortest Path solution */
-    if (cursor->pVtab->multiSolution->Mode == VROUTE_RANGE_SOLUTION)
+    MultiSolutionPtr multiSolution = cursor->pVtab->multiSolution;
+    if (multiSolution->Mode == VROUTE_MATRIX_SOLUTION)
+      {
+	  if (multiSolution->Matrix == NULL
+	      || multiSolution->CurrentRowId >=
+	      (sqlite3_int64) multiSolution->MultiFrom->Items *
+	      multiSolution->MultiTo->Items)
+	      cursor->pVtab->eof = 1;
+	  else
+	      cursor->pVtab->eof = 0;
+      }
+    else if (multiSolution->Mode == VROUTE_ISOCHRONE_SOLUTION)
+      {
+	  if (multiSolution->CurrentRowId >= multiSolution->NumBands)
+	      cursor->pVtab->eof = 1;
+	  else
+	      cursor->pVtab->eof = 0;
+      }
+    else if (cursor->pVtab->multiSolution->Mode == VROUTE_RANGE_SOLUTION)
       {
 	  if (cursor->pVtab->multiSolution->CurrentNodeRow == NULL)
 	      cursor->pVtab->eof = 1;
@@ -7498,6 +10697,47 @@ vroute_close (sqlite3_vtab_cursor * pCursor)
     return SQLITE_OK;
 }
 
+static void
+vroute_refresh (virtualroutingPtr net)
+{
+/*
+/ checking if the Routing Data table has been incrementally updated
+/ (CreateRouting_UpdateLinks) since the network has been loaded;
+/ if so, just the modified Blocks are reloaded
+*/
+    RoutingPtr graph;
+    double departure;
+    sqlite3_int64 generation = network_generation (net->db, net->dataTable);
+    if (generation < 0 || generation == net->graph->Generation)
+	return;
+    if (generation < net->graph->Generation
+	|| !network_patch (net->db, net->dataTable, net->graph, generation))
+      {
+	  /* unable to patch the network: loading it again */
+	  graph = load_network (net->db, net->dataTable, net->sidecarPath);
+	  if (graph == NULL)
+	      return;
+	  network_free (net->graph);
+	  net->graph = graph;
+      }
+
+/* the search buffers reference the Links, so they must be rebuilt */
+    departure = net->routing->Departure;
+    td_search_free (net->routing->Td);
+    routing_free (net->routing);
+    net->routing = routing_init (net->graph);
+    net->routing->Departure = departure;
+    if (net->chSearch != NULL)
+	ch_search_free (net->chSearch);
+    net->chSearch = NULL;
+    if (net->graph->ChNodes != NULL)
+	net->chSearch = ch_search_init (net->graph);
+    else if (net->currentAlgorithm == VROUTE_CH_ALGORITHM)
+	net->currentAlgorithm = VROUTE_DIJKSTRA_ALGORITHM;
+    if (net->graph->TurnOffsets != NULL || net->graph->LinkProfiles != NULL)
+	net->routing->Td = td_search_init (net->graph);
+}
+
 static int
 vroute_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 	       int argc, sqlite3_value ** argv)
@@ -7515,9 +10755,10 @@ vroute_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
     Point2PointSolutionPtr p2p = cursor->pVtab->point2PointSolution;
     if (idxStr)
 	idxStr = idxStr;	/* unused arg warning suppression */
-    node_code = net->graph->NodeCode;
     reset_multiSolution (multiSolution);
     reset_point2PointSolution (p2p);
+    vroute_refresh (net);
+    node_code = net->graph->NodeCode;
     cursor->pVtab->eof = 0;
     if (idxNum == 1 && argc == 2)
       {
@@ -7672,6 +10913,8 @@ vroute_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 	    }
 	  else if (sqlite3_value_type (argv[1]) == SQLITE_FLOAT)
 	      multiSolution->MaxCost = sqlite3_value_double (argv[1]);
+	  if (net->currentRequest == VROUTE_ISOCHRONES)
+	      vroute_set_isochrone_bands (net, multiSolution, argv[1]);
       }
     if (idxNum == 4 && argc == 2)
       {
@@ -7700,6 +10943,8 @@ vroute_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 	    }
 	  else if (sqlite3_value_type (argv[0]) == SQLITE_FLOAT)
 	      multiSolution->MaxCost = sqlite3_value_double (argv[0]);
+	  if (net->currentRequest == VROUTE_ISOCHRONES)
+	      vroute_set_isochrone_bands (net, multiSolution, argv[0]);
       }
     if (idxNum == 5 && argc == 2)
       {
@@ -7856,13 +11101,28 @@ vroute_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 	  cursor->pVtab->eof = 0;
 	  return SQLITE_OK;
       }
+    if ((idxNum == 1 || idxNum == 2) && argc == 2
+	&& net->currentRequest == VROUTE_COST_MATRIX)
+      {
+	  /* Cost Matrix: NodeFrom may contain many Origins */
+	  multiSolution->MultiFrom =
+	      vroute_get_multiple_origins (net, argv[(idxNum == 1) ? 0 : 1]);
+	  if (multiSolution->MultiFrom && multiSolution->MultiTo)
+	    {
+		multiSolution->Mode = VROUTE_MATRIX_SOLUTION;
+		cost_matrix_solve (net->graph, multiSolution);
+		multiSolution->CurrentRowId = 0;
+		vroute_read_row (cursor);
+		return SQLITE_OK;
+	    }
+      }
     if (multiSolution->From && multiSolution->MultiTo)
       {
 	  cursor->pVtab->eof = 0;
 	  if (net->currentRequest == VROUTE_TSP_NN)
 	    {
 		multiSolution->Mode = VROUTE_TSP_SOLUTION;
-		if (net->currentAlgorithm == VROUTE_DIJKSTRA_ALGORITHM)
+		if (net->currentAlgorithm != VROUTE_A_STAR_ALGORITHM)
 		  {
 		      tsp_nn_solve (net->db, net->currentOptions, net->graph,
 				    net->routing, multiSolution);
@@ -7873,7 +11133,7 @@ vroute_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 	  else if (net->currentRequest == VROUTE_TSP_GA)
 	    {
 		multiSolution->Mode = VROUTE_TSP_SOLUTION;
-		if (net->currentAlgorithm == VROUTE_DIJKSTRA_ALGORITHM)
+		if (net->currentAlgorithm != VROUTE_A_STAR_ALGORITHM)
 		  {
 		      tsp_ga_solve (net->db, net->currentOptions, net->graph,
 				    net->routing, multiSolution);
@@ -7897,6 +11157,10 @@ vroute_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 			  astar_solve (net->db, net->currentOptions, net->graph,
 				       net->routing, multiSolution);
 		  }
+		else if (net->currentAlgorithm == VROUTE_CH_ALGORITHM
+			 && multiSolution->MultiTo->Items == 1)
+		    ch_solve (net->db, net->currentOptions, net->graph,
+			      net->chSearch, net->routing, multiSolution);
 		else
 		    dijkstra_multi_solve (net->db, net->currentOptions,
 					  net->graph, net->routing,
@@ -7910,6 +11174,16 @@ vroute_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
       {
 	  find_srid (net->db, net->graph);
 	  cursor->pVtab->eof = 0;
+	  if (multiSolution->NumBands > 0)
+	    {
+		/* Isochrones: one polygon for each band */
+		multiSolution->Mode = VROUTE_ISOCHRONE_SOLUTION;
+		isochrones_solve (net->db, net->graph, net->routing,
+				  multiSolution, net->Tolerance);
+		multiSolution->CurrentRowId = 0;
+		vroute_read_row (cursor);
+		return SQLITE_OK;
+	    }
 	  multiSolution->Mode = VROUTE_RANGE_SOLUTION;
 	  /* always defaulting to Dijkstra's Shortest Path */
 	  dijkstra_within_cost_range (net->routing, multiSolution,
@@ -7952,6 +11226,14 @@ vroute_next (sqlite3_vtab_cursor * pCursor)
 		return SQLITE_OK;
 	    }
       }
+    if (multiSolution->Mode == VROUTE_MATRIX_SOLUTION
+	|| multiSolution->Mode == VROUTE_ISOCHRONE_SOLUTION)
+      {
+	  /* simply advancing into the Cost Matrix or Isochrones bands */
+	  (multiSolution->CurrentRowId)++;
+	  vroute_read_row (cursor);
+	  return SQLITE_OK;
+      }
     if (multiSolution->Mode == VROUTE_RANGE_SOLUTION)
       {
 	  if (multiSolution->CurrentNodeRow == NULL)
@@ -8078,9 +11360,9 @@ do_cost_range_column (virtualroutingCursorPtr cursor,
 	  /* the NodeFrom column */
 	  if (node_code)
 	      sqlite3_result_text (pContext,
-				   cursor->pVtab->multiSolution->From->Code,
-				   strlen (cursor->pVtab->multiSolution->
-					   From->Code), SQLITE_STATIC);
+				   route_node_code (cursor->pVtab->graph,
+						    cursor->pVtab->multiSolution->From),
+				   -1, SQLITE_STATIC);
 	  else
 	      sqlite3_result_int64 (pContext,
 				    cursor->pVtab->multiSolution->From->Id);
@@ -8093,9 +11375,10 @@ do_cost_range_column (virtualroutingCursorPtr cursor,
 	  else
 	    {
 		if (node_code)
-		    sqlite3_result_text (pContext, row_node->Node->Code,
-					 strlen (row_node->Node->Code),
-					 SQLITE_STATIC);
+		    sqlite3_result_text (pContext,
+					 route_node_code (cursor->pVtab->graph,
+							  row_node->Node),
+					 -1, SQLITE_STATIC);
 		else
 		    sqlite3_result_int64 (pContext, row_node->Node->Id);
 	    }
@@ -8153,6 +11436,259 @@ do_cost_range_column (virtualroutingCursorPtr cursor,
       }
 }
 
+static void
+do_isochrone_column (virtualroutingCursorPtr cursor,
+		     sqlite3_context * pContext, int node_code, int column)
+{
+/* processing an Isochrones solution row */
+    const char *algorithm;
+    char delimiter[128];
+    const char *role;
+    MultiSolutionPtr multiSolution = cursor->pVtab->multiSolution;
+    IsochroneBandPtr band = multiSolution->Bands + multiSolution->CurrentRowId;
+    int first = (multiSolution->CurrentRowId == 0);
+
+    if (column == 0)
+      {
+	  /* the currently used Algorithm */
+	  algorithm = "Dijkstra";
+	  if (!first)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_text (pContext, algorithm, strlen (algorithm),
+				   SQLITE_TRANSIENT);
+      }
+    if (column == 1)
+      {
+	  /* the current Request type */
+	  algorithm = "Isochrones";
+	  if (!first)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_text (pContext, algorithm, strlen (algorithm),
+				   SQLITE_TRANSIENT);
+      }
+    if (column == 2)
+      {
+	  /* the currently set Options */
+	  algorithm = "Full";
+	  if (!first)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_text (pContext, algorithm, strlen (algorithm),
+				   SQLITE_TRANSIENT);
+      }
+    if (column == 3)
+      {
+	  /* the currently set delimiter char */
+	  if (isprint (cursor->pVtab->currentDelimiter))
+	      sprintf (delimiter, "%c [dec=%d, hex=%02x]",
+		       cursor->pVtab->currentDelimiter,
+		       cursor->pVtab->currentDelimiter,
+		       cursor->pVtab->currentDelimiter);
+	  else
+	      sprintf (delimiter, "[dec=%d, hex=%02x]",
+		       cursor->pVtab->currentDelimiter,
+		       cursor->pVtab->currentDelimiter);
+	  if (!first)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_text (pContext, delimiter, strlen (delimiter),
+				   SQLITE_TRANSIENT);
+      }
+    if (column == 4)
+      {
+	  /* the RouteNum column: the band position */
+	  sqlite3_result_int (pContext, multiSolution->CurrentRowId);
+      }
+    if (column == 5 || column == 7 || column == 9 || column == 10
+	|| column == 11)
+      {
+	  /* the RouteRow, LinkRowId, NodeTo, PointFrom and PointTo columns */
+	  sqlite3_result_null (pContext);
+      }
+    if (column == 6)
+      {
+	  /* role of this row */
+	  role = "Isochrone";
+	  sqlite3_result_text (pContext, role, strlen (role), SQLITE_TRANSIENT);
+      }
+    if (column == 8)
+      {
+	  /* the NodeFrom column */
+	  if (node_code)
+	      sqlite3_result_text (pContext,
+				   route_node_code (cursor->pVtab->graph,
+						    multiSolution->From), -1,
+				   SQLITE_STATIC);
+	  else
+	      sqlite3_result_int64 (pContext, multiSolution->From->Id);
+      }
+    if (column == 12)
+      {
+	  /* the Tolerance column: the buffer radius */
+	  sqlite3_result_double (pContext, cursor->pVtab->Tolerance);
+      }
+    if (column == 13)
+      {
+	  /* the Cost column: the band threshold */
+	  sqlite3_result_double (pContext, band->Cost);
+      }
+    if (column == 14)
+      {
+	  /* the Geometry column */
+	  if (band->Blob == NULL)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_blob (pContext, band->Blob, band->Size,
+				   SQLITE_STATIC);
+      }
+    if (column == 15)
+      {
+	  /* the [optional] Name column */
+	  sqlite3_result_null (pContext);
+      }
+}
+
+static void
+do_matrix_node_column (sqlite3_context * pContext, int node_code,
+		       RoutingMultiDestPtr multiple, int index)
+{
+/* returning a Cost Matrix Origin or Destination, exactly as requested */
+    if (node_code)
+      {
+	  const char *code = *(multiple->Codes + index);
+	  if (code == NULL)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_text (pContext, code, strlen (code),
+				   SQLITE_STATIC);
+      }
+    else
+	sqlite3_result_int64 (pContext, *(multiple->Ids + index));
+}
+
+static void
+do_cost_matrix_column (virtualroutingCursorPtr cursor,
+		       sqlite3_context * pContext, int node_code, int column)
+{
+/* processing a Cost Matrix solution row */
+    const char *algorithm;
+    char delimiter[128];
+    const char *role;
+    MultiSolutionPtr multiSolution = cursor->pVtab->multiSolution;
+    int n_to = multiSolution->MultiTo->Items;
+    int origin = multiSolution->CurrentRowId / n_to;
+    int destination = multiSolution->CurrentRowId % n_to;
+    int first = (multiSolution->CurrentRowId == 0);
+    double cost;
+
+    if (column == 0)
+      {
+	  /* the currently used Algorithm */
+	  algorithm = "Dijkstra";
+	  if (!first)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_text (pContext, algorithm, strlen (algorithm),
+				   SQLITE_TRANSIENT);
+      }
+    if (column == 1)
+      {
+	  /* the current Request type */
+	  algorithm = "Cost Matrix";
+	  if (!first)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_text (pContext, algorithm, strlen (algorithm),
+				   SQLITE_TRANSIENT);
+      }
+    if (column == 2)
+      {
+	  /* the currently set Options */
+	  algorithm = "Simple";
+	  if (!first)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_text (pContext, algorithm, strlen (algorithm),
+				   SQLITE_TRANSIENT);
+      }
+    if (column == 3)
+      {
+	  /* the currently set delimiter char */
+	  if (isprint (cursor->pVtab->currentDelimiter))
+	      sprintf (delimiter, "%c [dec=%d, hex=%02x]",
+		       cursor->pVtab->currentDelimiter,
+		       cursor->pVtab->currentDelimiter,
+		       cursor->pVtab->currentDelimiter);
+	  else
+	      sprintf (delimiter, "[dec=%d, hex=%02x]",
+		       cursor->pVtab->currentDelimiter,
+		       cursor->pVtab->currentDelimiter);
+	  if (!first)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_text (pContext, delimiter, strlen (delimiter),
+				   SQLITE_TRANSIENT);
+      }
+    if (column == 4)
+      {
+	  /* the RouteNum column: the Origin position */
+	  sqlite3_result_int (pContext, origin);
+      }
+    if (column == 5)
+      {
+	  /* the RouteRow column: the Destination position */
+	  sqlite3_result_int (pContext, destination);
+      }
+    if (column == 6)
+      {
+	  /* role of this row */
+	  cost = *(multiSolution->Matrix + multiSolution->CurrentRowId);
+	  if (cost < 0.0)
+	      role = "Unreachable";
+	  else
+	      role = "Cost";
+	  sqlite3_result_text (pContext, role, strlen (role), SQLITE_TRANSIENT);
+      }
+    if (column == 7)
+      {
+	  /* the LinkRowId column */
+	  sqlite3_result_null (pContext);
+      }
+    if (column == 8)
+      {
+	  /* the NodeFrom column */
+	  do_matrix_node_column (pContext, node_code,
+				 multiSolution->MultiFrom, origin);
+      }
+    if (column == 9)
+      {
+	  /* the NodeTo column */
+	  do_matrix_node_column (pContext, node_code,
+				 multiSolution->MultiTo, destination);
+      }
+    if (column == 10 || column == 11 || column == 12)
+      {
+	  /* the PointFrom, PointTo and Tolerance columns */
+	  sqlite3_result_null (pContext);
+      }
+    if (column == 13)
+      {
+	  /* the Cost column */
+	  cost = *(multiSolution->Matrix + multiSolution->CurrentRowId);
+	  if (cost < 0.0)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_double (pContext, cost);
+      }
+    if (column == 14 || column == 15)
+      {
+	  /* the Geometry and [optional] Name columns */
+	  sqlite3_result_null (pContext);
+      }
+}
+
 static void
 do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		  sqlite3_context * pContext, int node_code,
@@ -8173,6 +11709,8 @@ do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		/* the currently used Algorithm */
 		if (net->currentAlgorithm == VROUTE_A_STAR_ALGORITHM)
 		    algorithm = "A*";
+		else if (net->currentAlgorithm == VROUTE_CH_ALGORITHM)
+		    algorithm = "CH";
 		else
 		    algorithm = "Dijkstra";
 		if (row != first)
@@ -8188,6 +11726,10 @@ do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		    algorithm = "TSP NN";
 		else if (net->currentRequest == VROUTE_TSP_GA)
 		    algorithm = "TSP GA";
+		else if (net->currentRequest == VROUTE_COST_MATRIX)
+		    algorithm = "Cost Matrix";
+		else if (net->currentRequest == VROUTE_ISOCHRONES)
+		    algorithm = "Isochrones";
 		else
 		    algorithm = "Shortest Path";
 		if (row != first)
@@ -8250,6 +11792,8 @@ do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		  {
 		      if (net->currentAlgorithm == VROUTE_A_STAR_ALGORITHM)
 			  algorithm = "A*";
+		      else if (net->currentAlgorithm == VROUTE_CH_ALGORITHM)
+			  algorithm = "CH";
 		      else
 			  algorithm = "Dijkstra";
 		  }
@@ -8266,6 +11810,10 @@ do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		    algorithm = "TSP NN";
 		else if (net->currentRequest == VROUTE_TSP_GA)
 		    algorithm = "TSP GA";
+		else if (net->currentRequest == VROUTE_COST_MATRIX)
+		    algorithm = "Cost Matrix";
+		else if (net->currentRequest == VROUTE_ISOCHRONES)
+		    algorithm = "Isochrones";
 		else
 		    algorithm = "Shortest Path";
 		if (row != first)
@@ -8349,9 +11897,10 @@ do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		else
 		  {
 		      if (node_code)
-			  sqlite3_result_text (pContext, row->From->Code,
-					       strlen (row->From->Code),
-					       SQLITE_STATIC);
+			  sqlite3_result_text (pContext,
+					       route_node_code (net->graph,
+								row->From),
+					       -1, SQLITE_STATIC);
 		      else
 			  sqlite3_result_int64 (pContext, row->From->Id);
 		  }
@@ -8413,6 +11962,8 @@ do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		  {
 		      if (net->currentAlgorithm == VROUTE_A_STAR_ALGORITHM)
 			  algorithm = "A*";
+		      else if (net->currentAlgorithm == VROUTE_CH_ALGORITHM)
+			  algorithm = "CH";
 		      else
 			  algorithm = "Dijkstra";
 		  }
@@ -8429,6 +11980,10 @@ do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		    algorithm = "TSP NN";
 		else if (net->currentRequest == VROUTE_TSP_GA)
 		    algorithm = "TSP GA";
+		else if (net->currentRequest == VROUTE_COST_MATRIX)
+		    algorithm = "Cost Matrix";
+		else if (net->currentRequest == VROUTE_ISOCHRONES)
+		    algorithm = "Isochrones";
 		else
 		    algorithm = "Shortest Path";
 		if (row != first)
@@ -8514,9 +12069,10 @@ do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 	    {
 		/* the NodeFrom column */
 		if (node_code)
-		    sqlite3_result_text (pContext, row->From->Code,
-					 strlen (row->From->Code),
-					 SQLITE_STATIC);
+		    sqlite3_result_text (pContext,
+					 route_node_code (net->graph,
+							  row->From),
+					 -1, SQLITE_STATIC);
 		else
 		    sqlite3_result_int64 (pContext, row->From->Id);
 	    }
@@ -8524,8 +12080,10 @@ do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 	    {
 		/* the NodeTo column */
 		if (node_code)
-		    sqlite3_result_text (pContext, row->To->Code,
-					 strlen (row->To->Code), SQLITE_STATIC);
+		    sqlite3_result_text (pContext,
+					 route_node_code (net->graph,
+							  row->To),
+					 -1, SQLITE_STATIC);
 		else
 		    sqlite3_result_int64 (pContext, row->To->Id);
 	    }
@@ -8622,25 +12180,28 @@ do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		/* the NodeFrom column */
 		if (node_code)
 		    sqlite3_result_text (pContext,
-					 row->linkRef->Link->NodeFrom->Code,
-					 strlen (row->linkRef->Link->
-						 NodeFrom->Code),
-					 SQLITE_STATIC);
+					 route_node_code (net->graph,
+							  route_link_from (net->graph,
+									   row->linkRef->Link)),
+					 -1, SQLITE_STATIC);
 		else
 		    sqlite3_result_int64 (pContext,
-					  row->linkRef->Link->NodeFrom->Id);
+					  route_link_from (net->graph,
+							   row->linkRef->Link)->Id);
 	    }
 	  if (column == 9)
 	    {
 		/* the NodeTo column */
 		if (node_code)
 		    sqlite3_result_text (pContext,
-					 row->linkRef->Link->NodeTo->Code,
-					 strlen (row->linkRef->Link->
-						 NodeTo->Code), SQLITE_STATIC);
+					 route_node_code (net->graph,
+							  route_link_to (net->graph,
+									 row->linkRef->Link)),
+					 -1, SQLITE_STATIC);
 		else
 		    sqlite3_result_int64 (pContext,
-					  row->linkRef->Link->NodeTo->Id);
+					  route_link_to (net->graph,
+							 row->linkRef->Link)->Id);
 	    }
 	  if (column == 10)
 	    {
@@ -8660,7 +12221,7 @@ do_common_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 	  if (column == 13)
 	    {
 		/* the Cost column */
-		sqlite3_result_double (pContext, row->linkRef->Link->Cost);
+		sqlite3_result_double (pContext, row->linkRef->Cost);
 	    }
 	  if (column == 14)
 	    {
@@ -8810,15 +12371,14 @@ do_point2point_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		  {
 		      if (node_code)
 			  sqlite3_result_text (pContext,
-					       row->linkRef->Link->
-					       NodeFrom->Code,
-					       strlen (row->linkRef->
-						       Link->NodeFrom->Code),
-					       SQLITE_STATIC);
+					       route_node_code (net->graph,
+								route_link_from (net->graph,
+										 row->linkRef->Link)),
+					       -1, SQLITE_STATIC);
 		      else
 			  sqlite3_result_int64 (pContext,
-						row->linkRef->Link->
-						NodeFrom->Id);
+						route_link_from (net->graph,
+								 row->linkRef->Link)->Id);
 		  }
 		else
 		    sqlite3_result_null (pContext);
@@ -8830,13 +12390,14 @@ do_point2point_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		  {
 		      if (node_code)
 			  sqlite3_result_text (pContext,
-					       row->linkRef->Link->NodeTo->Code,
-					       strlen (row->linkRef->
-						       Link->NodeTo->Code),
-					       SQLITE_STATIC);
+					       route_node_code (net->graph,
+								route_link_to (net->graph,
+									       row->linkRef->Link)),
+					       -1, SQLITE_STATIC);
 		      else
 			  sqlite3_result_int64 (pContext,
-						row->linkRef->Link->NodeTo->Id);
+						route_link_to (net->graph,
+							       row->linkRef->Link)->Id);
 		  }
 		else
 		    sqlite3_result_null (pContext);
@@ -8971,30 +12532,33 @@ do_point2point_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
 		/* the NodeFrom column */
 		if (node_code)
 		    sqlite3_result_text (pContext,
-					 row->linkRef->Link->NodeFrom->Code,
-					 strlen (row->linkRef->Link->
-						 NodeFrom->Code),
-					 SQLITE_STATIC);
+					 route_node_code (net->graph,
+							  route_link_from (net->graph,
+									   row->linkRef->Link)),
+					 -1, SQLITE_STATIC);
 		else
 		    sqlite3_result_int64 (pContext,
-					  row->linkRef->Link->NodeFrom->Id);
+					  route_link_from (net->graph,
+							   row->linkRef->Link)->Id);
 	    }
 	  if (column == 9)
 	    {
 		/* the NodeTo column */
 		if (node_code)
 		    sqlite3_result_text (pContext,
-					 row->linkRef->Link->NodeTo->Code,
-					 strlen (row->linkRef->Link->
-						 NodeTo->Code), SQLITE_STATIC);
+					 route_node_code (net->graph,
+							  route_link_to (net->graph,
+									 row->linkRef->Link)),
+					 -1, SQLITE_STATIC);
 		else
 		    sqlite3_result_int64 (pContext,
-					  row->linkRef->Link->NodeTo->Id);
+					  route_link_to (net->graph,
+							 row->linkRef->Link)->Id);
 	    }
 	  if (column == 13)
 	    {
 		/* the Cost column */
-		sqlite3_result_double (pContext, row->linkRef->Link->Cost);
+		sqlite3_result_double (pContext, row->linkRef->Cost);
 	    }
 	  if (column == 14)
 	    {
@@ -9014,6 +12578,53 @@ do_point2point_column (virtualroutingCursorPtr cursor, virtualroutingPtr net,
       }
 }
 
+static int
+vroute_departure_column (virtualroutingPtr net)
+{
+/* the DepartureTime column always is the last one */
+    if (net->graph->NameColumn != NULL)
+	return 16;
+    return 15;
+}
+
+static double
+vroute_parse_departure (sqlite3_value * value, double current)
+{
+/* 
+/ parsing a DepartureTime value:
+/ - NULL: no Departure Time (static Costs)
+/ - a number: seconds since midnight
+/ - a text string: 'HH:MM' or 'HH:MM:SS'
+/ any invalid value will leave the current Departure Time unchanged
+*/
+    double t;
+    int hh;
+    int mm;
+    int ss = 0;
+    int n;
+    const char *str;
+    switch (sqlite3_value_type (value))
+      {
+      case SQLITE_NULL:
+	  return -1.0;
+      case SQLITE_INTEGER:
+      case SQLITE_FLOAT:
+	  t = sqlite3_value_double (value);
+	  if (t < 0.0)
+	      return current;
+	  return fmod (t, 86400.0);
+      case SQLITE_TEXT:
+	  str = (const char *) sqlite3_value_text (value);
+	  n = sscanf (str, "%d:%d:%d", &hh, &mm, &ss);
+	  if (n < 2)
+	      return current;
+	  if (hh < 0 || hh > 23 || mm < 0 || mm > 59 || ss < 0 || ss > 59)
+	      return current;
+	  return (hh * 3600.0) + (mm * 60.0) + ss;
+      }
+    return current;
+}
+
 static int
 vroute_column (sqlite3_vtab_cursor * pCursor, sqlite3_context * pContext,
 	       int column)
@@ -9025,6 +12636,28 @@ vroute_column (sqlite3_vtab_cursor * pCursor, sqlite3_context * pContext,
     virtualroutingCursorPtr cursor = (virtualroutingCursorPtr) pCursor;
     virtualroutingPtr net = (virtualroutingPtr) cursor->pVtab;
     node_code = net->graph->NodeCode;
+    if (column == vroute_departure_column (net))
+      {
+	  /* the current Departure Time */
+	  if (net->routing->Departure < 0.0)
+	      sqlite3_result_null (pContext);
+	  else
+	      sqlite3_result_double (pContext, net->routing->Departure);
+	  return SQLITE_OK;
+      }
+    if (cursor->pVtab->multiSolution->Mode == VROUTE_MATRIX_SOLUTION
+	&& cursor->pVtab->multiSolution->Matrix != NULL)
+      {
+	  /* processing a Cost Matrix solution */
+	  do_cost_matrix_column (cursor, pContext, node_code, column);
+	  return SQLITE_OK;
+      }
+    if (cursor->pVtab->multiSolution->Mode == VROUTE_ISOCHRONE_SOLUTION)
+      {
+	  /* processing an Isochrones solution */
+	  do_isochrone_column (cursor, pContext, node_code, column);
+	  return SQLITE_OK;
+      }
     if (cursor->pVtab->multiSolution->Mode == VROUTE_RANGE_SOLUTION)
       {
 	  /* processing "within Cost range" solution */
@@ -9088,7 +12721,7 @@ vroute_update (sqlite3_vtab * pVTab, int argc, sqlite3_value ** argv,
 	  else
 	    {
 		/* performing an UPDATE */
-		if (argc == 18)
+		if (argc == 18 || argc == 19)
 		  {
 		      p_vtab->currentAlgorithm = VROUTE_DIJKSTRA_ALGORITHM;
 		      p_vtab->currentDelimiter = ',';
@@ -9099,8 +12732,15 @@ vroute_update (sqlite3_vtab * pVTab, int argc, sqlite3_value ** argv,
 			    if (strcasecmp ((char *) algorithm, "A*") == 0)
 				p_vtab->currentAlgorithm =
 				    VROUTE_A_STAR_ALGORITHM;
+			    if (strcasecmp ((char *) algorithm, "CH") == 0)
+				p_vtab->currentAlgorithm = VROUTE_CH_ALGORITHM;
 			}
-		      if (p_vtab->graph->AStar == 0)
+		      if (p_vtab->graph->AStar == 0
+			  && p_vtab->currentAlgorithm ==
+			  VROUTE_A_STAR_ALGORITHM)
+			  p_vtab->currentAlgorithm = VROUTE_DIJKSTRA_ALGORITHM;
+		      if (p_vtab->chSearch == NULL
+			  && p_vtab->currentAlgorithm == VROUTE_CH_ALGORITHM)
 			  p_vtab->currentAlgorithm = VROUTE_DIJKSTRA_ALGORITHM;
 		      if (sqlite3_value_type (argv[3]) == SQLITE_TEXT)
 			{
@@ -9117,6 +12757,12 @@ vroute_update (sqlite3_vtab * pVTab, int argc, sqlite3_value ** argv,
 			    else if (strcasecmp
 				     ((char *) request, "SHORTEST PATH") == 0)
 				p_vtab->currentRequest = VROUTE_SHORTEST_PATH;
+			    else if (strcasecmp
+				     ((char *) request, "COST MATRIX") == 0)
+				p_vtab->currentRequest = VROUTE_COST_MATRIX;
+			    else if (strcasecmp
+				     ((char *) request, "ISOCHRONES") == 0)
+				p_vtab->currentRequest = VROUTE_ISOCHRONES;
 			}
 		      if (sqlite3_value_type (argv[4]) == SQLITE_TEXT)
 			{
@@ -9145,6 +12791,12 @@ vroute_update (sqlite3_vtab * pVTab, int argc, sqlite3_value ** argv,
 			}
 		      if (sqlite3_value_type (argv[14]) == SQLITE_FLOAT)
 			  p_vtab->Tolerance = sqlite3_value_double (argv[14]);
+		      p_vtab->routing->Departure =
+			  vroute_parse_departure (argv
+						  [2 +
+						   vroute_departure_column
+						   (p_vtab)],
+						  p_vtab->routing->Departure);
 		  }
 		return SQLITE_OK;
 	    }
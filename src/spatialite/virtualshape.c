@@ -43,10 +43,47 @@ the terms of any one of the MPL, the GPL or the LGPL.
  
 */
 
+/*
+ 
+IMPORTANT NOTE: memory mapped Shapefiles
+
+on any platform but Windows the SHP, SHX and DBF files are read-only
+memory mapped, so that all entities can be directly accessed without
+copying them through stdio buffers; the plain stdio based reader is
+used instead whenever mapping is not possible.
+
+a mapping is refused if the file lengths declared by the SHP, SHX and
+DBF headers exceed the actual file sizes (a truncated Shapefile), and
+each new scan checks again all file sizes, releasing the mapping if any
+file has shrunk since the previous scan.
+
+anyway a Shapefile must never be truncated or rewritten in place by
+some other process while a VirtualShape scan is running: any access to
+a page beyond the new end of a mapped file raises a SIGBUS, terminating
+the whole process.
+such Shapefiles should rather be replaced by a rename(), which leaves
+the files already mapped untouched.
+
+IMPORTANT NOTE: spatial filtering
+
+two equivalent forms of spatial filter are directly supported, both of
+them only reading the records whose bounding box intersects the given
+Geometry (a grid index is built on the fly on the first filtered query):
+
+- the hidden SEARCH_FRAME column, as in VirtualSpatialIndex:
+  SELECT ... FROM shp WHERE search_frame = BuildMbr(...)
+- MbrIntersects(Geometry, ...) used as a WHERE term by itself:
+  SELECT ... FROM shp WHERE MbrIntersects(Geometry, BuildMbr(...))
+  (the Geometry column must be the first argument; NULL Geometries
+  are returned as well, since MbrIntersects() then returns -1)
+
+*/
+
 #include <sys/types.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <float.h>
 
 #if defined(_WIN32) && !defined(__MINGW32__)
@@ -69,8 +106,36 @@ the terms of any one of the MPL, the GPL or the LGPL.
 
 #ifndef OMIT_ICONV		/* if ICONV is disabled no SHP support is available */
 
+#define VSHP_GRID_MAX_SIDE	1024	/* max grid size: 1024 x 1024 cells */
+#define VSHP_GRID_MAX_SPAN	16	/* max cells covered by a single record */
+
+#ifdef SQLITE_INDEX_CONSTRAINT_FUNCTION
+#define VSHP_MBR_INTERSECTS	SQLITE_INDEX_CONSTRAINT_FUNCTION
+#else
+#define VSHP_MBR_INTERSECTS	150	/* overloaded MbrIntersects() */
+#endif
+
 static struct sqlite3_module my_shape_module;
 
+typedef struct VirtualShapeGridStruct
+{
+/* an on-the-fly grid index over the SHP record bounding boxes */
+    int cols;			/* # grid columns */
+    int rows;			/* # grid rows */
+    double origin_x;		/* the grid origin (Shapefile Full Extent) */
+    double origin_y;
+    double cell_width;
+    double cell_height;
+    int *cell_start;		/* cols * rows + 1 offsets into items */
+    int *items;			/* SHP row numbers, grouped by cell */
+    int n_large;		/* records spanning too many cells */
+    int *large;
+    double *large_mbr;		/* MinX, MinY, MaxX, MaxY for each large record */
+    int n_empty;		/* records without any bounding box (NULL Shapes) */
+    int *empty;
+} VirtualShapeGrid;
+typedef VirtualShapeGrid *VirtualShapeGridPtr;
+
 typedef struct VirtualShapeStruct
 {
 /* extends the sqlite3_vtab struct */
@@ -86,6 +151,9 @@ typedef struct VirtualShapeStruct
     double MinY;
     double MaxX;
     double MaxY;
+    struct splite_shp_mapping Mapping;	/* memory mapped Shapefile */
+    int FrameColumn;		/* the hidden "search_frame" column */
+    VirtualShapeGridPtr Grid;	/* the spatial index (built on demand) */
 } VirtualShape;
 typedef VirtualShape *VirtualShapePtr;
 
@@ -98,6 +166,10 @@ typedef struct VirtualShapeConstraintStruct
     sqlite3_int64 intValue;	/* Int64 comparison value */
     double dblValue;		/* Double comparison value */
     char *txtValue;		/* Text comparison value */
+    double minx;		/* search frame ('F') */
+    double miny;
+    double maxx;
+    double maxy;
     struct VirtualShapeConstraintStruct *next;
 } VirtualShapeConstraint;
 typedef VirtualShapeConstraint *VirtualShapeConstraintPtr;
@@ -111,6 +183,9 @@ typedef struct VirtualShapeCursorStruct
     int blobSize;
     unsigned char *blobGeometry;
     int eof;			/* the EOF marker */
+    int *candidates;		/* rows selected by the spatial index */
+    int n_candidates;
+    int next_candidate;
     VirtualShapeConstraintPtr firstConstraint;
     VirtualShapeConstraintPtr lastConstraint;
 } VirtualShapeCursor;
@@ -306,8 +381,12 @@ vshp_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
     p_vt->MaxX = -DBL_MAX;
     p_vt->MaxY = -DBL_MAX;
     p_vt->text_dates = text_dates;
+    p_vt->FrameColumn = -1;
+    p_vt->Grid = NULL;
 /* trying to open files etc in order to ensure we actually have a genuine shapefile */
     gaiaOpenShpRead (p_vt->Shp, path, encoding, "UTF-8");
+/* attempting to memory map the Shapefile; failing this the plain reader will be used */
+    splite_map_shapefile (p_vt->Shp, &(p_vt->Mapping));
     if (!(p_vt->Shp->Valid))
       {
 	  /* something is going the wrong way; creating a stupid default table */
@@ -381,9 +460,11 @@ vshp_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 		if (strcasecmp (xname, *(col_name + idup)) == 0)
 		    dup = 1;
 	    }
-	  if (strcasecmp (xname, "\"PKUID\"") == 0)
+	  if (strcasecmp (xname, "PKUID") == 0)
+	      dup = 1;
+	  if (strcasecmp (xname, "Geometry") == 0)
 	      dup = 1;
-	  if (strcasecmp (xname, "\"Geometry\"") == 0)
+	  if (strcasecmp (xname, "search_frame") == 0)
 	      dup = 1;
 	  if (dup)
 	    {
@@ -421,7 +502,12 @@ vshp_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
 	  cnt++;
 	  pFld = pFld->Next;
       }
-    gaiaAppendToOutBuffer (&sql_statement, ")");
+/* the hidden column supporting spatial filtering */
+    if (colname_case == GAIA_DBF_COLNAME_UPPERCASE)
+	gaiaAppendToOutBuffer (&sql_statement, ", SEARCH_FRAME HIDDEN BLOB)");
+    else
+	gaiaAppendToOutBuffer (&sql_statement, ", search_frame HIDDEN BLOB)");
+    p_vt->FrameColumn = 2 + col_cnt;
     if (col_name)
       {
 	  /* releasing memory allocation for column names */
@@ -674,20 +760,37 @@ vshp_best_index (sqlite3_vtab * pVTab, sqlite3_index_info * pIndex)
 /* best index selection */
     int i;
     int iArg = 0;
+    int frame = 0;
     char str[2048];
     char buf[64];
-
-    if (pVTab)
-	pVTab = pVTab;		/* unused arg warning suppression */
+    VirtualShapePtr p_vt = (VirtualShapePtr) pVTab;
 
     *str = '\0';
     for (i = 0; i < pIndex->nConstraint; i++)
       {
 	  if (pIndex->aConstraint[i].usable)
 	    {
+		if (pIndex->aConstraint[i].iColumn == p_vt->FrameColumn)
+		  {
+		      /* only "search_frame = <geometry>" is supported */
+		      if (pIndex->aConstraint[i].op !=
+			  SQLITE_INDEX_CONSTRAINT_EQ)
+			  continue;
+		      frame = 1;
+		  }
 		iArg++;
 		pIndex->aConstraintUsage[i].argvIndex = iArg;
 		pIndex->aConstraintUsage[i].omit = 1;
+		if (pIndex->aConstraint[i].iColumn == 1
+		    && pIndex->aConstraint[i].op == VSHP_MBR_INTERSECTS)
+		  {
+		      /* 
+		      / MbrIntersects(Geometry, <geometry>): the candidates are
+		      / only pre-filtered, the function itself is still evaluated
+		      */
+		      pIndex->aConstraintUsage[i].omit = 0;
+		      frame = 1;
+		  }
 		sprintf (buf, "%d:%d,", pIndex->aConstraint[i].iColumn,
 			 pIndex->aConstraint[i].op);
 		strcat (str, buf);
@@ -698,10 +801,345 @@ vshp_best_index (sqlite3_vtab * pVTab, sqlite3_index_info * pIndex)
 	  pIndex->idxStr = sqlite3_mprintf ("%s", str);
 	  pIndex->needToFreeIdxStr = 1;
       }
+    if (frame)
+      {
+	  /* spatial filter: only the candidates selected by the grid index */
+	  pIndex->estimatedCost = 1.0;
+      }
 
     return SQLITE_OK;
 }
 
+static void
+vshp_free_grid (VirtualShapeGridPtr grid)
+{
+/* memory cleanup - grid index */
+    if (grid == NULL)
+	return;
+    if (grid->cell_start)
+	free (grid->cell_start);
+    if (grid->items)
+	free (grid->items);
+    if (grid->large)
+	free (grid->large);
+    if (grid->large_mbr)
+	free (grid->large_mbr);
+    if (grid->empty)
+	free (grid->empty);
+    free (grid);
+}
+
+static int
+vshp_grid_cell (double value, double origin, double size, int count)
+{
+/* computing a grid column/row; outliers are clamped to the grid bounds */
+    double cell;
+    if (!(size > 0.0))
+	return 0;
+    cell = (value - origin) / size;
+    if (!(cell >= 0.0))
+	return 0;		/* negative or NaN */
+    if (cell >= (double) count)
+	return count - 1;
+    return (int) cell;
+}
+
+static int
+vshp_record_mbr (VirtualShapePtr p_vt, int row, double *minx, double *miny,
+		 double *maxx, double *maxy)
+{
+/* 
+/ fetching the bounding box of some SHP record from the memory mapped file
+/ returns 0 for NULL Shapes or invalid records
+*/
+    struct splite_shp_mapping *map = &(p_vt->Mapping);
+    int endian_arch = p_vt->Shp->endian_arch;
+    size_t offset = 100 + ((size_t) row * 8);
+    const unsigned char *rec;
+    int shape;
+    offset =
+	(size_t) gaiaImport32 (map->shx + offset, GAIA_BIG_ENDIAN,
+			       endian_arch) * 2;
+    if (offset + 12 > map->shp_size)
+	return 0;
+    rec = map->shp + offset + 8;
+    shape = gaiaImport32 (rec, GAIA_LITTLE_ENDIAN, endian_arch);
+    if (shape == GAIA_SHP_POINT || shape == GAIA_SHP_POINTZ
+	|| shape == GAIA_SHP_POINTM)
+      {
+	  if (offset + 28 > map->shp_size)
+	      return 0;
+	  *minx = gaiaImport64 (rec + 4, GAIA_LITTLE_ENDIAN, endian_arch);
+	  *miny = gaiaImport64 (rec + 12, GAIA_LITTLE_ENDIAN, endian_arch);
+	  *maxx = *minx;
+	  *maxy = *miny;
+	  return 1;
+      }
+    if (shape == GAIA_SHP_NULL || offset + 44 > map->shp_size)
+	return 0;
+    *minx = gaiaImport64 (rec + 4, GAIA_LITTLE_ENDIAN, endian_arch);
+    *miny = gaiaImport64 (rec + 12, GAIA_LITTLE_ENDIAN, endian_arch);
+    *maxx = gaiaImport64 (rec + 20, GAIA_LITTLE_ENDIAN, endian_arch);
+    *maxy = gaiaImport64 (rec + 28, GAIA_LITTLE_ENDIAN, endian_arch);
+    return 1;
+}
+
+static int
+vshp_grid_span (VirtualShapeGridPtr grid, double minx, double miny,
+		double maxx, double maxy, int *x0, int *y0, int *x1, int *y1)
+{
+/* determining the grid cells covered by some bounding box */
+    *x0 = vshp_grid_cell (minx, grid->origin_x, grid->cell_width, grid->cols);
+    *y0 =
+	vshp_grid_cell (miny, grid->origin_y, grid->cell_height, grid->rows);
+    *x1 = vshp_grid_cell (maxx, grid->origin_x, grid->cell_width, grid->cols);
+    *y1 =
+	vshp_grid_cell (maxy, grid->origin_y, grid->cell_height, grid->rows);
+    if (*x1 < *x0)
+	*x1 = *x0;
+    if (*y1 < *y0)
+	*y1 = *y0;
+    return (*x1 - *x0 + 1) * (*y1 - *y0 + 1);
+}
+
+static VirtualShapeGridPtr
+vshp_build_grid (VirtualShapePtr p_vt)
+{
+/* 
+/ building a grid index over the SHP record bounding boxes
+/ (a single sequential pass over the memory mapped SHP, repeated
+/ twice so to avoid storing the bounding boxes)
+/ returns NULL if the Shapefile isn't memory mapped
+*/
+    VirtualShapeGridPtr grid;
+    int n_recs;
+    int n_cells;
+    int side;
+    int row;
+    int pass;
+    int x;
+    int y;
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    int *fill = NULL;
+    sqlite3_int64 n_items;
+    double minx;
+    double miny;
+    double maxx;
+    double maxy;
+    if (p_vt->Mapping.shp == NULL || p_vt->Mapping.shx == NULL
+	|| p_vt->Mapping.shx_size < 100)
+	return NULL;
+    n_recs = (int) ((p_vt->Mapping.shx_size - 100) / 8);
+    grid = malloc (sizeof (VirtualShapeGrid));
+    if (grid == NULL)
+	return NULL;
+/* roughly 4 records per cell */
+    side = (int) sqrt ((double) n_recs / 4.0);
+    if (side < 1)
+	side = 1;
+    if (side > VSHP_GRID_MAX_SIDE)
+	side = VSHP_GRID_MAX_SIDE;
+    grid->cols = side;
+    grid->rows = side;
+    grid->origin_x = p_vt->MinX;
+    grid->origin_y = p_vt->MinY;
+    grid->cell_width = (p_vt->MaxX - p_vt->MinX) / (double) side;
+    grid->cell_height = (p_vt->MaxY - p_vt->MinY) / (double) side;
+    grid->items = NULL;
+    grid->n_large = 0;
+    grid->large = NULL;
+    grid->large_mbr = NULL;
+    grid->n_empty = 0;
+    grid->empty = NULL;
+    n_cells = grid->cols * grid->rows;
+    grid->cell_start = calloc (n_cells + 1, sizeof (int));
+    if (grid->cell_start == NULL)
+	goto error;
+
+    for (pass = 0; pass < 2; pass++)
+      {
+	  /* 1st pass: counting items; 2nd pass: filling the cells */
+	  if (pass == 1)
+	    {
+		n_items = 0;
+		for (x = 0; x < n_cells; x++)
+		  {
+		      int count = grid->cell_start[x];
+		      grid->cell_start[x] = (int) n_items;
+		      n_items += count;
+		      if (n_items > 0x7fffffff)
+			  goto error;
+		  }
+		grid->cell_start[n_cells] = (int) n_items;
+		grid->items = malloc (sizeof (int) * (n_items + 1));
+		if (grid->n_large > 0)
+		  {
+		      grid->large = malloc (sizeof (int) * grid->n_large);
+		      grid->large_mbr =
+			  malloc (sizeof (double) * 4 * grid->n_large);
+		      if (grid->large == NULL || grid->large_mbr == NULL)
+			  goto error;
+		  }
+		if (grid->n_empty > 0)
+		  {
+		      grid->empty = malloc (sizeof (int) * grid->n_empty);
+		      if (grid->empty == NULL)
+			  goto error;
+		  }
+		fill = malloc (sizeof (int) * n_cells);
+		if (grid->items == NULL || fill == NULL)
+		    goto error;
+		memcpy (fill, grid->cell_start, sizeof (int) * n_cells);
+		grid->n_large = 0;
+		grid->n_empty = 0;
+	    }
+	  for (row = 0; row < n_recs; row++)
+	    {
+		if (!vshp_record_mbr (p_vt, row, &minx, &miny, &maxx, &maxy))
+		  {
+		      /* no bounding box: only selected by MbrIntersects() */
+		      if (pass == 1)
+			  grid->empty[grid->n_empty] = row;
+		      grid->n_empty += 1;
+		      continue;
+		  }
+		if (vshp_grid_span
+		    (grid, minx, miny, maxx, maxy, &x0, &y0, &x1,
+		     &y1) > VSHP_GRID_MAX_SPAN)
+		  {
+		      /* too big: kept apart, together with its bounding box */
+		      if (pass == 1)
+			{
+			    double *mbr = grid->large_mbr + (grid->n_large * 4);
+			    grid->large[grid->n_large] = row;
+			    mbr[0] = minx;
+			    mbr[1] = miny;
+			    mbr[2] = maxx;
+			    mbr[3] = maxy;
+			}
+		      grid->n_large += 1;
+		      continue;
+		  }
+		for (y = y0; y <= y1; y++)
+		  {
+		      for (x = x0; x <= x1; x++)
+			{
+			    int cell = (y * grid->cols) + x;
+			    if (pass == 0)
+				grid->cell_start[cell] += 1;
+			    else
+				grid->items[fill[cell]++] = row;
+			}
+		  }
+	    }
+      }
+    free (fill);
+    return grid;
+
+  error:
+    if (fill)
+	free (fill);
+    vshp_free_grid (grid);
+    return NULL;
+}
+
+static int
+cmp_vshp_rows (const void *p1, const void *p2)
+{
+/* comparison function for QSORT */
+    int r1 = *((int *) p1);
+    int r2 = *((int *) p2);
+    if (r1 < r2)
+	return -1;
+    if (r1 > r2)
+	return 1;
+    return 0;
+}
+
+static void
+vshp_grid_candidates (VirtualShapeCursorPtr cursor, double minx, double miny,
+		      double maxx, double maxy, int with_empty)
+{
+/* 
+/ collecting (sorted and unique) candidate rows from the grid index
+/ candidates are left to NULL when a plain full scan is expected to be
+/ cheaper, i.e. when the search frame covers most of the grid
+/ records without a bounding box are only included if with_empty is set
+*/
+    VirtualShapeGridPtr grid = cursor->pVtab->Grid;
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    int x;
+    int y;
+    int i;
+    int count;
+    int *rows;
+    if (cursor->candidates)
+	free (cursor->candidates);
+    cursor->candidates = NULL;
+    cursor->n_candidates = 0;
+    cursor->next_candidate = 0;
+    if (grid == NULL)
+	return;
+    if (vshp_grid_span (grid, minx, miny, maxx, maxy, &x0, &y0, &x1, &y1) >
+	(grid->cols * grid->rows) / 2)
+	return;
+    count = grid->n_large;
+    if (with_empty)
+	count += grid->n_empty;
+    for (y = y0; y <= y1; y++)
+      {
+	  int cell = (y * grid->cols);
+	  count +=
+	      grid->cell_start[cell + x1 + 1] - grid->cell_start[cell + x0];
+      }
+    rows = malloc (sizeof (int) * (count + 1));
+    if (rows == NULL)
+	return;
+    count = 0;
+    for (i = 0; i < grid->n_large; i++)
+      {
+	  double *mbr = grid->large_mbr + (i * 4);
+	  if (mbr[0] <= maxx && mbr[2] >= minx && mbr[1] <= maxy
+	      && mbr[3] >= miny)
+	      rows[count++] = grid->large[i];
+      }
+    if (with_empty)
+      {
+	  for (i = 0; i < grid->n_empty; i++)
+	      rows[count++] = grid->empty[i];
+      }
+    for (y = y0; y <= y1; y++)
+      {
+	  for (x = x0; x <= x1; x++)
+	    {
+		int cell = (y * grid->cols) + x;
+		for (i = grid->cell_start[cell]; i < grid->cell_start[cell + 1];
+		     i++)
+		    rows[count++] = grid->items[i];
+	    }
+      }
+/* sorting and removing duplicates */
+    qsort (rows, count, sizeof (int), cmp_vshp_rows);
+    if (count > 0)
+      {
+	  int last = 0;
+	  for (i = 1; i < count; i++)
+	    {
+		if (rows[i] != rows[last])
+		    rows[++last] = rows[i];
+	    }
+	  count = last + 1;
+      }
+    cursor->candidates = rows;
+    cursor->n_candidates = count;
+}
+
 static int
 vshp_disconnect (sqlite3_vtab * pVTab)
 {
@@ -710,6 +1148,8 @@ vshp_disconnect (sqlite3_vtab * pVTab)
     sqlite3_stmt *stmt;
     const char *sql;
     VirtualShapePtr p_vt = (VirtualShapePtr) pVTab;
+    vshp_free_grid (p_vt->Grid);
+    splite_unmap_shapefile (&(p_vt->Mapping));
     if (p_vt->Shp)
 	gaiaFreeShapefile (p_vt->Shp);
 
@@ -745,7 +1185,6 @@ vshp_read_row (VirtualShapeCursorPtr cursor)
 {
 /* trying to read a "row" from shapefile */
     int ret;
-    gaiaGeomCollPtr geom;
     if (!(cursor->pVtab->Shp->Valid))
       {
 	  cursor->eof = 1;
@@ -758,14 +1197,30 @@ vshp_read_row (VirtualShapeCursorPtr cursor)
       }
     while (1)
       {
+	  if (cursor->candidates != NULL)
+	    {
+		/* spatial filter: jumping to the next candidate row */
+		if (cursor->next_candidate >= cursor->n_candidates)
+		  {
+		      cursor->eof = 1;
+		      return;
+		  }
+		cursor->current_row =
+		    cursor->candidates[cursor->next_candidate++];
+	    }
 	  ret =
-	      gaiaReadShpEntity_ex (cursor->pVtab->Shp, cursor->current_row,
-				    cursor->pVtab->Srid,
-				    cursor->pVtab->text_dates);
+	      splite_read_mapped_shp_entity (cursor->pVtab->Shp,
+					     &(cursor->pVtab->Mapping),
+					     cursor->current_row,
+					     cursor->pVtab->Srid,
+					     cursor->pVtab->text_dates,
+					     &(cursor->blobGeometry),
+					     &(cursor->blobSize));
 	  if (ret < 0)
 	    {
 		/* skkipping a DBF deleted Row */
-		cursor->current_row += 1;
+		if (cursor->candidates == NULL)
+		    cursor->current_row += 1;
 		continue;
 	    }
 	  break;
@@ -783,13 +1238,6 @@ vshp_read_row (VirtualShapeCursorPtr cursor)
 	  return;
       }
     cursor->current_row++;
-    geom = cursor->pVtab->Shp->Dbf->Geometry;
-    if (geom)
-      {
-	  /* preparing the BLOB representing Geometry */
-	  gaiaToSpatiaLiteBlobWkb (geom, &(cursor->blobGeometry),
-				   &(cursor->blobSize));
-      }
 }
 
 static int
@@ -803,10 +1251,16 @@ vshp_open (sqlite3_vtab * pVTab, sqlite3_vtab_cursor ** ppCursor)
     cursor->firstConstraint = NULL;
     cursor->lastConstraint = NULL;
     cursor->pVtab = (VirtualShapePtr) pVTab;
+/* the Shapefile could have been truncated since the previous scan */
+    splite_check_mapped_shapefile (cursor->pVtab->Shp,
+				   &(cursor->pVtab->Mapping));
     cursor->current_row = 0;
     cursor->blobGeometry = NULL;
     cursor->blobSize = 0;
     cursor->eof = 0;
+    cursor->candidates = NULL;
+    cursor->n_candidates = 0;
+    cursor->next_candidate = 0;
     *ppCursor = (sqlite3_vtab_cursor *) cursor;
     vshp_read_row (cursor);
     return SQLITE_OK;
@@ -838,6 +1292,8 @@ vshp_close (sqlite3_vtab_cursor * pCursor)
     VirtualShapeCursorPtr cursor = (VirtualShapeCursorPtr) pCursor;
     if (cursor->blobGeometry)
 	free (cursor->blobGeometry);
+    if (cursor->candidates)
+	free (cursor->candidates);
     vshp_free_constraints (cursor);
     sqlite3_free (pCursor);
     return SQLITE_OK;
@@ -889,6 +1345,21 @@ vshp_parse_constraint (const char *str, int index, int *iColumn, int *op)
     return 0;
 }
 
+static int
+vshp_frame_intersects (VirtualShapeCursorPtr cursor,
+		       VirtualShapeConstraintPtr pC)
+{
+/* checking the current Geometry MBR against a search frame */
+    int endian_arch = gaiaEndianArch ();
+    unsigned char *blob = cursor->blobGeometry;
+    if (gaiaImport64 (blob + 6, 1, endian_arch) <= pC->maxx
+	&& gaiaImport64 (blob + 22, 1, endian_arch) >= pC->minx
+	&& gaiaImport64 (blob + 14, 1, endian_arch) <= pC->maxy
+	&& gaiaImport64 (blob + 30, 1, endian_arch) >= pC->miny)
+	return 1;
+    return 0;
+}
+
 static int
 vshp_eval_constraints (VirtualShapeCursorPtr cursor)
 {
@@ -901,6 +1372,26 @@ vshp_eval_constraints (VirtualShapeCursorPtr cursor)
     while (pC)
       {
 	  int ok = 0;
+	  if (pC->iColumn == cursor->pVtab->FrameColumn)
+	    {
+		/* the hidden SEARCH_FRAME column: MbrIntersects() */
+		if (pC->valueType == 'F' && cursor->blobGeometry != NULL)
+		    ok = vshp_frame_intersects (cursor, pC);
+		goto done;
+	    }
+	  if (pC->iColumn == 1 && pC->op == VSHP_MBR_INTERSECTS)
+	    {
+		/* 
+		/ MbrIntersects(Geometry, <geometry>): only discarding the rows
+		/ for which it would surely return 0 (it returns -1 for NULL
+		/ Geometries, and for an invalid search frame)
+		*/
+		if (pC->valueType == 'F' && cursor->blobGeometry != NULL)
+		    ok = vshp_frame_intersects (cursor, pC);
+		else
+		    ok = 1;
+		goto done;
+	    }
 	  if (pC->iColumn == 0)
 	    {
 		/* the PRIMARY KEY column */
@@ -1107,6 +1598,7 @@ vshp_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
     int op;
     int len;
     VirtualShapeConstraintPtr pC;
+    VirtualShapeConstraintPtr frame = NULL;
     VirtualShapeCursorPtr cursor = (VirtualShapeCursorPtr) pCursor;
     if (idxNum)
 	idxNum = idxNum;	/* unused arg warning suppression */
@@ -1127,6 +1619,33 @@ vshp_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 	  pC->txtValue = NULL;
 	  pC->next = NULL;
 
+	  if (iColumn == cursor->pVtab->FrameColumn
+	      || (iColumn == 1 && op == VSHP_MBR_INTERSECTS))
+	    {
+		/* the search frame: only its MBR is relevant */
+		if (sqlite3_value_type (argv[i]) == SQLITE_BLOB)
+		  {
+		      gaiaGeomCollPtr mbr =
+			  gaiaFromSpatiaLiteBlobMbr (sqlite3_value_blob
+						     (argv[i]),
+						     sqlite3_value_bytes
+						     (argv[i]));
+		      if (mbr != NULL)
+			{
+			    gaiaMbrGeometry (mbr);
+			    pC->valueType = 'F';
+			    pC->minx = mbr->MinX;
+			    pC->miny = mbr->MinY;
+			    pC->maxx = mbr->MaxX;
+			    pC->maxy = mbr->MaxY;
+			    if (frame == NULL)
+				frame = pC;
+			    gaiaFreeGeomColl (mbr);
+			}
+		  }
+		goto append;
+	    }
+
 	  if (sqlite3_value_type (argv[i]) == SQLITE_INTEGER)
 	    {
 		pC->valueType = 'I';
@@ -1146,6 +1665,7 @@ vshp_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 		    strcpy (pC->txtValue,
 			    (char *) sqlite3_value_text (argv[i]));
 	    }
+	append:
 	  if (cursor->firstConstraint == NULL)
 	      cursor->firstConstraint = pC;
 	  if (cursor->lastConstraint != NULL)
@@ -1159,6 +1679,20 @@ vshp_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
     cursor->blobGeometry = NULL;
     cursor->blobSize = 0;
     cursor->eof = 0;
+    if (cursor->candidates)
+	free (cursor->candidates);
+    cursor->candidates = NULL;
+    cursor->n_candidates = 0;
+    cursor->next_candidate = 0;
+    if (frame != NULL)
+      {
+	  /* spatial filter: the grid index is built on first use */
+	  if (cursor->pVtab->Grid == NULL)
+	      cursor->pVtab->Grid = vshp_build_grid (cursor->pVtab);
+	  vshp_grid_candidates (cursor, frame->minx, frame->miny,
+				frame->maxx, frame->maxy,
+				frame->op == VSHP_MBR_INTERSECTS);
+      }
     while (1)
       {
 	  vshp_read_row (cursor);
@@ -1200,7 +1734,6 @@ vshp_column (sqlite3_vtab_cursor * pCursor, sqlite3_context * pContext,
 {
 /* fetching value for the Nth column */
     int nCol = 2;
-    gaiaGeomCollPtr geom;
     gaiaDbfFieldPtr pFld;
     VirtualShapeCursorPtr cursor = (VirtualShapeCursorPtr) pCursor;
     if (column == 0)
@@ -1212,8 +1745,7 @@ vshp_column (sqlite3_vtab_cursor * pCursor, sqlite3_context * pContext,
     if (column == 1)
       {
 	  /* the GEOMETRY column */
-	  geom = cursor->pVtab->Shp->Dbf->Geometry;
-	  if (geom)
+	  if (cursor->blobGeometry)
 	      sqlite3_result_blob (pContext, cursor->blobGeometry,
 				   cursor->blobSize, SQLITE_STATIC);
 	  else
@@ -1325,6 +1857,66 @@ vshp_rename (sqlite3_vtab * pVTab, const char *zNew)
     return SQLITE_ERROR;
 }
 
+static void
+vshp_mbr_intersects (sqlite3_context * context, int argc,
+		     sqlite3_value ** argv)
+{
+/* 
+/ the overloaded MbrIntersects(Geometry, BLOB encoded GEOMETRY)
+/ (exactly the same as the plain SQL function)
+/
+/ returns:
+/ 1 if the two MBRs intersect, 0 otherwise
+/ or -1 if any error is encountered
+*/
+    gaiaGeomCollPtr geo1 = NULL;
+    gaiaGeomCollPtr geo2 = NULL;
+    if (argc != 2 || sqlite3_value_type (argv[0]) != SQLITE_BLOB
+	|| sqlite3_value_type (argv[1]) != SQLITE_BLOB)
+      {
+	  sqlite3_result_int (context, -1);
+	  return;
+      }
+    geo1 =
+	gaiaFromSpatiaLiteBlobMbr (sqlite3_value_blob (argv[0]),
+				   sqlite3_value_bytes (argv[0]));
+    geo2 =
+	gaiaFromSpatiaLiteBlobMbr (sqlite3_value_blob (argv[1]),
+				   sqlite3_value_bytes (argv[1]));
+    if (!geo1 || !geo2)
+	sqlite3_result_int (context, -1);
+    else
+      {
+	  int ret;
+	  gaiaMbrGeometry (geo1);
+	  gaiaMbrGeometry (geo2);
+	  ret = gaiaMbrsIntersects (geo1, geo2);
+	  sqlite3_result_int (context, (ret < 0) ? -1 : ret);
+      }
+    gaiaFreeGeomColl (geo1);
+    gaiaFreeGeomColl (geo2);
+}
+
+static int
+vshp_find_function (sqlite3_vtab * pVTab, int nArg, const char *zName,
+		    void (**pxFunc) (sqlite3_context *, int,
+				     sqlite3_value **), void **ppArg)
+{
+/* 
+/ overloading MbrIntersects(Geometry, <geometry>), so that it
+/ can be passed to xBestIndex as a spatial filter
+*/
+    if (pVTab)
+	pVTab = pVTab;		/* unused arg warning suppression */
+    if (nArg == 2 && strcasecmp (zName, "MbrIntersects") == 0)
+      {
+	  *pxFunc = vshp_mbr_intersects;
+	  *ppArg = NULL;
+	  return VSHP_MBR_INTERSECTS;
+      }
+    return 0;
+}
+
 static int
 spliteVirtualShapeInit (sqlite3 * db)
 {
@@ -1347,7 +1939,7 @@ spliteVirtualShapeInit (sqlite3 * db)
     my_shape_module.xSync = &vshp_sync;
     my_shape_module.xCommit = &vshp_commit;
     my_shape_module.xRollback = &vshp_rollback;
-    my_shape_module.xFindFunction = NULL;
+    my_shape_module.xFindFunction = &vshp_find_function;
     my_shape_module.xRename = &vshp_rename;
     sqlite3_create_module_v2 (db, "VirtualShape", &my_shape_module, NULL, 0);
     return rc;
@@ -60,6 +60,7 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <spatialite/spatialite.h>
 #include <spatialite/gaiaaux.h>
 #include <spatialite/gaiageo.h>
+#include <spatialite_private.h>
 
 #ifdef _WIN32
 #define strcasecmp	_stricmp
@@ -82,6 +83,7 @@ typedef struct VirtualSpatialIndexStruct
     int nRef;			/* # references: USED INTERNALLY BY SQLITE */
     char *zErrMsg;		/* error message: USE INTERNALLY BY SQLITE */
     sqlite3 *db;		/* the sqlite db holding the virtual table */
+    const void *p_cache;	/* pointer to the internal cache */
 } VirtualSpatialIndex;
 typedef VirtualSpatialIndex *VirtualSpatialIndexPtr;
 
@@ -559,8 +561,6 @@ vspidx_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
     char *buf;
     char *vtable;
     char *xname;
-    if (pAux)
-	pAux = pAux;		/* unused arg warning suppression */
     if (argc == 3)
       {
 	  vtable = gaiaDequotedSql ((char *) argv[2]);
@@ -577,6 +577,7 @@ vspidx_create (sqlite3 * db, void *pAux, int argc, const char *const *argv,
     if (!p_vt)
 	return SQLITE_NOMEM;
     p_vt->db = db;
+    p_vt->p_cache = pAux;
     p_vt->pModule = &my_spidx_module;
     p_vt->nRef = 0;
     p_vt->zErrMsg = NULL;
@@ -726,6 +727,7 @@ vspidx_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
     int size;
     int exists;
     int ret;
+    int rc = SQLITE_OK;
     sqlite3_stmt *stmt;
     float minx;
     float miny;
@@ -805,6 +807,19 @@ vspidx_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 
 /* building the RTree query */
     idx_name = sqlite3_mprintf ("idx_%s_%s", xtable, xgeom);
+    if (db_prefix == NULL && spidx->p_cache != NULL
+	&& count_deferred_rtree_items (idx_name, spidx->p_cache) > 0)
+      {
+	  /* deferred SpatialIndex mode: the R*Tree isn't yet up to date */
+	  sqlite3_free (spidx->zErrMsg);
+	  spidx->zErrMsg =
+	      sqlite3_mprintf
+	      ("SpatialIndex: \"%s\" has pending deferred entries "
+	       "(FlushDeferredSpatialIndex() is required)", idx_name);
+	  sqlite3_free (idx_name);
+	  rc = SQLITE_ERROR;
+	  goto stop;
+      }
     idx_nameQ = gaiaDoubleQuotedSql (idx_name);
     if (db_prefix == NULL)
       {
@@ -871,7 +886,7 @@ vspidx_filter (sqlite3_vtab_cursor * pCursor, int idxNum, const char *idxStr,
 	free (db_prefix);
     if (table_name)
 	free (table_name);
-    return SQLITE_OK;
+    return rc;
 }
 
 static int
@@ -982,7 +997,7 @@ vspidx_rename (sqlite3_vtab * pVTab, const char *zNew)
 }
 
 static int
-spliteVirtualSpatialIndexInit (sqlite3 * db)
+spliteVirtualSpatialIndexInit (sqlite3 * db, void *p_cache)
 {
     int rc = SQLITE_OK;
     my_spidx_module.iVersion = 1;
@@ -1005,14 +1020,14 @@ spliteVirtualSpatialIndexInit (sqlite3 * db)
     my_spidx_module.xRollback = &vspidx_rollback;
     my_spidx_module.xFindFunction = NULL;
     my_spidx_module.xRename = &vspidx_rename;
-    sqlite3_create_module_v2 (db, "VirtualSpatialIndex", &my_spidx_module, NULL,
-			      0);
+    sqlite3_create_module_v2 (db, "VirtualSpatialIndex", &my_spidx_module,
+			      p_cache, 0);
     return rc;
 }
 
 SPATIALITE_PRIVATE int
-virtual_spatialindex_extension_init (void *xdb)
+virtual_spatialindex_extension_init (void *xdb, const void *p_cache)
 {
     sqlite3 *db = (sqlite3 *) xdb;
-    return spliteVirtualSpatialIndexInit (db);
+    return spliteVirtualSpatialIndexInit (db, (void *) p_cache);
 }
@@ -0,0 +1,317 @@
+/*
+
+ bench_blob.c -- BLOB Geometry decode/encode throughput benchmark
+
+ Author: Sandro Furieri <a.furieri@lqt.it>
+
+ ------------------------------------------------------------------------------
+
+ Version: MPL 1.1/GPL 2.0/LGPL 2.1
+
+ The contents of this file are subject to the Mozilla Public License Version
+ 1.1 (the "License"); you may not use this file except in compliance with
+ the License. You may obtain a copy of the License at
+ http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS" basis,
+WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+for the specific language governing rights and limitations under the
+License.
+
+The Original Code is the SpatiaLite library
+
+The Initial Developer of the Original Code is Alessandro Furieri
+
+Portions created by the Initial Developer are Copyright (C) 2024
+the Initial Developer. All Rights Reserved.
+
+Contributor(s):
+
+Alternatively, the contents of this file may be used under the terms of
+either the GNU General Public License Version 2 or later (the "GPL"), or
+the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+in which case the provisions of the GPL or the LGPL are applicable instead
+of those above. If you wish to allow use of your version of this file only
+under the terms of either the GPL or the LGPL, and not to allow others to
+use your version of this file under the terms of the MPL, indicate your
+decision by deleting the provisions above and replace them with the notice
+and other provisions required by the GPL or the LGPL. If you do not delete
+the provisions above, a recipient may use your version of this file under
+the terms of any one of the MPL, the GPL or the LGPL.
+
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "config.h"
+
+#include "sqlite3.h"
+#include "spatialite.h"
+#include <spatialite/gaiageo.h>
+
+/*
+/ a few synthetic Geometries of each type are encoded as SpatiaLite
+/ BLOBs and then repeatedly decoded and encoded again, reporting MB/s
+/ (the size of the BLOB divided by the elapsed time)
+/
+/ the "WKB XDR" rows decode a big-endian WKB, thus measuring the
+/ byte-swapping path instead of the plain copy
+/
+/ usage: bench_blob [vertices [iterations]]
+*/
+
+static void
+fill_coords (double *coords, int points, int dims, double cx, double cy,
+	     double radius)
+{
+/* a closed circle-like ring around cx,cy */
+    int iv;
+    for (iv = 0; iv < points; iv++)
+      {
+	  double angle = (6.283185307179586 * iv) / (points - 1);
+	  double r = radius * (1.0 + 0.1 * ((iv * 7919) % 13) / 13.0);
+	  double *p = coords + (iv * dims);
+	  if (iv == points - 1)
+	      angle = 0.0;
+	  p[0] = cx + (r * cos (angle));
+	  p[1] = cy + (r * sin (angle));
+	  if (dims > 2)
+	      p[2] = iv * 0.5;
+	  if (dims > 3)
+	      p[3] = iv * 0.25;
+      }
+}
+
+static gaiaGeomCollPtr
+build_geometry (int type, int dims, int vertices)
+{
+/* building a synthetic Geometry of the required class */
+    gaiaGeomCollPtr geom;
+    gaiaLinestringPtr line;
+    gaiaPolygonPtr polyg;
+    int dimension_model = GAIA_XY;
+    int ib;
+    int ip;
+    if (dims == 3)
+	dimension_model = GAIA_XY_Z;
+    else if (dims == 4)
+	dimension_model = GAIA_XY_Z_M;
+    if (dimension_model == GAIA_XY_Z)
+	geom = gaiaAllocGeomCollXYZ ();
+    else if (dimension_model == GAIA_XY_Z_M)
+	geom = gaiaAllocGeomCollXYZM ();
+    else
+	geom = gaiaAllocGeomColl ();
+    geom->Srid = 4326;
+    switch (type)
+      {
+      case GAIA_MULTIPOINT:
+	  for (ip = 0; ip < vertices; ip++)
+	    {
+		double x = (ip % 1000) * 0.01;
+		double y = (ip / 1000) * 0.01;
+		if (dimension_model == GAIA_XY_Z)
+		    gaiaAddPointToGeomCollXYZ (geom, x, y, ip);
+		else if (dimension_model == GAIA_XY_Z_M)
+		    gaiaAddPointToGeomCollXYZM (geom, x, y, ip, ip);
+		else
+		    gaiaAddPointToGeomColl (geom, x, y);
+	    }
+	  break;
+      case GAIA_LINESTRING:
+	  line = gaiaAddLinestringToGeomColl (geom, vertices);
+	  fill_coords (line->Coords, vertices, dims, 10.0, 40.0, 1.0);
+	  break;
+      case GAIA_POLYGON:
+	  /* an exterior ring and four holes */
+	  polyg = gaiaAddPolygonToGeomColl (geom, vertices, 4);
+	  fill_coords (polyg->Exterior->Coords, vertices, dims, 10.0, 40.0,
+		       10.0);
+	  for (ib = 0; ib < 4; ib++)
+	    {
+		gaiaRingPtr ring =
+		    gaiaAddInteriorRing (polyg, ib, vertices / 4 + 4);
+		fill_coords (ring->Coords, ring->Points, dims,
+			     10.0 + ((ib % 2) ? 4.0 : -4.0),
+			     40.0 + ((ib / 2) ? 4.0 : -4.0), 1.0);
+	    }
+	  break;
+      case GAIA_MULTIPOLYGON:
+	  /* many small polygons */
+	  for (ip = 0; ip < vertices / 16; ip++)
+	    {
+		polyg = gaiaAddPolygonToGeomColl (geom, 17, 0);
+		fill_coords (polyg->Exterior->Coords, 17, dims,
+			     (ip % 100) * 3.0, (ip / 100) * 3.0, 1.0);
+	    }
+	  break;
+      };
+    gaiaMbrGeometry (geom);
+    if (type == GAIA_MULTIPOINT)
+	geom->DeclaredType = GAIA_MULTIPOINT;
+    else if (type == GAIA_MULTIPOLYGON)
+	geom->DeclaredType = GAIA_MULTIPOLYGON;
+    return geom;
+}
+
+static unsigned char *
+build_xdr_polygon (gaiaGeomCollPtr geom, int *size)
+{
+/* encoding a POLYGON XY as a big-endian (XDR) WKB */
+    gaiaPolygonPtr polyg = geom->FirstPolygon;
+    int endian_arch = gaiaEndianArch ();
+    unsigned char *blob;
+    unsigned char *ptr;
+    int ib;
+    int iv;
+    int sz = 9 + (4 + (16 * polyg->Exterior->Points));
+    for (ib = 0; ib < polyg->NumInteriors; ib++)
+	sz += 4 + (16 * polyg->Interiors[ib].Points);
+    blob = malloc (sz);
+    ptr = blob;
+    *ptr = 0x00;		/* XDR: big-endian */
+    gaiaExport32 (ptr + 1, GAIA_POLYGON, 0, endian_arch);
+    gaiaExport32 (ptr + 5, polyg->NumInteriors + 1, 0, endian_arch);
+    ptr += 9;
+    for (ib = -1; ib < polyg->NumInteriors; ib++)
+      {
+	  gaiaRingPtr ring =
+	      (ib < 0) ? polyg->Exterior : polyg->Interiors + ib;
+	  gaiaExport32 (ptr, ring->Points, 0, endian_arch);
+	  ptr += 4;
+	  for (iv = 0; iv < ring->Points * 2; iv++)
+	    {
+		gaiaExport64 (ptr, ring->Coords[iv], 0, endian_arch);
+		ptr += 8;
+	    }
+      }
+    *size = sz;
+    return blob;
+}
+
+static void
+report (const char *title, const char *mode, int size, int iterations,
+	clock_t t0)
+{
+/* printing a single line of results */
+    double secs = (double) (clock () - t0) / CLOCKS_PER_SEC;
+    double mb = ((double) size * (double) iterations) / (1024.0 * 1024.0);
+    printf ("%-24s %-6s %9d bytes %7d iter %9.3f sec %10.1f MB/s\n", title,
+	    mode, size, iterations, secs, (secs > 0.0) ? mb / secs : 0.0);
+}
+
+static int
+run_blob (const char *title, int type, int dims, int vertices,
+	  int iterations)
+{
+/* measuring the SpatiaLite BLOB decode and encode throughput */
+    gaiaGeomCollPtr geom = build_geometry (type, dims, vertices);
+    unsigned char *blob = NULL;
+    int size;
+    int i;
+    clock_t t0;
+
+    gaiaToSpatiaLiteBlobWkb (geom, &blob, &size);
+    gaiaFreeGeomColl (geom);
+    if (blob == NULL)
+      {
+	  fprintf (stderr, "%s: unable to encode\n", title);
+	  return 0;
+      }
+
+    t0 = clock ();
+    for (i = 0; i < iterations; i++)
+      {
+	  geom = gaiaFromSpatiaLiteBlobWkb (blob, size);
+	  if (geom == NULL)
+	    {
+		fprintf (stderr, "%s: unable to decode\n", title);
+		free (blob);
+		return 0;
+	    }
+	  gaiaFreeGeomColl (geom);
+      }
+    report (title, "decode", size, iterations, t0);
+
+    geom = gaiaFromSpatiaLiteBlobWkb (blob, size);
+    t0 = clock ();
+    for (i = 0; i < iterations; i++)
+      {
+	  unsigned char *out;
+	  int out_size;
+	  gaiaToSpatiaLiteBlobWkb (geom, &out, &out_size);
+	  free (out);
+      }
+    report (title, "encode", size, iterations, t0);
+    gaiaFreeGeomColl (geom);
+    free (blob);
+    return 1;
+}
+
+static int
+run_xdr (const char *title, int vertices, int iterations)
+{
+/* measuring the big-endian WKB decode throughput */
+    gaiaGeomCollPtr geom = build_geometry (GAIA_POLYGON, 2, vertices);
+    unsigned char *blob;
+    int size;
+    int i;
+    clock_t t0;
+
+    blob = build_xdr_polygon (geom, &size);
+    gaiaFreeGeomColl (geom);
+    t0 = clock ();
+    for (i = 0; i < iterations; i++)
+      {
+	  geom = gaiaFromWkb (blob, size);
+	  if (geom == NULL)
+	    {
+		fprintf (stderr, "%s: unable to decode\n", title);
+		free (blob);
+		return 0;
+	    }
+	  gaiaFreeGeomColl (geom);
+      }
+    report (title, "decode", size, iterations, t0);
+    free (blob);
+    return 1;
+}
+
+int
+main (int argc, char *argv[])
+{
+    int vertices = 4096;
+    int iterations = 2000;
+
+    if (argc > 1)
+	vertices = atoi (argv[1]);
+    if (argc > 2)
+	iterations = atoi (argv[2]);
+    if (vertices < 32 || iterations < 1)
+      {
+	  fprintf (stderr, "usage: %s [vertices [iterations]]\n", argv[0]);
+	  return -1;
+      }
+
+    if (!run_blob ("MULTIPOINT XY", GAIA_MULTIPOINT, 2, vertices, iterations))
+	return -2;
+    if (!run_blob ("LINESTRING XY", GAIA_LINESTRING, 2, vertices, iterations))
+	return -3;
+    if (!run_blob ("LINESTRING XYZ", GAIA_LINESTRING, 3, vertices, iterations))
+	return -4;
+    if (!run_blob ("POLYGON XY", GAIA_POLYGON, 2, vertices, iterations))
+	return -5;
+    if (!run_blob ("POLYGON XYZM", GAIA_POLYGON, 4, vertices, iterations))
+	return -6;
+    if (!run_blob
+	("MULTIPOLYGON XY", GAIA_MULTIPOLYGON, 2, vertices, iterations))
+	return -7;
+    if (!run_xdr ("POLYGON XY (WKB XDR)", vertices, iterations))
+	return -8;
+
+    spatialite_shutdown ();
+    return 0;
+}
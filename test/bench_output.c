@@ -0,0 +1,273 @@
+/*
+
+ bench_output.c -- Text notations (WKT, GeoJSON, KML ...) output benchmark
+
+ Author: Sandro Furieri <a.furieri@lqt.it>
+
+ ------------------------------------------------------------------------------
+
+ Version: MPL 1.1/GPL 2.0/LGPL 2.1
+
+ The contents of this file are subject to the Mozilla Public License Version
+ 1.1 (the "License"); you may not use this file except in compliance with
+ the License. You may obtain a copy of the License at
+ http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS" basis,
+WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+for the specific language governing rights and limitations under the
+License.
+
+The Original Code is the SpatiaLite library
+
+The Initial Developer of the Original Code is Alessandro Furieri
+
+Portions created by the Initial Developer are Copyright (C) 2024
+the Initial Developer. All Rights Reserved.
+
+Contributor(s):
+
+Alternatively, the contents of this file may be used under the terms of
+either the GNU General Public License Version 2 or later (the "GPL"), or
+the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+in which case the provisions of the GPL or the LGPL are applicable instead
+of those above. If you wish to allow use of your version of this file only
+under the terms of either the GPL or the LGPL, and not to allow others to
+use your version of this file under the terms of the MPL, indicate your
+decision by deleting the provisions above and replace them with the notice
+and other provisions required by the GPL or the LGPL. If you do not delete
+the provisions above, a recipient may use your version of this file under
+the terms of any one of the MPL, the GPL or the LGPL.
+
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "config.h"
+
+#include "sqlite3.h"
+#include "spatialite.h"
+#include <spatialite/gaiageo.h>
+
+/*
+/ a synthetic Geometry of each type is repeatedly exported by all
+/ Text notations, reporting MB/s (the size of the generated text
+/ divided by the elapsed time) and the number of coordinates
+/ formatted per second
+/
+/ the "fixed" rows use the default precision (6 decimal digits),
+/ the "short" rows the shortest representation reading back as the
+/ same double (GAIA_PRECISION_SHORTEST)
+/
+/ usage: bench_output [vertices [iterations]]
+*/
+
+#define OUT_WKT		1
+#define OUT_EWKT	2
+#define OUT_GEOJSON	3
+#define OUT_KML		4
+#define OUT_GML2	5
+#define OUT_GML3	6
+#define OUT_SVG		7
+
+static void
+fill_coords (double *coords, int points, int dims, double cx, double cy,
+	     double radius)
+{
+/* a closed circle-like ring around cx,cy (full precision coordinates) */
+    int iv;
+    for (iv = 0; iv < points; iv++)
+      {
+	  double angle = (6.283185307179586 * iv) / (points - 1);
+	  double r = radius * (1.0 + 0.1 * ((iv * 7919) % 13) / 13.0);
+	  double *p = coords + (iv * dims);
+	  if (iv == points - 1)
+	      angle = 0.0;
+	  p[0] = cx + (r * cos (angle));
+	  p[1] = cy + (r * sin (angle));
+	  if (dims > 2)
+	      p[2] = 100.0 + (iv * 0.37);
+      }
+}
+
+static gaiaGeomCollPtr
+build_geometry (int type, int dims, int vertices)
+{
+/* building a synthetic Geometry of the required class */
+    gaiaGeomCollPtr geom;
+    gaiaLinestringPtr line;
+    gaiaPolygonPtr polyg;
+    int ip;
+    if (dims == 3)
+	geom = gaiaAllocGeomCollXYZ ();
+    else
+	geom = gaiaAllocGeomColl ();
+    geom->Srid = 4326;
+    switch (type)
+      {
+      case GAIA_MULTIPOINT:
+	  for (ip = 0; ip < vertices; ip++)
+	    {
+		double x = 11.0 + ((ip % 1000) * 0.001234567);
+		double y = 43.0 + ((ip / 1000) * 0.001234567);
+		if (dims == 3)
+		    gaiaAddPointToGeomCollXYZ (geom, x, y, ip * 0.1);
+		else
+		    gaiaAddPointToGeomColl (geom, x, y);
+	    }
+	  break;
+      case GAIA_LINESTRING:
+	  line = gaiaAddLinestringToGeomColl (geom, vertices);
+	  fill_coords (line->Coords, vertices, dims, 11.0, 43.0, 0.1);
+	  break;
+      case GAIA_POLYGON:
+	  polyg = gaiaAddPolygonToGeomColl (geom, vertices, 0);
+	  fill_coords (polyg->Exterior->Coords, vertices, dims, 11.0, 43.0,
+		       0.1);
+	  break;
+      };
+    gaiaMbrGeometry (geom);
+    if (type == GAIA_MULTIPOINT)
+	geom->DeclaredType = GAIA_MULTIPOINT;
+    return geom;
+}
+
+static void
+export_geometry (gaiaOutBufferPtr out_buf, gaiaGeomCollPtr geom, int format,
+		 int precision)
+{
+/* exporting a Geometry by using the required Text notation */
+    switch (format)
+      {
+      case OUT_WKT:
+	  gaiaOutWktEx (out_buf, geom, precision);
+	  break;
+      case OUT_EWKT:
+	  gaiaToEWKT (out_buf, geom);
+	  break;
+      case OUT_GEOJSON:
+	  gaiaOutGeoJSON (out_buf, geom, precision, 0);
+	  break;
+      case OUT_KML:
+	  gaiaOutBareKml (out_buf, geom, precision);
+	  break;
+      case OUT_GML2:
+	  gaiaOutGml (out_buf, 2, precision, geom);
+	  break;
+      case OUT_GML3:
+	  gaiaOutGml (out_buf, 3, precision, geom);
+	  break;
+      case OUT_SVG:
+	  gaiaOutSvg (out_buf, geom, 1, precision);
+	  break;
+      };
+}
+
+static int
+run_output (const char *title, const char *mode, gaiaGeomCollPtr geom,
+	    int coords, int format, int precision, int iterations)
+{
+/* measuring the throughput of a single Text notation */
+    gaiaOutBuffer out_buf;
+    clock_t t0;
+    double secs;
+    double mb;
+    int size;
+    int i;
+
+    gaiaOutBufferInitialize (&out_buf);
+    export_geometry (&out_buf, geom, format, precision);
+    size = out_buf.WriteOffset;
+    gaiaOutBufferReset (&out_buf);
+    if (size == 0)
+      {
+	  fprintf (stderr, "%s %s: unable to export\n", title, mode);
+	  return 0;
+      }
+
+    t0 = clock ();
+    for (i = 0; i < iterations; i++)
+      {
+	  gaiaOutBufferInitialize (&out_buf);
+	  export_geometry (&out_buf, geom, format, precision);
+	  gaiaOutBufferReset (&out_buf);
+      }
+    secs = (double) (clock () - t0) / CLOCKS_PER_SEC;
+    mb = ((double) size * (double) iterations) / (1024.0 * 1024.0);
+    printf ("%-26s %-5s %9d bytes %9.3f sec %8.1f MB/s %7.2f Mcoords/s\n",
+	    title, mode, size, secs, (secs > 0.0) ? mb / secs : 0.0,
+	    (secs >
+	     0.0) ? ((double) coords * iterations) / (secs * 1000000.0) : 0.0);
+    return 1;
+}
+
+static int
+run_geometry (const char *title, int type, int dims, int vertices,
+	      int iterations)
+{
+/* measuring all Text notations for the same Geometry */
+    static const char *names[] =
+	{ "WKT", "EWKT", "GeoJSON", "KML", "GML2", "GML3", "SVG" };
+    static const int formats[] =
+	{ OUT_WKT, OUT_EWKT, OUT_GEOJSON, OUT_KML, OUT_GML2, OUT_GML3,
+	OUT_SVG
+    };
+    gaiaGeomCollPtr geom = build_geometry (type, dims, vertices);
+    char label[128];
+    int coords = vertices * dims;
+    int i;
+    int ok = 1;
+
+    for (i = 0; i < 7; i++)
+      {
+	  if (formats[i] == OUT_SVG && dims == 3)
+	      continue;		/* SVG is always 2D */
+	  sprintf (label, "%s %s", title, names[i]);
+	  if (!run_output
+	      (label, "fixed", geom, coords, formats[i], 6, iterations))
+	      ok = 0;
+	  if (formats[i] == OUT_EWKT)
+	      continue;		/* EWKT has no precision argument */
+	  if (!run_output
+	      (label, "short", geom, coords, formats[i],
+	       GAIA_PRECISION_SHORTEST, iterations))
+	      ok = 0;
+      }
+    gaiaFreeGeomColl (geom);
+    return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+    int vertices = 4096;
+    int iterations = 200;
+
+    if (argc > 1)
+	vertices = atoi (argv[1]);
+    if (argc > 2)
+	iterations = atoi (argv[2]);
+    if (vertices < 32 || iterations < 1)
+      {
+	  fprintf (stderr, "usage: %s [vertices [iterations]]\n", argv[0]);
+	  return -1;
+      }
+
+    if (!run_geometry
+	("MULTIPOINT XY", GAIA_MULTIPOINT, 2, vertices, iterations))
+	return -2;
+    if (!run_geometry
+	("LINESTRING XY", GAIA_LINESTRING, 2, vertices, iterations))
+	return -3;
+    if (!run_geometry
+	("LINESTRING XYZ", GAIA_LINESTRING, 3, vertices, iterations))
+	return -4;
+    if (!run_geometry ("POLYGON XY", GAIA_POLYGON, 2, vertices, iterations))
+	return -5;
+
+    spatialite_shutdown ();
+    return 0;
+}
@@ -0,0 +1,352 @@
+/*
+
+ bench_routing.c -- VirtualRouting throughput benchmark
+
+ Author: Sandro Furieri <a.furieri@lqt.it>
+
+ ------------------------------------------------------------------------------
+ 
+ Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ 
+ The contents of this file are subject to the Mozilla Public License Version
+ 1.1 (the "License"); you may not use this file except in compliance with
+ the License. You may obtain a copy of the License at
+ http://www.mozilla.org/MPL/
+ 
+Software distributed under the License is distributed on an "AS IS" basis,
+WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+for the specific language governing rights and limitations under the
+License.
+
+The Original Code is the SpatiaLite library
+
+The Initial Developer of the Original Code is Alessandro Furieri
+ 
+Portions created by the Initial Developer are Copyright (C) 2024
+the Initial Developer. All Rights Reserved.
+
+Contributor(s):
+
+Alternatively, the contents of this file may be used under the terms of
+either the GNU General Public License Version 2 or later (the "GPL"), or
+the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+in which case the provisions of the GPL or the LGPL are applicable instead
+of those above. If you wish to allow use of your version of this file only
+under the terms of either the GPL or the LGPL, and not to allow others to
+use your version of this file under the terms of the MPL, indicate your
+decision by deleting the provisions above and replace them with the notice
+and other provisions required by the GPL or the LGPL. If you do not delete
+the provisions above, a recipient may use your version of this file under
+the terms of any one of the MPL, the GPL or the LGPL.
+ 
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "config.h"
+
+#include "sqlite3.h"
+#include "spatialite.h"
+
+/*
+/ a synthetic NxN grid graph is loaded into an in-memory database
+/ and then a batch of pseudo-random shortest path / range / TSP queries
+/ is submitted to the VirtualRouting table, reporting queries/sec
+/
+/ usage: bench_routing [grid-side [num-queries]]
+*/
+
+#ifndef OMIT_GEOS		/* GEOS is supported */
+
+static unsigned int bench_seed = 12345;
+
+static int
+bench_random (int max)
+{
+/* tiny deterministic LCG, so that every run submits the same queries */
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return (int) ((bench_seed >> 8) % (unsigned int) max);
+}
+
+static int
+create_grid (sqlite3 * handle, int side)
+{
+/* creating a bidirectional grid graph: node IDs are 1 .. side*side */
+    int ret;
+    char *err_msg = NULL;
+    char *sql;
+
+    ret = sqlite3_exec (handle,
+			"CREATE TABLE grid_arcs (id INTEGER PRIMARY KEY, "
+			"node_from INTEGER NOT NULL, node_to INTEGER NOT NULL, "
+			"cost DOUBLE NOT NULL)", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+	goto error;
+    sql = sqlite3_mprintf ("WITH RECURSIVE s(i) AS (SELECT 0 UNION ALL "
+			   "SELECT i + 1 FROM s WHERE i + 1 < %d) "
+			   "INSERT INTO grid_arcs (node_from, node_to, cost) "
+			   "SELECT y.i * %d + x.i + 1, y.i * %d + x.i + 2, "
+			   "1.0 + ((y.i * 7919 + x.i * 31) %% 97) / 10.0 "
+			   "FROM s AS x, s AS y WHERE x.i < %d - 1 "
+			   "UNION ALL "
+			   "SELECT y.i * %d + x.i + 1, (y.i + 1) * %d + x.i + 1, "
+			   "1.0 + ((y.i * 131 + x.i * 7907) %% 89) / 10.0 "
+			   "FROM s AS x, s AS y WHERE y.i < %d - 1",
+			   side, side, side, side, side, side, side);
+    ret = sqlite3_exec (handle, sql, NULL, NULL, &err_msg);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+	goto error;
+    ret = sqlite3_exec (handle,
+			"SELECT CreateRouting('grid_data', 'grid', 'grid_arcs', "
+			"'node_from', 'node_to', NULL, 'cost', NULL, 0, 1)", NULL, NULL,
+			&err_msg);
+    if (ret != SQLITE_OK)
+	goto error;
+    return 1;
+
+  error:
+    fprintf (stderr, "create_grid error: %s\n", err_msg);
+    sqlite3_free (err_msg);
+    return 0;
+}
+
+static int
+run_queries (sqlite3 * handle, const char *title, const char *sql, int side,
+	     int num_queries, int local, double range)
+{
+/* 
+/ submitting num_queries pseudo-random queries and reporting queries/sec
+/ a positive range means "NodeFrom = ? AND Cost <= range"
+*/
+    int ret;
+    int i;
+    int rows = 0;
+    sqlite3_stmt *stmt;
+    clock_t t0;
+    double secs;
+    int nodes = side * side;
+
+    ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "%s: %s\n", title, sqlite3_errmsg (handle));
+	  return 0;
+      }
+    t0 = clock ();
+    for (i = 0; i < num_queries; i++)
+      {
+	  int from = bench_random (nodes);
+	  int to;
+	  if (local)
+	    {
+		/* destination within a few blocks of the origin */
+		int x = from % side + bench_random (9) - 4;
+		int y = from / side + bench_random (9) - 4;
+		if (x < 0)
+		    x = 0;
+		if (x >= side)
+		    x = side - 1;
+		if (y < 0)
+		    y = 0;
+		if (y >= side)
+		    y = side - 1;
+		to = y * side + x;
+	    }
+	  else
+	      to = bench_random (nodes);
+	  sqlite3_reset (stmt);
+	  sqlite3_clear_bindings (stmt);
+	  sqlite3_bind_int (stmt, 1, from + 1);
+	  if (range > 0.0)
+	      sqlite3_bind_double (stmt, 2, range);
+	  else
+	      sqlite3_bind_int (stmt, 2, to + 1);
+	  while (1)
+	    {
+		ret = sqlite3_step (stmt);
+		if (ret == SQLITE_DONE)
+		    break;
+		if (ret != SQLITE_ROW)
+		  {
+		      fprintf (stderr, "%s: %s\n", title,
+			       sqlite3_errmsg (handle));
+		      sqlite3_finalize (stmt);
+		      return 0;
+		  }
+		rows++;
+	    }
+      }
+    secs = (double) (clock () - t0) / CLOCKS_PER_SEC;
+    sqlite3_finalize (stmt);
+    printf ("%-28s %6d queries %10d rows %9.3f sec %12.1f q/s\n", title,
+	    num_queries, rows, secs,
+	    (secs > 0.0) ? (double) num_queries / secs : 0.0);
+    return 1;
+}
+
+static int
+run_tsp (sqlite3 * handle, int side, int stops, int num_queries)
+{
+/* submitting num_queries pseudo-random TSP GA queries */
+    int ret;
+    int i;
+    int k;
+    char **results;
+    int rows;
+    int columns;
+    char *err_msg = NULL;
+    clock_t t0;
+    double secs;
+    double total = 0.0;
+    int nodes = side * side;
+
+    t0 = clock ();
+    for (i = 0; i < num_queries; i++)
+      {
+	  char *list = sqlite3_mprintf ("%d", bench_random (nodes) + 1);
+	  char *sql;
+	  for (k = 1; k < stops; k++)
+	    {
+		char *prev = list;
+		list =
+		    sqlite3_mprintf ("%s,%d", prev, bench_random (nodes) + 1);
+		sqlite3_free (prev);
+	    }
+	  sql =
+	      sqlite3_mprintf
+	      ("SELECT Cost FROM grid WHERE NodeFrom = %d AND NodeTo = %Q",
+	       bench_random (nodes) + 1, list);
+	  sqlite3_free (list);
+	  ret =
+	      sqlite3_get_table (handle, sql, &results, &rows, &columns,
+				 &err_msg);
+	  sqlite3_free (sql);
+	  if (ret != SQLITE_OK)
+	    {
+		fprintf (stderr, "TSP GA: %s\n", err_msg);
+		sqlite3_free (err_msg);
+		return 0;
+	    }
+	  if (rows >= 1 && results[1] != NULL)
+	      total += atof (results[1]);
+	  sqlite3_free_table (results);
+      }
+    secs = (double) (clock () - t0) / CLOCKS_PER_SEC;
+    printf ("%-28s %6d queries %10.1f avg cost %9.3f sec %12.1f q/s\n",
+	    "TSP GA", num_queries, total / num_queries, secs,
+	    (secs > 0.0) ? (double) num_queries / secs : 0.0);
+    return 1;
+}
+
+static int
+set_options (sqlite3 * handle, const char *sql)
+{
+/* changing the VirtualRouting settings */
+    char *err_msg = NULL;
+    int ret = sqlite3_exec (handle, sql, NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "%s: %s\n", sql, err_msg);
+	  sqlite3_free (err_msg);
+	  return 0;
+      }
+    return 1;
+}
+
+#endif /* end GEOS conditional */
+
+int
+main (int argc, char *argv[])
+{
+#ifndef OMIT_GEOS		/* GEOS is supported */
+    int ret;
+    sqlite3 *handle;
+    void *cache;
+    int side = 200;
+    int num_queries = 1000;
+    int retcode = 0;
+    const char *p2p =
+	"SELECT Cost FROM grid WHERE NodeFrom = ? AND NodeTo = ?";
+    const char *range =
+	"SELECT NodeTo FROM grid WHERE NodeFrom = ? AND Cost <= ?";
+
+    if (argc > 1)
+	side = atoi (argv[1]);
+    if (argc > 2)
+	num_queries = atoi (argv[2]);
+    if (side < 2 || num_queries < 1)
+      {
+	  fprintf (stderr, "usage: %s [grid-side [num-queries]]\n", argv[0]);
+	  return -1;
+      }
+
+    cache = spatialite_alloc_connection ();
+    ret =
+	sqlite3_open_v2 (":memory:", &handle,
+			 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "cannot open in-memory db: %s\n",
+		   sqlite3_errmsg (handle));
+	  sqlite3_close (handle);
+	  return -2;
+      }
+    spatialite_init_ex (handle, cache, 0);
+
+    if (!create_grid (handle, side))
+      {
+	  retcode = -3;
+	  goto end;
+      }
+    printf ("grid %dx%d: %d nodes\n", side, side, side * side);
+
+    if (!set_options (handle, "UPDATE grid SET Algorithm = 'Dijkstra', "
+		      "Options = 'Simple'"))
+      {
+	  retcode = -4;
+	  goto end;
+      }
+    if (!run_queries
+	(handle, "Dijkstra (local)", p2p, side, num_queries * 10, 1, 0.0))
+      {
+	  retcode = -5;
+	  goto end;
+      }
+    if (!run_queries
+	(handle, "Dijkstra (random)", p2p, side, num_queries, 0, 0.0))
+      {
+	  retcode = -6;
+	  goto end;
+      }
+    if (!run_queries
+	(handle, "Range (Cost <= 8.0)", range, side, num_queries * 10, 0, 8.0))
+      {
+	  retcode = -7;
+	  goto end;
+      }
+    if (!set_options (handle, "UPDATE grid SET Request = 'TSP GA'"))
+      {
+	  retcode = -8;
+	  goto end;
+      }
+    if (!run_tsp (handle, side, 30, 5))
+      {
+	  retcode = -9;
+	  goto end;
+      }
+
+  end:
+    sqlite3_close (handle);
+    spatialite_cleanup_ex (cache);
+    spatialite_shutdown ();
+    return retcode;
+#else
+    if (argc > 1 || argv[0] == NULL)
+	argc = 1;		/* silencing stupid compiler warnings */
+    printf ("bench_routing: skipped (GEOS is not supported)\n");
+    return 0;
+#endif /* end GEOS conditional */
+}
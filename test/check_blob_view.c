@@ -0,0 +1,479 @@
+/*
+
+ check_blob_view.c -- SpatiaLite Test Case
+
+ Author: Sandro Furieri <a.furieri@lqt.it>
+
+ ------------------------------------------------------------------------------
+
+ Version: MPL 1.1/GPL 2.0/LGPL 2.1
+
+ The contents of this file are subject to the Mozilla Public License Version
+ 1.1 (the "License"); you may not use this file except in compliance with
+ the License. You may obtain a copy of the License at
+ http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS" basis,
+WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+for the specific language governing rights and limitations under the
+License.
+
+The Original Code is the SpatiaLite library
+
+The Initial Developer of the Original Code is Alessandro Furieri
+
+Portions created by the Initial Developer are Copyright (C) 2011
+the Initial Developer. All Rights Reserved.
+
+Contributor(s):
+
+Alternatively, the contents of this file may be used under the terms of
+either the GNU General Public License Version 2 or later (the "GPL"), or
+the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+in which case the provisions of the GPL or the LGPL are applicable instead
+of those above. If you wish to allow use of your version of this file only
+under the terms of either the GPL or the LGPL, and not to allow others to
+use your version of this file under the terms of the MPL, indicate your
+decision by deleting the provisions above and replace them with the notice
+and other provisions required by the GPL or the LGPL. If you do not delete
+the provisions above, a recipient may use your version of this file under
+the terms of any one of the MPL, the GPL or the LGPL.
+
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+
+#include "sqlite3.h"
+#include "spatialite.h"
+
+#include <spatialite/gaiageo.h>
+
+/*
+/ the metadata SQL functions read a regular BLOB-Geometry through a
+/ read-only view, falling back to the full decoder for anything else
+/
+/ any BLOB is checked against the same BLOB decoded and then encoded
+/ again, so that the view never comes into play for the decoded value;
+/ truncated and corrupted BLOBs are checked in the same way whenever the
+/ view accepts them, and must return NULL whenever the decoder rejects
+/ them
+*/
+
+static const char *geometries[] = {
+    "GeomFromText('POINT(1.5 2.5)', 4326)",
+    "GeomFromText('POINT Z(1.5 2.5 3.5)', 4326)",
+    "GeomFromText('POINT M(1.5 2.5 4.5)', 4326)",
+    "GeomFromText('POINT ZM(1.5 2.5 3.5 4.5)', 4326)",
+    "GeomFromText('LINESTRING(1 1, 2 2.5, 3 1, 4 4)', 4326)",
+    "GeomFromText('LINESTRING Z(1 1 1, 2 2.5 2, 3 1 3, 4 4 4)', 4326)",
+    "GeomFromText('LINESTRING M(1 1 1, 2 2.5 2, 3 1 3, 4 4 4)', 4326)",
+    "GeomFromText('LINESTRING ZM(1 1 1 5, 2 2.5 2 6, 3 1 3 7, 4 4 4 8)', 4326)",
+    "GeomFromText('POLYGON((0 0, 10 0, 10 10, 0 10, 0 0), (2 2, 3 2, 3 3, 2 3, 2 2))', 4326)",
+    "GeomFromText('POLYGON Z((0 0 1, 10 0 1, 10 10 1, 0 10 1, 0 0 1))', 4326)",
+    "GeomFromText('MULTIPOINT(1 1, 2 2, 3 3)', 4326)",
+    "GeomFromText('MULTILINESTRING((1 1, 2 2), (3 3, 4 4, 5 5))', 4326)",
+    "GeomFromText('MULTIPOLYGON(((0 0, 1 0, 1 1, 0 0)), ((5 5, 6 5, 6 6, 5 5)))', 4326)",
+    "GeomFromText('GEOMETRYCOLLECTION(POINT(1 1), LINESTRING(1 1, 2 2, 3 3))', 4326)",
+    "CompressGeometry(GeomFromText('LINESTRING(1 1, 2 2.5, 3 1, 4 4)', 4326))",
+    "CompressGeometry(GeomFromText('LINESTRING ZM(1 1 1 5, 2 2.5 2 6, 3 1 3 7, 4 4 4 8)', 4326))",
+    "CompressGeometry(GeomFromText('POLYGON M((0 0 1, 10 0 2, 10 10 3, 0 10 4, 0 0 5))', 4326))",
+    "MakePoint(1.5, 2.5, 4326)",
+    "MakePointZM(1.5, 2.5, 3.5, 4.5, 4326)",
+    NULL
+};
+
+/* the SQL functions reading the BLOB through the view */
+#define CONVERTED	13
+
+static const char *functions =
+    "SELECT GeometryType(?1), X(?1), Y(?1), Z(?1), M(?1), NumPoints(?1), "
+    "ST_NPoints(?1), ST_NRings(?1), NumGeometries(?1), NumInteriorRings(?1), "
+    "AsText(StartPoint(?1)), AsText(EndPoint(?1)), AsText(PointN(?1, 2)), "
+    "SRID(?1), CoordDimension(?1), MbrMinX(?1), MbrMinY(?1), MbrMaxX(?1), "
+    "MbrMaxY(?1)";
+
+static int
+eval_functions (sqlite3_stmt * stmt, const unsigned char *blob, int size,
+		char **values)
+{
+/* evaluating all the SQL functions on some BLOB */
+    int ret;
+    int i;
+    sqlite3_reset (stmt);
+    sqlite3_clear_bindings (stmt);
+    sqlite3_bind_blob (stmt, 1, blob, size, SQLITE_STATIC);
+    ret = sqlite3_step (stmt);
+    if (ret != SQLITE_ROW)
+	return 0;
+    for (i = 0; i < sqlite3_column_count (stmt); i++)
+      {
+	  if (sqlite3_column_type (stmt, i) == SQLITE_NULL)
+	      values[i] = sqlite3_mprintf ("(NULL)");
+	  else
+	      values[i] =
+		  sqlite3_mprintf ("%s", sqlite3_column_text (stmt, i));
+      }
+    return 1;
+}
+
+static void
+free_values (char **values, int count)
+{
+/* memory cleanup */
+    int i;
+    for (i = 0; i < count; i++)
+      {
+	  sqlite3_free (values[i]);
+	  values[i] = NULL;
+      }
+}
+
+static int
+compare_view (gaiaBlobViewPtr view, gaiaGeomCollPtr geo)
+{
+/* checking a view against the decoded Geometry */
+    gaiaPointPtr pt;
+    gaiaLinestringPtr ln;
+    gaiaPolygonPtr pg;
+    int points = 0;
+    int lines = 0;
+    int polygs = 0;
+    int rings = 0;
+    int vertices = 0;
+    int n;
+    int iv;
+    int ib;
+    double x;
+    double y;
+    double z;
+    double m;
+    if (gaiaBlobViewGeometryType (view) != gaiaGeometryType (geo))
+	return 0;
+    if (view->Srid != geo->Srid || view->DimensionModel != geo->DimensionModel)
+	return 0;
+    pt = geo->FirstPoint;
+    while (pt)
+      {
+	  if (!gaiaBlobViewGetPoint (view, points, &x, &y, &z, &m))
+	      return 0;
+	  if (x != pt->X || y != pt->Y || z != pt->Z || m != pt->M)
+	      return 0;
+	  points++;
+	  vertices++;
+	  pt = pt->Next;
+      }
+    ln = geo->FirstLinestring;
+    while (ln)
+      {
+	  if (!gaiaBlobViewGetLinestring (view, lines, &n) || n != ln->Points)
+	      return 0;
+	  for (iv = 0; iv < ln->Points; iv++)
+	    {
+		double lx;
+		double ly;
+		double lz = 0.0;
+		double lm = 0.0;
+		if (ln->DimensionModel == GAIA_XY_Z)
+		  {
+		      gaiaGetPointXYZ (ln->Coords, iv, &lx, &ly, &lz);
+		  }
+		else if (ln->DimensionModel == GAIA_XY_M)
+		  {
+		      gaiaGetPointXYM (ln->Coords, iv, &lx, &ly, &lm);
+		  }
+		else if (ln->DimensionModel == GAIA_XY_Z_M)
+		  {
+		      gaiaGetPointXYZM (ln->Coords, iv, &lx, &ly, &lz, &lm);
+		  }
+		else
+		  {
+		      gaiaGetPoint (ln->Coords, iv, &lx, &ly);
+		  }
+		if (!gaiaBlobViewGetLinestringVertex
+		    (view, lines, iv, &x, &y, &z, &m))
+		    return 0;
+		if (x != lx || y != ly || z != lz || m != lm)
+		    return 0;
+	    }
+	  lines++;
+	  vertices += ln->Points;
+	  ln = ln->Next;
+      }
+    pg = geo->FirstPolygon;
+    while (pg)
+      {
+	  if (!gaiaBlobViewGetPolygon (view, polygs, &n)
+	      || n != pg->NumInteriors)
+	      return 0;
+	  vertices += pg->Exterior->Points;
+	  for (ib = 0; ib < pg->NumInteriors; ib++)
+	      vertices += (pg->Interiors + ib)->Points;
+	  polygs++;
+	  rings += 1 + pg->NumInteriors;
+	  pg = pg->Next;
+      }
+    if (view->NumPoints != points || view->NumLinestrings != lines
+	|| view->NumPolygons != polygs || view->NumRings != rings
+	|| view->NumVertices != vertices)
+	return 0;
+    return 1;
+}
+
+static int
+check_blob (sqlite3_stmt * stmt, const unsigned char *blob, int size,
+	    int regular)
+{
+/*
+/ checking a BLOB against the same BLOB decoded and encoded again
+/ (all the SQL functions for regular BLOBs, otherwise just the
+/ converted ones)
+/
+/ returns 0 on success, a negative value on failure
+*/
+    gaiaGeomCollPtr geo;
+    gaiaBlobView view;
+    int view_ok;
+    unsigned char *ref = NULL;
+    int ref_size;
+    char *values[32];
+    char *ref_values[32];
+    int count = regular ? sqlite3_column_count (stmt) : CONVERTED;
+    int retcode = 0;
+    int i;
+
+    geo = gaiaFromSpatiaLiteBlobWkb (blob, size);
+    view_ok = gaiaBlobViewInit (&view, blob, size);
+    if (regular && (geo == NULL || !view_ok))
+      {
+	  fprintf (stderr, "a regular BLOB has been rejected\n");
+	  retcode = -1;
+	  goto end;
+      }
+    if (view_ok)
+      {
+	  if (geo == NULL)
+	    {
+		fprintf (stderr,
+			 "the view accepted a BLOB rejected by the decoder\n");
+		retcode = -2;
+		goto end;
+	    }
+	  if (!compare_view (&view, geo))
+	    {
+		fprintf (stderr, "the view mismatches the decoded Geometry\n");
+		retcode = -3;
+		goto end;
+	    }
+      }
+
+    if (!eval_functions (stmt, blob, size, values))
+      {
+	  fprintf (stderr, "unable to evaluate the SQL functions\n");
+	  retcode = -4;
+	  goto end;
+      }
+    if (geo == NULL)
+      {
+	  /* any converted function is expected to return NULL */
+	  for (i = 0; i < CONVERTED; i++)
+	    {
+		if (strcmp (values[i], "(NULL)") != 0)
+		  {
+		      fprintf (stderr,
+			       "column #%d: unexpected %s from a broken BLOB\n",
+			       i, values[i]);
+		      retcode = -5;
+		  }
+	    }
+	  free_values (values, sqlite3_column_count (stmt));
+	  goto end;
+      }
+    if (!view_ok)
+      {
+	  /* the SQL functions have been falling back to the decoder */
+	  free_values (values, sqlite3_column_count (stmt));
+	  goto end;
+      }
+    gaiaToSpatiaLiteBlobWkb (geo, &ref, &ref_size);
+    if (ref == NULL)
+      {
+	  fprintf (stderr, "the view accepted an empty Geometry\n");
+	  free_values (values, sqlite3_column_count (stmt));
+	  retcode = -8;
+	  goto end;
+      }
+    if (!eval_functions (stmt, ref, ref_size, ref_values))
+      {
+	  fprintf (stderr, "unable to evaluate the SQL functions\n");
+	  free_values (values, sqlite3_column_count (stmt));
+	  retcode = -6;
+	  goto end;
+      }
+    for (i = 0; i < count; i++)
+      {
+	  if (strcmp (values[i], ref_values[i]) != 0)
+	    {
+		fprintf (stderr, "column #%d: got %s, decoder %s\n", i,
+			 values[i], ref_values[i]);
+		retcode = -7;
+	    }
+      }
+    free_values (values, sqlite3_column_count (stmt));
+    free_values (ref_values, sqlite3_column_count (stmt));
+
+  end:
+    if (geo != NULL)
+	gaiaFreeGeomColl (geo);
+    if (ref != NULL)
+	free (ref);
+    return retcode;
+}
+
+static int
+check_geometry (sqlite3 * handle, sqlite3_stmt * stmt, const char *expr)
+{
+/* checking some Geometry, then all its truncated and corrupted versions */
+    sqlite3_stmt *stmt_blob;
+    unsigned char *blob;
+    unsigned char *broken;
+    int size;
+    int ret;
+    int len;
+    int pos;
+    int im;
+    char *sql;
+    static const unsigned char masks[] = { 0x01, 0x10, 0x80, 0xff };
+
+    sql = sqlite3_mprintf ("SELECT %s", expr);
+    ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt_blob, NULL);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "%s: %s\n", expr, sqlite3_errmsg (handle));
+	  return -1;
+      }
+    if (sqlite3_step (stmt_blob) != SQLITE_ROW
+	|| sqlite3_column_type (stmt_blob, 0) != SQLITE_BLOB)
+      {
+	  fprintf (stderr, "%s: not a BLOB\n", expr);
+	  sqlite3_finalize (stmt_blob);
+	  return -1;
+      }
+    size = sqlite3_column_bytes (stmt_blob, 0);
+    blob = malloc (size);
+    broken = malloc (size);
+    memcpy (blob, sqlite3_column_blob (stmt_blob, 0), size);
+    sqlite3_finalize (stmt_blob);
+
+    ret = check_blob (stmt, blob, size, 1);
+    if (ret != 0)
+      {
+	  fprintf (stderr, "%s: regular BLOB\n", expr);
+	  goto end;
+      }
+    for (len = 0; len < size; len++)
+      {
+	  /* truncated BLOBs */
+	  ret = check_blob (stmt, blob, len, 0);
+	  if (ret != 0)
+	    {
+		fprintf (stderr, "%s: truncated at %d bytes\n", expr, len);
+		goto end;
+	    }
+      }
+    for (pos = 0; pos < size; pos++)
+      {
+	  /* corrupted BLOBs */
+	  for (im = 0; im < (int) sizeof (masks); im++)
+	    {
+		memcpy (broken, blob, size);
+		broken[pos] ^= masks[im];
+		ret = check_blob (stmt, broken, size, 0);
+		if (ret != 0)
+		  {
+		      fprintf (stderr, "%s: byte %d XOR 0x%02x\n", expr, pos,
+			       masks[im]);
+		      goto end;
+		  }
+	    }
+      }
+
+  end:
+    free (blob);
+    free (broken);
+    return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+    int ret;
+    sqlite3 *handle;
+    sqlite3_stmt *stmt;
+    char *err_msg = NULL;
+    int i;
+    void *cache = spatialite_alloc_connection ();
+
+    if (argc > 1 || argv[0] == NULL)
+	argc = 1;		/* silencing stupid compiler warnings */
+
+    ret =
+	sqlite3_open_v2 (":memory:", &handle,
+			 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "cannot open in-memory database: %s\n",
+		   sqlite3_errmsg (handle));
+	  sqlite3_close (handle);
+	  return -1;
+      }
+
+    spatialite_init_ex (handle, cache, 0);
+
+    ret = sqlite3_exec (handle, "SELECT EnableTinyPoint()", NULL, NULL,
+			&err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "EnableTinyPoint() error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -2;
+      }
+
+    ret =
+	sqlite3_prepare_v2 (handle, functions, strlen (functions), &stmt,
+			    NULL);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "SQL error: %s\n", sqlite3_errmsg (handle));
+	  sqlite3_close (handle);
+	  return -3;
+      }
+    for (i = 0; geometries[i] != NULL; i++)
+      {
+	  ret = check_geometry (handle, stmt, geometries[i]);
+	  if (ret != 0)
+	    {
+		sqlite3_finalize (stmt);
+		sqlite3_close (handle);
+		return -10 - i;
+	    }
+      }
+    sqlite3_finalize (stmt);
+
+    ret = sqlite3_close (handle);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "sqlite3_close() error: %s\n",
+		   sqlite3_errmsg (handle));
+	  return -4;
+      }
+
+    spatialite_cleanup_ex (cache);
+    spatialite_shutdown ();
+
+    return 0;
+}
@@ -64,6 +64,12 @@ main (int argc, char *argv[])
     sqlite3_int64 i64_val;
     float flt_val;
     double dbl_val;
+    unsigned char arr_in[8 * 7];
+    unsigned char arr_out[8 * 7];
+    double dbl_arr[7];
+    int i;
+    int little_endian;
+    int little_endian_arch;
 
     if (argc > 1 || argv[0] == NULL)
 	argc = 1;		/* silencing stupid compiler warnings */
@@ -422,6 +428,39 @@ main (int argc, char *argv[])
 	  return -30;
       }
 
+/* testing double arrays: must match the single value functions */
+    for (i = 0; i < 8 * 7; i++)
+	arr_in[i] = (unsigned char) ((i * 37) + 11);
+    for (i = 0; i < 4; i++)
+      {
+	  int iv;
+	  little_endian = i & 1;
+	  little_endian_arch = (i >> 1) & 1;
+	  gaiaImport64Array (dbl_arr, arr_in, 7, little_endian,
+			     little_endian_arch);
+	  for (iv = 0; iv < 7; iv++)
+	    {
+		dbl_val =
+		    gaiaImport64 (arr_in + (iv * 8), little_endian,
+				  little_endian_arch);
+		if (memcmp (&dbl_val, dbl_arr + iv, sizeof (double)) != 0)
+		  {
+		      fprintf (stderr,
+			       "endian DOUBLE array (%d): mismatching import #%d\n",
+			       i, iv);
+		      return -31;
+		  }
+	    }
+	  gaiaExport64Array (arr_out, dbl_arr, 7, little_endian,
+			     little_endian_arch);
+	  if (memcmp (arr_in, arr_out, 8 * 7) != 0)
+	    {
+		fprintf (stderr,
+			 "endian DOUBLE array (%d): mismatching export\n", i);
+		return -32;
+	    }
+      }
+
     spatialite_shutdown ();
     return 0;
 }
@@ -0,0 +1,359 @@
+/*
+
+ check_geom_arena.c -- SpatiaLite Test Case
+
+ Author: Sandro Furieri <a.furieri@lqt.it>
+
+ ------------------------------------------------------------------------------
+
+ Version: MPL 1.1/GPL 2.0/LGPL 2.1
+
+ The contents of this file are subject to the Mozilla Public License Version
+ 1.1 (the "License"); you may not use this file except in compliance with
+ the License. You may obtain a copy of the License at
+ http://www.mozilla.org/MPL/
+
+Software distributed under the License is distributed on an "AS IS" basis,
+WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+for the specific language governing rights and limitations under the
+License.
+
+The Original Code is the SpatiaLite library
+
+The Initial Developer of the Original Code is Alessandro Furieri
+
+Portions created by the Initial Developer are Copyright (C) 2011
+the Initial Developer. All Rights Reserved.
+
+Contributor(s):
+
+Alternatively, the contents of this file may be used under the terms of
+either the GNU General Public License Version 2 or later (the "GPL"), or
+the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+in which case the provisions of the GPL or the LGPL are applicable instead
+of those above. If you wish to allow use of your version of this file only
+under the terms of either the GPL or the LGPL, and not to allow others to
+use your version of this file under the terms of the MPL, indicate your
+decision by deleting the provisions above and replace them with the notice
+and other provisions required by the GPL or the LGPL. If you do not delete
+the provisions above, a recipient may use your version of this file under
+the terms of any one of the MPL, the GPL or the LGPL.
+
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+
+#include "sqlite3.h"
+#include "spatialite.h"
+
+#include <spatialite/gaiageo.h>
+
+/*
+/ the read-only SQL functions decode their input Geometry into a memory
+/ arena: their results are checked against the same output notations
+/ computed on the same BLOB decoded by the ordinary heap allocator
+/
+/ every Geometry is checked as a plain BLOB, as a compressed BLOB and
+/ (when supported) as a GPKG BLOB; POINTs are TinyPoint BLOBs, and a big
+/ MULTIPOINT needs more than a single arena chunk
+*/
+
+static const char *geometries[] = {
+    "GeomFromText('POINT(1.5 2.5)', 4326)",
+    "GeomFromText('POINT Z(1.5 2.5 3.5)', 4326)",
+    "GeomFromText('POINT M(1.5 2.5 4.5)', 4326)",
+    "GeomFromText('POINT ZM(1.5 2.5 3.5 4.5)', 4326)",
+    "GeomFromText('LINESTRING(1 1, 2 2.5, 3 1, 4 4)', 4326)",
+    "GeomFromText('LINESTRING Z(1 1 1, 2 2.5 2, 3 1 3, 4 4 4)', 4326)",
+    "GeomFromText('LINESTRING M(1 1 1, 2 2.5 2, 3 1 3, 4 4 4)', 4326)",
+    "GeomFromText('LINESTRING ZM(1 1 1 5, 2 2.5 2 6, 3 1 3 7, 4 4 4 8)', 4326)",
+    "GeomFromText('POLYGON((0 0, 10 0, 10 10, 0 10, 0 0), (2 2, 3 2, 3 3, 2 3, 2 2), (5 5, 6 5, 6 6, 5 6, 5 5))', 4326)",
+    "GeomFromText('POLYGON Z((0 0 1, 10 0 1, 10 10 1, 0 10 1, 0 0 1), (2 2 2, 3 2 2, 3 3 2, 2 2 2))', 4326)",
+    "GeomFromText('POLYGON M((0 0 1, 10 0 2, 10 10 3, 0 10 4, 0 0 5))', 4326)",
+    "GeomFromText('POLYGON ZM((0 0 1 9, 10 0 1 8, 10 10 1 7, 0 0 1 9), (1 1 2 6, 2 1 2 5, 2 2 2 4, 1 1 2 6))', 4326)",
+    "GeomFromText('MULTIPOINT(1 1, 2 2, 3 3)', 4326)",
+    "GeomFromText('MULTIPOINT Z(1 1 1, 2 2 2, 3 3 3)', 4326)",
+    "GeomFromText('MULTILINESTRING((1 1, 2 2), (3 3, 4 4, 5 5))', 4326)",
+    "GeomFromText('MULTILINESTRING M((1 1 1, 2 2 2), (3 3 3, 4 4 4, 5 5 5))', 4326)",
+    "GeomFromText('MULTIPOLYGON(((0 0, 1 0, 1 1, 0 0)), ((5 5, 9 5, 9 9, 5 5), (6 5.5, 8 5.5, 8 7, 6 5.5)))', 4326)",
+    "GeomFromText('MULTIPOLYGON ZM(((0 0 1 2, 1 0 1 2, 1 1 1 2, 0 0 1 2)), ((5 5 3 4, 6 5 3 4, 6 6 3 4, 5 5 3 4)))', 4326)",
+    "GeomFromText('GEOMETRYCOLLECTION(POINT(1 1), LINESTRING(1 1, 2 2, 3 3), POLYGON((0 0, 1 0, 1 1, 0 0)))', 4326)",
+    "GeomFromText('GEOMETRYCOLLECTION Z(POINT Z(1 1 1), LINESTRING Z(1 1 1, 2 2 2), POLYGON Z((0 0 0, 1 0 0, 1 1 0, 0 0 0)))', 4326)",
+    NULL
+};
+
+static const char *encodings[] = {
+    "SELECT %s",
+    "SELECT CompressGeometry(%s)",
+#ifdef ENABLE_GEOPACKAGE	/* GEOPACKAGE enabled: supporting GPKG geometries */
+    "SELECT AsGPB(%s)",
+#endif /* end GEOPACKAGE: supporting GPKG geometries */
+    NULL
+};
+
+/* the SQL functions decoding the BLOB into an arena */
+#define TEXT_FUNCTIONS	6
+
+static const char *functions =
+    "SELECT AsText(?1), AsWkt(?1), AsEWKT(?1), AsGeoJSON(?1), AsGml(3, ?1), "
+    "AsSvg(?1, 1, 6), AsBinary(?1)";
+
+static void
+expected_text (gaiaGeomCollPtr geo, int which, gaiaOutBufferPtr out_buf)
+{
+/* formatting a Geometry decoded by the heap allocator */
+    switch (which)
+      {
+      case 0:
+	  gaiaOutWkt (out_buf, geo);
+	  break;
+      case 1:
+	  gaiaOutWktStrict (out_buf, geo, 15);
+	  break;
+      case 2:
+	  gaiaToEWKT (out_buf, geo);
+	  break;
+      case 3:
+	  gaiaOutGeoJSON (out_buf, geo, 15, 0);
+	  break;
+      case 4:
+	  gaiaOutGml (out_buf, 3, 15, geo);
+	  break;
+      case 5:
+	  gaiaOutSvg (out_buf, geo, 1, 6);
+	  break;
+      };
+}
+
+static int
+check_blob (sqlite3_stmt * stmt, const unsigned char *blob, int size,
+	    const char *title)
+{
+/* checking the SQL functions against the heap decoder */
+    int ret;
+    int i;
+    int ok = 1;
+    gaiaGeomCollPtr geo;
+    unsigned char *wkb = NULL;
+    int wkb_size;
+
+    geo = gaiaFromSpatiaLiteBlobWkbEx (blob, size, 0, 1);
+    if (geo == NULL)
+      {
+	  fprintf (stderr, "%s: unable to decode\n", title);
+	  return 0;
+      }
+    sqlite3_reset (stmt);
+    sqlite3_clear_bindings (stmt);
+    sqlite3_bind_blob (stmt, 1, blob, size, SQLITE_STATIC);
+    ret = sqlite3_step (stmt);
+    if (ret != SQLITE_ROW)
+      {
+	  fprintf (stderr, "%s: SQL error\n", title);
+	  gaiaFreeGeomColl (geo);
+	  return 0;
+      }
+    for (i = 0; i < TEXT_FUNCTIONS; i++)
+      {
+	  const char *value = (const char *) sqlite3_column_text (stmt, i);
+	  gaiaOutBuffer out_buf;
+	  gaiaOutBufferInitialize (&out_buf);
+	  expected_text (geo, i, &out_buf);
+	  if (out_buf.Error || out_buf.Buffer == NULL || value == NULL
+	      || strcmp (out_buf.Buffer, value) != 0)
+	    {
+		fprintf (stderr, "%s: unexpected result #%d\n%s\n%s\n", title,
+			 i, (value == NULL) ? "(NULL)" : value,
+			 (out_buf.Buffer == NULL) ? "(NULL)" : out_buf.Buffer);
+		ok = 0;
+	    }
+	  gaiaOutBufferReset (&out_buf);
+      }
+    gaiaToWkb (geo, &wkb, &wkb_size);
+    if (wkb == NULL || sqlite3_column_type (stmt, TEXT_FUNCTIONS) != SQLITE_BLOB
+	|| sqlite3_column_bytes (stmt, TEXT_FUNCTIONS) != wkb_size
+	|| memcmp (sqlite3_column_blob (stmt, TEXT_FUNCTIONS), wkb,
+		   wkb_size) != 0)
+      {
+	  fprintf (stderr, "%s: unexpected AsBinary result\n", title);
+	  ok = 0;
+      }
+    if (wkb != NULL)
+	free (wkb);
+    gaiaFreeGeomColl (geo);
+    return ok;
+}
+
+static int
+check_geometry (sqlite3 * handle, sqlite3_stmt * stmt, const char *geometry)
+{
+/* checking a Geometry in any encoding */
+    int ret;
+    int e;
+    for (e = 0; encodings[e] != NULL; e++)
+      {
+	  sqlite3_stmt *stmt_enc;
+	  char *sql = sqlite3_mprintf (encodings[e], geometry);
+	  ret = sqlite3_prepare_v2 (handle, sql, -1, &stmt_enc, NULL);
+	  sqlite3_free (sql);
+	  if (ret != SQLITE_OK)
+	    {
+		fprintf (stderr, "SQL error: %s\n", sqlite3_errmsg (handle));
+		return 0;
+	    }
+	  ret = sqlite3_step (stmt_enc);
+	  if (ret != SQLITE_ROW
+	      || sqlite3_column_type (stmt_enc, 0) != SQLITE_BLOB)
+	    {
+		fprintf (stderr, "unable to encode #%d: %.64s\n", e, geometry);
+		sqlite3_finalize (stmt_enc);
+		return 0;
+	    }
+	  ret =
+	      check_blob (stmt, sqlite3_column_blob (stmt_enc, 0),
+			  sqlite3_column_bytes (stmt_enc, 0), geometry);
+	  sqlite3_finalize (stmt_enc);
+	  if (!ret)
+	      return 0;
+      }
+    return 1;
+}
+
+static char *
+big_geometry (int polygon, int points)
+{
+/* a big MULTIPOINT or POLYGON (many vertices and a few holes) */
+    int i;
+    int h;
+    char *geometry;
+    gaiaOutBuffer out_buf;
+    gaiaOutBufferInitialize (&out_buf);
+    if (polygon)
+	gaiaAppendToOutBuffer (&out_buf,
+			       "GeomFromText('POLYGON Z((0 0 0, 1000 0 0");
+    else
+	gaiaAppendToOutBuffer (&out_buf, "GeomFromText('MULTIPOINT Z(0 0 0");
+    for (i = 1; i < points; i++)
+      {
+	  char *pt = sqlite3_mprintf (", %d %d.5 %d", i, i % 97, i % 13);
+	  if (polygon)
+	    {
+		sqlite3_free (pt);
+		pt = sqlite3_mprintf (", %d %d %d", 1000 - (i % 2),
+				      i * 10, i % 13);
+	    }
+	  gaiaAppendToOutBuffer (&out_buf, pt);
+	  sqlite3_free (pt);
+      }
+    if (polygon)
+      {
+	  char *ring = sqlite3_mprintf (", 0 %d 0, 0 0 0)", points * 10);
+	  gaiaAppendToOutBuffer (&out_buf, ring);
+	  sqlite3_free (ring);
+	  for (h = 0; h < 4; h++)
+	    {
+		int y = (h + 1) * 100;
+		ring =
+		    sqlite3_mprintf (", (10 %d 1, 20 %d 1, 20 %d 1, 10 %d 1)",
+				     y, y, y + 10, y);
+		gaiaAppendToOutBuffer (&out_buf, ring);
+		sqlite3_free (ring);
+	    }
+	  gaiaAppendToOutBuffer (&out_buf, ")', 4326)");
+      }
+    else
+	gaiaAppendToOutBuffer (&out_buf, ")', 4326)");
+    geometry = sqlite3_mprintf ("%s", out_buf.Buffer);
+    gaiaOutBufferReset (&out_buf);
+    return geometry;
+}
+
+int
+main (int argc, char *argv[])
+{
+    int ret;
+    sqlite3 *handle;
+    sqlite3_stmt *stmt;
+    char *err_msg = NULL;
+    char *geometry;
+    int i;
+    void *cache = spatialite_alloc_connection ();
+
+    if (argc > 1 || argv[0] == NULL)
+	argc = 1;		/* silencing stupid compiler warnings */
+
+    ret =
+	sqlite3_open_v2 (":memory:", &handle,
+			 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "cannot open in-memory database: %s\n",
+		   sqlite3_errmsg (handle));
+	  sqlite3_close (handle);
+	  return -1;
+      }
+
+    spatialite_init_ex (handle, cache, 0);
+
+    ret =
+	sqlite3_exec (handle,
+		      "SELECT EnableTinyPoint(), EnableGpkgAmphibiousMode()",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "EnableTinyPoint() error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -2;
+      }
+
+    ret =
+	sqlite3_prepare_v2 (handle, functions, strlen (functions), &stmt,
+			    NULL);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "SQL error: %s\n", sqlite3_errmsg (handle));
+	  sqlite3_close (handle);
+	  return -3;
+      }
+    for (i = 0; geometries[i] != NULL; i++)
+      {
+	  if (!check_geometry (handle, stmt, geometries[i]))
+	    {
+		sqlite3_finalize (stmt);
+		sqlite3_close (handle);
+		return -10 - i;
+	    }
+      }
+
+/* big Geometries: the MULTIPOINT needs further arena chunks */
+    for (i = 0; i < 2; i++)
+      {
+	  geometry = big_geometry (i, 5000);
+	  ret = check_geometry (handle, stmt, geometry);
+	  sqlite3_free (geometry);
+	  if (!ret)
+	    {
+		sqlite3_finalize (stmt);
+		sqlite3_close (handle);
+		return -5 - i;
+	    }
+      }
+    sqlite3_finalize (stmt);
+
+    ret = sqlite3_close (handle);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "sqlite3_close() error: %s\n",
+		   sqlite3_errmsg (handle));
+	  return -4;
+      }
+
+    spatialite_cleanup_ex (cache);
+    spatialite_shutdown ();
+
+    return 0;
+}
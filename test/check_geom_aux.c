@@ -44,12 +44,85 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <float.h>
+#include <math.h>
 
 #include "sqlite3.h"
 #include "spatialite.h"
 
 #include <spatialite/gaiageo.h>
 
+static int
+check_shortest (double value, const char *expected)
+{
+/* checking the shortest round-trip format of a double */
+    gaiaOutBuffer buf;
+    double back;
+    int ok = 1;
+    gaiaOutBufferInitialize (&buf);
+    gaiaAppendDoubleToOutBuffer (&buf, value, GAIA_PRECISION_SHORTEST);
+    if (buf.Error || buf.Buffer == NULL)
+      {
+	  fprintf (stderr, "Shortest %1.17g: unable to format\n", value);
+	  return 0;
+      }
+    back = strtod (buf.Buffer, NULL);
+    if (value == 0.0)
+      {
+	  /* negative zeroes are always printed as plain zeroes */
+	  if (back != 0.0 || strcmp (buf.Buffer, "0") != 0)
+	      ok = 0;
+      }
+    else if (memcmp (&back, &value, sizeof (double)) != 0)
+	ok = 0;
+    if (expected != NULL && strcmp (buf.Buffer, expected) != 0)
+	ok = 0;
+    if (!ok)
+	fprintf (stderr, "Shortest %1.17g: unexpected result %s|\n", value,
+		 buf.Buffer);
+    gaiaOutBufferReset (&buf);
+    return ok;
+}
+
+static int
+test_shortest (void)
+{
+/* shortest round-trip formatting */
+    char expected[512];
+    int i;
+    if (!check_shortest (0.1, "0.1"))
+	return -55;
+    if (!check_shortest (0.1 + 0.2, "0.30000000000000004"))
+	return -56;
+    strcpy (expected, "1");
+    for (i = 0; i < 23; i++)
+	strcat (expected, "0");
+    if (!check_shortest (1e23, expected))
+	return -57;
+    strcpy (expected, "0.");
+    for (i = 0; i < 323; i++)
+	strcat (expected, "0");
+    strcat (expected, "5");
+    if (!check_shortest (5e-324, expected))
+	return -58;
+    if (!check_shortest (-0.0, "0"))
+	return -59;
+    if (!check_shortest (DBL_MIN, NULL))
+	return -60;
+    strcpy (expected, "17976931348623157");
+    for (i = 0; i < 292; i++)
+	strcat (expected, "0");
+    if (!check_shortest (DBL_MAX, expected))
+	return -61;
+    if (!check_shortest (-DBL_MAX, NULL))
+	return -62;
+    if (!check_shortest (nextafter (DBL_MAX, 0.0), NULL))
+	return -63;
+    if (!check_shortest (123456.789e-7, "0.0123456789"))
+	return -64;
+    return 0;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -1050,6 +1123,10 @@ main (int argc, char *argv[])
     gaiaFreePolygon (polyg2);
     gaiaFreePolygon (polyg1);
 
+    ret = test_shortest ();
+    if (ret != 0)
+	return ret;
+
     ret = sqlite3_close (handle);
     if (ret != SQLITE_OK)
       {
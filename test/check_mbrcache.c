@@ -44,12 +44,255 @@ the terms of any one of the MPL, the GPL or the LGPL.
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "config.h"
 
 #include "sqlite3.h"
 #include "spatialite.h"
 
+#ifndef OMIT_ICONV		/* only if ICONV is supported */
+static int
+check_sidecar_cache (sqlite3 * handle, const char *vtable)
+{
+/* checking an MbrCache against the main table */
+    int ret;
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    int ok = 1;
+    char *sql;
+    sql =
+	sqlite3_mprintf
+	("SELECT (SELECT Count(*) FROM \"%s\" WHERE mbr = FilterMbrIntersects(11.2, 43.2, 11.6, 43.6)), "
+	 "(SELECT Count(*) FROM pt WHERE MbrIntersects(g, BuildMbr(11.2, 43.2, 11.6, 43.6))), "
+	 "(SELECT Count(*) FROM \"%s\"), (SELECT Count(*) FROM pt WHERE g IS NOT NULL)",
+	 vtable, vtable);
+    ret = sqlite3_get_table (handle, sql, &results, &rows, &columns, &err_msg);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error in sidecar SELECT: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return 0;
+      }
+    if (rows != 1 || columns != 4 || strcmp (results[4], results[5]) != 0
+	|| strcmp (results[6], results[7]) != 0)
+      {
+	  fprintf (stderr, "unexpected %s result: %s %s %s %s\n", vtable,
+		   results[4], results[5], results[6], results[7]);
+	  ok = 0;
+      }
+    sqlite3_free_table (results);
+    return ok;
+}
+
+static int
+count_generation_objects (sqlite3 * handle)
+{
+/* counting the generation triggers and table left in sqlite_master */
+    int ret;
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    int count = -1;
+    ret =
+	sqlite3_get_table (handle,
+			   "SELECT Count(*) FROM sqlite_master WHERE "
+			   "(type = 'trigger' AND name LIKE 'mcg%') "
+			   "OR name = 'mbrcache_generations'", &results, &rows,
+			   &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error in sqlite_master SELECT: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -1;
+      }
+    if (rows == 1 && columns == 1 && results[1] != NULL)
+	count = atoi (results[1]);
+    sqlite3_free_table (results);
+    return count;
+}
+
+static int
+test_sidecar (sqlite3 * handle)
+{
+/* MbrCache saved on a sidecar file */
+    int ret;
+    int retcode = 0;
+    char *err_msg = NULL;
+    int pt;
+    char *old_SPATIALITE_SECURITY_ENV = getenv ("SPATIALITE_SECURITY");
+#ifdef _WIN32
+    char *env;
+    putenv ("SPATIALITE_SECURITY=relaxed");
+#else /* not WIN32 */
+    setenv ("SPATIALITE_SECURITY", "relaxed", 1);
+#endif
+
+    for (pt = 0; pt < 2; pt++)
+      {
+	  /* the second time the sidecar file is simply mapped */
+	  char sql[1024];
+	  sprintf (sql,
+		   "CREATE VIRTUAL TABLE side_pt_%d USING MbrCache(pt, g, 'mbrcache_pt.side');",
+		   pt);
+	  ret = sqlite3_exec (handle, sql, NULL, NULL, &err_msg);
+	  if (ret != SQLITE_OK)
+	    {
+		fprintf (stderr, "CREATE VIRTUAL TABLE side_pt error: %s\n",
+			 err_msg);
+		sqlite3_free (err_msg);
+		retcode = -63;
+		goto end;
+	    }
+	  sprintf (sql, "side_pt_%d", pt);
+	  if (!check_sidecar_cache (handle, sql))
+	    {
+		retcode = -64;
+		goto end;
+	    }
+      }
+    if (access ("mbrcache_pt.side", F_OK) != 0)
+      {
+	  fprintf (stderr, "the sidecar file has not been saved\n");
+	  retcode = -65;
+	  goto end;
+      }
+
+/* changes not affecting Max(ROWID) must invalidate the sidecar file */
+    ret =
+	sqlite3_exec (handle,
+		      "UPDATE pt SET g = MakePoint(20.0, 50.0, 4326) WHERE id BETWEEN 3000 AND 3099; "
+		      "DELETE FROM pt WHERE id BETWEEN 3100 AND 3199;", NULL,
+		      NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "UPDATE/DELETE pt error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  retcode = -66;
+	  goto end;
+      }
+    ret =
+	sqlite3_exec (handle,
+		      "CREATE VIRTUAL TABLE side_pt_2 USING MbrCache(pt, g, 'mbrcache_pt.side');",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "CREATE VIRTUAL TABLE side_pt_2 error: %s\n",
+		   err_msg);
+	  sqlite3_free (err_msg);
+	  retcode = -67;
+	  goto end;
+      }
+    if (!check_sidecar_cache (handle, "side_pt_2"))
+      {
+	  retcode = -68;
+	  goto end;
+      }
+
+/* a stale cache must never overwrite the sidecar file */
+    ret =
+	sqlite3_exec (handle,
+		      "INSERT INTO side_pt_0 (rowid, mbr) VALUES (100000, BuildMbrFilter(11.3, 43.3, 11.4, 43.4))",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "INSERT INTO side_pt_0 error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  retcode = -69;
+	  goto end;
+      }
+    ret =
+	sqlite3_exec (handle,
+		      "CREATE VIRTUAL TABLE side_pt_3 USING MbrCache(pt, g, 'mbrcache_pt.side');",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "CREATE VIRTUAL TABLE side_pt_3 error: %s\n",
+		   err_msg);
+	  sqlite3_free (err_msg);
+	  retcode = -70;
+	  goto end;
+      }
+    if (!check_sidecar_cache (handle, "side_pt_3"))
+      {
+	  retcode = -71;
+	  goto end;
+      }
+
+/* dropping the last sidecar MbrCache removes the generation tracking */
+    ret = count_generation_objects (handle);
+    if (ret != 4)
+      {
+	  fprintf (stderr, "unexpected generation objects: %d\n", ret);
+	  retcode = -72;
+	  goto end;
+      }
+    ret =
+	sqlite3_exec (handle,
+		      "DROP TABLE side_pt_0; DROP TABLE side_pt_1; DROP TABLE side_pt_2;",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "DROP TABLE side_pt error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  retcode = -73;
+	  goto end;
+      }
+    ret = count_generation_objects (handle);
+    if (ret != 4)
+      {
+	  fprintf (stderr, "generation objects dropped too early: %d\n",
+		   ret);
+	  retcode = -74;
+	  goto end;
+      }
+    ret =
+	sqlite3_exec (handle, "DROP TABLE side_pt_3;", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "DROP TABLE side_pt_3 error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  retcode = -75;
+	  goto end;
+      }
+    ret = count_generation_objects (handle);
+    if (ret != 0)
+      {
+	  fprintf (stderr, "generation objects left behind: %d\n", ret);
+	  retcode = -76;
+	  goto end;
+      }
+
+  end:
+    remove ("mbrcache_pt.side");
+    if (old_SPATIALITE_SECURITY_ENV)
+      {
+#ifdef _WIN32
+	  env =
+	      sqlite3_mprintf ("SPATIALITE_SECURITY=%s",
+			       old_SPATIALITE_SECURITY_ENV);
+	  putenv (env);
+	  sqlite3_free (env);
+#else /* not WIN32 */
+	  setenv ("SPATIALITE_SECURITY", old_SPATIALITE_SECURITY_ENV, 1);
+#endif
+      }
+    else
+      {
+#ifdef _WIN32
+	  putenv ("SPATIALITE_SECURITY=");
+#else /* not WIN32 */
+	  unsetenv ("SPATIALITE_SECURITY");
+#endif
+      }
+    return retcode;
+}
+#endif
+
 int
 main (int argc, char *argv[])
 {
@@ -557,6 +800,14 @@ main (int argc, char *argv[])
 	    }
       }
 
+/* MbrCache saved on a sidecar file (only if SPATIALITE_SECURITY=relaxed) */
+    ret = test_sidecar (handle);
+    if (ret != 0)
+      {
+	  sqlite3_close (handle);
+	  return ret;
+      }
+
     ret = sqlite3_exec (handle, "SELECT CreateMbrCache(1, 'geom');",
 			NULL, NULL, &err_msg);
     if (ret != SQLITE_OK)
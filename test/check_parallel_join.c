@@ -0,0 +1,367 @@
+/*
+
+ check_parallel_join.c -- SpatiaLite Test Case
+
+ Author: Sandro Furieri <a.furieri@lqt.it>
+
+ ------------------------------------------------------------------------------
+ 
+ Version: MPL 1.1/GPL 2.0/LGPL 2.1
+ 
+ The contents of this file are subject to the Mozilla Public License Version
+ 1.1 (the "License"); you may not use this file except in compliance with
+ the License. You may obtain a copy of the License at
+ http://www.mozilla.org/MPL/
+ 
+Software distributed under the License is distributed on an "AS IS" basis,
+WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+for the specific language governing rights and limitations under the
+License.
+
+The Original Code is the SpatiaLite library
+
+The Initial Developer of the Original Code is Alessandro Furieri
+ 
+Portions created by the Initial Developer are Copyright (C) 2011
+the Initial Developer. All Rights Reserved.
+
+Contributor(s):
+Brad Hards <bradh@frogmouth.net>
+
+Alternatively, the contents of this file may be used under the terms of
+either the GNU General Public License Version 2 or later (the "GPL"), or
+the GNU Lesser General Public License Version 2.1 or later (the "LGPL"),
+in which case the provisions of the GPL or the LGPL are applicable instead
+of those above. If you wish to allow use of your version of this file only
+under the terms of either the GPL or the LGPL, and not to allow others to
+use your version of this file under the terms of the MPL, indicate your
+decision by deleting the provisions above and replace them with the notice
+and other provisions required by the GPL or the LGPL. If you do not delete
+the provisions above, a recipient may use your version of this file under
+the terms of any one of the MPL, the GPL or the LGPL.
+ 
+*/
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "config.h"
+
+#include "sqlite3.h"
+#include "spatialite.h"
+
+static int
+get_count (sqlite3 * handle, const char *sql, sqlite3_int64 * count)
+{
+/* returning the value of some SELECT Count(*) */
+    sqlite3_stmt *stmt;
+    int ret;
+    int ok = 0;
+    ret = sqlite3_prepare_v2 (handle, sql, strlen (sql), &stmt, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "%s\n%s\n", sql, sqlite3_errmsg (handle));
+	  return 0;
+      }
+    while (1)
+      {
+	  ret = sqlite3_step (stmt);
+	  if (ret == SQLITE_DONE)
+	      break;
+	  if (ret == SQLITE_ROW)
+	    {
+		*count = sqlite3_column_int64 (stmt, 0);
+		ok = 1;
+	    }
+	  else
+	    {
+		fprintf (stderr, "%s\n%s\n", sql, sqlite3_errmsg (handle));
+		ok = 0;
+		break;
+	    }
+      }
+    sqlite3_finalize (stmt);
+    return ok;
+}
+
+static int
+do_test_join (sqlite3 * handle, const char *predicate, const char *out_table,
+	      int threads)
+{
+/* testing a ParallelSpatialJoin against the plain SQL Spatial Join */
+    char *sql;
+    sqlite3_int64 count;
+    sqlite3_int64 expected;
+    sql =
+	sqlite3_mprintf
+	("SELECT Count(*) FROM pts AS p, polys AS g WHERE %s(p.geom, g.geom) = 1",
+	 predicate);
+    if (!get_count (handle, sql, &expected))
+      {
+	  sqlite3_free (sql);
+	  return -7;
+      }
+    sqlite3_free (sql);
+    if (expected == 0)
+      {
+	  fprintf (stderr, "%s: empty Spatial Join\n", out_table);
+	  return -8;
+      }
+    sql =
+	sqlite3_mprintf
+	("SELECT ParallelSpatialJoin('pts', 'geom', 'polys', 'geom', %Q, %Q, %d)",
+	 predicate, out_table, threads);
+    if (!get_count (handle, sql, &count))
+      {
+	  sqlite3_free (sql);
+	  return -1;
+      }
+    sqlite3_free (sql);
+    if (count != expected)
+      {
+	  fprintf (stderr, "ParallelSpatialJoin %s: unexpected %lld (%lld)\n",
+		   out_table, count, expected);
+	  return -2;
+      }
+    sql = sqlite3_mprintf ("SELECT Count(*) FROM %s", out_table);
+    if (!get_count (handle, sql, &count))
+      {
+	  sqlite3_free (sql);
+	  return -3;
+      }
+    sqlite3_free (sql);
+    if (count != expected)
+      {
+	  fprintf (stderr, "%s: unexpected row count %lld (%lld)\n",
+		   out_table, count, expected);
+	  return -4;
+      }
+    sql =
+	sqlite3_mprintf
+	("SELECT Count(*) FROM (SELECT p.ROWID, g.ROWID FROM pts AS p, "
+	 "polys AS g WHERE %s(p.geom, g.geom) = 1 EXCEPT "
+	 "SELECT left_rowid, right_rowid FROM %s)", predicate, out_table);
+    if (!get_count (handle, sql, &count))
+      {
+	  sqlite3_free (sql);
+	  return -5;
+      }
+    sqlite3_free (sql);
+    if (count != 0)
+      {
+	  fprintf (stderr, "%s: %lld missing pairs\n", out_table, count);
+	  return -6;
+      }
+    return 0;
+}
+
+static int
+do_test_error (sqlite3 * handle, const char *sql)
+{
+/* testing some invalid ParallelSpatialJoin */
+    char *err_msg = NULL;
+    int ret = sqlite3_exec (handle, sql, NULL, NULL, &err_msg);
+    if (ret == SQLITE_OK)
+      {
+	  fprintf (stderr, "unexpected success: %s\n", sql);
+	  return 0;
+      }
+    sqlite3_free (err_msg);
+    return 1;
+}
+
+int
+main (int argc, char *argv[])
+{
+    int ret;
+    sqlite3 *handle;
+    char *err_msg = NULL;
+    const char *sql;
+    void *cache = spatialite_alloc_connection ();
+
+    unlink ("./test_parallel_join.sqlite");
+    ret =
+	sqlite3_open_v2 ("./test_parallel_join.sqlite", &handle,
+			 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "cannot open test_parallel_join.sqlite: %s\n",
+		   sqlite3_errmsg (handle));
+	  sqlite3_close (handle);
+	  return -1;
+      }
+
+    spatialite_init_ex (handle, cache, 0);
+
+    sql = "SELECT InitSpatialMetadata(1, 'NONE');"
+	"SELECT AddGeometryColumn('pts', 'geom', 4326, 'POINT', 'XY');"
+	"SELECT AddGeometryColumn('polys', 'geom', 4326, 'POLYGON', 'XY');";
+    ret =
+	sqlite3_exec (handle,
+		      "CREATE TABLE pts (id INTEGER PRIMARY KEY);"
+		      "CREATE TABLE polys (id INTEGER PRIMARY KEY);", NULL,
+		      NULL, &err_msg);
+    if (ret == SQLITE_OK)
+	ret = sqlite3_exec (handle, sql, NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "create tables error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -2;
+      }
+
+/* 2500 points and 100 squares (partially overlapping) */
+    sql = "WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n "
+	"WHERE i < 2499) INSERT INTO pts (id, geom) SELECT i + 1, "
+	"MakePoint(((i % 50) * 2) + 0.5, ((i / 50) * 2) + 0.25, 4326) FROM n;"
+	"WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n "
+	"WHERE i < 99) INSERT INTO polys (id, geom) SELECT i + 1, "
+	"BuildMbr((i % 10) * 10.0, (i / 10) * 10.0, "
+	"((i % 10) * 10.0) + 12.0, ((i / 10) * 10.0) + 12.0, 4326) FROM n;"
+	"SELECT CreateSpatialIndex('polys', 'geom');";
+    ret = sqlite3_exec (handle, sql, NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "populate tables error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -3;
+      }
+/* the Left table has no Spatial Index: partitioned by ROWID */
+    ret = do_test_join (handle, "MbrIntersects", "out1", 4);
+    if (ret != 0)
+      {
+	  sqlite3_close (handle);
+	  return -10 + ret;
+      }
+    ret = do_test_join (handle, "MbrIntersects", "out2", 1);
+    if (ret != 0)
+      {
+	  sqlite3_close (handle);
+	  return -20 + ret;
+      }
+
+/* the Left table has a Spatial Index: partitioned by grid cells */
+    ret =
+	sqlite3_exec (handle, "SELECT CreateSpatialIndex('pts', 'geom')", NULL,
+		      NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "CreateSpatialIndex error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -5;
+      }
+    ret = do_test_join (handle, "MbrIntersects", "out3", 4);
+    if (ret != 0)
+      {
+	  sqlite3_close (handle);
+	  return -30 + ret;
+      }
+    ret = do_test_join (handle, "MbrWithin", "out4", 3);
+    if (ret != 0)
+      {
+	  sqlite3_close (handle);
+	  return -40 + ret;
+      }
+
+/* within a pending transaction: uncommitted changes must be seen */
+    ret =
+	sqlite3_exec (handle, "BEGIN; DELETE FROM pts WHERE id <= 1000", NULL,
+		      NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "DELETE pts error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -6;
+      }
+    ret = do_test_join (handle, "MbrIntersects", "out6", 4);
+    if (ret != 0)
+      {
+	  sqlite3_close (handle);
+	  return -70 + ret;
+      }
+    ret = sqlite3_exec (handle, "ROLLBACK", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "ROLLBACK error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -7;
+      }
+
+#ifndef OMIT_GEOS		/* GEOS is supported */
+    ret = do_test_join (handle, "ST_Intersects", "out5", 4);
+    if (ret != 0)
+      {
+	  sqlite3_close (handle);
+	  return -50 + ret;
+      }
+#endif /* end GEOS conditional */
+
+/* testing invalid arguments */
+    if (!do_test_error
+	(handle,
+	 "SELECT ParallelSpatialJoin('pts', 'geom', 'polys', 'geom', 'Disjoint', 'out9')"))
+      {
+	  sqlite3_close (handle);
+	  return -60;
+      }
+    if (!do_test_error
+	(handle,
+	 "SELECT ParallelSpatialJoin('pts', 'geom', 'polys', 'geom', 'MbrWithin', 'out1')"))
+      {
+	  sqlite3_close (handle);
+	  return -61;
+      }
+    if (!do_test_error
+	(handle,
+	 "SELECT ParallelSpatialJoin('polys', 'geom', 'pts', 'none', 'MbrWithin', 'out9')"))
+      {
+	  sqlite3_close (handle);
+	  return -62;
+      }
+    if (!do_test_error
+	(handle,
+	 "SELECT ParallelSpatialJoin('pts', 'geom', 'polys', 'geom', 'MbrWithin', 'out9', 'a')"))
+      {
+	  sqlite3_close (handle);
+	  return -63;
+      }
+    ret =
+	sqlite3_exec (handle, "SELECT DisableSpatialIndex('polys', 'geom')",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "DisableSpatialIndex error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -64;
+      }
+    if (!do_test_error
+	(handle,
+	 "SELECT ParallelSpatialJoin('pts', 'geom', 'polys', 'geom', 'MbrWithin', 'out9')"))
+      {
+	  sqlite3_close (handle);
+	  return -65;
+      }
+
+    ret = sqlite3_close (handle);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "sqlite3_close() error: %s\n",
+		   sqlite3_errmsg (handle));
+	  return -66;
+      }
+
+    spatialite_cleanup_ex (cache);
+    unlink ("./test_parallel_join.sqlite");
+
+    if (argc > 1 || argv[0] == NULL)
+	argc = 1;		/* silencing stupid compiler warnings */
+
+    return 0;
+}
@@ -2165,6 +2165,188 @@ test_legacy_mode ()
     return 0;
 }
 
+#ifndef OMIT_GEOS		/* only if GEOS is supported */
+static int
+get_geos_cache_stats (sqlite3 * handle, const char *sql, sqlite3_int64 * count,
+		      sqlite3_int64 * hits, sqlite3_int64 * misses)
+{
+/* resetting the GEOS cache, then evaluating a Spatial Join */
+    int ret;
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    ret =
+	sqlite3_exec (handle, "SELECT GeosCache_Reset()", NULL, NULL,
+		      &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "GeosCache_Reset() error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return 0;
+      }
+    ret = sqlite3_get_table (handle, sql, &results, &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Spatial Join error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return 0;
+      }
+    *count = atoll (results[1]);
+    sqlite3_free_table (results);
+    ret =
+	sqlite3_get_table (handle,
+			   "SELECT GeosCache_GetHits(), GeosCache_GetMisses()",
+			   &results, &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "GeosCache_GetHits() error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return 0;
+      }
+    *hits = atoll (results[2]);
+    *misses = atoll (results[3]);
+    sqlite3_free_table (results);
+    return 1;
+}
+#endif /* end GEOS conditional */
+
+int
+test_geos_cache ()
+{
+#ifndef OMIT_GEOS		/* only if GEOS is supported */
+    int ret;
+    sqlite3 *handle;
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    sqlite3_int64 count;
+    sqlite3_int64 expected;
+    sqlite3_int64 hits;
+    sqlite3_int64 misses;
+    sqlite3_int64 hits_64;
+    int returnValue = 0;
+    const char *sql;
+    const char *join_sql =
+	"SELECT Count(*) FROM pts CROSS JOIN polys "
+	"WHERE ST_Intersects(polys.geom, pts.geom) = 1";
+    void *cache = spatialite_alloc_connection ();
+
+    ret =
+	sqlite3_open_v2 (":memory:", &handle,
+			 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "cannot open in-memory db: %s\n",
+		   sqlite3_errmsg (handle));
+	  sqlite3_close (handle);
+	  return -200;
+      }
+    spatialite_init_ex (handle, cache, 0);
+
+/*
+/ 50 Polygons repeatedly tested against 200 single-use Points: only
+/ the pairs passing the MBR quick check are actually evaluated by GEOS
+*/
+    sql = "CREATE TABLE polys (id INTEGER PRIMARY KEY, geom BLOB);"
+	"CREATE TABLE pts (id INTEGER PRIMARY KEY, geom BLOB);"
+	"WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n "
+	"WHERE i < 49) INSERT INTO polys (id, geom) SELECT i + 1, "
+	"BuildMbr((i % 10) * 10.0, (i / 10) * 10.0, "
+	"((i % 10) * 10.0) + 12.0, ((i / 10) * 10.0) + 12.0) FROM n;"
+	"WITH RECURSIVE n(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM n "
+	"WHERE i < 199) INSERT INTO pts (id, geom) SELECT i + 1, "
+	"MakePoint(((i * 37) % 100) + 0.5, ((i * 53) % 50) + 0.25) FROM n";
+    ret = sqlite3_exec (handle, sql, NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "populate tables error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  returnValue = -201;
+	  goto exit;
+      }
+    ret =
+	sqlite3_get_table (handle,
+			   "SELECT GeosCache_GetSize(), (SELECT Count(*) FROM "
+			   "pts CROSS JOIN polys WHERE MbrIntersects(polys.geom, "
+			   "pts.geom) = 1)", &results, &rows, &columns,
+			   &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "GeosCache_GetSize() error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  returnValue = -202;
+	  goto exit;
+      }
+    ret = atoi (results[2]);
+    expected = atoll (results[3]);
+    sqlite3_free_table (results);
+    if (ret != 64)
+      {
+	  fprintf (stderr, "GeosCache_GetSize(): unexpected default %d\n",
+		   ret);
+	  returnValue = -203;
+	  goto exit;
+      }
+
+/* all Polygons fit into the cache: they are prepared only once */
+    if (!get_geos_cache_stats (handle, join_sql, &count, &hits, &misses))
+      {
+	  returnValue = -204;
+	  goto exit;
+      }
+    if (count != expected || hits + misses != expected || hits == 0
+	|| misses > 150)
+      {
+	  fprintf (stderr,
+		   "GEOS cache (64): unexpected %lld (%lld) hits=%lld misses=%lld\n",
+		   count, expected, hits, misses);
+	  returnValue = -205;
+	  goto exit;
+      }
+
+/* a cache smaller than the working set is thrashed (LRU evictions) */
+    hits_64 = hits;
+    ret =
+	sqlite3_exec (handle, "SELECT GeosCache_SetSize(8)", NULL, NULL,
+		      &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "GeosCache_SetSize() error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  returnValue = -206;
+	  goto exit;
+      }
+    if (!get_geos_cache_stats (handle, join_sql, &count, &hits, &misses))
+      {
+	  returnValue = -207;
+	  goto exit;
+      }
+    if (count != expected || hits + misses != expected || hits >= hits_64)
+      {
+	  fprintf (stderr,
+		   "GEOS cache (8): unexpected %lld (%lld) hits=%lld misses=%lld\n",
+		   count, expected, hits, misses);
+	  returnValue = -208;
+	  goto exit;
+      }
+
+  exit:
+    ret = sqlite3_close (handle);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "sqlite3_close() error: %s\n",
+		   sqlite3_errmsg (handle));
+	  return -209;
+      }
+    spatialite_cleanup_ex (cache);
+    return returnValue;
+
+#endif /* end GEOS conditional */
+    return 0;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -2178,6 +2360,9 @@ main (int argc, char *argv[])
     if (ret != 0)
 	return ret;
     ret = test_legacy_mode ();
+    if (ret != 0)
+	return ret;
+    ret = test_geos_cache ();
     if (ret != 0)
 	return ret;
     return 0;
@@ -41,6 +41,7 @@ the provisions above, a recipient may use your version of this file under
 the terms of any one of the MPL, the GPL or the LGPL.
  
 */
+#include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -53,6 +54,219 @@ the terms of any one of the MPL, the GPL or the LGPL.
 
 #ifndef OMIT_ICONV		/* only if ICONV is supported */
 
+static void
+cleanup_shapefile (const char *filename)
+{
+    char nam[1000];
+
+    snprintf (nam, 1000, "%s.dbf", filename);
+    unlink (nam);
+    snprintf (nam, 1000, "%s.prj", filename);
+    unlink (nam);
+    snprintf (nam, 1000, "%s.shp", filename);
+    unlink (nam);
+    snprintf (nam, 1000, "%s.shx", filename);
+    unlink (nam);
+}
+
+static int
+check_dumped_shapefile (sqlite3 * handle, const char *table,
+			const char *geom_type, int expected)
+{
+/* VirtualShape on a dumped 2D or M Shapefile: must return the same geometries */
+    int ret;
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    int row_count;
+    char path[1000];
+    char *sql;
+    int retcode = 0;
+
+    snprintf (path, 1000, "./dump_%s", table);
+    ret =
+	dump_shapefile (handle, (char *) table, "geom", path, "UTF-8",
+			(char *) geom_type, 0, &row_count, NULL);
+    if (!ret || row_count != expected)
+      {
+	  fprintf (stderr, "dump_shapefile() %s error\n", table);
+	  cleanup_shapefile (path);
+	  return -72;
+      }
+    sql =
+	sqlite3_mprintf
+	("CREATE VIRTUAL TABLE \"v_%s\" USING VirtualShape('%s', 'UTF-8', 25832)",
+	 table, path);
+    ret = sqlite3_exec (handle, sql, NULL, NULL, &err_msg);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "CREATE VIRTUAL TABLE v_%s error: %s\n", table,
+		   err_msg);
+	  sqlite3_free (err_msg);
+	  cleanup_shapefile (path);
+	  return -73;
+      }
+    sql =
+	sqlite3_mprintf
+	("SELECT (SELECT Count(*) FROM \"v_%s\"), "
+	 "(SELECT Count(*) FROM (SELECT AsText(CastToSingle(geometry)) "
+	 "FROM \"v_%s\" EXCEPT SELECT AsText(geom) FROM \"%s\")), "
+	 "(SELECT Count(*) FROM (SELECT AsText(geom) FROM \"%s\" "
+	 "EXCEPT SELECT AsText(CastToSingle(geometry)) FROM \"v_%s\"))",
+	 table, table, table, table, table);
+    ret = sqlite3_get_table (handle, sql, &results, &rows, &columns, &err_msg);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  cleanup_shapefile (path);
+	  return -74;
+      }
+    if (rows != 1 || columns != 3 || atoi (results[3]) != expected
+	|| strcmp (results[4], "0") != 0 || strcmp (results[5], "0") != 0)
+      {
+	  fprintf (stderr, "Unexpected VirtualShape v_%s result: %s %s %s\n",
+		   table, results[3], results[4], results[5]);
+	  retcode = -75;
+      }
+    sqlite3_free_table (results);
+    sql = sqlite3_mprintf ("SELECT DropVirtualGeometry('v_%s')", table);
+    ret = sqlite3_exec (handle, sql, NULL, NULL, &err_msg);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "DropVirtualGeometry v_%s error: %s\n", table,
+		   err_msg);
+	  sqlite3_free (err_msg);
+	  retcode = -76;
+      }
+    cleanup_shapefile (path);
+    return retcode;
+}
+
+static int
+check_frame_overload (sqlite3 * handle)
+{
+/* 
+/ VirtualShape on a Shapefile having a SEARCH_FRAME field and NULL Shapes:
+/ MbrIntersects(geometry, ...) must be passed to xBestIndex and must return
+/ exactly the same rows as a plain (not overloaded) MbrIntersects()
+*/
+    int ret;
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    int row_count;
+    const char *path = "./dump_frames";
+    int retcode = 0;
+
+    ret =
+	sqlite3_exec (handle,
+		      "CREATE TABLE frames (id INTEGER PRIMARY KEY, search_frame TEXT, pkuid INTEGER);"
+		      "SELECT AddGeometryColumn('frames', 'geom', 25832, 'POINT', 'XY');"
+		      "WITH RECURSIVE c(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM c "
+		      "WHERE i < 100) INSERT INTO frames (id, search_frame, pkuid, geom) "
+		      "SELECT i, 'frame', i, CASE WHEN i % 7 = 0 THEN NULL "
+		      "ELSE MakePoint(i % 10, i / 10, 25832) END FROM c",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "CREATE TABLE frames error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -77;
+      }
+    ret =
+	dump_shapefile (handle, "frames", "geom", (char *) path, "UTF-8",
+			"POINT", 0, &row_count, NULL);
+    if (!ret || row_count != 100)
+      {
+	  fprintf (stderr, "dump_shapefile() frames error\n");
+	  cleanup_shapefile (path);
+	  return -78;
+      }
+    ret =
+	sqlite3_exec (handle,
+		      "CREATE VIRTUAL TABLE v_frames USING VirtualShape('./dump_frames', 'UTF-8', 25832)",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "CREATE VIRTUAL TABLE v_frames error: %s\n",
+		   err_msg);
+	  sqlite3_free (err_msg);
+	  cleanup_shapefile (path);
+	  return -79;
+      }
+    ret =
+	sqlite3_get_table (handle,
+			   "SELECT (SELECT Count(*) FROM v_frames WHERE "
+			   "MbrIntersects(geometry, BuildMbr(2.5, 2.5, 5.5, 6.5))), "
+			   "(SELECT Count(*) FROM v_frames WHERE "
+			   "MbrIntersects(geometry, BuildMbr(2.5, 2.5, 5.5, 6.5)) <> 0), "
+			   "(SELECT Count(*) FROM v_frames WHERE "
+			   "search_frame = BuildMbr(2.5, 2.5, 5.5, 6.5)), "
+			   "(SELECT Count(*) FROM v_frames WHERE +geometry IS NULL), "
+			   "(SELECT Count(*) FROM v_frames WHERE "
+			   "MbrIntersects(geometry, NULL))", &results, &rows,
+			   &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  retcode = -80;
+	  goto stop;
+      }
+    if (rows != 1 || columns != 5 || strcmp (results[5], "24") != 0
+	|| strcmp (results[6], "24") != 0 || strcmp (results[7], "10") != 0
+	|| strcmp (results[8], "14") != 0 || strcmp (results[9], "100") != 0)
+      {
+	  fprintf (stderr,
+		   "Unexpected VirtualShape MbrIntersects() result: %s %s %s %s %s\n",
+		   results[5], results[6], results[7], results[8], results[9]);
+	  retcode = -81;
+      }
+    sqlite3_free_table (results);
+    if (retcode != 0 || strcmp (sqlite3_libversion (), "3.25.0") < 0)
+	goto stop;		/* SQLITE_INDEX_CONSTRAINT_FUNCTION requires 3.25.0 */
+    ret =
+	sqlite3_get_table (handle,
+			   "EXPLAIN QUERY PLAN SELECT * FROM v_frames WHERE "
+			   "MbrIntersects(geometry, BuildMbr(2.5, 2.5, 5.5, 6.5))",
+			   &results, &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  retcode = -82;
+	  goto stop;
+      }
+    if (rows != 1 || columns != 4
+	|| strstr (results[7], "INDEX 0:1:150,") == NULL)
+      {
+	  fprintf (stderr, "Unexpected VirtualShape MbrIntersects() plan: %s\n",
+		   (rows == 1 && columns == 4) ? results[7] : "?");
+	  retcode = -83;
+      }
+    sqlite3_free_table (results);
+
+  stop:
+    ret =
+	sqlite3_exec (handle, "SELECT DropVirtualGeometry('v_frames')", NULL,
+		      NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "DropVirtualGeometry v_frames error: %s\n",
+		   err_msg);
+	  sqlite3_free (err_msg);
+	  retcode = -84;
+      }
+    cleanup_shapefile (path);
+    return retcode;
+}
+
 static int
 do_test (sqlite3 * handle, const void *p_cache)
 {
@@ -115,6 +329,127 @@ do_test (sqlite3 * handle, const void *p_cache)
 	  return -5;
       }
 
+/* pipelined import: must produce exactly the same table */
+    ret =
+	load_shapefile_ex4 (handle, "shp/merano-3d/roads", "roads_mt",
+			    "CP1252", 25832, "geom", NULL, NULL, 0, 0, 0, 0, 0,
+			    &row_count, GAIA_DBF_COLNAME_LOWERCASE, 4,
+			    err_msg);
+    if (!ret)
+      {
+	  fprintf (stderr, "load_shapefile_ex4() error: %s\n", err_msg);
+	  sqlite3_close (handle);
+	  return -64;
+      }
+    ret =
+	sqlite3_get_table (handle,
+			   "SELECT (SELECT Count(*) FROM roads), "
+			   "(SELECT Count(*) FROM roads_mt), "
+			   "(SELECT Count(*) FROM (SELECT * FROM roads "
+			   "EXCEPT SELECT * FROM roads_mt))", &results,
+			   &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -65;
+      }
+    if (rows != 1 || columns != 3 || atoi (results[3]) <= 0
+	|| atoi (results[3]) != row_count
+	|| strcmp (results[3], results[4]) != 0
+	|| strcmp (results[5], "0") != 0)
+      {
+	  fprintf (stderr, "Unexpected pipelined import result: %s %s %s\n",
+		   results[3], results[4], results[5]);
+	  sqlite3_free_table (results);
+	  sqlite3_close (handle);
+	  return -66;
+      }
+    sqlite3_free_table (results);
+
+/* VirtualShape (memory mapped reader): must return exactly the same geometries */
+    ret =
+	sqlite3_exec (handle,
+		      "CREATE VIRTUAL TABLE v_polygons USING VirtualShape('shp/merano-3d/polygons', CP1252, 25832); "
+		      "CREATE VIRTUAL TABLE v_roads USING VirtualShape('shp/merano-3d/roads', CP1252, 25832); "
+		      "CREATE VIRTUAL TABLE v_points USING VirtualShape('shp/merano-3d/points', CP1252, 25832)",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "CREATE VIRTUAL TABLE error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -67;
+      }
+    ret =
+	sqlite3_get_table (handle,
+			   "SELECT (SELECT Count(*) FROM v_polygons), "
+			   "(SELECT Count(*) FROM (SELECT CompressGeometry(geometry) "
+			   "FROM v_polygons EXCEPT SELECT geom FROM polygons)), "
+			   "(SELECT Count(*) FROM v_roads), "
+			   "(SELECT Count(*) FROM (SELECT geometry FROM v_roads "
+			   "EXCEPT SELECT geom FROM roads)), "
+			   "(SELECT Count(*) FROM v_points), "
+			   "(SELECT Count(*) FROM (SELECT geometry FROM v_points "
+			   "EXCEPT SELECT geom FROM points))", &results, &rows,
+			   &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -68;
+      }
+    if (rows != 1 || columns != 6 || strcmp (results[6], "10") != 0
+	|| strcmp (results[7], "0") != 0 || strcmp (results[8], "18") != 0
+	|| strcmp (results[9], "0") != 0 || strcmp (results[10], "20") != 0
+	|| strcmp (results[11], "0") != 0)
+      {
+	  fprintf (stderr,
+		   "Unexpected VirtualShape result: %s %s %s %s %s %s\n",
+		   results[6], results[7], results[8], results[9],
+		   results[10], results[11]);
+	  sqlite3_free_table (results);
+	  sqlite3_close (handle);
+	  return -69;
+      }
+    sqlite3_free_table (results);
+
+/* VirtualShape spatial filter: must match a plain MbrIntersects() scan */
+    ret =
+	sqlite3_get_table (handle,
+			   "SELECT (SELECT Count(*) FROM v_roads WHERE search_frame = "
+			   "BuildMbr(666000, 5169300, 666700, 5170000)), "
+			   "(SELECT Count(*) FROM v_roads WHERE MbrIntersects(geometry, "
+			   "BuildMbr(666000, 5169300, 666700, 5170000))), "
+			   "(SELECT Count(*) FROM v_points WHERE search_frame = "
+			   "BuildMbr(665000, 5169300, 666500, 5169900)), "
+			   "(SELECT Count(*) FROM v_points WHERE search_frame = "
+			   "BuildMbr(667500, 5169300, 667700, 5169400)), "
+			   "(SELECT Count(*) FROM v_points WHERE MbrIntersects(geometry, "
+			   "BuildMbr(667500, 5169300, 667700, 5169400)))",
+			   &results, &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  sqlite3_close (handle);
+	  return -70;
+      }
+    if (rows != 1 || columns != 5 || strcmp (results[5], "5") != 0
+	|| strcmp (results[6], "5") != 0 || strcmp (results[7], "3") != 0
+	|| strcmp (results[8], results[9]) != 0)
+      {
+	  fprintf (stderr,
+		   "Unexpected VirtualShape search_frame result: %s %s %s %s %s\n",
+		   results[5], results[6], results[7], results[8], results[9]);
+	  sqlite3_free_table (results);
+	  sqlite3_close (handle);
+	  return -71;
+      }
+    sqlite3_free_table (results);
+
     ret =
 	sqlite3_exec (handle,
 		      "INSERT INTO polygons (FEATURE_ID, DATUM, HAUSNR) VALUES (1250000, 0.1, 'alpha')",
@@ -586,6 +921,32 @@ do_test (sqlite3 * handle, const void *p_cache)
     remove_duplicated_rows (handle, "points_xym");
     remove_duplicated_rows (handle, "points_xyzm");
 
+/* VirtualShape (memory mapped reader) on 2D and M Shapefiles */
+    ret = check_dumped_shapefile (handle, "polyg_xy", "POLYGON", 10);
+    if (ret != 0)
+      {
+	  sqlite3_close (handle);
+	  return ret;
+      }
+    ret = check_dumped_shapefile (handle, "roads_xym", "LINESTRING", 18);
+    if (ret != 0)
+      {
+	  sqlite3_close (handle);
+	  return ret;
+      }
+    ret = check_dumped_shapefile (handle, "points_xym", "POINT", 20);
+    if (ret != 0)
+      {
+	  sqlite3_close (handle);
+	  return ret;
+      }
+    ret = check_frame_overload (handle);
+    if (ret != 0)
+      {
+	  sqlite3_close (handle);
+	  return ret;
+      }
+
     sql = "CREATE VIEW test_view AS "
 	"SELECT ROWID AS ROWID, pk_elem AS id, geom AS geometry FROM roads_xyz";
     ret = sqlite3_exec (handle, sql, NULL, NULL, &err_msg);
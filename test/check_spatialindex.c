@@ -1634,6 +1634,423 @@ do_test_rowid (sqlite3 * handle)
     return 0;
 }
 
+static int
+check_bulk_count (sqlite3 * handle, const char *sql, int expected,
+		  int err_code)
+{
+/* checking a single Count(*) query */
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    int ret = sqlite3_get_table (handle, sql, &results, &rows, &columns,
+				 &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error: %s\n%s\n", sql, err_msg);
+	  sqlite3_free (err_msg);
+	  return err_code;
+      }
+    if (rows != 1 || columns != 1 || results[1] == NULL
+	|| atoi (results[1]) != expected)
+      {
+	  fprintf (stderr, "Unexpected result: %s\n%s (expected %d)\n", sql,
+		   (rows == 1 && results[1] != NULL) ? results[1] : "NULL",
+		   expected);
+	  sqlite3_free_table (results);
+	  return err_code - 1;
+      }
+    sqlite3_free_table (results);
+    return 0;
+}
+
+static int
+check_bulk_rtree (sqlite3 * handle, int err_code)
+{
+/* checking the R*Tree internal consistency */
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    int ret;
+    if (strcmp (sqlite3_libversion (), "3.24.0") < 0)
+	return 0;		/* rtreecheck() requires SQLite 3.24.0 or later */
+    ret = sqlite3_get_table (handle, "SELECT rtreecheck('idx_bulk_geom')",
+			     &results, &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "rtreecheck() error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return err_code;
+      }
+    if (rows != 1 || columns != 1 || results[1] == NULL
+	|| strcmp (results[1], "ok") != 0)
+      {
+	  fprintf (stderr, "rtreecheck() unexpected result: %s\n",
+		   (rows == 1 && results[1] != NULL) ? results[1] : "NULL");
+	  sqlite3_free_table (results);
+	  return err_code - 1;
+      }
+    sqlite3_free_table (results);
+    return 0;
+}
+
+int
+do_test_bulk_load (sqlite3 * handle)
+{
+/* testing the STR bulk loaded R*Tree */
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    int expected;
+    int ret;
+    const char *brute =
+	"SELECT Count(*) FROM bulk WHERE MbrIntersects(geom, BuildMbr(10, 30, 20, 40)) = 1";
+    const char *indexed =
+	"SELECT Count(*) FROM bulk WHERE ROWID IN (SELECT ROWID FROM SpatialIndex "
+	"WHERE f_table_name = 'bulk' AND search_frame = BuildMbr(10, 30, 20, 40))";
+
+    ret = sqlite3_exec (handle,
+			"CREATE TABLE bulk (id INTEGER PRIMARY KEY, name TEXT)",
+			NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "CREATE TABLE bulk error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -401;
+      }
+    ret = sqlite3_exec (handle,
+			"SELECT AddGeometryColumn('bulk', 'geom', 4326, 'LINESTRING', 'XY')",
+			NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "AddGeometryColumn(bulk) error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -402;
+      }
+    ret = sqlite3_exec (handle,
+			"WITH RECURSIVE c(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM c WHERE i < 20000) "
+			"INSERT INTO bulk (id, name, geom) SELECT i, 'line', "
+			"MakeLine(MakePoint((i * 7919) % 1000 / 10.0, (i * 104729) % 997 / 10.0, 4326), "
+			"MakePoint((i * 7919) % 1000 / 10.0 + 0.5, (i * 104729) % 997 / 10.0 + 0.25, 4326)) "
+			"FROM c", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "INSERT INTO bulk error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -403;
+      }
+    ret = sqlite3_exec (handle,
+			"INSERT INTO bulk (id, name, geom) VALUES (20001, 'null', NULL)",
+			NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "INSERT INTO bulk (NULL) error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -404;
+      }
+
+/* bulk loading the R*Tree */
+    ret = check_bulk_count (handle,
+			    "SELECT CreateSpatialIndex('bulk', 'geom')", 1,
+			    -405);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, "SELECT Count(*) FROM idx_bulk_geom",
+			    20000, -407);
+    if (ret != 0)
+	return ret;
+/* 20000 entries: 393 fully packed leaves, 8 inner nodes and the root */
+    ret = check_bulk_count (handle, "SELECT Count(*) FROM idx_bulk_geom_node",
+			    402, -409);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_rtree (handle, -411);
+    if (ret != 0)
+	return ret;
+    ret = sqlite3_get_table (handle, brute, &results, &rows, &columns,
+			     &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -413;
+      }
+    expected = (rows == 1) ? atoi (results[1]) : 0;
+    sqlite3_free_table (results);
+    if (expected <= 0)
+      {
+	  fprintf (stderr, "Unexpected brute force result: %d\n", expected);
+	  return -414;
+      }
+    ret = check_bulk_count (handle, indexed, expected, -415);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, "SELECT CheckSpatialIndex('bulk', 'geom')",
+			    1, -417);
+    if (ret != 0)
+	return ret;
+
+/* rebuilding the R*Tree from scratch */
+    ret = check_bulk_count (handle,
+			    "SELECT RecoverSpatialIndex('bulk', 'geom', 1)", 1,
+			    -419);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_rtree (handle, -421);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, indexed, expected, -423);
+    if (ret != 0)
+	return ret;
+
+/* the packed R*Tree must still support ordinary updates */
+    ret = sqlite3_exec (handle,
+			"INSERT INTO bulk (id, name, geom) SELECT id + 30000, name, geom "
+			"FROM bulk WHERE id < 5000", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "INSERT INTO bulk (copy) error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -425;
+      }
+    ret = sqlite3_exec (handle, "DELETE FROM bulk WHERE id BETWEEN 100 AND 3000",
+			NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "DELETE FROM bulk error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -426;
+      }
+    ret = check_bulk_rtree (handle, -427);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, "SELECT Count(*) FROM idx_bulk_geom",
+			    22098, -429);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, "SELECT CheckSpatialIndex('bulk', 'geom')",
+			    1, -431);
+    if (ret != 0)
+	return ret;
+    return 0;
+}
+
+int
+do_test_deferred (sqlite3 * handle)
+{
+/* testing the deferred SpatialIndex mode */
+    char *err_msg = NULL;
+    int ret;
+
+    ret = check_bulk_count (handle, "SELECT IsDeferredSpatialIndexEnabled()",
+			    0, -501);
+    if (ret != 0)
+	return ret;
+    ret = sqlite3_exec (handle,
+			"BEGIN; SELECT EnableDeferredSpatialIndex()",
+			NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "EnableDeferredSpatialIndex() error: %s\n",
+		   err_msg);
+	  sqlite3_free (err_msg);
+	  return -503;
+      }
+    ret = check_bulk_count (handle, "SELECT IsDeferredSpatialIndexEnabled()",
+			    1, -504);
+    if (ret != 0)
+	return ret;
+    ret = sqlite3_exec (handle,
+			"INSERT INTO bulk (id, name, geom) SELECT id + 40000, name, geom "
+			"FROM bulk WHERE id <= 1000;"
+			"UPDATE bulk SET geom = MakeLine(MakePoint(1, 1, 4326), "
+			"MakePoint(2, 2, 4326)) WHERE id = 40001;"
+			"UPDATE bulk SET geom = MakeLine(MakePoint(3, 3, 4326), "
+			"MakePoint(4, 4, 4326)) WHERE id = 40001;"
+			"UPDATE bulk SET geom = MakeLine(MakePoint(5, 5, 4326), "
+			"MakePoint(6, 6, 4326)) WHERE id = 1;"
+			"DELETE FROM bulk WHERE id = 40002", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "INSERT INTO bulk (deferred) error: %s\n",
+		   err_msg);
+	  sqlite3_free (err_msg);
+	  return -506;
+      }
+/* pending entries are still not written into the R*Tree */
+    ret = check_bulk_count (handle, "SELECT Count(*) FROM idx_bulk_geom",
+			    22097, -507);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, "SELECT FlushDeferredSpatialIndex()",
+			    99, -509);
+    if (ret != 0)
+	return ret;
+    ret = sqlite3_exec (handle, "COMMIT", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "COMMIT error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -511;
+      }
+    ret = check_bulk_count (handle, "SELECT DisableDeferredSpatialIndex()",
+			    0, -512);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, "SELECT IsDeferredSpatialIndexEnabled()",
+			    0, -514);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, "SELECT Count(*) FROM idx_bulk_geom",
+			    22196, -516);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle,
+			    "SELECT Count(*) FROM idx_bulk_geom WHERE pkid = 40001 "
+			    "AND xmin = 3 AND ymax = 4", 1, -518);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_rtree (handle, -520);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, "SELECT CheckSpatialIndex('bulk', 'geom')",
+			    1, -522);
+    if (ret != 0)
+	return ret;
+
+/* the deferred mode requires an open transaction */
+    ret = sqlite3_exec (handle, "SELECT EnableDeferredSpatialIndex()",
+			NULL, NULL, &err_msg);
+    if (ret == SQLITE_OK)
+      {
+	  fprintf (stderr,
+		   "EnableDeferredSpatialIndex() unexpected success (autocommit)\n");
+	  return -524;
+      }
+    sqlite3_free (err_msg);
+    err_msg = NULL;
+
+/* pending entries: SpatialIndex queries and COMMIT are expected to fail */
+    ret = sqlite3_exec (handle,
+			"BEGIN; SELECT EnableDeferredSpatialIndex();"
+			"INSERT INTO bulk (id, name, geom) SELECT id + 50000, name, geom "
+			"FROM bulk WHERE id <= 10", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "INSERT INTO bulk (pending) error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -525;
+      }
+    ret = sqlite3_exec (handle,
+			"SELECT Count(*) FROM SpatialIndex WHERE "
+			"f_table_name = 'bulk' AND search_frame = BuildMbr(0, 0, 10, 10)",
+			NULL, NULL, &err_msg);
+    if (ret == SQLITE_OK)
+      {
+	  fprintf (stderr, "SpatialIndex unexpected success (pending)\n");
+	  return -526;
+      }
+    sqlite3_free (err_msg);
+    err_msg = NULL;
+    ret = sqlite3_exec (handle, "COMMIT", NULL, NULL, &err_msg);
+    if (ret == SQLITE_OK)
+      {
+	  fprintf (stderr, "COMMIT unexpected success (pending)\n");
+	  return -527;
+      }
+    sqlite3_free (err_msg);
+    err_msg = NULL;
+    if (!sqlite3_get_autocommit (handle))
+      {
+	  fprintf (stderr, "COMMIT (pending): the transaction is still open\n");
+	  return -528;
+      }
+    ret = check_bulk_count (handle, "SELECT IsDeferredSpatialIndexEnabled()",
+			    0, -529);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle,
+			    "SELECT Count(*) FROM bulk WHERE id > 50000", 0,
+			    -531);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, "SELECT Count(*) FROM idx_bulk_geom",
+			    22196, -533);
+    if (ret != 0)
+	return ret;
+    return 0;
+}
+
+int
+do_test_deferred_large (sqlite3 * handle)
+{
+/* 
+/ testing the deferred SpatialIndex mode on a single statement
+/ queuing more than 1M entries (the former automatic flush
+/ threshold, silently discarding the whole queue)
+*/
+    char *err_msg = NULL;
+    int ret;
+
+    ret = sqlite3_exec (handle,
+			"CREATE TABLE big (id INTEGER PRIMARY KEY);"
+			"SELECT AddGeometryColumn('big', 'geom', 4326, 'POINT', 'XY');"
+			"SELECT CreateSpatialIndex('big', 'geom')", NULL, NULL,
+			&err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "CREATE TABLE big error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -541;
+      }
+    ret = sqlite3_exec (handle,
+			"BEGIN; SELECT EnableDeferredSpatialIndex();"
+			"WITH RECURSIVE c(i) AS (SELECT 1 UNION ALL SELECT i + 1 "
+			"FROM c WHERE i < 1048600) INSERT INTO big (id, geom) "
+			"SELECT i, MakePoint(i % 1000, i / 1000, 4326) FROM c",
+			NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "INSERT INTO big (deferred) error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -542;
+      }
+    ret = check_bulk_count (handle, "SELECT Count(*) FROM idx_big_geom",
+			    0, -543);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, "SELECT FlushDeferredSpatialIndex()",
+			    1048600, -545);
+    if (ret != 0)
+	return ret;
+    ret = sqlite3_exec (handle, "COMMIT", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "COMMIT (big) error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -547;
+      }
+    ret = check_bulk_count (handle, "SELECT Count(*) FROM idx_big_geom",
+			    1048600, -548);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle, "SELECT CheckSpatialIndex('big', 'geom')",
+			    1, -550);
+    if (ret != 0)
+	return ret;
+    ret = check_bulk_count (handle,
+			    "SELECT Count(*) FROM big WHERE ROWID IN ("
+			    "SELECT ROWID FROM SpatialIndex WHERE "
+			    "f_table_name = 'big' AND "
+			    "search_frame = BuildMbr(9.5, 9.5, 19.5, 1047.5))",
+			    10380, -552);
+    if (ret != 0)
+	return ret;
+    return 0;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -1761,6 +2178,30 @@ main (int argc, char *argv[])
 	  return ret;
       }
 
+    ret = do_test_bulk_load (handle);
+    if (ret != 0)
+      {
+	  fprintf (stderr,
+		   "error while testing current style metadata layout (R*Tree bulk load)\n");
+	  return ret;
+      }
+
+    ret = do_test_deferred (handle);
+    if (ret != 0)
+      {
+	  fprintf (stderr,
+		   "error while testing current style metadata layout (deferred R*Tree)\n");
+	  return ret;
+      }
+
+    ret = do_test_deferred_large (handle);
+    if (ret != 0)
+      {
+	  fprintf (stderr,
+		   "error while testing current style metadata layout (deferred R*Tree, 1M entries)\n");
+	  return ret;
+      }
+
     ret = sqlite3_close (handle);
     if (ret != SQLITE_OK)
       {
@@ -41,9 +41,11 @@ the terms of any one of the MPL, the GPL or the LGPL.
  
 */
 #define _GNU_SOURCE
+#include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 
 #include "config.h"
 
@@ -429,6 +431,368 @@ test_knn (sqlite3 * sqlite, int mode)
     return 0;
 }
 
+static int
+test_knn_order (sqlite3 * sqlite, double x, double y)
+{
+/* comparing KNN against a brute force sorted resultset */
+    int ret;
+    const char *sql;
+    sqlite3_stmt *stmt_knn = NULL;
+    sqlite3_stmt *stmt_ref = NULL;
+    int rows = 0;
+
+    sql =
+	"SELECT distance FROM knn WHERE f_table_name = 'points' "
+	"AND ref_geometry = MakePoint(?, ?) AND max_items = 64";
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt_knn, NULL);
+    if (ret != SQLITE_OK)
+	goto error;
+    sql =
+	"SELECT ST_Distance(MakePoint(?, ?), geom) AS dist FROM points "
+	"ORDER BY dist LIMIT 64";
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt_ref, NULL);
+    if (ret != SQLITE_OK)
+	goto error;
+    sqlite3_bind_double (stmt_knn, 1, x);
+    sqlite3_bind_double (stmt_knn, 2, y);
+    sqlite3_bind_double (stmt_ref, 1, x);
+    sqlite3_bind_double (stmt_ref, 2, y);
+    while (1)
+      {
+	  /* scrolling both result sets in parallel */
+	  ret = sqlite3_step (stmt_knn);
+	  if (ret == SQLITE_DONE)
+	      break;		/* end of result set */
+	  if (ret != SQLITE_ROW)
+	      goto error;
+	  if (sqlite3_step (stmt_ref) != SQLITE_ROW)
+	      goto error;
+	  if (sqlite3_column_double (stmt_knn, 0) !=
+	      sqlite3_column_double (stmt_ref, 0))
+	    {
+		fprintf (stderr, "KNN order: #%d unexpected distance %1.6f\n",
+			 rows + 1, sqlite3_column_double (stmt_knn, 0));
+		goto error;
+	    }
+	  rows++;
+      }
+    if (rows != 64)
+      {
+	  fprintf (stderr, "KNN order: unexpected %d rows\n", rows);
+	  goto error;
+      }
+    sqlite3_finalize (stmt_knn);
+    sqlite3_finalize (stmt_ref);
+
+/* LIMIT should simply stop the traversal */
+    sql =
+	"SELECT Count(*) FROM (SELECT fid FROM knn WHERE f_table_name = 'points' "
+	"AND ref_geometry = MakePoint(?, ?) AND max_items = 10000 LIMIT 5)";
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt_knn, NULL);
+    if (ret != SQLITE_OK)
+	goto error;
+    stmt_ref = NULL;
+    sqlite3_bind_double (stmt_knn, 1, x);
+    sqlite3_bind_double (stmt_knn, 2, y);
+    if (sqlite3_step (stmt_knn) != SQLITE_ROW
+	|| sqlite3_column_int (stmt_knn, 0) != 5)
+      {
+	  fprintf (stderr, "KNN LIMIT: unexpected result\n");
+	  goto error;
+      }
+    sqlite3_finalize (stmt_knn);
+    return 1;
+
+  error:
+    if (stmt_knn != NULL)
+	sqlite3_finalize (stmt_knn);
+    if (stmt_ref != NULL)
+	sqlite3_finalize (stmt_ref);
+    return 0;
+}
+
+static int
+test_knn_cursors (sqlite3 * sqlite)
+{
+/* two KNN cursors within the same statement must not interfere */
+    int ret;
+    const char *sql;
+    char **results;
+    int rows;
+    int columns;
+    char *err_msg = NULL;
+
+    sql =
+	"SELECT Count(*), Count(DISTINCT k1.fid), Count(DISTINCT k2.fid) "
+	"FROM knn AS k1, knn AS k2 WHERE k1.f_table_name = 'points' "
+	"AND k1.ref_geometry = MakePoint(100250.5, 4000333.3) "
+	"AND k1.max_items = 3 AND k2.f_table_name = 'points' "
+	"AND k2.ref_geometry = MakePoint(100900.1, 4000900.7) "
+	"AND k2.max_items = 4";
+    ret = sqlite3_get_table (sqlite, sql, &results, &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "KNN cursors error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return 0;
+      }
+    if (rows != 1 || atoi (results[3]) != 12 || atoi (results[4]) != 3
+	|| atoi (results[5]) != 4)
+      {
+	  fprintf (stderr, "KNN cursors: unexpected result %s %s %s\n",
+		   results[3], results[4], results[5]);
+	  sqlite3_free_table (results);
+	  return 0;
+      }
+    sqlite3_free_table (results);
+    return 1;
+}
+
+static int
+test_knn_join (sqlite3 * sqlite)
+{
+/* testing KNN_Join against the KNN Virtual Table */
+    int ret;
+    const char *sql;
+    char **results;
+    int rows;
+    int columns;
+    char *err_msg = NULL;
+
+    sql = "SELECT KNN_Join('points', 'geom', 'points', 'geom', 4, 'knn_out')";
+    ret = sqlite3_get_table (sqlite, sql, &results, &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "KNN_Join error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return 0;
+      }
+    if (rows != 1 || results[1] == NULL || atoi (results[1]) != 30000)
+      {
+	  fprintf (stderr, "KNN_Join: unexpected result %s\n",
+		   results[1] == NULL ? "NULL" : results[1]);
+	  sqlite3_free_table (results);
+	  return 0;
+      }
+    sqlite3_free_table (results);
+
+    sql =
+	"SELECT Count(*) FROM points AS p, knn AS k, knn_out AS o "
+	"WHERE p.id % 97 = 0 AND k.f_table_name = 'points' "
+	"AND k.ref_geometry = p.geom AND k.max_items = 4 "
+	"AND o.point_rowid = p.id AND o.pos = k.pos "
+	"AND (o.target_rowid <> k.fid OR o.distance <> k.distance)";
+    ret = sqlite3_get_table (sqlite, sql, &results, &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "KNN_Join check error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return 0;
+      }
+    if (rows != 1 || results[1] == NULL || atoi (results[1]) != 0)
+      {
+	  fprintf (stderr, "KNN_Join: %s mismatching rows\n",
+		   results[1] == NULL ? "NULL" : results[1]);
+	  sqlite3_free_table (results);
+	  return 0;
+      }
+    sqlite3_free_table (results);
+
+/* the output table already exists */
+    sql = "SELECT KNN_Join('points', 'geom', 'points', 'geom', 4, 'knn_out')";
+    ret = sqlite3_exec (sqlite, sql, NULL, NULL, &err_msg);
+    if (ret == SQLITE_OK)
+      {
+	  fprintf (stderr, "KNN_Join: unexpected success\n");
+	  return 0;
+      }
+    sqlite3_free (err_msg);
+    return 1;
+}
+
+static int
+test_knn_join_transaction (void)
+{
+/* KNN_Join within a pending transaction: uncommitted changes must be seen */
+    int ret;
+    sqlite3 *sqlite = NULL;
+    const char *sql;
+    char **results;
+    int rows;
+    int columns;
+    char *err_msg = NULL;
+    int retcode = 0;
+    const char *path = "./knn_join_tx.sqlite";
+    void *cache = spatialite_alloc_connection ();
+
+    unlink (path);
+    ret =
+	sqlite3_open_v2 (path, &sqlite,
+			 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "cannot open \"%s\": %s\n", path,
+		   sqlite3_errmsg (sqlite));
+	  goto end;
+      }
+    spatialite_init_ex (sqlite, cache, 0);
+    ret =
+	sqlite3_exec (sqlite, "SELECT InitSpatialMetadata(1)", NULL, NULL,
+		      &err_msg);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    if (!create_table (sqlite))
+	goto end;
+    if (!populate_table (sqlite))
+	goto end;
+
+    sql = "BEGIN; DELETE FROM points WHERE id <= 2500";
+    ret = sqlite3_exec (sqlite, sql, NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    sql =
+	"SELECT KNN_Join('points', 'geom', 'points', 'geom', 4, 'knn_tx', 4)";
+    ret = sqlite3_get_table (sqlite, sql, &results, &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    if (rows != 1 || results[1] == NULL || atoi (results[1]) != 20000)
+      {
+	  fprintf (stderr, "KNN_Join transaction: unexpected result %s\n",
+		   results[1] == NULL ? "NULL" : results[1]);
+	  sqlite3_free_table (results);
+	  goto end;
+      }
+    sqlite3_free_table (results);
+    sql =
+	"SELECT Count(*) FROM knn_tx WHERE point_rowid <= 2500 "
+	"OR target_rowid <= 2500";
+    ret = sqlite3_get_table (sqlite, sql, &results, &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    if (rows != 1 || results[1] == NULL || atoi (results[1]) != 0)
+      {
+	  fprintf (stderr, "KNN_Join transaction: %s deleted rows\n",
+		   results[1] == NULL ? "NULL" : results[1]);
+	  sqlite3_free_table (results);
+	  goto end;
+      }
+    sqlite3_free_table (results);
+    ret = sqlite3_exec (sqlite, "ROLLBACK", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    retcode = 1;
+    goto end;
+
+  sql_error:
+    fprintf (stderr, "KNN_Join transaction error: %s\n", err_msg);
+    sqlite3_free (err_msg);
+  end:
+    sqlite3_close (sqlite);
+    spatialite_cleanup_ex (cache);
+    unlink (path);
+    return retcode;
+}
+
+static int
+test_knn_geodesic (sqlite3 * sqlite)
+{
+/* comparing a long/lat KNN against brute force geodesic distances */
+    int ret;
+    int i;
+    const char *sql;
+    char *err_msg = NULL;
+    sqlite3_stmt *stmt_knn = NULL;
+    sqlite3_stmt *stmt_ref = NULL;
+    double refs[] = { 179.95, 10.0, -179.95, -20.0, 12.5, 88.7, -60.0, -85.0 };
+
+    sql = "CREATE TABLE geo_points (id INTEGER PRIMARY KEY AUTOINCREMENT)";
+    ret = sqlite3_exec (sqlite, sql, NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    sql =
+	"SELECT AddGeometryColumn('geo_points', 'geom', 4326, 'POINT', 'XY')";
+    ret = sqlite3_exec (sqlite, sql, NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+    sql = "SELECT CreateSpatialIndex('geo_points', 'geom')";
+    ret = sqlite3_exec (sqlite, sql, NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+/* a grid covering the whole globe, poles and antimeridian included */
+    sql =
+	"WITH RECURSIVE c(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM c "
+	"WHERE i < 4999) INSERT INTO geo_points (geom) "
+	"SELECT MakePoint(((i * 37) % 3600) / 10.0 - 180.0, "
+	"((i * 53) % 1780) / 10.0 - 89.0, 4326) FROM c";
+    ret = sqlite3_exec (sqlite, sql, NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+	goto sql_error;
+
+    sql =
+	"SELECT distance FROM knn WHERE f_table_name = 'geo_points' "
+	"AND ref_geometry = MakePoint(?, ?, 4326) AND max_items = 32";
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt_knn, NULL);
+    if (ret != SQLITE_OK)
+	goto error;
+    sql =
+	"SELECT dist FROM (SELECT ST_Distance(MakePoint(?, ?, 4326), geom, 1) "
+	"AS dist FROM geo_points) WHERE dist IS NOT NULL "
+	"ORDER BY dist LIMIT 32";
+    ret = sqlite3_prepare_v2 (sqlite, sql, strlen (sql), &stmt_ref, NULL);
+    if (ret != SQLITE_OK)
+	goto error;
+    for (i = 0; i < 8; i += 2)
+      {
+	  int rows = 0;
+	  sqlite3_reset (stmt_knn);
+	  sqlite3_reset (stmt_ref);
+	  sqlite3_bind_double (stmt_knn, 1, refs[i]);
+	  sqlite3_bind_double (stmt_knn, 2, refs[i + 1]);
+	  sqlite3_bind_double (stmt_ref, 1, refs[i]);
+	  sqlite3_bind_double (stmt_ref, 2, refs[i + 1]);
+	  while (1)
+	    {
+		/* scrolling both result sets in parallel */
+		ret = sqlite3_step (stmt_knn);
+		if (ret == SQLITE_DONE)
+		    break;	/* end of result set */
+		if (ret != SQLITE_ROW)
+		    goto error;
+		if (sqlite3_step (stmt_ref) != SQLITE_ROW)
+		    goto error;
+		if (fabs (sqlite3_column_double (stmt_knn, 0) -
+			  sqlite3_column_double (stmt_ref, 0)) > 0.000001)
+		  {
+		      fprintf (stderr,
+			       "KNN geodesic: #%d unexpected distance %1.6f\n",
+			       rows + 1, sqlite3_column_double (stmt_knn, 0));
+		      goto error;
+		  }
+		rows++;
+	    }
+	  if (rows != 32)
+	    {
+		fprintf (stderr, "KNN geodesic: unexpected %d rows\n", rows);
+		goto error;
+	    }
+      }
+    sqlite3_finalize (stmt_knn);
+    sqlite3_finalize (stmt_ref);
+    return 1;
+
+  sql_error:
+    fprintf (stderr, "KNN geodesic error: %s\n", err_msg);
+    sqlite3_free (err_msg);
+    return 0;
+
+  error:
+    if (stmt_knn != NULL)
+	sqlite3_finalize (stmt_knn);
+    if (stmt_ref != NULL)
+	sqlite3_finalize (stmt_ref);
+    return 0;
+}
+
 #endif
 #endif
 
@@ -620,6 +984,60 @@ main (int argc, char *argv[])
 	  return -19;
       }
 
+/* Testing KNN - #11 */
+    ret = test_knn_order (db_handle, 100250.5, 4000333.3);
+    if (!ret)
+      {
+	  fprintf (stderr, "Check KNN #11: unexpected failure\n");
+	  sqlite3_close (db_handle);
+	  return -20;
+      }
+
+/* Testing KNN - #12 */
+    ret = test_knn_order (db_handle, 100900.1, 4000900.7);
+    if (!ret)
+      {
+	  fprintf (stderr, "Check KNN #12: unexpected failure\n");
+	  sqlite3_close (db_handle);
+	  return -21;
+      }
+
+/* Testing KNN_Join */
+    ret = test_knn_join (db_handle);
+    if (!ret)
+      {
+	  fprintf (stderr, "Check KNN_Join: unexpected failure\n");
+	  sqlite3_close (db_handle);
+	  return -22;
+      }
+
+/* Testing KNN - long/lat */
+    ret = test_knn_geodesic (db_handle);
+    if (!ret)
+      {
+	  fprintf (stderr, "Check KNN geodesic: unexpected failure\n");
+	  sqlite3_close (db_handle);
+	  return -23;
+      }
+
+/* Testing KNN_Join within a pending transaction */
+    ret = test_knn_join_transaction ();
+    if (!ret)
+      {
+	  fprintf (stderr, "Check KNN_Join transaction: unexpected failure\n");
+	  sqlite3_close (db_handle);
+	  return -24;
+      }
+
+/* Testing two KNN cursors within the same statement */
+    ret = test_knn_cursors (db_handle);
+    if (!ret)
+      {
+	  fprintf (stderr, "Check KNN cursors: unexpected failure\n");
+	  sqlite3_close (db_handle);
+	  return -25;
+      }
+
 #endif /* end KNN conditional */
 #endif /* end GEOS conditional */
 
@@ -643,6 +643,8 @@ set_request (sqlite3_stmt * stmt, int request)
 	sqlite3_bind_text (stmt, 1, "TSP NN", -1, SQLITE_STATIC);
     else if (request == 2)
 	sqlite3_bind_text (stmt, 1, "TSP GA", -1, SQLITE_STATIC);
+    else if (request == 3)
+	sqlite3_bind_text (stmt, 1, "COST MATRIX", -1, SQLITE_STATIC);
     else
 	sqlite3_bind_text (stmt, 1, "SHORTEST PATH", -1, SQLITE_STATIC);
     sqlite3_step (stmt);
@@ -1078,7 +1080,7 @@ do_test (sqlite3 * handle, const char *base_name, int srid, int has_z,
 	  if (!with_astar && alg != 0)
 	      continue;		/* skipping A* test */
 	  set_algorithm (stmt_alg, alg);
-	  for (req = 0; req < 3; req++)
+	  for (req = 0; req < 4; req++)
 	    {
 		set_request (stmt_req, req);
 		for (opt = 0; opt < 4; opt++)
@@ -1141,6 +1143,465 @@ do_test (sqlite3 * handle, const char *base_name, int srid, int has_z,
     return 0;
 }
 
+static int
+do_test_sidecar (sqlite3 * handle)
+{
+/* testing a Routing graph saved on a sidecar file (only if SPATIALITE_SECURITY=relaxed) */
+    int ret;
+    int i;
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    char cost[64];
+    const char *sql =
+	"SELECT Cost FROM %s WHERE NodeFrom = 'RT05301804525GZ' AND NodeTo = 'RT05301806819GZ'";
+
+    *cost = '\0';
+    for (i = 0; i < 3; i++)
+      {
+	  /* the second time the sidecar file (if any) is simply mapped */
+	  char name[64];
+	  char *stmt;
+	  if (i == 0)
+	      strcpy (name, "test_3003_2d_cyyy");
+	  else
+	    {
+		sprintf (name, "side_route_%d", i);
+		stmt =
+		    sqlite3_mprintf
+		    ("CREATE VIRTUAL TABLE %s USING VirtualRouting(test_3003_2d_cyyy_data, 'routing_test.side')",
+		     name);
+		ret = sqlite3_exec (handle, stmt, NULL, NULL, &err_msg);
+		sqlite3_free (stmt);
+		if (ret != SQLITE_OK)
+		  {
+		      fprintf (stderr,
+			       "CREATE VIRTUAL TABLE side_route error: %s\n",
+			       err_msg);
+		      sqlite3_free (err_msg);
+		      return -1;
+		  }
+	    }
+	  stmt = sqlite3_mprintf (sql, name);
+	  ret =
+	      sqlite3_get_table (handle, stmt, &results, &rows, &columns,
+				 &err_msg);
+	  sqlite3_free (stmt);
+	  if (ret != SQLITE_OK)
+	    {
+		fprintf (stderr, "Error in sidecar SELECT: %s\n", err_msg);
+		sqlite3_free (err_msg);
+		return -2;
+	    }
+	  if (rows < 1 || columns != 1 || results[1] == NULL)
+	    {
+		fprintf (stderr, "unexpected sidecar result\n");
+		sqlite3_free_table (results);
+		return -3;
+	    }
+	  if (i == 0)
+	      strcpy (cost, results[1]);
+	  else if (strcmp (cost, results[1]) != 0)
+	    {
+		fprintf (stderr, "unexpected sidecar Cost: %s (expected %s)\n",
+			 results[1], cost);
+		sqlite3_free_table (results);
+		return -4;
+	    }
+	  sqlite3_free_table (results);
+      }
+    remove ("routing_test.side");
+    return 0;
+}
+
+static int
+do_check_turns_cost (sqlite3 * handle, const char *vtable, double expected)
+{
+/* checking the Cost of the 1 -> 6 Shortest Path */
+    int ret;
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    double cost;
+    char *sql =
+	sqlite3_mprintf ("SELECT Cost FROM %s WHERE NodeFrom = 1 AND NodeTo = 6",
+			 vtable);
+    ret = sqlite3_get_table (handle, sql, &results, &rows, &columns, &err_msg);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error in turns SELECT: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -1;
+      }
+    if (rows < 1 || columns != 1 || results[1] == NULL)
+      {
+	  fprintf (stderr, "unexpected turns result\n");
+	  sqlite3_free_table (results);
+	  return -2;
+      }
+    cost = atof (results[1]);
+    sqlite3_free_table (results);
+    if (cost != expected)
+      {
+	  fprintf (stderr, "%s: unexpected Cost %1.6f (expected %1.6f)\n",
+		   vtable, cost, expected);
+	  return -3;
+      }
+    return 0;
+}
+
+static int
+do_test_turns_profiles (sqlite3 * handle)
+{
+/* testing Turn restrictions and Time Dependent Costs */
+    int ret;
+    int i;
+    char *err_msg = NULL;
+    const char *sql[] = {
+	"CREATE TABLE turn_arcs (id INTEGER PRIMARY KEY, node_from INTEGER, "
+	    "node_to INTEGER, cost DOUBLE)",
+	"INSERT INTO turn_arcs VALUES (1, 1, 2, 1), (2, 2, 3, 1), (3, 3, 6, 1), "
+	    "(4, 1, 4, 2), (5, 4, 5, 2), (6, 5, 6, 2), (7, 2, 5, 1)",
+	"CREATE TABLE turn_bans (from_link INTEGER, to_link INTEGER)",
+	"INSERT INTO turn_bans VALUES (2, 3)",
+	"CREATE TABLE turn_profiles (link INTEGER, t DOUBLE, cost DOUBLE)",
+	"INSERT INTO turn_profiles VALUES (1, 0, 1), (1, 43200, 10)",
+	"SELECT CreateRouting('turn_data', 'turn_vt1', 'turn_arcs', "
+	    "'node_from', 'node_to', NULL, 'cost', NULL, 0, 1)",
+	"SELECT CreateRoutingTurns('turn_data', 'turn_bans', 'from_link', 'to_link')",
+	"CREATE VIRTUAL TABLE turn_vt2 USING VirtualRouting(turn_data)",
+	"SELECT CreateRoutingProfiles('turn_data', 'turn_profiles', 'link', 't', 'cost')",
+	"CREATE VIRTUAL TABLE turn_vt3 USING VirtualRouting(turn_data)",
+	NULL
+    };
+    for (i = 0; sql[i] != NULL; i++)
+      {
+	  ret = sqlite3_exec (handle, sql[i], NULL, NULL, &err_msg);
+	  if (ret != SQLITE_OK)
+	    {
+		fprintf (stderr, "Turns \"%s\" error: %s\n", sql[i], err_msg);
+		sqlite3_free (err_msg);
+		return -1;
+	    }
+      }
+
+/* 1-2-3-6 is the Shortest Path, unless turning from 2-3 into 3-6 is forbidden */
+    if (do_check_turns_cost (handle, "turn_vt1", 3.0) != 0)
+	return -2;
+    if (do_check_turns_cost (handle, "turn_vt2", 4.0) != 0)
+	return -3;
+
+/* at noon the 1-2 Link costs 10 */
+    if (do_check_turns_cost (handle, "turn_vt3", 4.0) != 0)
+	return -4;
+    ret =
+	sqlite3_exec (handle, "UPDATE turn_vt3 SET DepartureTime = '12:00'",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "DepartureTime error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -5;
+      }
+    if (do_check_turns_cost (handle, "turn_vt3", 6.0) != 0)
+	return -6;
+/* at 01:30 the 1-2 Link costs 2.125 (linear interpolation) */
+    ret =
+	sqlite3_exec (handle, "UPDATE turn_vt3 SET DepartureTime = 5400",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "DepartureTime error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -7;
+      }
+    if (do_check_turns_cost (handle, "turn_vt3", 5.125) != 0)
+	return -8;
+    return 0;
+}
+
+static int
+do_test_isochrones (sqlite3 * handle)
+{
+/* testing the Isochrones request */
+    int ret;
+    int i;
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    double area = 0.0;
+    const char *sql =
+	"SELECT Cost, GeometryType(Geometry), ST_Area(Geometry) "
+	"FROM test_3003_2d_cnnn WHERE NodeFrom = 'RT05301804525GZ' "
+	"AND Cost <= '1000, 250, 500'";
+
+    ret =
+	sqlite3_exec (handle,
+		      "UPDATE test_3003_2d_cnnn SET Request = 'Isochrones', "
+		      "Tolerance = 25.0", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Isochrones UPDATE error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -1;
+      }
+    ret = sqlite3_get_table (handle, sql, &results, &rows, &columns, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error in Isochrones SELECT: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -2;
+      }
+    if (rows != 3 || columns != 3)
+      {
+	  fprintf (stderr, "unexpected Isochrones result %d/%d\n", rows,
+		   columns);
+	  sqlite3_free_table (results);
+	  return -3;
+      }
+/* one polygon for each band, sorted by Cost: each one covering a wider area */
+    for (i = 1; i <= rows; i++)
+      {
+	  const char *cost = results[(i * columns) + 0];
+	  const char *type = results[(i * columns) + 1];
+	  const char *value = results[(i * columns) + 2];
+	  double expected = (i == 1) ? 250.0 : ((i == 2) ? 500.0 : 1000.0);
+	  if (cost == NULL || atof (cost) != expected)
+	    {
+		fprintf (stderr, "unexpected Isochrones Cost #%d\n", i);
+		sqlite3_free_table (results);
+		return -4;
+	    }
+	  if (type == NULL || strstr (type, "POLYGON") == NULL)
+	    {
+		fprintf (stderr, "unexpected Isochrones Geometry #%d\n", i);
+		sqlite3_free_table (results);
+		return -5;
+	    }
+	  if (value == NULL || atof (value) <= area)
+	    {
+		fprintf (stderr, "unexpected Isochrones Area #%d\n", i);
+		sqlite3_free_table (results);
+		return -6;
+	    }
+	  area = atof (value);
+      }
+    sqlite3_free_table (results);
+
+    ret =
+	sqlite3_exec (handle,
+		      "UPDATE test_3003_2d_cnnn SET Request = 'Shortest Path', "
+		      "Tolerance = 20.0", NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Isochrones UPDATE error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -7;
+      }
+    return 0;
+}
+
+static int
+do_test_update_links (sqlite3 * handle)
+{
+/* testing incremental updates (CreateRouting_UpdateLinks) */
+    int ret;
+    int i;
+    char *err_msg = NULL;
+    const char *sql[] = {
+	"CREATE TABLE upd_arcs (id INTEGER PRIMARY KEY, node_from INTEGER, "
+	    "node_to INTEGER, cost DOUBLE)",
+	"INSERT INTO upd_arcs VALUES (1, 1, 2, 1), (2, 2, 3, 1), (3, 3, 6, 1), "
+	    "(4, 1, 4, 2), (5, 4, 5, 2), (6, 5, 6, 2), (7, 2, 5, 1)",
+	"SELECT CreateRouting('upd_data', 'upd_vt1', 'upd_arcs', "
+	    "'node_from', 'node_to', NULL, 'cost', NULL, 0, 1)",
+	NULL
+    };
+    const char *upd[] = {
+	"UPDATE upd_arcs SET cost = 5 WHERE id = 2",
+	"SELECT CreateRouting_UpdateLinks('upd_data', 2, 'cost')",
+	"DELETE FROM upd_arcs WHERE id = 7",
+	"SELECT CreateRouting_UpdateLinks('upd_data', '7', 'cost')",
+	"UPDATE upd_arcs SET node_to = 6, cost = 2.5 WHERE id = 4",
+	"SELECT CreateRouting_UpdateLinks('upd_data', '4, 2', 'cost', 1)",
+	NULL
+    };
+/*
+/ 1-2-3-6, then 1-2-5-6, then 1-4-5-6 and finally 1-6; the network
+/ is left untouched until CreateRouting_UpdateLinks() is called
+*/
+    double expected[] = { 3.0, 4.0, 4.0, 6.0, 6.0, 2.5 };
+    for (i = 0; sql[i] != NULL; i++)
+      {
+	  ret = sqlite3_exec (handle, sql[i], NULL, NULL, &err_msg);
+	  if (ret != SQLITE_OK)
+	    {
+		fprintf (stderr, "UpdateLinks \"%s\" error: %s\n", sql[i],
+			 err_msg);
+		sqlite3_free (err_msg);
+		return -1;
+	    }
+      }
+    if (do_check_turns_cost (handle, "upd_vt1", 3.0) != 0)
+	return -2;
+    for (i = 0; upd[i] != NULL; i++)
+      {
+	  ret = sqlite3_exec (handle, upd[i], NULL, NULL, &err_msg);
+	  if (ret != SQLITE_OK)
+	    {
+		fprintf (stderr, "UpdateLinks \"%s\" error: %s\n", upd[i],
+			 err_msg);
+		sqlite3_free (err_msg);
+		return -3;
+	    }
+	  if (do_check_turns_cost (handle, "upd_vt1", expected[i]) != 0)
+	      return -4;
+      }
+
+/* a freshly connected VirtualRouting must agree */
+    ret =
+	sqlite3_exec (handle,
+		      "CREATE VIRTUAL TABLE upd_vt2 USING VirtualRouting(upd_data)",
+		      NULL, NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "UpdateLinks VirtualRouting error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -5;
+      }
+    if (do_check_turns_cost (handle, "upd_vt2", 2.5) != 0)
+	return -6;
+
+/* adding a brand new Node requires a full CreateRouting */
+    ret =
+	sqlite3_exec (handle, "INSERT INTO upd_arcs VALUES (8, 6, 7, 1)", NULL,
+		      NULL, &err_msg);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "UpdateLinks INSERT error: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -7;
+      }
+    ret =
+	sqlite3_exec (handle,
+		      "SELECT CreateRouting_UpdateLinks('upd_data', 8, 'cost')",
+		      NULL, NULL, &err_msg);
+    if (ret == SQLITE_OK)
+      {
+	  fprintf (stderr, "UpdateLinks: unexpected success (new Node)\n");
+	  return -8;
+      }
+    sqlite3_free (err_msg);
+    if (do_check_turns_cost (handle, "upd_vt1", 2.5) != 0)
+	return -9;
+    return 0;
+}
+
+static int
+do_check_cost_matrix (sqlite3 * handle, const char *vtable)
+{
+/* checking a Cost Matrix against the expected costs */
+    int ret;
+    int i;
+    char *err_msg = NULL;
+    char **results;
+    int rows;
+    int columns;
+    char *sql;
+/*
+/ origins 1 and 3, destinations 2, 5 and 8: Node 8 only belongs
+/ to an isolated Link, so it can't be reached from any origin
+*/
+    const char *expected[] = {
+	"0", "0", "1", "2", "1.0", "Cost",
+	"0", "1", "1", "5", "7.0", "Cost",
+	"0", "2", "1", "8", NULL, "Unreachable",
+	"1", "0", "3", "2", "2.0", "Cost",
+	"1", "1", "3", "5", "4.0", "Cost",
+	"1", "2", "3", "8", NULL, "Unreachable"
+    };
+    sql =
+	sqlite3_mprintf
+	("SELECT RouteId, RouteRow, NodeFrom, NodeTo, Cost, Role "
+	 "FROM \"%s\" WHERE NodeFrom = '1, 3' AND NodeTo = '2, 5, 8' "
+	 "ORDER BY RouteId, RouteRow", vtable);
+    ret = sqlite3_get_table (handle, sql, &results, &rows, &columns, &err_msg);
+    sqlite3_free (sql);
+    if (ret != SQLITE_OK)
+      {
+	  fprintf (stderr, "Error in Cost Matrix SELECT: %s\n", err_msg);
+	  sqlite3_free (err_msg);
+	  return -1;
+      }
+    if (rows != 6 || columns != 6)
+      {
+	  fprintf (stderr, "unexpected %s Cost Matrix result %d/%d\n", vtable,
+		   rows, columns);
+	  sqlite3_free_table (results);
+	  return -2;
+      }
+    for (i = 0; i < rows * columns; i++)
+      {
+	  const char *value = results[columns + i];
+	  if (expected[i] == NULL && value == NULL)
+	      continue;
+	  if (expected[i] == NULL || value == NULL
+	      || strcmp (expected[i], value) != 0)
+	    {
+		fprintf (stderr,
+			 "unexpected %s Cost Matrix value #%d: %s (expected %s)\n",
+			 vtable, i, (value == NULL) ? "NULL" : value,
+			 (expected[i] == NULL) ? "NULL" : expected[i]);
+		sqlite3_free_table (results);
+		return -3;
+	    }
+      }
+    sqlite3_free_table (results);
+    return 0;
+}
+
+static int
+do_test_cost_matrix (sqlite3 * handle)
+{
+/* testing the Cost Matrix request, both plain and Contraction Hierarchies */
+    int ret;
+    int i;
+    char *err_msg = NULL;
+    const char *sql[] = {
+	"CREATE TABLE cm_arcs (id INTEGER PRIMARY KEY, node_from INTEGER, "
+	    "node_to INTEGER, cost DOUBLE)",
+	"INSERT INTO cm_arcs VALUES (1, 1, 2, 1), (2, 2, 3, 2), (3, 1, 3, 4), "
+	    "(4, 3, 4, 1), (5, 2, 4, 5), (6, 4, 5, 3), (7, 7, 8, 1)",
+	"SELECT CreateRouting('cm_data', 'cm_vt1', 'cm_arcs', "
+	    "'node_from', 'node_to', NULL, 'cost', NULL, 0, 1)",
+	"SELECT CreateRouting('cm_data_ch', 'cm_vt2', 'cm_arcs', "
+	    "'node_from', 'node_to', NULL, 'cost', NULL, 0, 1, NULL, NULL, 0, 1)",
+	"UPDATE cm_vt1 SET Request = 'Cost Matrix'",
+	"UPDATE cm_vt2 SET Request = 'Cost Matrix', Algorithm = 'CH'",
+	NULL
+    };
+    for (i = 0; sql[i] != NULL; i++)
+      {
+	  ret = sqlite3_exec (handle, sql[i], NULL, NULL, &err_msg);
+	  if (ret != SQLITE_OK)
+	    {
+		fprintf (stderr, "Cost Matrix \"%s\" error: %s\n", sql[i],
+			 err_msg);
+		sqlite3_free (err_msg);
+		return -1;
+	    }
+      }
+    if (do_check_cost_matrix (handle, "cm_vt1") != 0)
+	return -2;
+    if (do_check_cost_matrix (handle, "cm_vt2") != 0)
+	return -3;
+    return 0;
+}
+
 #endif
 
 int
@@ -1505,6 +1966,46 @@ main (int argc, char *argv[])
 	  return -45;
       }
 
+/* testing a sidecar file */
+    ret = do_test_sidecar (handle);
+    if (ret != 0)
+      {
+	  fprintf (stderr, "Test Sidecar error\n");
+	  return -46;
+      }
+
+/* testing Turn restrictions and Time Dependent Costs */
+    ret = do_test_turns_profiles (handle);
+    if (ret != 0)
+      {
+	  fprintf (stderr, "Test Turns error\n");
+	  return -48;
+      }
+
+/* testing incremental updates */
+    ret = do_test_update_links (handle);
+    if (ret != 0)
+      {
+	  fprintf (stderr, "Test UpdateLinks error\n");
+	  return -49;
+      }
+
+/* testing Isochrones */
+    ret = do_test_isochrones (handle);
+    if (ret != 0)
+      {
+	  fprintf (stderr, "Test Isochrones error\n");
+	  return -50;
+      }
+
+/* testing Cost Matrix */
+    ret = do_test_cost_matrix (handle);
+    if (ret != 0)
+      {
+	  fprintf (stderr, "Test Cost Matrix error\n");
+	  return -51;
+      }
+
 /* testing invalid cases */
     ret = do_test_invalid (handle);
     if (ret != 0)